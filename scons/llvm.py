@@ -120,6 +120,13 @@ def generate(env):
                 'LLVMDemangle', 'LLVMGlobalISel', 'LLVMDebugInfoMSF',
                 'LLVMBinaryFormat',
             ])
+            if llvm_version >= distutils.version.LooseVersion('8.0'):
+                # llvmpipe compute shaders use coroutines
+                env.Prepend(LIBS = [
+                    'LLVMCoroutines', 'LLVMipo', 'LLVMInstrumentation',
+                    'LLVMVectorize', 'LLVMLinker',
+                    'LLVMAggressiveInstCombine',
+                ])
             if env['platform'] == 'windows' and env['crosscompile']:
                 # LLVM 5.0 requires MinGW w/ pthreads due to use of std::thread and friends.
                 assert env['gcc']
@@ -265,6 +272,10 @@ def generate(env):
             else:
                components = ['engine', 'mcjit', 'bitwriter', 'mcdisassembler', 'irreader']
 
+            if llvm_version >= distutils.version.LooseVersion('8.0'):
+               # llvmpipe compute shaders use coroutines
+               components.append('coroutines')
+
             env.ParseConfig('%s --libs ' % llvm_config + ' '.join(components))
             env.ParseConfig('%s --ldflags' % llvm_config)
             if llvm_version >= distutils.version.LooseVersion('3.5'):
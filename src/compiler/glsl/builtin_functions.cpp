@@ -82,7 +82,10 @@
 #include "program/prog_instruction.h"
 #include <math.h>
 #include "builtin_functions.h"
+#include "ir_serialize.h"
+#include "compiler/blob.h"
 #include "util/hash_table.h"
+#include "util/u_math.h"
 
 #define M_PIf   ((float) M_PI)
 #define M_PI_2f ((float) M_PI_2)
@@ -90,6 +93,14 @@
 
 using namespace ir_builder;
 
+/**
+ * The serialized built-in function library, generated at build time by
+ * builtin_library_gen.cpp.  Its size is zero when the library isn't
+ * available, in which case the built-ins are built with ir_builder instead.
+ */
+extern const uint32_t _mesa_glsl_builtin_library[];
+extern const unsigned _mesa_glsl_builtin_library_size;
+
 /**
  * Availability predicates:
  *  @{
@@ -796,6 +807,112 @@ shader_atomic_float_minmax(const _mesa_glsl_parse_state *state)
 {
    return state->INTEL_shader_atomic_float_minmax_enable;
 }
+
+/**
+ * Every availability predicate, so that the serialized built-in library can
+ * refer to them by index.  New predicates have to be added here as well.
+ */
+static const builtin_available_predicate builtin_predicates[] = {
+   always_available,
+   compatibility_vs_only,
+   derivatives_only,
+   gs_only,
+   v110,
+   v110_derivatives_only,
+   v120,
+   v130,
+   v130_desktop,
+   v460_desktop,
+   v130_derivatives_only,
+   v140_or_es3,
+   v400_derivatives_only,
+   texture_rectangle,
+   texture_external,
+   texture_external_es3,
+   lod_exists_in_stage,
+   v110_lod,
+   texture_buffer,
+   shader_texture_lod,
+   shader_texture_lod_and_rect,
+   shader_bit_encoding,
+   shader_integer_mix,
+   shader_packing_or_es3,
+   shader_packing_or_es3_or_gpu_shader5,
+   gpu_shader4,
+   gpu_shader4_integer,
+   gpu_shader4_array,
+   gpu_shader4_array_integer,
+   gpu_shader4_rect,
+   gpu_shader4_rect_integer,
+   gpu_shader4_tbo,
+   gpu_shader4_tbo_integer,
+   gpu_shader4_derivs_only,
+   gpu_shader4_integer_derivs_only,
+   gpu_shader4_array_derivs_only,
+   gpu_shader4_array_integer_derivs_only,
+   v130_or_gpu_shader4,
+   gpu_shader5,
+   gpu_shader5_es,
+   gpu_shader5_or_OES_texture_cube_map_array,
+   es31_not_gs5,
+   gpu_shader5_or_es31,
+   shader_packing_or_es31_or_gpu_shader5,
+   gpu_shader5_or_es31_or_integer_functions,
+   fs_interpolate_at,
+   texture_array_lod,
+   texture_array,
+   texture_array_derivs_only,
+   texture_multisample,
+   texture_multisample_array,
+   texture_samples_identical,
+   texture_samples_identical_array,
+   derivatives_texture_cube_map_array,
+   texture_cube_map_array,
+   texture_query_levels,
+   texture_query_lod,
+   texture_gather_cube_map_array,
+   texture_texture4,
+   texture_gather_or_es31,
+   texture_gather_only_or_es31,
+   derivatives,
+   derivative_control,
+   tex1d_lod,
+   tex3d,
+   derivatives_tex3d,
+   tex3d_lod,
+   shader_atomic_counters,
+   shader_atomic_counter_ops,
+   shader_atomic_counter_ops_or_v460_desktop,
+   shader_ballot,
+   supports_arb_fragment_shader_interlock,
+   supports_nv_fragment_shader_interlock,
+   shader_clock,
+   shader_clock_int64,
+   shader_storage_buffer_object,
+   shader_trinary_minmax,
+   shader_image_load_store,
+   shader_image_atomic,
+   shader_image_atomic_exchange_float,
+   shader_image_atomic_add_float,
+   shader_image_size,
+   shader_samples,
+   gs_streams,
+   fp64,
+   int64,
+   int64_fp64,
+   compute_shader,
+   compute_shader_supported,
+   buffer_atomics_supported,
+   barrier_supported,
+   vote,
+   vote_or_v460_desktop,
+   integer_functions_supported,
+   NV_shader_atomic_float_supported,
+   shader_atomic_float_add,
+   shader_atomic_float_exchange,
+   INTEL_shader_atomic_float_minmax_supported,
+   shader_atomic_float_minmax,
+};
 /** @} */
 
 /******************************************************************************/
@@ -814,10 +931,12 @@ public:
    builtin_builder();
    ~builtin_builder();
 
-   void initialize();
+   void initialize(const uint32_t *library, unsigned library_size);
    void release();
    ir_function_signature *find(_mesa_glsl_parse_state *state,
                                const char *name, exec_list *actual_parameters);
+   ir_function *get_function(const char *name);
+   void write_library(struct blob *blob);
 
    /**
     * A shader to hold all the built-in signatures; created by this module.
@@ -831,9 +950,18 @@ public:
 private:
    void *mem_ctx;
 
+   /**
+    * Functions of the serialized library whose signatures haven't been read
+    * yet, mapped to their offset in \c library_functions.
+    */
+   struct hash_table *unread_functions;
+   const uint8_t *library_functions;
+   size_t library_functions_size;
+
    void create_shader();
    void create_intrinsics();
    void create_builtins();
+   void read_library(const uint32_t *library, unsigned library_size);
 
    /**
     * IR builder helpers:
@@ -1186,7 +1314,8 @@ enum image_function_flags {
  *  @{
  */
 builtin_builder::builtin_builder()
-   : shader(NULL)
+   : shader(NULL), unread_functions(NULL), library_functions(NULL),
+     library_functions_size(0)
 {
    mem_ctx = NULL;
 }
@@ -1209,7 +1338,7 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
     */
    state->uses_builtin_functions = true;
 
-   ir_function *f = shader->symbols->get_function(name);
+   ir_function *f = get_function(name);
    if (f == NULL)
       return NULL;
 
@@ -1221,8 +1350,12 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
    return sig;
 }
 
+/**
+ * Create the built-in functions, reading them from \p library unless its
+ * size is zero, in which case they are built with ir_builder.
+ */
 void
-builtin_builder::initialize()
+builtin_builder::initialize(const uint32_t *library, unsigned library_size)
 {
    /* If already initialized, don't do it again. */
    if (mem_ctx != NULL)
@@ -1230,6 +1363,12 @@ builtin_builder::initialize()
 
    mem_ctx = ralloc_context(NULL);
    create_shader();
+
+   if (library_size != 0) {
+      read_library(library, library_size);
+      return;
+   }
+
    create_intrinsics();
    create_builtins();
 }
@@ -1239,11 +1378,98 @@ builtin_builder::release()
 {
    ralloc_free(mem_ctx);
    mem_ctx = NULL;
+   unread_functions = NULL;
 
    ralloc_free(shader);
    shader = NULL;
 }
 
+static ir_function *
+get_library_function(void *data, const char *name)
+{
+   return ((builtin_builder *) data)->get_function(name);
+}
+
+/**
+ * Look up a built-in function by name, reading its signatures from the
+ * serialized library on first use.
+ */
+ir_function *
+builtin_builder::get_function(const char *name)
+{
+   ir_function *f = shader->symbols->get_function(name);
+   if (f == NULL || unread_functions == NULL)
+      return f;
+
+   struct hash_entry *entry = _mesa_hash_table_search(unread_functions, f);
+   if (entry != NULL) {
+      const uint32_t offset = (uintptr_t) entry->data;
+      struct blob_reader blob;
+
+      _mesa_hash_table_remove(unread_functions, entry);
+
+      blob_reader_init(&blob, library_functions + offset,
+                       library_functions_size - offset);
+      ir_deserialize_function(mem_ctx, &blob, f, builtin_predicates,
+                              get_library_function, this);
+      assert(!blob.overrun);
+   }
+
+   return f;
+}
+
+/**
+ * Create an empty ir_function for every function in the serialized library.
+ *
+ * The library starts with a directory of function names and the offsets of
+ * their signatures, which are only read once the function is looked up.
+ */
+void
+builtin_builder::read_library(const uint32_t *library, unsigned library_size)
+{
+   struct blob_reader blob;
+   blob_reader_init(&blob, library, library_size);
+
+   unread_functions = _mesa_pointer_hash_table_create(mem_ctx);
+
+   const unsigned num_functions = blob_read_uint32(&blob);
+   for (unsigned i = 0; i < num_functions; i++) {
+      ir_function *f = new(mem_ctx) ir_function(blob_read_string(&blob));
+      const uint32_t offset = blob_read_uint32(&blob);
+
+      _mesa_hash_table_insert(unread_functions, f, (void *) (uintptr_t) offset);
+      shader->symbols->add_function(f);
+      shader->ir->push_tail(f);
+   }
+
+   library_functions_size = blob_read_uint32(&blob);
+   library_functions = blob.current;
+   assert(!blob.overrun);
+}
+
+/**
+ * Serialize every built-in function in the format read_library() expects.
+ */
+void
+builtin_builder::write_library(struct blob *blob)
+{
+   struct blob functions;
+   blob_init(&functions);
+
+   blob_write_uint32(blob, shader->ir->length());
+   foreach_in_list(ir_function, f, shader->ir) {
+      /* Each function starts with a uint32, so it's word aligned. */
+      blob_write_string(blob, f->name);
+      blob_write_uint32(blob, align(functions.size, sizeof(uint32_t)));
+      ir_serialize_function(&functions, f, builtin_predicates,
+                            ARRAY_SIZE(builtin_predicates));
+   }
+
+   blob_write_uint32(blob, functions.size);
+   blob_write_bytes(blob, functions.data, functions.size);
+   blob_finish(&functions);
+}
+
 void
 builtin_builder::create_shader()
 {
@@ -1253,6 +1479,7 @@ builtin_builder::create_shader()
     */
    shader = _mesa_new_shader(0, MESA_SHADER_VERTEX);
    shader->symbols = new(mem_ctx) glsl_symbol_table;
+   shader->ir = new(mem_ctx) exec_list;
 }
 
 /** @} */
@@ -4244,6 +4471,7 @@ builtin_builder::add_function(const char *name, ...)
    va_end(ap);
 
    shader->symbols->add_function(f);
+   shader->ir->push_tail(f);
 }
 
 void
@@ -4302,6 +4530,7 @@ builtin_builder::add_image_function(const char *name,
    }
 
    shader->symbols->add_function(f);
+   shader->ir->push_tail(f);
 }
 
 void
@@ -7221,7 +7450,8 @@ void
 _mesa_glsl_initialize_builtin_functions()
 {
    mtx_lock(&builtins_lock);
-   builtins.initialize();
+   builtins.initialize(_mesa_glsl_builtin_library,
+                       _mesa_glsl_builtin_library_size);
    mtx_unlock(&builtins_lock);
 }
 
@@ -7251,7 +7481,7 @@ _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state, const char *name)
    ir_function *f;
    bool ret = false;
    mtx_lock(&builtins_lock);
-   f = builtins.shader->symbols->get_function(name);
+   f = builtins.get_function(name);
    if (f != NULL) {
       foreach_in_list(ir_function_signature, sig, &f->signatures) {
          if (sig->is_builtin_available(state)) {
@@ -7265,12 +7495,160 @@ _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state, const char *name)
    return ret;
 }
 
+/**
+ * Look up a built-in function by name, loading its signatures from the
+ * library first if they haven't been read yet.
+ */
+ir_function *
+_mesa_glsl_get_builtin_function(const char *name)
+{
+   ir_function *f;
+   mtx_lock(&builtins_lock);
+   f = builtins.get_function(name);
+   mtx_unlock(&builtins_lock);
+
+   return f;
+}
+
 gl_shader *
 _mesa_glsl_get_builtin_function_shader()
 {
    return builtins.shader;
 }
 
+void
+_mesa_glsl_write_builtin_library(struct blob *blob)
+{
+   builtin_builder builder;
+
+   builder.initialize(NULL, 0);
+   builder.write_library(blob);
+   builder.release();
+}
+
+/**
+ * Print \p ir to a string allocated out of \p mem_ctx.
+ *
+ * ir_print_visitor numbers clashing variable names with process-wide
+ * counters, so the "@N" suffixes are renumbered in order of appearance.
+ */
+static char *
+print_ir_to_string(void *mem_ctx, ir_instruction *ir)
+{
+   FILE *f = tmpfile();
+   if (f == NULL)
+      return NULL;
+
+   ir->fprint(f);
+
+   const long size = ftell(f);
+   char *printed = (char *) ralloc_size(mem_ctx, size + 1);
+   rewind(f);
+   printed[fread(printed, 1, size, f)] = '\0';
+   fclose(f);
+
+   char *normalized = ralloc_strdup(mem_ctx, "");
+   struct hash_table *numbers =
+      _mesa_hash_table_create(mem_ctx, _mesa_key_hash_string,
+                              _mesa_key_string_equal);
+   const char *p = printed;
+
+   while (const char *at = strchr(p, '@')) {
+      const size_t digits = strspn(at + 1, "0123456789");
+
+      ralloc_strncat(&normalized, p, at + 1 - p);
+      p = at + 1 + digits;
+      if (digits == 0)
+         continue;
+
+      char *number = ralloc_strndup(mem_ctx, at + 1, digits);
+      struct hash_entry *entry = _mesa_hash_table_search(numbers, number);
+      if (entry == NULL) {
+         entry = _mesa_hash_table_insert(numbers, number,
+            (void *) (uintptr_t) (numbers->entries + 1));
+      }
+      ralloc_asprintf_append(&normalized, "%u",
+                             (unsigned) (uintptr_t) entry->data);
+   }
+   ralloc_strcat(&normalized, p);
+
+   return normalized;
+}
+
+/**
+ * Check that \p library holds the built-in functions ir_builder builds.
+ *
+ * Every signature is read back from the library and its printed IR is
+ * compared with the one of the built signature, then the whole library is
+ * validated.  Mismatches are reported on stderr.
+ */
+bool
+_mesa_glsl_check_builtin_library(const uint32_t *library,
+                                 unsigned library_size)
+{
+   builtin_builder built, read;
+   void *mem_ctx = ralloc_context(NULL);
+   unsigned errors = 0;
+
+   built.initialize(NULL, 0);
+   read.initialize(library, library_size);
+
+   if (read.shader->ir->length() != built.shader->ir->length()) {
+      fprintf(stderr, "built-in library has %u functions instead of %u\n",
+              read.shader->ir->length(), built.shader->ir->length());
+      errors++;
+   }
+
+   foreach_in_list(ir_function, f, built.shader->ir) {
+      ir_function *read_f = read.get_function(f->name);
+      if (read_f == NULL) {
+         fprintf(stderr, "built-in library lacks %s\n", f->name);
+         errors++;
+         continue;
+      }
+
+      const exec_node *read_node = read_f->signatures.get_head_raw();
+      foreach_in_list(ir_function_signature, sig, &f->signatures) {
+         if (read_node->is_tail_sentinel()) {
+            fprintf(stderr, "built-in library lacks signatures of %s\n",
+                    f->name);
+            errors++;
+            break;
+         }
+
+         ir_function_signature *read_sig =
+            (ir_function_signature *) read_node;
+         const char *expected = print_ir_to_string(mem_ctx, sig);
+         const char *printed = print_ir_to_string(mem_ctx, read_sig);
+
+         if (expected == NULL || printed == NULL ||
+             strcmp(expected, printed) != 0 ||
+             read_sig->get_builtin_avail() != sig->get_builtin_avail() ||
+             read_sig->intrinsic_id != sig->intrinsic_id) {
+            fprintf(stderr, "built-in library has a different %s:\n%s\n"
+                    "instead of:\n%s\n", f->name, printed, expected);
+            errors++;
+         }
+
+         read_node = read_node->get_next();
+      }
+
+      if (!read_node->is_tail_sentinel()) {
+         fprintf(stderr, "built-in library has extra signatures of %s\n",
+                 f->name);
+         errors++;
+      }
+   }
+
+   validate_ir_tree(read.shader->ir);
+
+   ralloc_free(mem_ctx);
+   read.release();
+   built.release();
+
+   return errors == 0;
+}
+
 
 /**
  * Get the function signature for main from a shader
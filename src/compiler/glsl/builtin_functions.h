@@ -24,6 +24,7 @@
 #ifndef BULITIN_FUNCTIONS_H
 #define BULITIN_FUNCTIONS_H
 
+struct blob;
 struct gl_shader;
 
 extern void
@@ -37,9 +38,19 @@ extern bool
 _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state,
                                 const char *name);
 
+extern ir_function *
+_mesa_glsl_get_builtin_function(const char *name);
+
 extern gl_shader *
 _mesa_glsl_get_builtin_function_shader(void);
 
+extern void
+_mesa_glsl_write_builtin_library(struct blob *blob);
+
+extern bool
+_mesa_glsl_check_builtin_library(const uint32_t *library,
+                                 unsigned library_size);
+
 extern ir_function_signature *
 _mesa_get_main_function_signature(glsl_symbol_table *symbols);
 
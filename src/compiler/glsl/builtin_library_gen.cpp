@@ -0,0 +1,102 @@
+/*
+ * Copyright © 2019 VMware, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file builtin_library_gen.cpp
+ *
+ * Builds every built-in function with ir_builder and writes the serialized
+ * library to a C++ source file, which is compiled into libglsl so that the
+ * built-ins don't have to be built at run time.  The library is read back
+ * and checked against the built IR before it is written.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "compiler/blob.h"
+#include "compiler/glsl_types.h"
+#include "ir.h"
+#include "builtin_functions.h"
+
+int
+main(int argc, char **argv)
+{
+   if (argc != 2) {
+      fprintf(stderr, "usage: %s OUTPUT\n", argv[0]);
+      return 1;
+   }
+
+   /* Store the names of temporaries.  They are dropped again when the
+    * library is read, unless the compiler is keeping them for debugging.
+    */
+   ir_variable::temporaries_allocate_names = true;
+
+   glsl_type_singleton_init_or_ref();
+
+   struct blob blob;
+   blob_init(&blob);
+   _mesa_glsl_write_builtin_library(&blob);
+
+   if (blob.out_of_memory) {
+      fprintf(stderr, "%s: out of memory\n", argv[0]);
+      return 1;
+   }
+
+   /* Fail the build rather than ship a library which reads back as
+    * different IR.
+    */
+   if (!_mesa_glsl_check_builtin_library((const uint32_t *) blob.data,
+                                         blob.size)) {
+      fprintf(stderr, "%s: the serialized library doesn't match the "
+                      "built-in functions\n", argv[0]);
+      return 1;
+   }
+
+   FILE *f = fopen(argv[1], "w");
+   if (f == NULL) {
+      fprintf(stderr, "%s: failed to write %s\n", argv[0], argv[1]);
+      return 1;
+   }
+
+   /* Emit words so that the library is aligned for blob_read_uint32(). */
+   fprintf(f, "/* Generated by builtin_library_gen, do not edit. */\n\n"
+              "#include <stdint.h>\n\n"
+              "extern const uint32_t _mesa_glsl_builtin_library[];\n"
+              "extern const unsigned _mesa_glsl_builtin_library_size;\n\n"
+              "const unsigned _mesa_glsl_builtin_library_size = %u;\n\n"
+              "const uint32_t _mesa_glsl_builtin_library[] = {\n",
+           (unsigned) blob.size);
+
+   for (size_t i = 0; i < blob.size; i += sizeof(uint32_t)) {
+      uint32_t word = 0;
+      memcpy(&word, blob.data + i, MIN2(sizeof(word), blob.size - i));
+      fprintf(f, "%s0x%08x,%s", i % 32 == 0 ? "   " : " ", word,
+              i % 32 == 28 || i + sizeof(word) >= blob.size ? "\n" : "");
+   }
+
+   fprintf(f, "};\n");
+
+   blob_finish(&blob);
+   glsl_type_singleton_decref();
+
+   return fclose(f) == 0 ? 0 : 1;
+}
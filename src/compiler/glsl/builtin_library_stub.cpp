@@ -0,0 +1,40 @@
+/*
+ * Copyright © 2019 VMware, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file builtin_library_stub.cpp
+ *
+ * An empty built-in function library.
+ *
+ * Used by builtin_library_gen itself and by builds that can't run it, such
+ * as cross builds.  The built-in functions are then built with ir_builder
+ * when the first shader is compiled.
+ */
+
+#include <stdint.h>
+
+extern const uint32_t _mesa_glsl_builtin_library[];
+extern const unsigned _mesa_glsl_builtin_library_size;
+
+const uint32_t _mesa_glsl_builtin_library[] = { 0 };
+const unsigned _mesa_glsl_builtin_library_size = 0;
@@ -0,0 +1,638 @@
+/*
+ * Copyright © 2019 VMware, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_serialize.cpp
+ *
+ * Writes GLSL IR functions to a blob and reads them back.
+ *
+ * Every node starts with its ir_node_type, with ir_type_unset standing for
+ * a NULL pointer.  Variables are numbered in the order they are declared
+ * within a signature and dereferences refer to them by that number.  Types
+ * that follow from the operands (dereferences, swizzles) are not stored.
+ */
+
+#include "ir_serialize.h"
+#include "compiler/blob.h"
+#include "compiler/glsl_types.h"
+#include "util/hash_table.h"
+#include "util/u_dynarray.h"
+
+namespace {
+
+class ir_serializer {
+public:
+   ir_serializer(struct blob *blob,
+                 const builtin_available_predicate *predicates,
+                 unsigned num_predicates)
+      : blob(blob), predicates(predicates), num_predicates(num_predicates),
+        num_variables(0)
+   {
+      variables = _mesa_pointer_hash_table_create(NULL);
+   }
+
+   ~ir_serializer()
+   {
+      _mesa_hash_table_destroy(variables, NULL);
+   }
+
+   void write_function(const ir_function *f);
+
+private:
+   void write_signature(const ir_function_signature *sig);
+   void write_list(const exec_list *list);
+   void write_ir(const ir_instruction *ir);
+   void write_variable(const ir_variable *var);
+   void write_variable_index(const ir_variable *var);
+   void write_constant(const ir_constant *c);
+   void write_call(const ir_call *call);
+   void write_texture(const ir_texture *tex);
+
+   struct blob *blob;
+   const builtin_available_predicate *predicates;
+   unsigned num_predicates;
+
+   /** Index of each variable declared in the current signature. */
+   struct hash_table *variables;
+   unsigned num_variables;
+};
+
+class ir_deserializer {
+public:
+   ir_deserializer(void *mem_ctx, struct blob_reader *blob,
+                   const builtin_available_predicate *predicates,
+                   ir_function *(*get_function)(void *, const char *),
+                   void *data)
+      : mem_ctx(mem_ctx), blob(blob), predicates(predicates),
+        get_function(get_function), data(data)
+   {
+      util_dynarray_init(&variables, NULL);
+   }
+
+   ~ir_deserializer()
+   {
+      util_dynarray_fini(&variables);
+   }
+
+   void read_function(ir_function *f);
+
+private:
+   ir_function_signature *read_signature();
+   void read_list(exec_list *list);
+   ir_instruction *read_ir();
+   ir_rvalue *read_rvalue();
+   ir_variable *read_variable();
+   ir_variable *read_variable_index();
+   ir_constant *read_constant();
+   ir_call *read_call();
+   ir_texture *read_texture();
+
+   void *mem_ctx;
+   struct blob_reader *blob;
+   const builtin_available_predicate *predicates;
+   ir_function *(*get_function)(void *, const char *);
+   void *data;
+
+   /** Variables declared so far in the current signature. */
+   struct util_dynarray variables;
+};
+
+} /* anonymous namespace */
+
+void
+ir_serializer::write_function(const ir_function *f)
+{
+   blob_write_uint32(blob, f->signatures.length());
+   foreach_in_list(const ir_function_signature, sig, &f->signatures)
+      write_signature(sig);
+}
+
+void
+ir_serializer::write_signature(const ir_function_signature *sig)
+{
+   unsigned avail;
+   for (avail = 0; avail < num_predicates; avail++) {
+      if (predicates[avail] == sig->get_builtin_avail())
+         break;
+   }
+   assert(avail < num_predicates);
+
+   _mesa_hash_table_clear(variables, NULL);
+   num_variables = 0;
+
+   encode_type_to_blob(blob, sig->return_type);
+   blob_write_uint32(blob, avail);
+   blob_write_uint32(blob, sig->intrinsic_id);
+   blob_write_uint32(blob, sig->is_defined);
+   write_list(&sig->parameters);
+   write_list(&sig->body);
+}
+
+void
+ir_serializer::write_list(const exec_list *list)
+{
+   blob_write_uint32(blob, list->length());
+   foreach_in_list(const ir_instruction, ir, list)
+      write_ir(ir);
+}
+
+void
+ir_serializer::write_variable_index(const ir_variable *var)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(variables, var);
+   assert(entry != NULL);
+   blob_write_uint32(blob, (uintptr_t) entry->data);
+}
+
+void
+ir_serializer::write_variable(const ir_variable *var)
+{
+   /* Interface blocks and built-in uniforms never appear in functions. */
+   assert(var->get_interface_type() == NULL);
+   assert(var->get_state_slots() == NULL);
+
+   encode_type_to_blob(blob, var->type);
+   blob_write_string(blob, var->name);
+   blob_write_bytes(blob, &var->data, sizeof(var->data));
+   write_ir(var->constant_value);
+   write_ir(var->constant_initializer);
+
+   _mesa_hash_table_insert(variables, var, (void *) (uintptr_t) num_variables);
+   num_variables++;
+}
+
+void
+ir_serializer::write_constant(const ir_constant *c)
+{
+   const glsl_type *type = c->type;
+
+   encode_type_to_blob(blob, type);
+
+   if (type->is_array() || type->is_struct()) {
+      for (unsigned i = 0; i < type->length; i++)
+         write_ir(c->const_elements[i]);
+      return;
+   }
+
+   for (unsigned i = 0; i < type->components(); i++) {
+      if (glsl_base_type_is_64bit(type->base_type)) {
+         blob_write_uint32(blob, c->value.u64[i]);
+         blob_write_uint32(blob, c->value.u64[i] >> 32);
+      } else if (type->is_boolean()) {
+         blob_write_uint32(blob, c->value.b[i]);
+      } else {
+         blob_write_uint32(blob, c->value.u[i]);
+      }
+   }
+}
+
+void
+ir_serializer::write_call(const ir_call *call)
+{
+   const ir_function *f = call->callee->function();
+   unsigned index = 0;
+
+   foreach_in_list(const ir_function_signature, sig, &f->signatures) {
+      if (sig == call->callee)
+         break;
+      index++;
+   }
+
+   /* Subroutine calls can't be made from built-ins. */
+   assert(call->sub_var == NULL);
+
+   blob_write_string(blob, f->name);
+   blob_write_uint32(blob, index);
+   write_ir(call->return_deref);
+   write_list(&call->actual_parameters);
+}
+
+void
+ir_serializer::write_texture(const ir_texture *tex)
+{
+   blob_write_uint32(blob, tex->op);
+   encode_type_to_blob(blob, tex->type);
+   write_ir(tex->sampler);
+   write_ir(tex->coordinate);
+   write_ir(tex->projector);
+   write_ir(tex->shadow_comparator);
+   write_ir(tex->offset);
+
+   switch (tex->op) {
+   case ir_tex:
+   case ir_lod:
+   case ir_query_levels:
+   case ir_texture_samples:
+   case ir_samples_identical:
+      break;
+   case ir_txb:
+      write_ir(tex->lod_info.bias);
+      break;
+   case ir_txl:
+   case ir_txf:
+   case ir_txs:
+      write_ir(tex->lod_info.lod);
+      break;
+   case ir_txf_ms:
+      write_ir(tex->lod_info.sample_index);
+      break;
+   case ir_txd:
+      write_ir(tex->lod_info.grad.dPdx);
+      write_ir(tex->lod_info.grad.dPdy);
+      break;
+   case ir_tg4:
+      write_ir(tex->lod_info.component);
+      break;
+   }
+}
+
+void
+ir_serializer::write_ir(const ir_instruction *ir)
+{
+   if (ir == NULL) {
+      blob_write_uint32(blob, ir_type_unset);
+      return;
+   }
+
+   blob_write_uint32(blob, ir->ir_type);
+
+   switch (ir->ir_type) {
+   case ir_type_dereference_array: {
+      const ir_dereference_array *deref = (const ir_dereference_array *) ir;
+      write_ir(deref->array);
+      write_ir(deref->array_index);
+      break;
+   }
+   case ir_type_dereference_record: {
+      const ir_dereference_record *deref = (const ir_dereference_record *) ir;
+      write_ir(deref->record);
+      blob_write_uint32(blob, deref->field_idx);
+      break;
+   }
+   case ir_type_dereference_variable:
+      write_variable_index(((const ir_dereference_variable *) ir)->var);
+      break;
+   case ir_type_constant:
+      write_constant((const ir_constant *) ir);
+      break;
+   case ir_type_expression: {
+      const ir_expression *expr = (const ir_expression *) ir;
+      blob_write_uint32(blob, expr->operation);
+      blob_write_uint32(blob, expr->num_operands);
+      encode_type_to_blob(blob, expr->type);
+      for (unsigned i = 0; i < expr->num_operands; i++)
+         write_ir(expr->operands[i]);
+      break;
+   }
+   case ir_type_swizzle: {
+      const ir_swizzle *swiz = (const ir_swizzle *) ir;
+      blob_write_uint32(blob, swiz->mask.x | swiz->mask.y << 2 |
+                              swiz->mask.z << 4 | swiz->mask.w << 6 |
+                              swiz->mask.num_components << 8);
+      write_ir(swiz->val);
+      break;
+   }
+   case ir_type_texture:
+      write_texture((const ir_texture *) ir);
+      break;
+   case ir_type_variable:
+      write_variable((const ir_variable *) ir);
+      break;
+   case ir_type_assignment: {
+      const ir_assignment *assign = (const ir_assignment *) ir;
+      write_ir(assign->lhs);
+      write_ir(assign->rhs);
+      write_ir(assign->condition);
+      blob_write_uint32(blob, assign->write_mask);
+      break;
+   }
+   case ir_type_call:
+      write_call((const ir_call *) ir);
+      break;
+   case ir_type_if: {
+      const ir_if *iff = (const ir_if *) ir;
+      write_ir(iff->condition);
+      write_list(&iff->then_instructions);
+      write_list(&iff->else_instructions);
+      break;
+   }
+   case ir_type_loop:
+      write_list(&((const ir_loop *) ir)->body_instructions);
+      break;
+   case ir_type_loop_jump:
+      blob_write_uint32(blob, ((const ir_loop_jump *) ir)->mode);
+      break;
+   case ir_type_return:
+      write_ir(((const ir_return *) ir)->value);
+      break;
+   case ir_type_discard:
+      write_ir(((const ir_discard *) ir)->condition);
+      break;
+   case ir_type_emit_vertex:
+      write_ir(((const ir_emit_vertex *) ir)->stream);
+      break;
+   case ir_type_end_primitive:
+      write_ir(((const ir_end_primitive *) ir)->stream);
+      break;
+   case ir_type_barrier:
+      break;
+   case ir_type_function:
+   case ir_type_function_signature:
+   case ir_type_unset:
+      unreachable("not part of a function body");
+   }
+}
+
+void
+ir_deserializer::read_function(ir_function *f)
+{
+   unsigned num_signatures = blob_read_uint32(blob);
+   for (unsigned i = 0; i < num_signatures; i++)
+      f->add_signature(read_signature());
+}
+
+ir_function_signature *
+ir_deserializer::read_signature()
+{
+   util_dynarray_clear(&variables);
+
+   const glsl_type *return_type = decode_type_from_blob(blob);
+   builtin_available_predicate avail = predicates[blob_read_uint32(blob)];
+   ir_function_signature *sig =
+      new(mem_ctx) ir_function_signature(return_type, avail);
+
+   sig->intrinsic_id = (enum ir_intrinsic_id) blob_read_uint32(blob);
+   sig->is_defined = blob_read_uint32(blob);
+   read_list(&sig->parameters);
+   read_list(&sig->body);
+
+   return sig;
+}
+
+void
+ir_deserializer::read_list(exec_list *list)
+{
+   unsigned length = blob_read_uint32(blob);
+   for (unsigned i = 0; i < length; i++)
+      list->push_tail(read_ir());
+}
+
+ir_rvalue *
+ir_deserializer::read_rvalue()
+{
+   ir_instruction *ir = read_ir();
+   return ir ? ir->as_rvalue() : NULL;
+}
+
+ir_variable *
+ir_deserializer::read_variable_index()
+{
+   unsigned index = blob_read_uint32(blob);
+   return *util_dynarray_element(&variables, ir_variable *, index);
+}
+
+ir_variable *
+ir_deserializer::read_variable()
+{
+   const glsl_type *type = decode_type_from_blob(blob);
+   const char *name = blob_read_string(blob);
+
+   /* The constructor decides from the mode whether to keep the name of a
+    * temporary, so the mode is needed before the rest of the data.
+    */
+   ir_variable::ir_variable_data data;
+   blob_copy_bytes(blob, &data, sizeof(data));
+
+   ir_variable *var =
+      new(mem_ctx) ir_variable(type, name, (ir_variable_mode) data.mode);
+   memcpy(&var->data, &data, sizeof(data));
+   var->constant_value = (ir_constant *) read_ir();
+   var->constant_initializer = (ir_constant *) read_ir();
+
+   util_dynarray_append(&variables, ir_variable *, var);
+   return var;
+}
+
+ir_constant *
+ir_deserializer::read_constant()
+{
+   const glsl_type *type = decode_type_from_blob(blob);
+
+   if (type->is_array() || type->is_struct()) {
+      exec_list values;
+      for (unsigned i = 0; i < type->length; i++)
+         values.push_tail(read_ir());
+      return new(mem_ctx) ir_constant(type, &values);
+   }
+
+   ir_constant_data value;
+   memset(&value, 0, sizeof(value));
+   for (unsigned i = 0; i < type->components(); i++) {
+      if (glsl_base_type_is_64bit(type->base_type)) {
+         value.u64[i] = blob_read_uint32(blob);
+         value.u64[i] |= (uint64_t) blob_read_uint32(blob) << 32;
+      } else if (type->is_boolean()) {
+         value.b[i] = blob_read_uint32(blob);
+      } else {
+         value.u[i] = blob_read_uint32(blob);
+      }
+   }
+   return new(mem_ctx) ir_constant(type, &value);
+}
+
+ir_call *
+ir_deserializer::read_call()
+{
+   ir_function *f = get_function(data, blob_read_string(blob));
+   unsigned index = blob_read_uint32(blob);
+   ir_function_signature *callee = NULL;
+
+   foreach_in_list(ir_function_signature, sig, &f->signatures) {
+      if (index-- == 0) {
+         callee = sig;
+         break;
+      }
+   }
+   assert(callee != NULL);
+
+   ir_dereference_variable *return_deref =
+      (ir_dereference_variable *) read_ir();
+   exec_list actual_parameters;
+   read_list(&actual_parameters);
+
+   return new(mem_ctx) ir_call(callee, return_deref, &actual_parameters);
+}
+
+ir_texture *
+ir_deserializer::read_texture()
+{
+   ir_texture *tex =
+      new(mem_ctx) ir_texture((enum ir_texture_opcode) blob_read_uint32(blob));
+
+   tex->type = decode_type_from_blob(blob);
+   tex->sampler = (ir_dereference *) read_ir();
+   tex->coordinate = read_rvalue();
+   tex->projector = read_rvalue();
+   tex->shadow_comparator = read_rvalue();
+   tex->offset = read_rvalue();
+
+   switch (tex->op) {
+   case ir_tex:
+   case ir_lod:
+   case ir_query_levels:
+   case ir_texture_samples:
+   case ir_samples_identical:
+      break;
+   case ir_txb:
+      tex->lod_info.bias = read_rvalue();
+      break;
+   case ir_txl:
+   case ir_txf:
+   case ir_txs:
+      tex->lod_info.lod = read_rvalue();
+      break;
+   case ir_txf_ms:
+      tex->lod_info.sample_index = read_rvalue();
+      break;
+   case ir_txd:
+      tex->lod_info.grad.dPdx = read_rvalue();
+      tex->lod_info.grad.dPdy = read_rvalue();
+      break;
+   case ir_tg4:
+      tex->lod_info.component = read_rvalue();
+      break;
+   }
+
+   return tex;
+}
+
+ir_instruction *
+ir_deserializer::read_ir()
+{
+   enum ir_node_type node_type = (enum ir_node_type) blob_read_uint32(blob);
+
+   switch (node_type) {
+   case ir_type_dereference_array: {
+      ir_rvalue *array = read_rvalue();
+      ir_rvalue *index = read_rvalue();
+      return new(mem_ctx) ir_dereference_array(array, index);
+   }
+   case ir_type_dereference_record: {
+      ir_rvalue *record = read_rvalue();
+      unsigned field = blob_read_uint32(blob);
+      return new(mem_ctx)
+         ir_dereference_record(record,
+                               record->type->fields.structure[field].name);
+   }
+   case ir_type_dereference_variable:
+      return new(mem_ctx) ir_dereference_variable(read_variable_index());
+   case ir_type_constant:
+      return read_constant();
+   case ir_type_expression: {
+      ir_rvalue *operands[4] = { NULL, NULL, NULL, NULL };
+      unsigned op = blob_read_uint32(blob);
+      unsigned num_operands = blob_read_uint32(blob);
+      const glsl_type *type = decode_type_from_blob(blob);
+      for (unsigned i = 0; i < num_operands; i++)
+         operands[i] = read_rvalue();
+      return new(mem_ctx) ir_expression(op, type, operands[0], operands[1],
+                                        operands[2], operands[3]);
+   }
+   case ir_type_swizzle: {
+      unsigned bits = blob_read_uint32(blob);
+      ir_swizzle_mask mask;
+      mask.x = bits & 3;
+      mask.y = (bits >> 2) & 3;
+      mask.z = (bits >> 4) & 3;
+      mask.w = (bits >> 6) & 3;
+      mask.num_components = bits >> 8;
+      mask.has_duplicates = 0;
+      return new(mem_ctx) ir_swizzle(read_rvalue(), mask);
+   }
+   case ir_type_texture:
+      return read_texture();
+   case ir_type_variable:
+      return read_variable();
+   case ir_type_assignment: {
+      ir_dereference *lhs = (ir_dereference *) read_ir();
+      ir_rvalue *rhs = read_rvalue();
+      ir_rvalue *condition = read_rvalue();
+      unsigned write_mask = blob_read_uint32(blob);
+      return new(mem_ctx) ir_assignment(lhs, rhs, condition, write_mask);
+   }
+   case ir_type_call:
+      return read_call();
+   case ir_type_if: {
+      ir_if *iff = new(mem_ctx) ir_if(read_rvalue());
+      read_list(&iff->then_instructions);
+      read_list(&iff->else_instructions);
+      return iff;
+   }
+   case ir_type_loop: {
+      ir_loop *loop = new(mem_ctx) ir_loop;
+      read_list(&loop->body_instructions);
+      return loop;
+   }
+   case ir_type_loop_jump:
+      return new(mem_ctx)
+         ir_loop_jump((ir_loop_jump::jump_mode) blob_read_uint32(blob));
+   case ir_type_return:
+      return new(mem_ctx) ir_return(read_rvalue());
+   case ir_type_discard:
+      return new(mem_ctx) ir_discard(read_rvalue());
+   case ir_type_emit_vertex:
+      return new(mem_ctx) ir_emit_vertex(read_rvalue());
+   case ir_type_end_primitive:
+      return new(mem_ctx) ir_end_primitive(read_rvalue());
+   case ir_type_barrier:
+      return new(mem_ctx) ir_barrier;
+   case ir_type_unset:
+      return NULL;
+   case ir_type_function:
+   case ir_type_function_signature:
+      break;
+   }
+
+   unreachable("invalid IR in blob");
+}
+
+void
+ir_serialize_function(struct blob *blob, const ir_function *f,
+                      const builtin_available_predicate *predicates,
+                      unsigned num_predicates)
+{
+   ir_serializer s(blob, predicates, num_predicates);
+   s.write_function(f);
+}
+
+void
+ir_deserialize_function(void *mem_ctx, struct blob_reader *blob,
+                        ir_function *f,
+                        const builtin_available_predicate *predicates,
+                        ir_function *(*get_function)(void *data,
+                                                     const char *name),
+                        void *data)
+{
+   ir_deserializer d(mem_ctx, blob, predicates, get_function, data);
+   d.read_function(f);
+}
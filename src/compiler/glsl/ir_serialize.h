@@ -0,0 +1,68 @@
+/*
+ * Copyright © 2019 VMware, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_serialize.h
+ *
+ * Binary serialization of GLSL IR functions.
+ *
+ * This is how the built-in function library is stored: the signatures of
+ * each function are written to a blob at build time and read back the first
+ * time the function is used.
+ */
+
+#ifndef IR_SERIALIZE_H
+#define IR_SERIALIZE_H
+
+#include "ir.h"
+
+struct blob;
+struct blob_reader;
+
+/**
+ * Write all signatures of \p f to \p blob.
+ *
+ * Availability predicates are stored as indices into \p predicates, which
+ * must list every predicate used by \p f.  Calls are stored as the name of
+ * the called function and the index of the signature within it.
+ */
+void
+ir_serialize_function(struct blob *blob, const ir_function *f,
+                      const builtin_available_predicate *predicates,
+                      unsigned num_predicates);
+
+/**
+ * Read signatures written by ir_serialize_function() and add them to \p f.
+ *
+ * \p get_function is called to look up the functions the signatures call.
+ * The IR is allocated out of \p mem_ctx.
+ */
+void
+ir_deserialize_function(void *mem_ctx, struct blob_reader *blob,
+                        ir_function *f,
+                        const builtin_available_predicate *predicates,
+                        ir_function *(*get_function)(void *data,
+                                                     const char *name),
+                        void *data);
+
+#endif /* IR_SERIALIZE_H */
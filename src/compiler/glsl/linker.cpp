@@ -2427,9 +2427,7 @@ link_intrastage_shaders(void *mem_ctx,
 
    /* Create program and attach it to the linked shader */
    struct gl_program *gl_prog =
-      ctx->Driver.NewProgram(ctx,
-                             _mesa_shader_stage_to_program(shader_list[0]->Stage),
-                             prog->Name, false);
+      _mesa_new_linked_program(ctx, prog, shader_list[0]->Stage);
    if (!gl_prog) {
       prog->data->LinkStatus = LINKING_FAILURE;
       _mesa_delete_linked_shader(ctx, linked);
@@ -4860,6 +4858,22 @@ linker_optimisation_loop(struct gl_context *ctx, exec_list *ir,
       }
 }
 
+static void
+linker_optimize_stage(struct gl_context *ctx, struct gl_shader_program *prog,
+                      struct gl_linked_shader *shader, void *data)
+{
+   /* Call opts before lowering const arrays to uniforms so we can const
+    * propagate any elements accessed directly.
+    */
+   linker_optimisation_loop(ctx, shader->ir, shader->Stage);
+
+   /* Call opts after lowering const arrays to copy propagate things. */
+   if (lower_const_arrays_to_uniforms(shader->ir, shader->Stage))
+      linker_optimisation_loop(ctx, shader->ir, shader->Stage);
+
+   propagate_invariance(shader->ir);
+}
+
 void
 link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
 {
@@ -5195,19 +5209,22 @@ link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
             goto done;
          }
       }
+   }
 
-      /* Call opts before lowering const arrays to uniforms so we can const
-       * propagate any elements accessed directly.
-       */
-      linker_optimisation_loop(ctx, prog->_LinkedShaders[i]->ir, i);
-
-      /* Call opts after lowering const arrays to copy propagate things. */
-      if (lower_const_arrays_to_uniforms(prog->_LinkedShaders[i]->ir, i))
-         linker_optimisation_loop(ctx, prog->_LinkedShaders[i]->ir, i);
+   /* The stages don't depend on each other until varyings are linked, so
+    * optimize them in parallel.  Their IR was cloned into the temporary
+    * linker context, which the passes allocate from and the threads can't
+    * share, so move each stage's IR to a context of its own first.
+    */
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (prog->_LinkedShaders[i] == NULL)
+         continue;
 
-      propagate_invariance(prog->_LinkedShaders[i]->ir);
+      reparent_ir(prog->_LinkedShaders[i]->ir, prog->_LinkedShaders[i]->ir);
    }
 
+   link_util_run_stages(ctx, prog, linker_optimize_stage, NULL);
+
    /* Validation for special cases where we allow sampler array indexing
     * with loop induction variable. This check emits a warning or error
     * depending if backend can handle dynamic indexing.
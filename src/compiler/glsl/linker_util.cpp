@@ -22,6 +22,7 @@
  *
  */
 #include "main/mtypes.h"
+#include "main/shaderobj.h"
 #include "linker_util.h"
 #include "util/set.h"
 #include "ir_uniform.h" /* for gl_uniform_storage */
@@ -154,3 +155,86 @@ link_util_update_empty_uniform_locations(struct gl_shader_program *prog)
       }
    }
 }
+
+/**
+ * A linked shader handed to another thread by link_util_run_stages().
+ */
+struct link_util_stage_job {
+   struct util_queue_fence fence;
+   struct gl_context *ctx;
+   struct gl_shader_program *prog;
+   struct gl_linked_shader *shader;
+   link_util_stage_func func;
+   void *data;
+   bool done;
+};
+
+static void
+run_stage_job(void *data, int thread_index)
+{
+   struct link_util_stage_job *job = (struct link_util_stage_job *) data;
+
+   job->func(job->ctx, job->prog, job->shader, job->data);
+   job->done = true;
+}
+
+/**
+ * Call \p func for every linked shader of \p prog, and return when all of
+ * them are done.
+ *
+ * When _mesa_get_shader_compiler_queue() allows it, the stages run on the
+ * shader compiler threads in parallel.  \p func must therefore only modify
+ * the shader it is given, including the ralloc context its IR is allocated
+ * from, and must not report linker errors, which go to the log shared by all
+ * stages.
+ */
+void
+link_util_run_stages(struct gl_context *ctx, struct gl_shader_program *prog,
+                     link_util_stage_func func, void *data)
+{
+   struct util_queue *queue;
+   struct link_util_stage_job jobs[MESA_SHADER_STAGES];
+   unsigned num_jobs = 0;
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (prog->_LinkedShaders[i] == NULL)
+         continue;
+
+      struct link_util_stage_job *job = &jobs[num_jobs++];
+      job->ctx = ctx;
+      job->prog = prog;
+      job->shader = prog->_LinkedShaders[i];
+      job->func = func;
+      job->data = data;
+      job->done = false;
+   }
+
+   /* The same conditions that keep compiles and links on the application
+    * thread keep their stages there.
+    */
+   queue = num_jobs < 2 ? NULL : _mesa_get_shader_compiler_queue(ctx);
+   if (!queue) {
+      for (unsigned i = 0; i < num_jobs; i++)
+         run_stage_job(&jobs[i], 0);
+      return;
+   }
+
+   for (unsigned i = 1; i < num_jobs; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(queue, &jobs[i], &jobs[i].fence, run_stage_job,
+                         NULL);
+   }
+
+   run_stage_job(&jobs[0], 0);
+
+   /* We may be on one of the compiler threads ourselves, with all the others
+    * busy, so take back the stages nobody has picked up yet rather than
+    * waiting for them.
+    */
+   for (unsigned i = 1; i < num_jobs; i++) {
+      util_queue_drop_job(queue, &jobs[i].fence);
+      if (!jobs[i].done)
+         run_stage_job(&jobs[i], 0);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
@@ -24,6 +24,8 @@
 #ifndef GLSL_LINKER_UTIL_H
 #define GLSL_LINKER_UTIL_H
 
+struct gl_context;
+struct gl_linked_shader;
 struct gl_shader_program;
 struct gl_uniform_storage;
 
@@ -70,6 +72,15 @@ link_util_find_empty_block(struct gl_shader_program *prog,
 void
 link_util_update_empty_uniform_locations(struct gl_shader_program *prog);
 
+typedef void (*link_util_stage_func)(struct gl_context *ctx,
+                                     struct gl_shader_program *prog,
+                                     struct gl_linked_shader *shader,
+                                     void *data);
+
+void
+link_util_run_stages(struct gl_context *ctx, struct gl_shader_program *prog,
+                     link_util_stage_func func, void *data);
+
 #ifdef __cplusplus
 }
 #endif
@@ -130,7 +130,7 @@ shader_cache_write_program_metadata(struct gl_context *ctx,
                   &cache_item_metadata);
 
    char sha1_buf[41];
-   if (ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+   if (ctx->Shader.Flags & GLSL_CACHE_INFO) {
       _mesa_sha1_format(sha1_buf, prog->data->sha1);
       fprintf(stderr, "putting program metadata in cache: %s\n", sha1_buf);
    }
@@ -228,7 +228,7 @@ shader_cache_read_program_metadata(struct gl_context *ctx,
       return false;
    }
 
-   if (ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+   if (ctx->Shader.Flags & GLSL_CACHE_INFO) {
       _mesa_sha1_format(sha1buf, prog->data->sha1);
       fprintf(stderr, "loading shader program meta data from cache: %s\n",
               sha1buf);
@@ -245,7 +245,7 @@ shader_cache_read_program_metadata(struct gl_context *ctx,
        */
       assert(!"Invalid GLSL shader disk cache item!");
 
-      if (ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+      if (ctx->Shader.Flags & GLSL_CACHE_INFO) {
          fprintf(stderr, "Error reading program from cache (invalid GLSL "
                  "cache item)\n");
       }
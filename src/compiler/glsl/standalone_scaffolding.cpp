@@ -35,6 +35,7 @@
 #include "util/ralloc.h"
 #include "util/strtod.h"
 #include "main/mtypes.h"
+#include "program/program.h"
 
 void
 _mesa_warning(struct gl_context *ctx, const char *fmt, ...)
@@ -138,6 +139,23 @@ _mesa_delete_shader(struct gl_context *, struct gl_shader *sh)
    ralloc_free(sh);
 }
 
+struct gl_program *
+_mesa_new_linked_program(struct gl_context *ctx,
+                         struct gl_shader_program *shProg,
+                         gl_shader_stage stage)
+{
+   return ctx->Driver.NewProgram(ctx, _mesa_shader_stage_to_program(stage),
+                                 shProg->Name, false);
+}
+
+struct util_queue *
+_mesa_get_shader_compiler_queue(struct gl_context *ctx)
+{
+   /* The standalone compiler never starts the queue itself. */
+   return util_queue_is_initialized(&ctx->ShaderCompilerQueue) ?
+      &ctx->ShaderCompilerQueue : NULL;
+}
+
 void
 _mesa_delete_linked_shader(struct gl_context *,
                            struct gl_linked_shader *sh)
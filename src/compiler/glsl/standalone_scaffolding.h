@@ -59,6 +59,14 @@ _mesa_new_shader(GLuint name, gl_shader_stage stage);
 extern "C" void
 _mesa_delete_shader(struct gl_context *ctx, struct gl_shader *sh);
 
+extern "C" struct gl_program *
+_mesa_new_linked_program(struct gl_context *ctx,
+                         struct gl_shader_program *shProg,
+                         gl_shader_stage stage);
+
+extern "C" struct util_queue *
+_mesa_get_shader_compiler_queue(struct gl_context *ctx);
+
 extern "C" void
 _mesa_delete_linked_shader(struct gl_context *ctx,
                            struct gl_linked_shader *sh);
@@ -0,0 +1,79 @@
+/*
+ * Copyright © 2019 VMware, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include "compiler/blob.h"
+#include "compiler/glsl_types.h"
+#include "ir.h"
+#include "builtin_functions.h"
+
+extern const uint32_t _mesa_glsl_builtin_library[];
+extern const unsigned _mesa_glsl_builtin_library_size;
+
+class builtin_library : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+};
+
+void
+builtin_library::SetUp()
+{
+   glsl_type_singleton_init_or_ref();
+}
+
+void
+builtin_library::TearDown()
+{
+   glsl_type_singleton_decref();
+}
+
+/**
+ * Serialize every built-in signature, and check that what is read back
+ * prints the same as the IR built by ir_builder and validates.
+ */
+TEST_F(builtin_library, round_trip)
+{
+   struct blob blob;
+
+   blob_init(&blob);
+   _mesa_glsl_write_builtin_library(&blob);
+   ASSERT_FALSE(blob.out_of_memory);
+
+   EXPECT_TRUE(_mesa_glsl_check_builtin_library((const uint32_t *) blob.data,
+                                                blob.size));
+
+   blob_finish(&blob);
+}
+
+/**
+ * Check the library generated at build time, which is what the compiler
+ * actually loads.  Builds that can't run the generator link an empty one.
+ */
+TEST_F(builtin_library, generated_library)
+{
+   if (_mesa_glsl_builtin_library_size == 0)
+      return;
+
+   EXPECT_TRUE(_mesa_glsl_check_builtin_library(_mesa_glsl_builtin_library,
+                                                _mesa_glsl_builtin_library_size));
+}
@@ -29,7 +29,7 @@
 #include "util/u_string.h"
 
 
-mtx_t glsl_type::hash_mutex = _MTX_INITIALIZER_NP;
+simple_mtx_t glsl_type::hash_mutex = _SIMPLE_MTX_INITIALIZER_NP;
 hash_table *glsl_type::explicit_matrix_types = NULL;
 hash_table *glsl_type::array_types = NULL;
 hash_table *glsl_type::struct_types = NULL;
@@ -477,21 +477,21 @@ hash_free_type_function(struct hash_entry *entry)
 void
 glsl_type_singleton_init_or_ref()
 {
-   mtx_lock(&glsl_type::hash_mutex);
+   simple_mtx_lock(&glsl_type::hash_mutex);
    glsl_type_users++;
-   mtx_unlock(&glsl_type::hash_mutex);
+   simple_mtx_unlock(&glsl_type::hash_mutex);
 }
 
 void
 glsl_type_singleton_decref()
 {
-   mtx_lock(&glsl_type::hash_mutex);
+   simple_mtx_lock(&glsl_type::hash_mutex);
 
    assert(glsl_type_users > 0);
 
    /* Do not release glsl_types if they are still used. */
    if (--glsl_type_users) {
-      mtx_unlock(&glsl_type::hash_mutex);
+      simple_mtx_unlock(&glsl_type::hash_mutex);
       return;
    }
 
@@ -526,7 +526,7 @@ glsl_type_singleton_decref()
       glsl_type::subroutine_types = NULL;
    }
 
-   mtx_unlock(&glsl_type::hash_mutex);
+   simple_mtx_unlock(&glsl_type::hash_mutex);
 }
 
 
@@ -638,7 +638,7 @@ glsl_type::get_instance(unsigned base_type, unsigned rows, unsigned columns,
       util_snprintf(name, sizeof(name), "%sx%uB%s", bare_type->name,
                     explicit_stride, row_major ? "RM" : "");
 
-      mtx_lock(&glsl_type::hash_mutex);
+      simple_mtx_lock(&glsl_type::hash_mutex);
 
       if (explicit_matrix_types == NULL) {
          explicit_matrix_types =
@@ -663,7 +663,7 @@ glsl_type::get_instance(unsigned base_type, unsigned rows, unsigned columns,
       assert(((glsl_type *) entry->data)->matrix_columns == columns);
       assert(((glsl_type *) entry->data)->explicit_stride == explicit_stride);
 
-      mtx_unlock(&glsl_type::hash_mutex);
+      simple_mtx_unlock(&glsl_type::hash_mutex);
 
       return (const glsl_type *) entry->data;
    }
@@ -1003,7 +1003,7 @@ glsl_type::get_array_instance(const glsl_type *base,
    util_snprintf(key, sizeof(key), "%p[%u]x%uB", (void *) base, array_size,
                  explicit_stride);
 
-   mtx_lock(&glsl_type::hash_mutex);
+   simple_mtx_lock(&glsl_type::hash_mutex);
 
    if (array_types == NULL) {
       array_types = _mesa_hash_table_create(NULL, _mesa_key_hash_string,
@@ -1023,7 +1023,7 @@ glsl_type::get_array_instance(const glsl_type *base,
    assert(((glsl_type *) entry->data)->length == array_size);
    assert(((glsl_type *) entry->data)->fields.array == base);
 
-   mtx_unlock(&glsl_type::hash_mutex);
+   simple_mtx_unlock(&glsl_type::hash_mutex);
 
    return (glsl_type *) entry->data;
 }
@@ -1165,7 +1165,7 @@ glsl_type::get_struct_instance(const glsl_struct_field *fields,
 {
    const glsl_type key(fields, num_fields, name, packed);
 
-   mtx_lock(&glsl_type::hash_mutex);
+   simple_mtx_lock(&glsl_type::hash_mutex);
 
    if (struct_types == NULL) {
       struct_types = _mesa_hash_table_create(NULL, record_key_hash,
@@ -1185,7 +1185,7 @@ glsl_type::get_struct_instance(const glsl_struct_field *fields,
    assert(strcmp(((glsl_type *) entry->data)->name, name) == 0);
    assert(((glsl_type *) entry->data)->packed == packed);
 
-   mtx_unlock(&glsl_type::hash_mutex);
+   simple_mtx_unlock(&glsl_type::hash_mutex);
 
    return (glsl_type *) entry->data;
 }
@@ -1200,7 +1200,7 @@ glsl_type::get_interface_instance(const glsl_struct_field *fields,
 {
    const glsl_type key(fields, num_fields, packing, row_major, block_name);
 
-   mtx_lock(&glsl_type::hash_mutex);
+   simple_mtx_lock(&glsl_type::hash_mutex);
 
    if (interface_types == NULL) {
       interface_types = _mesa_hash_table_create(NULL, record_key_hash,
@@ -1220,7 +1220,7 @@ glsl_type::get_interface_instance(const glsl_struct_field *fields,
    assert(((glsl_type *) entry->data)->length == num_fields);
    assert(strcmp(((glsl_type *) entry->data)->name, block_name) == 0);
 
-   mtx_unlock(&glsl_type::hash_mutex);
+   simple_mtx_unlock(&glsl_type::hash_mutex);
 
    return (glsl_type *) entry->data;
 }
@@ -1230,7 +1230,7 @@ glsl_type::get_subroutine_instance(const char *subroutine_name)
 {
    const glsl_type key(subroutine_name);
 
-   mtx_lock(&glsl_type::hash_mutex);
+   simple_mtx_lock(&glsl_type::hash_mutex);
 
    if (subroutine_types == NULL) {
       subroutine_types = _mesa_hash_table_create(NULL, record_key_hash,
@@ -1248,7 +1248,7 @@ glsl_type::get_subroutine_instance(const char *subroutine_name)
    assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_SUBROUTINE);
    assert(strcmp(((glsl_type *) entry->data)->name, subroutine_name) == 0);
 
-   mtx_unlock(&glsl_type::hash_mutex);
+   simple_mtx_unlock(&glsl_type::hash_mutex);
 
    return (glsl_type *) entry->data;
 }
@@ -1283,7 +1283,7 @@ glsl_type::get_function_instance(const glsl_type *return_type,
 {
    const glsl_type key(return_type, params, num_params);
 
-   mtx_lock(&glsl_type::hash_mutex);
+   simple_mtx_lock(&glsl_type::hash_mutex);
 
    if (function_types == NULL) {
       function_types = _mesa_hash_table_create(NULL, function_key_hash,
@@ -1302,7 +1302,7 @@ glsl_type::get_function_instance(const glsl_type *return_type,
    assert(t->base_type == GLSL_TYPE_FUNCTION);
    assert(t->length == num_params);
 
-   mtx_unlock(&glsl_type::hash_mutex);
+   simple_mtx_unlock(&glsl_type::hash_mutex);
 
    return t;
 }
@@ -30,8 +30,8 @@
 
 #include "shader_enums.h"
 #include "blob.h"
-#include "c11/threads.h"
 #include "util/macros.h"
+#include "util/simple_mtx.h"
 
 #ifdef __cplusplus
 #include "main/config.h"
@@ -992,7 +992,7 @@ public:
 
 private:
 
-   static mtx_t hash_mutex;
+   static simple_mtx_t hash_mutex;
 
    /**
     * ralloc context for the type itself.
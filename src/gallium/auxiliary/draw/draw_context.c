@@ -340,6 +340,27 @@ void draw_set_driver_clipping( struct draw_context *draw,
 }
 
 
+/**
+ * Install callbacks used to look up and store the machine code of jitted
+ * vertex/geometry shader variants in a persistent (disk) cache.
+ * The cookie is passed back to the callbacks.
+ */
+void
+draw_set_disk_cache_callbacks(struct draw_context *draw,
+                              void *data_cookie,
+                              void (*find_shader)(void *cookie,
+                                                  struct lp_cached_code *cache,
+                                                  unsigned char ir_sha1_cache_key[20]),
+                              void (*insert_shader)(void *cookie,
+                                                    struct lp_cached_code *cache,
+                                                    unsigned char ir_sha1_cache_key[20]))
+{
+   draw->disk_cache_find_shader = find_shader;
+   draw->disk_cache_insert_shader = insert_shader;
+   draw->disk_cache_cookie = data_cookie;
+}
+
+
 /** 
  * Plug in the primitive rendering/rasterization stage (which is the last
  * stage in the drawing pipeline).
@@ -1088,6 +1109,21 @@ draw_collect_pipeline_statistics(struct draw_context *draw,
    draw->collect_statistics = enable;
 }
 
+/**
+ * Returns how many indices the indexed draws so far had, and how many
+ * vertices were shaded for them.  Each unique vertex being shaded once
+ * would be ideal; the excess is the vertex shading amplification of the
+ * post-transform vertex cache and of the splitting into segments.
+ */
+void
+draw_get_vertex_cache_stats(const struct draw_context *draw,
+                            uint64_t *num_indices,
+                            uint64_t *num_shaded)
+{
+   *num_indices = draw->pt.vcache_stats.num_indices;
+   *num_shaded = draw->pt.vcache_stats.num_shaded;
+}
+
 /**
  * Computes clipper invocation statistics.
  *
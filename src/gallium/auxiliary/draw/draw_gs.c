@@ -31,6 +31,8 @@
 #include "draw_context.h"
 #ifdef HAVE_LLVM
 #include "draw_llvm.h"
+#include "gallivm/lp_bld_nir.h"
+#include "nir/nir_to_tgsi_info.h"
 #endif
 
 #include "tgsi/tgsi_parse.h"
@@ -41,6 +43,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/ralloc.h"
 
 /* fixme: move it from here */
 #define MAX_PRIMITIVES 64
@@ -198,7 +201,7 @@ static void tgsi_gs_prepare(struct draw_geometry_shader *shader,
 
    if (shader->info.uses_invocationid) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_INVOCATIONID];
-      for (j = 0; j < TGSI_QUAD_SIZE; j++)
+      for (j = 0; j < TGSI_EXEC_WIDTH; j++)
          machine->SystemValue[i].xyzw[0].i[j] = shader->invocation_id;
    }
 }
@@ -793,13 +796,24 @@ draw_create_geometry_shader(struct draw_context *draw,
 
    gs->draw = draw;
    gs->state = *state;
-   gs->state.tokens = tgsi_dup_tokens(state->tokens);
-   if (!gs->state.tokens) {
-      FREE(gs);
-      return NULL;
-   }
 
-   tgsi_scan_shader(state->tokens, &gs->info);
+#ifdef HAVE_LLVM
+   if (state->type == PIPE_SHADER_IR_NIR) {
+      /* only the llvm path can run NIR; the shader now owns it */
+      assert(use_llvm);
+      lp_build_opt_nir(state->ir.nir);
+      nir_tgsi_scan_shader(state->ir.nir, &gs->info, false);
+   } else
+#endif
+   {
+      gs->state.tokens = tgsi_dup_tokens(state->tokens);
+      if (!gs->state.tokens) {
+         FREE(gs);
+         return NULL;
+      }
+
+      tgsi_scan_shader(state->tokens, &gs->info);
+   }
 
    /* setup the defaults */
    gs->max_out_prims = 0;
@@ -951,7 +965,11 @@ void draw_delete_geometry_shader(struct draw_context *draw,
 
    for (i = 0; i < TGSI_MAX_VERTEX_STREAMS; i++)
       FREE(dgs->stream[i].primitive_lengths);
-   FREE((void*) dgs->state.tokens);
+
+   if (dgs->state.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(dgs->state.ir.nir);
+   else
+      FREE((void*) dgs->state.tokens);
    FREE(dgs);
 }
 
@@ -43,6 +43,7 @@
 #include "gallivm/lp_bld_flow.h"
 #include "gallivm/lp_bld_debug.h"
 #include "gallivm/lp_bld_tgsi.h"
+#include "gallivm/lp_bld_nir.h"
 #include "gallivm/lp_bld_printf.h"
 #include "gallivm/lp_bld_intr.h"
 #include "gallivm/lp_bld_init.h"
@@ -52,11 +53,15 @@
 
 #include "tgsi/tgsi_exec.h"
 #include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
+
+#include "compiler/nir/nir.h"
 
 #include "util/u_math.h"
 #include "util/u_pointer.h"
 #include "util/u_string.h"
 #include "util/simple_list.h"
+#include "util/mesa-sha1.h"
 
 
 #define DEBUG_STORE 0
@@ -539,6 +544,46 @@ draw_llvm_destroy(struct draw_llvm *llvm)
 }
 
 
+/**
+ * Compute the disk cache key of a vertex or geometry shader variant, from
+ * the shader IR, the vertex header size and the variant key.
+ */
+static void
+draw_get_ir_cache_key(const struct pipe_shader_state *state,
+                      const void *key,
+                      size_t key_size,
+                      unsigned num_vertex_attribs,
+                      unsigned char ir_sha1_cache_key[20])
+{
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, key, key_size);
+   _mesa_sha1_update(&ctx, &num_vertex_attribs, sizeof(num_vertex_attribs));
+   if (state->type == PIPE_SHADER_IR_NIR) {
+      unsigned char nir_sha1[20];
+      lp_build_nir_sha1(state->ir.nir, nir_sha1);
+      _mesa_sha1_update(&ctx, nir_sha1, sizeof(nir_sha1));
+   }
+   else {
+      _mesa_sha1_update(&ctx, state->tokens,
+                        tgsi_num_tokens(state->tokens) *
+                        sizeof(struct tgsi_token));
+   }
+   _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+}
+
+
+static void
+draw_dump_shader_ir(const struct pipe_shader_state *state)
+{
+   if (state->type == PIPE_SHADER_IR_NIR)
+      nir_print_shader(state->ir.nir, stderr);
+   else
+      tgsi_dump(state->tokens, 0);
+}
+
+
 /**
  * Create LLVM-generated code for a vertex shader.
  */
@@ -552,6 +597,9 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
       llvm_vertex_shader(llvm->draw->vs.vertex_shader);
    LLVMTypeRef vertex_header;
    char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   boolean needs_caching = FALSE;
 
    variant = MALLOC(sizeof *variant +
                     shader->variant_key_size -
@@ -565,14 +613,24 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
    util_snprintf(module_name, sizeof(module_name), "draw_llvm_vs_variant%u",
                  variant->shader->variants_cached);
 
-   variant->gallivm = gallivm_create(module_name, llvm->context);
+   if (llvm->draw->disk_cache_find_shader) {
+      draw_get_ir_cache_key(&shader->base.state,
+                            key, shader->variant_key_size, num_inputs,
+                            ir_sha1_cache_key);
+      llvm->draw->disk_cache_find_shader(llvm->draw->disk_cache_cookie,
+                                         &cached, ir_sha1_cache_key);
+      if (!cached.data_size)
+         needs_caching = TRUE;
+   }
+
+   variant->gallivm = gallivm_create(module_name, llvm->context, &cached);
 
    create_jit_types(variant);
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
    if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
-      tgsi_dump(llvm->draw->vs.vertex_shader->state.tokens, 0);
+      draw_dump_shader_ir(&llvm->draw->vs.vertex_shader->state);
       draw_llvm_dump_variant_key(&variant->key);
    }
 
@@ -587,6 +645,10 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
    variant->jit_func = (draw_jit_vert_func)
          gallivm_jit_function(variant->gallivm, variant->function);
 
+   if (needs_caching)
+      llvm->draw->disk_cache_insert_shader(llvm->draw->disk_cache_cookie,
+                                           &cached, ir_sha1_cache_key);
+
    gallivm_free_ir(variant->gallivm);
 
    variant->list_item_global.base = variant;
@@ -610,26 +672,44 @@ generate_vs(struct draw_llvm_variant *variant,
             boolean clamp_vertex_color)
 {
    struct draw_llvm *llvm = variant->llvm;
-   const struct tgsi_token *tokens = llvm->draw->vs.vertex_shader->state.tokens;
+   const struct pipe_shader_state *state = &llvm->draw->vs.vertex_shader->state;
    LLVMValueRef consts_ptr =
       draw_jit_context_vs_constants(variant->gallivm, context_ptr);
    LLVMValueRef num_consts_ptr =
       draw_jit_context_num_vs_constants(variant->gallivm, context_ptr);
 
-   lp_build_tgsi_soa(variant->gallivm,
-                     tokens,
-                     vs_type,
-                     NULL /*struct lp_build_mask_context *mask*/,
-                     consts_ptr,
-                     num_consts_ptr,
-                     system_values,
-                     inputs,
-                     outputs,
-                     context_ptr,
-                     NULL,
-                     draw_sampler,
-                     &llvm->draw->vs.vertex_shader->info,
-                     NULL);
+   if (state->type == PIPE_SHADER_IR_NIR)
+      lp_build_nir_soa(variant->gallivm,
+                       state->ir.nir,
+                       vs_type,
+                       NULL /*struct lp_build_mask_context *mask*/,
+                       consts_ptr,
+                       num_consts_ptr,
+                       system_values,
+                       inputs,
+                       outputs,
+                       context_ptr,
+                       NULL,
+                       draw_sampler,
+                       &llvm->draw->vs.vertex_shader->info,
+                       NULL,
+                       NULL);
+   else
+      lp_build_tgsi_soa(variant->gallivm,
+                        state->tokens,
+                        vs_type,
+                        NULL /*struct lp_build_mask_context *mask*/,
+                        consts_ptr,
+                        num_consts_ptr,
+                        system_values,
+                        inputs,
+                        outputs,
+                        context_ptr,
+                        NULL,
+                        draw_sampler,
+                        &llvm->draw->vs.vertex_shader->info,
+                        NULL,
+                        NULL);
 
    {
       LLVMValueRef out;
@@ -1198,11 +1278,19 @@ generate_clipmask(struct draw_llvm *llvm,
     * comparisons here).
     */
    /* Cliptest, for hardwired planes */
-   /*
-    * XXX should take guardband into account (currently not in key).
-    * Otherwise might run the draw pipeline stages for nothing.
-    */
    if (key->clip_xy) {
+      /*
+       * With a guard band only the vertices outside twice the viewport
+       * need clipping, matching draw_pt_post_vs.c and the planes it sets.
+       * Otherwise any vertex just off screen would send the whole draw
+       * through the pipeline stages.
+       */
+      if (key->guard_band_xy) {
+         LLVMValueRef half = lp_build_const_vec(gallivm, f32_type, 0.5);
+         pos_x = LLVMBuildFMul(builder, pos_x, half, "");
+         pos_y = LLVMBuildFMul(builder, pos_y, half, "");
+      }
+
       /* plane 1 */
       test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_GREATER, pos_x , pos_w);
       temp = shift;
@@ -1377,7 +1465,7 @@ clipmask_booli8(struct gallivm_state *gallivm,
 
 static LLVMValueRef
 draw_gs_llvm_fetch_input(const struct lp_build_tgsi_gs_iface *gs_iface,
-                         struct lp_build_tgsi_context * bld_base,
+                         struct lp_build_context * bld,
                          boolean is_vindex_indirect,
                          LLVMValueRef vertex_index,
                          boolean is_aindex_indirect,
@@ -1385,15 +1473,15 @@ draw_gs_llvm_fetch_input(const struct lp_build_tgsi_gs_iface *gs_iface,
                          LLVMValueRef swizzle_index)
 {
    const struct draw_gs_llvm_iface *gs = draw_gs_llvm_iface(gs_iface);
-   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   struct gallivm_state *gallivm = bld->gallivm;
    LLVMBuilderRef builder = gallivm->builder;
    LLVMValueRef indices[3];
    LLVMValueRef res;
-   struct lp_type type = bld_base->base.type;
+   struct lp_type type = bld->type;
 
    if (is_vindex_indirect || is_aindex_indirect) {
       int i;
-      res = bld_base->base.zero;
+      res = bld->zero;
       for (i = 0; i < type.length; ++i) {
          LLVMValueRef idx = lp_build_const_int32(gallivm, i);
          LLVMValueRef vert_chan_index = vertex_index;
@@ -1433,7 +1521,7 @@ draw_gs_llvm_fetch_input(const struct lp_build_tgsi_gs_iface *gs_iface,
 
 static void
 draw_gs_llvm_emit_vertex(const struct lp_build_tgsi_gs_iface *gs_base,
-                         struct lp_build_tgsi_context * bld_base,
+                         struct lp_build_context * bld,
                          LLVMValueRef (*outputs)[4],
                          LLVMValueRef emitted_vertices_vec)
 {
@@ -1441,7 +1529,7 @@ draw_gs_llvm_emit_vertex(const struct lp_build_tgsi_gs_iface *gs_base,
    struct draw_gs_llvm_variant *variant = gs_iface->variant;
    struct gallivm_state *gallivm = variant->gallivm;
    LLVMBuilderRef builder = gallivm->builder;
-   struct lp_type gs_type = bld_base->base.type;
+   struct lp_type gs_type = bld->type;
    LLVMValueRef clipmask = lp_build_const_int_vec(gallivm,
                                                   lp_int_type(gs_type), 0);
    LLVMValueRef indices[LP_MAX_VECTOR_LENGTH];
@@ -1467,7 +1555,7 @@ draw_gs_llvm_emit_vertex(const struct lp_build_tgsi_gs_iface *gs_base,
 
 static void
 draw_gs_llvm_end_primitive(const struct lp_build_tgsi_gs_iface *gs_base,
-                           struct lp_build_tgsi_context * bld_base,
+                           struct lp_build_context * bld,
                            LLVMValueRef verts_per_prim_vec,
                            LLVMValueRef emitted_prims_vec)
 {
@@ -1479,7 +1567,7 @@ draw_gs_llvm_end_primitive(const struct lp_build_tgsi_gs_iface *gs_base,
       draw_gs_jit_prim_lengths(variant->gallivm, variant->context_ptr);
    unsigned i;
 
-   for (i = 0; i < bld_base->base.type.length; ++i) {
+   for (i = 0; i < bld->type.length; ++i) {
       LLVMValueRef ind = lp_build_const_int32(gallivm, i);
       LLVMValueRef prims_emitted =
          LLVMBuildExtractElement(builder, emitted_prims_vec, ind, "");
@@ -1496,7 +1584,7 @@ draw_gs_llvm_end_primitive(const struct lp_build_tgsi_gs_iface *gs_base,
 
 static void
 draw_gs_llvm_epilogue(const struct lp_build_tgsi_gs_iface *gs_base,
-                      struct lp_build_tgsi_context * bld_base,
+                      struct lp_build_context * bld,
                       LLVMValueRef total_emitted_vertices_vec,
                       LLVMValueRef emitted_prims_vec)
 {
@@ -1574,8 +1662,8 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant)
 
    memset(&system_values, 0, sizeof(system_values));
 
-   util_snprintf(func_name, sizeof(func_name), "draw_llvm_vs_variant%u",
-                 variant->shader->variants_cached);
+   /* Not numbered, so that it can be found in cached objects. */
+   util_snprintf(func_name, sizeof(func_name), "draw_llvm_vs_variant");
 
    i = 0;
    arg_types[i++] = get_context_ptr_type(variant);       /* context */
@@ -1980,6 +2068,9 @@ draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
    key->clip_user = llvm->draw->clip_user;
    key->bypass_viewport = llvm->draw->bypass_viewport;
    key->clip_halfz = llvm->draw->rasterizer->clip_halfz;
+   /* draw_pt_post_vs_prepare() only uses the guard band with halfz */
+   key->guard_band_xy = key->clip_xy && key->clip_halfz &&
+                        llvm->draw->guard_band_xy;
    /* XXX assumes edgeflag output not at 0 */
    key->need_edgeflags = (llvm->draw->vs.edgeflag_output ? TRUE : FALSE);
    key->ucp_enable = llvm->draw->rasterizer->clip_plane_enable;
@@ -2053,6 +2144,7 @@ draw_llvm_dump_variant_key(struct draw_llvm_variant_key *key)
    debug_printf("clip_user = %u\n", key->clip_user);
    debug_printf("bypass_viewport = %u\n", key->bypass_viewport);
    debug_printf("clip_halfz = %u\n", key->clip_halfz);
+   debug_printf("guard_band_xy = %u\n", key->guard_band_xy);
    debug_printf("need_edgeflags = %u\n", key->need_edgeflags);
    debug_printf("has_gs = %u\n", key->has_gs);
    debug_printf("ucp_enable = %u\n", key->ucp_enable);
@@ -2245,7 +2337,7 @@ draw_gs_llvm_generate(struct draw_llvm *llvm,
    struct lp_type gs_type;
    unsigned i;
    struct draw_gs_llvm_iface gs_iface;
-   const struct tgsi_token *tokens = variant->shader->base.state.tokens;
+   const struct pipe_shader_state *state = &variant->shader->base.state;
    LLVMValueRef consts_ptr, num_consts_ptr;
    LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
    struct lp_build_mask_context mask;
@@ -2254,8 +2346,8 @@ draw_gs_llvm_generate(struct draw_llvm *llvm,
 
    memset(&system_values, 0, sizeof(system_values));
 
-   util_snprintf(func_name, sizeof(func_name), "draw_llvm_gs_variant%u",
-                 variant->shader->variants_cached);
+   /* Not numbered, so that it can be found in cached objects. */
+   util_snprintf(func_name, sizeof(func_name), "draw_llvm_gs_variant");
 
    assert(variant->vertex_header_ptr_type);
 
@@ -2339,24 +2431,42 @@ draw_gs_llvm_generate(struct draw_llvm *llvm,
    }
 
    if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
-      tgsi_dump(tokens, 0);
+      draw_dump_shader_ir(state);
       draw_gs_llvm_dump_variant_key(&variant->key);
    }
 
-   lp_build_tgsi_soa(variant->gallivm,
-                     tokens,
-                     gs_type,
-                     &mask,
-                     consts_ptr,
-                     num_consts_ptr,
-                     &system_values,
-                     NULL,
-                     outputs,
-                     context_ptr,
-                     NULL,
-                     sampler,
-                     &llvm->draw->gs.geometry_shader->info,
-                     (const struct lp_build_tgsi_gs_iface *)&gs_iface);
+   if (state->type == PIPE_SHADER_IR_NIR)
+      lp_build_nir_soa(variant->gallivm,
+                       state->ir.nir,
+                       gs_type,
+                       &mask,
+                       consts_ptr,
+                       num_consts_ptr,
+                       &system_values,
+                       NULL,
+                       outputs,
+                       context_ptr,
+                       NULL,
+                       sampler,
+                       &llvm->draw->gs.geometry_shader->info,
+                       (const struct lp_build_tgsi_gs_iface *)&gs_iface,
+                       NULL);
+   else
+      lp_build_tgsi_soa(variant->gallivm,
+                        state->tokens,
+                        gs_type,
+                        &mask,
+                        consts_ptr,
+                        num_consts_ptr,
+                        &system_values,
+                        NULL,
+                        outputs,
+                        context_ptr,
+                        NULL,
+                        sampler,
+                        &llvm->draw->gs.geometry_shader->info,
+                        (const struct lp_build_tgsi_gs_iface *)&gs_iface,
+                        NULL);
 
    sampler->destroy(sampler);
 
@@ -2378,6 +2488,9 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
       llvm_geometry_shader(llvm->draw->gs.geometry_shader);
    LLVMTypeRef vertex_header;
    char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   boolean needs_caching = FALSE;
 
    variant = MALLOC(sizeof *variant +
                     shader->variant_key_size -
@@ -2391,7 +2504,17 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
    util_snprintf(module_name, sizeof(module_name), "draw_llvm_gs_variant%u",
                  variant->shader->variants_cached);
 
-   variant->gallivm = gallivm_create(module_name, llvm->context);
+   if (llvm->draw->disk_cache_find_shader) {
+      draw_get_ir_cache_key(&shader->base.state,
+                            key, shader->variant_key_size, num_outputs,
+                            ir_sha1_cache_key);
+      llvm->draw->disk_cache_find_shader(llvm->draw->disk_cache_cookie,
+                                         &cached, ir_sha1_cache_key);
+      if (!cached.data_size)
+         needs_caching = TRUE;
+   }
+
+   variant->gallivm = gallivm_create(module_name, llvm->context, &cached);
 
    create_gs_jit_types(variant);
 
@@ -2408,6 +2531,10 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
    variant->jit_func = (draw_gs_jit_func)
          gallivm_jit_function(variant->gallivm, variant->function);
 
+   if (needs_caching)
+      llvm->draw->disk_cache_insert_shader(llvm->draw->disk_cache_cookie,
+                                           &cached, ir_sha1_cache_key);
+
    gallivm_free_ir(variant->gallivm);
 
    variant->list_item_global.base = variant;
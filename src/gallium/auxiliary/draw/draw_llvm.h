@@ -298,6 +298,7 @@ struct draw_llvm_variant_key
    unsigned need_edgeflags:1;
    unsigned has_gs:1;
    unsigned num_outputs:8;
+   unsigned guard_band_xy:1;
    unsigned ucp_enable:PIPE_MAX_CLIP_PLANES;
    /* note padding here - must use memset */
 
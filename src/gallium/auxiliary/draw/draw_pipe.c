@@ -268,6 +268,9 @@ void draw_pipeline_run( struct draw_context *draw,
                     vert_info->count - 1);
    }
 
+   /* the clipper may hold triangles referencing these vertices */
+   draw_clip_flush_batch(draw->pipeline.clip);
+
    draw->pipeline.verts = NULL;
    draw->pipeline.vertex_count = 0;
 }
@@ -336,6 +339,9 @@ void draw_pipeline_run_linear( struct draw_context *draw,
                       (struct vertex_header*)verts,
                       vert_info->stride,
                       count);
+
+      /* the clipper may hold triangles referencing these vertices */
+      draw_clip_flush_batch(draw->pipeline.clip);
    }
 
    draw->pipeline.verts = NULL;
@@ -50,6 +50,22 @@ struct prim_header {
 
 
 
+/**
+ * A convex polygon made by the clipper, with its provoking vertex first.
+ * Its nr_new new vertices follow those of the previous polygon in memory.
+ */
+struct draw_poly {
+   struct vertex_header *v[4];
+   unsigned nr;
+   unsigned nr_new;
+};
+
+
+/* This is only used for temporary verts.
+ */
+#define MAX_VERTEX_SIZE ((2 + PIPE_MAX_SHADER_OUTPUTS) * 4 * sizeof(float))
+
+
 /**
  * Base class for all primitive drawing stages.
  */
@@ -95,7 +111,17 @@ extern struct draw_stage *draw_validate_stage( struct draw_context *context );
 extern void draw_free_temp_verts( struct draw_stage *stage );
 extern boolean draw_alloc_temp_verts( struct draw_stage *stage, unsigned nr );
 
-extern void draw_reset_vertex_ids( struct draw_context *draw );
+extern void draw_reset_vertex_ids( struct draw_context *draw,
+                                   struct vertex_header **emitted,
+                                   unsigned nr_emitted );
+
+extern void draw_clip_flush_batch( struct draw_stage *stage );
+
+extern boolean draw_vbuf_emit_polys( struct draw_stage *stage,
+                                     const struct draw_poly *polys,
+                                     unsigned nr_polys,
+                                     struct vertex_header *new_verts,
+                                     unsigned new_stride );
 
 void draw_pipe_passthrough_tri(struct draw_stage *stage, struct prim_header *header);
 void draw_pipe_passthrough_line(struct draw_stage *stage, struct prim_header *header);
@@ -44,6 +44,10 @@
 #include "tgsi/tgsi_transform.h"
 #include "tgsi/tgsi_dump.h"
 
+#include "nir/nir_draw_helpers.h"
+#include "compiler/nir/nir.h"
+#include "util/ralloc.h"
+
 #include "draw_context.h"
 #include "draw_private.h"
 #include "draw_pipe.h"
@@ -265,6 +269,37 @@ aa_transform_inst(struct tgsi_transform_context *ctx,
 }
 
 
+/**
+ * Generate the frag shader we'll use for drawing AA lines from a NIR
+ * shader.  The driver takes ownership of the NIR, so transform a copy.
+ */
+static boolean
+generate_aaline_fs_nir(struct aaline_stage *aaline)
+{
+   struct pipe_context *pipe = aaline->stage.draw->pipe;
+   const struct pipe_shader_state *orig_fs = &aaline->fs->state;
+   struct pipe_shader_state aaline_fs;
+   unsigned generic_attrib;
+
+   aaline_fs = *orig_fs; /* copy to init */
+   aaline_fs.ir.nir = nir_shader_clone(NULL, orig_fs->ir.nir);
+   if (!aaline_fs.ir.nir)
+      return FALSE;
+
+   if (!nir_lower_aaline_fs(aaline_fs.ir.nir, &generic_attrib)) {
+      ralloc_free(aaline_fs.ir.nir);
+      return FALSE;
+   }
+
+   aaline->fs->aaline_fs = aaline->driver_create_fs_state(pipe, &aaline_fs);
+   if (aaline->fs->aaline_fs == NULL)
+      return FALSE;
+
+   aaline->fs->generic_attrib = generic_attrib;
+   return TRUE;
+}
+
+
 /**
  * Generate the frag shader we'll use for drawing AA lines.
  * This will be the user's shader plus some arithmetic instructions.
@@ -276,7 +311,12 @@ generate_aaline_fs(struct aaline_stage *aaline)
    const struct pipe_shader_state *orig_fs = &aaline->fs->state;
    struct pipe_shader_state aaline_fs;
    struct aa_transform_context transform;
-   const uint newLen = tgsi_num_tokens(orig_fs->tokens) + NUM_NEW_TOKENS;
+   uint newLen;
+
+   if (orig_fs->type == PIPE_SHADER_IR_NIR)
+      return generate_aaline_fs_nir(aaline);
+
+   newLen = tgsi_num_tokens(orig_fs->tokens) + NUM_NEW_TOKENS;
 
    aaline_fs = *orig_fs; /* copy to init */
    aaline_fs.tokens = tgsi_alloc_tokens(newLen);
@@ -618,7 +658,11 @@ aaline_create_fs_state(struct pipe_context *pipe,
    if (!aafs)
       return NULL;
 
-   aafs->state.tokens = tgsi_dup_tokens(fs->tokens);
+   aafs->state.type = fs->type;
+   if (fs->type == PIPE_SHADER_IR_TGSI)
+      aafs->state.tokens = tgsi_dup_tokens(fs->tokens);
+   else
+      aafs->state.ir.nir = nir_shader_clone(NULL, fs->ir.nir);
 
    /* pass-through */
    aafs->driver_fs = aaline->driver_create_fs_state(pipe, fs);
@@ -662,7 +706,10 @@ aaline_delete_fs_state(struct pipe_context *pipe, void *fs)
          aaline->driver_delete_fs_state(pipe, aafs->aaline_fs);
    }
 
-   FREE((void*)aafs->state.tokens);
+   if (aafs->state.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(aafs->state.ir.nir);
+   else
+      FREE((void*)aafs->state.tokens);
    FREE(aafs);
 }
 
@@ -48,6 +48,10 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 
+#include "nir/nir_draw_helpers.h"
+#include "compiler/nir/nir.h"
+#include "util/ralloc.h"
+
 #include "draw_context.h"
 #include "draw_vs.h"
 #include "draw_pipe.h"
@@ -350,6 +354,38 @@ aa_transform_inst(struct tgsi_transform_context *ctx,
 }
 
 
+/**
+ * Generate the frag shader we'll use for drawing AA points from a NIR
+ * shader.  The driver takes ownership of the NIR, so transform a copy.
+ */
+static boolean
+generate_aapoint_fs_nir(struct aapoint_stage *aapoint)
+{
+   struct pipe_context *pipe = aapoint->stage.draw->pipe;
+   const struct pipe_shader_state *orig_fs = &aapoint->fs->state;
+   struct pipe_shader_state aapoint_fs;
+   unsigned generic_attrib;
+
+   aapoint_fs = *orig_fs; /* copy to init */
+   aapoint_fs.ir.nir = nir_shader_clone(NULL, orig_fs->ir.nir);
+   if (!aapoint_fs.ir.nir)
+      return FALSE;
+
+   if (!nir_lower_aapoint_fs(aapoint_fs.ir.nir, &generic_attrib)) {
+      ralloc_free(aapoint_fs.ir.nir);
+      return FALSE;
+   }
+
+   aapoint->fs->aapoint_fs
+      = aapoint->driver_create_fs_state(pipe, &aapoint_fs);
+   if (aapoint->fs->aapoint_fs == NULL)
+      return FALSE;
+
+   aapoint->fs->generic_attrib = generic_attrib;
+   return TRUE;
+}
+
+
 /**
  * Generate the frag shader we'll use for drawing AA points.
  * This will be the user's shader plus some texture/modulate instructions.
@@ -360,8 +396,13 @@ generate_aapoint_fs(struct aapoint_stage *aapoint)
    const struct pipe_shader_state *orig_fs = &aapoint->fs->state;
    struct pipe_shader_state aapoint_fs;
    struct aa_transform_context transform;
-   const uint newLen = tgsi_num_tokens(orig_fs->tokens) + NUM_NEW_TOKENS;
    struct pipe_context *pipe = aapoint->stage.draw->pipe;
+   uint newLen;
+
+   if (orig_fs->type == PIPE_SHADER_IR_NIR)
+      return generate_aapoint_fs_nir(aapoint);
+
+   newLen = tgsi_num_tokens(orig_fs->tokens) + NUM_NEW_TOKENS;
 
    aapoint_fs = *orig_fs; /* copy to init */
    aapoint_fs.tokens = tgsi_alloc_tokens(newLen);
@@ -558,7 +599,11 @@ aapoint_first_point(struct draw_stage *stage, struct prim_header *header)
    /*
     * Bind (generate) our fragprog.
     */
-   bind_aapoint_fragment_shader(aapoint);
+   if (!bind_aapoint_fragment_shader(aapoint)) {
+      stage->point = draw_pipe_passthrough_point;
+      stage->point(stage, header);
+      return;
+   }
 
    draw_aapoint_prepare_outputs(draw, draw->pipeline.aapoint);
 
@@ -710,7 +755,11 @@ aapoint_create_fs_state(struct pipe_context *pipe,
    if (!aafs)
       return NULL;
 
-   aafs->state.tokens = tgsi_dup_tokens(fs->tokens);
+   aafs->state.type = fs->type;
+   if (fs->type == PIPE_SHADER_IR_TGSI)
+      aafs->state.tokens = tgsi_dup_tokens(fs->tokens);
+   else
+      aafs->state.ir.nir = nir_shader_clone(NULL, fs->ir.nir);
 
    /* pass-through */
    aafs->driver_fs = aapoint->driver_create_fs_state(pipe, fs);
@@ -744,7 +793,10 @@ aapoint_delete_fs_state(struct pipe_context *pipe, void *fs)
    if (aafs->aapoint_fs)
       aapoint->driver_delete_fs_state(pipe, aafs->aapoint_fs);
 
-   FREE((void*)aafs->state.tokens);
+   if (aafs->state.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(aafs->state.ir.nir);
+   else
+      FREE((void*)aafs->state.tokens);
 
    FREE(aafs);
 }
@@ -35,6 +35,7 @@
 #include "util/u_bitcast.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
+#include "util/u_sse.h"
 
 #include "pipe/p_shader_tokens.h"
 
@@ -49,6 +50,12 @@
 
 #define MAX_CLIPPED_VERTICES ((2 * (6 + PIPE_MAX_CLIP_PLANES))+1)
 
+/** Triangles crossing a single plane which are clipped together */
+#define CLIP_BATCH_SIZE 16
+
+/** Each can make two vertices on the plane, and a flat shaded copy */
+#define CLIP_BATCH_VERTICES (3 * CLIP_BATCH_SIZE)
+
 
 
 struct clip_stage {
@@ -69,6 +76,16 @@ struct clip_stage {
    uint8_t perspect_attribs[PIPE_MAX_SHADER_OUTPUTS];
 
    float (*plane)[4];
+
+   /* Triangles waiting to be clipped by clip_flush_batch(), which must
+    * run before any other primitive goes through.
+    */
+   struct prim_header batch[CLIP_BATCH_SIZE];
+   ubyte batch_plane[CLIP_BATCH_SIZE];
+   unsigned batch_nr;
+
+   /** Distance between the vertices the batch makes, packed to stay in cache */
+   unsigned batch_stride;
 };
 
 
@@ -97,17 +114,26 @@ draw_viewport_index(struct draw_context *draw,
 #define LINTERP(T, OUT, IN) ((OUT) + (T) * ((IN) - (OUT)))
 
 
-/* All attributes are float[4], so this is easy:
+/* All attributes are float[4], so this is easy, and a single SSE
+ * operation when available.  The attributes follow the 4 byte vertex
+ * header bits, so they are not 16 byte aligned.
  */
-static void interp_attr(float dst[4],
-                        float t,
-                        const float in[4],
-                        const float out[4])
+static inline void interp_attr(float dst[4],
+                               float t,
+                               const float in[4],
+                               const float out[4])
 {
+#if defined(PIPE_ARCH_SSE)
+   const __m128 o = _mm_loadu_ps(out);
+   const __m128 d = _mm_sub_ps(_mm_loadu_ps(in), o);
+
+   _mm_storeu_ps(dst, _mm_add_ps(o, _mm_mul_ps(_mm_set1_ps(t), d)));
+#else
    dst[0] = LINTERP( t, out[0], in[0] );
    dst[1] = LINTERP( t, out[1], in[1] );
    dst[2] = LINTERP( t, out[2], in[2] );
    dst[3] = LINTERP( t, out[3], in[3] );
+#endif
 }
 
 
@@ -126,16 +152,15 @@ static void copy_flat(struct draw_stage *stage,
    }
 }
 
-/* Interpolate between two vertices to produce a third.  
+/* Interpolate the attributes other than the window position, once the
+ * clip-space position of the new vertex is known.
  */
-static void interp(const struct clip_stage *clip,
-                   struct vertex_header *dst,
-                   float t,
-                   const struct vertex_header *out,
-                   const struct vertex_header *in,
-                   unsigned viewport_index)
+static void interp_attribs(const struct clip_stage *clip,
+                           struct vertex_header *dst,
+                           float t,
+                           const struct vertex_header *out,
+                           const struct vertex_header *in)
 {
-   const unsigned pos_attr = clip->pos_attr;
    unsigned j;
    float t_nopersp;
 
@@ -152,26 +177,6 @@ static void interp(const struct clip_stage *clip,
       interp_attr(dst->data[clip->cv_attr], t,
                   in->data[clip->cv_attr], out->data[clip->cv_attr]);
    }
-   /* interpolate the clip-space position */
-   interp_attr(dst->clip_pos, t, in->clip_pos, out->clip_pos);
-
-   /* Do the projective divide and viewport transformation to get
-    * new window coordinates:
-    */
-   {
-      const float *pos = dst->clip_pos;
-      const float *scale =
-         clip->stage.draw->viewports[viewport_index].scale;
-      const float *trans =
-         clip->stage.draw->viewports[viewport_index].translate;
-      const float oow = 1.0f / pos[3];
-
-      dst->data[pos_attr][0] = pos[0] * oow * scale[0] + trans[0];
-      dst->data[pos_attr][1] = pos[1] * oow * scale[1] + trans[1];
-      dst->data[pos_attr][2] = pos[2] * oow * scale[2] + trans[2];
-      dst->data[pos_attr][3] = oow;
-   }
-   
 
    /* interp perspective attribs */
    for (j = 0; j < clip->num_perspect_attribs; j++) {
@@ -209,6 +214,40 @@ static void interp(const struct clip_stage *clip,
    }
 }
 
+/* Interpolate between two vertices to produce a third.
+ */
+static void interp(const struct clip_stage *clip,
+                   struct vertex_header *dst,
+                   float t,
+                   const struct vertex_header *out,
+                   const struct vertex_header *in,
+                   unsigned viewport_index)
+{
+   const unsigned pos_attr = clip->pos_attr;
+
+   /* interpolate the clip-space position */
+   interp_attr(dst->clip_pos, t, in->clip_pos, out->clip_pos);
+
+   /* Do the projective divide and viewport transformation to get
+    * new window coordinates:
+    */
+   {
+      const float *pos = dst->clip_pos;
+      const float *scale =
+         clip->stage.draw->viewports[viewport_index].scale;
+      const float *trans =
+         clip->stage.draw->viewports[viewport_index].translate;
+      const float oow = 1.0f / pos[3];
+
+      dst->data[pos_attr][0] = pos[0] * oow * scale[0] + trans[0];
+      dst->data[pos_attr][1] = pos[1] * oow * scale[1] + trans[1];
+      dst->data[pos_attr][2] = pos[2] * oow * scale[2] + trans[2];
+      dst->data[pos_attr][3] = oow;
+   }
+
+   interp_attribs(clip, dst, t, out, in);
+}
+
 /**
  * Emit a post-clip polygon to the next pipeline stage.  The polygon
  * will be convex and the provoking vertex will always be vertex[0].
@@ -340,6 +379,46 @@ static inline float getclipdist(const struct clip_stage *clipper,
    return dp;
 }
 
+/* If constant interpolated, copy provoking vertex attrib to polygon
+ * vertex[0], and emit the polygon as triangles to the next stage.
+ */
+static void
+emit_clipped_poly(struct draw_stage *stage,
+                  const struct prim_header *header,
+                  struct vertex_header **inlist,
+                  const boolean *inEdges,
+                  unsigned n,
+                  unsigned tmpnr)
+{
+   const struct clip_stage *clipper = clip_stage( stage );
+
+   if (n < 3)
+      return;
+
+   if (clipper->num_const_attribs) {
+      if (stage->draw->rasterizer->flatshade_first) {
+         if (inlist[0] != header->v[0]) {
+            assert(tmpnr < MAX_CLIPPED_VERTICES + 1);
+            if (tmpnr >= MAX_CLIPPED_VERTICES + 1)
+               return;
+            inlist[0] = dup_vert(stage, inlist[0], tmpnr++);
+            copy_flat(stage, inlist[0], header->v[0]);
+         }
+      }
+      else {
+         if (inlist[0] != header->v[2]) {
+            assert(tmpnr < MAX_CLIPPED_VERTICES + 1);
+            if (tmpnr >= MAX_CLIPPED_VERTICES + 1)
+               return;
+            inlist[0] = dup_vert(stage, inlist[0], tmpnr++);
+            copy_flat(stage, inlist[0], header->v[2]);
+         }
+      }
+   }
+
+   emit_poly(stage, inlist, inEdges, n, header);
+}
+
 /* Clip a triangle against the viewport and user clip planes.
  */
 static void
@@ -524,37 +603,458 @@ do_clip_tri(struct draw_stage *stage,
 
    }
 
-   /* If constant interpolated, copy provoking vertex attrib to polygon vertex[0]
-    */
-   if (n >= 3) {
-      if (clipper->num_const_attribs) {
-         if (stage->draw->rasterizer->flatshade_first) {
-            if (inlist[0] != header->v[0]) {
-               assert(tmpnr < MAX_CLIPPED_VERTICES + 1);
-               if (tmpnr >= MAX_CLIPPED_VERTICES + 1)
-                  return;
-               inlist[0] = dup_vert(stage, inlist[0], tmpnr++);
-               copy_flat(stage, inlist[0], header->v[0]);
+   emit_clipped_poly(stage, header, inlist, inEdges, n, tmpnr);
+}
+
+
+/* Clip a triangle against a single plane, which is the common case of
+ * geometry crossing the near plane.  Same as do_clip_tri(), but the
+ * distances of the three vertices are computed once, and the polygon
+ * can only grow to four vertices, two of them new.
+ */
+static void
+do_clip_tri_plane(struct draw_stage *stage,
+                  struct prim_header *header,
+                  unsigned plane_idx)
+{
+   struct clip_stage *clipper = clip_stage( stage );
+   const boolean is_user_clip_plane = plane_idx >= 6;
+   struct vertex_header *verts[4];
+   struct vertex_header *outlist[4];
+   boolean edges[4];
+   boolean outEdges[4];
+   float dp[4];
+   unsigned tmpnr = 0;
+   unsigned n = 0;
+   unsigned i;
+   int viewport_index;
+
+   verts[0] = header->v[0];
+   verts[1] = header->v[1];
+   verts[2] = header->v[2];
+   verts[3] = header->v[0];
+
+   /* see do_clip_tri() */
+   viewport_index = draw_viewport_index(clipper->stage.draw,
+      stage->draw->rasterizer->flatshade_first ? verts[0] : verts[2]);
+
+   edges[0] = !!(header->flags & DRAW_PIPE_EDGE_FLAG_0);
+   edges[1] = !!(header->flags & DRAW_PIPE_EDGE_FLAG_1);
+   edges[2] = !!(header->flags & DRAW_PIPE_EDGE_FLAG_2);
+   edges[3] = edges[0];
+
+   for (i = 0; i < 3; i++) {
+      dp[i] = getclipdist(clipper, verts[i], plane_idx);
+      if (util_is_inf_or_nan(dp[i]))
+         return; //discard nan
+   }
+   dp[3] = dp[0];
+
+   for (i = 0; i < 3; i++) {
+      boolean different_sign;
+
+      if (dp[i] >= 0.0f) {
+         outEdges[n] = edges[i];
+         outlist[n++] = verts[i];
+         different_sign = dp[i + 1] < 0.0f;
+      } else {
+         different_sign = !(dp[i + 1] < 0.0f);
+      }
+
+      if (different_sign) {
+         struct vertex_header *new_vert = clipper->stage.tmp[tmpnr++];
+
+         if (dp[i + 1] < 0.0f) {
+            /* Going out of bounds */
+            float t = dp[i + 1] / (dp[i + 1] - dp[i]);
+            interp( clipper, new_vert, t, verts[i + 1], verts[i], viewport_index );
+
+            if (is_user_clip_plane) {
+               outEdges[n] = TRUE;
+               new_vert->edgeflag = TRUE;
+            }
+            else {
+               outEdges[n] = edges[i];
+               new_vert->edgeflag = FALSE;
             }
          }
          else {
-            if (inlist[0] != header->v[2]) {
-               assert(tmpnr < MAX_CLIPPED_VERTICES + 1);
-               if (tmpnr >= MAX_CLIPPED_VERTICES + 1)
-                  return;
-               inlist[0] = dup_vert(stage, inlist[0], tmpnr++);
-               copy_flat(stage, inlist[0], header->v[2]);
+            /* Coming back in */
+            float t = dp[i] / (dp[i] - dp[i + 1]);
+            interp( clipper, new_vert, t, verts[i], verts[i + 1], viewport_index );
+
+            new_vert->edgeflag = verts[i]->edgeflag;
+            outEdges[n] = edges[i];
+         }
+         outlist[n++] = new_vert;
+      }
+   }
+
+   emit_clipped_poly(stage, header, outlist, outEdges, n, tmpnr);
+}
+
+
+/* The positions of the new vertices of a batch, in SoA form.
+ */
+struct clip_batch_interp {
+   unsigned nr;
+   float t[2 * CLIP_BATCH_SIZE];
+   float in[4][2 * CLIP_BATCH_SIZE];
+   float out[4][2 * CLIP_BATCH_SIZE];
+   float scale[3][2 * CLIP_BATCH_SIZE];
+   float trans[3][2 * CLIP_BATCH_SIZE];
+   float pos[4][2 * CLIP_BATCH_SIZE];
+   float win[4][2 * CLIP_BATCH_SIZE];
+   struct vertex_header *dst[2 * CLIP_BATCH_SIZE];
+   const struct vertex_header *in_vert[2 * CLIP_BATCH_SIZE];
+   const struct vertex_header *out_vert[2 * CLIP_BATCH_SIZE];
+   boolean edgeflag[2 * CLIP_BATCH_SIZE];
+};
+
+
+/* dp = src . plane for nr SoA elements, nr being a multiple of four.
+ */
+static void
+clip_batch_distances(float *dp,
+                     float (*src)[CLIP_BATCH_SIZE],
+                     float (*plane)[CLIP_BATCH_SIZE],
+                     unsigned nr)
+{
+   unsigned i;
+
+   for (i = 0; i < nr; i += 4) {
+#if defined(PIPE_ARCH_SSE)
+      __m128 d = _mm_mul_ps(_mm_loadu_ps(&src[0][i]),
+                            _mm_loadu_ps(&plane[0][i]));
+      unsigned c;
+
+      for (c = 1; c < 4; c++)
+         d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(&src[c][i]),
+                                      _mm_loadu_ps(&plane[c][i])));
+      _mm_storeu_ps(&dp[i], d);
+#else
+      unsigned j;
+
+      for (j = i; j < i + 4; j++)
+         dp[j] = (src[0][j] * plane[0][j] +
+                  src[1][j] * plane[1][j] +
+                  src[2][j] * plane[2][j] +
+                  src[3][j] * plane[3][j]);
+#endif
+   }
+}
+
+
+/* Same as the position part of interp(), for nr SoA elements, nr being a
+ * multiple of four.
+ */
+static void
+clip_batch_positions(struct clip_batch_interp *bi, unsigned nr)
+{
+   unsigned i, c;
+
+   for (i = 0; i < nr; i += 4) {
+#if defined(PIPE_ARCH_SSE)
+      const __m128 t = _mm_loadu_ps(&bi->t[i]);
+      __m128 pos[4], oow;
+
+      for (c = 0; c < 4; c++) {
+         const __m128 o = _mm_loadu_ps(&bi->out[c][i]);
+         const __m128 d = _mm_sub_ps(_mm_loadu_ps(&bi->in[c][i]), o);
+
+         pos[c] = _mm_add_ps(o, _mm_mul_ps(t, d));
+         _mm_storeu_ps(&bi->pos[c][i], pos[c]);
+      }
+
+      oow = _mm_div_ps(_mm_set1_ps(1.0f), pos[3]);
+      for (c = 0; c < 3; c++) {
+         const __m128 w = _mm_mul_ps(_mm_mul_ps(pos[c], oow),
+                                     _mm_loadu_ps(&bi->scale[c][i]));
+
+         _mm_storeu_ps(&bi->win[c][i],
+                       _mm_add_ps(w, _mm_loadu_ps(&bi->trans[c][i])));
+      }
+      _mm_storeu_ps(&bi->win[3][i], oow);
+#else
+      unsigned j;
+
+      for (j = i; j < i + 4; j++) {
+         float oow;
+
+         for (c = 0; c < 4; c++)
+            bi->pos[c][j] = LINTERP(bi->t[j], bi->out[c][j], bi->in[c][j]);
+
+         oow = 1.0f / bi->pos[3][j];
+         for (c = 0; c < 3; c++)
+            bi->win[c][j] = bi->pos[c][j] * oow * bi->scale[c][j] +
+                            bi->trans[c][j];
+         bi->win[3][j] = oow;
+      }
+#endif
+   }
+}
+
+
+/* Record a new vertex of a batch, to be interpolated by clip_flush_batch().
+ */
+static void
+clip_batch_add_vert(struct clip_stage *clipper,
+                    struct clip_batch_interp *bi,
+                    struct vertex_header *dst,
+                    float t,
+                    const struct vertex_header *out,
+                    const struct vertex_header *in,
+                    unsigned viewport_index,
+                    boolean edgeflag)
+{
+   const struct pipe_viewport_state *vp =
+      &clipper->stage.draw->viewports[viewport_index];
+   const unsigned j = bi->nr++;
+   unsigned c;
+
+   bi->t[j] = t;
+   for (c = 0; c < 4; c++) {
+      bi->in[c][j] = in->clip_pos[c];
+      bi->out[c][j] = out->clip_pos[c];
+   }
+   for (c = 0; c < 3; c++) {
+      bi->scale[c][j] = vp->scale[c];
+      bi->trans[c][j] = vp->translate[c];
+   }
+   bi->dst[j] = dst;
+   bi->in_vert[j] = in;
+   bi->out_vert[j] = out;
+   bi->edgeflag[j] = edgeflag;
+}
+
+
+/* Clip the batched triangles, each against its plane.  Same as
+ * do_clip_tri_plane(), but the distances to the planes and the positions
+ * of the new vertices are computed for the whole batch at once, and the
+ * polygons go straight into the vertex buffer when the next stage is the
+ * vbuf stage.
+ */
+static void
+clip_flush_batch(struct draw_stage *stage)
+{
+   struct clip_stage *clipper = clip_stage(stage);
+   struct draw_context *draw = stage->draw;
+   const boolean flatshade_first = draw->rasterizer->flatshade_first;
+   const boolean uses_viewport_index =
+      draw_current_shader_uses_viewport_index(draw);
+   const unsigned nr = clipper->batch_nr;
+   float src[4][CLIP_BATCH_SIZE];
+   float plane[4][CLIP_BATCH_SIZE];
+   float dp[3][CLIP_BATCH_SIZE];
+   struct clip_batch_interp bi;
+   struct draw_poly polys[CLIP_BATCH_SIZE];
+   boolean edges[CLIP_BATCH_SIZE][4];
+   const struct prim_header *headers[CLIP_BATCH_SIZE];
+   const struct vertex_header *prov[CLIP_BATCH_SIZE];
+   struct vertex_header *new_verts = stage->tmp[MAX_CLIPPED_VERTICES + 1];
+   unsigned nr_polys = 0, nr_new_verts = 0;
+   unsigned i, j, k, c;
+
+   clipper->batch_nr = 0;
+
+   /* Gather the clip coordinates and the planes, padding them to whole
+    * SIMD vectors with the last triangle.
+    */
+   for (i = 0; i < nr; i++) {
+      const float *p = clipper->plane[clipper->batch_plane[i]];
+
+      for (c = 0; c < 4; c++)
+         plane[c][i] = p[c];
+   }
+   for (; i < align(nr, 4); i++) {
+      for (c = 0; c < 4; c++)
+         plane[c][i] = plane[c][nr - 1];
+   }
+
+   for (k = 0; k < 3; k++) {
+      for (i = 0; i < nr; i++) {
+         const struct vertex_header *v = clipper->batch[i].v[k];
+         const float *pos = clipper->batch_plane[i] >= 6 &&
+                            clipper->cv_attr >= 0 ?
+                            v->data[clipper->cv_attr] : v->clip_pos;
+
+         for (c = 0; c < 4; c++)
+            src[c][i] = pos[c];
+      }
+      for (; i < align(nr, 4); i++) {
+         for (c = 0; c < 4; c++)
+            src[c][i] = src[c][nr - 1];
+      }
+      clip_batch_distances(dp[k], src, plane, align(nr, 4));
+   }
+
+   bi.nr = 0;
+
+   for (i = 0; i < nr; i++) {
+      const struct prim_header *header = &clipper->batch[i];
+      const boolean is_user_clip_plane = clipper->batch_plane[i] >= 6;
+      struct draw_poly *poly = &polys[nr_polys];
+      boolean *outEdges = edges[nr_polys];
+      struct vertex_header *verts[4];
+      boolean inEdges[4];
+      float d[4];
+      unsigned viewport_index;
+      unsigned n = 0;
+
+      for (k = 0; k < 3; k++) {
+         d[k] = dp[k][i];
+         if (util_is_inf_or_nan(d[k]))
+            break;
+      }
+      if (k < 3)
+         continue; //discard nan
+      d[3] = d[0];
+
+      verts[0] = header->v[0];
+      verts[1] = header->v[1];
+      verts[2] = header->v[2];
+      verts[3] = header->v[0];
+
+      prov[nr_polys] = flatshade_first ? verts[0] : verts[2];
+      viewport_index = uses_viewport_index ?
+                       draw_viewport_index(draw, prov[nr_polys]) : 0;
+
+      inEdges[0] = !!(header->flags & DRAW_PIPE_EDGE_FLAG_0);
+      inEdges[1] = !!(header->flags & DRAW_PIPE_EDGE_FLAG_1);
+      inEdges[2] = !!(header->flags & DRAW_PIPE_EDGE_FLAG_2);
+      inEdges[3] = inEdges[0];
+
+      poly->nr_new = 0;
+
+      for (k = 0; k < 3; k++) {
+         boolean different_sign;
+
+         if (d[k] >= 0.0f) {
+            outEdges[n] = inEdges[k];
+            poly->v[n++] = verts[k];
+            different_sign = d[k + 1] < 0.0f;
+         } else {
+            different_sign = !(d[k + 1] < 0.0f);
+         }
+
+         if (different_sign) {
+            struct vertex_header *new_vert =
+               stage->tmp[MAX_CLIPPED_VERTICES + 1 +
+                          nr_new_verts + poly->nr_new++];
+
+            if (d[k + 1] < 0.0f) {
+               /* Going out of bounds */
+               float t = d[k + 1] / (d[k + 1] - d[k]);
+
+               clip_batch_add_vert(clipper, &bi, new_vert, t, verts[k + 1],
+                                   verts[k], viewport_index,
+                                   is_user_clip_plane);
+               outEdges[n] = is_user_clip_plane ? TRUE : inEdges[k];
             }
+            else {
+               /* Coming back in */
+               float t = d[k] / (d[k] - d[k + 1]);
+
+               clip_batch_add_vert(clipper, &bi, new_vert, t, verts[k],
+                                   verts[k + 1], viewport_index,
+                                   verts[k]->edgeflag);
+               outEdges[n] = inEdges[k];
+            }
+            poly->v[n++] = new_vert;
          }
       }
 
-      /* Emit the polygon as triangles to the setup stage:
-       */
-      emit_poly(stage, inlist, inEdges, n, header);
+      /* a sign change makes a polygon, so no new vertex is lost here */
+      if (n < 3)
+         continue;
+
+      /* the provoking vertex is copied once interpolated, see below */
+      if (clipper->num_const_attribs &&
+          poly->v[0] != prov[nr_polys] &&
+          (poly->v[0] == header->v[0] ||
+           poly->v[0] == header->v[1] ||
+           poly->v[0] == header->v[2])) {
+         struct vertex_header *dup =
+            stage->tmp[MAX_CLIPPED_VERTICES + 1 +
+                       nr_new_verts + poly->nr_new++];
+
+         memcpy(dup, poly->v[0], clipper->batch_stride);
+         dup->vertex_id = UNDEFINED_VERTEX_ID;
+         poly->v[0] = dup;
+      }
+
+      poly->nr = n;
+      headers[nr_polys] = header;
+      nr_new_verts += poly->nr_new;
+      nr_polys++;
+   }
+
+   if (bi.nr) {
+      /* pad to whole SIMD vectors with the last vertex */
+      for (j = bi.nr; j < align(bi.nr, 4); j++) {
+         bi.t[j] = bi.t[bi.nr - 1];
+         for (c = 0; c < 4; c++) {
+            bi.in[c][j] = bi.in[c][bi.nr - 1];
+            bi.out[c][j] = bi.out[c][bi.nr - 1];
+         }
+         for (c = 0; c < 3; c++) {
+            bi.scale[c][j] = bi.scale[c][bi.nr - 1];
+            bi.trans[c][j] = bi.trans[c][bi.nr - 1];
+         }
+      }
+
+      clip_batch_positions(&bi, align(bi.nr, 4));
+
+      for (j = 0; j < bi.nr; j++) {
+         struct vertex_header *dst = bi.dst[j];
+
+         for (c = 0; c < 4; c++) {
+            dst->clip_pos[c] = bi.pos[c][j];
+            dst->data[clipper->pos_attr][c] = bi.win[c][j];
+         }
+         interp_attribs(clipper, dst, bi.t[j], bi.out_vert[j], bi.in_vert[j]);
+         dst->edgeflag = bi.edgeflag[j];
+      }
+   }
+
+   /* If constant interpolated, copy provoking vertex attrib to polygon
+    * vertex[0]
+    */
+   if (clipper->num_const_attribs) {
+      for (i = 0; i < nr_polys; i++) {
+         if (polys[i].v[0] != prov[i])
+            copy_flat(stage, polys[i].v[0], prov[i]);
+      }
+   }
+
+   if (nr_polys &&
+       !draw_vbuf_emit_polys(stage->next, polys, nr_polys, new_verts,
+                             clipper->batch_stride)) {
+      for (i = 0; i < nr_polys; i++)
+         emit_poly(stage, polys[i].v, edges[i], polys[i].nr, headers[i]);
    }
 }
 
 
+static inline void
+flush_batch(struct draw_stage *stage)
+{
+   if (clip_stage(stage)->batch_nr)
+      clip_flush_batch(stage);
+}
+
+
+/**
+ * Clip the triangles batched so far, as the vertices they reference are
+ * about to go away.
+ */
+void
+draw_clip_flush_batch(struct draw_stage *stage)
+{
+   flush_batch(stage);
+}
+
+
 /* Clip a line against the viewport and user clip planes.
  */
 static void
@@ -640,6 +1140,8 @@ do_clip_line(struct draw_stage *stage,
 static void
 clip_point(struct draw_stage *stage, struct prim_header *header)
 {
+   flush_batch(stage);
+
    if (header->v[0]->clipmask == 0)
       stage->next->point( stage->next, header );
 }
@@ -655,6 +1157,9 @@ static void
 clip_point_guard_xy(struct draw_stage *stage, struct prim_header *header)
 {
    unsigned clipmask = header->v[0]->clipmask;
+
+   flush_batch(stage);
+
    if ((clipmask & 0xffffffff) == 0)
       stage->next->point(stage->next, header);
    else if ((clipmask & 0xfffffff0) == 0) {
@@ -692,6 +1197,8 @@ clip_line(struct draw_stage *stage, struct prim_header *header)
    unsigned clipmask = (header->v[0]->clipmask | 
                         header->v[1]->clipmask);
 
+   flush_batch(stage);
+
    if (clipmask == 0) {
       /* no clipping needed */
       stage->next->line( stage->next, header );
@@ -713,12 +1220,30 @@ clip_tri(struct draw_stage *stage, struct prim_header *header)
 
    if (clipmask == 0) {
       /* no clipping needed */
+      flush_batch(stage);
       stage->next->tri( stage->next, header );
    }
    else if ((header->v[0]->clipmask & 
              header->v[1]->clipmask & 
              header->v[2]->clipmask) == 0) {
-      do_clip_tri(stage, header, clipmask);
+      struct clip_stage *clipper = clip_stage(stage);
+      const unsigned plane_idx = ffs(clipmask) - 1;
+
+      if (util_is_power_of_two_nonzero(clipmask) &&
+          (plane_idx < 6 || !clipper->have_clipdist)) {
+         /* the distance to the plane is a dot product, batch it */
+         clipper->batch[clipper->batch_nr] = *header;
+         clipper->batch_plane[clipper->batch_nr] = plane_idx;
+         if (++clipper->batch_nr == CLIP_BATCH_SIZE)
+            clip_flush_batch(stage);
+         return;
+      }
+
+      flush_batch(stage);
+      if (util_is_power_of_two_nonzero(clipmask))
+         do_clip_tri_plane(stage, header, plane_idx);
+      else
+         do_clip_tri(stage, header, clipmask);
    }
 }
 
@@ -881,6 +1406,18 @@ clip_init_state(struct draw_stage *stage)
       }
    }
 
+   /* Pack the temporary vertices of the batches, which still fall within
+    * the space draw_alloc_temp_verts() reserved for them.
+    */
+   clipper->batch_stride = sizeof(struct vertex_header)
+      + draw_num_shader_outputs(draw) * 4 * sizeof(float);
+   for (i = 0; i < CLIP_BATCH_VERTICES; i++) {
+      stage->tmp[MAX_CLIPPED_VERTICES + 1 + i] = (struct vertex_header *)
+         ((char *)stage->tmp[0] +
+          (MAX_CLIPPED_VERTICES + 1) * MAX_VERTEX_SIZE +
+          i * clipper->batch_stride);
+   }
+
    stage->tri = clip_tri;
    stage->line = clip_line;
 }
@@ -904,6 +1441,7 @@ static void clip_first_line(struct draw_stage *stage,
 
 static void clip_flush(struct draw_stage *stage, unsigned flags)
 {
+   flush_batch(stage);
    stage->tri = clip_first_tri;
    stage->line = clip_first_line;
    stage->next->flush( stage->next, flags );
@@ -912,6 +1450,7 @@ static void clip_flush(struct draw_stage *stage, unsigned flags)
 
 static void clip_reset_stipple_counter(struct draw_stage *stage)
 {
+   flush_batch(stage);
    stage->next->reset_stipple_counter( stage->next );
 }
 
@@ -944,7 +1483,9 @@ struct draw_stage *draw_clip_stage(struct draw_context *draw)
 
    clipper->plane = draw->plane;
 
-   if (!draw_alloc_temp_verts( &clipper->stage, MAX_CLIPPED_VERTICES+1 ))
+   /* the batched triangles' new vertices come after those of the others */
+   if (!draw_alloc_temp_verts( &clipper->stage,
+                               MAX_CLIPPED_VERTICES + 1 + CLIP_BATCH_VERTICES ))
       goto fail;
 
    return &clipper->stage;
@@ -48,6 +48,10 @@
 
 #include "tgsi/tgsi_transform.h"
 
+#include "nir/nir_draw_helpers.h"
+#include "compiler/nir/nir.h"
+#include "util/ralloc.h"
+
 #include "draw_context.h"
 #include "draw_pipe.h"
 
@@ -133,18 +137,30 @@ generate_pstip_fs(struct pstip_stage *pstip)
                    TGSI_FILE_SYSTEM_VALUE : TGSI_FILE_INPUT;
 
    pstip_fs = *orig_fs; /* copy to init */
-   pstip_fs.tokens = util_pstipple_create_fragment_shader(orig_fs->tokens,
-                                                          &pstip->fs->sampler_unit,
-                                                          0,
-                                                          wincoord_file);
-   if (pstip_fs.tokens == NULL)
-      return FALSE;
+   if (orig_fs->type == PIPE_SHADER_IR_NIR) {
+      /* the driver takes ownership of the NIR, so transform a copy */
+      pstip_fs.ir.nir = nir_shader_clone(NULL, orig_fs->ir.nir);
+      if (pstip_fs.ir.nir == NULL)
+         return FALSE;
+
+      nir_lower_pstipple_fs(pstip_fs.ir.nir, &pstip->fs->sampler_unit,
+                            wincoord_file == TGSI_FILE_SYSTEM_VALUE);
+   }
+   else {
+      pstip_fs.tokens = util_pstipple_create_fragment_shader(orig_fs->tokens,
+                                                             &pstip->fs->sampler_unit,
+                                                             0,
+                                                             wincoord_file);
+      if (pstip_fs.tokens == NULL)
+         return FALSE;
+   }
 
    assert(pstip->fs->sampler_unit < PIPE_MAX_SAMPLERS);
 
    pstip->fs->pstip_fs = pstip->driver_create_fs_state(pipe, &pstip_fs);
 
-   FREE((void *)pstip_fs.tokens);
+   if (orig_fs->type == PIPE_SHADER_IR_TGSI)
+      FREE((void *)pstip_fs.tokens);
 
    if (!pstip->fs->pstip_fs)
       return FALSE;
@@ -334,7 +350,11 @@ pstip_create_fs_state(struct pipe_context *pipe,
    struct pstip_fragment_shader *pstipfs = CALLOC_STRUCT(pstip_fragment_shader);
 
    if (pstipfs) {
-      pstipfs->state.tokens = tgsi_dup_tokens(fs->tokens);
+      pstipfs->state.type = fs->type;
+      if (fs->type == PIPE_SHADER_IR_TGSI)
+         pstipfs->state.tokens = tgsi_dup_tokens(fs->tokens);
+      else
+         pstipfs->state.ir.nir = nir_shader_clone(NULL, fs->ir.nir);
 
       /* pass-through */
       pstipfs->driver_fs = pstip->driver_create_fs_state(pstip->pipe, fs);
@@ -368,7 +388,10 @@ pstip_delete_fs_state(struct pipe_context *pipe, void *fs)
    if (pstipfs->pstip_fs)
       pstip->driver_delete_fs_state(pstip->pipe, pstipfs->pstip_fs);
 
-   FREE((void*)pstipfs->state.tokens);
+   if (pstipfs->state.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(pstipfs->state.ir.nir);
+   else
+      FREE((void*)pstipfs->state.tokens);
    FREE(pstipfs);
 }
 
@@ -58,11 +58,6 @@ draw_pipe_passthrough_tri(struct draw_stage *stage, struct prim_header *header)
 
 
 
-/* This is only used for temporary verts.
- */
-#define MAX_VERTEX_SIZE ((2 + PIPE_MAX_SHADER_OUTPUTS) * 4 * sizeof(float))
-
-
 /**
  * Allocate space for temporary post-transform vertices, such as for clipping.
  */
@@ -106,10 +101,16 @@ void draw_free_temp_verts( struct draw_stage *stage )
 
 
 /* Reset vertex ids.  This is basically a type of flush.
+ *
+ * The vertices of the current run are reset when listed in emitted[],
+ * or all of them when there is no list.  The listed vertices of the
+ * previous runs aren't used anymore, and may have been freed.
  *
  * Called only from draw_pipe_vbuf.c
  */
-void draw_reset_vertex_ids(struct draw_context *draw)
+void draw_reset_vertex_ids(struct draw_context *draw,
+                           struct vertex_header **emitted,
+                           unsigned nr_emitted)
 {
    struct draw_stage *stage = draw->pipeline.first;
    
@@ -122,7 +123,19 @@ void draw_reset_vertex_ids(struct draw_context *draw)
       stage = stage->next;
    }
 
-   if (draw->pipeline.verts)
+   if (draw->pipeline.verts && emitted)
+   {
+      const uintptr_t start = (uintptr_t)draw->pipeline.verts;
+      const uintptr_t end = start +
+         draw->pipeline.vertex_count * draw->pipeline.vertex_stride;
+      unsigned i;
+
+      for (i = 0; i < nr_emitted; i++) {
+         if ((uintptr_t)emitted[i] >= start && (uintptr_t)emitted[i] < end)
+            emitted[i]->vertex_id = UNDEFINED_VERTEX_ID;
+      }
+   }
+   else if (draw->pipeline.verts)
    {
       unsigned i;
       char *verts = draw->pipeline.verts;
@@ -134,4 +147,3 @@ void draw_reset_vertex_ids(struct draw_context *draw)
       }
    }
 }
-
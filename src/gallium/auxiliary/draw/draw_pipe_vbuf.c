@@ -68,6 +68,10 @@ struct vbuf_stage {
    unsigned max_vertices;
    unsigned nr_vertices;
 
+   /** The vertices in the buffer, to reset their ids on flush */
+   struct vertex_header **emitted;
+   unsigned max_emitted;
+
    /** Indices */
    ushort *indices;
    unsigned max_indices;
@@ -131,6 +135,8 @@ emit_vertex(struct vbuf_stage *vbuf, struct vertex_header *vertex)
       if (0) draw_dump_emitted_vertex(vbuf->vinfo, (uint8_t *)vbuf->vertex_ptr);
 
       vbuf->vertex_ptr += vbuf->vertex_size/4;
+      if (vbuf->emitted)
+         vbuf->emitted[vbuf->nr_vertices] = vertex;
       vertex->vertex_id = vbuf->nr_vertices++;
    }
 
@@ -318,7 +324,8 @@ vbuf_flush_vertices(struct vbuf_stage *vbuf)
 
       /* Reset temporary vertices ids */
       if (vbuf->nr_vertices)
-         draw_reset_vertex_ids(vbuf->stage.draw);
+         draw_reset_vertex_ids(vbuf->stage.draw, vbuf->emitted,
+                               vbuf->nr_vertices);
 
       /* Free the vertex buffer */
       vbuf->render->release_vertices(vbuf->render);
@@ -354,6 +361,15 @@ vbuf_alloc_vertices(struct vbuf_stage *vbuf)
    if (vbuf->max_vertices >= UNDEFINED_VERTEX_ID)
       vbuf->max_vertices = UNDEFINED_VERTEX_ID - 1;
 
+   /* Without the list, all the vertices of the run get reset on flush,
+    * which is slow when the buffer is small compared to the run.
+    */
+   if (vbuf->max_vertices > vbuf->max_emitted) {
+      FREE(vbuf->emitted);
+      vbuf->emitted = MALLOC(vbuf->max_vertices * sizeof(vbuf->emitted[0]));
+      vbuf->max_emitted = vbuf->emitted ? vbuf->max_vertices : 0;
+   }
+
    /* Must always succeed -- driver gives us a
     * 'max_vertex_buffer_bytes' which it guarantees it can allocate,
     * and it will flush itself if necessary to do so.  If this does
@@ -395,6 +411,8 @@ vbuf_destroy(struct draw_stage *stage)
    if (vbuf->indices)
       align_free(vbuf->indices);
 
+   FREE(vbuf->emitted);
+
    if (vbuf->render)
       vbuf->render->destroy(vbuf->render);
 
@@ -405,6 +423,99 @@ vbuf_destroy(struct draw_stage *stage)
 }
 
 
+/**
+ * Emit the polygons made by the clipper as triangle fans, writing their new
+ * vertices straight into the vertex buffer with one translate run per
+ * buffer instead of one per vertex.
+ * \return FALSE if the stage isn't a vbuf stage
+ */
+boolean
+draw_vbuf_emit_polys(struct draw_stage *stage,
+                     const struct draw_poly *polys,
+                     unsigned nr_polys,
+                     struct vertex_header *new_verts,
+                     unsigned new_stride)
+{
+   struct vbuf_stage *vbuf;
+   const boolean flatshade_first =
+      stage->draw->rasterizer->flatshade_first;
+   unsigned i = 0;
+
+   if (stage->destroy != vbuf_destroy)
+      return FALSE;
+
+   vbuf = vbuf_stage(stage);
+
+   if (stage->tri == vbuf_first_tri) {
+      vbuf_flush_vertices(vbuf);
+      vbuf_start_prim(vbuf, PIPE_PRIM_TRIANGLES);
+      stage->tri = vbuf_tri;
+   }
+
+   while (i < nr_polys) {
+      unsigned nr_verts = 0, nr_indices = 0, nr_new = 0;
+      unsigned end, j, k;
+
+      check_space(vbuf, 6);
+
+      /* as many polygons as fit, counting each vertex as new */
+      for (end = i; end < nr_polys; end++) {
+         const struct draw_poly *poly = &polys[end];
+
+         if (vbuf->nr_vertices + nr_verts + poly->nr > vbuf->max_vertices ||
+             vbuf->nr_indices + nr_indices + 3 * (poly->nr - 2) >
+             vbuf->max_indices)
+            break;
+
+         nr_verts += poly->nr;
+         nr_indices += 3 * (poly->nr - 2);
+         nr_new += poly->nr_new;
+      }
+
+      if (nr_new) {
+         vbuf->translate->set_buffer(vbuf->translate, 0, new_verts->data[0],
+                                     new_stride, ~0);
+         vbuf->translate->run(vbuf->translate, 0, nr_new, 0, 0,
+                              vbuf->vertex_ptr);
+         vbuf->vertex_ptr += nr_new * vbuf->vertex_size / 4;
+
+         for (j = 0; j < nr_new; j++) {
+            if (vbuf->emitted)
+               vbuf->emitted[vbuf->nr_vertices] = new_verts;
+            new_verts->vertex_id = vbuf->nr_vertices++;
+            new_verts = (struct vertex_header *)
+               ((char *)new_verts + new_stride);
+         }
+      }
+
+      /* same vertex order as the clipper's emit_poly() */
+      for (; i < end; i++) {
+         const struct draw_poly *poly = &polys[i];
+
+         for (j = 2; j < poly->nr; j++) {
+            struct vertex_header *v[3];
+
+            if (flatshade_first) {
+               v[0] = poly->v[0];
+               v[1] = poly->v[j - 1];
+               v[2] = poly->v[j];
+            }
+            else {
+               v[0] = poly->v[j - 1];
+               v[1] = poly->v[j];
+               v[2] = poly->v[0];
+            }
+
+            for (k = 0; k < 3; k++)
+               vbuf->indices[vbuf->nr_indices++] = emit_vertex(vbuf, v[k]);
+         }
+      }
+   }
+
+   return TRUE;
+}
+
+
 /**
  * Create a new primitive vbuf/render stage.
  */
@@ -71,6 +71,7 @@ struct tgsi_buffer;
 struct draw_pt_front_end;
 struct draw_assembler;
 struct draw_llvm;
+struct lp_cached_code;
 
 
 /**
@@ -210,6 +211,12 @@ struct draw_context
          float (*planes)[DRAW_TOTAL_CLIP_PLANES][4]; 
       } user;
 
+      /** Indices of indexed draws, and how many vertices they shaded */
+      struct {
+         uint64_t num_indices;
+         uint64_t num_shaded;
+      } vcache_stats;
+
       boolean test_fse;         /* enable FSE even though its not correct (eg for softpipe) */
       boolean no_fse;           /* disable FSE even when it is correct */
    } pt;
@@ -341,6 +348,15 @@ struct draw_context
 
    struct draw_assembler *ia;
 
+   /** Persistent cache of jitted shader variants, provided by the driver */
+   void *disk_cache_cookie;
+   void (*disk_cache_find_shader)(void *cookie,
+                                  struct lp_cached_code *cache,
+                                  unsigned char ir_sha1_cache_key[20]);
+   void (*disk_cache_insert_shader)(void *cookie,
+                                    struct lp_cached_code *cache,
+                                    unsigned char ir_sha1_cache_key[20]);
+
    void *driver_private;
 };
 
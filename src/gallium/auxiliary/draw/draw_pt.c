@@ -148,6 +148,9 @@ draw_pt_arrays(struct draw_context *draw,
 
    frontend->run( frontend, start, count );
 
+   if (middle->finish_run)
+      middle->finish_run(middle);
+
    return TRUE;
 }
 
@@ -124,6 +124,12 @@ struct draw_pt_middle_end {
 
    int (*get_max_vertex_count)( struct draw_pt_middle_end * );
 
+   /**
+    * Called once the frontend has split a whole draw, for middle ends
+    * which defer some of the work.  May be NULL.
+    */
+   void (*finish_run)( struct draw_pt_middle_end * );
+
    void (*finish)( struct draw_pt_middle_end * );
    void (*destroy)( struct draw_pt_middle_end * );
 };
@@ -25,9 +25,11 @@
  *
  **************************************************************************/
 
+#include "util/u_cpu_detect.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/u_queue.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
 #include "draw/draw_vbuf.h"
@@ -40,6 +42,47 @@
 #include "gallivm/lp_bld_debug.h"
 
 
+DEBUG_GET_ONCE_BOOL_OPTION(draw_no_early_cull, "DRAW_NO_EARLY_CULL", FALSE)
+
+
+/** Max number of worker threads shading vertices */
+#define LLVM_MAX_THREADS 8
+
+/** Max number of vsplit segments in flight */
+#define LLVM_MAX_SEGMENTS 16
+
+/** Vertices a draw must have before its segments go to the worker threads */
+#define LLVM_MIN_THREADED_VERTICES 8192
+
+
+struct llvm_middle_end;
+
+/**
+ * A vsplit segment which gets fetched and shaded by a worker thread, and
+ * whose primitives get drawn on the application thread, in API order,
+ * once the vertices are ready.
+ */
+struct llvm_segment {
+   struct llvm_middle_end *fpme;
+
+   struct draw_fetch_info fetch_info;
+   struct draw_prim_info prim_info;
+   struct draw_vertex_info vert_info;
+   unsigned prim_length;
+   boolean clipped;
+
+   /** Whether a worker thread shades the segment */
+   boolean queued;
+   struct util_queue_fence fence;
+
+   /* Copies of the element lists, which vsplit reuses for the next segment */
+   unsigned *fetch_elts;
+   unsigned max_fetch_elts;
+   ushort *draw_elts;
+   unsigned max_draw_elts;
+};
+
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -57,6 +100,27 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   /* Triangles left to draw after early culling */
+   boolean early_cull;
+   ushort *cull_elts;
+   unsigned max_cull_elts;
+
+   /*
+    * Segments of big draws are shaded on this queue.  It is created by the
+    * first such draw, so contexts which only do small draws never start the
+    * threads.  The ring of segments in flight is drained at the end of each
+    * draw, so the shader variant and the jit context never change
+    * underneath the workers.
+    */
+   struct util_queue queue;
+   unsigned num_threads;
+   struct llvm_segment segments[LLVM_MAX_SEGMENTS];
+   unsigned max_segments;
+   unsigned first_segment;
+   unsigned num_segments;
+   /** Vertices in the segments of the current draw so far */
+   unsigned draw_vertices;
 };
 
 
@@ -347,45 +411,40 @@ emit(struct pt_emit *emit,
 }
 
 
-static void
-llvm_pipeline_generic(struct draw_pt_middle_end *middle,
-                      const struct draw_fetch_info *fetch_info,
-                      const struct draw_prim_info *in_prim_info)
+/**
+ * Allocate the vertex buffer which the vertex shader writes into.
+ */
+static boolean
+llvm_alloc_vertices(struct llvm_middle_end *fpme,
+                    unsigned count,
+                    struct draw_vertex_info *vert_info)
 {
-   struct llvm_middle_end *fpme = llvm_middle_end(middle);
-   struct draw_context *draw = fpme->draw;
-   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
-   struct draw_prim_info gs_prim_info[TGSI_MAX_VERTEX_STREAMS];
-   struct draw_vertex_info llvm_vert_info;
-   struct draw_vertex_info gs_vert_info[TGSI_MAX_VERTEX_STREAMS];
-   struct draw_vertex_info *vert_info;
-   struct draw_prim_info ia_prim_info;
-   struct draw_vertex_info ia_vert_info;
-   const struct draw_prim_info *prim_info = in_prim_info;
-   boolean free_prim_info = FALSE;
-   unsigned opt = fpme->opt;
-   boolean clipped = 0;
-   unsigned start_or_maxelt, vid_base;
-   const unsigned *elts;
-
-   assert(fetch_info->count > 0);
-   llvm_vert_info.count = fetch_info->count;
-   llvm_vert_info.vertex_size = fpme->vertex_size;
-   llvm_vert_info.stride = fpme->vertex_size;
-   llvm_vert_info.verts = (struct vertex_header *)
+   vert_info->count = count;
+   vert_info->vertex_size = fpme->vertex_size;
+   vert_info->stride = fpme->vertex_size;
+   vert_info->verts = (struct vertex_header *)
       MALLOC(fpme->vertex_size *
-             align(fetch_info->count, lp_native_vector_width / 32));
-   if (!llvm_vert_info.verts) {
+             align(count, lp_native_vector_width / 32));
+   if (!vert_info->verts) {
       assert(0);
-      return;
+      return FALSE;
    }
+   return TRUE;
+}
 
-   if (draw->collect_statistics) {
-      draw->statistics.ia_vertices += prim_info->count;
-      draw->statistics.ia_primitives +=
-         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
-      draw->statistics.vs_invocations += fetch_info->count;
-   }
+
+/**
+ * Fetch and shade the vertices, returning whether any needs clipping.
+ * Only reads draw state, so it may run on the worker threads.
+ */
+static boolean
+llvm_pipeline_shade(struct llvm_middle_end *fpme,
+                    const struct draw_fetch_info *fetch_info,
+                    struct draw_vertex_info *vert_info)
+{
+   struct draw_context *draw = fpme->draw;
+   unsigned start_or_maxelt, vid_base;
+   const unsigned *elts;
 
    if (fetch_info->linear) {
       start_or_maxelt = fetch_info->start;
@@ -397,22 +456,161 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       vid_base = draw->pt.user.eltBias;
       elts = fetch_info->elts;
    }
-   clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
-                                             llvm_vert_info.verts,
-                                             draw->pt.user.vbuffer,
-                                             fetch_info->count,
-                                             start_or_maxelt,
-                                             fpme->vertex_size,
-                                             draw->pt.vertex_buffer,
-                                             draw->instance_id,
-                                             vid_base,
-                                             draw->start_instance,
-                                             elts);
-
-   /* Finished with fetch and vs:
+   return fpme->current_variant->jit_func(&fpme->llvm->jit_context,
+                                          vert_info->verts,
+                                          draw->pt.user.vbuffer,
+                                          fetch_info->count,
+                                          start_or_maxelt,
+                                          fpme->vertex_size,
+                                          draw->pt.vertex_buffer,
+                                          draw->instance_id,
+                                          vid_base,
+                                          draw->start_instance,
+                                          elts);
+}
+
+
+/**
+ * Trivially reject and face cull a list of triangles, using the clip masks
+ * and the clip space positions computed by the vertex shader variant, so
+ * that when clipping is the only reason to run the pipeline stages they
+ * never see the primitives which would not be drawn.  Returns FALSE if
+ * the triangles could not be culled, otherwise fills in cull_prim_info
+ * with the remaining ones and returns in need_clip whether any of those
+ * needs clipping.
+ *
+ * Only the per-vertex half of culling, the plane tests giving the clip
+ * masks and the viewport transform, is generated into the vertex shader
+ * variant.  The per-triangle half is done here in C because the variant
+ * never sees primitives: it shades the vertices of a segment in SoA
+ * vectors which don't line up with triangles, and for indexed draws those
+ * are the unique vertices of the segment, the triangles being formed from
+ * the element list afterwards.  Moving the face test into the variant
+ * would also put the cull face and front face state into its key, and
+ * compile new variants on state changes which cost nothing today.
+ */
+static boolean
+llvm_pipeline_cull(struct llvm_middle_end *fpme,
+                   const struct draw_vertex_info *vert_info,
+                   const struct draw_prim_info *prim_info,
+                   struct draw_prim_info *cull_prim_info,
+                   boolean *need_clip)
+{
+   struct draw_context *draw = fpme->draw;
+   const struct pipe_rasterizer_state *rast = draw->rasterizer;
+   const char *verts = (const char *) vert_info->verts;
+   const unsigned stride = vert_info->stride;
+   /*
+    * The facing of a triangle in window space is the sign of the
+    * determinant of the homogeneous x, y and w of its vertices, when those
+    * are all in front of the eye, flipped by the viewport scale.
     */
-   fetch_info = NULL;
-   vert_info = &llvm_vert_info;
+   const unsigned cull_face = draw->bypass_viewport ? PIPE_FACE_NONE :
+                                                      rast->cull_face;
+   const float flip = draw->viewports[0].scale[0] *
+                      draw->viewports[0].scale[1];
+   unsigned clipmask = 0;
+   unsigned i, j, n = 0;
+
+   if (prim_info->prim != PIPE_PRIM_TRIANGLES ||
+       prim_info->primitive_count != 1)
+      return FALSE;
+
+   if (fpme->max_cull_elts < prim_info->count) {
+      FREE(fpme->cull_elts);
+      fpme->cull_elts = MALLOC(prim_info->count * sizeof(ushort));
+      fpme->max_cull_elts = fpme->cull_elts ? prim_info->count : 0;
+      if (!fpme->cull_elts)
+         return FALSE;
+   }
+
+   for (i = 0; i + 2 < prim_info->count; i += 3) {
+      const struct vertex_header *v[3];
+      ushort idx[3];
+
+      for (j = 0; j < 3; j++) {
+         idx[j] = prim_info->linear ? prim_info->start + i + j :
+                                      prim_info->elts[i + j];
+         v[j] = (const struct vertex_header *) (verts + idx[j] * stride);
+      }
+
+      /* entirely outside one of the planes */
+      if (v[0]->clipmask & v[1]->clipmask & v[2]->clipmask)
+         continue;
+
+      if (cull_face != PIPE_FACE_NONE &&
+          v[0]->clip_pos[3] > 0.0f &&
+          v[1]->clip_pos[3] > 0.0f &&
+          v[2]->clip_pos[3] > 0.0f) {
+         const float *p0 = v[0]->clip_pos;
+         const float *p1 = v[1]->clip_pos;
+         const float *p2 = v[2]->clip_pos;
+         const float det = (p0[0] * (p1[1] * p2[3] - p2[1] * p1[3]) -
+                            p0[1] * (p1[0] * p2[3] - p2[0] * p1[3]) +
+                            p0[3] * (p1[0] * p2[1] - p2[0] * p1[1])) * flip;
+
+         /* same rules as the cull stage */
+         if (det != 0) {
+            const unsigned ccw = (det < 0);
+            const unsigned face = (ccw == rast->front_ccw) ? PIPE_FACE_FRONT :
+                                                             PIPE_FACE_BACK;
+            if (face & cull_face)
+               continue;
+         }
+         else if (cull_face & PIPE_FACE_BACK) {
+            continue;
+         }
+      }
+
+      clipmask |= v[0]->clipmask | v[1]->clipmask | v[2]->clipmask;
+
+      fpme->cull_elts[n++] = idx[0];
+      fpme->cull_elts[n++] = idx[1];
+      fpme->cull_elts[n++] = idx[2];
+   }
+
+   *cull_prim_info = *prim_info;
+   cull_prim_info->linear = FALSE;
+   cull_prim_info->start = 0;
+   cull_prim_info->elts = fpme->cull_elts;
+   cull_prim_info->count = n;
+   cull_prim_info->primitive_lengths = &cull_prim_info->count;
+
+   *need_clip = clipmask != 0;
+   return TRUE;
+}
+
+
+/**
+ * Run the shaded vertices through the geometry shader, stream output,
+ * clipping and the pipeline or emit.  Frees the vertices.
+ */
+static void
+llvm_pipeline_draw(struct llvm_middle_end *fpme,
+                   unsigned fetch_count,
+                   struct draw_vertex_info *in_vert_info,
+                   const struct draw_prim_info *in_prim_info,
+                   boolean clipped)
+{
+   struct draw_context *draw = fpme->draw;
+   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
+   struct draw_prim_info gs_prim_info[TGSI_MAX_VERTEX_STREAMS];
+   struct draw_vertex_info gs_vert_info[TGSI_MAX_VERTEX_STREAMS];
+   struct draw_vertex_info *vert_info = in_vert_info;
+   struct draw_prim_info ia_prim_info;
+   struct draw_vertex_info ia_vert_info;
+   struct draw_prim_info cull_prim_info;
+   const struct draw_prim_info *prim_info = in_prim_info;
+   const struct draw_prim_info *draw_prim_info;
+   boolean free_prim_info = FALSE;
+   unsigned opt = fpme->opt;
+
+   if (draw->collect_statistics) {
+      draw->statistics.ia_vertices += prim_info->count;
+      draw->statistics.ia_primitives +=
+         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
+      draw->statistics.vs_invocations += fetch_count;
+   }
 
    if ((opt & PT_SHADE) && gshader) {
       struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
@@ -470,22 +668,33 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
     * will try to access non-existent position output.
     */
    if (draw_current_shader_position_output(draw) != -1) {
+      draw_prim_info = prim_info;
+
       if ((opt & PT_SHADE) && (gshader ||
                                draw->vs.vertex_shader->info.writes_viewport_index)) {
          clipped = draw_pt_post_vs_run( fpme->post_vs, vert_info, prim_info );
       }
+      else if (clipped && fpme->early_cull &&
+               !(opt & PT_PIPELINE) && !draw->vs.edgeflag_output &&
+               llvm_pipeline_cull(fpme, vert_info, prim_info,
+                                  &cull_prim_info, &clipped)) {
+         draw_prim_info = &cull_prim_info;
+      }
       /* "clipped" also includes non-one edgeflag */
       if (clipped) {
          opt |= PT_PIPELINE;
       }
 
       /* Do we need to run the pipeline? Now will come here if clipped
+       * (and not all the triangles were culled)
        */
-      if (opt & PT_PIPELINE) {
-         pipeline( fpme, vert_info, prim_info );
-      }
-      else {
-         emit( fpme->emit, vert_info, prim_info );
+      if (draw_prim_info->count) {
+         if (opt & PT_PIPELINE) {
+            pipeline( fpme, vert_info, draw_prim_info );
+         }
+         else {
+            emit( fpme->emit, vert_info, draw_prim_info );
+         }
       }
    }
    FREE(vert_info->verts);
@@ -495,6 +704,178 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
 }
 
 
+static void
+llvm_segment_shade(void *data, int thread_index)
+{
+   struct llvm_segment *seg = (struct llvm_segment *) data;
+
+   seg->clipped = llvm_pipeline_shade(seg->fpme, &seg->fetch_info,
+                                      &seg->vert_info);
+}
+
+
+/**
+ * Wait for the oldest segment in flight to be shaded, or shade it here if
+ * it never went to the workers, and draw it.
+ */
+static void
+llvm_finish_oldest_segment(struct llvm_middle_end *fpme)
+{
+   struct llvm_segment *seg = &fpme->segments[fpme->first_segment];
+
+   assert(fpme->num_segments);
+
+   if (seg->queued)
+      util_queue_fence_wait(&seg->fence);
+   else
+      llvm_segment_shade(seg, 0);
+
+   /* Pop the segment first, in case drawing flushes back into us. */
+   fpme->first_segment = (fpme->first_segment + 1) % LLVM_MAX_SEGMENTS;
+   fpme->num_segments--;
+
+   llvm_pipeline_draw(fpme, seg->fetch_info.count, &seg->vert_info,
+                      &seg->prim_info, seg->clipped);
+}
+
+
+static void
+llvm_finish_segments(struct llvm_middle_end *fpme)
+{
+   while (fpme->num_segments)
+      llvm_finish_oldest_segment(fpme);
+
+   fpme->draw_vertices = 0;
+}
+
+
+/**
+ * Start the worker threads, the first time a draw is big enough for them.
+ */
+static boolean
+llvm_init_queue(struct llvm_middle_end *fpme)
+{
+   if (util_queue_is_initialized(&fpme->queue))
+      return TRUE;
+
+   if (!fpme->num_threads ||
+       !util_queue_init(&fpme->queue, "draw", LLVM_MAX_SEGMENTS,
+                        fpme->num_threads, 0)) {
+      /* Keep shading everything on this thread. */
+      fpme->num_threads = 0;
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Add a segment to the ring of segments in flight.
+ */
+static void
+llvm_queue_segment(struct llvm_middle_end *fpme,
+                   const struct draw_fetch_info *fetch_info,
+                   const struct draw_prim_info *prim_info)
+{
+   struct llvm_segment *seg;
+   unsigned i;
+
+   if (fpme->num_segments == fpme->max_segments)
+      llvm_finish_oldest_segment(fpme);
+
+   seg = &fpme->segments[(fpme->first_segment + fpme->num_segments) %
+                         LLVM_MAX_SEGMENTS];
+
+   if (!llvm_alloc_vertices(fpme, fetch_info->count, &seg->vert_info))
+      return;
+
+   seg->fetch_info = *fetch_info;
+   if (fetch_info->elts) {
+      if (seg->max_fetch_elts < fetch_info->count) {
+         FREE(seg->fetch_elts);
+         seg->fetch_elts = MALLOC(fetch_info->count * sizeof(unsigned));
+         seg->max_fetch_elts = seg->fetch_elts ? fetch_info->count : 0;
+      }
+      if (!seg->fetch_elts) {
+         FREE(seg->vert_info.verts);
+         return;
+      }
+      memcpy(seg->fetch_elts, fetch_info->elts,
+             fetch_info->count * sizeof(unsigned));
+      seg->fetch_info.elts = seg->fetch_elts;
+   }
+
+   assert(prim_info->primitive_count == 1);
+   seg->prim_info = *prim_info;
+   seg->prim_length = prim_info->count;
+   seg->prim_info.primitive_lengths = &seg->prim_length;
+   if (prim_info->elts) {
+      if (seg->max_draw_elts < prim_info->count) {
+         FREE(seg->draw_elts);
+         seg->draw_elts = MALLOC(prim_info->count * sizeof(ushort));
+         seg->max_draw_elts = seg->draw_elts ? prim_info->count : 0;
+      }
+      if (!seg->draw_elts) {
+         FREE(seg->vert_info.verts);
+         return;
+      }
+      memcpy(seg->draw_elts, prim_info->elts,
+             prim_info->count * sizeof(ushort));
+      seg->prim_info.elts = seg->draw_elts;
+   }
+
+   seg->queued = FALSE;
+   fpme->num_segments++;
+   fpme->draw_vertices += fetch_info->count;
+
+   /*
+    * The segments of small draws get shaded on this thread when drained,
+    * so that they don't pay for the hand-off.  Once a draw is big enough,
+    * all its pending segments go to the workers.
+    */
+   if (fpme->num_segments > 1 &&
+       fpme->draw_vertices >= LLVM_MIN_THREADED_VERTICES &&
+       llvm_init_queue(fpme)) {
+      for (i = 0; i < fpme->num_segments; i++) {
+         struct llvm_segment *pending =
+            &fpme->segments[(fpme->first_segment + i) % LLVM_MAX_SEGMENTS];
+         if (!pending->queued) {
+            pending->queued = TRUE;
+            util_queue_add_job(&fpme->queue, pending, &pending->fence,
+                               llvm_segment_shade, NULL);
+         }
+      }
+   }
+}
+
+
+static void
+llvm_pipeline_generic(struct draw_pt_middle_end *middle,
+                      const struct draw_fetch_info *fetch_info,
+                      const struct draw_prim_info *prim_info)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   struct draw_vertex_info vert_info;
+   boolean clipped;
+
+   assert(fetch_info->count > 0);
+
+   if (fpme->max_segments) {
+      llvm_queue_segment(fpme, fetch_info, prim_info);
+      return;
+   }
+
+   if (!llvm_alloc_vertices(fpme, fetch_info->count, &vert_info))
+      return;
+
+   clipped = llvm_pipeline_shade(fpme, fetch_info, &vert_info);
+
+   llvm_pipeline_draw(fpme, fetch_info->count, &vert_info, prim_info,
+                      clipped);
+}
+
+
 static inline unsigned
 prim_type(unsigned prim, unsigned flags)
 {
@@ -595,10 +976,17 @@ llvm_middle_end_linear_run_elts(struct draw_pt_middle_end *middle,
 }
 
 
+static void
+llvm_middle_end_finish_run(struct draw_pt_middle_end *middle)
+{
+   llvm_finish_segments(llvm_middle_end(middle));
+}
+
+
 static void
 llvm_middle_end_finish(struct draw_pt_middle_end *middle)
 {
-   /* nothing to do */
+   llvm_finish_segments(llvm_middle_end(middle));
 }
 
 
@@ -606,6 +994,20 @@ static void
 llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
 {
    struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   unsigned i;
+
+   llvm_finish_segments(fpme);
+
+   if (util_queue_is_initialized(&fpme->queue))
+      util_queue_destroy(&fpme->queue);
+
+   for (i = 0; i < LLVM_MAX_SEGMENTS; i++) {
+      util_queue_fence_destroy(&fpme->segments[i].fence);
+      FREE(fpme->segments[i].fetch_elts);
+      FREE(fpme->segments[i].draw_elts);
+   }
+
+   FREE(fpme->cull_elts);
 
    if (fpme->fetch)
       draw_pt_fetch_destroy( fpme->fetch );
@@ -627,19 +1029,27 @@ struct draw_pt_middle_end *
 draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 {
    struct llvm_middle_end *fpme = 0;
+   unsigned num_threads;
+   unsigned i;
 
    if (!draw->llvm)
       return NULL;
 
    fpme = CALLOC_STRUCT( llvm_middle_end );
    if (!fpme)
-      goto fail;
+      return NULL;
+
+   for (i = 0; i < LLVM_MAX_SEGMENTS; i++) {
+      fpme->segments[i].fpme = fpme;
+      util_queue_fence_init(&fpme->segments[i].fence);
+   }
 
    fpme->base.prepare         = llvm_middle_end_prepare;
    fpme->base.bind_parameters = llvm_middle_end_bind_parameters;
    fpme->base.run             = llvm_middle_end_run;
    fpme->base.run_linear      = llvm_middle_end_linear_run;
    fpme->base.run_linear_elts = llvm_middle_end_linear_run_elts;
+   fpme->base.finish_run      = llvm_middle_end_finish_run;
    fpme->base.finish          = llvm_middle_end_finish;
    fpme->base.destroy         = llvm_middle_end_destroy;
 
@@ -667,6 +1077,22 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 
    fpme->current_variant = NULL;
 
+   fpme->early_cull = !debug_get_option_draw_no_early_cull();
+
+   /*
+    * Vertex shading of big draws is spread over worker threads, keeping
+    * two segments per thread in flight.  The threads are only started by
+    * the first big draw.
+    */
+   util_cpu_detect();
+   num_threads = debug_get_num_option("DRAW_NUM_THREADS",
+                                      util_cpu_caps.nr_cpus > 1 ?
+                                      MIN2(util_cpu_caps.nr_cpus,
+                                           LLVM_MAX_THREADS) : 0);
+   fpme->num_threads = MIN2(num_threads, LLVM_MAX_THREADS);
+   if (fpme->num_threads)
+      fpme->max_segments = MIN2(2 * fpme->num_threads, LLVM_MAX_SEGMENTS);
+
    return &fpme->base;
 
  fail:
@@ -23,6 +23,7 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 
@@ -31,7 +32,11 @@
 #include "draw/draw_pt.h"
 
 #define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+#define DRAW_ELTS_SIZE (4 * SEGMENT_SIZE)
+
+/* The vertex cache is CACHE_WAYS-way set associative, with LRU replacement */
+#define CACHE_WAYS   4
+#define CACHE_SIZE   1024
 
 /* The largest possible index within an index buffer */
 #define MAX_ELT_IDX 0xffffffff
@@ -41,22 +46,28 @@ struct vsplit_frontend {
    struct draw_context *draw;
 
    unsigned prim;
+   /* vertices per primitive of list primitives, zero otherwise */
+   unsigned list_verts;
 
    struct draw_pt_middle_end *middle;
 
    unsigned max_vertices;
    ushort segment_size;
+   ushort max_draw_elts;
 
    /* buffers for splitting */
    unsigned fetch_elts[SEGMENT_SIZE];
-   ushort draw_elts[SEGMENT_SIZE];
+   ushort draw_elts[DRAW_ELTS_SIZE];
    ushort identity_draw_elts[SEGMENT_SIZE];
 
    struct {
-      /* map a fetch element to a draw element */
-      unsigned fetches[MAP_SIZE];
-      ushort draws[MAP_SIZE];
-      boolean has_max_fetch;
+      /*
+       * Map a fetch element to a draw element.  An entry is only valid when
+       * it points to a fetch element of the current segment which has the
+       * same value, so stale entries never need clearing.
+       */
+      ushort *draws;
+      unsigned set_mask;
 
       ushort num_fetch_elts;
       ushort num_draw_elts;
@@ -67,8 +78,6 @@ struct vsplit_frontend {
 static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
-   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
-   vsplit->cache.has_max_fetch = FALSE;
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
 }
@@ -76,6 +85,11 @@ vsplit_clear_cache(struct vsplit_frontend *vsplit)
 static void
 vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 {
+   struct draw_context *draw = vsplit->draw;
+
+   draw->pt.vcache_stats.num_indices += vsplit->cache.num_draw_elts;
+   draw->pt.vcache_stats.num_shaded += vsplit->cache.num_fetch_elts;
+
    vsplit->middle->run(vsplit->middle,
          vsplit->fetch_elts, vsplit->cache.num_fetch_elts,
          vsplit->draw_elts, vsplit->cache.num_draw_elts, flags);
@@ -87,23 +101,36 @@ vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 static inline void
 vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch)
 {
-   unsigned hash;
-
-   hash = fetch % MAP_SIZE;
-
-   /* If the value isn't in the cache or it's an overflow due to the
-    * element bias */
-   if (vsplit->cache.fetches[hash] != fetch) {
-      /* update cache */
-      vsplit->cache.fetches[hash] = fetch;
-      vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
-
-      /* add fetch */
-      assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
-      vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
+   ushort *set = vsplit->cache.draws +
+      (fetch & vsplit->cache.set_mask) * CACHE_WAYS;
+   ushort draw = set[0];
+   unsigned way;
+
+   if (draw >= vsplit->cache.num_fetch_elts ||
+       vsplit->fetch_elts[draw] != fetch) {
+      /* look for it in the other ways, shifting the more recent ones down */
+      for (way = 1; way < CACHE_WAYS; way++) {
+         const ushort prev = draw;
+
+         draw = set[way];
+         set[way] = prev;
+         if (draw < vsplit->cache.num_fetch_elts &&
+             vsplit->fetch_elts[draw] == fetch)
+            break;
+      }
+
+      if (way == CACHE_WAYS) {
+         /* miss, the least recently used entry was evicted */
+         draw = vsplit->cache.num_fetch_elts;
+
+         assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
+         vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
+      }
+
+      set[0] = draw;
    }
 
-   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = vsplit->cache.draws[hash];
+   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = draw;
 }
 
 /**
@@ -125,12 +152,6 @@ vsplit_add_cache_ubyte(struct vsplit_frontend *vsplit, const ubyte *elts,
    unsigned elt_idx;
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* unlike the uint case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -142,12 +163,6 @@ vsplit_add_cache_ushort(struct vsplit_frontend *vsplit, const ushort *elts,
    unsigned elt_idx;
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* unlike the uint case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -167,13 +182,6 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, const uint *elts,
     */
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* Take care for DRAW_MAX_FETCH_IDX (since cache is initialized to -1). */
-   if (elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      /* force update - any value will do except DRAW_MAX_FETCH_IDX */
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -203,6 +211,7 @@ static void vsplit_prepare(struct draw_pt_front_end *frontend,
                            unsigned opt)
 {
    struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;
+   unsigned first, incr;
 
    switch (vsplit->draw->pt.user.eltSize) {
    case 0:
@@ -225,10 +234,14 @@ static void vsplit_prepare(struct draw_pt_front_end *frontend,
    /* split only */
    vsplit->prim = in_prim;
 
+   draw_pt_split_prim(in_prim, &first, &incr);
+   vsplit->list_verts = first == incr ? first : 0;
+
    vsplit->middle = middle;
    middle->prepare(middle, vsplit->prim, opt, &vsplit->max_vertices);
 
    vsplit->segment_size = MIN2(SEGMENT_SIZE, vsplit->max_vertices);
+   vsplit->max_draw_elts = MIN2(DRAW_ELTS_SIZE, vsplit->max_vertices);
 }
 
 
@@ -245,6 +258,9 @@ static void vsplit_flush(struct draw_pt_front_end *frontend, unsigned flags)
 
 static void vsplit_destroy(struct draw_pt_front_end *frontend)
 {
+   struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;
+
+   FREE(vsplit->cache.draws);
    FREE(frontend);
 }
 
@@ -252,11 +268,24 @@ static void vsplit_destroy(struct draw_pt_front_end *frontend)
 struct draw_pt_front_end *draw_pt_vsplit(struct draw_context *draw)
 {
    struct vsplit_frontend *vsplit = CALLOC_STRUCT(vsplit_frontend);
+   unsigned cache_size;
    ushort i;
 
    if (!vsplit)
       return NULL;
 
+   /* number of cached vertices, there is no point in exceeding a segment */
+   cache_size = debug_get_num_option("DRAW_VERTEX_CACHE_SIZE", CACHE_SIZE);
+   cache_size = util_next_power_of_two(CLAMP(cache_size,
+                                             CACHE_WAYS, SEGMENT_SIZE));
+
+   vsplit->cache.draws = CALLOC(cache_size, sizeof(ushort));
+   if (!vsplit->cache.draws) {
+      FREE(vsplit);
+      return NULL;
+   }
+   vsplit->cache.set_mask = cache_size / CACHE_WAYS - 1;
+
    vsplit->base.prepare = vsplit_prepare;
    vsplit->base.run     = NULL;
    vsplit->base.flush   = vsplit_flush;
@@ -117,9 +117,15 @@ CONCAT(vsplit_primitive_, ELT_TYPE)(struct vsplit_frontend *vsplit,
       draw_elts = vsplit->draw_elts;
    }
 
-   return vsplit->middle->run_linear_elts(vsplit->middle,
-                                          fetch_start, fetch_count,
-                                          draw_elts, icount, 0x0);
+   if (!vsplit->middle->run_linear_elts(vsplit->middle,
+                                        fetch_start, fetch_count,
+                                        draw_elts, icount, 0x0))
+      return FALSE;
+
+   draw->pt.vcache_stats.num_indices += icount;
+   draw->pt.vcache_stats.num_shaded += fetch_count;
+
+   return TRUE;
 }
 
 /**
@@ -170,14 +176,58 @@ CONCAT(vsplit_segment_cache_, ELT_TYPE)(struct vsplit_frontend *vsplit,
    vsplit_flush_cache(vsplit, flags);
 }
 
+/**
+ * Use the cache to prepare the fetch and draw elements of a list of
+ * primitives, and flush whenever the next primitive might not fit.
+ *
+ * The segments are sized by the number of vertices to shade rather than by
+ * the number of indices, so that indexed meshes with good locality shade
+ * each vertex about once.
+ */
+static inline void
+CONCAT(vsplit_segment_list_, ELT_TYPE)(struct vsplit_frontend *vsplit,
+                                       unsigned flags,
+                                       unsigned istart, unsigned icount)
+{
+   struct draw_context *draw = vsplit->draw;
+   const ELT_TYPE *ib = (const ELT_TYPE *) draw->pt.user.elts;
+   const int ibias = draw->pt.user.eltBias;
+   const unsigned verts = vsplit->list_verts;
+   unsigned i, j;
+
+   assert(icount % verts == 0);
+   assert(icount <= vsplit->max_draw_elts);
+
+   vsplit_clear_cache(vsplit);
+
+   for (i = 0; i < icount; i += verts) {
+      if (vsplit->cache.num_fetch_elts + verts > vsplit->segment_size) {
+         vsplit_flush_cache(vsplit, flags | DRAW_SPLIT_AFTER);
+         vsplit_clear_cache(vsplit);
+
+         flags |= DRAW_SPLIT_BEFORE;
+      }
+
+      for (j = 0; j < verts; j++)
+         ADD_CACHE(vsplit, ib, istart, i + j, ibias);
+   }
+
+   vsplit_flush_cache(vsplit, flags);
+}
+
 static void
 CONCAT(vsplit_segment_simple_, ELT_TYPE)(struct vsplit_frontend *vsplit,
                                          unsigned flags,
                                          unsigned istart,
                                          unsigned icount)
 {
-   CONCAT(vsplit_segment_cache_, ELT_TYPE)(vsplit,
-         flags, istart, icount, FALSE, 0, FALSE, 0);
+   if (vsplit->list_verts) {
+      CONCAT(vsplit_segment_list_, ELT_TYPE)(vsplit, flags, istart, icount);
+   }
+   else {
+      CONCAT(vsplit_segment_cache_, ELT_TYPE)(vsplit,
+            flags, istart, icount, FALSE, 0, FALSE, 0);
+   }
 }
 
 static void
@@ -209,7 +259,8 @@ CONCAT(vsplit_segment_fan_, ELT_TYPE)(struct vsplit_frontend *vsplit,
 #define LOCAL_VARS                                                         \
    struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;   \
    const unsigned prim = vsplit->prim;                                     \
-   const unsigned max_count_simple = vsplit->segment_size;                 \
+   const unsigned max_count_simple =                                       \
+      vsplit->list_verts ? vsplit->max_draw_elts : vsplit->segment_size;   \
    const unsigned max_count_loop = vsplit->segment_size - 1;               \
    const unsigned max_count_fan = vsplit->segment_size;
 
@@ -46,6 +46,8 @@
 #include "tgsi/tgsi_dump.h"
 #include "tgsi/tgsi_exec.h"
 
+#include "compiler/nir/nir.h"
+
 DEBUG_GET_ONCE_BOOL_OPTION(gallium_dump_vs, "GALLIUM_DUMP_VS", FALSE)
 
 
@@ -56,7 +58,10 @@ draw_create_vertex_shader(struct draw_context *draw,
    struct draw_vertex_shader *vs = NULL;
 
    if (draw->dump_vs) {
-      tgsi_dump(shader->tokens, 0);
+      if (shader->type == PIPE_SHADER_IR_NIR)
+         nir_print_shader(shader->ir.nir, stderr);
+      else
+         tgsi_dump(shader->tokens, 0);
    }
 
 #if HAVE_LLVM
@@ -65,7 +70,8 @@ draw_create_vertex_shader(struct draw_context *draw,
    }
 #endif
 
-   if (!vs) {
+   /* NIR can only be run through LLVM */
+   if (!vs && shader->type == PIPE_SHADER_IR_TGSI) {
       vs = draw_create_vs_exec( draw, shader );
    }
 
@@ -204,7 +204,7 @@ static inline int draw_vs_variant_key_compare( const struct draw_vs_variant_key
 }
 
 
-#define MAX_TGSI_VERTICES 4
+#define MAX_TGSI_VERTICES TGSI_EXEC_WIDTH
    
 
 
@@ -109,7 +109,7 @@ vs_exec_run_linear(struct draw_vertex_shader *shader,
    if (shader->info.uses_instanceid) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_INSTANCEID];
       assert(i < ARRAY_SIZE(machine->SystemValue));
-      for (j = 0; j < TGSI_QUAD_SIZE; j++)
+      for (j = 0; j < TGSI_EXEC_WIDTH; j++)
          machine->SystemValue[i].xyzw[0].i[j] = shader->draw->instance_id;
    }
 
@@ -163,7 +163,7 @@ vs_exec_run_linear(struct draw_vertex_shader *shader,
          input = (const float (*)[4])((const char *)input + input_stride);
       }
 
-      machine->NonHelperMask = (1 << max_vertices) - 1;
+      machine->NonHelperMask = TGSI_EXEC_MASK >> (TGSI_EXEC_WIDTH - max_vertices);
       /* run interpreter */
       tgsi_exec_machine_run(machine, 0);
 
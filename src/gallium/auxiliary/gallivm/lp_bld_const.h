@@ -141,6 +141,12 @@ lp_build_const_int_pointer(struct gallivm_state *gallivm, const void *ptr)
    LLVMTypeRef int_type;
    LLVMValueRef v;
 
+   /* Host addresses are only valid in this process, so code embedding
+    * them must not be stored persistently.
+    */
+   if (gallivm->cache)
+      gallivm->cache->dont_cache = true;
+
    /* int type large enough to hold a pointer */
    int_type = LLVMIntTypeInContext(gallivm->context, 8 * sizeof(void *));
    v = LLVMConstInt(int_type, (uintptr_t) ptr, 0);
@@ -0,0 +1,283 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+#include "pipe/p_config.h"
+
+#include "lp_bld_coro.h"
+#include "lp_bld_type.h"
+#include "lp_bld_init.h"
+#include "lp_bld_intr.h"
+#include "lp_bld_const.h"
+
+
+#if GALLIVM_HAVE_CORO
+
+
+static LLVMTypeRef
+coro_ptr_type(struct gallivm_state *gallivm)
+{
+   return LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+}
+
+
+LLVMValueRef
+lp_build_coro_id(struct gallivm_state *gallivm)
+{
+   LLVMValueRef coro_id_args[4];
+
+   coro_id_args[0] = lp_build_const_int32(gallivm, 0);
+   coro_id_args[1] = LLVMConstPointerNull(coro_ptr_type(gallivm));
+   coro_id_args[2] = coro_id_args[1];
+   coro_id_args[3] = coro_id_args[1];
+   return lp_build_intrinsic(gallivm->builder, "llvm.coro.id",
+                             LLVMTokenTypeInContext(gallivm->context),
+                             coro_id_args, 4, 0);
+}
+
+
+LLVMValueRef
+lp_build_coro_size(struct gallivm_state *gallivm)
+{
+   return lp_build_intrinsic(gallivm->builder, "llvm.coro.size.i32",
+                             LLVMInt32TypeInContext(gallivm->context),
+                             NULL, 0, 0);
+}
+
+
+LLVMValueRef
+lp_build_coro_begin(struct gallivm_state *gallivm,
+                    LLVMValueRef coro_id, LLVMValueRef mem_ptr)
+{
+   LLVMValueRef coro_begin_args[2];
+
+   coro_begin_args[0] = coro_id;
+   coro_begin_args[1] = mem_ptr;
+   return lp_build_intrinsic(gallivm->builder, "llvm.coro.begin",
+                             coro_ptr_type(gallivm),
+                             coro_begin_args, 2, 0);
+}
+
+
+LLVMValueRef
+lp_build_coro_free(struct gallivm_state *gallivm,
+                   LLVMValueRef coro_id, LLVMValueRef coro_hdl)
+{
+   LLVMValueRef coro_free_args[2];
+
+   coro_free_args[0] = coro_id;
+   coro_free_args[1] = coro_hdl;
+   return lp_build_intrinsic(gallivm->builder, "llvm.coro.free",
+                             coro_ptr_type(gallivm),
+                             coro_free_args, 2, 0);
+}
+
+
+void
+lp_build_coro_end(struct gallivm_state *gallivm, LLVMValueRef coro_hdl)
+{
+   LLVMValueRef coro_end_args[2];
+
+   coro_end_args[0] = coro_hdl;
+   coro_end_args[1] = LLVMConstInt(LLVMInt1TypeInContext(gallivm->context),
+                                   0, 0);
+   lp_build_intrinsic(gallivm->builder, "llvm.coro.end",
+                      LLVMInt1TypeInContext(gallivm->context),
+                      coro_end_args, 2, 0);
+}
+
+
+void
+lp_build_coro_resume(struct gallivm_state *gallivm, LLVMValueRef coro_hdl)
+{
+   lp_build_intrinsic(gallivm->builder, "llvm.coro.resume",
+                      LLVMVoidTypeInContext(gallivm->context),
+                      &coro_hdl, 1, 0);
+}
+
+
+void
+lp_build_coro_destroy(struct gallivm_state *gallivm, LLVMValueRef coro_hdl)
+{
+   lp_build_intrinsic(gallivm->builder, "llvm.coro.destroy",
+                      LLVMVoidTypeInContext(gallivm->context),
+                      &coro_hdl, 1, 0);
+}
+
+
+LLVMValueRef
+lp_build_coro_done(struct gallivm_state *gallivm, LLVMValueRef coro_hdl)
+{
+   return lp_build_intrinsic(gallivm->builder, "llvm.coro.done",
+                             LLVMInt1TypeInContext(gallivm->context),
+                             &coro_hdl, 1, 0);
+}
+
+
+/**
+ * Emit a suspend point.  The result is 0 when the coroutine gets resumed,
+ * 1 when it gets destroyed, and -1 when it just got suspended.
+ */
+LLVMValueRef
+lp_build_coro_suspend(struct gallivm_state *gallivm, boolean last)
+{
+   LLVMValueRef coro_susp_args[2];
+
+   coro_susp_args[0] = LLVMConstNull(LLVMTokenTypeInContext(gallivm->context));
+   coro_susp_args[1] = LLVMConstInt(LLVMInt1TypeInContext(gallivm->context),
+                                    last, 0);
+   return lp_build_intrinsic(gallivm->builder, "llvm.coro.suspend",
+                             LLVMInt8TypeInContext(gallivm->context),
+                             coro_susp_args, 2, 0);
+}
+
+
+/**
+ * The coroutine frame holds the values live across suspend points, which
+ * include vectors with the native vector alignment, so it must be
+ * allocated with at least that alignment.  malloc() only guarantees 16
+ * bytes.
+ */
+#define CORO_FRAME_ALIGNMENT 64
+
+
+/**
+ * Get a C library function by name.  Calls by name, rather than through
+ * function pointer constants, keep the code cacheable.
+ */
+static LLVMValueRef
+coro_get_libc_function(struct gallivm_state *gallivm, const char *name,
+                       LLVMTypeRef ret_type,
+                       LLVMTypeRef *arg_types, unsigned num_args)
+{
+   LLVMValueRef function = LLVMGetNamedFunction(gallivm->module, name);
+
+   if (!function) {
+      function = LLVMAddFunction(gallivm->module, name,
+                                 LLVMFunctionType(ret_type, arg_types,
+                                                  num_args, 0));
+      LLVMSetFunctionCallConv(function, LLVMCCallConv);
+      LLVMSetLinkage(function, LLVMExternalLinkage);
+   }
+   return function;
+}
+
+
+/**
+ * Allocate the coroutine frame and begin the coroutine.
+ * Returns the coroutine handle.
+ */
+LLVMValueRef
+lp_build_coro_begin_alloc_mem(struct gallivm_state *gallivm,
+                              LLVMValueRef coro_id)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef size_type = LLVMIntPtrTypeInContext(gallivm->context,
+                                                   gallivm->target);
+   LLVMValueRef align = LLVMConstInt(size_type, CORO_FRAME_ALIGNMENT, 0);
+   LLVMValueRef coro_size = lp_build_coro_size(gallivm);
+   LLVMValueRef args[2], alloc_mem;
+   LLVMTypeRef arg_types[2];
+
+   /* aligned_alloc() wants a multiple of the alignment */
+   coro_size = LLVMBuildZExt(builder, coro_size, size_type, "");
+   coro_size = LLVMBuildAdd(builder, coro_size,
+                            LLVMConstInt(size_type,
+                                         CORO_FRAME_ALIGNMENT - 1, 0), "");
+   coro_size = LLVMBuildAnd(builder, coro_size,
+                            LLVMConstInt(size_type,
+                                         ~(uint64_t)(CORO_FRAME_ALIGNMENT - 1),
+                                         0), "");
+
+   arg_types[0] = arg_types[1] = size_type;
+#if defined(PIPE_OS_WINDOWS)
+   args[0] = coro_size;
+   args[1] = align;
+   alloc_mem = LLVMBuildCall(builder,
+                             coro_get_libc_function(gallivm, "_aligned_malloc",
+                                                    coro_ptr_type(gallivm),
+                                                    arg_types, 2),
+                             args, 2, "coro_mem");
+#else
+   args[0] = align;
+   args[1] = coro_size;
+   alloc_mem = LLVMBuildCall(builder,
+                             coro_get_libc_function(gallivm, "aligned_alloc",
+                                                    coro_ptr_type(gallivm),
+                                                    arg_types, 2),
+                             args, 2, "coro_mem");
+#endif
+   return lp_build_coro_begin(gallivm, coro_id, alloc_mem);
+}
+
+
+void
+lp_build_coro_free_mem(struct gallivm_state *gallivm,
+                       LLVMValueRef coro_id, LLVMValueRef coro_hdl)
+{
+   LLVMValueRef alloc_mem = lp_build_coro_free(gallivm, coro_id, coro_hdl);
+   LLVMTypeRef ptr_type = coro_ptr_type(gallivm);
+
+   LLVMBuildCall(gallivm->builder,
+#if defined(PIPE_OS_WINDOWS)
+                 coro_get_libc_function(gallivm, "_aligned_free",
+                                        LLVMVoidTypeInContext(gallivm->context),
+                                        &ptr_type, 1),
+#else
+                 coro_get_libc_function(gallivm, "free",
+                                        LLVMVoidTypeInContext(gallivm->context),
+                                        &ptr_type, 1),
+#endif
+                 &alloc_mem, 1, "");
+}
+
+
+/**
+ * Emit a suspend point, and branch on its result: to resume_block when
+ * resumed, to the cleanup block when destroyed and to the suspend block
+ * otherwise.  The final suspend point has no resume block.
+ */
+void
+lp_build_coro_suspend_switch(struct gallivm_state *gallivm,
+                             const struct lp_build_coro_suspend_info *sus_info,
+                             LLVMBasicBlockRef resume_block,
+                             boolean final_suspend)
+{
+   LLVMTypeRef int8_type = LLVMInt8TypeInContext(gallivm->context);
+   LLVMValueRef coro_suspend = lp_build_coro_suspend(gallivm, final_suspend);
+   LLVMValueRef coro_switch;
+
+   coro_switch = LLVMBuildSwitch(gallivm->builder, coro_suspend,
+                                 sus_info->suspend, resume_block ? 2 : 1);
+   LLVMAddCase(coro_switch, LLVMConstInt(int8_type, 1, 0), sus_info->cleanup);
+   if (resume_block)
+      LLVMAddCase(coro_switch, LLVMConstInt(int8_type, 0, 0), resume_block);
+}
+
+
+#endif /* GALLIVM_HAVE_CORO */
@@ -42,6 +42,7 @@
 #include "lp_bld_format.h"
 #include "lp_bld_arit.h"
 #include "lp_bld_pack.h"
+#include "lp_bld_flow.h"
 
 
 static void
@@ -858,3 +859,200 @@ lp_build_fetch_rgba_soa(struct gallivm_state *gallivm,
       convert_to_soa(gallivm, aos_fetch, rgba_out, type);
    }
 }
+
+
+/**
+ * Convert a SoA channel to its bits in a texel of a plain format, shifted
+ * to their position in the 32 bit word of the texel which holds them.
+ */
+static LLVMValueRef
+pack_channel_soa(struct gallivm_state *gallivm,
+                 const struct util_format_channel_description *chan,
+                 struct lp_type type,
+                 LLVMValueRef src)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type int_type = lp_int_type(type);
+   struct lp_type uint_type = lp_uint_type(type);
+   struct lp_build_context bld, int_bld, uint_bld;
+   LLVMValueRef val;
+
+   lp_build_context_init(&bld, gallivm, type);
+   lp_build_context_init(&int_bld, gallivm, int_type);
+   lp_build_context_init(&uint_bld, gallivm, uint_type);
+
+   switch (chan->type) {
+   case UTIL_FORMAT_TYPE_FLOAT:
+      if (chan->size == 32) {
+         val = LLVMBuildBitCast(builder, src, uint_bld.vec_type, "");
+      }
+      else {
+         assert(chan->size == 16);
+         val = lp_build_float_to_half(gallivm, src);
+         val = LLVMBuildZExt(builder, val, uint_bld.vec_type, "");
+      }
+      break;
+   case UTIL_FORMAT_TYPE_UNSIGNED:
+      if (chan->pure_integer) {
+         val = LLVMBuildBitCast(builder, src, uint_bld.vec_type, "");
+         if (chan->size < 32) {
+            val = lp_build_min(&uint_bld, val,
+                               lp_build_const_int_vec(gallivm, uint_type,
+                                                      (1u << chan->size) - 1));
+         }
+      }
+      else {
+         assert(chan->normalized);
+         val = lp_build_clamp_zero_one_nanzero(&bld, src);
+         val = lp_build_clamped_float_to_unsigned_norm(gallivm, type,
+                                                       chan->size, val);
+      }
+      break;
+   case UTIL_FORMAT_TYPE_SIGNED:
+      if (chan->pure_integer) {
+         val = LLVMBuildBitCast(builder, src, int_bld.vec_type, "");
+         if (chan->size < 32) {
+            int max = (1 << (chan->size - 1)) - 1;
+            val = lp_build_clamp(&int_bld, val,
+                                 lp_build_const_int_vec(gallivm, int_type,
+                                                        -max - 1),
+                                 lp_build_const_int_vec(gallivm, int_type,
+                                                        max));
+         }
+      }
+      else {
+         assert(chan->normalized);
+         val = lp_build_clamp(&bld, src,
+                              lp_build_const_vec(gallivm, type, -1.0),
+                              bld.one);
+         val = lp_build_mul(&bld, val,
+                            lp_build_const_vec(gallivm, type,
+                                               (1 << (chan->size - 1)) - 1));
+         val = lp_build_iround(&bld, val);
+      }
+      val = LLVMBuildBitCast(builder, val, uint_bld.vec_type, "");
+      if (chan->size < 32) {
+         val = LLVMBuildAnd(builder, val,
+                            lp_build_const_int_vec(gallivm, uint_type,
+                                                   (1u << chan->size) - 1),
+                            "");
+      }
+      break;
+   default:
+      assert(0);
+      return uint_bld.zero;
+   }
+
+   if (chan->shift % 32) {
+      val = LLVMBuildShl(builder, val,
+                         lp_build_const_int_vec(gallivm, uint_type,
+                                                chan->shift % 32), "");
+   }
+   return val;
+}
+
+
+/**
+ * Store SoA rgba values to the texels of a plain format at the given byte
+ * offsets, for the lanes of exec_mask which are set.
+ *
+ * This is the store counterpart of lp_build_fetch_rgba_soa, for shader
+ * images: float formats take float values, pure integer formats take the
+ * integer values bitcast to type.  Values are clamped to the range of the
+ * channels.
+ *
+ * \param type  the SoA type of rgba_in, with 32 bit elements
+ * \param exec_mask  integer mask of the lanes to store
+ */
+void
+lp_build_store_rgba_soa(struct gallivm_state *gallivm,
+                        const struct util_format_description *format_desc,
+                        struct lp_type type,
+                        LLVMValueRef exec_mask,
+                        LLVMValueRef base_ptr,
+                        LLVMValueRef offset,
+                        const LLVMValueRef rgba_in[4])
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   const unsigned bits = format_desc->block.bits;
+   const unsigned num_words = MAX2(1, bits / 32);
+   struct lp_type uint_type = lp_uint_type(type);
+   LLVMValueRef packed[4];
+   struct lp_build_loop_state loop_state;
+   struct lp_build_if_state ifthen;
+   LLVMValueRef cond, ptr, index, val;
+   unsigned chan, c, w;
+
+   assert(format_desc->layout == UTIL_FORMAT_LAYOUT_PLAIN);
+   assert(format_desc->block.width == 1 && format_desc->block.height == 1);
+   assert(type.width == 32);
+   assert(bits == 8 || bits == 16 || bits == 32 || bits == 64 || bits == 128);
+
+   for (w = 0; w < num_words; w++)
+      packed[w] = lp_build_zero(gallivm, uint_type);
+
+   if (format_desc->format == PIPE_FORMAT_R11G11B10_FLOAT) {
+      LLVMValueRef rgb[3] = { rgba_in[0], rgba_in[1], rgba_in[2] };
+      packed[0] = lp_build_float_to_r11g11b10(gallivm, rgb);
+   }
+   else {
+      for (chan = 0; chan < format_desc->nr_channels; chan++) {
+         const struct util_format_channel_description *chan_desc =
+            &format_desc->channel[chan];
+         LLVMValueRef src = NULL;
+
+         for (c = 0; c < 4; c++) {
+            if (format_desc->swizzle[c] == PIPE_SWIZZLE_X + chan) {
+               src = rgba_in[c];
+               break;
+            }
+         }
+         if (!src || chan_desc->type == UTIL_FORMAT_TYPE_VOID)
+            continue;
+
+         w = chan_desc->shift / 32;
+         val = pack_channel_soa(gallivm, chan_desc, type, src);
+         packed[w] = LLVMBuildOr(builder, packed[w], val, "");
+      }
+   }
+
+   /* scatter the active lanes */
+   lp_build_loop_begin(&loop_state, gallivm, lp_build_const_int32(gallivm, 0));
+
+   cond = LLVMBuildExtractElement(builder, exec_mask, loop_state.counter, "");
+   cond = LLVMBuildICmp(builder, LLVMIntNE, cond,
+                        LLVMConstNull(LLVMTypeOf(cond)), "");
+   lp_build_if(&ifthen, gallivm, cond);
+   {
+      index = LLVMBuildExtractElement(builder, offset, loop_state.counter, "");
+      ptr = LLVMBuildGEP(builder, base_ptr, &index, 1, "");
+
+      if (bits < 32) {
+         LLVMTypeRef store_type = LLVMIntTypeInContext(gallivm->context, bits);
+
+         val = LLVMBuildExtractElement(builder, packed[0],
+                                       loop_state.counter, "");
+         val = LLVMBuildTrunc(builder, val, store_type, "");
+         ptr = LLVMBuildBitCast(builder, ptr,
+                                LLVMPointerType(store_type, 0), "");
+         LLVMBuildStore(builder, val, ptr);
+      }
+      else {
+         ptr = LLVMBuildBitCast(builder, ptr,
+                                LLVMPointerType(LLVMInt32TypeInContext(gallivm->context), 0),
+                                "");
+         for (w = 0; w < num_words; w++) {
+            index = lp_build_const_int32(gallivm, w);
+            val = LLVMBuildExtractElement(builder, packed[w],
+                                          loop_state.counter, "");
+            LLVMBuildStore(builder, val,
+                           LLVMBuildGEP(builder, ptr, &index, 1, ""));
+         }
+      }
+   }
+   lp_build_endif(&ifthen);
+
+   lp_build_loop_end_cond(&loop_state,
+                          lp_build_const_int32(gallivm, type.length),
+                          NULL, LLVMIntUGE);
+}
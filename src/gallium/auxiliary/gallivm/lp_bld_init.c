@@ -28,6 +28,7 @@
 
 #include "pipe/p_config.h"
 #include "pipe/p_compiler.h"
+#include "c11/threads.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_debug.h"
 #include "util/u_memory.h"
@@ -37,6 +38,8 @@
 #include "lp_bld_debug.h"
 #include "lp_bld_misc.h"
 #include "lp_bld_init.h"
+#include "lp_bld_type.h"
+#include "lp_bld_coro.h"
 
 #include <llvm-c/Analysis.h>
 #include <llvm-c/Transforms/Scalar.h>
@@ -44,6 +47,9 @@
 #include <llvm-c/Transforms/Utils.h>
 #endif
 #include <llvm-c/BitWriter.h>
+#if GALLIVM_HAVE_CORO
+#include <llvm-c/Transforms/Coroutines.h>
+#endif
 
 
 /* Only MCJIT is available as of LLVM SVN r216982 */
@@ -111,20 +117,64 @@ enum LLVM_CodeGenOpt_Level {
 };
 
 
+/**
+ * The optimization pass managers.  These are module pass managers, which
+ * don't hold on to any module between runs, so rather than building them
+ * for every module the idle ones are pooled and shared by all the threads.
+ */
+struct gallivm_passes
+{
+   LLVMPassManagerRef passmgr;
+   LLVMPassManagerRef cgpassmgr;  /**< coroutine passes */
+};
+
+#define GALLIVM_MAX_POOLED_PASSES 8
+
+static mtx_t passes_pool_mutex = _MTX_INITIALIZER_NP;
+static struct gallivm_passes
+passes_pool[GALLIVM_TIER_COUNT][GALLIVM_MAX_POOLED_PASSES];
+static unsigned passes_pool_size[GALLIVM_TIER_COUNT];
+
+
+static void
+destroy_pass_managers(struct gallivm_passes *passes)
+{
+   if (passes->passmgr)
+      LLVMDisposePassManager(passes->passmgr);
+   if (passes->cgpassmgr)
+      LLVMDisposePassManager(passes->cgpassmgr);
+   passes->passmgr = NULL;
+   passes->cgpassmgr = NULL;
+}
+
+
 /**
  * Create the LLVM (optimization) pass manager and install
  * relevant optimization passes.
  * \return  TRUE for success, FALSE for failure
  */
 static boolean
-create_pass_manager(struct gallivm_state *gallivm)
+create_pass_managers(struct gallivm_state *gallivm,
+                     struct gallivm_passes *passes)
 {
-   assert(!gallivm->passmgr);
    assert(gallivm->target);
 
-   gallivm->passmgr = LLVMCreateFunctionPassManagerForModule(gallivm->module);
-   if (!gallivm->passmgr)
+   passes->passmgr = LLVMCreatePassManager();
+   if (!passes->passmgr)
+      return FALSE;
+
+#if GALLIVM_HAVE_CORO
+   /* Coroutines must be split before the function passes run, whether or
+    * not optimizations are enabled.
+    */
+   passes->cgpassmgr = LLVMCreatePassManager();
+   if (!passes->cgpassmgr)
       return FALSE;
+   LLVMAddCoroEarlyPass(passes->cgpassmgr);
+   LLVMAddCoroSplitPass(passes->cgpassmgr);
+   LLVMAddCoroElidePass(passes->cgpassmgr);
+#endif
+
    /*
     * TODO: some per module pass manager with IPO passes might be helpful -
     * the generated texture functions may benefit from inlining if they are
@@ -133,18 +183,11 @@ create_pass_manager(struct gallivm_state *gallivm)
 
 #if HAVE_LLVM < 0x0309
    // Old versions of LLVM get the DataLayout from the pass manager.
-   LLVMAddTargetData(gallivm->target, gallivm->passmgr);
+   LLVMAddTargetData(gallivm->target, passes->passmgr);
 #endif
 
-   {
-      char *td_str;
-      // New ones from the Module.
-      td_str = LLVMCopyStringRepOfTargetData(gallivm->target);
-      LLVMSetDataLayout(gallivm->module, td_str);
-      free(td_str);
-   }
-
-   if ((gallivm_perf & GALLIVM_PERF_NO_OPT) == 0) {
+   if ((gallivm_perf & GALLIVM_PERF_NO_OPT) == 0 &&
+       gallivm->tier == GALLIVM_TIER_FULL) {
       /*
        * TODO: Evaluate passes some more - keeping in mind
        * both quality of generated code and compile times.
@@ -153,9 +196,9 @@ create_pass_manager(struct gallivm_state *gallivm)
        * NOTE: if you change this, don't forget to change the output
        * with GALLIVM_DEBUG_DUMP_BC in gallivm_compile_module.
        */
-      LLVMAddScalarReplAggregatesPass(gallivm->passmgr);
-      LLVMAddEarlyCSEPass(gallivm->passmgr);
-      LLVMAddCFGSimplificationPass(gallivm->passmgr);
+      LLVMAddScalarReplAggregatesPass(passes->passmgr);
+      LLVMAddEarlyCSEPass(passes->passmgr);
+      LLVMAddCFGSimplificationPass(passes->passmgr);
       /*
        * FIXME: LICM is potentially quite useful. However, for some
        * rather crazy shaders the compile time can reach _hours_ per shader,
@@ -163,25 +206,85 @@ create_pass_manager(struct gallivm_state *gallivm)
        * Even for sane shaders, the cost of licm is rather high (and not just
        * due to lcssa, licm itself too), though mostly only in cases when it
        * can actually move things, so having to disable it is a pity.
-       * LLVMAddLICMPass(gallivm->passmgr);
+       * LLVMAddLICMPass(passes->passmgr);
        */
-      LLVMAddReassociatePass(gallivm->passmgr);
-      LLVMAddPromoteMemoryToRegisterPass(gallivm->passmgr);
-      LLVMAddConstantPropagationPass(gallivm->passmgr);
-      LLVMAddInstructionCombiningPass(gallivm->passmgr);
-      LLVMAddGVNPass(gallivm->passmgr);
+      LLVMAddReassociatePass(passes->passmgr);
+      LLVMAddPromoteMemoryToRegisterPass(passes->passmgr);
+      LLVMAddConstantPropagationPass(passes->passmgr);
+      LLVMAddInstructionCombiningPass(passes->passmgr);
+      LLVMAddGVNPass(passes->passmgr);
    }
    else {
       /* We need at least this pass to prevent the backends to fail in
        * unexpected ways.
        */
-      LLVMAddPromoteMemoryToRegisterPass(gallivm->passmgr);
+      LLVMAddPromoteMemoryToRegisterPass(passes->passmgr);
+   }
+
+#if GALLIVM_HAVE_CORO
+   LLVMAddCoroCleanupPass(passes->passmgr);
+#endif
+
+   return TRUE;
+}
+
+
+/**
+ * Take pass managers from the pool, or create new ones if it is empty.
+ */
+static boolean
+get_pass_managers(struct gallivm_state *gallivm,
+                  struct gallivm_passes *passes)
+{
+   const enum gallivm_tier tier = gallivm->tier;
+   boolean found = FALSE;
+
+#if HAVE_LLVM >= 0x0309
+   mtx_lock(&passes_pool_mutex);
+   if (passes_pool_size[tier]) {
+      *passes = passes_pool[tier][--passes_pool_size[tier]];
+      found = TRUE;
+   }
+   mtx_unlock(&passes_pool_mutex);
+#endif
+
+   if (found)
+      return TRUE;
+
+   memset(passes, 0, sizeof *passes);
+   if (!create_pass_managers(gallivm, passes)) {
+      destroy_pass_managers(passes);
+      return FALSE;
    }
 
    return TRUE;
 }
 
 
+/**
+ * Return pass managers to the pool.  With older LLVM the pass managers
+ * reference the target data of their module, so they can't be reused.
+ */
+static void
+put_pass_managers(struct gallivm_state *gallivm,
+                  struct gallivm_passes *passes)
+{
+#if HAVE_LLVM >= 0x0309
+   const enum gallivm_tier tier = gallivm->tier;
+
+   mtx_lock(&passes_pool_mutex);
+   if (passes_pool_size[tier] < GALLIVM_MAX_POOLED_PASSES) {
+      passes_pool[tier][passes_pool_size[tier]++] = *passes;
+      passes = NULL;
+   }
+   mtx_unlock(&passes_pool_mutex);
+#endif
+
+   if (passes)
+      destroy_pass_managers(passes);
+}
+
+
 /**
  * Free gallivm object's LLVM allocations, but not any generated code
  * nor the gallivm object itself.
@@ -189,10 +292,6 @@ create_pass_manager(struct gallivm_state *gallivm)
 void
 gallivm_free_ir(struct gallivm_state *gallivm)
 {
-   if (gallivm->passmgr) {
-      LLVMDisposePassManager(gallivm->passmgr);
-   }
-
    if (gallivm->engine) {
       /* This will already destroy any associated module */
       LLVMDisposeExecutionEngine(gallivm->engine);
@@ -200,6 +299,16 @@ gallivm_free_ir(struct gallivm_state *gallivm)
       LLVMDisposeModule(gallivm->module);
    }
 
+   if (gallivm->cache) {
+      /* The object cache must outlive the engine which references it. */
+      if (gallivm->cache->jit_obj_cache)
+         lp_free_objcache(gallivm->cache->jit_obj_cache);
+      free(gallivm->cache->data);
+      gallivm->cache->jit_obj_cache = NULL;
+      gallivm->cache->data = NULL;
+      gallivm->cache->data_size = 0;
+   }
+
    FREE(gallivm->module_name);
 
    if (!use_mcjit) {
@@ -219,9 +328,9 @@ gallivm_free_ir(struct gallivm_state *gallivm)
    gallivm->target = NULL;
    gallivm->module = NULL;
    gallivm->module_name = NULL;
-   gallivm->passmgr = NULL;
    gallivm->context = NULL;
    gallivm->builder = NULL;
+   gallivm->cache = NULL;
 }
 
 
@@ -240,6 +349,22 @@ gallivm_free_code(struct gallivm_state *gallivm)
 }
 
 
+/**
+ * Create the execution engine for the module.
+ *
+ * Unlike the pass managers, the engine and its TargetMachine are not
+ * pooled: MCJIT takes ownership of the TargetMachine it is built with, and
+ * an engine finalizes exactly one module.  Creating the TargetMachine is
+ * cheap anyway (~150 usec with LLVM 14 on x86-64, about 5% of compiling a
+ * trivial function).
+ *
+ * Most of the fixed cost of a module is in codegen (~0.5 msec just to set
+ * up the pipeline), which is why all the functions of a fragment shader
+ * variant share one module.  Variants of different kinds (fragment, setup,
+ * draw) don't: their keys depend on different state, they are compiled on
+ * different threads and freed independently, and they are cached on disk
+ * under their own keys.
+ */
 static boolean
 init_gallivm_engine(struct gallivm_state *gallivm)
 {
@@ -248,7 +373,8 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       char *error = NULL;
       int ret;
 
-      if (gallivm_perf & GALLIVM_PERF_NO_OPT) {
+      if ((gallivm_perf & GALLIVM_PERF_NO_OPT) ||
+          gallivm->tier == GALLIVM_TIER_FAST) {
          optlevel = None;
       }
       else {
@@ -257,6 +383,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
 
       ret = lp_build_create_jit_compiler_for_module(&gallivm->engine,
                                                     &gallivm->code,
+                                                    gallivm->cache,
                                                     gallivm->module,
                                                     gallivm->memorymgr,
                                                     (unsigned) optlevel,
@@ -309,7 +436,7 @@ fail:
  */
 static boolean
 init_gallivm_state(struct gallivm_state *gallivm, const char *name,
-                   LLVMContextRef context)
+                   LLVMContextRef context, struct lp_cached_code *cache)
 {
    assert(!gallivm->context);
    assert(!gallivm->module);
@@ -318,6 +445,7 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
       return FALSE;
 
    gallivm->context = context;
+   gallivm->cache = cache;
 
    if (!gallivm->context)
       goto fail;
@@ -389,8 +517,13 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
       }
    }
 
-   if (!create_pass_manager(gallivm))
-      goto fail;
+   {
+      char *td_str;
+      // New ones from the Module.
+      td_str = LLVMCopyStringRepOfTargetData(gallivm->target);
+      LLVMSetDataLayout(gallivm->module, td_str);
+      free(td_str);
+   }
 
    return TRUE;
 
@@ -466,8 +599,12 @@ lp_build_init(void)
       lp_native_vector_width = 128;
    }
  
+   /* 512 bits (shading a whole 4x4 block per fragment shader iteration on
+    * AVX-512) is opt-in, as it is not a win on every such processor.
+    */
    lp_native_vector_width = debug_get_num_option("LP_NATIVE_VECTOR_WIDTH",
                                                  lp_native_vector_width);
+   lp_native_vector_width = MIN2(lp_native_vector_width, LP_MAX_VECTOR_WIDTH);
 
    if (lp_native_vector_width <= 128) {
       /* Hide AVX support, as often LLVM AVX intrinsics are only guarded by
@@ -519,15 +656,22 @@ lp_build_init(void)
 
 /**
  * Create a new gallivm_state object.
+ *
+ * If cache is non-NULL and already holds machine code (see
+ * lp_cached_code) the optimization passes and codegen are skipped and the
+ * cached object is loaded instead.  Otherwise the code produced by the JIT
+ * is recorded into it once the first function is jitted, so that the caller
+ * can store it persistently before calling gallivm_free_ir().
  */
 struct gallivm_state *
-gallivm_create(const char *name, LLVMContextRef context)
+gallivm_create(const char *name, LLVMContextRef context,
+               struct lp_cached_code *cache)
 {
    struct gallivm_state *gallivm;
 
    gallivm = CALLOC_STRUCT(gallivm_state);
    if (gallivm) {
-      if (!init_gallivm_state(gallivm, name, context)) {
+      if (!init_gallivm_state(gallivm, name, context, cache)) {
          FREE(gallivm);
          gallivm = NULL;
       }
@@ -581,6 +725,7 @@ gallivm_verify_function(struct gallivm_state *gallivm,
 void
 gallivm_compile_module(struct gallivm_state *gallivm)
 {
+   struct gallivm_passes passes;
    LLVMValueRef func;
    int64_t time_begin = 0;
 
@@ -607,11 +752,14 @@ gallivm_compile_module(struct gallivm_state *gallivm)
                    "[-mattr=<-mattr option(s)>]");
    }
 
+   /* The cached object already contains optimized code. */
+   if (gallivm->cache && gallivm->cache->data_size)
+      goto skip_cached;
+
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
       time_begin = os_time_get();
 
    /* Run optimization passes */
-   LLVMInitializeFunctionPassManager(gallivm->passmgr);
    func = LLVMGetFirstFunction(gallivm->module);
    while (func) {
       if (0) {
@@ -627,10 +775,16 @@ gallivm_compile_module(struct gallivm_state *gallivm)
       LLVMAddTargetDependentFunctionAttr(func, "no-frame-pointer-elim-non-leaf", "true");
 #endif
 
-      LLVMRunFunctionPassManager(gallivm->passmgr, func);
       func = LLVMGetNextFunction(func);
    }
-   LLVMFinalizeFunctionPassManager(gallivm->passmgr);
+
+   if (get_pass_managers(gallivm, &passes)) {
+#if GALLIVM_HAVE_CORO
+      LLVMRunPassManager(passes.cgpassmgr, gallivm->module);
+#endif
+      LLVMRunPassManager(passes.passmgr, gallivm->module);
+      put_pass_managers(gallivm, &passes);
+   }
 
    if (gallivm_debug & GALLIVM_DEBUG_PERF) {
       int64_t time_end = os_time_get();
@@ -640,6 +794,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
                    gallivm->module_name, time_msec);
    }
 
+skip_cached:
    if (use_mcjit) {
       /* Setting the module's DataLayout to an empty string will cause the
        * ExecutionEngine to copy to the DataLayout string from its target
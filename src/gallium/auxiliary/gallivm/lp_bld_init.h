@@ -39,17 +39,44 @@
 extern "C" {
 #endif
 
+/**
+ * Machine code for a gallivm module, either produced by the JIT or loaded
+ * from a persistent cache, so that optimization and codegen can be skipped.
+ */
+struct lp_cached_code
+{
+   void *data;
+   size_t data_size;
+   bool dont_cache;
+   void *jit_obj_cache;
+};
+
+
+/**
+ * How much optimization a module gets.  The fast tier only runs the passes
+ * needed for codegen, and generates code at -O0 (with FastISel), for when
+ * compile latency matters more than the quality of the code.
+ */
+enum gallivm_tier
+{
+   GALLIVM_TIER_FULL = 0,
+   GALLIVM_TIER_FAST,
+   GALLIVM_TIER_COUNT
+};
+
+
 struct gallivm_state
 {
    char *module_name;
    LLVMModuleRef module;
    LLVMExecutionEngineRef engine;
    LLVMTargetDataRef target;
-   LLVMPassManagerRef passmgr;
    LLVMContextRef context;
    LLVMBuilderRef builder;
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
+   struct lp_cached_code *cache;
+   enum gallivm_tier tier;  /**< set before gallivm_compile_module() */
    unsigned compiled;
 };
 
@@ -59,7 +86,8 @@ lp_build_init(void);
 
 
 struct gallivm_state *
-gallivm_create(const char *name, LLVMContextRef context);
+gallivm_create(const char *name, LLVMContextRef context,
+               struct lp_cached_code *cache);
 
 void
 gallivm_destroy(struct gallivm_state *gallivm);
@@ -0,0 +1,1917 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * NIR to LLVM IR translation: control flow walk and ALU instructions.
+ */
+
+#include "lp_bld_nir.h"
+#include "lp_bld_arit.h"
+#include "lp_bld_bitarit.h"
+#include "lp_bld_const.h"
+#include "lp_bld_conv.h"
+#include "lp_bld_debug.h"
+#include "lp_bld_flow.h"
+#include "lp_bld_init.h"
+#include "lp_bld_intr.h"
+#include "lp_bld_logic.h"
+#include "lp_bld_quad.h"
+
+#include "compiler/blob.h"
+#include "nir_serialize.h"
+#include "util/mesa-sha1.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+
+static void visit_cf_list(struct lp_build_nir_context *bld_base,
+                          struct exec_list *list);
+
+
+static LLVMValueRef
+cast_type(struct lp_build_nir_context *bld_base, LLVMValueRef val,
+          nir_alu_type alu_type, unsigned bit_size)
+{
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+
+   switch (nir_alu_type_get_base_type(alu_type)) {
+   case nir_type_float:
+      return LLVMBuildBitCast(builder, val,
+                              get_flt_bld(bld_base, bit_size)->vec_type, "");
+   case nir_type_int:
+      return LLVMBuildBitCast(builder, val,
+                              get_int_bld(bld_base, FALSE, bit_size)->vec_type,
+                              "");
+   default:
+      return LLVMBuildBitCast(builder, val,
+                              get_int_bld(bld_base, TRUE, bit_size)->vec_type,
+                              "");
+   }
+}
+
+
+/** Registers are kept as unsigned integers of their bit size */
+static struct lp_build_context *
+get_reg_bld(struct lp_build_nir_context *bld_base, const nir_register *reg)
+{
+   assert(reg->bit_size == 32 || reg->bit_size == 64);
+   return get_int_bld(bld_base, TRUE, reg->bit_size);
+}
+
+
+static void
+get_src(struct lp_build_nir_context *bld_base, nir_src src,
+        LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   unsigned i;
+
+   if (src.is_ssa) {
+      for (i = 0; i < src.ssa->num_components; i++)
+         result[i] = bld_base->ssa_defs[src.ssa->index *
+                                        NIR_MAX_VEC_COMPONENTS + i];
+   }
+   else {
+      LLVMValueRef indir_src = NULL;
+
+      if (src.reg.indirect) {
+         LLVMValueRef indir[NIR_MAX_VEC_COMPONENTS];
+         get_src(bld_base, *src.reg.indirect, indir);
+         indir_src = cast_type(bld_base, indir[0], nir_type_uint, 32);
+      }
+      bld_base->load_reg(bld_base, get_reg_bld(bld_base, src.reg.reg),
+                         &src.reg, indir_src,
+                         bld_base->regs[src.reg.reg->index], result);
+   }
+}
+
+
+/** Get the first component of a source, which must be scalar */
+static LLVMValueRef
+get_src_scalar(struct lp_build_nir_context *bld_base, nir_src src)
+{
+   LLVMValueRef values[NIR_MAX_VEC_COMPONENTS];
+
+   get_src(bld_base, src, values);
+   return values[0];
+}
+
+
+static void
+assign_dest(struct lp_build_nir_context *bld_base, const nir_dest *dest,
+            unsigned writemask, LLVMValueRef vals[NIR_MAX_VEC_COMPONENTS])
+{
+   unsigned i;
+
+   if (dest->is_ssa) {
+      for (i = 0; i < dest->ssa.num_components; i++)
+         bld_base->ssa_defs[dest->ssa.index * NIR_MAX_VEC_COMPONENTS + i] =
+            vals[i];
+   }
+   else {
+      LLVMValueRef indir_src = NULL;
+
+      if (dest->reg.indirect) {
+         LLVMValueRef indir[NIR_MAX_VEC_COMPONENTS];
+         get_src(bld_base, *dest->reg.indirect, indir);
+         indir_src = cast_type(bld_base, indir[0], nir_type_uint, 32);
+      }
+      bld_base->store_reg(bld_base, get_reg_bld(bld_base, dest->reg.reg),
+                          &dest->reg, writemask, indir_src,
+                          bld_base->regs[dest->reg.reg->index], vals);
+   }
+}
+
+
+static void
+assign_dest_all(struct lp_build_nir_context *bld_base, const nir_dest *dest,
+                LLVMValueRef vals[NIR_MAX_VEC_COMPONENTS])
+{
+   assign_dest(bld_base, dest,
+               (1 << nir_dest_num_components(*dest)) - 1, vals);
+}
+
+
+/**
+ * Fetch the components of an ALU source, swizzled, and cast to the type
+ * the opcode expects.
+ */
+static void
+get_alu_src(struct lp_build_nir_context *bld_base,
+            const nir_alu_instr *instr,
+            unsigned src_idx,
+            unsigned num_components,
+            LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   const nir_alu_src *src = &instr->src[src_idx];
+   const unsigned bit_size = nir_src_bit_size(src->src);
+   const nir_alu_type type = nir_op_infos[instr->op].input_types[src_idx];
+   LLVMValueRef value[NIR_MAX_VEC_COMPONENTS];
+   unsigned i;
+
+   /* Source modifiers are only produced by nir_lower_to_source_mods(). */
+   assert(!src->abs && !src->negate);
+
+   get_src(bld_base, src->src, value);
+   for (i = 0; i < num_components; i++)
+      result[i] = cast_type(bld_base, value[src->swizzle[i]], type, bit_size);
+}
+
+
+/**
+ * Comparisons produce 32-bit booleans whatever the size of the operands,
+ * as nir_lower_bool_to_int32() leaves them.
+ */
+static LLVMValueRef
+bool_result(struct lp_build_nir_context *bld_base,
+            unsigned src_bit_size, LLVMValueRef result)
+{
+   if (src_bit_size == 64)
+      result = LLVMBuildTrunc(bld_base->base.gallivm->builder, result,
+                              bld_base->int_bld.vec_type, "");
+   return result;
+}
+
+
+static LLVMValueRef
+fcmp32(struct lp_build_nir_context *bld_base,
+       enum pipe_compare_func compare,
+       unsigned src_bit_size,
+       LLVMValueRef src[NIR_MAX_VEC_COMPONENTS])
+{
+   struct lp_build_context *flt_bld = get_flt_bld(bld_base, src_bit_size);
+   LLVMValueRef result;
+
+   /* Only not-equal is true when either operand is NaN. */
+   if (compare == PIPE_FUNC_NOTEQUAL)
+      result = lp_build_cmp(flt_bld, compare, src[0], src[1]);
+   else
+      result = lp_build_cmp_ordered(flt_bld, compare, src[0], src[1]);
+   return bool_result(bld_base, src_bit_size, result);
+}
+
+
+static LLVMValueRef
+icmp32(struct lp_build_nir_context *bld_base,
+       enum pipe_compare_func compare,
+       boolean is_unsigned,
+       unsigned src_bit_size,
+       LLVMValueRef src[NIR_MAX_VEC_COMPONENTS])
+{
+   struct lp_build_context *i_bld =
+      get_int_bld(bld_base, is_unsigned, src_bit_size);
+   LLVMValueRef result = lp_build_cmp(i_bld, compare, src[0], src[1]);
+
+   return bool_result(bld_base, src_bit_size, result);
+}
+
+
+/** Widen a 32-bit boolean to select between values of another size */
+static LLVMValueRef
+bool_mask(struct lp_build_nir_context *bld_base,
+          unsigned bit_size, LLVMValueRef cond)
+{
+   cond = cast_type(bld_base, cond, nir_type_int, 32);
+   if (bit_size == 64)
+      cond = LLVMBuildSExt(bld_base->base.gallivm->builder, cond,
+                           bld_base->int64_bld.vec_type, "");
+   return cond;
+}
+
+
+/**
+ * Integer division and remainder.  Division by zero must not trap, so the
+ * divisor is replaced by ~0 in those channels, and the results follow the
+ * TGSI conventions: ~0 for unsigned division and remainders, 0 for signed
+ * division.
+ */
+static LLVMValueRef
+do_int_divide(struct lp_build_nir_context *bld_base,
+              boolean is_unsigned, unsigned src_bit_size,
+              LLVMValueRef src, LLVMValueRef src2)
+{
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   struct lp_build_context *int_bld =
+      get_int_bld(bld_base, is_unsigned, src_bit_size);
+   struct lp_build_context *mask_bld =
+      get_int_bld(bld_base, TRUE, src_bit_size);
+   LLVMValueRef div_mask = lp_build_cmp(mask_bld, PIPE_FUNC_EQUAL, src2,
+                                        mask_bld->zero);
+   LLVMValueRef divisor = LLVMBuildOr(builder, div_mask, src2, "");
+   LLVMValueRef result = lp_build_div(int_bld, src, divisor);
+
+   if (is_unsigned)
+      return LLVMBuildOr(builder, div_mask, result, "");
+   else
+      return LLVMBuildAnd(builder, LLVMBuildNot(builder, div_mask, ""),
+                          result, "");
+}
+
+
+static LLVMValueRef
+do_int_mod(struct lp_build_nir_context *bld_base,
+           boolean is_unsigned, unsigned src_bit_size,
+           LLVMValueRef src, LLVMValueRef src2)
+{
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   struct lp_build_context *int_bld =
+      get_int_bld(bld_base, is_unsigned, src_bit_size);
+   struct lp_build_context *mask_bld =
+      get_int_bld(bld_base, TRUE, src_bit_size);
+   LLVMValueRef div_mask = lp_build_cmp(mask_bld, PIPE_FUNC_EQUAL, src2,
+                                        mask_bld->zero);
+   LLVMValueRef divisor = LLVMBuildOr(builder, div_mask, src2, "");
+   LLVMValueRef result = lp_build_mod(int_bld, src, divisor);
+
+   return LLVMBuildOr(builder, div_mask, result, "");
+}
+
+
+/** Shift amounts are 32-bit and taken modulo the operand size */
+static LLVMValueRef
+shift_amount(struct lp_build_nir_context *bld_base,
+             unsigned bit_size, LLVMValueRef amount)
+{
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   struct lp_build_context *uint_bld = get_int_bld(bld_base, TRUE, bit_size);
+
+   amount = cast_type(bld_base, amount, nir_type_uint, 32);
+   if (bit_size == 64)
+      amount = LLVMBuildZExt(builder, amount, uint_bld->vec_type, "");
+   return lp_build_and(uint_bld, amount,
+                       lp_build_const_int_vec(bld_base->base.gallivm,
+                                              uint_bld->type, bit_size - 1));
+}
+
+
+static LLVMValueRef
+do_bit_intrinsic(struct lp_build_nir_context *bld_base,
+                 const char *name_root, LLVMValueRef src,
+                 boolean has_zero_undef_arg)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMTypeRef vec_type = bld_base->uint_bld.vec_type;
+   LLVMValueRef args[2];
+   char name[64];
+
+   lp_format_intrinsic(name, sizeof name, name_root, vec_type);
+   args[0] = src;
+   args[1] = LLVMConstInt(LLVMInt1TypeInContext(gallivm->context), 0, 0);
+   return lp_build_intrinsic(gallivm->builder, name, vec_type, args,
+                             has_zero_undef_arg ? 2 : 1, 0);
+}
+
+
+static LLVMValueRef
+split_64bit(struct lp_build_nir_context *bld_base,
+            LLVMValueRef src, boolean hi)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMValueRef shuffles[LP_MAX_VECTOR_WIDTH / 32];
+   const unsigned len = bld_base->base.type.length;
+   unsigned i;
+
+   for (i = 0; i < len; i++)
+      shuffles[i] = lp_build_const_int32(gallivm, i * 2 + (hi ? 1 : 0));
+
+   src = LLVMBuildBitCast(gallivm->builder, src,
+                          LLVMVectorType(LLVMInt32TypeInContext(gallivm->context),
+                                         len * 2), "");
+   return LLVMBuildShuffleVector(gallivm->builder, src,
+                                 LLVMGetUndef(LLVMTypeOf(src)),
+                                 LLVMConstVector(shuffles, len), "");
+}
+
+
+static LLVMValueRef
+merge_64bit(struct lp_build_nir_context *bld_base,
+            LLVMValueRef lo, LLVMValueRef hi)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMValueRef shuffles[2 * (LP_MAX_VECTOR_WIDTH / 32)];
+   const unsigned len = bld_base->base.type.length;
+   unsigned i;
+
+   for (i = 0; i < len; i++) {
+      shuffles[i * 2] = lp_build_const_int32(gallivm, i);
+      shuffles[i * 2 + 1] = lp_build_const_int32(gallivm, i + len);
+   }
+   return LLVMBuildShuffleVector(gallivm->builder, lo, hi,
+                                 LLVMConstVector(shuffles, len * 2), "");
+}
+
+
+/**
+ * Translate one channel of a per-component ALU operation.
+ */
+static LLVMValueRef
+do_alu_action(struct lp_build_nir_context *bld_base,
+              nir_op op, unsigned dst_bit_size,
+              const unsigned src_bit_size[NIR_MAX_VEC_COMPONENTS],
+              LLVMValueRef src[NIR_MAX_VEC_COMPONENTS])
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *flt_bld = get_flt_bld(bld_base, src_bit_size[0]);
+   struct lp_build_context *int_bld =
+      get_int_bld(bld_base, FALSE, src_bit_size[0]);
+   struct lp_build_context *uint_bld =
+      get_int_bld(bld_base, TRUE, src_bit_size[0]);
+   LLVMValueRef result;
+
+   switch (op) {
+   case nir_op_mov:
+      result = src[0];
+      break;
+
+   /* Conversions */
+   case nir_op_b2f32:
+      result = LLVMBuildAnd(builder, src[0],
+                            LLVMBuildBitCast(builder, bld_base->base.one,
+                                             bld_base->int_bld.vec_type, ""),
+                            "");
+      result = LLVMBuildBitCast(builder, result, bld_base->base.vec_type, "");
+      break;
+   case nir_op_b2f64:
+      result = lp_build_select(&bld_base->dbl_bld,
+                               bool_mask(bld_base, 64, src[0]),
+                               bld_base->dbl_bld.one, bld_base->dbl_bld.zero);
+      break;
+   case nir_op_b2i32:
+      result = LLVMBuildAnd(builder, src[0], bld_base->int_bld.one, "");
+      break;
+   case nir_op_b2i64:
+      result = lp_build_select(&bld_base->int64_bld,
+                               bool_mask(bld_base, 64, src[0]),
+                               bld_base->int64_bld.one,
+                               bld_base->int64_bld.zero);
+      break;
+   case nir_op_f2b32:
+      result = bool_result(bld_base, src_bit_size[0],
+                           lp_build_cmp(flt_bld, PIPE_FUNC_NOTEQUAL,
+                                        src[0], flt_bld->zero));
+      break;
+   case nir_op_i2b32:
+      result = bool_result(bld_base, src_bit_size[0],
+                           lp_build_cmp(uint_bld, PIPE_FUNC_NOTEQUAL,
+                                        src[0], uint_bld->zero));
+      break;
+   case nir_op_f2f32:
+   case nir_op_f2f64:
+      if (src_bit_size[0] < dst_bit_size)
+         result = LLVMBuildFPExt(builder, src[0],
+                                 get_flt_bld(bld_base, dst_bit_size)->vec_type,
+                                 "");
+      else if (src_bit_size[0] > dst_bit_size)
+         result = LLVMBuildFPTrunc(builder, src[0],
+                                   get_flt_bld(bld_base,
+                                               dst_bit_size)->vec_type, "");
+      else
+         result = src[0];
+      break;
+   case nir_op_f2i32:
+   case nir_op_f2i64:
+      result = LLVMBuildFPToSI(builder, src[0],
+                               get_int_bld(bld_base, FALSE,
+                                           dst_bit_size)->vec_type, "");
+      break;
+   case nir_op_f2u32:
+   case nir_op_f2u64:
+      result = LLVMBuildFPToUI(builder, src[0],
+                               get_int_bld(bld_base, TRUE,
+                                           dst_bit_size)->vec_type, "");
+      break;
+   case nir_op_i2f32:
+   case nir_op_i2f64:
+      result = LLVMBuildSIToFP(builder, src[0],
+                               get_flt_bld(bld_base, dst_bit_size)->vec_type,
+                               "");
+      break;
+   case nir_op_u2f32:
+   case nir_op_u2f64:
+      result = LLVMBuildUIToFP(builder, src[0],
+                               get_flt_bld(bld_base, dst_bit_size)->vec_type,
+                               "");
+      break;
+   case nir_op_i2i32:
+   case nir_op_i2i64:
+   case nir_op_u2u32:
+   case nir_op_u2u64: {
+      struct lp_build_context *dst_bld =
+         get_int_bld(bld_base, op == nir_op_u2u32 || op == nir_op_u2u64,
+                     dst_bit_size);
+      if (src_bit_size[0] > dst_bit_size)
+         result = LLVMBuildTrunc(builder, src[0], dst_bld->vec_type, "");
+      else if (src_bit_size[0] == dst_bit_size)
+         result = src[0];
+      else if (op == nir_op_i2i64)
+         result = LLVMBuildSExt(builder, src[0], dst_bld->vec_type, "");
+      else
+         result = LLVMBuildZExt(builder, src[0], dst_bld->vec_type, "");
+      break;
+   }
+   case nir_op_unpack_64_2x32_split_x:
+      result = split_64bit(bld_base, src[0], FALSE);
+      break;
+   case nir_op_unpack_64_2x32_split_y:
+      result = split_64bit(bld_base, src[0], TRUE);
+      break;
+   case nir_op_pack_64_2x32_split:
+      result = LLVMBuildBitCast(builder, merge_64bit(bld_base, src[0], src[1]),
+                                bld_base->uint64_bld.vec_type, "");
+      break;
+   case nir_op_unpack_half_2x16_split_x:
+   case nir_op_unpack_half_2x16_split_y: {
+      LLVMTypeRef i16_vec_type =
+         LLVMVectorType(LLVMInt16TypeInContext(gallivm->context),
+                        bld_base->base.type.length);
+      result = src[0];
+      if (op == nir_op_unpack_half_2x16_split_y)
+         result = lp_build_shr_imm(&bld_base->uint_bld, result, 16);
+      result = LLVMBuildTrunc(builder, result, i16_vec_type, "");
+      result = lp_build_half_to_float(gallivm, result);
+      break;
+   }
+   case nir_op_pack_half_2x16_split: {
+      LLVMValueRef lo = lp_build_float_to_half(gallivm, src[0]);
+      LLVMValueRef hi = lp_build_float_to_half(gallivm, src[1]);
+      lo = LLVMBuildZExt(builder, lo, bld_base->uint_bld.vec_type, "");
+      hi = LLVMBuildZExt(builder, hi, bld_base->uint_bld.vec_type, "");
+      result = LLVMBuildOr(builder, lo,
+                           lp_build_shl_imm(&bld_base->uint_bld, hi, 16), "");
+      break;
+   }
+   case nir_op_fquantize2f16:
+      result = lp_build_half_to_float(gallivm,
+                                      lp_build_float_to_half(gallivm, src[0]));
+      break;
+
+   /* Floating point */
+   case nir_op_fabs:
+      result = lp_build_abs(flt_bld, src[0]);
+      break;
+   case nir_op_fneg:
+      result = lp_build_negate(flt_bld, src[0]);
+      break;
+   case nir_op_fsign:
+      result = lp_build_sgn(flt_bld, src[0]);
+      break;
+   case nir_op_fsat:
+      result = lp_build_clamp_zero_one_nanzero(flt_bld, src[0]);
+      break;
+   case nir_op_fadd:
+      result = lp_build_add(flt_bld, src[0], src[1]);
+      break;
+   case nir_op_fsub:
+      result = lp_build_sub(flt_bld, src[0], src[1]);
+      break;
+   case nir_op_fmul:
+      result = lp_build_mul(flt_bld, src[0], src[1]);
+      break;
+   case nir_op_fdiv:
+      result = lp_build_div(flt_bld, src[0], src[1]);
+      break;
+   case nir_op_frem:
+      result = lp_build_sub(flt_bld, src[0],
+                            lp_build_mul(flt_bld, src[1],
+                                         lp_build_trunc(flt_bld,
+                                                        lp_build_div(flt_bld,
+                                                                     src[0],
+                                                                     src[1]))));
+      break;
+   case nir_op_fmin:
+      result = lp_build_min_ext(flt_bld, src[0], src[1],
+                                GALLIVM_NAN_RETURN_OTHER);
+      break;
+   case nir_op_fmax:
+      result = lp_build_max_ext(flt_bld, src[0], src[1],
+                                GALLIVM_NAN_RETURN_OTHER);
+      break;
+   case nir_op_ffma:
+      result = lp_build_add(flt_bld, lp_build_mul(flt_bld, src[0], src[1]),
+                            src[2]);
+      break;
+   case nir_op_flrp:
+      result = lp_build_lerp(flt_bld, src[2], src[0], src[1], 0);
+      break;
+   case nir_op_frcp:
+      result = lp_build_rcp(flt_bld, src[0]);
+      break;
+   case nir_op_frsq:
+      result = lp_build_rsqrt(flt_bld, src[0]);
+      break;
+   case nir_op_fsqrt:
+      result = lp_build_sqrt(flt_bld, src[0]);
+      break;
+   case nir_op_fexp2:
+      result = lp_build_exp2(flt_bld, src[0]);
+      break;
+   case nir_op_flog2:
+      result = lp_build_log2_safe(flt_bld, src[0]);
+      break;
+   case nir_op_fpow:
+      result = lp_build_pow(flt_bld, src[0], src[1]);
+      break;
+   case nir_op_fsin:
+      result = lp_build_sin(flt_bld, src[0]);
+      break;
+   case nir_op_fcos:
+      result = lp_build_cos(flt_bld, src[0]);
+      break;
+   case nir_op_ftrunc:
+      result = lp_build_trunc(flt_bld, src[0]);
+      break;
+   case nir_op_fceil:
+      result = lp_build_ceil(flt_bld, src[0]);
+      break;
+   case nir_op_ffloor:
+      result = lp_build_floor(flt_bld, src[0]);
+      break;
+   case nir_op_ffract:
+      result = lp_build_fract(flt_bld, src[0]);
+      break;
+   case nir_op_fround_even:
+      result = lp_build_round(flt_bld, src[0]);
+      break;
+   case nir_op_fddx:
+   case nir_op_fddx_coarse:
+   case nir_op_fddx_fine:
+      result = lp_build_ddx(flt_bld, src[0]);
+      break;
+   case nir_op_fddy:
+   case nir_op_fddy_coarse:
+   case nir_op_fddy_fine:
+      result = lp_build_ddy(flt_bld, src[0]);
+      break;
+   case nir_op_flt32:
+      result = fcmp32(bld_base, PIPE_FUNC_LESS, src_bit_size[0], src);
+      break;
+   case nir_op_fge32:
+      result = fcmp32(bld_base, PIPE_FUNC_GEQUAL, src_bit_size[0], src);
+      break;
+   case nir_op_feq32:
+      result = fcmp32(bld_base, PIPE_FUNC_EQUAL, src_bit_size[0], src);
+      break;
+   case nir_op_fne32:
+      result = fcmp32(bld_base, PIPE_FUNC_NOTEQUAL, src_bit_size[0], src);
+      break;
+   case nir_op_fcsel:
+      result = lp_build_select(flt_bld,
+                               lp_build_cmp(flt_bld, PIPE_FUNC_NOTEQUAL,
+                                            src[0], flt_bld->zero),
+                               src[1], src[2]);
+      break;
+
+   /* Integer */
+   case nir_op_ineg:
+      result = lp_build_negate(int_bld, src[0]);
+      break;
+   case nir_op_iabs:
+      result = lp_build_abs(int_bld, src[0]);
+      break;
+   case nir_op_isign:
+      result = lp_build_sgn(int_bld, src[0]);
+      break;
+   case nir_op_inot:
+      result = lp_build_not(uint_bld, src[0]);
+      break;
+   case nir_op_iadd:
+      result = lp_build_add(int_bld, src[0], src[1]);
+      break;
+   case nir_op_isub:
+      result = lp_build_sub(int_bld, src[0], src[1]);
+      break;
+   case nir_op_imul:
+      result = lp_build_mul(int_bld, src[0], src[1]);
+      break;
+   case nir_op_idiv:
+      result = do_int_divide(bld_base, FALSE, src_bit_size[0],
+                             src[0], src[1]);
+      break;
+   case nir_op_udiv:
+      result = do_int_divide(bld_base, TRUE, src_bit_size[0],
+                             src[0], src[1]);
+      break;
+   case nir_op_umod:
+      result = do_int_mod(bld_base, TRUE, src_bit_size[0], src[0], src[1]);
+      break;
+   case nir_op_irem:
+      result = do_int_mod(bld_base, FALSE, src_bit_size[0], src[0], src[1]);
+      break;
+   case nir_op_imod: {
+      /* The remainder takes the sign of the divisor. */
+      LLVMValueRef rem = do_int_mod(bld_base, FALSE, src_bit_size[0],
+                                    src[0], src[1]);
+      LLVMValueRef adjust =
+         LLVMBuildAnd(builder,
+                      lp_build_cmp(int_bld, PIPE_FUNC_NOTEQUAL,
+                                   rem, int_bld->zero),
+                      lp_build_cmp(int_bld, PIPE_FUNC_LESS,
+                                   LLVMBuildXor(builder, rem, src[1], ""),
+                                   int_bld->zero), "");
+      result = lp_build_select(int_bld, adjust,
+                               lp_build_add(int_bld, rem, src[1]), rem);
+      break;
+   }
+   case nir_op_imin:
+      result = lp_build_min(int_bld, src[0], src[1]);
+      break;
+   case nir_op_imax:
+      result = lp_build_max(int_bld, src[0], src[1]);
+      break;
+   case nir_op_umin:
+      result = lp_build_min(uint_bld, src[0], src[1]);
+      break;
+   case nir_op_umax:
+      result = lp_build_max(uint_bld, src[0], src[1]);
+      break;
+   case nir_op_iand:
+      result = lp_build_and(uint_bld, src[0], src[1]);
+      break;
+   case nir_op_ior:
+      result = lp_build_or(uint_bld, src[0], src[1]);
+      break;
+   case nir_op_ixor:
+      result = lp_build_xor(uint_bld, src[0], src[1]);
+      break;
+   case nir_op_ishl:
+      result = lp_build_shl(int_bld, src[0],
+                            shift_amount(bld_base, src_bit_size[0], src[1]));
+      break;
+   case nir_op_ishr:
+      result = lp_build_shr(int_bld, src[0],
+                            shift_amount(bld_base, src_bit_size[0], src[1]));
+      break;
+   case nir_op_ushr:
+      result = lp_build_shr(uint_bld, src[0],
+                            shift_amount(bld_base, src_bit_size[0], src[1]));
+      break;
+   case nir_op_ilt32:
+      result = icmp32(bld_base, PIPE_FUNC_LESS, FALSE, src_bit_size[0], src);
+      break;
+   case nir_op_ige32:
+      result = icmp32(bld_base, PIPE_FUNC_GEQUAL, FALSE, src_bit_size[0], src);
+      break;
+   case nir_op_ieq32:
+      result = icmp32(bld_base, PIPE_FUNC_EQUAL, FALSE, src_bit_size[0], src);
+      break;
+   case nir_op_ine32:
+      result = icmp32(bld_base, PIPE_FUNC_NOTEQUAL, FALSE, src_bit_size[0],
+                      src);
+      break;
+   case nir_op_ult32:
+      result = icmp32(bld_base, PIPE_FUNC_LESS, TRUE, src_bit_size[0], src);
+      break;
+   case nir_op_uge32:
+      result = icmp32(bld_base, PIPE_FUNC_GEQUAL, TRUE, src_bit_size[0], src);
+      break;
+   case nir_op_b32csel:
+      result = lp_build_select(get_int_bld(bld_base, TRUE, src_bit_size[1]),
+                               bool_mask(bld_base, src_bit_size[1], src[0]),
+                               src[1], src[2]);
+      break;
+   case nir_op_bitfield_reverse:
+      result = do_bit_intrinsic(bld_base, "llvm.bitreverse", src[0], FALSE);
+      break;
+   case nir_op_bit_count:
+      result = do_bit_intrinsic(bld_base, "llvm.ctpop", src[0], FALSE);
+      break;
+   case nir_op_find_lsb:
+      result = lp_build_select(&bld_base->uint_bld,
+                               lp_build_cmp(&bld_base->uint_bld,
+                                            PIPE_FUNC_EQUAL, src[0],
+                                            bld_base->uint_bld.zero),
+                               lp_build_const_int_vec(gallivm,
+                                                      bld_base->uint_bld.type,
+                                                      -1),
+                               do_bit_intrinsic(bld_base, "llvm.cttz",
+                                                src[0], TRUE));
+      break;
+   case nir_op_ufind_msb:
+      /* 31 - ctlz(0) is already -1 */
+      result = lp_build_sub(&bld_base->int_bld,
+                            lp_build_const_int_vec(gallivm,
+                                                   bld_base->int_bld.type, 31),
+                            do_bit_intrinsic(bld_base, "llvm.ctlz",
+                                             src[0], TRUE));
+      break;
+   default:
+      _debug_printf("gallivm: unhandled NIR opcode %s\n",
+                    nir_op_infos[op].name);
+      assert(0);
+      bld_base->failed = TRUE;
+      result = bld_base->base.undef;
+      break;
+   }
+   return result;
+}
+
+
+static void
+visit_alu(struct lp_build_nir_context *bld_base, const nir_alu_instr *instr)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const nir_op_info *info = &nir_op_infos[instr->op];
+   const unsigned num_components = nir_dest_num_components(instr->dest.dest);
+   const unsigned dst_bit_size = nir_dest_bit_size(instr->dest.dest);
+   LLVMValueRef src[NIR_MAX_VEC_COMPONENTS][NIR_MAX_VEC_COMPONENTS];
+   unsigned src_bit_size[NIR_MAX_VEC_COMPONENTS];
+   LLVMValueRef result[NIR_MAX_VEC_COMPONENTS];
+   unsigned i, c;
+
+   assert(!instr->dest.saturate);
+
+   for (i = 0; i < info->num_inputs; i++) {
+      get_alu_src(bld_base, instr, i,
+                  info->input_sizes[i] ? info->input_sizes[i] : num_components,
+                  src[i]);
+      src_bit_size[i] = nir_src_bit_size(instr->src[i].src);
+   }
+
+   switch (instr->op) {
+   case nir_op_vec2:
+   case nir_op_vec3:
+   case nir_op_vec4:
+      for (c = 0; c < info->num_inputs; c++)
+         result[c] = src[c][0];
+      break;
+
+   case nir_op_fdot2:
+   case nir_op_fdot3:
+   case nir_op_fdot4:
+   case nir_op_fdph: {
+      struct lp_build_context *flt_bld = get_flt_bld(bld_base,
+                                                     src_bit_size[0]);
+      const unsigned n = instr->op == nir_op_fdph ? 3 : info->input_sizes[0];
+      result[0] = lp_build_mul(flt_bld, src[0][0], src[1][0]);
+      for (c = 1; c < n; c++)
+         result[0] = lp_build_add(flt_bld, result[0],
+                                  lp_build_mul(flt_bld,
+                                               src[0][c], src[1][c]));
+      if (instr->op == nir_op_fdph)
+         result[0] = lp_build_add(flt_bld, result[0], src[1][3]);
+      break;
+   }
+
+   case nir_op_b32all_fequal2:
+   case nir_op_b32all_fequal3:
+   case nir_op_b32all_fequal4:
+   case nir_op_b32any_fnequal2:
+   case nir_op_b32any_fnequal3:
+   case nir_op_b32any_fnequal4:
+   case nir_op_b32all_iequal2:
+   case nir_op_b32all_iequal3:
+   case nir_op_b32all_iequal4:
+   case nir_op_b32any_inequal2:
+   case nir_op_b32any_inequal3:
+   case nir_op_b32any_inequal4: {
+      const boolean is_float =
+         nir_alu_type_get_base_type(info->input_types[0]) == nir_type_float;
+      const boolean is_all =
+         instr->op == nir_op_b32all_fequal2 ||
+         instr->op == nir_op_b32all_fequal3 ||
+         instr->op == nir_op_b32all_fequal4 ||
+         instr->op == nir_op_b32all_iequal2 ||
+         instr->op == nir_op_b32all_iequal3 ||
+         instr->op == nir_op_b32all_iequal4;
+      const enum pipe_compare_func compare =
+         is_all ? PIPE_FUNC_EQUAL : PIPE_FUNC_NOTEQUAL;
+
+      result[0] = NULL;
+      for (c = 0; c < info->input_sizes[0]; c++) {
+         LLVMValueRef chan_src[2] = { src[0][c], src[1][c] };
+         LLVMValueRef cmp =
+            is_float ? fcmp32(bld_base, compare, src_bit_size[0], chan_src) :
+                       icmp32(bld_base, compare, TRUE, src_bit_size[0],
+                              chan_src);
+         if (!result[0])
+            result[0] = cmp;
+         else if (is_all)
+            result[0] = LLVMBuildAnd(builder, result[0], cmp, "");
+         else
+            result[0] = LLVMBuildOr(builder, result[0], cmp, "");
+      }
+      break;
+   }
+
+   default:
+      for (c = 0; c < num_components; c++) {
+         LLVMValueRef chan_src[NIR_MAX_VEC_COMPONENTS];
+
+         for (i = 0; i < info->num_inputs; i++)
+            chan_src[i] = src[i][c];
+         result[c] = do_alu_action(bld_base, instr->op, dst_bit_size,
+                                   src_bit_size, chan_src);
+      }
+      break;
+   }
+
+   assign_dest(bld_base, &instr->dest.dest, instr->dest.write_mask, result);
+}
+
+
+static void
+visit_load_const(struct lp_build_nir_context *bld_base,
+                 const nir_load_const_instr *instr)
+{
+   struct lp_build_context *uint_bld =
+      get_int_bld(bld_base, TRUE, instr->def.bit_size);
+   LLVMValueRef result[NIR_MAX_VEC_COMPONENTS];
+   unsigned i;
+
+   for (i = 0; i < instr->def.num_components; i++) {
+      const uint64_t value = instr->def.bit_size == 64 ?
+         instr->value[i].u64 : instr->value[i].u32;
+      result[i] = lp_build_const_int_vec(bld_base->base.gallivm,
+                                         uint_bld->type, value);
+   }
+   for (i = 0; i < instr->def.num_components; i++)
+      bld_base->ssa_defs[instr->def.index * NIR_MAX_VEC_COMPONENTS + i] =
+         result[i];
+}
+
+
+static void
+visit_ssa_undef(struct lp_build_nir_context *bld_base,
+                const nir_ssa_undef_instr *instr)
+{
+   struct lp_build_context *uint_bld =
+      get_int_bld(bld_base, TRUE, instr->def.bit_size);
+   unsigned i;
+
+   for (i = 0; i < instr->def.num_components; i++)
+      bld_base->ssa_defs[instr->def.index * NIR_MAX_VEC_COMPONENTS + i] =
+         uint_bld->undef;
+}
+
+
+/**
+ * Fold a constant I/O offset into the base, or return it as an index
+ * vector.
+ */
+static LLVMValueRef
+get_io_offset(struct lp_build_nir_context *bld_base, nir_src offset,
+              unsigned *base)
+{
+   if (nir_src_is_const(offset)) {
+      *base += nir_src_as_uint(offset);
+      return NULL;
+   }
+   return cast_type(bld_base, get_src_scalar(bld_base, offset),
+                    nir_type_uint, 32);
+}
+
+
+static void
+visit_load_input(struct lp_build_nir_context *bld_base,
+                 nir_intrinsic_instr *instr,
+                 LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   const boolean per_vertex =
+      instr->intrinsic == nir_intrinsic_load_per_vertex_input;
+   nir_src *offset_src = &instr->src[per_vertex ? 1 : 0];
+   unsigned base = nir_intrinsic_base(instr);
+   LLVMValueRef vertex_index = NULL;
+   LLVMValueRef indir_index;
+
+   if (per_vertex) {
+      if (nir_src_is_const(instr->src[0]))
+         vertex_index = lp_build_const_int32(gallivm,
+                                             nir_src_as_uint(instr->src[0]));
+      else
+         vertex_index = cast_type(bld_base,
+                                  get_src_scalar(bld_base, instr->src[0]),
+                                  nir_type_uint, 32);
+   }
+   indir_index = get_io_offset(bld_base, *offset_src, &base);
+
+   bld_base->load_input(bld_base, nir_dest_num_components(instr->dest),
+                        nir_dest_bit_size(instr->dest), base,
+                        nir_intrinsic_component(instr),
+                        vertex_index, indir_index, result);
+}
+
+
+static void
+visit_store_output(struct lp_build_nir_context *bld_base,
+                   nir_intrinsic_instr *instr)
+{
+   LLVMValueRef src[NIR_MAX_VEC_COMPONENTS];
+   unsigned base = nir_intrinsic_base(instr);
+
+   /* Indirect output stores are lowered by lp_build_opt_nir(). */
+   get_io_offset(bld_base, instr->src[1], &base);
+   get_src(bld_base, instr->src[0], src);
+
+   bld_base->store_output(bld_base, nir_intrinsic_write_mask(instr),
+                          nir_src_bit_size(instr->src[0]), base,
+                          nir_intrinsic_component(instr), src);
+}
+
+
+static void
+visit_load_uniform(struct lp_build_nir_context *bld_base,
+                   nir_intrinsic_instr *instr,
+                   LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   const unsigned base = nir_intrinsic_base(instr);
+   const boolean offset_is_uniform = nir_src_is_const(instr->src[0]);
+   LLVMValueRef offset;
+
+   /*
+    * Uniforms live in the first constant buffer, and the state tracker
+    * sizes them in vec4 slots.
+    */
+   if (offset_is_uniform) {
+      offset = lp_build_const_int32(gallivm,
+                                    (base + nir_src_as_uint(instr->src[0])) *
+                                    16);
+   }
+   else {
+      offset = cast_type(bld_base, get_src_scalar(bld_base, instr->src[0]),
+                         nir_type_uint, 32);
+      offset = lp_build_add(&bld_base->uint_bld, offset,
+                            lp_build_const_int_vec(gallivm,
+                                                   bld_base->uint_bld.type,
+                                                   base));
+      offset = lp_build_shl_imm(&bld_base->uint_bld, offset, 4);
+   }
+
+   bld_base->load_ubo(bld_base, nir_dest_num_components(instr->dest),
+                      nir_dest_bit_size(instr->dest), offset_is_uniform,
+                      0, offset, result);
+}
+
+
+static void
+visit_load_ubo(struct lp_build_nir_context *bld_base,
+               nir_intrinsic_instr *instr,
+               LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const unsigned nc = nir_dest_num_components(instr->dest);
+   const unsigned bit_size = nir_dest_bit_size(instr->dest);
+   struct lp_build_context *bld = get_int_bld(bld_base, TRUE, bit_size);
+   const boolean offset_is_uniform = nir_src_is_const(instr->src[1]);
+   LLVMValueRef offset, index;
+   unsigned num_ubos, i, c;
+
+   if (offset_is_uniform)
+      offset = lp_build_const_int32(gallivm, nir_src_as_uint(instr->src[1]));
+   else
+      offset = cast_type(bld_base, get_src_scalar(bld_base, instr->src[1]),
+                         nir_type_uint, 32);
+
+   /* The uniforms take the first buffer, UBO n is bound to slot n + 1. */
+   if (nir_src_is_const(instr->src[0])) {
+      bld_base->load_ubo(bld_base, nc, bit_size, offset_is_uniform,
+                         nir_src_as_uint(instr->src[0]) + 1, offset, result);
+      return;
+   }
+
+   /*
+    * UBO arrays indexed dynamically: load from each UBO of the shader and
+    * keep, in each channel, the value of the UBO it indexes.  Indices past
+    * the last UBO read zero, like out of bounds offsets.
+    */
+   index = cast_type(bld_base, get_src_scalar(bld_base, instr->src[0]),
+                     nir_type_uint, 32);
+   num_ubos = MIN2(bld_base->shader->info.num_ubos,
+                   LP_MAX_TGSI_CONST_BUFFERS - 1);
+
+   for (c = 0; c < nc; c++)
+      result[c] = bld->zero;
+
+   for (i = 0; i < num_ubos; i++) {
+      LLVMValueRef values[NIR_MAX_VEC_COMPONENTS];
+      LLVMValueRef sel;
+
+      bld_base->load_ubo(bld_base, nc, bit_size, offset_is_uniform,
+                         i + 1, offset, values);
+
+      sel = lp_build_cmp(&bld_base->uint_bld, PIPE_FUNC_EQUAL, index,
+                         lp_build_const_int_vec(gallivm,
+                                                bld_base->uint_bld.type, i));
+      if (bit_size == 64)
+         sel = LLVMBuildSExt(builder, sel, bld->int_vec_type, "");
+
+      for (c = 0; c < nc; c++)
+         result[c] = lp_build_select(bld, sel,
+                                     LLVMBuildBitCast(builder, values[c],
+                                                      bld->vec_type, ""),
+                                     result[c]);
+   }
+}
+
+
+static LLVMValueRef
+get_buffer_index(struct lp_build_nir_context *bld_base, nir_src src)
+{
+   /* Like TGSI, only constant buffer indices are supported. */
+   assert(nir_src_is_const(src));
+   return lp_build_const_int32(bld_base->base.gallivm, nir_src_as_uint(src));
+}
+
+
+static void
+visit_load_mem(struct lp_build_nir_context *bld_base,
+               nir_intrinsic_instr *instr,
+               LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   const boolean is_shared = instr->intrinsic == nir_intrinsic_load_shared;
+   LLVMValueRef index = NULL;
+   LLVMValueRef offset;
+
+   if (!is_shared)
+      index = get_buffer_index(bld_base, instr->src[0]);
+   offset = get_src_scalar(bld_base, instr->src[is_shared ? 0 : 1]);
+   offset = cast_type(bld_base, offset, nir_type_uint, 32);
+   if (is_shared && nir_intrinsic_base(instr))
+      offset = lp_build_add(&bld_base->uint_bld, offset,
+                            lp_build_const_int_vec(bld_base->base.gallivm,
+                                                   bld_base->uint_bld.type,
+                                                   nir_intrinsic_base(instr)));
+
+   bld_base->load_mem(bld_base, nir_dest_num_components(instr->dest),
+                      nir_dest_bit_size(instr->dest), index, offset, result);
+}
+
+
+static void
+visit_store_mem(struct lp_build_nir_context *bld_base,
+                nir_intrinsic_instr *instr)
+{
+   const boolean is_shared = instr->intrinsic == nir_intrinsic_store_shared;
+   LLVMValueRef src[NIR_MAX_VEC_COMPONENTS];
+   LLVMValueRef index = NULL;
+   LLVMValueRef offset;
+
+   get_src(bld_base, instr->src[0], src);
+   if (!is_shared)
+      index = get_buffer_index(bld_base, instr->src[1]);
+   offset = get_src_scalar(bld_base, instr->src[is_shared ? 1 : 2]);
+   offset = cast_type(bld_base, offset, nir_type_uint, 32);
+   if (is_shared && nir_intrinsic_base(instr))
+      offset = lp_build_add(&bld_base->uint_bld, offset,
+                            lp_build_const_int_vec(bld_base->base.gallivm,
+                                                   bld_base->uint_bld.type,
+                                                   nir_intrinsic_base(instr)));
+
+   bld_base->store_mem(bld_base, nir_intrinsic_write_mask(instr),
+                       nir_src_num_components(instr->src[0]),
+                       nir_src_bit_size(instr->src[0]), index, offset, src);
+}
+
+
+static void
+visit_atomic_mem(struct lp_build_nir_context *bld_base,
+                 nir_intrinsic_instr *instr,
+                 boolean is_shared,
+                 LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   const unsigned first = is_shared ? 0 : 1;
+   LLVMValueRef index = NULL;
+   LLVMValueRef offset, val, val2 = NULL;
+
+   if (!is_shared)
+      index = get_buffer_index(bld_base, instr->src[0]);
+   offset = cast_type(bld_base, get_src_scalar(bld_base, instr->src[first]),
+                      nir_type_uint, 32);
+   if (is_shared && nir_intrinsic_base(instr))
+      offset = lp_build_add(&bld_base->uint_bld, offset,
+                            lp_build_const_int_vec(bld_base->base.gallivm,
+                                                   bld_base->uint_bld.type,
+                                                   nir_intrinsic_base(instr)));
+   val = cast_type(bld_base, get_src_scalar(bld_base, instr->src[first + 1]),
+                   nir_type_uint, 32);
+   if (nir_intrinsic_infos[instr->intrinsic].num_srcs > first + 2)
+      val2 = cast_type(bld_base,
+                       get_src_scalar(bld_base, instr->src[first + 2]),
+                       nir_type_uint, 32);
+
+   bld_base->atomic_mem(bld_base, instr->intrinsic, index, offset,
+                        val, val2, &result[0]);
+}
+
+
+static enum pipe_texture_target
+image_target(const struct glsl_type *type)
+{
+   const bool is_array = glsl_sampler_type_is_array(type);
+
+   switch (glsl_get_sampler_dim(type)) {
+   case GLSL_SAMPLER_DIM_1D:
+      return is_array ? PIPE_TEXTURE_1D_ARRAY : PIPE_TEXTURE_1D;
+   case GLSL_SAMPLER_DIM_3D:
+      return PIPE_TEXTURE_3D;
+   case GLSL_SAMPLER_DIM_CUBE:
+      return is_array ? PIPE_TEXTURE_CUBE_ARRAY : PIPE_TEXTURE_CUBE;
+   case GLSL_SAMPLER_DIM_RECT:
+      return PIPE_TEXTURE_RECT;
+   case GLSL_SAMPLER_DIM_BUF:
+      return PIPE_BUFFER;
+   default:
+      return is_array ? PIPE_TEXTURE_2D_ARRAY : PIPE_TEXTURE_2D;
+   }
+}
+
+
+/**
+ * Get the unit of the image an intrinsic accesses, and its type.  The
+ * state tracker puts the first unit of each image uniform in its
+ * driver_location.
+ */
+static unsigned
+get_image_index(nir_intrinsic_instr *instr, const struct glsl_type **type)
+{
+   nir_deref_instr *deref = nir_src_as_deref(instr->src[0]);
+   unsigned index = 0;
+
+   /* Like for buffers, only constant array indices are supported. */
+   while (deref->deref_type == nir_deref_type_array) {
+      assert(nir_src_is_const(deref->arr.index));
+      index += nir_src_as_uint(deref->arr.index) *
+               glsl_type_get_image_count(deref->type);
+      deref = nir_deref_instr_parent(deref);
+   }
+   assert(deref->deref_type == nir_deref_type_var);
+
+   *type = glsl_without_array(deref->var->type);
+   return deref->var->data.driver_location + index;
+}
+
+
+static void
+visit_image_op(struct lp_build_nir_context *bld_base,
+               nir_intrinsic_instr *instr,
+               LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   const struct glsl_type *type;
+   struct lp_img_params params;
+   LLVMValueRef src[NIR_MAX_VEC_COMPONENTS];
+   LLVMValueRef coords[3];
+   bool is_signed;
+   unsigned c;
+
+   memset(&params, 0, sizeof params);
+   params.image_index = get_image_index(instr, &type);
+   params.target = image_target(type);
+   params.coords = coords;
+   params.outdata = result;
+   is_signed = glsl_get_sampler_result_type(type) == GLSL_TYPE_INT;
+
+   /* the layer of 1D arrays goes in coords[2] like for texel fetches */
+   get_src(bld_base, instr->src[1], src);
+   for (c = 0; c < 3; c++)
+      coords[c] = cast_type(bld_base, src[c], nir_type_float, 32);
+   if (params.target == PIPE_TEXTURE_1D_ARRAY)
+      coords[2] = coords[1];
+
+   switch (instr->intrinsic) {
+   case nir_intrinsic_image_deref_load:
+      params.img_op = LP_IMG_LOAD;
+      break;
+   case nir_intrinsic_image_deref_store:
+      params.img_op = LP_IMG_STORE;
+      get_src(bld_base, instr->src[3], src);
+      for (c = 0; c < 4; c++) {
+         params.indata[c] = c < nir_src_num_components(instr->src[3]) ?
+            cast_type(bld_base, src[c], nir_type_float, 32) :
+            bld_base->base.undef;
+      }
+      break;
+   case nir_intrinsic_image_deref_atomic_comp_swap:
+      params.img_op = LP_IMG_ATOMIC_CAS;
+      params.indata2[0] = cast_type(bld_base,
+                                    get_src_scalar(bld_base, instr->src[3]),
+                                    nir_type_float, 32);
+      params.indata[0] = cast_type(bld_base,
+                                   get_src_scalar(bld_base, instr->src[4]),
+                                   nir_type_float, 32);
+      break;
+   default:
+      params.img_op = LP_IMG_ATOMIC;
+      params.indata[0] = cast_type(bld_base,
+                                   get_src_scalar(bld_base, instr->src[3]),
+                                   nir_type_float, 32);
+      switch (instr->intrinsic) {
+      case nir_intrinsic_image_deref_atomic_add:
+         params.op = LLVMAtomicRMWBinOpAdd;
+         break;
+      case nir_intrinsic_image_deref_atomic_min:
+         params.op = is_signed ? LLVMAtomicRMWBinOpMin : LLVMAtomicRMWBinOpUMin;
+         break;
+      case nir_intrinsic_image_deref_atomic_max:
+         params.op = is_signed ? LLVMAtomicRMWBinOpMax : LLVMAtomicRMWBinOpUMax;
+         break;
+      case nir_intrinsic_image_deref_atomic_and:
+         params.op = LLVMAtomicRMWBinOpAnd;
+         break;
+      case nir_intrinsic_image_deref_atomic_or:
+         params.op = LLVMAtomicRMWBinOpOr;
+         break;
+      case nir_intrinsic_image_deref_atomic_xor:
+         params.op = LLVMAtomicRMWBinOpXor;
+         break;
+      case nir_intrinsic_image_deref_atomic_exchange:
+         params.op = LLVMAtomicRMWBinOpXchg;
+         break;
+      default:
+         unreachable("unexpected image atomic");
+      }
+      break;
+   }
+
+   bld_base->image_op(bld_base, &params);
+}
+
+
+static void
+visit_image_size(struct lp_build_nir_context *bld_base,
+                 nir_intrinsic_instr *instr,
+                 LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   const struct glsl_type *type;
+   struct lp_sampler_size_query_params params;
+
+   memset(&params, 0, sizeof params);
+   params.int_type = bld_base->int_bld.type;
+   params.texture_unit = get_image_index(instr, &type);
+   params.target = image_target(type);
+   params.is_sviewinfo = TRUE;
+   params.lod_property = LP_SAMPLER_LOD_SCALAR;
+   params.sizes_out = result;
+
+   bld_base->image_size(bld_base, &params);
+}
+
+
+static void
+visit_intrinsic(struct lp_build_nir_context *bld_base,
+                nir_intrinsic_instr *instr)
+{
+   LLVMValueRef result[NIR_MAX_VEC_COMPONENTS] = { NULL };
+
+   switch (instr->intrinsic) {
+   case nir_intrinsic_load_input:
+   case nir_intrinsic_load_per_vertex_input:
+      visit_load_input(bld_base, instr, result);
+      break;
+   case nir_intrinsic_store_output:
+      visit_store_output(bld_base, instr);
+      break;
+   case nir_intrinsic_load_uniform:
+      visit_load_uniform(bld_base, instr, result);
+      break;
+   case nir_intrinsic_load_ubo:
+      visit_load_ubo(bld_base, instr, result);
+      break;
+   case nir_intrinsic_load_ssbo:
+   case nir_intrinsic_load_shared:
+      visit_load_mem(bld_base, instr, result);
+      break;
+   case nir_intrinsic_store_ssbo:
+   case nir_intrinsic_store_shared:
+      visit_store_mem(bld_base, instr);
+      break;
+   case nir_intrinsic_ssbo_atomic_add:
+   case nir_intrinsic_ssbo_atomic_imin:
+   case nir_intrinsic_ssbo_atomic_umin:
+   case nir_intrinsic_ssbo_atomic_imax:
+   case nir_intrinsic_ssbo_atomic_umax:
+   case nir_intrinsic_ssbo_atomic_and:
+   case nir_intrinsic_ssbo_atomic_or:
+   case nir_intrinsic_ssbo_atomic_xor:
+   case nir_intrinsic_ssbo_atomic_exchange:
+   case nir_intrinsic_ssbo_atomic_comp_swap:
+      visit_atomic_mem(bld_base, instr, FALSE, result);
+      break;
+   case nir_intrinsic_shared_atomic_add:
+   case nir_intrinsic_shared_atomic_imin:
+   case nir_intrinsic_shared_atomic_umin:
+   case nir_intrinsic_shared_atomic_imax:
+   case nir_intrinsic_shared_atomic_umax:
+   case nir_intrinsic_shared_atomic_and:
+   case nir_intrinsic_shared_atomic_or:
+   case nir_intrinsic_shared_atomic_xor:
+   case nir_intrinsic_shared_atomic_exchange:
+   case nir_intrinsic_shared_atomic_comp_swap:
+      visit_atomic_mem(bld_base, instr, TRUE, result);
+      break;
+   case nir_intrinsic_image_deref_load:
+   case nir_intrinsic_image_deref_store:
+   case nir_intrinsic_image_deref_atomic_add:
+   case nir_intrinsic_image_deref_atomic_min:
+   case nir_intrinsic_image_deref_atomic_max:
+   case nir_intrinsic_image_deref_atomic_and:
+   case nir_intrinsic_image_deref_atomic_or:
+   case nir_intrinsic_image_deref_atomic_xor:
+   case nir_intrinsic_image_deref_atomic_exchange:
+   case nir_intrinsic_image_deref_atomic_comp_swap:
+      visit_image_op(bld_base, instr, result);
+      break;
+   case nir_intrinsic_image_deref_size:
+      visit_image_size(bld_base, instr, result);
+      break;
+   case nir_intrinsic_get_buffer_size:
+      bld_base->get_buffer_size(bld_base,
+                                get_buffer_index(bld_base, instr->src[0]),
+                                &result[0]);
+      break;
+   case nir_intrinsic_barrier:
+      bld_base->barrier(bld_base);
+      break;
+   case nir_intrinsic_memory_barrier:
+   case nir_intrinsic_memory_barrier_atomic_counter:
+   case nir_intrinsic_memory_barrier_buffer:
+   case nir_intrinsic_memory_barrier_image:
+   case nir_intrinsic_memory_barrier_shared:
+   case nir_intrinsic_group_memory_barrier:
+      /* Memory accesses are done in program order, and atomics are
+       * sequentially consistent.
+       */
+      break;
+   case nir_intrinsic_load_vertex_id:
+   case nir_intrinsic_load_vertex_id_zero_base:
+   case nir_intrinsic_load_base_vertex:
+   case nir_intrinsic_load_instance_id:
+   case nir_intrinsic_load_primitive_id:
+   case nir_intrinsic_load_invocation_id:
+   case nir_intrinsic_load_local_invocation_id:
+   case nir_intrinsic_load_work_group_id:
+   case nir_intrinsic_load_num_work_groups:
+   case nir_intrinsic_load_local_group_size:
+      bld_base->sysval_intrin(bld_base, instr, result);
+      break;
+   case nir_intrinsic_discard:
+      bld_base->discard(bld_base, NULL);
+      break;
+   case nir_intrinsic_discard_if:
+      bld_base->discard(bld_base,
+                        cast_type(bld_base,
+                                  get_src_scalar(bld_base, instr->src[0]),
+                                  nir_type_int, 32));
+      break;
+   case nir_intrinsic_emit_vertex:
+      bld_base->emit_vertex(bld_base, nir_intrinsic_stream_id(instr));
+      break;
+   case nir_intrinsic_end_primitive:
+      bld_base->end_primitive(bld_base, nir_intrinsic_stream_id(instr));
+      break;
+   default:
+      _debug_printf("gallivm: unhandled NIR intrinsic %s\n",
+                    nir_intrinsic_infos[instr->intrinsic].name);
+      assert(0);
+      bld_base->failed = TRUE;
+      if (nir_intrinsic_infos[instr->intrinsic].has_dest) {
+         struct lp_build_context *bld =
+            get_int_bld(bld_base, TRUE, nir_dest_bit_size(instr->dest));
+         for (unsigned c = 0; c < nir_dest_num_components(instr->dest); c++)
+            result[c] = bld->undef;
+      }
+      break;
+   }
+
+   if (nir_intrinsic_infos[instr->intrinsic].has_dest && result[0])
+      assign_dest_all(bld_base, &instr->dest, result);
+}
+
+
+static enum pipe_texture_target
+tex_target(const nir_tex_instr *instr)
+{
+   switch (instr->sampler_dim) {
+   case GLSL_SAMPLER_DIM_1D:
+      return instr->is_array ? PIPE_TEXTURE_1D_ARRAY : PIPE_TEXTURE_1D;
+   case GLSL_SAMPLER_DIM_3D:
+      return PIPE_TEXTURE_3D;
+   case GLSL_SAMPLER_DIM_CUBE:
+      return instr->is_array ? PIPE_TEXTURE_CUBE_ARRAY : PIPE_TEXTURE_CUBE;
+   case GLSL_SAMPLER_DIM_RECT:
+      return PIPE_TEXTURE_RECT;
+   case GLSL_SAMPLER_DIM_BUF:
+      return PIPE_BUFFER;
+   default:
+      return instr->is_array ? PIPE_TEXTURE_2D_ARRAY : PIPE_TEXTURE_2D;
+   }
+}
+
+
+static enum lp_sampler_lod_property
+lod_property(struct lp_build_nir_context *bld_base, nir_src lod_src)
+{
+   /* See lp_build_lod_property() in lp_bld_tgsi_soa.c. */
+   if (nir_src_is_const(lod_src))
+      return LP_SAMPLER_LOD_SCALAR;
+   else if (bld_base->shader->info.stage == MESA_SHADER_FRAGMENT) {
+      if (gallivm_perf & GALLIVM_PERF_NO_QUAD_LOD)
+         return LP_SAMPLER_LOD_PER_ELEMENT;
+      else
+         return LP_SAMPLER_LOD_PER_QUAD;
+   }
+   else
+      return LP_SAMPLER_LOD_PER_ELEMENT;
+}
+
+
+static void
+visit_txs(struct lp_build_nir_context *bld_base, nir_tex_instr *instr)
+{
+   struct lp_sampler_size_query_params params;
+   LLVMValueRef sizes_out[NIR_MAX_VEC_COMPONENTS];
+   LLVMValueRef explicit_lod = NULL;
+   unsigned i;
+
+   for (i = 0; i < instr->num_srcs; i++) {
+      if (instr->src[i].src_type == nir_tex_src_lod)
+         explicit_lod = cast_type(bld_base,
+                                  get_src_scalar(bld_base, instr->src[i].src),
+                                  nir_type_int, 32);
+   }
+
+   memset(&params, 0, sizeof params);
+   params.int_type = bld_base->int_bld.type;
+   params.texture_unit = instr->texture_index;
+   params.target = tex_target(instr);
+   params.is_sviewinfo = TRUE;
+   params.lod_property = explicit_lod ? LP_SAMPLER_LOD_PER_ELEMENT :
+                                        LP_SAMPLER_LOD_SCALAR;
+   params.explicit_lod = explicit_lod;
+   params.sizes_out = sizes_out;
+
+   bld_base->tex_size(bld_base, &params);
+
+   /* The number of levels comes in the last component. */
+   if (instr->op == nir_texop_query_levels)
+      sizes_out[0] = sizes_out[3];
+   assign_dest_all(bld_base, &instr->dest, sizes_out);
+}
+
+
+static void
+visit_tex(struct lp_build_nir_context *bld_base, nir_tex_instr *instr)
+{
+   const boolean is_fetch = instr->op == nir_texop_txf ||
+                            instr->op == nir_texop_txf_ms;
+   const nir_alu_type coord_type = is_fetch ? nir_type_int : nir_type_float;
+   struct lp_sampler_params params;
+   struct lp_derivatives derivs;
+   LLVMValueRef coords[5];
+   LLVMValueRef offsets[3] = { NULL };
+   LLVMValueRef explicit_lod = NULL;
+   LLVMValueRef texel[NIR_MAX_VEC_COMPONENTS];
+   enum lp_sampler_lod_property lod_prop = LP_SAMPLER_LOD_SCALAR;
+   enum lp_sampler_op_type sample_op = LP_SAMPLER_OP_TEXTURE;
+   unsigned sample_key = 0;
+   unsigned coord_dims;
+   unsigned i, c;
+
+   if (instr->op == nir_texop_txs || instr->op == nir_texop_query_levels) {
+      visit_txs(bld_base, instr);
+      return;
+   }
+
+   if (is_fetch)
+      sample_op = LP_SAMPLER_OP_FETCH;
+   else if (instr->op == nir_texop_tg4)
+      sample_op = LP_SAMPLER_OP_GATHER;
+   else if (instr->op == nir_texop_lod)
+      sample_op = LP_SAMPLER_OP_LODQ;
+
+   coord_dims = instr->coord_components - (instr->is_array ? 1 : 0);
+   for (c = 0; c < 5; c++)
+      coords[c] = is_fetch ? bld_base->int_bld.undef : bld_base->base.undef;
+
+   memset(&derivs, 0, sizeof derivs);
+
+   for (i = 0; i < instr->num_srcs; i++) {
+      const nir_src src = instr->src[i].src;
+      LLVMValueRef values[NIR_MAX_VEC_COMPONENTS];
+
+      switch (instr->src[i].src_type) {
+      case nir_tex_src_coord:
+         get_src(bld_base, src, values);
+         for (c = 0; c < coord_dims; c++)
+            coords[c] = cast_type(bld_base, values[c], coord_type, 32);
+         /* The layer goes in the third slot, but the fourth for cubes. */
+         if (instr->is_array) {
+            unsigned layer = instr->sampler_dim == GLSL_SAMPLER_DIM_CUBE ?
+                             3 : 2;
+            coords[layer] = cast_type(bld_base, values[coord_dims],
+                                      coord_type, 32);
+         }
+         break;
+      case nir_tex_src_comparator:
+         sample_key |= LP_SAMPLER_SHADOW;
+         coords[4] = cast_type(bld_base, get_src_scalar(bld_base, src),
+                               nir_type_float, 32);
+         break;
+      case nir_tex_src_bias:
+         sample_key |= LP_SAMPLER_LOD_BIAS << LP_SAMPLER_LOD_CONTROL_SHIFT;
+         explicit_lod = cast_type(bld_base, get_src_scalar(bld_base, src),
+                                  nir_type_float, 32);
+         lod_prop = lod_property(bld_base, src);
+         break;
+      case nir_tex_src_lod:
+         sample_key |= LP_SAMPLER_LOD_EXPLICIT << LP_SAMPLER_LOD_CONTROL_SHIFT;
+         explicit_lod = cast_type(bld_base, get_src_scalar(bld_base, src),
+                                  is_fetch ? nir_type_int : nir_type_float,
+                                  32);
+         lod_prop = lod_property(bld_base, src);
+         break;
+      case nir_tex_src_ddx:
+      case nir_tex_src_ddy:
+         get_src(bld_base, src, values);
+         for (c = 0; c < nir_src_num_components(src); c++) {
+            LLVMValueRef deriv = cast_type(bld_base, values[c],
+                                           nir_type_float, 32);
+            if (instr->src[i].src_type == nir_tex_src_ddx)
+               derivs.ddx[c] = deriv;
+            else
+               derivs.ddy[c] = deriv;
+         }
+         break;
+      case nir_tex_src_offset:
+         sample_key |= LP_SAMPLER_OFFSETS;
+         get_src(bld_base, src, values);
+         for (c = 0; c < nir_src_num_components(src); c++)
+            offsets[c] = cast_type(bld_base, values[c], nir_type_int, 32);
+         break;
+      case nir_tex_src_ms_index:
+         /* No multisampled textures, like TGSI. */
+         break;
+      case nir_tex_src_texture_offset:
+      case nir_tex_src_sampler_offset:
+         /* Indirect sampler indexing is not supported, like TGSI. */
+         _debug_printf("gallivm: unhandled indirect NIR sampler index\n");
+         assert(0);
+         bld_base->failed = TRUE;
+         break;
+      default:
+         _debug_printf("gallivm: unhandled NIR texture source %u\n",
+                       instr->src[i].src_type);
+         assert(0);
+         bld_base->failed = TRUE;
+         break;
+      }
+   }
+
+   if (derivs.ddx[0]) {
+      sample_key |= LP_SAMPLER_LOD_DERIVATIVES << LP_SAMPLER_LOD_CONTROL_SHIFT;
+      if (bld_base->shader->info.stage == MESA_SHADER_FRAGMENT &&
+          !(gallivm_perf & GALLIVM_PERF_NO_QUAD_LOD))
+         lod_prop = LP_SAMPLER_LOD_PER_QUAD;
+      else
+         lod_prop = LP_SAMPLER_LOD_PER_ELEMENT;
+   }
+
+   sample_key |= sample_op << LP_SAMPLER_OP_TYPE_SHIFT;
+   sample_key |= lod_prop << LP_SAMPLER_LOD_PROPERTY_SHIFT;
+
+   memset(&params, 0, sizeof params);
+   params.type = bld_base->base.type;
+   params.sample_key = sample_key;
+   params.texture_index = instr->texture_index;
+   /* texel fetches don't use the sampler, see emit_fetch_texels() */
+   params.sampler_index = is_fetch ? 0 : instr->sampler_index;
+   params.coords = coords;
+   params.offsets = offsets;
+   params.lod = explicit_lod;
+   params.derivs = derivs.ddx[0] ? &derivs : NULL;
+   params.texel = texel;
+
+   bld_base->tex(bld_base, &params);
+
+   assign_dest_all(bld_base, &instr->dest, texel);
+}
+
+
+static void
+visit_jump(struct lp_build_nir_context *bld_base, const nir_jump_instr *instr)
+{
+   switch (instr->type) {
+   case nir_jump_break:
+      bld_base->break_stmt(bld_base);
+      break;
+   case nir_jump_continue:
+      bld_base->continue_stmt(bld_base);
+      break;
+   default:
+      /* returns are lowered by the state tracker */
+      unreachable("unexpected jump type");
+   }
+}
+
+
+static void
+visit_block(struct lp_build_nir_context *bld_base, nir_block *block)
+{
+   nir_foreach_instr(instr, block) {
+      switch (instr->type) {
+      case nir_instr_type_alu:
+         visit_alu(bld_base, nir_instr_as_alu(instr));
+         break;
+      case nir_instr_type_load_const:
+         visit_load_const(bld_base, nir_instr_as_load_const(instr));
+         break;
+      case nir_instr_type_intrinsic:
+         visit_intrinsic(bld_base, nir_instr_as_intrinsic(instr));
+         break;
+      case nir_instr_type_tex:
+         visit_tex(bld_base, nir_instr_as_tex(instr));
+         break;
+      case nir_instr_type_ssa_undef:
+         visit_ssa_undef(bld_base, nir_instr_as_ssa_undef(instr));
+         break;
+      case nir_instr_type_jump:
+         visit_jump(bld_base, nir_instr_as_jump(instr));
+         break;
+      case nir_instr_type_deref:
+         /* only the uses of dead variables are left */
+         break;
+      default:
+         /* phis and parallel copies are gone after nir_convert_from_ssa() */
+         unreachable("unexpected NIR instruction type");
+      }
+   }
+}
+
+
+static void
+visit_if(struct lp_build_nir_context *bld_base, nir_if *if_stmt)
+{
+   LLVMValueRef cond = get_src_scalar(bld_base, if_stmt->condition);
+
+   bld_base->if_cond(bld_base, cast_type(bld_base, cond, nir_type_int, 32));
+   visit_cf_list(bld_base, &if_stmt->then_list);
+
+   if (!exec_list_is_empty(&if_stmt->else_list)) {
+      bld_base->else_stmt(bld_base);
+      visit_cf_list(bld_base, &if_stmt->else_list);
+   }
+   bld_base->endif_stmt(bld_base);
+}
+
+
+static void
+visit_loop(struct lp_build_nir_context *bld_base, nir_loop *loop)
+{
+   bld_base->bgnloop(bld_base);
+   visit_cf_list(bld_base, &loop->body);
+   bld_base->endloop(bld_base);
+}
+
+
+static void
+visit_cf_list(struct lp_build_nir_context *bld_base, struct exec_list *list)
+{
+   foreach_list_typed(nir_cf_node, node, node, list)
+   {
+      switch (node->type) {
+      case nir_cf_node_block:
+         visit_block(bld_base, nir_cf_node_as_block(node));
+         break;
+      case nir_cf_node_if:
+         visit_if(bld_base, nir_cf_node_as_if(node));
+         break;
+      case nir_cf_node_loop:
+         visit_loop(bld_base, nir_cf_node_as_loop(node));
+         break;
+      default:
+         assert(0);
+      }
+   }
+}
+
+
+/**
+ * Translate the shader, with the callbacks of the backend.
+ *
+ * Returns FALSE if some instruction could not be translated, like
+ * lp_build_tgsi_llvm().  The code is still complete, with undefined values
+ * in place of the untranslated results.
+ */
+boolean
+lp_build_nir_llvm(struct lp_build_nir_context *bld_base,
+                  struct nir_shader *nir)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   nir_function_impl *impl = nir_shader_get_entrypoint(nir);
+
+   bld_base->shader = nir;
+
+   bld_base->ssa_defs = CALLOC(impl->ssa_alloc * NIR_MAX_VEC_COMPONENTS,
+                               sizeof(LLVMValueRef));
+   bld_base->regs = CALLOC(MAX2(impl->reg_alloc, 1), sizeof(LLVMValueRef));
+   if (!bld_base->ssa_defs || !bld_base->regs) {
+      FREE(bld_base->ssa_defs);
+      FREE(bld_base->regs);
+      return FALSE;
+   }
+
+   nir_foreach_register(reg, &impl->registers) {
+      struct lp_build_context *reg_bld = get_reg_bld(bld_base, reg);
+      LLVMTypeRef type = LLVMArrayType(reg_bld->vec_type,
+                                       MAX2(reg->num_array_elems, 1) *
+                                       reg->num_components);
+      bld_base->regs[reg->index] = lp_build_alloca_undef(gallivm, type,
+                                                         "reg");
+   }
+
+   bld_base->failed = FALSE;
+   visit_cf_list(bld_base, &impl->body);
+
+   FREE(bld_base->ssa_defs);
+   FREE(bld_base->regs);
+   bld_base->ssa_defs = NULL;
+   bld_base->regs = NULL;
+
+   return !bld_base->failed;
+}
+
+
+static int
+type_size(const struct glsl_type *type, bool bindless)
+{
+   return glsl_count_attribute_slots(type, false);
+}
+
+
+static int
+shared_type_size(const struct glsl_type *type, bool bindless)
+{
+   unsigned size, align;
+
+   glsl_get_natural_size_align_bytes(type, &size, &align);
+   return size;
+}
+
+
+static void
+loops_to_lcssa(struct exec_list *list)
+{
+   foreach_list_typed(nir_cf_node, node, node, list)
+   {
+      switch (node->type) {
+      case nir_cf_node_if: {
+         nir_if *if_stmt = nir_cf_node_as_if(node);
+         loops_to_lcssa(&if_stmt->then_list);
+         loops_to_lcssa(&if_stmt->else_list);
+         break;
+      }
+      case nir_cf_node_loop: {
+         nir_loop *loop = nir_cf_node_as_loop(node);
+         loops_to_lcssa(&loop->body);
+         nir_convert_loop_to_lcssa(loop);
+         break;
+      }
+      default:
+         break;
+      }
+   }
+}
+
+
+void
+lp_build_opt_nir(struct nir_shader *nir)
+{
+   nir_lower_tex_options lower_tex_options;
+   bool progress;
+
+   memset(&lower_tex_options, 0, sizeof lower_tex_options);
+   lower_tex_options.lower_txp = ~0u;
+
+   NIR_PASS_V(nir, nir_lower_tex, &lower_tex_options);
+   NIR_PASS_V(nir, nir_lower_system_values);
+   NIR_PASS_V(nir, nir_lower_frexp);
+
+   /* Outputs are only ever stored to with constant indices. */
+   NIR_PASS_V(nir, nir_lower_indirect_derefs, nir_var_shader_out);
+   NIR_PASS_V(nir, nir_lower_io, nir_var_shader_in | nir_var_shader_out,
+              type_size, (nir_lower_io_options)0);
+   if (nir->info.stage == MESA_SHADER_COMPUTE) {
+      nir_assign_var_locations(&nir->shared, &nir->num_shared,
+                               shared_type_size);
+      NIR_PASS_V(nir, nir_lower_io, nir_var_mem_shared,
+                 shared_type_size, (nir_lower_io_options)0);
+   }
+
+   do {
+      progress = false;
+      NIR_PASS_V(nir, nir_lower_vars_to_ssa);
+      NIR_PASS(progress, nir, nir_copy_prop);
+      NIR_PASS(progress, nir, nir_opt_remove_phis);
+      NIR_PASS(progress, nir, nir_opt_dce);
+      NIR_PASS(progress, nir, nir_opt_dead_cf);
+      NIR_PASS(progress, nir, nir_opt_cse);
+      NIR_PASS(progress, nir, nir_opt_algebraic);
+      NIR_PASS(progress, nir, nir_opt_constant_folding);
+      NIR_PASS(progress, nir, nir_opt_undef);
+   } while (progress);
+
+   NIR_PASS_V(nir, nir_lower_bool_to_int32);
+   NIR_PASS_V(nir, nir_lower_locals_to_regs);
+   NIR_PASS_V(nir, nir_remove_dead_derefs);
+   NIR_PASS_V(nir, nir_remove_dead_variables, nir_var_function_temp);
+
+   /*
+    * All the channels run the loops until the last one breaks, so values
+    * used after a loop must be copied out when each channel breaks, through
+    * the registers the phis of the loop exits become.
+    */
+   nir_foreach_function(func, nir) {
+      if (func->impl) {
+         loops_to_lcssa(&func->impl->body);
+         nir_metadata_preserve(func->impl, nir_metadata_block_index |
+                                           nir_metadata_dominance);
+      }
+   }
+   NIR_PASS_V(nir, nir_convert_from_ssa, true);
+
+   nir_foreach_function(func, nir) {
+      if (func->impl) {
+         nir_index_ssa_defs(func->impl);
+         nir_index_local_regs(func->impl);
+      }
+   }
+}
+
+
+void
+lp_build_nir_sha1(const struct nir_shader *nir, unsigned char sha1[20])
+{
+   struct blob blob;
+
+   blob_init(&blob);
+   nir_serialize(&blob, nir);
+   _mesa_sha1_compute(blob.data, blob.size, sha1);
+   blob_finish(&blob);
+}
@@ -0,0 +1,251 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * NIR to LLVM IR translation.
+ *
+ * lp_bld_nir.c walks the NIR control flow and translates the ALU
+ * instructions, while the backend (only SoA so far, in lp_bld_nir_soa.c)
+ * supplies the control flow, register, I/O, memory and texture callbacks,
+ * just like lp_bld_tgsi.c and lp_bld_tgsi_soa.c split the TGSI work.
+ */
+
+#ifndef LP_BLD_NIR_H
+#define LP_BLD_NIR_H
+
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_limits.h"
+#include "gallivm/lp_bld_sample.h"
+#include "gallivm/lp_bld_tgsi.h"
+#include "nir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct tgsi_shader_info;
+struct lp_build_mask_context;
+struct lp_build_sampler_soa;
+struct lp_bld_tgsi_system_values;
+struct lp_build_tgsi_gs_iface;
+struct lp_build_tgsi_cs_iface;
+
+
+void
+lp_build_nir_soa(struct gallivm_state *gallivm,
+                 struct nir_shader *shader,
+                 struct lp_type type,
+                 struct lp_build_mask_context *mask,
+                 LLVMValueRef consts_ptr,
+                 LLVMValueRef const_sizes_ptr,
+                 const struct lp_bld_tgsi_system_values *system_values,
+                 const LLVMValueRef (*inputs)[4],
+                 LLVMValueRef (*outputs)[4],
+                 LLVMValueRef context_ptr,
+                 LLVMValueRef thread_data_ptr,
+                 const struct lp_build_sampler_soa *sampler,
+                 const struct tgsi_shader_info *info,
+                 const struct lp_build_tgsi_gs_iface *gs_iface,
+                 const struct lp_build_tgsi_cs_iface *cs_iface);
+
+
+/**
+ * Lower and optimize a shader received from the state tracker into the
+ * form lp_build_nir_soa() translates.  This modifies the shader, so it
+ * must be done once when the shader state is created, before any variant
+ * is compiled from it.
+ */
+void
+lp_build_opt_nir(struct nir_shader *nir);
+
+
+/**
+ * Compute a hash of the shader, for the disk cache keys.
+ */
+void
+lp_build_nir_sha1(const struct nir_shader *nir, unsigned char sha1[20]);
+
+
+struct lp_build_nir_context
+{
+   struct lp_build_context base;
+   struct lp_build_context uint_bld;
+   struct lp_build_context int_bld;
+   struct lp_build_context dbl_bld;
+   struct lp_build_context uint64_bld;
+   struct lp_build_context int64_bld;
+
+   /** Values of the SSA definitions, NIR_MAX_VEC_COMPONENTS per def */
+   LLVMValueRef *ssa_defs;
+   /** Storage of the registers, an array of vectors each */
+   LLVMValueRef *regs;
+
+   nir_shader *shader;
+
+   /** Set when an instruction could not be translated */
+   boolean failed;
+
+   void (*load_reg)(struct lp_build_nir_context *bld_base,
+                    struct lp_build_context *reg_bld,
+                    const nir_reg_src *reg,
+                    LLVMValueRef indir_src,
+                    LLVMValueRef reg_storage,
+                    LLVMValueRef result[NIR_MAX_VEC_COMPONENTS]);
+   void (*store_reg)(struct lp_build_nir_context *bld_base,
+                     struct lp_build_context *reg_bld,
+                     const nir_reg_dest *reg,
+                     unsigned writemask,
+                     LLVMValueRef indir_src,
+                     LLVMValueRef reg_storage,
+                     LLVMValueRef dst[NIR_MAX_VEC_COMPONENTS]);
+
+   /**
+    * Inputs and outputs are in vec4 slots.  The vertex index of per vertex
+    * inputs is a scalar when it is constant and a vector otherwise; the
+    * slot index is only passed when it is not constant, and otherwise
+    * folded into the base.  Output stores are never indirect.
+    */
+   void (*load_input)(struct lp_build_nir_context *bld_base,
+                      unsigned num_components,
+                      unsigned bit_size,
+                      unsigned base,
+                      unsigned component,
+                      LLVMValueRef vertex_index,
+                      LLVMValueRef indir_index,
+                      LLVMValueRef result[NIR_MAX_VEC_COMPONENTS]);
+   void (*store_output)(struct lp_build_nir_context *bld_base,
+                        unsigned writemask,
+                        unsigned bit_size,
+                        unsigned base,
+                        unsigned component,
+                        LLVMValueRef src[NIR_MAX_VEC_COMPONENTS]);
+
+   /** Load from a constant buffer; the offset is in bytes */
+   void (*load_ubo)(struct lp_build_nir_context *bld_base,
+                    unsigned num_components,
+                    unsigned bit_size,
+                    boolean offset_is_uniform,
+                    unsigned index,
+                    LLVMValueRef offset,
+                    LLVMValueRef result[NIR_MAX_VEC_COMPONENTS]);
+
+   /** Shader storage buffer, or shared memory when index is NULL */
+   void (*load_mem)(struct lp_build_nir_context *bld_base,
+                    unsigned num_components,
+                    unsigned bit_size,
+                    LLVMValueRef index,
+                    LLVMValueRef offset,
+                    LLVMValueRef result[NIR_MAX_VEC_COMPONENTS]);
+   void (*store_mem)(struct lp_build_nir_context *bld_base,
+                     unsigned writemask,
+                     unsigned num_components,
+                     unsigned bit_size,
+                     LLVMValueRef index,
+                     LLVMValueRef offset,
+                     LLVMValueRef dst[NIR_MAX_VEC_COMPONENTS]);
+   void (*atomic_mem)(struct lp_build_nir_context *bld_base,
+                      nir_intrinsic_op op,
+                      LLVMValueRef index,
+                      LLVMValueRef offset,
+                      LLVMValueRef val,
+                      LLVMValueRef val2,
+                      LLVMValueRef *result);
+   void (*get_buffer_size)(struct lp_build_nir_context *bld_base,
+                           LLVMValueRef index,
+                           LLVMValueRef *result);
+   void (*barrier)(struct lp_build_nir_context *bld_base);
+
+   void (*tex)(struct lp_build_nir_context *bld_base,
+               struct lp_sampler_params *params);
+   void (*tex_size)(struct lp_build_nir_context *bld_base,
+                    struct lp_sampler_size_query_params *params);
+   void (*image_op)(struct lp_build_nir_context *bld_base,
+                    struct lp_img_params *params);
+   void (*image_size)(struct lp_build_nir_context *bld_base,
+                      struct lp_sampler_size_query_params *params);
+
+   void (*sysval_intrin)(struct lp_build_nir_context *bld_base,
+                         nir_intrinsic_instr *instr,
+                         LLVMValueRef result[NIR_MAX_VEC_COMPONENTS]);
+   void (*discard)(struct lp_build_nir_context *bld_base,
+                   LLVMValueRef cond);
+   void (*emit_vertex)(struct lp_build_nir_context *bld_base,
+                       unsigned stream_id);
+   void (*end_primitive)(struct lp_build_nir_context *bld_base,
+                         unsigned stream_id);
+
+   void (*if_cond)(struct lp_build_nir_context *bld_base, LLVMValueRef cond);
+   void (*else_stmt)(struct lp_build_nir_context *bld_base);
+   void (*endif_stmt)(struct lp_build_nir_context *bld_base);
+   void (*bgnloop)(struct lp_build_nir_context *bld_base);
+   void (*endloop)(struct lp_build_nir_context *bld_base);
+   void (*break_stmt)(struct lp_build_nir_context *bld_base);
+   void (*continue_stmt)(struct lp_build_nir_context *bld_base);
+};
+
+
+boolean
+lp_build_nir_llvm(struct lp_build_nir_context *bld_base,
+                  struct nir_shader *nir);
+
+
+static inline struct lp_build_context *
+get_flt_bld(struct lp_build_nir_context *bld_base,
+            unsigned op_bit_size)
+{
+   if (op_bit_size == 64)
+      return &bld_base->dbl_bld;
+   else
+      return &bld_base->base;
+}
+
+
+static inline struct lp_build_context *
+get_int_bld(struct lp_build_nir_context *bld_base,
+            boolean is_unsigned,
+            unsigned op_bit_size)
+{
+   if (is_unsigned) {
+      if (op_bit_size == 64)
+         return &bld_base->uint64_bld;
+      else
+         return &bld_base->uint_bld;
+   }
+   else {
+      if (op_bit_size == 64)
+         return &bld_base->int64_bld;
+      else
+         return &bld_base->int_bld;
+   }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LP_BLD_NIR_H */
@@ -0,0 +1,1582 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * NIR to LLVM IR translation, SoA backend.
+ *
+ * Implements the callbacks of lp_bld_nir.c the same way lp_bld_tgsi_soa.c
+ * implements the TGSI opcodes, with one vector per channel and execution
+ * masks for the control flow.
+ */
+
+#include "lp_bld_nir.h"
+#include "lp_bld_init.h"
+#include "lp_bld_flow.h"
+#include "lp_bld_logic.h"
+#include "lp_bld_const.h"
+#include "lp_bld_struct.h"
+#include "lp_bld_arit.h"
+#include "lp_bld_bitarit.h"
+#include "util/u_math.h"
+
+
+struct lp_build_nir_soa_context
+{
+   struct lp_build_nir_context bld_base;
+
+   LLVMValueRef consts_ptr;
+   LLVMValueRef const_sizes_ptr;
+   LLVMValueRef consts[LP_MAX_TGSI_CONST_BUFFERS];
+   LLVMValueRef consts_sizes[LP_MAX_TGSI_CONST_BUFFERS];
+   const LLVMValueRef (*inputs)[TGSI_NUM_CHANNELS];
+   LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS];
+   LLVMValueRef context_ptr;
+   LLVMValueRef thread_data_ptr;
+
+   /** Copy of the inputs, for indirect addressing */
+   LLVMValueRef inputs_array;
+
+   LLVMValueRef ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+   LLVMValueRef ssbo_sizes[LP_MAX_TGSI_SHADER_BUFFERS];
+
+   const struct lp_build_sampler_soa *sampler;
+   const struct tgsi_shader_info *info;
+
+   struct lp_bld_tgsi_system_values system_values;
+
+   const struct lp_build_tgsi_gs_iface *gs_iface;
+   const struct lp_build_tgsi_cs_iface *cs_iface;
+   LLVMValueRef emitted_prims_vec_ptr;
+   LLVMValueRef total_emitted_vertices_vec_ptr;
+   LLVMValueRef emitted_vertices_vec_ptr;
+   LLVMValueRef max_output_vertices_vec;
+
+   struct lp_build_mask_context *mask;
+   struct lp_exec_mask exec_mask;
+};
+
+
+static inline struct lp_build_nir_soa_context *
+lp_nir_soa_context(struct lp_build_nir_context *bld_base)
+{
+   return (struct lp_build_nir_soa_context *) bld_base;
+}
+
+
+static LLVMValueRef
+mask_vec(struct lp_build_nir_context *bld_base)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   struct lp_exec_mask *exec_mask = &bld->exec_mask;
+
+   if (!exec_mask->has_mask)
+      return lp_build_mask_value(bld->mask);
+   return LLVMBuildAnd(builder, lp_build_mask_value(bld->mask),
+                       exec_mask->exec_mask, "");
+}
+
+
+/**
+ * Combine two vectors of 32-bit halves into one vector of 64-bit values.
+ */
+static LLVMValueRef
+emit_fetch_64bit(struct lp_build_nir_context *bld_base,
+                 LLVMValueRef input,
+                 LLVMValueRef input2)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef shuffles[2 * (LP_MAX_VECTOR_WIDTH / 32)];
+   const unsigned len = bld_base->base.type.length;
+   LLVMValueRef res;
+   unsigned i;
+
+   input = LLVMBuildBitCast(builder, input, bld_base->base.vec_type, "");
+   input2 = LLVMBuildBitCast(builder, input2, bld_base->base.vec_type, "");
+   for (i = 0; i < len; i++) {
+      shuffles[i * 2] = lp_build_const_int32(gallivm, i);
+      shuffles[i * 2 + 1] = lp_build_const_int32(gallivm, i + len);
+   }
+   res = LLVMBuildShuffleVector(builder, input, input2,
+                                LLVMConstVector(shuffles, len * 2), "");
+   return LLVMBuildBitCast(builder, res, bld_base->uint64_bld.vec_type, "");
+}
+
+
+/**
+ * Split a vector of 64-bit values into two vectors of their 32-bit halves.
+ */
+static void
+emit_store_64bit_split(struct lp_build_nir_context *bld_base,
+                       LLVMValueRef value,
+                       LLVMValueRef split_values[2])
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef shuffles[LP_MAX_VECTOR_WIDTH / 32];
+   LLVMValueRef shuffles2[LP_MAX_VECTOR_WIDTH / 32];
+   const unsigned len = bld_base->base.type.length;
+   unsigned i;
+
+   value = LLVMBuildBitCast(builder, value,
+                            LLVMVectorType(LLVMFloatTypeInContext(gallivm->context),
+                                           len * 2), "");
+   for (i = 0; i < len; i++) {
+      shuffles[i] = lp_build_const_int32(gallivm, i * 2);
+      shuffles2[i] = lp_build_const_int32(gallivm, i * 2 + 1);
+   }
+   split_values[0] = LLVMBuildShuffleVector(builder, value,
+                                            LLVMGetUndef(LLVMTypeOf(value)),
+                                            LLVMConstVector(shuffles, len),
+                                            "");
+   split_values[1] = LLVMBuildShuffleVector(builder, value,
+                                            LLVMGetUndef(LLVMTypeOf(value)),
+                                            LLVMConstVector(shuffles2, len),
+                                            "");
+}
+
+
+/**
+ * Offsets of the elements of channel chan of the indirectly addressed
+ * register in an array of vectors with four channels per register.
+ */
+static LLVMValueRef
+get_soa_array_offsets(struct lp_build_context *uint_bld,
+                      LLVMValueRef indirect_index,
+                      unsigned num_components,
+                      unsigned chan_index,
+                      boolean need_perelement_offset)
+{
+   struct gallivm_state *gallivm = uint_bld->gallivm;
+   LLVMValueRef chan_vec =
+      lp_build_const_int_vec(gallivm, uint_bld->type, chan_index);
+   LLVMValueRef length_vec =
+      lp_build_const_int_vec(gallivm, uint_bld->type, uint_bld->type.length);
+   LLVMValueRef index_vec;
+
+   /* index_vec = (indirect_index * num_components + chan_index) * length + offsets */
+   index_vec = lp_build_mul(uint_bld, indirect_index,
+                            lp_build_const_int_vec(gallivm, uint_bld->type,
+                                                   num_components));
+   index_vec = lp_build_add(uint_bld, index_vec, chan_vec);
+   index_vec = lp_build_mul(uint_bld, index_vec, length_vec);
+
+   if (need_perelement_offset) {
+      LLVMValueRef pixel_offsets;
+      unsigned i;
+      /* build pixel offset vector: {0, 1, 2, 3, ...} */
+      pixel_offsets = uint_bld->undef;
+      for (i = 0; i < uint_bld->type.length; i++) {
+         LLVMValueRef ii = lp_build_const_int32(gallivm, i);
+         pixel_offsets = LLVMBuildInsertElement(gallivm->builder,
+                                                pixel_offsets, ii, ii, "");
+      }
+      index_vec = lp_build_add(uint_bld, index_vec, pixel_offsets);
+   }
+   return index_vec;
+}
+
+
+/**
+ * Gather the scalars at indexes from base_ptr, with zero for the channels
+ * of overflow_mask.
+ */
+static LLVMValueRef
+build_gather(struct lp_build_nir_context *bld_base,
+             struct lp_build_context *bld,
+             LLVMValueRef base_ptr,
+             LLVMValueRef indexes,
+             LLVMValueRef overflow_mask)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   LLVMValueRef res = bld->undef;
+   unsigned i;
+
+   /* See build_gather() in lp_bld_tgsi_soa.c about avoiding control flow. */
+   if (overflow_mask)
+      indexes = lp_build_select(uint_bld, overflow_mask, uint_bld->zero,
+                                indexes);
+
+   for (i = 0; i < bld->type.length; i++) {
+      LLVMValueRef ii = lp_build_const_int32(gallivm, i);
+      LLVMValueRef index = LLVMBuildExtractElement(builder, indexes, ii, "");
+      LLVMValueRef scalar_ptr = LLVMBuildGEP(builder, base_ptr, &index, 1,
+                                             "gather_ptr");
+      LLVMValueRef scalar = LLVMBuildLoad(builder, scalar_ptr, "");
+
+      res = LLVMBuildInsertElement(builder, res, scalar, ii, "");
+   }
+
+   if (overflow_mask)
+      res = lp_build_select(bld, overflow_mask, bld->zero, res);
+
+   return res;
+}
+
+
+/**
+ * Scatter the elements of values to indexes of base_ptr, for the active
+ * channels of the execution mask.
+ */
+static void
+emit_mask_scatter(struct lp_build_nir_soa_context *bld,
+                  LLVMValueRef base_ptr,
+                  LLVMValueRef indexes,
+                  LLVMValueRef values,
+                  struct lp_exec_mask *mask)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef pred = mask->has_mask ? mask->exec_mask : NULL;
+   unsigned i;
+
+   for (i = 0; i < bld->bld_base.base.type.length; i++) {
+      LLVMValueRef ii = lp_build_const_int32(gallivm, i);
+      LLVMValueRef index = LLVMBuildExtractElement(builder, indexes, ii, "");
+      LLVMValueRef scalar_ptr = LLVMBuildGEP(builder, base_ptr, &index, 1,
+                                             "scatter_ptr");
+      LLVMValueRef val = LLVMBuildExtractElement(builder, values, ii,
+                                                 "scatter_val");
+      LLVMValueRef scalar_pred = pred ?
+         LLVMBuildExtractElement(builder, pred, ii, "scatter_pred") : NULL;
+
+      if (scalar_pred) {
+         LLVMValueRef real_val, dst_val;
+         dst_val = LLVMBuildLoad(builder, scalar_ptr, "");
+         scalar_pred = LLVMBuildICmp(builder, LLVMIntNE, scalar_pred,
+                                     lp_build_const_int32(gallivm, 0), "");
+         real_val = LLVMBuildSelect(builder, scalar_pred, val, dst_val, "");
+         LLVMBuildStore(builder, real_val, scalar_ptr);
+      }
+      else {
+         LLVMBuildStore(builder, val, scalar_ptr);
+      }
+   }
+}
+
+
+static LLVMValueRef
+get_reg_ptr(struct lp_build_nir_context *bld_base,
+            LLVMValueRef reg_storage,
+            unsigned index)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMValueRef gep[2];
+
+   gep[0] = lp_build_const_int32(gallivm, 0);
+   gep[1] = lp_build_const_int32(gallivm, index);
+   return LLVMBuildGEP(gallivm->builder, reg_storage, gep, 2, "");
+}
+
+
+/** Pointer to the scalars of an array register, for indirect accesses */
+static LLVMValueRef
+get_reg_scalar_ptr(struct lp_build_nir_context *bld_base,
+                   struct lp_build_context *reg_bld,
+                   LLVMValueRef reg_storage)
+{
+   LLVMTypeRef elem_type = LLVMGetElementType(reg_bld->vec_type);
+
+   return LLVMBuildBitCast(bld_base->base.gallivm->builder, reg_storage,
+                           LLVMPointerType(elem_type, 0), "");
+}
+
+
+static LLVMValueRef
+get_reg_indirect_index(struct lp_build_nir_context *bld_base,
+                       unsigned base_offset,
+                       unsigned num_array_elems,
+                       LLVMValueRef indir_src)
+{
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMValueRef index;
+
+   index = lp_build_add(uint_bld, indir_src,
+                        lp_build_const_int_vec(gallivm, uint_bld->type,
+                                               base_offset));
+   /* Clamp to the array, like get_indirect_index() in lp_bld_tgsi_soa.c. */
+   return lp_build_min(uint_bld, index,
+                       lp_build_const_int_vec(gallivm, uint_bld->type,
+                                              num_array_elems - 1));
+}
+
+
+static void
+emit_load_reg(struct lp_build_nir_context *bld_base,
+              struct lp_build_context *reg_bld,
+              const nir_reg_src *reg,
+              LLVMValueRef indir_src,
+              LLVMValueRef reg_storage,
+              LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   const unsigned num_components = reg->reg->num_components;
+   unsigned i;
+
+   if (indir_src) {
+      LLVMValueRef index = get_reg_indirect_index(bld_base, reg->base_offset,
+                                                  reg->reg->num_array_elems,
+                                                  indir_src);
+      LLVMValueRef scalar_ptr = get_reg_scalar_ptr(bld_base, reg_bld,
+                                                   reg_storage);
+
+      for (i = 0; i < num_components; i++) {
+         LLVMValueRef indexes =
+            get_soa_array_offsets(&bld_base->uint_bld, index,
+                                  num_components, i, TRUE);
+         result[i] = build_gather(bld_base, reg_bld, scalar_ptr, indexes,
+                                  NULL);
+      }
+   }
+   else {
+      for (i = 0; i < num_components; i++) {
+         LLVMValueRef ptr =
+            get_reg_ptr(bld_base, reg_storage,
+                        reg->base_offset * num_components + i);
+         result[i] = LLVMBuildLoad(builder, ptr, "");
+      }
+   }
+}
+
+
+static void
+emit_store_reg(struct lp_build_nir_context *bld_base,
+               struct lp_build_context *reg_bld,
+               const nir_reg_dest *reg,
+               unsigned writemask,
+               LLVMValueRef indir_src,
+               LLVMValueRef reg_storage,
+               LLVMValueRef dst[NIR_MAX_VEC_COMPONENTS])
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   const unsigned num_components = reg->reg->num_components;
+   unsigned i;
+
+   if (indir_src) {
+      LLVMValueRef index = get_reg_indirect_index(bld_base, reg->base_offset,
+                                                  reg->reg->num_array_elems,
+                                                  indir_src);
+      LLVMValueRef scalar_ptr = get_reg_scalar_ptr(bld_base, reg_bld,
+                                                   reg_storage);
+
+      for (i = 0; i < num_components; i++) {
+         LLVMValueRef indexes;
+
+         if (!(writemask & (1 << i)))
+            continue;
+         indexes = get_soa_array_offsets(&bld_base->uint_bld, index,
+                                         num_components, i, TRUE);
+         emit_mask_scatter(bld, scalar_ptr, indexes,
+                           LLVMBuildBitCast(builder, dst[i],
+                                            reg_bld->vec_type, ""),
+                           &bld->exec_mask);
+      }
+   }
+   else {
+      for (i = 0; i < num_components; i++) {
+         LLVMValueRef ptr;
+
+         if (!(writemask & (1 << i)))
+            continue;
+         ptr = get_reg_ptr(bld_base, reg_storage,
+                           reg->base_offset * num_components + i);
+         lp_exec_mask_store(&bld->exec_mask, reg_bld,
+                            LLVMBuildBitCast(builder, dst[i],
+                                             reg_bld->vec_type, ""),
+                            ptr);
+      }
+   }
+}
+
+
+/**
+ * Fetch one 32-bit channel of an input, which the caller has already
+ * clamped to the registers.
+ */
+static LLVMValueRef
+emit_fetch_input_chan(struct lp_build_nir_context *bld_base,
+                      unsigned base,
+                      unsigned chan,
+                      LLVMValueRef vertex_index,
+                      LLVMValueRef indir_index)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+
+   base += chan / 4;
+   chan %= 4;
+
+   if (bld->gs_iface) {
+      LLVMValueRef attrib_index;
+
+      if (indir_index)
+         attrib_index = lp_build_add(&bld_base->uint_bld, indir_index,
+                                     lp_build_const_int_vec(gallivm,
+                                                            bld_base->uint_bld.type,
+                                                            base));
+      else
+         attrib_index = lp_build_const_int32(gallivm, base);
+
+      return bld->gs_iface->fetch_input(bld->gs_iface, &bld_base->base,
+                                        !LLVMIsConstant(vertex_index),
+                                        vertex_index,
+                                        indir_index != NULL,
+                                        attrib_index,
+                                        lp_build_const_int32(gallivm, chan));
+   }
+
+   if (indir_index) {
+      LLVMValueRef index, index_vec;
+
+      assert(bld->inputs_array);
+      index = lp_build_add(&bld_base->uint_bld, indir_index,
+                           lp_build_const_int_vec(gallivm,
+                                                  bld_base->uint_bld.type,
+                                                  base));
+      index = lp_build_min(&bld_base->uint_bld, index,
+                           lp_build_const_int_vec(gallivm,
+                                                  bld_base->uint_bld.type,
+                                                  bld->info->file_max[TGSI_FILE_INPUT]));
+      index_vec = get_soa_array_offsets(&bld_base->uint_bld, index, 4, chan,
+                                        TRUE);
+      return build_gather(bld_base, &bld_base->base,
+                          LLVMBuildBitCast(builder, bld->inputs_array,
+                                           LLVMPointerType(LLVMFloatTypeInContext(gallivm->context), 0),
+                                           ""),
+                          index_vec, NULL);
+   }
+
+   return bld->inputs[base][chan];
+}
+
+
+static void
+emit_load_input(struct lp_build_nir_context *bld_base,
+                unsigned num_components,
+                unsigned bit_size,
+                unsigned base,
+                unsigned component,
+                LLVMValueRef vertex_index,
+                LLVMValueRef indir_index,
+                LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   unsigned i;
+
+   for (i = 0; i < num_components; i++) {
+      if (bit_size == 64) {
+         const unsigned chan = component + i * 2;
+         result[i] = emit_fetch_64bit(bld_base,
+                                      emit_fetch_input_chan(bld_base, base,
+                                                            chan,
+                                                            vertex_index,
+                                                            indir_index),
+                                      emit_fetch_input_chan(bld_base, base,
+                                                            chan + 1,
+                                                            vertex_index,
+                                                            indir_index));
+      }
+      else {
+         result[i] = emit_fetch_input_chan(bld_base, base, component + i,
+                                           vertex_index, indir_index);
+      }
+   }
+
+   /*
+    * TGSI, and so the interpolation code, represents gl_FrontFacing as a
+    * float which is positive for front faces.
+    */
+   if (bld_base->shader->info.stage == MESA_SHADER_FRAGMENT &&
+       !indir_index &&
+       bld->info->input_semantic_name[base] == TGSI_SEMANTIC_FACE) {
+      result[0] = lp_build_cmp(&bld_base->base, PIPE_FUNC_GREATER,
+                               result[0], bld_base->base.zero);
+   }
+}
+
+
+static void
+emit_store_output_chan(struct lp_build_nir_context *bld_base,
+                       unsigned base, unsigned chan,
+                       LLVMValueRef value)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+
+   base += chan / 4;
+   chan %= 4;
+
+   value = LLVMBuildBitCast(builder, value, bld_base->base.vec_type, "");
+   lp_exec_mask_store(&bld->exec_mask, &bld_base->base, value,
+                      bld->outputs[base][chan]);
+}
+
+
+static void
+emit_store_output(struct lp_build_nir_context *bld_base,
+                  unsigned writemask,
+                  unsigned bit_size,
+                  unsigned base,
+                  unsigned component,
+                  LLVMValueRef src[NIR_MAX_VEC_COMPONENTS])
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   unsigned i;
+
+   /*
+    * The fragment depth and stencil outputs are scalars in NIR, but live in
+    * the z and y channels of their TGSI output registers.
+    */
+   if (bld_base->shader->info.stage == MESA_SHADER_FRAGMENT) {
+      if (bld->info->output_semantic_name[base] == TGSI_SEMANTIC_POSITION)
+         component = 2;
+      else if (bld->info->output_semantic_name[base] == TGSI_SEMANTIC_STENCIL)
+         component = 1;
+   }
+
+   for (i = 0; i < NIR_MAX_VEC_COMPONENTS; i++) {
+      if (!(writemask & (1 << i)))
+         continue;
+
+      if (bit_size == 64) {
+         LLVMValueRef split[2];
+         const unsigned chan = component + i * 2;
+
+         emit_store_64bit_split(bld_base, src[i], split);
+         emit_store_output_chan(bld_base, base, chan, split[0]);
+         emit_store_output_chan(bld_base, base, chan + 1, split[1]);
+      }
+      else {
+         emit_store_output_chan(bld_base, base, component + i, src[i]);
+      }
+   }
+}
+
+
+/**
+ * Load one 32-bit word of a constant buffer per channel.
+ */
+static LLVMValueRef
+emit_load_ubo_word(struct lp_build_nir_context *bld_base,
+                   unsigned index,
+                   boolean offset_is_uniform,
+                   LLVMValueRef word_offset)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   LLVMValueRef consts_ptr = bld->consts[index];
+
+   if (offset_is_uniform) {
+      LLVMValueRef scalar_ptr = LLVMBuildGEP(builder, consts_ptr,
+                                             &word_offset, 1, "");
+      return lp_build_broadcast_scalar(&bld_base->base,
+                                       LLVMBuildLoad(builder, scalar_ptr, ""));
+   }
+   else {
+      /* Out of bounds accesses return zero, see emit_fetch_constant(). */
+      LLVMValueRef num_words =
+         lp_build_broadcast_scalar(uint_bld,
+                                   LLVMBuildShl(builder,
+                                                bld->consts_sizes[index],
+                                                lp_build_const_int32(gallivm,
+                                                                     2), ""));
+      LLVMValueRef overflow_mask =
+         lp_build_compare(gallivm, uint_bld->type, PIPE_FUNC_GEQUAL,
+                          word_offset, num_words);
+
+      return build_gather(bld_base, &bld_base->base, consts_ptr, word_offset,
+                          overflow_mask);
+   }
+}
+
+
+static void
+emit_load_ubo(struct lp_build_nir_context *bld_base,
+              unsigned nc,
+              unsigned bit_size,
+              boolean offset_is_uniform,
+              unsigned index,
+              LLVMValueRef offset,
+              LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const unsigned words = bit_size / 32;
+   unsigned c, w;
+
+   assert(index < LP_MAX_TGSI_CONST_BUFFERS);
+
+   if (offset_is_uniform)
+      offset = LLVMBuildLShr(builder, offset,
+                             lp_build_const_int32(gallivm, 2), "");
+   else
+      offset = lp_build_shr_imm(uint_bld, offset, 2);
+
+   for (c = 0; c < nc; c++) {
+      LLVMValueRef values[2];
+
+      for (w = 0; w < words; w++) {
+         const unsigned word = c * words + w;
+         LLVMValueRef word_offset;
+
+         if (offset_is_uniform)
+            word_offset = LLVMBuildAdd(builder, offset,
+                                       lp_build_const_int32(gallivm, word),
+                                       "");
+         else
+            word_offset = lp_build_add(uint_bld, offset,
+                                       lp_build_const_int_vec(gallivm,
+                                                              uint_bld->type,
+                                                              word));
+         values[w] = emit_load_ubo_word(bld_base, index, offset_is_uniform,
+                                        word_offset);
+      }
+      result[c] = words == 2 ?
+         emit_fetch_64bit(bld_base, values[0], values[1]) : values[0];
+   }
+}
+
+
+/**
+ * Get the base pointer (to 32 bit words) of the buffer or shared memory
+ * an access uses, and the number of words it holds.  The size is NULL for
+ * shared memory, whose accesses are not bounds checked.
+ */
+static void
+get_mem_ptr(struct lp_build_nir_soa_context *bld,
+            LLVMValueRef index,
+            LLVMValueRef *base_ptr,
+            LLVMValueRef *num_words)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+
+   assert(bld->cs_iface);
+
+   if (index) {
+      unsigned idx = LLVMConstIntGetZExtValue(index);
+
+      assert(idx < LP_MAX_TGSI_SHADER_BUFFERS);
+      *base_ptr = bld->ssbos[idx];
+      *num_words = LLVMBuildLShr(gallivm->builder, bld->ssbo_sizes[idx],
+                                 lp_build_const_int32(gallivm, 2), "");
+   }
+   else {
+      *base_ptr = bld->cs_iface->shared_ptr;
+      *num_words = NULL;
+   }
+}
+
+
+/**
+ * Begin a loop over the active lanes of the execution mask, see the
+ * function of the same name in lp_bld_tgsi_soa.c.
+ */
+static LLVMValueRef
+begin_lane_loop(struct lp_build_nir_context *bld_base,
+                struct lp_build_loop_state *loop_state,
+                struct lp_build_if_state *ifthen,
+                LLVMValueRef exec_mask)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef lane_active;
+
+   lp_build_loop_begin(loop_state, gallivm, lp_build_const_int32(gallivm, 0));
+
+   lane_active = LLVMBuildExtractElement(builder, exec_mask,
+                                         loop_state->counter, "");
+   lane_active = LLVMBuildICmp(builder, LLVMIntNE, lane_active,
+                               lp_build_const_int32(gallivm, 0), "");
+   lp_build_if(ifthen, gallivm, lane_active);
+
+   return loop_state->counter;
+}
+
+
+static void
+end_lane_loop(struct lp_build_nir_context *bld_base,
+              struct lp_build_loop_state *loop_state,
+              struct lp_build_if_state *ifthen)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+
+   lp_build_endif(ifthen);
+   lp_build_loop_end_cond(loop_state,
+                          lp_build_const_int32(gallivm,
+                                               bld_base->uint_bld.type.length),
+                          NULL, LLVMIntUGE);
+}
+
+
+static void
+begin_bounds_check(struct gallivm_state *gallivm,
+                   struct lp_build_if_state *ifthen,
+                   LLVMValueRef word_index,
+                   LLVMValueRef num_words)
+{
+   if (!num_words)
+      return;
+
+   lp_build_if(ifthen, gallivm,
+               LLVMBuildICmp(gallivm->builder, LLVMIntULT,
+                             word_index, num_words, ""));
+}
+
+
+static void
+end_bounds_check(struct lp_build_if_state *ifthen,
+                 LLVMValueRef num_words)
+{
+   if (num_words)
+      lp_build_endif(ifthen);
+}
+
+
+static void
+emit_load_mem(struct lp_build_nir_context *bld_base,
+              unsigned nc,
+              unsigned bit_size,
+              LLVMValueRef index,
+              LLVMValueRef offset,
+              LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const unsigned num_words_loaded = nc * bit_size / 32;
+   LLVMValueRef words[2 * NIR_MAX_VEC_COMPONENTS];
+   LLVMValueRef base_ptr, num_words, word_index, lane;
+   struct lp_build_loop_state loop_state;
+   struct lp_build_if_state lane_if;
+   unsigned w, c;
+
+   get_mem_ptr(bld, index, &base_ptr, &num_words);
+   word_index = lp_build_shr_imm(&bld_base->uint_bld, offset, 2);
+
+   for (w = 0; w < num_words_loaded; w++) {
+      words[w] = lp_build_alloca(gallivm, bld_base->uint_bld.vec_type,
+                                 "load_result");
+   }
+
+   lane = begin_lane_loop(bld_base, &loop_state, &lane_if,
+                          mask_vec(bld_base));
+   {
+      LLVMValueRef lane_index = LLVMBuildExtractElement(builder, word_index,
+                                                        lane, "");
+
+      for (w = 0; w < num_words_loaded; w++) {
+         struct lp_build_if_state bounds_if;
+         LLVMValueRef idx, value, vec;
+
+         idx = LLVMBuildAdd(builder, lane_index,
+                            lp_build_const_int32(gallivm, w), "");
+         begin_bounds_check(gallivm, &bounds_if, idx, num_words);
+         value = LLVMBuildLoad(builder,
+                               LLVMBuildGEP(builder, base_ptr, &idx, 1, ""),
+                               "");
+         vec = LLVMBuildLoad(builder, words[w], "");
+         vec = LLVMBuildInsertElement(builder, vec, value, lane, "");
+         LLVMBuildStore(builder, vec, words[w]);
+         end_bounds_check(&bounds_if, num_words);
+      }
+   }
+   end_lane_loop(bld_base, &loop_state, &lane_if);
+
+   for (w = 0; w < num_words_loaded; w++)
+      words[w] = LLVMBuildLoad(builder, words[w], "");
+
+   for (c = 0; c < nc; c++) {
+      if (bit_size == 64)
+         result[c] = emit_fetch_64bit(bld_base, words[c * 2],
+                                      words[c * 2 + 1]);
+      else
+         result[c] = words[c];
+   }
+}
+
+
+static void
+emit_store_mem(struct lp_build_nir_context *bld_base,
+               unsigned writemask,
+               unsigned nc,
+               unsigned bit_size,
+               LLVMValueRef index,
+               LLVMValueRef offset,
+               LLVMValueRef dst[NIR_MAX_VEC_COMPONENTS])
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const unsigned words_per_comp = bit_size / 32;
+   LLVMValueRef values[2 * NIR_MAX_VEC_COMPONENTS];
+   LLVMValueRef base_ptr, num_words, word_index, lane;
+   struct lp_build_loop_state loop_state;
+   struct lp_build_if_state lane_if;
+   unsigned w, c;
+
+   get_mem_ptr(bld, index, &base_ptr, &num_words);
+   word_index = lp_build_shr_imm(&bld_base->uint_bld, offset, 2);
+
+   for (c = 0; c < nc; c++) {
+      if (!(writemask & (1 << c)))
+         continue;
+      if (bit_size == 64) {
+         emit_store_64bit_split(bld_base, dst[c], &values[c * 2]);
+         values[c * 2] = LLVMBuildBitCast(builder, values[c * 2],
+                                          bld_base->uint_bld.vec_type, "");
+         values[c * 2 + 1] = LLVMBuildBitCast(builder, values[c * 2 + 1],
+                                              bld_base->uint_bld.vec_type,
+                                              "");
+      }
+      else {
+         values[c] = LLVMBuildBitCast(builder, dst[c],
+                                      bld_base->uint_bld.vec_type, "");
+      }
+   }
+
+   lane = begin_lane_loop(bld_base, &loop_state, &lane_if,
+                          mask_vec(bld_base));
+   {
+      LLVMValueRef lane_index = LLVMBuildExtractElement(builder, word_index,
+                                                        lane, "");
+
+      for (w = 0; w < nc * words_per_comp; w++) {
+         struct lp_build_if_state bounds_if;
+         LLVMValueRef idx, value;
+
+         if (!(writemask & (1 << (w / words_per_comp))))
+            continue;
+
+         idx = LLVMBuildAdd(builder, lane_index,
+                            lp_build_const_int32(gallivm, w), "");
+         begin_bounds_check(gallivm, &bounds_if, idx, num_words);
+         value = LLVMBuildExtractElement(builder, values[w], lane, "");
+         LLVMBuildStore(builder, value,
+                        LLVMBuildGEP(builder, base_ptr, &idx, 1, ""));
+         end_bounds_check(&bounds_if, num_words);
+      }
+   }
+   end_lane_loop(bld_base, &loop_state, &lane_if);
+}
+
+
+static void
+emit_atomic_mem(struct lp_build_nir_context *bld_base,
+                nir_intrinsic_op nir_op,
+                LLVMValueRef index,
+                LLVMValueRef offset,
+                LLVMValueRef val,
+                LLVMValueRef val2,
+                LLVMValueRef *result)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMAtomicRMWBinOp op = LLVMAtomicRMWBinOpAdd;
+   LLVMValueRef base_ptr, num_words, word_index, lane, res;
+   struct lp_build_loop_state loop_state;
+   struct lp_build_if_state lane_if;
+   boolean is_cmpxchg = FALSE;
+
+   switch (nir_op) {
+   case nir_intrinsic_ssbo_atomic_add:
+   case nir_intrinsic_shared_atomic_add:
+      op = LLVMAtomicRMWBinOpAdd;
+      break;
+   case nir_intrinsic_ssbo_atomic_exchange:
+   case nir_intrinsic_shared_atomic_exchange:
+      op = LLVMAtomicRMWBinOpXchg;
+      break;
+   case nir_intrinsic_ssbo_atomic_and:
+   case nir_intrinsic_shared_atomic_and:
+      op = LLVMAtomicRMWBinOpAnd;
+      break;
+   case nir_intrinsic_ssbo_atomic_or:
+   case nir_intrinsic_shared_atomic_or:
+      op = LLVMAtomicRMWBinOpOr;
+      break;
+   case nir_intrinsic_ssbo_atomic_xor:
+   case nir_intrinsic_shared_atomic_xor:
+      op = LLVMAtomicRMWBinOpXor;
+      break;
+   case nir_intrinsic_ssbo_atomic_umin:
+   case nir_intrinsic_shared_atomic_umin:
+      op = LLVMAtomicRMWBinOpUMin;
+      break;
+   case nir_intrinsic_ssbo_atomic_umax:
+   case nir_intrinsic_shared_atomic_umax:
+      op = LLVMAtomicRMWBinOpUMax;
+      break;
+   case nir_intrinsic_ssbo_atomic_imin:
+   case nir_intrinsic_shared_atomic_imin:
+      op = LLVMAtomicRMWBinOpMin;
+      break;
+   case nir_intrinsic_ssbo_atomic_imax:
+   case nir_intrinsic_shared_atomic_imax:
+      op = LLVMAtomicRMWBinOpMax;
+      break;
+   case nir_intrinsic_ssbo_atomic_comp_swap:
+   case nir_intrinsic_shared_atomic_comp_swap:
+      is_cmpxchg = TRUE;
+      break;
+   default:
+      assert(0);
+      *result = bld_base->uint_bld.undef;
+      return;
+   }
+
+   get_mem_ptr(bld, index, &base_ptr, &num_words);
+   word_index = lp_build_shr_imm(&bld_base->uint_bld, offset, 2);
+
+   res = lp_build_alloca(gallivm, bld_base->uint_bld.vec_type,
+                         "atomic_result");
+
+   lane = begin_lane_loop(bld_base, &loop_state, &lane_if,
+                          mask_vec(bld_base));
+   {
+      struct lp_build_if_state bounds_if;
+      LLVMValueRef idx, ptr, lane_value, old, vec;
+
+      idx = LLVMBuildExtractElement(builder, word_index, lane, "");
+      begin_bounds_check(gallivm, &bounds_if, idx, num_words);
+
+      ptr = LLVMBuildGEP(builder, base_ptr, &idx, 1, "");
+      ptr = LLVMBuildBitCast(builder, ptr,
+                             LLVMPointerType(LLVMInt32TypeInContext(gallivm->context), 0),
+                             "");
+      lane_value = LLVMBuildExtractElement(builder, val, lane, "");
+
+#if HAVE_LLVM >= 0x0309
+      if (is_cmpxchg) {
+         /* NIR puts the comparison first, then the new value. */
+         LLVMValueRef lane_value2 =
+            LLVMBuildExtractElement(builder, val2, lane, "");
+         old = LLVMBuildAtomicCmpXchg(builder, ptr, lane_value, lane_value2,
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      FALSE);
+         old = LLVMBuildExtractValue(builder, old, 0, "");
+      }
+      else
+#endif
+      {
+         assert(!is_cmpxchg);
+         old = LLVMBuildAtomicRMW(builder, op, ptr, lane_value,
+                                  LLVMAtomicOrderingSequentiallyConsistent,
+                                  FALSE);
+      }
+
+      vec = LLVMBuildLoad(builder, res, "");
+      vec = LLVMBuildInsertElement(builder, vec, old, lane, "");
+      LLVMBuildStore(builder, vec, res);
+
+      end_bounds_check(&bounds_if, num_words);
+   }
+   end_lane_loop(bld_base, &loop_state, &lane_if);
+
+   *result = LLVMBuildLoad(builder, res, "");
+}
+
+
+static void
+emit_get_buffer_size(struct lp_build_nir_context *bld_base,
+                     LLVMValueRef index,
+                     LLVMValueRef *result)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   const unsigned idx = LLVMConstIntGetZExtValue(index);
+
+   assert(idx < LP_MAX_TGSI_SHADER_BUFFERS);
+   *result = lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                       bld->ssbo_sizes[idx]);
+}
+
+
+static void
+emit_barrier(struct lp_build_nir_context *bld_base)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+
+   if (bld->cs_iface && bld->cs_iface->emit_barrier)
+      bld->cs_iface->emit_barrier(bld->cs_iface, &bld_base->base);
+}
+
+
+static void
+emit_tex(struct lp_build_nir_context *bld_base,
+         struct lp_sampler_params *params)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   unsigned i;
+
+   if (!bld->sampler) {
+      _debug_printf("warning: found texture instruction but no sampler generator supplied\n");
+      for (i = 0; i < 4; i++)
+         params->texel[i] = bld_base->base.undef;
+      return;
+   }
+
+   params->context_ptr = bld->context_ptr;
+   params->thread_data_ptr = bld->thread_data_ptr;
+   bld->sampler->emit_tex_sample(bld->sampler, bld_base->base.gallivm,
+                                 params);
+}
+
+
+static void
+emit_tex_size(struct lp_build_nir_context *bld_base,
+              struct lp_sampler_size_query_params *params)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   unsigned i;
+
+   if (!bld->sampler) {
+      _debug_printf("warning: found texture query instruction but no sampler generator supplied\n");
+      for (i = 0; i < 4; i++)
+         params->sizes_out[i] = bld_base->int_bld.undef;
+      return;
+   }
+
+   params->context_ptr = bld->context_ptr;
+   bld->sampler->emit_size_query(bld->sampler, bld_base->base.gallivm,
+                                 params);
+}
+
+
+static void
+emit_image_op(struct lp_build_nir_context *bld_base,
+              struct lp_img_params *params)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   unsigned i;
+
+   if (!bld->cs_iface || !bld->cs_iface->image) {
+      _debug_printf("warning: found image instruction but no image generator supplied\n");
+      if (params->img_op != LP_IMG_STORE) {
+         for (i = 0; i < 4; i++)
+            params->outdata[i] = bld_base->base.zero;
+      }
+      return;
+   }
+
+   params->type = bld_base->base.type;
+   params->exec_mask = mask_vec(bld_base);
+   params->context_ptr = bld->context_ptr;
+   bld->cs_iface->image->emit_op(bld->cs_iface->image,
+                                 bld_base->base.gallivm, params);
+}
+
+
+static void
+emit_image_size(struct lp_build_nir_context *bld_base,
+                struct lp_sampler_size_query_params *params)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   unsigned i;
+
+   if (!bld->cs_iface || !bld->cs_iface->image) {
+      _debug_printf("warning: found image query instruction but no image generator supplied\n");
+      for (i = 0; i < 4; i++)
+         params->sizes_out[i] = bld_base->int_bld.zero;
+      return;
+   }
+
+   params->context_ptr = bld->context_ptr;
+   bld->cs_iface->image->emit_size_query(bld->cs_iface->image,
+                                         bld_base->base.gallivm, params);
+}
+
+
+static void
+emit_sysval_intrin(struct lp_build_nir_context *bld_base,
+                   nir_intrinsic_instr *instr,
+                   LLVMValueRef result[NIR_MAX_VEC_COMPONENTS])
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct lp_bld_tgsi_system_values *sv = &bld->system_values;
+   unsigned i;
+
+   switch (instr->intrinsic) {
+   case nir_intrinsic_load_vertex_id:
+      result[0] = sv->vertex_id;
+      break;
+   case nir_intrinsic_load_vertex_id_zero_base:
+      result[0] = sv->vertex_id_nobase;
+      break;
+   case nir_intrinsic_load_base_vertex:
+      result[0] = sv->basevertex;
+      break;
+   case nir_intrinsic_load_instance_id:
+      result[0] = lp_build_broadcast_scalar(uint_bld, sv->instance_id);
+      break;
+   case nir_intrinsic_load_primitive_id:
+      result[0] = sv->prim_id;
+      break;
+   case nir_intrinsic_load_invocation_id:
+      result[0] = lp_build_broadcast_scalar(uint_bld, sv->invocation_id);
+      break;
+   case nir_intrinsic_load_local_invocation_id:
+      for (i = 0; i < 3; i++)
+         result[i] = sv->thread_id[i];
+      break;
+   case nir_intrinsic_load_work_group_id:
+      for (i = 0; i < 3; i++)
+         result[i] = lp_build_broadcast_scalar(uint_bld, sv->block_id[i]);
+      break;
+   case nir_intrinsic_load_num_work_groups:
+      for (i = 0; i < 3; i++)
+         result[i] = lp_build_broadcast_scalar(uint_bld, sv->grid_size[i]);
+      break;
+   case nir_intrinsic_load_local_group_size:
+      for (i = 0; i < 3; i++)
+         result[i] = lp_build_broadcast_scalar(uint_bld, sv->block_size[i]);
+      break;
+   default:
+      assert(0);
+      break;
+   }
+}
+
+
+/**
+ * Kill the fragments of the active channels for which cond is true, or all
+ * of the active channels when cond is NULL.
+ */
+static void
+emit_discard(struct lp_build_nir_context *bld_base, LLVMValueRef cond)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   LLVMValueRef mask;
+
+   if (!cond) {
+      if (bld->exec_mask.has_mask)
+         mask = LLVMBuildNot(builder, bld->exec_mask.exec_mask, "kilp");
+      else
+         mask = LLVMConstNull(bld_base->base.int_vec_type);
+   }
+   else {
+      mask = LLVMBuildNot(builder, cond, "");
+      if (bld->exec_mask.has_mask) {
+         LLVMValueRef invmask;
+         invmask = LLVMBuildNot(builder, bld->exec_mask.exec_mask, "kilp");
+         mask = LLVMBuildOr(builder, mask, invmask, "");
+      }
+   }
+
+   lp_build_mask_update(bld->mask, mask);
+   lp_build_mask_check(bld->mask);
+}
+
+
+static void
+increment_vec_ptr_by_mask(struct lp_build_nir_context *bld_base,
+                          LLVMValueRef ptr,
+                          LLVMValueRef mask)
+{
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   LLVMValueRef current_vec = LLVMBuildLoad(builder, ptr, "");
+
+   current_vec = LLVMBuildSub(builder, current_vec, mask, "");
+
+   LLVMBuildStore(builder, current_vec, ptr);
+}
+
+
+static void
+clear_uint_vec_ptr_from_mask(struct lp_build_nir_context *bld_base,
+                             LLVMValueRef ptr,
+                             LLVMValueRef mask)
+{
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   LLVMValueRef current_vec = LLVMBuildLoad(builder, ptr, "");
+
+   current_vec = lp_build_select(&bld_base->uint_bld,
+                                 mask,
+                                 bld_base->uint_bld.zero,
+                                 current_vec);
+
+   LLVMBuildStore(builder, current_vec, ptr);
+}
+
+
+static void
+emit_vertex(struct lp_build_nir_context *bld_base, uint32_t stream_id)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+
+   /* Only the first vertex stream is rasterized or captured, like TGSI. */
+   if (stream_id != 0)
+      return;
+
+   if (bld->gs_iface->emit_vertex) {
+      LLVMValueRef mask = mask_vec(bld_base);
+      LLVMValueRef total_emitted_vertices_vec =
+         LLVMBuildLoad(builder, bld->total_emitted_vertices_vec_ptr, "");
+      LLVMValueRef max_mask = lp_build_cmp(&bld_base->int_bld, PIPE_FUNC_LESS,
+                                           total_emitted_vertices_vec,
+                                           bld->max_output_vertices_vec);
+
+      mask = LLVMBuildAnd(builder, mask, max_mask, "");
+      bld->gs_iface->emit_vertex(bld->gs_iface, &bld_base->base,
+                                 bld->outputs,
+                                 total_emitted_vertices_vec);
+      increment_vec_ptr_by_mask(bld_base, bld->emitted_vertices_vec_ptr,
+                                mask);
+      increment_vec_ptr_by_mask(bld_base, bld->total_emitted_vertices_vec_ptr,
+                                mask);
+   }
+}
+
+
+static void
+end_primitive_masked(struct lp_build_nir_context *bld_base,
+                     LLVMValueRef mask)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+
+   if (bld->gs_iface->end_primitive) {
+      struct lp_build_context *uint_bld = &bld_base->uint_bld;
+      LLVMValueRef emitted_vertices_vec =
+         LLVMBuildLoad(builder, bld->emitted_vertices_vec_ptr, "");
+      LLVMValueRef emitted_prims_vec =
+         LLVMBuildLoad(builder, bld->emitted_prims_vec_ptr, "");
+      LLVMValueRef emitted_mask = lp_build_cmp(uint_bld, PIPE_FUNC_NOTEQUAL,
+                                               emitted_vertices_vec,
+                                               uint_bld->zero);
+
+      /* Only end the primitives of the channels with unflushed vertices. */
+      mask = LLVMBuildAnd(builder, mask, emitted_mask, "");
+
+      bld->gs_iface->end_primitive(bld->gs_iface, &bld_base->base,
+                                   emitted_vertices_vec,
+                                   emitted_prims_vec);
+
+      increment_vec_ptr_by_mask(bld_base, bld->emitted_prims_vec_ptr,
+                                mask);
+      clear_uint_vec_ptr_from_mask(bld_base, bld->emitted_vertices_vec_ptr,
+                                   mask);
+   }
+}
+
+
+static void
+end_primitive(struct lp_build_nir_context *bld_base, uint32_t stream_id)
+{
+   if (stream_id != 0)
+      return;
+
+   end_primitive_masked(bld_base, mask_vec(bld_base));
+}
+
+
+static void
+if_cond(struct lp_build_nir_context *bld_base, LLVMValueRef cond)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+
+   lp_exec_mask_cond_push(&bld->exec_mask, cond);
+}
+
+
+static void
+else_stmt(struct lp_build_nir_context *bld_base)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+
+   lp_exec_mask_cond_invert(&bld->exec_mask);
+}
+
+
+static void
+endif_stmt(struct lp_build_nir_context *bld_base)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+
+   lp_exec_mask_cond_pop(&bld->exec_mask);
+}
+
+
+static void
+bgnloop(struct lp_build_nir_context *bld_base)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+
+   lp_exec_bgnloop(&bld->exec_mask);
+}
+
+
+static void
+endloop(struct lp_build_nir_context *bld_base)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+
+   lp_exec_endloop(bld_base->base.gallivm, &bld->exec_mask);
+}
+
+
+static void
+break_stmt(struct lp_build_nir_context *bld_base)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+
+   /* NIR has no switch statements, so there is no pc to move */
+   lp_exec_break(&bld->exec_mask, NULL, FALSE);
+}
+
+
+static void
+continue_stmt(struct lp_build_nir_context *bld_base)
+{
+   struct lp_build_nir_soa_context *bld = lp_nir_soa_context(bld_base);
+
+   lp_exec_continue(&bld->exec_mask);
+}
+
+
+static void
+emit_prologue(struct lp_build_nir_soa_context *bld)
+{
+   struct lp_build_nir_context *bld_base = &bld->bld_base;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   const struct shader_info *info = &bld_base->shader->info;
+   unsigned i;
+
+   /*
+    * Fetch the buffer pointers up front, see the comment in
+    * lp_emit_declaration_soa() about doing it at each use.
+    */
+   for (i = 0; i < MIN2(info->num_ubos + 1, LP_MAX_TGSI_CONST_BUFFERS); i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      bld->consts[i] = lp_build_array_get(gallivm, bld->consts_ptr, index);
+      bld->consts_sizes[i] = lp_build_array_get(gallivm, bld->const_sizes_ptr,
+                                                index);
+   }
+
+   if (bld->cs_iface) {
+      for (i = 0; i < MIN2(info->num_ssbos, LP_MAX_TGSI_SHADER_BUFFERS); i++) {
+         LLVMValueRef index = lp_build_const_int32(gallivm, i);
+         bld->ssbos[i] = lp_build_array_get(gallivm, bld->cs_iface->ssbo_ptr,
+                                            index);
+         bld->ssbo_sizes[i] =
+            lp_build_array_get(gallivm, bld->cs_iface->ssbo_sizes_ptr, index);
+      }
+   }
+
+   /* Copy the inputs to an array, for indirect addressing */
+   if (bld->info->indirect_files & (1 << TGSI_FILE_INPUT) && !bld->gs_iface) {
+      unsigned index, chan;
+      LLVMTypeRef vec_type = bld_base->base.vec_type;
+      LLVMValueRef array_size = lp_build_const_int32(gallivm,
+            bld->info->file_max[TGSI_FILE_INPUT] * 4 + 4);
+      bld->inputs_array = lp_build_array_alloca(gallivm,
+                                               vec_type, array_size,
+                                               "input_array");
+
+      for (index = 0; index < bld->info->num_inputs; ++index) {
+         for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
+            LLVMValueRef lindex =
+               lp_build_const_int32(gallivm, index * 4 + chan);
+            LLVMValueRef input_ptr =
+               LLVMBuildGEP(gallivm->builder, bld->inputs_array,
+                            &lindex, 1, "");
+            LLVMValueRef value = bld->inputs[index][chan];
+            if (value)
+               LLVMBuildStore(gallivm->builder, value, input_ptr);
+         }
+      }
+   }
+
+   if (bld->gs_iface) {
+      struct lp_build_context *uint_bld = &bld_base->uint_bld;
+      bld->emitted_prims_vec_ptr =
+         lp_build_alloca(gallivm, uint_bld->vec_type, "emitted_prims_ptr");
+      bld->emitted_vertices_vec_ptr =
+         lp_build_alloca(gallivm, uint_bld->vec_type, "emitted_vertices_ptr");
+      bld->total_emitted_vertices_vec_ptr =
+         lp_build_alloca(gallivm, uint_bld->vec_type,
+                         "total_emitted_vertices_ptr");
+
+      LLVMBuildStore(gallivm->builder, uint_bld->zero,
+                     bld->emitted_prims_vec_ptr);
+      LLVMBuildStore(gallivm->builder, uint_bld->zero,
+                     bld->emitted_vertices_vec_ptr);
+      LLVMBuildStore(gallivm->builder, uint_bld->zero,
+                     bld->total_emitted_vertices_vec_ptr);
+   }
+}
+
+
+static void
+emit_epilogue(struct lp_build_nir_soa_context *bld)
+{
+   struct lp_build_nir_context *bld_base = &bld->bld_base;
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+
+   if (bld->gs_iface) {
+      LLVMValueRef total_emitted_vertices_vec;
+      LLVMValueRef emitted_prims_vec;
+
+      /* Implicit end of the last primitive, see emit_epilogue() in
+       * lp_bld_tgsi_soa.c.
+       */
+      end_primitive_masked(bld_base, lp_build_mask_value(bld->mask));
+
+      total_emitted_vertices_vec =
+         LLVMBuildLoad(builder, bld->total_emitted_vertices_vec_ptr, "");
+      emitted_prims_vec =
+         LLVMBuildLoad(builder, bld->emitted_prims_vec_ptr, "");
+
+      bld->gs_iface->gs_epilogue(bld->gs_iface, &bld_base->base,
+                                 total_emitted_vertices_vec,
+                                 emitted_prims_vec);
+   }
+}
+
+
+void
+lp_build_nir_soa(struct gallivm_state *gallivm,
+                 struct nir_shader *shader,
+                 struct lp_type type,
+                 struct lp_build_mask_context *mask,
+                 LLVMValueRef consts_ptr,
+                 LLVMValueRef const_sizes_ptr,
+                 const struct lp_bld_tgsi_system_values *system_values,
+                 const LLVMValueRef (*inputs)[TGSI_NUM_CHANNELS],
+                 LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS],
+                 LLVMValueRef context_ptr,
+                 LLVMValueRef thread_data_ptr,
+                 const struct lp_build_sampler_soa *sampler,
+                 const struct tgsi_shader_info *info,
+                 const struct lp_build_tgsi_gs_iface *gs_iface,
+                 const struct lp_build_tgsi_cs_iface *cs_iface)
+{
+   struct lp_build_nir_soa_context bld;
+
+   assert(type.length <= LP_MAX_VECTOR_LENGTH);
+
+   /* Setup build context */
+   memset(&bld, 0, sizeof bld);
+   lp_build_context_init(&bld.bld_base.base, gallivm, type);
+   lp_build_context_init(&bld.bld_base.uint_bld, gallivm, lp_uint_type(type));
+   lp_build_context_init(&bld.bld_base.int_bld, gallivm, lp_int_type(type));
+   {
+      struct lp_type dbl_type;
+      dbl_type = type;
+      dbl_type.width *= 2;
+      lp_build_context_init(&bld.bld_base.dbl_bld, gallivm, dbl_type);
+   }
+   {
+      struct lp_type uint64_type;
+      uint64_type = lp_uint_type(type);
+      uint64_type.width *= 2;
+      lp_build_context_init(&bld.bld_base.uint64_bld, gallivm, uint64_type);
+   }
+   {
+      struct lp_type int64_type;
+      int64_type = lp_int_type(type);
+      int64_type.width *= 2;
+      lp_build_context_init(&bld.bld_base.int64_bld, gallivm, int64_type);
+   }
+
+   bld.bld_base.load_reg = emit_load_reg;
+   bld.bld_base.store_reg = emit_store_reg;
+   bld.bld_base.load_input = emit_load_input;
+   bld.bld_base.store_output = emit_store_output;
+   bld.bld_base.load_ubo = emit_load_ubo;
+   bld.bld_base.load_mem = emit_load_mem;
+   bld.bld_base.store_mem = emit_store_mem;
+   bld.bld_base.atomic_mem = emit_atomic_mem;
+   bld.bld_base.get_buffer_size = emit_get_buffer_size;
+   bld.bld_base.barrier = emit_barrier;
+   bld.bld_base.tex = emit_tex;
+   bld.bld_base.tex_size = emit_tex_size;
+   bld.bld_base.image_op = emit_image_op;
+   bld.bld_base.image_size = emit_image_size;
+   bld.bld_base.sysval_intrin = emit_sysval_intrin;
+   bld.bld_base.discard = emit_discard;
+   bld.bld_base.emit_vertex = emit_vertex;
+   bld.bld_base.end_primitive = end_primitive;
+   bld.bld_base.if_cond = if_cond;
+   bld.bld_base.else_stmt = else_stmt;
+   bld.bld_base.endif_stmt = endif_stmt;
+   bld.bld_base.bgnloop = bgnloop;
+   bld.bld_base.endloop = endloop;
+   bld.bld_base.break_stmt = break_stmt;
+   bld.bld_base.continue_stmt = continue_stmt;
+   bld.bld_base.shader = shader;
+
+   bld.mask = mask;
+   bld.inputs = inputs;
+   bld.outputs = outputs;
+   bld.consts_ptr = consts_ptr;
+   bld.const_sizes_ptr = const_sizes_ptr;
+   bld.sampler = sampler;
+   bld.info = info;
+   bld.context_ptr = context_ptr;
+   bld.thread_data_ptr = thread_data_ptr;
+   bld.system_values = *system_values;
+   bld.cs_iface = cs_iface;
+
+   if (gs_iface) {
+      /* See lp_build_tgsi_soa() about the default. */
+      unsigned max_output_vertices = shader->info.gs.vertices_out;
+      if (!max_output_vertices)
+         max_output_vertices = 32;
+
+      bld.gs_iface = gs_iface;
+      bld.max_output_vertices_vec =
+         lp_build_const_int_vec(gallivm, bld.bld_base.int_bld.type,
+                                max_output_vertices);
+   }
+
+   lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
+
+   emit_prologue(&bld);
+   if (!lp_build_nir_llvm(&bld.bld_base, shader)) {
+      /* Kill the fragments rather than writing undefined values. */
+      _debug_printf("warning: failed to translate NIR shader\n");
+      if (mask)
+         lp_build_mask_update(mask, bld.bld_base.uint_bld.zero);
+   }
+   emit_epilogue(&bld);
+
+   lp_exec_mask_fini(&bld.exec_mask);
+}
@@ -48,6 +48,7 @@ extern "C" {
 
 struct pipe_resource;
 struct pipe_sampler_view;
+struct pipe_image_view;
 struct pipe_sampler_state;
 struct util_format_description;
 struct lp_type;
@@ -122,6 +123,39 @@ struct lp_sampler_size_query_params
    LLVMValueRef explicit_lod;
    LLVMValueRef *sizes_out;
 };
+
+
+/**
+ * Shader image operations, for lp_img_params::img_op.
+ */
+#define LP_IMG_LOAD       0
+#define LP_IMG_STORE      1
+#define LP_IMG_ATOMIC     2
+#define LP_IMG_ATOMIC_CAS 3
+
+/**
+ * Parameters of a shader image load, store or atomic.
+ *
+ * The coordinates are integers bitcast to type, with the layer (or cube
+ * face) in coords[2] like for texel fetches.  Stores take the texel in
+ * indata, atomics their operand in indata[0], and compare-and-swap the
+ * value to compare with in indata2[0].  Loads return the texel in outdata,
+ * atomics the old value in outdata[0].
+ */
+struct lp_img_params
+{
+   struct lp_type type;
+   unsigned image_index;
+   unsigned img_op;
+   unsigned target;
+   LLVMAtomicRMWBinOp op;
+   LLVMValueRef exec_mask;
+   LLVMValueRef context_ptr;
+   const LLVMValueRef *coords;
+   LLVMValueRef indata[4];
+   LLVMValueRef indata2[4];
+   LLVMValueRef *outdata;
+};
 /**
  * Texture static state.
  *
@@ -489,6 +523,10 @@ void
 lp_sampler_static_texture_state(struct lp_static_texture_state *state,
                                 const struct pipe_sampler_view *view);
 
+void
+lp_sampler_static_texture_state_image(struct lp_static_texture_state *state,
+                                      const struct pipe_image_view *view);
+
 
 void
 lp_build_lod_selector(struct lp_build_sample_context *bld,
@@ -626,6 +664,12 @@ lp_build_size_query_soa(struct gallivm_state *gallivm,
                         struct lp_sampler_dynamic_state *dynamic_state,
                         const struct lp_sampler_size_query_params *params);
 
+void
+lp_build_img_op_soa(const struct lp_static_texture_state *static_texture_state,
+                    struct lp_sampler_dynamic_state *dynamic_state,
+                    struct gallivm_state *gallivm,
+                    const struct lp_img_params *params);
+
 void
 lp_build_sample_nop(struct gallivm_state *gallivm, 
                     struct lp_type type,
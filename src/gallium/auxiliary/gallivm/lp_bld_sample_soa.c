@@ -3947,3 +3947,197 @@ lp_build_size_query_soa(struct gallivm_state *gallivm,
                                         num_levels);
    }
 }
+
+
+/**
+ * Load, store or atomically update the texels of a shader image, for the
+ * lanes of params->exec_mask which are set.
+ *
+ * Out of bounds loads and atomics return zero, and out of bounds stores
+ * are dropped, as with nothing bound.
+ */
+void
+lp_build_img_op_soa(const struct lp_static_texture_state *static_texture_state,
+                    struct lp_sampler_dynamic_state *dynamic_state,
+                    struct gallivm_state *gallivm,
+                    const struct lp_img_params *params)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   const unsigned target = params->target;
+   const unsigned dims = texture_dims(target);
+   const struct util_format_description *format_desc;
+   LLVMValueRef context_ptr = params->context_ptr;
+   unsigned image_index = params->image_index;
+   struct lp_type int_coord_type = lp_uint_type(params->type);
+   struct lp_build_context int_coord_bld;
+   LLVMValueRef x, y = NULL, z = NULL;
+   LLVMValueRef row_stride = NULL, img_stride = NULL;
+   LLVMValueRef base_ptr, size, offset, i, j, mask;
+   unsigned chan;
+
+   if (static_texture_state->format == PIPE_FORMAT_NONE) {
+      if (params->img_op != LP_IMG_STORE) {
+         for (chan = 0; chan < 4; chan++) {
+            params->outdata[chan] = lp_build_zero(gallivm, params->type);
+         }
+      }
+      return;
+   }
+
+   format_desc = util_format_description(static_texture_state->format);
+   lp_build_context_init(&int_coord_bld, gallivm, int_coord_type);
+
+   /*
+    * The unsigned compares against the size also catch negative
+    * coordinates.
+    */
+   mask = LLVMBuildBitCast(builder, params->exec_mask,
+                           int_coord_bld.vec_type, "");
+
+   x = LLVMBuildBitCast(builder, params->coords[0],
+                        int_coord_bld.vec_type, "");
+   size = dynamic_state->width(dynamic_state, gallivm,
+                               context_ptr, image_index);
+   size = lp_build_broadcast_scalar(&int_coord_bld, size);
+   mask = LLVMBuildAnd(builder, mask,
+                       lp_build_cmp(&int_coord_bld, PIPE_FUNC_LESS, x, size),
+                       "");
+
+   if (dims >= 2) {
+      y = LLVMBuildBitCast(builder, params->coords[1],
+                           int_coord_bld.vec_type, "");
+      size = dynamic_state->height(dynamic_state, gallivm,
+                                   context_ptr, image_index);
+      size = lp_build_broadcast_scalar(&int_coord_bld, size);
+      mask = LLVMBuildAnd(builder, mask,
+                          lp_build_cmp(&int_coord_bld, PIPE_FUNC_LESS, y, size),
+                          "");
+      row_stride = dynamic_state->row_stride(dynamic_state, gallivm,
+                                             context_ptr, image_index);
+      row_stride = lp_build_broadcast_scalar(&int_coord_bld, row_stride);
+   }
+
+   if (dims >= 3 || has_layer_coord(target)) {
+      z = LLVMBuildBitCast(builder, params->coords[2],
+                           int_coord_bld.vec_type, "");
+      size = dynamic_state->depth(dynamic_state, gallivm,
+                                  context_ptr, image_index);
+      size = lp_build_broadcast_scalar(&int_coord_bld, size);
+      mask = LLVMBuildAnd(builder, mask,
+                          lp_build_cmp(&int_coord_bld, PIPE_FUNC_LESS, z, size),
+                          "");
+      img_stride = dynamic_state->img_stride(dynamic_state, gallivm,
+                                             context_ptr, image_index);
+      img_stride = lp_build_broadcast_scalar(&int_coord_bld, img_stride);
+   }
+
+   base_ptr = dynamic_state->base_ptr(dynamic_state, gallivm,
+                                      context_ptr, image_index);
+
+   lp_build_sample_offset(&int_coord_bld, format_desc, x, y, z,
+                          row_stride, img_stride, &offset, &i, &j);
+
+   if (params->img_op == LP_IMG_LOAD) {
+      struct lp_type texel_type = params->type;
+      LLVMValueRef texel[4];
+
+      if (format_desc->channel[0].pure_integer) {
+         if (format_desc->channel[0].type == UTIL_FORMAT_TYPE_SIGNED)
+            texel_type = lp_int_type(params->type);
+         else
+            texel_type = lp_uint_type(params->type);
+      }
+
+      /* read the first texel in the inactive lanes, and zero them after */
+      offset = LLVMBuildAnd(builder, offset, mask, "");
+      lp_build_fetch_rgba_soa(gallivm, format_desc, texel_type, TRUE,
+                              base_ptr, offset, i, j, NULL, texel);
+
+      for (chan = 0; chan < 4; chan++) {
+         texel[chan] = LLVMBuildBitCast(builder, texel[chan],
+                                        int_coord_bld.vec_type, "");
+         texel[chan] = LLVMBuildAnd(builder, texel[chan], mask, "");
+         params->outdata[chan] = LLVMBuildBitCast(builder, texel[chan],
+                                                  lp_build_vec_type(gallivm, params->type),
+                                                  "");
+      }
+   }
+   else if (params->img_op == LP_IMG_STORE) {
+      lp_build_store_rgba_soa(gallivm, format_desc, params->type, mask,
+                              base_ptr, offset, params->indata);
+   }
+   else {
+      struct lp_build_loop_state loop_state;
+      struct lp_build_if_state ifthen;
+      LLVMTypeRef i32_ptr_type =
+         LLVMPointerType(LLVMInt32TypeInContext(gallivm->context), 0);
+      LLVMValueRef result, value, compare = NULL, cond, ptr, old, vec;
+
+      /* only the single channel 32 bit formats support atomics */
+      assert(format_desc->block.bits == 32 && format_desc->nr_channels == 1);
+
+      value = LLVMBuildBitCast(builder, params->indata[0],
+                               int_coord_bld.vec_type, "");
+      if (params->img_op == LP_IMG_ATOMIC_CAS) {
+         compare = LLVMBuildBitCast(builder, params->indata2[0],
+                                    int_coord_bld.vec_type, "");
+      }
+
+      result = lp_build_alloca(gallivm, int_coord_bld.vec_type,
+                               "atomic_result");
+
+      lp_build_loop_begin(&loop_state, gallivm,
+                          lp_build_const_int32(gallivm, 0));
+
+      cond = LLVMBuildExtractElement(builder, mask, loop_state.counter, "");
+      cond = LLVMBuildICmp(builder, LLVMIntNE, cond,
+                           LLVMConstNull(LLVMTypeOf(cond)), "");
+      lp_build_if(&ifthen, gallivm, cond);
+      {
+         LLVMValueRef lane_offset, lane_value;
+
+         lane_offset = LLVMBuildExtractElement(builder, offset,
+                                               loop_state.counter, "");
+         ptr = LLVMBuildGEP(builder, base_ptr, &lane_offset, 1, "");
+         ptr = LLVMBuildBitCast(builder, ptr, i32_ptr_type, "");
+         lane_value = LLVMBuildExtractElement(builder, value,
+                                              loop_state.counter, "");
+
+#if HAVE_LLVM >= 0x0309
+         if (params->img_op == LP_IMG_ATOMIC_CAS) {
+            LLVMValueRef lane_compare =
+               LLVMBuildExtractElement(builder, compare,
+                                       loop_state.counter, "");
+            old = LLVMBuildAtomicCmpXchg(builder, ptr, lane_compare,
+                                         lane_value,
+                                         LLVMAtomicOrderingSequentiallyConsistent,
+                                         LLVMAtomicOrderingSequentiallyConsistent,
+                                         FALSE);
+            old = LLVMBuildExtractValue(builder, old, 0, "");
+         }
+         else
+#endif
+         {
+            old = LLVMBuildAtomicRMW(builder, params->op, ptr, lane_value,
+                                     LLVMAtomicOrderingSequentiallyConsistent,
+                                     FALSE);
+         }
+
+         vec = LLVMBuildLoad(builder, result, "");
+         vec = LLVMBuildInsertElement(builder, vec, old,
+                                      loop_state.counter, "");
+         LLVMBuildStore(builder, vec, result);
+      }
+      lp_build_endif(&ifthen);
+
+      lp_build_loop_end_cond(&loop_state,
+                             lp_build_const_int32(gallivm,
+                                                  params->type.length),
+                             NULL, LLVMIntUGE);
+
+      params->outdata[0] = LLVMBuildBitCast(builder,
+                                            LLVMBuildLoad(builder, result, ""),
+                                            lp_build_vec_type(gallivm, params->type),
+                                            "");
+   }
+}
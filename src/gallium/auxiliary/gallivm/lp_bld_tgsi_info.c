@@ -307,6 +307,11 @@ analyse_instruction(struct analysis_context *ctx,
          max_regs = ARRAY_SIZE(info->output);
       } else if (dst->File == TGSI_FILE_ADDRESS) {
          continue;
+      } else if (dst->File == TGSI_FILE_BUFFER ||
+                 dst->File == TGSI_FILE_MEMORY ||
+                 dst->File == TGSI_FILE_IMAGE) {
+         /* memory stores don't produce register values */
+         continue;
       } else {
          assert(0);
          continue;
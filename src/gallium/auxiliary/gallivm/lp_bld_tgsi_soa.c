@@ -67,10 +67,6 @@
 #include "lp_bld_sample.h"
 #include "lp_bld_struct.h"
 
-/* SM 4.0 says that subroutines can nest 32 deep and 
- * we need one more for our main function */
-#define LP_MAX_NUM_FUNCS 33
-
 #define DUMP_GS_EMITS 0
 
 /*
@@ -103,402 +99,6 @@ emit_dump_reg(struct gallivm_state *gallivm,
    lp_build_print_value(gallivm, buf, value);
 }
 
-/*
- * Return the context for the current function.
- * (always 'main', if shader doesn't do any function calls)
- */
-static inline struct function_ctx *
-func_ctx(struct lp_exec_mask *mask)
-{
-   assert(mask->function_stack_size > 0);
-   assert(mask->function_stack_size <= LP_MAX_NUM_FUNCS);
-   return &mask->function_stack[mask->function_stack_size - 1];
-}
-
-/*
- * Returns true if we're in a loop.
- * It's global, meaning that it returns true even if there's
- * no loop inside the current function, but we were inside
- * a loop inside another function, from which this one was called.
- */
-static inline boolean
-mask_has_loop(struct lp_exec_mask *mask)
-{
-   int i;
-   for (i = mask->function_stack_size - 1; i >= 0; --i) {
-      const struct function_ctx *ctx = &mask->function_stack[i];
-      if (ctx->loop_stack_size > 0)
-         return TRUE;
-   }
-   return FALSE;
-}
-
-/*
- * Returns true if we're inside a switch statement.
- * It's global, meaning that it returns true even if there's
- * no switch in the current function, but we were inside
- * a switch inside another function, from which this one was called.
- */
-static inline boolean
-mask_has_switch(struct lp_exec_mask *mask)
-{
-   int i;
-   for (i = mask->function_stack_size - 1; i >= 0; --i) {
-      const struct function_ctx *ctx = &mask->function_stack[i];
-      if (ctx->switch_stack_size > 0)
-         return TRUE;
-   }
-   return FALSE;
-}
-
-/*
- * Returns true if we're inside a conditional.
- * It's global, meaning that it returns true even if there's
- * no conditional in the current function, but we were inside
- * a conditional inside another function, from which this one was called.
- */
-static inline boolean
-mask_has_cond(struct lp_exec_mask *mask)
-{
-   int i;
-   for (i = mask->function_stack_size - 1; i >= 0; --i) {
-      const struct function_ctx *ctx = &mask->function_stack[i];
-      if (ctx->cond_stack_size > 0)
-         return TRUE;
-   }
-   return FALSE;
-}
-
-
-/*
- * Initialize a function context at the specified index.
- */
-static void
-lp_exec_mask_function_init(struct lp_exec_mask *mask, int function_idx)
-{
-   LLVMTypeRef int_type = LLVMInt32TypeInContext(mask->bld->gallivm->context);
-   LLVMBuilderRef builder = mask->bld->gallivm->builder;
-   struct function_ctx *ctx =  &mask->function_stack[function_idx];
-
-   ctx->cond_stack_size = 0;
-   ctx->loop_stack_size = 0;
-   ctx->switch_stack_size = 0;
-
-   if (function_idx == 0) {
-      ctx->ret_mask = mask->ret_mask;
-   }
-
-   ctx->loop_limiter = lp_build_alloca(mask->bld->gallivm,
-                                       int_type, "looplimiter");
-   LLVMBuildStore(
-      builder,
-      LLVMConstInt(int_type, LP_MAX_TGSI_LOOP_ITERATIONS, false),
-      ctx->loop_limiter);
-}
-
-static void lp_exec_mask_init(struct lp_exec_mask *mask, struct lp_build_context *bld)
-{
-   mask->bld = bld;
-   mask->has_mask = FALSE;
-   mask->ret_in_main = FALSE;
-   /* For the main function */
-   mask->function_stack_size = 1;
-
-   mask->int_vec_type = lp_build_int_vec_type(bld->gallivm, mask->bld->type);
-   mask->exec_mask = mask->ret_mask = mask->break_mask = mask->cont_mask =
-         mask->cond_mask = mask->switch_mask =
-         LLVMConstAllOnes(mask->int_vec_type);
-
-   mask->function_stack = CALLOC(LP_MAX_NUM_FUNCS,
-                                 sizeof(mask->function_stack[0]));
-   lp_exec_mask_function_init(mask, 0);
-}
-
-static void
-lp_exec_mask_fini(struct lp_exec_mask *mask)
-{
-   FREE(mask->function_stack);
-}
-
-static void lp_exec_mask_update(struct lp_exec_mask *mask)
-{
-   LLVMBuilderRef builder = mask->bld->gallivm->builder;
-   boolean has_loop_mask = mask_has_loop(mask);
-   boolean has_cond_mask = mask_has_cond(mask);
-   boolean has_switch_mask = mask_has_switch(mask);
-   boolean has_ret_mask = mask->function_stack_size > 1 ||
-         mask->ret_in_main;
-
-   if (has_loop_mask) {
-      /*for loops we need to update the entire mask at runtime */
-      LLVMValueRef tmp;
-      assert(mask->break_mask);
-      tmp = LLVMBuildAnd(builder,
-                         mask->cont_mask,
-                         mask->break_mask,
-                         "maskcb");
-      mask->exec_mask = LLVMBuildAnd(builder,
-                                     mask->cond_mask,
-                                     tmp,
-                                     "maskfull");
-   } else
-      mask->exec_mask = mask->cond_mask;
-
-   if (has_switch_mask) {
-      mask->exec_mask = LLVMBuildAnd(builder,
-                                     mask->exec_mask,
-                                     mask->switch_mask,
-                                     "switchmask");
-   }
-
-   if (has_ret_mask) {
-      mask->exec_mask = LLVMBuildAnd(builder,
-                                     mask->exec_mask,
-                                     mask->ret_mask,
-                                     "callmask");
-   }
-
-   mask->has_mask = (has_cond_mask ||
-                     has_loop_mask ||
-                     has_switch_mask ||
-                     has_ret_mask);
-}
-
-static void lp_exec_mask_cond_push(struct lp_exec_mask *mask,
-                                   LLVMValueRef val)
-{
-   LLVMBuilderRef builder = mask->bld->gallivm->builder;
-   struct function_ctx *ctx = func_ctx(mask);
-
-   if (ctx->cond_stack_size >= LP_MAX_TGSI_NESTING) {
-      ctx->cond_stack_size++;
-      return;
-   }
-   if (ctx->cond_stack_size == 0 && mask->function_stack_size == 1) {
-      assert(mask->cond_mask == LLVMConstAllOnes(mask->int_vec_type));
-   }
-   ctx->cond_stack[ctx->cond_stack_size++] = mask->cond_mask;
-   assert(LLVMTypeOf(val) == mask->int_vec_type);
-   mask->cond_mask = LLVMBuildAnd(builder,
-                                  mask->cond_mask,
-                                  val,
-                                  "");
-   lp_exec_mask_update(mask);
-}
-
-static void lp_exec_mask_cond_invert(struct lp_exec_mask *mask)
-{
-   LLVMBuilderRef builder = mask->bld->gallivm->builder;
-   struct function_ctx *ctx = func_ctx(mask);
-   LLVMValueRef prev_mask;
-   LLVMValueRef inv_mask;
-
-   assert(ctx->cond_stack_size);
-   if (ctx->cond_stack_size >= LP_MAX_TGSI_NESTING)
-      return;
-   prev_mask = ctx->cond_stack[ctx->cond_stack_size - 1];
-   if (ctx->cond_stack_size == 1 && mask->function_stack_size == 1) {
-      assert(prev_mask == LLVMConstAllOnes(mask->int_vec_type));
-   }
-
-   inv_mask = LLVMBuildNot(builder, mask->cond_mask, "");
-
-   mask->cond_mask = LLVMBuildAnd(builder,
-                                  inv_mask,
-                                  prev_mask, "");
-   lp_exec_mask_update(mask);
-}
-
-static void lp_exec_mask_cond_pop(struct lp_exec_mask *mask)
-{
-   struct function_ctx *ctx = func_ctx(mask);
-   assert(ctx->cond_stack_size);
-   --ctx->cond_stack_size;
-   if (ctx->cond_stack_size >= LP_MAX_TGSI_NESTING)
-      return;
-   mask->cond_mask = ctx->cond_stack[ctx->cond_stack_size];
-   lp_exec_mask_update(mask);
-}
-
-static void lp_exec_bgnloop(struct lp_exec_mask *mask)
-{
-   LLVMBuilderRef builder = mask->bld->gallivm->builder;
-   struct function_ctx *ctx = func_ctx(mask);
-
-   if (ctx->loop_stack_size >= LP_MAX_TGSI_NESTING) {
-      ++ctx->loop_stack_size;
-      return;
-   }
-
-   ctx->break_type_stack[ctx->loop_stack_size + ctx->switch_stack_size] =
-      ctx->break_type;
-   ctx->break_type = LP_EXEC_MASK_BREAK_TYPE_LOOP;
-
-   ctx->loop_stack[ctx->loop_stack_size].loop_block = ctx->loop_block;
-   ctx->loop_stack[ctx->loop_stack_size].cont_mask = mask->cont_mask;
-   ctx->loop_stack[ctx->loop_stack_size].break_mask = mask->break_mask;
-   ctx->loop_stack[ctx->loop_stack_size].break_var = ctx->break_var;
-   ++ctx->loop_stack_size;
-
-   ctx->break_var = lp_build_alloca(mask->bld->gallivm, mask->int_vec_type, "");
-   LLVMBuildStore(builder, mask->break_mask, ctx->break_var);
-
-   ctx->loop_block = lp_build_insert_new_block(mask->bld->gallivm, "bgnloop");
-
-   LLVMBuildBr(builder, ctx->loop_block);
-   LLVMPositionBuilderAtEnd(builder, ctx->loop_block);
-
-   mask->break_mask = LLVMBuildLoad(builder, ctx->break_var, "");
-
-   lp_exec_mask_update(mask);
-}
-
-static void lp_exec_break(struct lp_exec_mask *mask,
-                          struct lp_build_tgsi_context * bld_base)
-{
-   LLVMBuilderRef builder = mask->bld->gallivm->builder;
-   struct function_ctx *ctx = func_ctx(mask);
-
-   if (ctx->break_type == LP_EXEC_MASK_BREAK_TYPE_LOOP) {
-      LLVMValueRef exec_mask = LLVMBuildNot(builder,
-                                            mask->exec_mask,
-                                            "break");
-
-      mask->break_mask = LLVMBuildAnd(builder,
-                                      mask->break_mask,
-                                      exec_mask, "break_full");
-   }
-   else {
-      enum tgsi_opcode opcode =
-         bld_base->instructions[bld_base->pc + 1].Instruction.Opcode;
-      boolean break_always = (opcode == TGSI_OPCODE_ENDSWITCH ||
-                              opcode == TGSI_OPCODE_CASE);
-
-
-      if (ctx->switch_in_default) {
-         /*
-          * stop default execution but only if this is an unconditional switch.
-          * (The condition here is not perfect since dead code after break is
-          * allowed but should be sufficient since false negatives are just
-          * unoptimized - so we don't have to pre-evaluate that).
-          */
-         if(break_always && ctx->switch_pc) {
-            bld_base->pc = ctx->switch_pc;
-            return;
-         }
-      }
-
-      if (break_always) {
-         mask->switch_mask = LLVMConstNull(mask->bld->int_vec_type);
-      }
-      else {
-         LLVMValueRef exec_mask = LLVMBuildNot(builder,
-                                               mask->exec_mask,
-                                               "break");
-         mask->switch_mask = LLVMBuildAnd(builder,
-                                          mask->switch_mask,
-                                          exec_mask, "break_switch");
-      }
-   }
-
-   lp_exec_mask_update(mask);
-}
-
-static void lp_exec_continue(struct lp_exec_mask *mask)
-{
-   LLVMBuilderRef builder = mask->bld->gallivm->builder;
-   LLVMValueRef exec_mask = LLVMBuildNot(builder,
-                                         mask->exec_mask,
-                                         "");
-
-   mask->cont_mask = LLVMBuildAnd(builder,
-                                  mask->cont_mask,
-                                  exec_mask, "");
-
-   lp_exec_mask_update(mask);
-}
-
-
-static void lp_exec_endloop(struct gallivm_state *gallivm,
-                            struct lp_exec_mask *mask)
-{
-   LLVMBuilderRef builder = mask->bld->gallivm->builder;
-   struct function_ctx *ctx = func_ctx(mask);
-   LLVMBasicBlockRef endloop;
-   LLVMTypeRef int_type = LLVMInt32TypeInContext(mask->bld->gallivm->context);
-   LLVMTypeRef reg_type = LLVMIntTypeInContext(gallivm->context,
-                                               mask->bld->type.width *
-                                               mask->bld->type.length);
-   LLVMValueRef i1cond, i2cond, icond, limiter;
-
-   assert(mask->break_mask);
-
-   
-   assert(ctx->loop_stack_size);
-   if (ctx->loop_stack_size > LP_MAX_TGSI_NESTING) {
-      --ctx->loop_stack_size;
-      return;
-   }
-
-   /*
-    * Restore the cont_mask, but don't pop
-    */
-   mask->cont_mask = ctx->loop_stack[ctx->loop_stack_size - 1].cont_mask;
-   lp_exec_mask_update(mask);
-
-   /*
-    * Unlike the continue mask, the break_mask must be preserved across loop
-    * iterations
-    */
-   LLVMBuildStore(builder, mask->break_mask, ctx->break_var);
-
-   /* Decrement the loop limiter */
-   limiter = LLVMBuildLoad(builder, ctx->loop_limiter, "");
-
-   limiter = LLVMBuildSub(
-      builder,
-      limiter,
-      LLVMConstInt(int_type, 1, false),
-      "");
-
-   LLVMBuildStore(builder, limiter, ctx->loop_limiter);
-
-   /* i1cond = (mask != 0) */
-   i1cond = LLVMBuildICmp(
-      builder,
-      LLVMIntNE,
-      LLVMBuildBitCast(builder, mask->exec_mask, reg_type, ""),
-      LLVMConstNull(reg_type), "i1cond");
-
-   /* i2cond = (looplimiter > 0) */
-   i2cond = LLVMBuildICmp(
-      builder,
-      LLVMIntSGT,
-      limiter,
-      LLVMConstNull(int_type), "i2cond");
-
-   /* if( i1cond && i2cond ) */
-   icond = LLVMBuildAnd(builder, i1cond, i2cond, "");
-
-   endloop = lp_build_insert_new_block(mask->bld->gallivm, "endloop");
-
-   LLVMBuildCondBr(builder,
-                   icond, ctx->loop_block, endloop);
-
-   LLVMPositionBuilderAtEnd(builder, endloop);
-
-   assert(ctx->loop_stack_size);
-   --ctx->loop_stack_size;
-   mask->cont_mask = ctx->loop_stack[ctx->loop_stack_size].cont_mask;
-   mask->break_mask = ctx->loop_stack[ctx->loop_stack_size].break_mask;
-   ctx->loop_block = ctx->loop_stack[ctx->loop_stack_size].loop_block;
-   ctx->break_var = ctx->loop_stack[ctx->loop_stack_size].break_var;
-   ctx->break_type = ctx->break_type_stack[ctx->loop_stack_size +
-         ctx->switch_stack_size];
-
-   lp_exec_mask_update(mask);
-}
-
 static void lp_exec_switch(struct lp_exec_mask *mask,
                            LLVMValueRef switchval)
 {
@@ -727,34 +327,6 @@ static void lp_exec_default(struct lp_exec_mask *mask,
 }
 
 
-/* stores val into an address pointed to by dst_ptr.
- * mask->exec_mask is used to figure out which bits of val
- * should be stored into the address
- * (0 means don't store this bit, 1 means do store).
- */
-static void lp_exec_mask_store(struct lp_exec_mask *mask,
-                               struct lp_build_context *bld_store,
-                               LLVMValueRef val,
-                               LLVMValueRef dst_ptr)
-{
-   LLVMBuilderRef builder = mask->bld->gallivm->builder;
-   LLVMValueRef exec_mask = mask->has_mask ? mask->exec_mask : NULL;
-
-   assert(lp_check_value(bld_store->type, val));
-   assert(LLVMGetTypeKind(LLVMTypeOf(dst_ptr)) == LLVMPointerTypeKind);
-   assert(LLVMGetElementType(LLVMTypeOf(dst_ptr)) == LLVMTypeOf(val) ||
-          LLVMGetTypeKind(LLVMGetElementType(LLVMTypeOf(dst_ptr))) == LLVMArrayTypeKind);
-
-   if (exec_mask) {
-      LLVMValueRef res, dst;
-
-      dst = LLVMBuildLoad(builder, dst_ptr, "");
-      res = lp_build_select(bld_store, exec_mask, val, dst);
-      LLVMBuildStore(builder, res, dst_ptr);
-   } else
-      LLVMBuildStore(builder, val, dst_ptr);
-}
-
 static void lp_exec_mask_call(struct lp_exec_mask *mask,
                               int func,
                               int *pc)
@@ -1560,7 +1132,7 @@ emit_fetch_gs_input(
       vertex_index = lp_build_const_int32(gallivm, reg->Dimension.Index);
    }
 
-   res = bld->gs_iface->fetch_input(bld->gs_iface, bld_base,
+   res = bld->gs_iface->fetch_input(bld->gs_iface, &bld_base->base,
                                     reg->Dimension.Indirect,
                                     vertex_index,
                                     reg->Register.Indirect,
@@ -1571,7 +1143,7 @@ emit_fetch_gs_input(
    if (tgsi_type_is_64bit(stype)) {
       LLVMValueRef swizzle_index = lp_build_const_int32(gallivm, swizzle_in >> 16);
       LLVMValueRef res2;
-      res2 = bld->gs_iface->fetch_input(bld->gs_iface, bld_base,
+      res2 = bld->gs_iface->fetch_input(bld->gs_iface, &bld_base->base,
                                         reg->Dimension.Indirect,
                                         vertex_index,
                                         reg->Register.Indirect,
@@ -1670,6 +1242,7 @@ emit_fetch_system_value(
    LLVMBuilderRef builder = gallivm->builder;
    LLVMValueRef res;
    enum tgsi_opcode_type atype; // Actual type of the value
+   unsigned swizzle = swizzle_in & 0xffff;
 
    assert(!reg->Register.Indirect);
 
@@ -1704,6 +1277,36 @@ emit_fetch_system_value(
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
+   case TGSI_SEMANTIC_THREAD_ID:
+      res = swizzle < 3 ? bld->system_values.thread_id[swizzle] :
+                          bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_ID:
+      res = swizzle < 3 ?
+         lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                   bld->system_values.block_id[swizzle]) :
+         bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_GRID_SIZE:
+      res = swizzle < 3 ?
+         lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                   bld->system_values.grid_size[swizzle]) :
+         bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_SIZE:
+      res = swizzle < 3 ?
+         lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                   bld->system_values.block_size[swizzle]) :
+         bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
    default:
       assert(!"unexpected semantic in emit_fetch_system_value");
       res = bld_base->base.zero;
@@ -2962,6 +2565,19 @@ lp_emit_declaration_soa(
    }
       break;
 
+   case TGSI_FILE_BUFFER:
+      /* see the comment about constant buffers above */
+      assert(bld->cs_iface);
+      for (idx = first; idx <= last; ++idx) {
+         LLVMValueRef index = lp_build_const_int32(gallivm, idx);
+         assert(idx < LP_MAX_TGSI_SHADER_BUFFERS);
+         bld->ssbos[idx] =
+            lp_build_array_get(gallivm, bld->cs_iface->ssbo_ptr, index);
+         bld->ssbo_sizes[idx] =
+            lp_build_array_get(gallivm, bld->cs_iface->ssbo_sizes_ptr, index);
+      }
+      break;
+
    default:
       /* don't need to declare other vars */
       break;
@@ -3413,6 +3029,527 @@ clamp_mask_to_max_output_vertices(struct lp_build_tgsi_soa_context * bld,
    return LLVMBuildAnd(builder, current_mask_vec, max_mask, "");
 }
 
+/**
+ * Get the base pointer (to 32 bit words) of the buffer or shared memory
+ * an instruction accesses, and the number of words it holds.  The size is
+ * NULL for shared memory, whose accesses are not bounds checked.
+ */
+static void
+get_mem_ptr(struct lp_build_tgsi_soa_context *bld,
+            const struct tgsi_full_src_register *resource,
+            LLVMValueRef *base_ptr,
+            LLVMValueRef *num_words)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+
+   assert(!resource->Register.Indirect);
+
+   if (resource->Register.File == TGSI_FILE_BUFFER) {
+      unsigned idx = resource->Register.Index;
+
+      assert(idx < LP_MAX_TGSI_SHADER_BUFFERS);
+      *base_ptr = bld->ssbos[idx];
+      *num_words = LLVMBuildLShr(gallivm->builder, bld->ssbo_sizes[idx],
+                                 lp_build_const_int32(gallivm, 2), "");
+   }
+   else {
+      assert(resource->Register.File == TGSI_FILE_MEMORY);
+      *base_ptr = bld->cs_iface->shared_ptr;
+      *num_words = NULL;
+   }
+}
+
+
+/**
+ * Begin a loop over the active lanes of the execution mask, for memory
+ * accesses which have to be done one element at a time.  Returns the lane
+ * index; the code emitted until end_lane_loop() only runs for active lanes.
+ */
+static LLVMValueRef
+begin_lane_loop(struct lp_build_tgsi_soa_context *bld,
+                struct lp_build_loop_state *loop_state,
+                struct lp_build_if_state *ifthen,
+                LLVMValueRef exec_mask)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef lane_active;
+
+   lp_build_loop_begin(loop_state, gallivm, lp_build_const_int32(gallivm, 0));
+
+   lane_active = LLVMBuildExtractElement(builder, exec_mask,
+                                         loop_state->counter, "");
+   lane_active = LLVMBuildICmp(builder, LLVMIntNE, lane_active,
+                               lp_build_const_int32(gallivm, 0), "");
+   lp_build_if(ifthen, gallivm, lane_active);
+
+   return loop_state->counter;
+}
+
+
+static void
+end_lane_loop(struct lp_build_tgsi_soa_context *bld,
+              struct lp_build_loop_state *loop_state,
+              struct lp_build_if_state *ifthen)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+
+   lp_build_endif(ifthen);
+   lp_build_loop_end_cond(loop_state,
+                          lp_build_const_int32(gallivm,
+                                               bld->bld_base.uint_bld.type.length),
+                          NULL, LLVMIntUGE);
+}
+
+
+/**
+ * Begin code which only runs when the word index is within the buffer.
+ * Out of bounds reads return zero, and out of bounds writes are dropped.
+ */
+static void
+begin_bounds_check(struct gallivm_state *gallivm,
+                   struct lp_build_if_state *ifthen,
+                   LLVMValueRef word_index,
+                   LLVMValueRef num_words)
+{
+   LLVMValueRef in_bounds;
+
+   if (!num_words)
+      return;
+
+   in_bounds = LLVMBuildICmp(gallivm->builder, LLVMIntULT,
+                             word_index, num_words, "");
+   lp_build_if(ifthen, gallivm, in_bounds);
+}
+
+
+static void
+end_bounds_check(struct lp_build_if_state *ifthen,
+                 LLVMValueRef num_words)
+{
+   if (num_words)
+      lp_build_endif(ifthen);
+}
+
+
+/** Fetch the byte offset operand of a memory instruction, as word index */
+static LLVMValueRef
+fetch_word_index(struct lp_build_tgsi_context *bld_base,
+                 const struct tgsi_full_instruction *inst,
+                 unsigned src_op)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMValueRef offset;
+
+   offset = lp_build_emit_fetch(bld_base, inst, src_op, TGSI_CHAN_X);
+   offset = LLVMBuildBitCast(gallivm->builder, offset,
+                             bld_base->uint_bld.vec_type, "");
+   return lp_build_shr_imm(&bld_base->uint_bld, offset, 2);
+}
+
+
+/**
+ * Emit a load, store or atomic on an image through the image code
+ * generator.  The coordinates are the first source after the resource, and
+ * the layer of 1D arrays moves to coords[2] like for texel fetches.
+ */
+static void
+img_op_emit(struct lp_build_tgsi_soa_context *bld,
+            struct lp_build_emit_data *emit_data,
+            unsigned img_op,
+            LLVMAtomicRMWBinOp op)
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const unsigned coord_src = img_op == LP_IMG_STORE ? 0 : 1;
+   struct lp_img_params params;
+   LLVMValueRef coords[3], outdata[4];
+   unsigned dims, chan;
+
+   memset(&params, 0, sizeof params);
+   params.type = bld_base->base.type;
+   params.image_index = img_op == LP_IMG_STORE ?
+      inst->Dst[0].Register.Index : inst->Src[0].Register.Index;
+   params.img_op = img_op;
+   params.target = tgsi_to_pipe_tex_target(inst->Memory.Texture);
+   params.op = op;
+   params.exec_mask = mask_vec(bld_base);
+   params.context_ptr = bld->context_ptr;
+   params.coords = coords;
+   params.outdata = outdata;
+
+   dims = texture_dims(params.target);
+   coords[0] = lp_build_emit_fetch(bld_base, inst, coord_src, TGSI_CHAN_X);
+   coords[1] = coords[2] = bld_base->base.undef;
+   if (dims >= 2)
+      coords[1] = lp_build_emit_fetch(bld_base, inst, coord_src, TGSI_CHAN_Y);
+   if (dims >= 3 || has_layer_coord(params.target))
+      coords[2] = lp_build_emit_fetch(bld_base, inst, coord_src,
+                                      dims == 1 ? TGSI_CHAN_Y : TGSI_CHAN_Z);
+
+   if (img_op == LP_IMG_STORE) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+         params.indata[chan] = lp_build_emit_fetch(bld_base, inst, 1, chan);
+   }
+   else if (img_op == LP_IMG_ATOMIC_CAS) {
+      params.indata2[0] = lp_build_emit_fetch(bld_base, inst, 2, TGSI_CHAN_X);
+      params.indata[0] = lp_build_emit_fetch(bld_base, inst, 3, TGSI_CHAN_X);
+   }
+   else if (img_op == LP_IMG_ATOMIC) {
+      params.indata[0] = lp_build_emit_fetch(bld_base, inst, 2, TGSI_CHAN_X);
+   }
+
+   if (bld->cs_iface->image) {
+      bld->cs_iface->image->emit_op(bld->cs_iface->image,
+                                    bld_base->base.gallivm, &params);
+   }
+   else {
+      for (chan = 0; chan < 4; chan++)
+         outdata[chan] = bld_base->base.zero;
+   }
+
+   if (img_op == LP_IMG_STORE)
+      return;
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      emit_data->output[chan] = img_op == LP_IMG_LOAD ?
+         outdata[chan] : outdata[0];
+   }
+}
+
+
+static void
+load_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const unsigned writemask = inst->Dst[0].Register.WriteMask;
+   LLVMValueRef result[TGSI_NUM_CHANNELS];
+   LLVMValueRef base_ptr, num_words, index, lane;
+   struct lp_build_loop_state loop_state;
+   struct lp_build_if_state lane_if;
+   unsigned chan;
+
+   if (inst->Src[0].Register.File == TGSI_FILE_IMAGE) {
+      img_op_emit(bld, emit_data, LP_IMG_LOAD, 0);
+      return;
+   }
+
+   get_mem_ptr(bld, &inst->Src[0], &base_ptr, &num_words);
+   index = fetch_word_index(bld_base, inst, 1);
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (writemask & (1 << chan))
+         result[chan] = lp_build_alloca(gallivm, bld_base->uint_bld.vec_type,
+                                        "load_result");
+   }
+
+   lane = begin_lane_loop(bld, &loop_state, &lane_if, mask_vec(bld_base));
+   {
+      LLVMValueRef lane_index = LLVMBuildExtractElement(builder, index,
+                                                        lane, "");
+
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         struct lp_build_if_state bounds_if;
+         LLVMValueRef word_index, value, vec;
+
+         if (!(writemask & (1 << chan)))
+            continue;
+
+         word_index = LLVMBuildAdd(builder, lane_index,
+                                   lp_build_const_int32(gallivm, chan), "");
+         begin_bounds_check(gallivm, &bounds_if, word_index, num_words);
+         value = LLVMBuildLoad(builder,
+                               LLVMBuildGEP(builder, base_ptr,
+                                            &word_index, 1, ""), "");
+         vec = LLVMBuildLoad(builder, result[chan], "");
+         vec = LLVMBuildInsertElement(builder, vec, value, lane, "");
+         LLVMBuildStore(builder, vec, result[chan]);
+         end_bounds_check(&bounds_if, num_words);
+      }
+   }
+   end_lane_loop(bld, &loop_state, &lane_if);
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (writemask & (1 << chan))
+         emit_data->output[chan] =
+            LLVMBuildBitCast(builder, LLVMBuildLoad(builder, result[chan], ""),
+                             bld_base->base.vec_type, "");
+   }
+}
+
+
+static void
+store_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const unsigned writemask = inst->Dst[0].Register.WriteMask;
+   struct tgsi_full_src_register resource;
+   LLVMValueRef values[TGSI_NUM_CHANNELS];
+   LLVMValueRef base_ptr, num_words, index, lane;
+   struct lp_build_loop_state loop_state;
+   struct lp_build_if_state lane_if;
+   unsigned chan;
+
+   if (inst->Dst[0].Register.File == TGSI_FILE_IMAGE) {
+      img_op_emit(bld, emit_data, LP_IMG_STORE, 0);
+      return;
+   }
+
+   /* the resource is the destination operand of stores */
+   memset(&resource, 0, sizeof resource);
+   resource.Register.File = inst->Dst[0].Register.File;
+   resource.Register.Index = inst->Dst[0].Register.Index;
+   resource.Register.Indirect = inst->Dst[0].Register.Indirect;
+
+   get_mem_ptr(bld, &resource, &base_ptr, &num_words);
+   index = fetch_word_index(bld_base, inst, 0);
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (writemask & (1 << chan)) {
+         values[chan] = lp_build_emit_fetch(bld_base, inst, 1, chan);
+         values[chan] = LLVMBuildBitCast(builder, values[chan],
+                                         bld_base->uint_bld.vec_type, "");
+      }
+   }
+
+   lane = begin_lane_loop(bld, &loop_state, &lane_if, mask_vec(bld_base));
+   {
+      LLVMValueRef lane_index = LLVMBuildExtractElement(builder, index,
+                                                        lane, "");
+
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         struct lp_build_if_state bounds_if;
+         LLVMValueRef word_index, value;
+
+         if (!(writemask & (1 << chan)))
+            continue;
+
+         word_index = LLVMBuildAdd(builder, lane_index,
+                                   lp_build_const_int32(gallivm, chan), "");
+         begin_bounds_check(gallivm, &bounds_if, word_index, num_words);
+         value = LLVMBuildExtractElement(builder, values[chan], lane, "");
+         LLVMBuildStore(builder, value,
+                        LLVMBuildGEP(builder, base_ptr, &word_index, 1, ""));
+         end_bounds_check(&bounds_if, num_words);
+      }
+   }
+   end_lane_loop(bld, &loop_state, &lane_if);
+}
+
+
+static void
+atomic_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const unsigned opcode = inst->Instruction.Opcode;
+   LLVMValueRef base_ptr, num_words, index, lane;
+   LLVMValueRef value, compare = NULL, result;
+   LLVMAtomicRMWBinOp op = LLVMAtomicRMWBinOpAdd;
+   struct lp_build_loop_state loop_state;
+   struct lp_build_if_state lane_if;
+   unsigned chan;
+
+   switch (opcode) {
+   case TGSI_OPCODE_ATOMUADD:
+      op = LLVMAtomicRMWBinOpAdd;
+      break;
+   case TGSI_OPCODE_ATOMXCHG:
+      op = LLVMAtomicRMWBinOpXchg;
+      break;
+   case TGSI_OPCODE_ATOMAND:
+      op = LLVMAtomicRMWBinOpAnd;
+      break;
+   case TGSI_OPCODE_ATOMOR:
+      op = LLVMAtomicRMWBinOpOr;
+      break;
+   case TGSI_OPCODE_ATOMXOR:
+      op = LLVMAtomicRMWBinOpXor;
+      break;
+   case TGSI_OPCODE_ATOMUMIN:
+      op = LLVMAtomicRMWBinOpUMin;
+      break;
+   case TGSI_OPCODE_ATOMUMAX:
+      op = LLVMAtomicRMWBinOpUMax;
+      break;
+   case TGSI_OPCODE_ATOMIMIN:
+      op = LLVMAtomicRMWBinOpMin;
+      break;
+   case TGSI_OPCODE_ATOMIMAX:
+      op = LLVMAtomicRMWBinOpMax;
+      break;
+   case TGSI_OPCODE_ATOMCAS:
+      break;
+   default:
+      assert(0);
+      return;
+   }
+
+   if (inst->Src[0].Register.File == TGSI_FILE_IMAGE) {
+      img_op_emit(bld, emit_data, opcode == TGSI_OPCODE_ATOMCAS ?
+                  LP_IMG_ATOMIC_CAS : LP_IMG_ATOMIC, op);
+      return;
+   }
+
+   get_mem_ptr(bld, &inst->Src[0], &base_ptr, &num_words);
+   index = fetch_word_index(bld_base, inst, 1);
+
+   if (opcode == TGSI_OPCODE_ATOMCAS) {
+      compare = lp_build_emit_fetch(bld_base, inst, 2, TGSI_CHAN_X);
+      compare = LLVMBuildBitCast(builder, compare,
+                                 bld_base->uint_bld.vec_type, "");
+      value = lp_build_emit_fetch(bld_base, inst, 3, TGSI_CHAN_X);
+   }
+   else {
+      value = lp_build_emit_fetch(bld_base, inst, 2, TGSI_CHAN_X);
+   }
+   value = LLVMBuildBitCast(builder, value, bld_base->uint_bld.vec_type, "");
+
+   result = lp_build_alloca(gallivm, bld_base->uint_bld.vec_type,
+                            "atomic_result");
+
+   lane = begin_lane_loop(bld, &loop_state, &lane_if, mask_vec(bld_base));
+   {
+      struct lp_build_if_state bounds_if;
+      LLVMValueRef word_index, ptr, lane_value, old, vec;
+
+      word_index = LLVMBuildExtractElement(builder, index, lane, "");
+      begin_bounds_check(gallivm, &bounds_if, word_index, num_words);
+
+      ptr = LLVMBuildGEP(builder, base_ptr, &word_index, 1, "");
+      lane_value = LLVMBuildExtractElement(builder, value, lane, "");
+
+#if HAVE_LLVM >= 0x0309
+      if (opcode == TGSI_OPCODE_ATOMCAS) {
+         LLVMValueRef lane_compare =
+            LLVMBuildExtractElement(builder, compare, lane, "");
+         old = LLVMBuildAtomicCmpXchg(builder, ptr, lane_compare, lane_value,
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      FALSE);
+         old = LLVMBuildExtractValue(builder, old, 0, "");
+      }
+      else
+#endif
+      {
+         old = LLVMBuildAtomicRMW(builder, op, ptr, lane_value,
+                                  LLVMAtomicOrderingSequentiallyConsistent,
+                                  FALSE);
+      }
+
+      vec = LLVMBuildLoad(builder, result, "");
+      vec = LLVMBuildInsertElement(builder, vec, old, lane, "");
+      LLVMBuildStore(builder, vec, result);
+
+      end_bounds_check(&bounds_if, num_words);
+   }
+   end_lane_loop(bld, &loop_state, &lane_if);
+
+   result = LLVMBuildBitCast(builder, LLVMBuildLoad(builder, result, ""),
+                             bld_base->base.vec_type, "");
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      emit_data->output[chan] = result;
+   }
+}
+
+
+static void
+resq_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_src_register *resource = &inst->Src[0];
+   LLVMValueRef size;
+
+   assert(!resource->Register.Indirect);
+
+   if (resource->Register.File == TGSI_FILE_IMAGE) {
+      struct lp_sampler_size_query_params params;
+      LLVMValueRef sizes[4];
+      unsigned chan;
+
+      memset(&params, 0, sizeof params);
+      params.int_type = bld_base->int_bld.type;
+      params.texture_unit = resource->Register.Index;
+      params.target = tgsi_to_pipe_tex_target(inst->Memory.Texture);
+      params.context_ptr = bld->context_ptr;
+      params.is_sviewinfo = TRUE;
+      params.lod_property = LP_SAMPLER_LOD_SCALAR;
+      params.sizes_out = sizes;
+
+      if (bld->cs_iface->image) {
+         bld->cs_iface->image->emit_size_query(bld->cs_iface->image,
+                                               bld_base->base.gallivm,
+                                               &params);
+      }
+      else {
+         for (chan = 0; chan < 4; chan++)
+            sizes[chan] = bld_base->int_bld.zero;
+      }
+
+      TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+         emit_data->output[chan] =
+            LLVMBuildBitCast(bld_base->base.gallivm->builder, sizes[chan],
+                             bld_base->base.vec_type, "");
+      }
+      return;
+   }
+
+   assert(resource->Register.File == TGSI_FILE_BUFFER);
+
+   size = lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                    bld->ssbo_sizes[resource->Register.Index]);
+   emit_data->output[TGSI_CHAN_X] =
+      LLVMBuildBitCast(bld_base->base.gallivm->builder, size,
+                       bld_base->base.vec_type, "");
+}
+
+
+static void
+barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+
+   if (bld->cs_iface->emit_barrier)
+      bld->cs_iface->emit_barrier(bld->cs_iface, &bld_base->base);
+}
+
+
+static void
+membar_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   /* All memory accesses are done in program order, and atomics are
+    * sequentially consistent, so there is nothing to do here.
+    */
+}
+
+
 static void
 emit_vertex(
    const struct lp_build_tgsi_action * action,
@@ -3429,7 +3566,7 @@ emit_vertex(
       mask = clamp_mask_to_max_output_vertices(bld, mask,
                                                total_emitted_vertices_vec);
       gather_outputs(bld);
-      bld->gs_iface->emit_vertex(bld->gs_iface, &bld->bld_base,
+      bld->gs_iface->emit_vertex(bld->gs_iface, &bld->bld_base.base,
                                  bld->outputs,
                                  total_emitted_vertices_vec);
       increment_vec_ptr_by_mask(bld_base, bld->emitted_vertices_vec_ptr,
@@ -3471,7 +3608,7 @@ end_primitive_masked(struct lp_build_tgsi_context * bld_base,
          executes only on the paths that have unflushed vertices */
       mask = LLVMBuildAnd(builder, mask, emitted_mask, "");
 
-      bld->gs_iface->end_primitive(bld->gs_iface, &bld->bld_base,
+      bld->gs_iface->end_primitive(bld->gs_iface, &bld->bld_base.base,
                                    emitted_vertices_vec,
                                    emitted_prims_vec);
 
@@ -3545,8 +3682,12 @@ brk_emit(
    struct lp_build_emit_data * emit_data)
 {
    struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   enum tgsi_opcode opcode =
+      bld_base->instructions[bld_base->pc + 1].Instruction.Opcode;
+   boolean break_always = (opcode == TGSI_OPCODE_ENDSWITCH ||
+                           opcode == TGSI_OPCODE_CASE);
 
-   lp_exec_break(&bld->exec_mask, bld_base);
+   lp_exec_break(&bld->exec_mask, &bld_base->pc, break_always);
 }
 
 static void
@@ -3816,7 +3957,7 @@ static void emit_epilogue(struct lp_build_tgsi_context * bld_base)
          LLVMBuildLoad(builder, bld->emitted_prims_vec_ptr, "");
 
       bld->gs_iface->gs_epilogue(bld->gs_iface,
-                                 &bld->bld_base,
+                                 &bld->bld_base.base,
                                  total_emitted_vertices_vec,
                                  emitted_prims_vec);
    } else {
@@ -3838,7 +3979,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   const struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface)
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface)
 {
    struct lp_build_tgsi_soa_context bld;
 
@@ -3994,6 +4136,27 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                                 max_output_vertices);
    }
 
+   if (cs_iface) {
+      bld.cs_iface = cs_iface;
+      bld.bld_base.op_actions[TGSI_OPCODE_LOAD].emit = load_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_STORE].emit = store_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_RESQ].emit = resq_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUADD].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXCHG].emit = atomic_emit;
+#if HAVE_LLVM >= 0x0309
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMCAS].emit = atomic_emit;
+#endif
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMAND].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = barrier_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_MEMBAR].emit = membar_emit;
+   }
+
    lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
 
    bld.system_values = *system_values;
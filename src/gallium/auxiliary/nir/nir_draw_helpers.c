@@ -0,0 +1,336 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * The fragment shader transforms of draw_pipe_aaline.c, draw_pipe_aapoint.c
+ * and util/u_pstipple.c, for NIR shaders.  They compute the same values as
+ * the TGSI code they mirror.
+ */
+
+#include "nir_draw_helpers.h"
+#include "compiler/nir/nir.h"
+#include "compiler/nir/nir_builder.h"
+#include "pipe/p_state.h"
+#include "tgsi/tgsi_from_mesa.h"
+#include "util/bitscan.h"
+#include "util/u_math.h"
+
+
+static unsigned
+input_num_slots(const nir_variable *var)
+{
+   if (var->data.compact)
+      return DIV_ROUND_UP(var->data.location_frac +
+                          glsl_get_length(var->type), 4);
+
+   return glsl_count_attribute_slots(var->type, false);
+}
+
+
+/**
+ * Add a vec4 input at the given varying slot, after all the other inputs.
+ */
+static nir_variable *
+add_input(nir_shader *shader, const char *name, int location)
+{
+   unsigned driver_location = 0;
+   nir_variable *var;
+
+   nir_foreach_variable(in, &shader->inputs)
+      driver_location = MAX2(driver_location,
+                             in->data.driver_location + input_num_slots(in));
+
+   var = nir_variable_create(shader, nir_var_shader_in, glsl_vec4_type(),
+                             name);
+   var->data.location = location;
+   var->data.driver_location = driver_location;
+   var->data.interpolation = INTERP_MODE_NOPERSPECTIVE;
+
+   shader->num_inputs = MAX2(shader->num_inputs, driver_location + 1);
+   shader->info.inputs_read |= BITFIELD64_BIT(location);
+
+   return var;
+}
+
+
+/**
+ * Add the input of the generic attribute the draw stage computes for each
+ * vertex.  Like in the TGSI transforms, its generic index is past those of
+ * all the other inputs.
+ */
+static nir_variable *
+add_generic_input(nir_shader *shader, const char *name,
+                  unsigned *generic_attrib)
+{
+   int location = VARYING_SLOT_VAR0 - 1;
+   nir_variable *var;
+
+   nir_foreach_variable(in, &shader->inputs)
+      location = MAX2(location,
+                      (int) (in->data.location + input_num_slots(in) - 1));
+
+   var = add_input(shader, name, location + 1);
+   *generic_attrib =
+      tgsi_get_generic_gl_varying_index(var->data.location, false);
+
+   return var;
+}
+
+
+/**
+ * Make the shader write color 0 to a temporary instead of the output, and
+ * return the output.  The caller writes the output at the end of the
+ * shader, from the temporary.
+ *
+ * Returns NULL if there is no float vec4 color 0 output to transform.
+ */
+static nir_variable *
+redirect_color_output(nir_shader *shader, nir_function_impl *impl,
+                      nir_variable **temp)
+{
+   nir_variable *color = NULL;
+
+   nir_foreach_variable(var, &shader->outputs) {
+      if ((var->data.location == FRAG_RESULT_COLOR ||
+           var->data.location == FRAG_RESULT_DATA0) && var->data.index == 0)
+         color = var;
+   }
+
+   if (!color || color->type != glsl_vec4_type())
+      return NULL;
+
+   *temp = nir_local_variable_create(impl, glsl_vec4_type(), "color_temp");
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         nir_deref_instr *deref;
+
+         if (instr->type != nir_instr_type_deref)
+            continue;
+
+         deref = nir_instr_as_deref(instr);
+         if (deref->deref_type == nir_deref_type_var && deref->var == color) {
+            deref->var = *temp;
+            deref->mode = nir_var_function_temp;
+         }
+      }
+   }
+
+   return color;
+}
+
+
+/**
+ * Write the color output from the temporary, with the alpha multiplied by
+ * the coverage.
+ */
+static void
+emit_color_output(nir_builder *b, nir_function_impl *impl,
+                  nir_variable *color, nir_variable *temp,
+                  nir_ssa_def *coverage)
+{
+   nir_ssa_def *value;
+
+   b->cursor = nir_after_block_before_jump(nir_impl_last_block(impl));
+
+   value = nir_load_var(b, temp);
+   value = nir_vec4(b,
+                    nir_channel(b, value, 0),
+                    nir_channel(b, value, 1),
+                    nir_channel(b, value, 2),
+                    nir_fmul(b, nir_channel(b, value, 3), coverage));
+   nir_store_var(b, color, value, 0xf);
+}
+
+
+static void
+emit_discard_if(nir_builder *b, nir_ssa_def *cond)
+{
+   nir_intrinsic_instr *discard =
+      nir_intrinsic_instr_create(b->shader, nir_intrinsic_discard_if);
+
+   discard->src[0] = nir_src_for_ssa(cond);
+   nir_builder_instr_insert(b, &discard->instr);
+   b->shader->info.fs.uses_discard = true;
+}
+
+
+/**
+ * Multiply the color alpha by the line coverage, from the distances to the
+ * line center the AA line stage puts in a new generic attribute.
+ */
+bool
+nir_lower_aaline_fs(struct nir_shader *shader, unsigned *generic_attrib)
+{
+   nir_function_impl *impl = nir_shader_get_entrypoint(shader);
+   nir_variable *color, *temp, *dist;
+   nir_ssa_def *d, *width, *length;
+   nir_builder b;
+
+   color = redirect_color_output(shader, impl, &temp);
+   if (!color)
+      return false;
+
+   dist = add_generic_input(shader, "aaline", generic_attrib);
+
+   nir_builder_init(&b, impl);
+   b.cursor = nir_after_block_before_jump(nir_impl_last_block(impl));
+
+   /* saturate(linewidth - fabs(interpx)) * saturate(linelength - fabs(interpz)) */
+   d = nir_load_var(&b, dist);
+   width = nir_fsat(&b, nir_fsub(&b, nir_channel(&b, d, 1),
+                                 nir_fabs(&b, nir_channel(&b, d, 0))));
+   length = nir_fsat(&b, nir_fsub(&b, nir_channel(&b, d, 3),
+                                  nir_fabs(&b, nir_channel(&b, d, 2))));
+
+   emit_color_output(&b, impl, color, temp, nir_fmul(&b, width, length));
+
+   nir_metadata_preserve(impl, nir_metadata_block_index |
+                               nir_metadata_dominance);
+   return true;
+}
+
+
+/**
+ * Kill the fragments outside the point, and multiply the color alpha by the
+ * coverage of the others.  The AA point stage puts the position in the
+ * point and its radius in a new generic attribute.
+ */
+bool
+nir_lower_aapoint_fs(struct nir_shader *shader, unsigned *generic_attrib)
+{
+   nir_function_impl *impl = nir_shader_get_entrypoint(shader);
+   nir_variable *color, *temp, *texcoord;
+   nir_ssa_def *tex, *dist, *k, *one, *coverage;
+   nir_builder b;
+
+   color = redirect_color_output(shader, impl, &temp);
+   if (!color)
+      return false;
+
+   texcoord = add_generic_input(shader, "aapoint", generic_attrib);
+
+   nir_builder_init(&b, impl);
+   b.cursor = nir_before_cf_list(&impl->body);
+
+   /* The coverage is computed first, so that it dominates the end. */
+   tex = nir_load_var(&b, texcoord);
+   k = nir_channel(&b, tex, 2);
+   one = nir_channel(&b, tex, 3);
+   dist = nir_fadd(&b,
+                   nir_fmul(&b, nir_channel(&b, tex, 0),
+                            nir_channel(&b, tex, 0)),
+                   nir_fmul(&b, nir_channel(&b, tex, 1),
+                            nir_channel(&b, tex, 1)));
+
+   /* kill if d > 1 */
+   emit_discard_if(&b, nir_flt(&b, one, dist));
+
+   /* coverage = d <= k ? 1 : (1 - d) / (1 - k) */
+   coverage = nir_fmul(&b, nir_fsub(&b, one, dist),
+                       nir_frcp(&b, nir_fsub(&b, one, k)));
+   coverage = nir_bcsel(&b, nir_fge(&b, k, dist), one, coverage);
+
+   emit_color_output(&b, impl, color, temp, coverage);
+
+   nir_metadata_preserve(impl, nir_metadata_block_index |
+                               nir_metadata_dominance);
+   return true;
+}
+
+
+/**
+ * Kill the fragments whose bit is off in the stipple pattern, which is
+ * sampled from a 32x32 texture with the window position.  The texture takes
+ * the first sampler unit the shader doesn't use.
+ */
+void
+nir_lower_pstipple_fs(struct nir_shader *shader, unsigned *sampler_unit,
+                      bool fs_pos_is_sysval)
+{
+   nir_function_impl *impl = nir_shader_get_entrypoint(shader);
+   unsigned samplers_used = 0;
+   nir_ssa_def *pos, *texcoord;
+   nir_tex_instr *tex;
+   nir_builder b;
+   int unit;
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type == nir_instr_type_tex)
+            samplers_used |= 1u << nir_instr_as_tex(instr)->sampler_index;
+      }
+   }
+
+   unit = ffs(~samplers_used) - 1;
+   if (unit < 0 || unit >= PIPE_MAX_SAMPLERS)
+      unit = PIPE_MAX_SAMPLERS - 1;
+   *sampler_unit = unit;
+
+   nir_builder_init(&b, impl);
+   b.cursor = nir_before_cf_list(&impl->body);
+
+   if (fs_pos_is_sysval) {
+      pos = nir_load_frag_coord(&b);
+   }
+   else {
+      nir_variable *pos_input = NULL;
+
+      nir_foreach_variable(in, &shader->inputs) {
+         if (in->data.location == VARYING_SLOT_POS)
+            pos_input = in;
+      }
+      if (!pos_input)
+         pos_input = add_input(shader, "gl_FragCoord", VARYING_SLOT_POS);
+
+      pos = nir_load_var(&b, pos_input);
+   }
+
+   texcoord = nir_fmul(&b, nir_channels(&b, pos, 0x3),
+                       nir_imm_vec2(&b, 1.0 / 32.0, 1.0 / 32.0));
+
+   tex = nir_tex_instr_create(shader, 1);
+   tex->op = nir_texop_tex;
+   tex->sampler_dim = GLSL_SAMPLER_DIM_2D;
+   tex->coord_components = 2;
+   tex->dest_type = nir_type_float;
+   tex->texture_index = unit;
+   tex->sampler_index = unit;
+   tex->src[0].src_type = nir_tex_src_coord;
+   tex->src[0].src = nir_src_for_ssa(texcoord);
+   nir_ssa_dest_init(&tex->instr, &tex->dest, 4, 32, NULL);
+   nir_builder_instr_insert(&b, &tex->instr);
+
+   shader->info.textures_used |= 1u << unit;
+
+   /* kill if the texel alpha is set, meaning the stipple bit is off */
+   emit_discard_if(&b, nir_flt(&b, nir_imm_float(&b, 0.0),
+                               nir_channel(&b, &tex->dest.ssa, 3)));
+
+   nir_metadata_preserve(impl, nir_metadata_block_index |
+                               nir_metadata_dominance);
+}
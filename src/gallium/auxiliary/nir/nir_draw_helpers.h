@@ -0,0 +1,51 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#ifndef NIR_DRAW_HELPERS_H
+#define NIR_DRAW_HELPERS_H
+
+#include <stdbool.h>
+
+struct nir_shader;
+
+/*
+ * NIR versions of the fragment shader transforms of the draw module's AA
+ * line, AA point and polygon stipple stages.  They work on the shaders the
+ * state tracker hands to the driver, before their I/O is lowered.
+ */
+
+bool
+nir_lower_aaline_fs(struct nir_shader *shader, unsigned *generic_attrib);
+
+bool
+nir_lower_aapoint_fs(struct nir_shader *shader, unsigned *generic_attrib);
+
+void
+nir_lower_pstipple_fs(struct nir_shader *shader, unsigned *sampler_unit,
+                      bool fs_pos_is_sysval);
+
+#endif /* NIR_DRAW_HELPERS_H */
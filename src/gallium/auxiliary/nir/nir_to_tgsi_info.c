@@ -0,0 +1,445 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Build a tgsi_shader_info from a NIR shader, the equivalent of
+ * tgsi_scan_shader() for NIR.
+ */
+
+#include "nir_to_tgsi_info.h"
+
+#include "compiler/nir/nir.h"
+#include "tgsi/tgsi_from_mesa.h"
+#include "tgsi/tgsi_scan.h"
+#include "util/u_math.h"
+
+
+static unsigned
+interp_mode(const nir_variable *var, unsigned semantic_name)
+{
+   switch (semantic_name) {
+   case TGSI_SEMANTIC_POSITION:
+      return TGSI_INTERPOLATE_LINEAR;
+   case TGSI_SEMANTIC_FACE:
+   case TGSI_SEMANTIC_PRIMID:
+      return TGSI_INTERPOLATE_CONSTANT;
+   default:
+      break;
+   }
+
+   switch (var->data.interpolation) {
+   case INTERP_MODE_NONE:
+      if (semantic_name == TGSI_SEMANTIC_COLOR)
+         return TGSI_INTERPOLATE_COLOR;
+      return TGSI_INTERPOLATE_PERSPECTIVE;
+   case INTERP_MODE_FLAT:
+      return TGSI_INTERPOLATE_CONSTANT;
+   case INTERP_MODE_NOPERSPECTIVE:
+      return TGSI_INTERPOLATE_LINEAR;
+   default:
+      return TGSI_INTERPOLATE_PERSPECTIVE;
+   }
+}
+
+
+static unsigned
+interp_loc(const nir_variable *var)
+{
+   if (var->data.sample)
+      return TGSI_INTERPOLATE_LOC_SAMPLE;
+   else if (var->data.centroid)
+      return TGSI_INTERPOLATE_LOC_CENTROID;
+   else
+      return TGSI_INTERPOLATE_LOC_CENTER;
+}
+
+
+/**
+ * Number of slots of a variable, and the components it uses in slot i.
+ */
+static unsigned
+var_num_slots(const nir_variable *var, const struct glsl_type *type)
+{
+   if (var->data.compact)
+      return DIV_ROUND_UP(var->data.location_frac + glsl_get_length(type), 4);
+   return glsl_count_attribute_slots(type, false);
+}
+
+
+static unsigned
+var_usage_mask(const nir_variable *var, const struct glsl_type *type,
+               unsigned slot)
+{
+   const struct glsl_type *elem = glsl_without_array(type);
+   unsigned mask;
+
+   if (var->data.compact) {
+      const unsigned first = var->data.location_frac + slot * 4;
+      const unsigned end = var->data.location_frac + glsl_get_length(type);
+      return BITFIELD_MASK(MIN2(end - first, 4)) & 0xf;
+   }
+
+   if (!glsl_type_is_vector_or_scalar(elem))
+      return TGSI_WRITEMASK_XYZW;
+
+   mask = BITFIELD_MASK(glsl_get_vector_elements(elem) *
+                        (glsl_type_is_64bit(elem) ? 2 : 1));
+   mask <<= var->data.location_frac;
+   /* 64-bit vec3 and vec4 spill into a second slot */
+   return (slot & 1 ? mask >> 4 : mask) & 0xf;
+}
+
+
+static void
+scan_inputs(const struct nir_shader *nir, struct tgsi_shader_info *info,
+            bool need_texcoord)
+{
+   nir_foreach_variable(var, &nir->inputs) {
+      const struct glsl_type *type = var->type;
+      unsigned num_slots, i;
+
+      /* The vertices of the geometry shader inputs are not slots. */
+      if (nir->info.stage == MESA_SHADER_GEOMETRY && glsl_type_is_array(type))
+         type = glsl_get_array_element(type);
+
+      num_slots = var_num_slots(var, type);
+      for (i = 0; i < num_slots; i++) {
+         const unsigned index = var->data.driver_location + i;
+         unsigned semantic_name, semantic_index;
+
+         if (index >= PIPE_MAX_SHADER_INPUTS)
+            break;
+
+         if (nir->info.stage == MESA_SHADER_VERTEX) {
+            semantic_name = TGSI_SEMANTIC_GENERIC;
+            semantic_index = index;
+         }
+         else {
+            tgsi_get_gl_varying_semantic(var->data.location + i,
+                                         need_texcoord,
+                                         &semantic_name, &semantic_index);
+         }
+
+         info->input_semantic_name[index] = semantic_name;
+         info->input_semantic_index[index] = semantic_index;
+         info->input_usage_mask[index] |= var_usage_mask(var, type, i);
+
+         if (nir->info.stage == MESA_SHADER_FRAGMENT) {
+            info->input_interpolate[index] = interp_mode(var, semantic_name);
+            info->input_interpolate_loc[index] = interp_loc(var);
+
+            if (semantic_name == TGSI_SEMANTIC_POSITION)
+               info->reads_position = TRUE;
+            else if (semantic_name == TGSI_SEMANTIC_FACE)
+               info->uses_frontface = TRUE;
+            else if (semantic_name == TGSI_SEMANTIC_PRIMID)
+               info->uses_primid = TRUE;
+         }
+
+         info->num_inputs = MAX2(info->num_inputs, index + 1);
+      }
+   }
+
+   info->file_max[TGSI_FILE_INPUT] = (int) info->num_inputs - 1;
+}
+
+
+static void
+scan_outputs(const struct nir_shader *nir, struct tgsi_shader_info *info,
+             bool need_texcoord)
+{
+   nir_foreach_variable(var, &nir->outputs) {
+      const unsigned num_slots = var_num_slots(var, var->type);
+      unsigned i;
+
+      for (i = 0; i < num_slots; i++) {
+         const unsigned index = var->data.driver_location + i;
+         unsigned semantic_name, semantic_index;
+
+         if (index >= PIPE_MAX_SHADER_OUTPUTS)
+            break;
+
+         if (nir->info.stage == MESA_SHADER_FRAGMENT) {
+            tgsi_get_gl_frag_result_semantic(var->data.location + i,
+                                             &semantic_name, &semantic_index);
+
+            if (var->data.location == FRAG_RESULT_COLOR)
+               info->properties[TGSI_PROPERTY_FS_COLOR0_WRITES_ALL_CBUFS] = 1;
+         }
+         else {
+            tgsi_get_gl_varying_semantic(var->data.location + i,
+                                         need_texcoord,
+                                         &semantic_name, &semantic_index);
+         }
+
+         info->output_semantic_name[index] = semantic_name;
+         info->output_semantic_index[index] = semantic_index;
+         info->output_usagemask[index] |= var_usage_mask(var, var->type, i);
+         info->num_outputs = MAX2(info->num_outputs, index + 1);
+
+         switch (semantic_name) {
+         case TGSI_SEMANTIC_POSITION:
+            if (nir->info.stage == MESA_SHADER_FRAGMENT)
+               info->writes_z = TRUE;
+            else
+               info->writes_position = TRUE;
+            break;
+         case TGSI_SEMANTIC_STENCIL:
+            info->writes_stencil = TRUE;
+            break;
+         case TGSI_SEMANTIC_SAMPLEMASK:
+            info->writes_samplemask = TRUE;
+            break;
+         case TGSI_SEMANTIC_PSIZE:
+            info->writes_psize = TRUE;
+            break;
+         case TGSI_SEMANTIC_CLIPVERTEX:
+            info->writes_clipvertex = TRUE;
+            break;
+         case TGSI_SEMANTIC_EDGEFLAG:
+            info->writes_edgeflag = TRUE;
+            break;
+         case TGSI_SEMANTIC_LAYER:
+            info->writes_layer = TRUE;
+            break;
+         case TGSI_SEMANTIC_VIEWPORT_INDEX:
+            info->writes_viewport_index = TRUE;
+            break;
+         case TGSI_SEMANTIC_PRIMID:
+            info->writes_primid = TRUE;
+            break;
+         case TGSI_SEMANTIC_COLOR:
+            if (nir->info.stage == MESA_SHADER_FRAGMENT)
+               info->colors_written |= 1 << semantic_index;
+            break;
+         default:
+            break;
+         }
+      }
+
+      if (var->data.location == VARYING_SLOT_CLIP_DIST0 && var->data.compact) {
+         info->num_written_clipdistance = glsl_get_length(var->type);
+         info->clipdist_writemask =
+            BITFIELD_MASK(info->num_written_clipdistance);
+      }
+      else if (var->data.location == VARYING_SLOT_CULL_DIST0 &&
+               var->data.compact) {
+         info->num_written_culldistance = glsl_get_length(var->type);
+         info->culldist_writemask =
+            BITFIELD_MASK(info->num_written_culldistance);
+      }
+   }
+
+   info->file_max[TGSI_FILE_OUTPUT] = (int) info->num_outputs - 1;
+}
+
+
+static void
+scan_instr(const struct nir_shader *nir, struct tgsi_shader_info *info,
+           const nir_instr *instr)
+{
+   info->num_instructions++;
+
+   switch (instr->type) {
+   case nir_instr_type_intrinsic: {
+      const nir_intrinsic_instr *intr = nir_instr_as_intrinsic(instr);
+
+      switch (intr->intrinsic) {
+      case nir_intrinsic_load_input:
+         if (!nir_src_is_const(intr->src[0]))
+            info->indirect_files |= 1 << TGSI_FILE_INPUT;
+         break;
+      case nir_intrinsic_load_per_vertex_input:
+         if (!nir_src_is_const(intr->src[1]))
+            info->indirect_files |= 1 << TGSI_FILE_INPUT;
+         break;
+      case nir_intrinsic_load_uniform:
+         if (!nir_src_is_const(intr->src[0]))
+            info->indirect_files |= 1 << TGSI_FILE_CONSTANT;
+         break;
+      case nir_intrinsic_store_ssbo:
+      case nir_intrinsic_ssbo_atomic_add:
+      case nir_intrinsic_ssbo_atomic_imin:
+      case nir_intrinsic_ssbo_atomic_umin:
+      case nir_intrinsic_ssbo_atomic_imax:
+      case nir_intrinsic_ssbo_atomic_umax:
+      case nir_intrinsic_ssbo_atomic_and:
+      case nir_intrinsic_ssbo_atomic_or:
+      case nir_intrinsic_ssbo_atomic_xor:
+      case nir_intrinsic_ssbo_atomic_exchange:
+      case nir_intrinsic_ssbo_atomic_comp_swap:
+         info->writes_memory = TRUE;
+         info->num_memory_instructions++;
+         break;
+      case nir_intrinsic_load_ssbo:
+         info->num_memory_instructions++;
+         break;
+      case nir_intrinsic_discard:
+      case nir_intrinsic_discard_if:
+         info->uses_kill = TRUE;
+         break;
+      case nir_intrinsic_barrier:
+         info->opcode_count[TGSI_OPCODE_BARRIER]++;
+         break;
+      default:
+         break;
+      }
+      break;
+   }
+   case nir_instr_type_tex: {
+      const nir_tex_instr *tex = nir_instr_as_tex(instr);
+
+      info->samplers_declared |= 1u << tex->sampler_index;
+      info->file_max[TGSI_FILE_SAMPLER] =
+         MAX2(info->file_max[TGSI_FILE_SAMPLER], (int) tex->sampler_index);
+      info->file_max[TGSI_FILE_SAMPLER_VIEW] =
+         MAX2(info->file_max[TGSI_FILE_SAMPLER_VIEW],
+              (int) tex->texture_index);
+      info->num_memory_instructions++;
+      break;
+   }
+   case nir_instr_type_alu: {
+      const nir_alu_instr *alu = nir_instr_as_alu(instr);
+
+      switch (alu->op) {
+      case nir_op_fddx:
+      case nir_op_fddy:
+      case nir_op_fddx_fine:
+      case nir_op_fddy_fine:
+      case nir_op_fddx_coarse:
+      case nir_op_fddy_coarse:
+         info->uses_derivatives = TRUE;
+         break;
+      default:
+         break;
+      }
+      if (nir_dest_bit_size(alu->dest.dest) == 64)
+         info->uses_doubles = TRUE;
+      break;
+   }
+   default:
+      break;
+   }
+}
+
+
+void
+nir_tgsi_scan_shader(const struct nir_shader *nir,
+                     struct tgsi_shader_info *info,
+                     bool need_texcoord)
+{
+   const uint64_t sysvals = nir->info.system_values_read;
+   unsigned i;
+
+   memset(info, 0, sizeof *info);
+
+   for (i = 0; i < TGSI_FILE_COUNT; i++)
+      info->file_max[i] = -1;
+
+   info->processor = pipe_shader_type_from_mesa(nir->info.stage);
+
+   scan_inputs(nir, info, need_texcoord);
+   scan_outputs(nir, info, need_texcoord);
+
+   info->uses_instanceid = !!(sysvals & BITFIELD64_BIT(SYSTEM_VALUE_INSTANCE_ID));
+   info->uses_vertexid = !!(sysvals & BITFIELD64_BIT(SYSTEM_VALUE_VERTEX_ID));
+   info->uses_vertexid_nobase =
+      !!(sysvals & BITFIELD64_BIT(SYSTEM_VALUE_VERTEX_ID_ZERO_BASE));
+   info->uses_basevertex = !!(sysvals & BITFIELD64_BIT(SYSTEM_VALUE_BASE_VERTEX));
+   info->uses_primid |= !!(sysvals & BITFIELD64_BIT(SYSTEM_VALUE_PRIMITIVE_ID));
+   info->uses_invocationid =
+      !!(sysvals & BITFIELD64_BIT(SYSTEM_VALUE_INVOCATION_ID));
+   info->uses_frontface |= !!(sysvals & BITFIELD64_BIT(SYSTEM_VALUE_FRONT_FACE));
+   for (i = 0; i < 3; i++) {
+      info->uses_thread_id[i] =
+         !!(sysvals & BITFIELD64_BIT(SYSTEM_VALUE_LOCAL_INVOCATION_ID));
+      info->uses_block_id[i] =
+         !!(sysvals & BITFIELD64_BIT(SYSTEM_VALUE_WORK_GROUP_ID));
+   }
+   info->uses_block_size =
+      !!(sysvals & BITFIELD64_BIT(SYSTEM_VALUE_LOCAL_GROUP_SIZE));
+   info->uses_grid_size =
+      !!(sysvals & BITFIELD64_BIT(SYSTEM_VALUE_NUM_WORK_GROUPS));
+
+   info->const_buffers_declared = BITFIELD_MASK(nir->info.num_ubos + 1);
+   info->file_max[TGSI_FILE_CONSTANT] = nir->num_uniforms - 1;
+   info->shader_buffers_declared = BITFIELD_MASK(nir->info.num_ssbos);
+   if (nir->info.num_ssbos)
+      info->file_max[TGSI_FILE_BUFFER] = nir->info.num_ssbos - 1;
+   info->images_declared = BITFIELD_MASK(nir->info.num_images);
+   if (nir->info.num_images)
+      info->file_max[TGSI_FILE_IMAGE] = nir->info.num_images - 1;
+
+   switch (nir->info.stage) {
+   case MESA_SHADER_VERTEX:
+      info->properties[TGSI_PROPERTY_VS_WINDOW_SPACE_POSITION] =
+         nir->info.vs.window_space_position;
+      break;
+   case MESA_SHADER_GEOMETRY:
+      info->properties[TGSI_PROPERTY_GS_INPUT_PRIM] =
+         nir->info.gs.input_primitive;
+      info->properties[TGSI_PROPERTY_GS_OUTPUT_PRIM] =
+         nir->info.gs.output_primitive;
+      info->properties[TGSI_PROPERTY_GS_MAX_OUTPUT_VERTICES] =
+         nir->info.gs.vertices_out;
+      info->properties[TGSI_PROPERTY_GS_INVOCATIONS] =
+         nir->info.gs.invocations;
+      break;
+   case MESA_SHADER_FRAGMENT:
+      info->uses_kill |= nir->info.fs.uses_discard;
+      info->properties[TGSI_PROPERTY_FS_COORD_ORIGIN] =
+         nir->info.fs.origin_upper_left ? TGSI_FS_COORD_ORIGIN_UPPER_LEFT :
+                                          TGSI_FS_COORD_ORIGIN_LOWER_LEFT;
+      info->properties[TGSI_PROPERTY_FS_COORD_PIXEL_CENTER] =
+         nir->info.fs.pixel_center_integer ?
+         TGSI_FS_COORD_PIXEL_CENTER_INTEGER :
+         TGSI_FS_COORD_PIXEL_CENTER_HALF_INTEGER;
+      info->properties[TGSI_PROPERTY_FS_EARLY_DEPTH_STENCIL] =
+         nir->info.fs.early_fragment_tests;
+      break;
+   case MESA_SHADER_COMPUTE:
+      info->properties[TGSI_PROPERTY_CS_FIXED_BLOCK_WIDTH] =
+         nir->info.cs.local_size[0];
+      info->properties[TGSI_PROPERTY_CS_FIXED_BLOCK_HEIGHT] =
+         nir->info.cs.local_size[1];
+      info->properties[TGSI_PROPERTY_CS_FIXED_BLOCK_DEPTH] =
+         nir->info.cs.local_size[2];
+      break;
+   default:
+      break;
+   }
+
+   nir_foreach_function(func, nir) {
+      if (!func->impl)
+         continue;
+      nir_foreach_block(block, func->impl) {
+         nir_foreach_instr(instr, block)
+            scan_instr(nir, info, instr);
+      }
+   }
+}
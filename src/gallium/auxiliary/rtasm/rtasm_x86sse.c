@@ -1508,6 +1508,118 @@ void sse2_rcpss( struct x86_function *p,
    emit_modrm( p, dst, src );
 }
 
+/***********************************************************************
+ * SSE4.1 instructions
+ */
+
+/* Zero or sign extend the low bytes or words of src to dwords.  The
+ * memory forms only read the 4 or 8 bytes which are extended.
+ */
+void sse4_1_pmovzxbd( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   assert(dst.mod == mod_REG);
+   emit_1ub(p, 0x66);
+   emit_3ub(p, X86_TWOB, 0x38, 0x31);
+   emit_modrm( p, dst, src );
+}
+
+void sse4_1_pmovzxwd( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   assert(dst.mod == mod_REG);
+   emit_1ub(p, 0x66);
+   emit_3ub(p, X86_TWOB, 0x38, 0x33);
+   emit_modrm( p, dst, src );
+}
+
+void sse4_1_pmovsxbd( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   assert(dst.mod == mod_REG);
+   emit_1ub(p, 0x66);
+   emit_3ub(p, X86_TWOB, 0x38, 0x21);
+   emit_modrm( p, dst, src );
+}
+
+void sse4_1_pmovsxwd( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   assert(dst.mod == mod_REG);
+   emit_1ub(p, 0x66);
+   emit_3ub(p, X86_TWOB, 0x38, 0x23);
+   emit_modrm( p, dst, src );
+}
+
+/***********************************************************************
+ * AVX and F16C instructions
+ */
+
+#define VEX_MAP_0F    1
+#define VEX_MAP_0F38  2
+
+#define VEX_PP_NONE   0
+#define VEX_PP_66     1
+#define VEX_PP_F3     2
+
+/* Emit a VEX prefix without a second source operand.  As emit_modrm()
+ * only deals with the first eight registers the inverted R, X and B bits
+ * are always set, so the two byte form can be used for the 0F map.
+ */
+static void emit_vex( struct x86_function *p,
+                      unsigned map,
+                      unsigned pp,
+                      unsigned l )
+{
+   if (map == VEX_MAP_0F) {
+      emit_2ub(p, 0xc5, 0xf8 | (l << 2) | pp);
+   }
+   else {
+      emit_3ub(p, 0xc4, 0xe0 | map, 0x78 | (l << 2) | pp);
+   }
+}
+
+/* 32 byte unaligned move, dst or src being the ymm register with the
+ * index of the given xmm register.
+ */
+void avx_vmovdqu256( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   emit_vex(p, VEX_MAP_0F, VEX_PP_F3, 1);
+   emit_op_modrm(p, 0x6f, 0x7f, dst, src);
+   p->need_vzeroupper = 1;
+}
+
+/* Convert the four doubles at the 32 bytes of memory src to floats.
+ */
+void avx_vcvtpd2ps256( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   assert(dst.mod == mod_REG && src.mod != mod_REG);
+   emit_vex(p, VEX_MAP_0F, VEX_PP_66, 1);
+   emit_1ub(p, 0x5a);
+   emit_modrm( p, dst, src );
+}
+
+void avx_vzeroupper( struct x86_function *p )
+{
+   DUMP();
+   emit_vex(p, VEX_MAP_0F, VEX_PP_NONE, 0);
+   emit_1ub(p, 0x77);
+   p->need_vzeroupper = 0;
+}
+
+/* Convert the four half floats in the low 8 bytes of src to floats.
+ */
+void f16c_vcvtph2ps( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   assert(dst.mod == mod_REG);
+   emit_vex(p, VEX_MAP_0F38, VEX_PP_66, 0);
+   emit_1ub(p, 0x13);
+   emit_modrm( p, dst, src );
+}
+
 /***********************************************************************
  * x87 instructions
  */
@@ -2164,6 +2276,10 @@ static void x86_init_func_common( struct x86_function *p )
       p->caps |= X86_SSE3;
    if(util_cpu_caps.has_sse4_1)
       p->caps |= X86_SSE4_1;
+   if(util_cpu_caps.has_avx)
+      p->caps |= X86_AVX;
+   if(util_cpu_caps.has_f16c)
+      p->caps |= X86_F16C;
    p->csr = p->store;
    DUMP_START();
 }
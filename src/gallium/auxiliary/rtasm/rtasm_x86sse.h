@@ -47,6 +47,8 @@ struct x86_reg {
 #define X86_SSE2 8
 #define X86_SSE3 0x10
 #define X86_SSE4_1 0x20
+#define X86_AVX 0x40
+#define X86_F16C 0x80
 
 struct x86_function {
    unsigned caps;
@@ -56,6 +58,7 @@ struct x86_function {
 
    unsigned stack_offset:16;
    unsigned need_emms:8;
+   unsigned need_vzeroupper:8;
    int x87_stack:8;
 
    unsigned char error_overflow[4];
@@ -270,6 +273,17 @@ void sse2_pshuflw( struct x86_function *p, struct x86_reg dst, struct x86_reg sr
 void sse2_pshufhw( struct x86_function *p, struct x86_reg dst, struct x86_reg src, uint8_t imm );
 void sse2_pshufd( struct x86_function *p, struct x86_reg dst, struct x86_reg src, uint8_t imm );
 
+void sse4_1_pmovzxbd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void sse4_1_pmovzxwd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void sse4_1_pmovsxbd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void sse4_1_pmovsxwd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+
+void avx_vmovdqu256( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void avx_vcvtpd2ps256( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void avx_vzeroupper( struct x86_function *p );
+
+void f16c_vcvtph2ps( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+
 void sse_prefetchnta( struct x86_function *p, struct x86_reg ptr);
 void sse_prefetch0( struct x86_function *p, struct x86_reg ptr);
 void sse_prefetch1( struct x86_function *p, struct x86_reg ptr);
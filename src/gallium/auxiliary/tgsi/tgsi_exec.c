@@ -75,10 +75,10 @@
 #define TILE_BOTTOM_RIGHT 3
 
 union tgsi_double_channel {
-   double d[TGSI_QUAD_SIZE];
-   unsigned u[TGSI_QUAD_SIZE][2];
-   uint64_t u64[TGSI_QUAD_SIZE];
-   int64_t i64[TGSI_QUAD_SIZE];
+   double d[TGSI_EXEC_WIDTH];
+   unsigned u[TGSI_EXEC_WIDTH][2];
+   uint64_t u64[TGSI_EXEC_WIDTH];
+   int64_t i64[TGSI_EXEC_WIDTH];
 };
 
 struct tgsi_double_vector {
@@ -90,40 +90,40 @@ static void
 micro_abs(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = fabsf(src->f[0]);
-   dst->f[1] = fabsf(src->f[1]);
-   dst->f[2] = fabsf(src->f[2]);
-   dst->f[3] = fabsf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = fabsf(src->f[i]);
 }
 
 static void
 micro_arl(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->i[0] = (int)floorf(src->f[0]);
-   dst->i[1] = (int)floorf(src->f[1]);
-   dst->i[2] = (int)floorf(src->f[2]);
-   dst->i[3] = (int)floorf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = (int)floorf(src->f[i]);
 }
 
 static void
 micro_arr(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->i[0] = (int)floorf(src->f[0] + 0.5f);
-   dst->i[1] = (int)floorf(src->f[1] + 0.5f);
-   dst->i[2] = (int)floorf(src->f[2] + 0.5f);
-   dst->i[3] = (int)floorf(src->f[3] + 0.5f);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = (int)floorf(src->f[i] + 0.5f);
 }
 
 static void
 micro_ceil(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->f[0] = ceilf(src->f[0]);
-   dst->f[1] = ceilf(src->f[1]);
-   dst->f[2] = ceilf(src->f[2]);
-   dst->f[3] = ceilf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = ceilf(src->f[i]);
 }
 
 static void
@@ -132,229 +132,233 @@ micro_cmp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
-   dst->f[0] = src0->f[0] < 0.0f ? src1->f[0] : src2->f[0];
-   dst->f[1] = src0->f[1] < 0.0f ? src1->f[1] : src2->f[1];
-   dst->f[2] = src0->f[2] < 0.0f ? src1->f[2] : src2->f[2];
-   dst->f[3] = src0->f[3] < 0.0f ? src1->f[3] : src2->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] < 0.0f ? src1->f[i] : src2->f[i];
 }
 
 static void
 micro_cos(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = cosf(src->f[0]);
-   dst->f[1] = cosf(src->f[1]);
-   dst->f[2] = cosf(src->f[2]);
-   dst->f[3] = cosf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = cosf(src->f[i]);
 }
 
 static void
 micro_d2f(union tgsi_exec_channel *dst,
           const union tgsi_double_channel *src)
 {
-   dst->f[0] = (float)src->d[0];
-   dst->f[1] = (float)src->d[1];
-   dst->f[2] = (float)src->d[2];
-   dst->f[3] = (float)src->d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = (float)src->d[i];
 }
 
 static void
 micro_d2i(union tgsi_exec_channel *dst,
           const union tgsi_double_channel *src)
 {
-   dst->i[0] = (int)src->d[0];
-   dst->i[1] = (int)src->d[1];
-   dst->i[2] = (int)src->d[2];
-   dst->i[3] = (int)src->d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = (int)src->d[i];
 }
 
 static void
 micro_d2u(union tgsi_exec_channel *dst,
           const union tgsi_double_channel *src)
 {
-   dst->u[0] = (unsigned)src->d[0];
-   dst->u[1] = (unsigned)src->d[1];
-   dst->u[2] = (unsigned)src->d[2];
-   dst->u[3] = (unsigned)src->d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = (unsigned)src->d[i];
 }
 static void
 micro_dabs(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = src->d[0] >= 0.0 ? src->d[0] : -src->d[0];
-   dst->d[1] = src->d[1] >= 0.0 ? src->d[1] : -src->d[1];
-   dst->d[2] = src->d[2] >= 0.0 ? src->d[2] : -src->d[2];
-   dst->d[3] = src->d[3] >= 0.0 ? src->d[3] : -src->d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = src->d[i] >= 0.0 ? src->d[i] : -src->d[i];
 }
 
 static void
 micro_dadd(union tgsi_double_channel *dst,
           const union tgsi_double_channel *src)
 {
-   dst->d[0] = src[0].d[0] + src[1].d[0];
-   dst->d[1] = src[0].d[1] + src[1].d[1];
-   dst->d[2] = src[0].d[2] + src[1].d[2];
-   dst->d[3] = src[0].d[3] + src[1].d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = src[0].d[i] + src[1].d[i];
 }
 
 static void
 micro_ddiv(union tgsi_double_channel *dst,
           const union tgsi_double_channel *src)
 {
-   dst->d[0] = src[0].d[0] / src[1].d[0];
-   dst->d[1] = src[0].d[1] / src[1].d[1];
-   dst->d[2] = src[0].d[2] / src[1].d[2];
-   dst->d[3] = src[0].d[3] / src[1].d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = src[0].d[i] / src[1].d[i];
 }
 
 static void
 micro_ddx(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] =
-   dst->f[1] =
-   dst->f[2] =
-   dst->f[3] = src->f[TILE_BOTTOM_RIGHT] - src->f[TILE_BOTTOM_LEFT];
+   unsigned q;
+
+   for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+      const float d = src->f[q + TILE_BOTTOM_RIGHT] - src->f[q + TILE_BOTTOM_LEFT];
+      dst->f[q + 0] = dst->f[q + 1] = dst->f[q + 2] = dst->f[q + 3] = d;
+   }
 }
 
 static void
 micro_ddy(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] =
-   dst->f[1] =
-   dst->f[2] =
-   dst->f[3] = src->f[TILE_BOTTOM_LEFT] - src->f[TILE_TOP_LEFT];
+   unsigned q;
+
+   for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+      const float d = src->f[q + TILE_BOTTOM_LEFT] - src->f[q + TILE_TOP_LEFT];
+      dst->f[q + 0] = dst->f[q + 1] = dst->f[q + 2] = dst->f[q + 3] = d;
+   }
 }
 
 static void
 micro_dmul(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = src[0].d[0] * src[1].d[0];
-   dst->d[1] = src[0].d[1] * src[1].d[1];
-   dst->d[2] = src[0].d[2] * src[1].d[2];
-   dst->d[3] = src[0].d[3] * src[1].d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = src[0].d[i] * src[1].d[i];
 }
 
 static void
 micro_dmax(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = src[0].d[0] > src[1].d[0] ? src[0].d[0] : src[1].d[0];
-   dst->d[1] = src[0].d[1] > src[1].d[1] ? src[0].d[1] : src[1].d[1];
-   dst->d[2] = src[0].d[2] > src[1].d[2] ? src[0].d[2] : src[1].d[2];
-   dst->d[3] = src[0].d[3] > src[1].d[3] ? src[0].d[3] : src[1].d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = src[0].d[i] > src[1].d[i] ? src[0].d[i] : src[1].d[i];
 }
 
 static void
 micro_dmin(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = src[0].d[0] < src[1].d[0] ? src[0].d[0] : src[1].d[0];
-   dst->d[1] = src[0].d[1] < src[1].d[1] ? src[0].d[1] : src[1].d[1];
-   dst->d[2] = src[0].d[2] < src[1].d[2] ? src[0].d[2] : src[1].d[2];
-   dst->d[3] = src[0].d[3] < src[1].d[3] ? src[0].d[3] : src[1].d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = src[0].d[i] < src[1].d[i] ? src[0].d[i] : src[1].d[i];
 }
 
 static void
 micro_dneg(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = -src->d[0];
-   dst->d[1] = -src->d[1];
-   dst->d[2] = -src->d[2];
-   dst->d[3] = -src->d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = -src->d[i];
 }
 
 static void
 micro_dslt(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].d[0] < src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] < src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] < src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] < src[1].d[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i][0] = src[0].d[i] < src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_dsne(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].d[0] != src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] != src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] != src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] != src[1].d[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i][0] = src[0].d[i] != src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_dsge(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].d[0] >= src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] >= src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] >= src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] >= src[1].d[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i][0] = src[0].d[i] >= src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_dseq(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].d[0] == src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] == src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] == src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] == src[1].d[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i][0] = src[0].d[i] == src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_drcp(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = 1.0 / src->d[0];
-   dst->d[1] = 1.0 / src->d[1];
-   dst->d[2] = 1.0 / src->d[2];
-   dst->d[3] = 1.0 / src->d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = 1.0 / src->d[i];
 }
 
 static void
 micro_dsqrt(union tgsi_double_channel *dst,
             const union tgsi_double_channel *src)
 {
-   dst->d[0] = sqrt(src->d[0]);
-   dst->d[1] = sqrt(src->d[1]);
-   dst->d[2] = sqrt(src->d[2]);
-   dst->d[3] = sqrt(src->d[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = sqrt(src->d[i]);
 }
 
 static void
 micro_drsq(union tgsi_double_channel *dst,
           const union tgsi_double_channel *src)
 {
-   dst->d[0] = 1.0 / sqrt(src->d[0]);
-   dst->d[1] = 1.0 / sqrt(src->d[1]);
-   dst->d[2] = 1.0 / sqrt(src->d[2]);
-   dst->d[3] = 1.0 / sqrt(src->d[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = 1.0 / sqrt(src->d[i]);
 }
 
 static void
 micro_dmad(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = src[0].d[0] * src[1].d[0] + src[2].d[0];
-   dst->d[1] = src[0].d[1] * src[1].d[1] + src[2].d[1];
-   dst->d[2] = src[0].d[2] * src[1].d[2] + src[2].d[2];
-   dst->d[3] = src[0].d[3] * src[1].d[3] + src[2].d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = src[0].d[i] * src[1].d[i] + src[2].d[i];
 }
 
 static void
 micro_dfrac(union tgsi_double_channel *dst,
             const union tgsi_double_channel *src)
 {
-   dst->d[0] = src->d[0] - floor(src->d[0]);
-   dst->d[1] = src->d[1] - floor(src->d[1]);
-   dst->d[2] = src->d[2] - floor(src->d[2]);
-   dst->d[3] = src->d[3] - floor(src->d[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = src->d[i] - floor(src->d[i]);
 }
 
 static void
@@ -362,10 +366,10 @@ micro_dldexp(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src0,
              union tgsi_exec_channel *src1)
 {
-   dst->d[0] = ldexp(src0->d[0], src1->i[0]);
-   dst->d[1] = ldexp(src0->d[1], src1->i[1]);
-   dst->d[2] = ldexp(src0->d[2], src1->i[2]);
-   dst->d[3] = ldexp(src0->d[3], src1->i[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = ldexp(src0->d[i], src1->i[i]);
 }
 
 static void
@@ -373,28 +377,27 @@ micro_dfracexp(union tgsi_double_channel *dst,
                union tgsi_exec_channel *dst_exp,
                const union tgsi_double_channel *src)
 {
-   dst->d[0] = frexp(src->d[0], &dst_exp->i[0]);
-   dst->d[1] = frexp(src->d[1], &dst_exp->i[1]);
-   dst->d[2] = frexp(src->d[2], &dst_exp->i[2]);
-   dst->d[3] = frexp(src->d[3], &dst_exp->i[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = frexp(src->d[i], &dst_exp->i[i]);
 }
 
 static void
 micro_exp2(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
+   unsigned i;
+
 #if FAST_MATH
-   dst->f[0] = util_fast_exp2(src->f[0]);
-   dst->f[1] = util_fast_exp2(src->f[1]);
-   dst->f[2] = util_fast_exp2(src->f[2]);
-   dst->f[3] = util_fast_exp2(src->f[3]);
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = util_fast_exp2(src->f[i]);
 #else
 #if DEBUG
    /* Inf is okay for this instruction, so clamp it to silence assertions. */
-   uint i;
    union tgsi_exec_channel clamped;
 
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
       if (src->f[i] > 127.99999f) {
          clamped.f[i] = 127.99999f;
       } else if (src->f[i] < -126.99999f) {
@@ -406,10 +409,8 @@ micro_exp2(union tgsi_exec_channel *dst,
    src = &clamped;
 #endif /* DEBUG */
 
-   dst->f[0] = powf(2.0f, src->f[0]);
-   dst->f[1] = powf(2.0f, src->f[1]);
-   dst->f[2] = powf(2.0f, src->f[2]);
-   dst->f[3] = powf(2.0f, src->f[3]);
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = powf(2.0f, src->f[i]);
 #endif /* FAST_MATH */
 }
 
@@ -417,76 +418,74 @@ static void
 micro_f2d(union tgsi_double_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->d[0] = (double)src->f[0];
-   dst->d[1] = (double)src->f[1];
-   dst->d[2] = (double)src->f[2];
-   dst->d[3] = (double)src->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = (double)src->f[i];
 }
 
 static void
 micro_flr(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = floorf(src->f[0]);
-   dst->f[1] = floorf(src->f[1]);
-   dst->f[2] = floorf(src->f[2]);
-   dst->f[3] = floorf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = floorf(src->f[i]);
 }
 
 static void
 micro_frc(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = src->f[0] - floorf(src->f[0]);
-   dst->f[1] = src->f[1] - floorf(src->f[1]);
-   dst->f[2] = src->f[2] - floorf(src->f[2]);
-   dst->f[3] = src->f[3] - floorf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src->f[i] - floorf(src->f[i]);
 }
 
 static void
 micro_i2d(union tgsi_double_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->d[0] = (double)src->i[0];
-   dst->d[1] = (double)src->i[1];
-   dst->d[2] = (double)src->i[2];
-   dst->d[3] = (double)src->i[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = (double)src->i[i];
 }
 
 static void
 micro_iabs(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->i[0] = src->i[0] >= 0 ? src->i[0] : -src->i[0];
-   dst->i[1] = src->i[1] >= 0 ? src->i[1] : -src->i[1];
-   dst->i[2] = src->i[2] >= 0 ? src->i[2] : -src->i[2];
-   dst->i[3] = src->i[3] >= 0 ? src->i[3] : -src->i[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = src->i[i] >= 0 ? src->i[i] : -src->i[i];
 }
 
 static void
 micro_ineg(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->i[0] = -src->i[0];
-   dst->i[1] = -src->i[1];
-   dst->i[2] = -src->i[2];
-   dst->i[3] = -src->i[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = -src->i[i];
 }
 
 static void
 micro_lg2(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
+   unsigned i;
+
 #if FAST_MATH
-   dst->f[0] = util_fast_log2(src->f[0]);
-   dst->f[1] = util_fast_log2(src->f[1]);
-   dst->f[2] = util_fast_log2(src->f[2]);
-   dst->f[3] = util_fast_log2(src->f[3]);
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = util_fast_log2(src->f[i]);
 #else
-   dst->f[0] = logf(src->f[0]) * 1.442695f;
-   dst->f[1] = logf(src->f[1]) * 1.442695f;
-   dst->f[2] = logf(src->f[2]) * 1.442695f;
-   dst->f[3] = logf(src->f[3]) * 1.442695f;
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = logf(src->f[i]) * 1.442695f;
 #endif
 }
 
@@ -496,10 +495,10 @@ micro_lrp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
-   dst->f[0] = src0->f[0] * (src1->f[0] - src2->f[0]) + src2->f[0];
-   dst->f[1] = src0->f[1] * (src1->f[1] - src2->f[1]) + src2->f[1];
-   dst->f[2] = src0->f[2] * (src1->f[2] - src2->f[2]) + src2->f[2];
-   dst->f[3] = src0->f[3] * (src1->f[3] - src2->f[3]) + src2->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] * (src1->f[i] - src2->f[i]) + src2->f[i];
 }
 
 static void
@@ -508,72 +507,68 @@ micro_mad(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
-   dst->f[0] = src0->f[0] * src1->f[0] + src2->f[0];
-   dst->f[1] = src0->f[1] * src1->f[1] + src2->f[1];
-   dst->f[2] = src0->f[2] * src1->f[2] + src2->f[2];
-   dst->f[3] = src0->f[3] * src1->f[3] + src2->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] * src1->f[i] + src2->f[i];
 }
 
 static void
 micro_mov(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->u[0] = src->u[0];
-   dst->u[1] = src->u[1];
-   dst->u[2] = src->u[2];
-   dst->u[3] = src->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src->u[i];
 }
 
 static void
 micro_rcp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
+   unsigned i;
+
 #if 0 /* for debugging */
-   assert(src->f[0] != 0.0f);
-   assert(src->f[1] != 0.0f);
-   assert(src->f[2] != 0.0f);
-   assert(src->f[3] != 0.0f);
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      assert(src->f[i] != 0.0f);
 #endif
-   dst->f[0] = 1.0f / src->f[0];
-   dst->f[1] = 1.0f / src->f[1];
-   dst->f[2] = 1.0f / src->f[2];
-   dst->f[3] = 1.0f / src->f[3];
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = 1.0f / src->f[i];
 }
 
 static void
 micro_rnd(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = _mesa_roundevenf(src->f[0]);
-   dst->f[1] = _mesa_roundevenf(src->f[1]);
-   dst->f[2] = _mesa_roundevenf(src->f[2]);
-   dst->f[3] = _mesa_roundevenf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = _mesa_roundevenf(src->f[i]);
 }
 
 static void
 micro_rsq(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
+   unsigned i;
+
 #if 0 /* for debugging */
-   assert(src->f[0] != 0.0f);
-   assert(src->f[1] != 0.0f);
-   assert(src->f[2] != 0.0f);
-   assert(src->f[3] != 0.0f);
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      assert(src->f[i] != 0.0f);
 #endif
-   dst->f[0] = 1.0f / sqrtf(src->f[0]);
-   dst->f[1] = 1.0f / sqrtf(src->f[1]);
-   dst->f[2] = 1.0f / sqrtf(src->f[2]);
-   dst->f[3] = 1.0f / sqrtf(src->f[3]);
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = 1.0f / sqrtf(src->f[i]);
 }
 
 static void
 micro_sqrt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->f[0] = sqrtf(src->f[0]);
-   dst->f[1] = sqrtf(src->f[1]);
-   dst->f[2] = sqrtf(src->f[2]);
-   dst->f[3] = sqrtf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = sqrtf(src->f[i]);
 }
 
 static void
@@ -581,10 +576,10 @@ micro_seq(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] == src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] == src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] == src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] == src1->f[3] ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] == src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
@@ -592,30 +587,30 @@ micro_sge(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] >= src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] >= src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] >= src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] >= src1->f[3] ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] >= src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_sgn(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = src->f[0] < 0.0f ? -1.0f : src->f[0] > 0.0f ? 1.0f : 0.0f;
-   dst->f[1] = src->f[1] < 0.0f ? -1.0f : src->f[1] > 0.0f ? 1.0f : 0.0f;
-   dst->f[2] = src->f[2] < 0.0f ? -1.0f : src->f[2] > 0.0f ? 1.0f : 0.0f;
-   dst->f[3] = src->f[3] < 0.0f ? -1.0f : src->f[3] > 0.0f ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src->f[i] < 0.0f ? -1.0f : src->f[i] > 0.0f ? 1.0f : 0.0f;
 }
 
 static void
 micro_isgn(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->i[0] = src->i[0] < 0 ? -1 : src->i[0] > 0 ? 1 : 0;
-   dst->i[1] = src->i[1] < 0 ? -1 : src->i[1] > 0 ? 1 : 0;
-   dst->i[2] = src->i[2] < 0 ? -1 : src->i[2] > 0 ? 1 : 0;
-   dst->i[3] = src->i[3] < 0 ? -1 : src->i[3] > 0 ? 1 : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = src->i[i] < 0 ? -1 : src->i[i] > 0 ? 1 : 0;
 }
 
 static void
@@ -623,20 +618,20 @@ micro_sgt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] > src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] > src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] > src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] > src1->f[3] ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] > src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_sin(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = sinf(src->f[0]);
-   dst->f[1] = sinf(src->f[1]);
-   dst->f[2] = sinf(src->f[2]);
-   dst->f[3] = sinf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = sinf(src->f[i]);
 }
 
 static void
@@ -644,10 +639,10 @@ micro_sle(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] <= src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] <= src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] <= src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] <= src1->f[3] ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] <= src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
@@ -655,10 +650,10 @@ micro_slt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] < src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] < src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] < src1->f[3] ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
@@ -666,220 +661,220 @@ micro_sne(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] != src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] != src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] != src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] != src1->f[3] ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] != src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_trunc(union tgsi_exec_channel *dst,
             const union tgsi_exec_channel *src)
 {
-   dst->f[0] = truncf(src->f[0]);
-   dst->f[1] = truncf(src->f[1]);
-   dst->f[2] = truncf(src->f[2]);
-   dst->f[3] = truncf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = truncf(src->f[i]);
 }
 
 static void
 micro_u2d(union tgsi_double_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->d[0] = (double)src->u[0];
-   dst->d[1] = (double)src->u[1];
-   dst->d[2] = (double)src->u[2];
-   dst->d[3] = (double)src->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = (double)src->u[i];
 }
 
 static void
 micro_i64abs(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = src->i64[0] >= 0.0 ? src->i64[0] : -src->i64[0];
-   dst->i64[1] = src->i64[1] >= 0.0 ? src->i64[1] : -src->i64[1];
-   dst->i64[2] = src->i64[2] >= 0.0 ? src->i64[2] : -src->i64[2];
-   dst->i64[3] = src->i64[3] >= 0.0 ? src->i64[3] : -src->i64[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i64[i] = src->i64[i] >= 0.0 ? src->i64[i] : -src->i64[i];
 }
 
 static void
 micro_i64sgn(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = src->i64[0] < 0 ? -1 : src->i64[0] > 0 ? 1 : 0;
-   dst->i64[1] = src->i64[1] < 0 ? -1 : src->i64[1] > 0 ? 1 : 0;
-   dst->i64[2] = src->i64[2] < 0 ? -1 : src->i64[2] > 0 ? 1 : 0;
-   dst->i64[3] = src->i64[3] < 0 ? -1 : src->i64[3] > 0 ? 1 : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i64[i] = src->i64[i] < 0 ? -1 : src->i64[i] > 0 ? 1 : 0;
 }
 
 static void
 micro_i64neg(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = -src->i64[0];
-   dst->i64[1] = -src->i64[1];
-   dst->i64[2] = -src->i64[2];
-   dst->i64[3] = -src->i64[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i64[i] = -src->i64[i];
 }
 
 static void
 micro_u64seq(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].u64[0] == src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] == src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] == src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] == src[1].u64[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i][0] = src[0].u64[i] == src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64sne(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].u64[0] != src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] != src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] != src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] != src[1].u64[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i][0] = src[0].u64[i] != src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_i64slt(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].i64[0] < src[1].i64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].i64[1] < src[1].i64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].i64[2] < src[1].i64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].i64[3] < src[1].i64[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i][0] = src[0].i64[i] < src[1].i64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64slt(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].u64[0] < src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] < src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] < src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] < src[1].u64[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i][0] = src[0].u64[i] < src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_i64sge(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].i64[0] >= src[1].i64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].i64[1] >= src[1].i64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].i64[2] >= src[1].i64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].i64[3] >= src[1].i64[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i][0] = src[0].i64[i] >= src[1].i64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64sge(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].u64[0] >= src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] >= src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] >= src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] >= src[1].u64[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i][0] = src[0].u64[i] >= src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64max(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u64[0] = src[0].u64[0] > src[1].u64[0] ? src[0].u64[0] : src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] > src[1].u64[1] ? src[0].u64[1] : src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] > src[1].u64[2] ? src[0].u64[2] : src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] > src[1].u64[3] ? src[0].u64[3] : src[1].u64[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u64[i] = src[0].u64[i] > src[1].u64[i] ? src[0].u64[i] : src[1].u64[i];
 }
 
 static void
 micro_i64max(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = src[0].i64[0] > src[1].i64[0] ? src[0].i64[0] : src[1].i64[0];
-   dst->i64[1] = src[0].i64[1] > src[1].i64[1] ? src[0].i64[1] : src[1].i64[1];
-   dst->i64[2] = src[0].i64[2] > src[1].i64[2] ? src[0].i64[2] : src[1].i64[2];
-   dst->i64[3] = src[0].i64[3] > src[1].i64[3] ? src[0].i64[3] : src[1].i64[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i64[i] = src[0].i64[i] > src[1].i64[i] ? src[0].i64[i] : src[1].i64[i];
 }
 
 static void
 micro_u64min(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u64[0] = src[0].u64[0] < src[1].u64[0] ? src[0].u64[0] : src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] < src[1].u64[1] ? src[0].u64[1] : src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] < src[1].u64[2] ? src[0].u64[2] : src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] < src[1].u64[3] ? src[0].u64[3] : src[1].u64[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u64[i] = src[0].u64[i] < src[1].u64[i] ? src[0].u64[i] : src[1].u64[i];
 }
 
 static void
 micro_i64min(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = src[0].i64[0] < src[1].i64[0] ? src[0].i64[0] : src[1].i64[0];
-   dst->i64[1] = src[0].i64[1] < src[1].i64[1] ? src[0].i64[1] : src[1].i64[1];
-   dst->i64[2] = src[0].i64[2] < src[1].i64[2] ? src[0].i64[2] : src[1].i64[2];
-   dst->i64[3] = src[0].i64[3] < src[1].i64[3] ? src[0].i64[3] : src[1].i64[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i64[i] = src[0].i64[i] < src[1].i64[i] ? src[0].i64[i] : src[1].i64[i];
 }
 
 static void
 micro_u64add(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u64[0] = src[0].u64[0] + src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] + src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] + src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] + src[1].u64[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u64[i] = src[0].u64[i] + src[1].u64[i];
 }
 
 static void
 micro_u64mul(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u64[0] = src[0].u64[0] * src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] * src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] * src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] * src[1].u64[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u64[i] = src[0].u64[i] * src[1].u64[i];
 }
 
 static void
 micro_u64div(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u64[0] = src[1].u64[0] ? src[0].u64[0] / src[1].u64[0] : ~0ull;
-   dst->u64[1] = src[1].u64[1] ? src[0].u64[1] / src[1].u64[1] : ~0ull;
-   dst->u64[2] = src[1].u64[2] ? src[0].u64[2] / src[1].u64[2] : ~0ull;
-   dst->u64[3] = src[1].u64[3] ? src[0].u64[3] / src[1].u64[3] : ~0ull;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u64[i] = src[1].u64[i] ? src[0].u64[i] / src[1].u64[i] : ~0ull;
 }
 
 static void
 micro_i64div(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = src[1].i64[0] ? src[0].i64[0] / src[1].i64[0] : 0;
-   dst->i64[1] = src[1].i64[1] ? src[0].i64[1] / src[1].i64[1] : 0;
-   dst->i64[2] = src[1].i64[2] ? src[0].i64[2] / src[1].i64[2] : 0;
-   dst->i64[3] = src[1].i64[3] ? src[0].i64[3] / src[1].i64[3] : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i64[i] = src[1].i64[i] ? src[0].i64[i] / src[1].i64[i] : 0;
 }
 
 static void
 micro_u64mod(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u64[0] = src[1].u64[0] ? src[0].u64[0] % src[1].u64[0] : ~0ull;
-   dst->u64[1] = src[1].u64[1] ? src[0].u64[1] % src[1].u64[1] : ~0ull;
-   dst->u64[2] = src[1].u64[2] ? src[0].u64[2] % src[1].u64[2] : ~0ull;
-   dst->u64[3] = src[1].u64[3] ? src[0].u64[3] % src[1].u64[3] : ~0ull;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u64[i] = src[1].u64[i] ? src[0].u64[i] % src[1].u64[i] : ~0ull;
 }
 
 static void
 micro_i64mod(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = src[1].i64[0] ? src[0].i64[0] % src[1].i64[0] : ~0ll;
-   dst->i64[1] = src[1].i64[1] ? src[0].i64[1] % src[1].i64[1] : ~0ll;
-   dst->i64[2] = src[1].i64[2] ? src[0].i64[2] % src[1].i64[2] : ~0ll;
-   dst->i64[3] = src[1].i64[3] ? src[0].i64[3] % src[1].i64[3] : ~0ll;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i64[i] = src[1].i64[i] ? src[0].i64[i] % src[1].i64[i] : ~0ll;
 }
 
 static void
@@ -888,14 +883,11 @@ micro_u64shl(union tgsi_double_channel *dst,
              union tgsi_exec_channel *src1)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x3f;
-   dst->u64[0] = src0->u64[0] << masked_count;
-   masked_count = src1->u[1] & 0x3f;
-   dst->u64[1] = src0->u64[1] << masked_count;
-   masked_count = src1->u[2] & 0x3f;
-   dst->u64[2] = src0->u64[2] << masked_count;
-   masked_count = src1->u[3] & 0x3f;
-   dst->u64[3] = src0->u64[3] << masked_count;
+   unsigned i;
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
+      masked_count = src1->u[i] & 0x3f;
+      dst->u64[i] = src0->u64[i] << masked_count;
+   }
 }
 
 static void
@@ -904,14 +896,11 @@ micro_i64shr(union tgsi_double_channel *dst,
              union tgsi_exec_channel *src1)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x3f;
-   dst->i64[0] = src0->i64[0] >> masked_count;
-   masked_count = src1->u[1] & 0x3f;
-   dst->i64[1] = src0->i64[1] >> masked_count;
-   masked_count = src1->u[2] & 0x3f;
-   dst->i64[2] = src0->i64[2] >> masked_count;
-   masked_count = src1->u[3] & 0x3f;
-   dst->i64[3] = src0->i64[3] >> masked_count;
+   unsigned i;
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
+      masked_count = src1->u[i] & 0x3f;
+      dst->i64[i] = src0->i64[i] >> masked_count;
+   }
 }
 
 static void
@@ -920,14 +909,11 @@ micro_u64shr(union tgsi_double_channel *dst,
              union tgsi_exec_channel *src1)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x3f;
-   dst->u64[0] = src0->u64[0] >> masked_count;
-   masked_count = src1->u[1] & 0x3f;
-   dst->u64[1] = src0->u64[1] >> masked_count;
-   masked_count = src1->u[2] & 0x3f;
-   dst->u64[2] = src0->u64[2] >> masked_count;
-   masked_count = src1->u[3] & 0x3f;
-   dst->u64[3] = src0->u64[3] >> masked_count;
+   unsigned i;
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
+      masked_count = src1->u[i] & 0x3f;
+      dst->u64[i] = src0->u64[i] >> masked_count;
+   }
 }
 
 enum tgsi_exec_datatype {
@@ -970,20 +956,15 @@ static const struct {
       MACH->ExecMask = MACH->CondMask & MACH->LoopMask & MACH->ContMask & MACH->Switch.mask & MACH->FuncMask
 
 
-static const union tgsi_exec_channel ZeroVec =
-   { { 0.0, 0.0, 0.0, 0.0 } };
+static const union tgsi_exec_channel ZeroVec = { { 0.0f } };
 
-static const union tgsi_exec_channel OneVec = {
-   {1.0f, 1.0f, 1.0f, 1.0f}
-};
-
-static const union tgsi_exec_channel P128Vec = {
-   {128.0f, 128.0f, 128.0f, 128.0f}
-};
-
-static const union tgsi_exec_channel M128Vec = {
-   {-128.0f, -128.0f, -128.0f, -128.0f}
-};
+/* Splatted constants, kept in the machine's internal temporaries */
+#define ONE_VEC(MACH) \
+   (&(MACH)->Temps[TGSI_EXEC_TEMP_ONE_I].xyzw[TGSI_EXEC_TEMP_ONE_C])
+#define P128_VEC(MACH) \
+   (&(MACH)->Temps[TGSI_EXEC_TEMP_128_I].xyzw[TGSI_EXEC_TEMP_128_C])
+#define M128_VEC(MACH) \
+   (&(MACH)->Temps[TGSI_EXEC_TEMP_MINUS_128_I].xyzw[TGSI_EXEC_TEMP_MINUS_128_C])
 
 
 /**
@@ -995,10 +976,10 @@ static const union tgsi_exec_channel M128Vec = {
 static inline void
 check_inf_or_nan(const union tgsi_exec_channel *chan)
 {
-   assert(!util_is_inf_or_nan((chan)->f[0]));
-   assert(!util_is_inf_or_nan((chan)->f[1]));
-   assert(!util_is_inf_or_nan((chan)->f[2]));
-   assert(!util_is_inf_or_nan((chan)->f[3]));
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      assert(!util_is_inf_or_nan((chan)->f[i]));
 }
 
 
@@ -1006,8 +987,12 @@ check_inf_or_nan(const union tgsi_exec_channel *chan)
 static void
 print_chan(const char *msg, const union tgsi_exec_channel *chan)
 {
-   debug_printf("%s = {%f, %f, %f, %f}\n",
-                msg, chan->f[0], chan->f[1], chan->f[2], chan->f[3]);
+   unsigned i;
+
+   debug_printf("%s = {", msg);
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      debug_printf(i ? ", %f" : "%f", chan->f[i]);
+   debug_printf("}\n");
 }
 #endif
 
@@ -1018,14 +1003,13 @@ print_temp(const struct tgsi_exec_machine *mach, uint index)
 {
    const struct tgsi_exec_vector *tmp = &mach->Temps[index];
    int i;
+   unsigned j;
    debug_printf("Temp[%u] =\n", index);
    for (i = 0; i < 4; i++) {
-      debug_printf("  %c: { %f, %f, %f, %f }\n",
-                   "XYZW"[i],
-                   tmp->xyzw[i].f[0],
-                   tmp->xyzw[i].f[1],
-                   tmp->xyzw[i].f[2],
-                   tmp->xyzw[i].f[3]);
+      debug_printf("  %c: {", "XYZW"[i]);
+      for (j = 0; j < TGSI_EXEC_WIDTH; j++)
+         debug_printf(j ? ", %f" : " %f", tmp->xyzw[i].f[j]);
+      debug_printf(" }\n");
    }
 }
 #endif
@@ -1100,6 +1084,9 @@ tgsi_check_soa_dependencies(const struct tgsi_full_instruction *inst)
 }
 
 
+static struct tgsi_exec_op *
+decode_instructions(struct tgsi_exec_machine *mach);
+
 /**
  * Initialize machine state by expanding tokens to full instructions,
  * allocating temporary storage, setting up constants, etc.
@@ -1142,6 +1129,9 @@ tgsi_exec_machine_bind_shader(
       mach->Instructions = NULL;
       mach->NumInstructions = 0;
 
+      FREE(mach->Ops);
+      mach->Ops = NULL;
+
       return;
    }
 
@@ -1298,6 +1288,12 @@ tgsi_exec_machine_bind_shader(
    FREE(mach->Instructions);
    mach->Instructions = instructions;
    mach->NumInstructions = numInstructions;
+
+   /* The operands are resolved against the register files of this machine,
+    * so this has to come after they are (re)allocated above.
+    */
+   FREE(mach->Ops);
+   mach->Ops = decode_instructions(mach);
 }
 
 
@@ -1331,7 +1327,7 @@ tgsi_exec_machine_create(enum pipe_shader_type shader_type)
    }
 
    /* Setup constants needed by the SSE2 executor. */
-   for( i = 0; i < 4; i++ ) {
+   for( i = 0; i < TGSI_EXEC_WIDTH; i++ ) {
       mach->Temps[TGSI_EXEC_TEMP_00000000_I].xyzw[TGSI_EXEC_TEMP_00000000_C].u[i] = 0x00000000;
       mach->Temps[TGSI_EXEC_TEMP_7FFFFFFF_I].xyzw[TGSI_EXEC_TEMP_7FFFFFFF_C].u[i] = 0x7FFFFFFF;
       mach->Temps[TGSI_EXEC_TEMP_80000000_I].xyzw[TGSI_EXEC_TEMP_80000000_C].u[i] = 0x80000000;
@@ -1368,6 +1364,7 @@ tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach)
 {
    if (mach) {
       FREE(mach->Instructions);
+      FREE(mach->Ops);
       FREE(mach->Declarations);
       FREE(mach->Imms);
 
@@ -1384,10 +1381,10 @@ micro_add(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] + src1->f[0];
-   dst->f[1] = src0->f[1] + src1->f[1];
-   dst->f[2] = src0->f[2] + src1->f[2];
-   dst->f[3] = src0->f[3] + src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] + src1->f[i];
 }
 
 static void
@@ -1396,17 +1393,12 @@ micro_div(
    const union tgsi_exec_channel *src0,
    const union tgsi_exec_channel *src1 )
 {
-   if (src1->f[0] != 0) {
-      dst->f[0] = src0->f[0] / src1->f[0];
-   }
-   if (src1->f[1] != 0) {
-      dst->f[1] = src0->f[1] / src1->f[1];
-   }
-   if (src1->f[2] != 0) {
-      dst->f[2] = src0->f[2] / src1->f[2];
-   }
-   if (src1->f[3] != 0) {
-      dst->f[3] = src0->f[3] / src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
+      if (src1->f[i] != 0) {
+         dst->f[i] = src0->f[i] / src1->f[i];
+      }
    }
 }
 
@@ -1418,10 +1410,10 @@ micro_lt(
    const union tgsi_exec_channel *src2,
    const union tgsi_exec_channel *src3 )
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? src2->f[0] : src3->f[0];
-   dst->f[1] = src0->f[1] < src1->f[1] ? src2->f[1] : src3->f[1];
-   dst->f[2] = src0->f[2] < src1->f[2] ? src2->f[2] : src3->f[2];
-   dst->f[3] = src0->f[3] < src1->f[3] ? src2->f[3] : src3->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? src2->f[i] : src3->f[i];
 }
 
 static void
@@ -1429,10 +1421,10 @@ micro_max(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] > src1->f[0] ? src0->f[0] : src1->f[0];
-   dst->f[1] = src0->f[1] > src1->f[1] ? src0->f[1] : src1->f[1];
-   dst->f[2] = src0->f[2] > src1->f[2] ? src0->f[2] : src1->f[2];
-   dst->f[3] = src0->f[3] > src1->f[3] ? src0->f[3] : src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] > src1->f[i] ? src0->f[i] : src1->f[i];
 }
 
 static void
@@ -1440,10 +1432,10 @@ micro_min(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? src0->f[0] : src1->f[0];
-   dst->f[1] = src0->f[1] < src1->f[1] ? src0->f[1] : src1->f[1];
-   dst->f[2] = src0->f[2] < src1->f[2] ? src0->f[2] : src1->f[2];
-   dst->f[3] = src0->f[3] < src1->f[3] ? src0->f[3] : src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? src0->f[i] : src1->f[i];
 }
 
 static void
@@ -1451,10 +1443,10 @@ micro_mul(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] * src1->f[0];
-   dst->f[1] = src0->f[1] * src1->f[1];
-   dst->f[2] = src0->f[2] * src1->f[2];
-   dst->f[3] = src0->f[3] * src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] * src1->f[i];
 }
 
 static void
@@ -1462,10 +1454,10 @@ micro_neg(
    union tgsi_exec_channel *dst,
    const union tgsi_exec_channel *src )
 {
-   dst->f[0] = -src->f[0];
-   dst->f[1] = -src->f[1];
-   dst->f[2] = -src->f[2];
-   dst->f[3] = -src->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = -src->f[i];
 }
 
 static void
@@ -1474,16 +1466,14 @@ micro_pow(
    const union tgsi_exec_channel *src0,
    const union tgsi_exec_channel *src1 )
 {
+   unsigned i;
+
 #if FAST_MATH
-   dst->f[0] = util_fast_pow( src0->f[0], src1->f[0] );
-   dst->f[1] = util_fast_pow( src0->f[1], src1->f[1] );
-   dst->f[2] = util_fast_pow( src0->f[2], src1->f[2] );
-   dst->f[3] = util_fast_pow( src0->f[3], src1->f[3] );
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = util_fast_pow( src0->f[i], src1->f[i] );
 #else
-   dst->f[0] = powf( src0->f[0], src1->f[0] );
-   dst->f[1] = powf( src0->f[1], src1->f[1] );
-   dst->f[2] = powf( src0->f[2], src1->f[2] );
-   dst->f[3] = powf( src0->f[3], src1->f[3] );
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = powf( src0->f[i], src1->f[i] );
 #endif
 }
 
@@ -1492,10 +1482,10 @@ micro_ldexp(union tgsi_exec_channel *dst,
             const union tgsi_exec_channel *src0,
             const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = ldexpf(src0->f[0], src1->i[0]);
-   dst->f[1] = ldexpf(src0->f[1], src1->i[1]);
-   dst->f[2] = ldexpf(src0->f[2], src1->i[2]);
-   dst->f[3] = ldexpf(src0->f[3], src1->i[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = ldexpf(src0->f[i], src1->i[i]);
 }
 
 static void
@@ -1503,10 +1493,10 @@ micro_sub(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] - src1->f[0];
-   dst->f[1] = src0->f[1] - src1->f[1];
-   dst->f[2] = src0->f[2] - src1->f[2];
-   dst->f[3] = src0->f[3] - src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->f[i] - src1->f[i];
 }
 
 static void
@@ -1523,7 +1513,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
 
    switch (file) {
    case TGSI_FILE_CONSTANT:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
          assert(index2D->i[i] >= 0 && index2D->i[i] < PIPE_MAX_CONSTANT_BUFFERS);
          assert(mach->Consts[index2D->i[i]]);
 
@@ -1552,7 +1542,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_INPUT:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
          /*
          if (PIPE_SHADER_GEOMETRY == mach->ShaderType) {
             debug_printf("Fetching Input[%d] (2d=%d, 1d=%d)\n",
@@ -1570,13 +1560,13 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       /* XXX no swizzling at this point.  Will be needed if we put
        * gl_FragCoord, for example, in a sys value register.
        */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
          chan->u[i] = mach->SystemValue[index->i[i]].xyzw[swizzle].u[i];
       }
       break;
 
    case TGSI_FILE_TEMPORARY:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
          assert(index->i[i] < TGSI_EXEC_NUM_TEMPS);
          assert(index2D->i[i] == 0);
 
@@ -1585,7 +1575,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_IMMEDIATE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
          assert(index->i[i] >= 0 && index->i[i] < (int)mach->ImmLimit);
          assert(index2D->i[i] == 0);
 
@@ -1594,7 +1584,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_ADDRESS:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
          assert(index->i[i] >= 0);
          assert(index2D->i[i] == 0);
 
@@ -1604,7 +1594,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
 
    case TGSI_FILE_OUTPUT:
       /* vertex/fragment output vars can be read too */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
          assert(index->i[i] >= 0);
          assert(index2D->i[i] == 0);
 
@@ -1614,7 +1604,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
 
    default:
       assert(0);
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
          chan->u[i] = 0;
       }
    }
@@ -1627,6 +1617,7 @@ get_index_registers(const struct tgsi_exec_machine *mach,
                     union tgsi_exec_channel *index2D)
 {
    uint swizzle;
+   unsigned i;
 
    /* We start with a direct index into a register file.
     *
@@ -1635,10 +1626,8 @@ get_index_registers(const struct tgsi_exec_machine *mach,
     *       file = Register.File
     *       [1] = Register.Index
     */
-   index->i[0] =
-   index->i[1] =
-   index->i[2] =
-   index->i[3] = reg->Register.Index;
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      index->i[i] = reg->Register.Index;
 
    /* There is an extra source register that indirectly subscripts
     * a register file. The direct index now becomes an offset
@@ -1657,10 +1646,8 @@ get_index_registers(const struct tgsi_exec_machine *mach,
       uint i;
 
       /* which address register (always zero now) */
-      index2.i[0] =
-      index2.i[1] =
-      index2.i[2] =
-      index2.i[3] = reg->Indirect.Index;
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+         index2.i[i] = reg->Indirect.Index;
       /* get current value of address register[swizzle] */
       swizzle = reg->Indirect.Swizzle;
       fetch_src_file_channel(mach,
@@ -1671,15 +1658,13 @@ get_index_registers(const struct tgsi_exec_machine *mach,
                              &indir_index);
 
       /* add value of address register to the offset */
-      index->i[0] += indir_index.i[0];
-      index->i[1] += indir_index.i[1];
-      index->i[2] += indir_index.i[2];
-      index->i[3] += indir_index.i[3];
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+         index->i[i] += indir_index.i[i];
 
       /* for disabled execution channels, zero-out the index to
        * avoid using a potential garbage value.
        */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
          if ((execmask & (1 << i)) == 0)
             index->i[i] = 0;
       }
@@ -1694,10 +1679,8 @@ get_index_registers(const struct tgsi_exec_machine *mach,
     *       [3] = Dimension.Index
     */
    if (reg->Register.Dimension) {
-      index2D->i[0] =
-      index2D->i[1] =
-      index2D->i[2] =
-      index2D->i[3] = reg->Dimension.Index;
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+         index2D->i[i] = reg->Dimension.Index;
 
       /* Again, the second subscript index can be addressed indirectly
        * identically to the first one.
@@ -1716,10 +1699,8 @@ get_index_registers(const struct tgsi_exec_machine *mach,
          const uint execmask = mach->ExecMask;
          uint i;
 
-         index2.i[0] =
-         index2.i[1] =
-         index2.i[2] =
-         index2.i[3] = reg->DimIndirect.Index;
+         for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+            index2.i[i] = reg->DimIndirect.Index;
 
          swizzle = reg->DimIndirect.Swizzle;
          fetch_src_file_channel(mach,
@@ -1729,15 +1710,13 @@ get_index_registers(const struct tgsi_exec_machine *mach,
                                 &ZeroVec,
                                 &indir_index);
 
-         index2D->i[0] += indir_index.i[0];
-         index2D->i[1] += indir_index.i[1];
-         index2D->i[2] += indir_index.i[2];
-         index2D->i[3] += indir_index.i[3];
+         for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+            index2D->i[i] += indir_index.i[i];
 
          /* for disabled execution channels, zero-out the index to
           * avoid using a potential garbage value.
           */
-         for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+         for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
             if ((execmask & (1 << i)) == 0) {
                index2D->i[i] = 0;
             }
@@ -1749,14 +1728,74 @@ get_index_registers(const struct tgsi_exec_machine *mach,
        * by a dimension register and continue the saga.
        */
    } else {
-      index2D->i[0] =
-      index2D->i[1] =
-      index2D->i[2] =
-      index2D->i[3] = 0;
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+         index2D->i[i] = 0;
    }
 }
 
 
+/**
+ * Fetch a source channel whose register index is the same in all lanes,
+ * which is the common case.  Returns false if the register needs the
+ * per-lane path.
+ */
+static boolean
+fetch_source_uniform(const struct tgsi_exec_machine *mach,
+                     union tgsi_exec_channel *chan,
+                     const struct tgsi_full_src_register *reg,
+                     const uint swizzle)
+{
+   const int index = reg->Register.Index;
+   uint i;
+
+   if (reg->Register.Indirect)
+      return FALSE;
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_TEMPORARY:
+      assert(index < TGSI_EXEC_NUM_TEMPS);
+      *chan = mach->Temps[index].xyzw[swizzle];
+      return TRUE;
+
+   case TGSI_FILE_INPUT:
+      if (reg->Register.Dimension)
+         return FALSE;
+      *chan = mach->Inputs[index].xyzw[swizzle];
+      return TRUE;
+
+   case TGSI_FILE_OUTPUT:
+      *chan = mach->Outputs[index].xyzw[swizzle];
+      return TRUE;
+
+   case TGSI_FILE_IMMEDIATE:
+      assert(index >= 0 && index < (int)mach->ImmLimit);
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+         chan->f[i] = mach->Imms[index][swizzle];
+      return TRUE;
+
+   case TGSI_FILE_CONSTANT:
+      if (reg->Register.Dimension && reg->Dimension.Indirect)
+         return FALSE;
+      else {
+         const uint constbuf = reg->Register.Dimension ? reg->Dimension.Index : 0;
+         const int pos = index * 4 + swizzle;
+         uint value = 0;
+
+         assert(constbuf < PIPE_MAX_CONSTANT_BUFFERS);
+         assert(mach->Consts[constbuf]);
+
+         if (index >= 0 && pos < (int) mach->ConstsSize[constbuf])
+            value = ((const uint *)mach->Consts[constbuf])[pos];
+         for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+            chan->u[i] = value;
+      }
+      return TRUE;
+
+   default:
+      return FALSE;
+   }
+}
+
 static void
 fetch_source_d(const struct tgsi_exec_machine *mach,
                union tgsi_exec_channel *chan,
@@ -1767,10 +1806,12 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
    union tgsi_exec_channel index2D;
    uint swizzle;
 
-   get_index_registers(mach, reg, &index, &index2D);
+   swizzle = tgsi_util_get_full_src_register_swizzle( reg, chan_index );
+   if (fetch_source_uniform(mach, chan, reg, swizzle))
+      return;
 
+   get_index_registers(mach, reg, &index, &index2D);
 
-   swizzle = tgsi_util_get_full_src_register_swizzle( reg, chan_index );
    fetch_src_file_channel(mach,
                           reg->Register.File,
                           swizzle,
@@ -1817,6 +1858,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel index2D;
    int offset = 0;  /* indirection offset */
    int index;
+   unsigned i;
 
    /* for debugging */
    if (0 && dst_datatype == TGSI_EXEC_DATA_FLOAT) {
@@ -1839,10 +1881,8 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
       uint swizzle;
 
       /* which address register (always zero for now) */
-      index.i[0] =
-      index.i[1] =
-      index.i[2] =
-      index.i[3] = reg->Indirect.Index;
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+         index.i[i] = reg->Indirect.Index;
 
       /* get current value of address register[swizzle] */
       swizzle = reg->Indirect.Swizzle;
@@ -1868,10 +1908,8 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
     *       [3] = Dimension.Index
     */
    if (reg->Register.Dimension) {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = reg->Dimension.Index;
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+         index2D.i[i] = reg->Dimension.Index;
 
       /* Again, the second subscript index can be addressed indirectly
        * identically to the first one.
@@ -1891,10 +1929,8 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
          unsigned swizzle;
          uint i;
 
-         index2.i[0] =
-         index2.i[1] =
-         index2.i[2] =
-         index2.i[3] = reg->DimIndirect.Index;
+         for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+            index2.i[i] = reg->DimIndirect.Index;
 
          swizzle = reg->DimIndirect.Swizzle;
          fetch_src_file_channel(mach,
@@ -1904,15 +1940,13 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
                                 &ZeroVec,
                                 &indir_index);
 
-         index2D.i[0] += indir_index.i[0];
-         index2D.i[1] += indir_index.i[1];
-         index2D.i[2] += indir_index.i[2];
-         index2D.i[3] += indir_index.i[3];
+         for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+            index2D.i[i] += indir_index.i[i];
 
          /* for disabled execution channels, zero-out the index to
           * avoid using a potential garbage value.
           */
-         for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+         for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
             if ((execmask & (1 << i)) == 0) {
                index2D.i[i] = 0;
             }
@@ -1924,10 +1958,8 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
        * by a dimension register and continue the saga.
        */
    } else {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = 0;
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+         index2D.i[i] = 0;
    }
 
    switch (reg->Register.File) {
@@ -1945,7 +1977,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
                    reg->Register.Index);
       if (PIPE_SHADER_GEOMETRY == mach->ShaderType) {
          debug_printf("STORING OUT[%d] mask(%d), = (", offset + index, execmask);
-         for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         for (i = 0; i < TGSI_EXEC_WIDTH; i++)
             if (execmask & (1 << i))
                debug_printf("%f, ", chan->f[i]);
          debug_printf(")\n");
@@ -1988,34 +2020,33 @@ store_dest_double(struct tgsi_exec_machine *mach,
       return;
 
    /* doubles path */
-   for (i = 0; i < TGSI_QUAD_SIZE; i++)
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
       if (execmask & (1 << i))
          dst->i[i] = chan->i[i];
 }
 
-static void
-store_dest(struct tgsi_exec_machine *mach,
-           const union tgsi_exec_channel *chan,
-           const struct tgsi_full_dst_register *reg,
-           const struct tgsi_full_instruction *inst,
-           uint chan_index,
-           enum tgsi_exec_datatype dst_datatype)
+/**
+ * Write the enabled lanes of a channel to its destination register.
+ */
+static inline void
+store_channel(const struct tgsi_exec_machine *mach,
+              union tgsi_exec_channel *dst,
+              const union tgsi_exec_channel *chan,
+              boolean saturate)
 {
-   union tgsi_exec_channel *dst;
    const uint execmask = mach->ExecMask;
    int i;
 
-   dst = store_dest_dstret(mach, chan, reg, chan_index, dst_datatype);
-   if (!dst)
-      return;
-
-   if (!inst->Instruction.Saturate) {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
-         if (execmask & (1 << i))
-            dst->i[i] = chan->i[i];
+   if (!saturate) {
+      if (execmask == TGSI_EXEC_MASK)
+         *dst = *chan;
+      else
+         for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+            if (execmask & (1 << i))
+               dst->i[i] = chan->i[i];
    }
    else {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
          if (execmask & (1 << i)) {
             if (chan->f[i] < 0.0f)
                dst->f[i] = 0.0f;
@@ -2027,6 +2058,23 @@ store_dest(struct tgsi_exec_machine *mach,
    }
 }
 
+static void
+store_dest(struct tgsi_exec_machine *mach,
+           const union tgsi_exec_channel *chan,
+           const struct tgsi_full_dst_register *reg,
+           const struct tgsi_full_instruction *inst,
+           uint chan_index,
+           enum tgsi_exec_datatype dst_datatype)
+{
+   union tgsi_exec_channel *dst;
+
+   dst = store_dest_dstret(mach, chan, reg, chan_index, dst_datatype);
+   if (!dst)
+      return;
+
+   store_channel(mach, dst, chan, inst->Instruction.Saturate);
+}
+
 #define FETCH(VAL,INDEX,CHAN)\
     fetch_source(mach, VAL, &inst->Src[INDEX], CHAN, TGSI_EXEC_DATA_FLOAT)
 
@@ -2066,7 +2114,7 @@ exec_kill_if(struct tgsi_exec_machine *mach,
       uniquemask |= 1 << swizzle;
 
       FETCH(&r[0], 0, chan_index);
-      for (i = 0; i < 4; i++)
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
          if (r[0].f[i] < 0.0f)
             kilmask |= 1 << i;
    }
@@ -2154,10 +2202,10 @@ conditional_emit_primitive(struct tgsi_exec_machine *mach)
 
 
 /*
- * Fetch four texture samples using STR texture coordinates.
+ * Fetch texture samples using STR texture coordinates, one quad at a time.
  */
 static void
-fetch_texel( struct tgsi_sampler *sampler,
+fetch_texel( const struct tgsi_exec_machine *mach,
              const unsigned sview_idx,
              const unsigned sampler_idx,
              const union tgsi_exec_channel *s,
@@ -2165,7 +2213,7 @@ fetch_texel( struct tgsi_sampler *sampler,
              const union tgsi_exec_channel *p,
              const union tgsi_exec_channel *c0,
              const union tgsi_exec_channel *c1,
-             float derivs[3][2][TGSI_QUAD_SIZE],
+             float derivs[3][2][TGSI_EXEC_WIDTH],
              const int8_t offset[3],
              enum tgsi_sampler_control control,
              union tgsi_exec_channel *r,
@@ -2173,18 +2221,35 @@ fetch_texel( struct tgsi_sampler *sampler,
              union tgsi_exec_channel *b,
              union tgsi_exec_channel *a )
 {
-   uint j;
+   struct tgsi_sampler *sampler = mach->Sampler;
+   uint q, i, j;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
+   float quad_derivs[3][2][TGSI_QUAD_SIZE];
 
-   /* FIXME: handle explicit derivs, offsets */
-   sampler->get_samples(sampler, sview_idx, sampler_idx,
-                        s->f, t->f, p->f, c0->f, c1->f, derivs, offset, control, rgba);
+   for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+      /* skip quads with no active pixel */
+      if (!((mach->ExecMask >> q) & 0xf))
+         continue;
+
+      if (derivs) {
+         for (i = 0; i < 3; i++)
+            for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+               quad_derivs[i][0][j] = derivs[i][0][q + j];
+               quad_derivs[i][1][j] = derivs[i][1][q + j];
+            }
+      }
 
-   for (j = 0; j < 4; j++) {
-      r->f[j] = rgba[0][j];
-      g->f[j] = rgba[1][j];
-      b->f[j] = rgba[2][j];
-      a->f[j] = rgba[3][j];
+      /* FIXME: handle explicit derivs, offsets */
+      sampler->get_samples(sampler, sview_idx, sampler_idx,
+                           s->f + q, t->f + q, p->f + q, c0->f + q, c1->f + q,
+                           derivs ? quad_derivs : NULL, offset, control, rgba);
+
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r->f[q + j] = rgba[0][j];
+         g->f[q + j] = rgba[1][j];
+         b->f[q + j] = rgba[2][j];
+         a->f[q + j] = rgba[3][j];
+      }
    }
 }
 
@@ -2204,10 +2269,13 @@ fetch_texel_offsets(struct tgsi_exec_machine *mach,
                     const struct tgsi_full_instruction *inst,
                     int8_t offsets[3])
 {
+   unsigned i;
+
    if (inst->Texture.NumOffsets == 1) {
       union tgsi_exec_channel index;
       union tgsi_exec_channel offset[3];
-      index.i[0] = index.i[1] = index.i[2] = index.i[3] = inst->TexOffsets[0].Index;
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+         index.i[i] = inst->TexOffsets[0].Index;
       fetch_src_file_channel(mach, inst->TexOffsets[0].File,
                              inst->TexOffsets[0].SwizzleX, &index, &ZeroVec, &offset[0]);
       fetch_src_file_channel(mach, inst->TexOffsets[0].File,
@@ -2233,19 +2301,13 @@ fetch_assign_deriv_channel(struct tgsi_exec_machine *mach,
                            const struct tgsi_full_instruction *inst,
                            unsigned regdsrcx,
                            unsigned chan,
-                           float derivs[2][TGSI_QUAD_SIZE])
+                           float derivs[2][TGSI_EXEC_WIDTH])
 {
    union tgsi_exec_channel d;
    FETCH(&d, regdsrcx, chan);
-   derivs[0][0] = d.f[0];
-   derivs[0][1] = d.f[1];
-   derivs[0][2] = d.f[2];
-   derivs[0][3] = d.f[3];
+   memcpy(derivs[0], d.f, sizeof(derivs[0]));
    FETCH(&d, regdsrcx + 1, chan);
-   derivs[1][0] = d.f[0];
-   derivs[1][1] = d.f[1];
-   derivs[1][2] = d.f[2];
-   derivs[1][3] = d.f[3];
+   memcpy(derivs[1], d.f, sizeof(derivs[1]));
 }
 
 static uint
@@ -2259,10 +2321,8 @@ fetch_sampler_unit(struct tgsi_exec_machine *mach,
       const struct tgsi_full_src_register *reg = &inst->Src[sampler];
       union tgsi_exec_channel indir_index, index2;
       const uint execmask = mach->ExecMask;
-      index2.i[0] =
-      index2.i[1] =
-      index2.i[2] =
-      index2.i[3] = reg->Indirect.Index;
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+         index2.i[i] = reg->Indirect.Index;
 
       fetch_src_file_channel(mach,
                              reg->Indirect.File,
@@ -2270,7 +2330,7 @@ fetch_sampler_unit(struct tgsi_exec_machine *mach,
                              &index2,
                              &ZeroVec,
                              &indir_index);
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
          if (execmask & (1 << i)) {
             unit = inst->Src[sampler].Register.Index + indir_index.i[i];
             break;
@@ -2374,7 +2434,7 @@ exec_tex(struct tgsi_exec_machine *mach,
       args[shadow_ref] = &r[shadow_ref];
    }
 
-   fetch_texel(mach->Sampler, unit, unit,
+   fetch_texel(mach, unit, unit,
          args[0], args[1], args[2], args[3], args[4],
          NULL, offsets, control,
          &r[0], &r[1], &r[2], &r[3]);     /* R, G, B, A */
@@ -2403,7 +2463,7 @@ exec_lodq(struct tgsi_exec_machine *mach,
 {
    uint resource_unit, sampler_unit;
    unsigned dim;
-   unsigned i;
+   unsigned i, q;
    union tgsi_exec_channel coords[4];
    const union tgsi_exec_channel *args[ARRAY_SIZE(coords)];
    union tgsi_exec_channel r[2];
@@ -2426,14 +2486,18 @@ exec_lodq(struct tgsi_exec_machine *mach,
    for (i = dim; i < ARRAY_SIZE(coords); i++) {
       args[i] = &ZeroVec;
    }
-   mach->Sampler->query_lod(mach->Sampler, resource_unit, sampler_unit,
-                            args[0]->f,
-                            args[1]->f,
-                            args[2]->f,
-                            args[3]->f,
-                            TGSI_SAMPLER_LOD_NONE,
-                            r[0].f,
-                            r[1].f);
+   for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+      if (!((mach->ExecMask >> q) & 0xf))
+         continue;
+      mach->Sampler->query_lod(mach->Sampler, resource_unit, sampler_unit,
+                               args[0]->f + q,
+                               args[1]->f + q,
+                               args[2]->f + q,
+                               args[3]->f + q,
+                               TGSI_SAMPLER_LOD_NONE,
+                               r[0].f + q,
+                               r[1].f + q);
+   }
 
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
       store_dest(mach, &r[0], &inst->Dst[0], inst, TGSI_CHAN_X,
@@ -2479,7 +2543,7 @@ exec_txd(struct tgsi_exec_machine *mach,
          const struct tgsi_full_instruction *inst)
 {
    union tgsi_exec_channel r[4];
-   float derivs[3][2][TGSI_QUAD_SIZE];
+   float derivs[3][2][TGSI_EXEC_WIDTH];
    uint chan;
    uint unit;
    int8_t offsets[3];
@@ -2494,7 +2558,7 @@ exec_txd(struct tgsi_exec_machine *mach,
 
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &ZeroVec, &ZeroVec, &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -2510,7 +2574,7 @@ exec_txd(struct tgsi_exec_machine *mach,
 
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &r[1], &r[2], &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -2524,7 +2588,7 @@ exec_txd(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Y, derivs[1]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &r[1], &ZeroVec, &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -2544,7 +2608,7 @@ exec_txd(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Y, derivs[1]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &r[1], &r[2], &r[3], &ZeroVec,   /* inputs */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);     /* outputs */
@@ -2564,7 +2628,7 @@ exec_txd(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Y, derivs[1]);
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Z, derivs[2]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &r[1], &r[2], &r[3], &ZeroVec,   /* inputs */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);     /* outputs */
@@ -2591,6 +2655,7 @@ exec_txf(struct tgsi_exec_machine *mach,
    uint unit;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    int j;
+   uint q;
    int8_t offsets[3];
    unsigned target;
 
@@ -2633,14 +2698,20 @@ exec_txf(struct tgsi_exec_machine *mach,
       break;
    }      
 
-   mach->Sampler->get_texel(mach->Sampler, unit, r[0].i, r[1].i, r[2].i, r[3].i,
-                            offsets, rgba);
+   for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+      if (!((mach->ExecMask >> q) & 0xf))
+         continue;
+
+      mach->Sampler->get_texel(mach->Sampler, unit,
+                               r[0].i + q, r[1].i + q, r[2].i + q, r[3].i + q,
+                               offsets, rgba);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
 
    if (inst->Instruction.Opcode == TGSI_OPCODE_SAMPLE_I ||
@@ -2684,7 +2755,7 @@ exec_txq(struct tgsi_exec_machine *mach,
    /* XXX: This interface can't return per-pixel values */
    mach->Sampler->get_dims(mach->Sampler, unit, src.i[0], result);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
       for (j = 0; j < 4; j++) {
          r[j].i[i] = result[j];
       }
@@ -2743,13 +2814,13 @@ exec_sample(struct tgsi_exec_machine *mach,
    case TGSI_TEXTURE_1D:
       if (compare) {
          FETCH(&r[2], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &ZeroVec, &r[2], &ZeroVec, lod, /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);     /* R, G, B, A */
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &ZeroVec, &ZeroVec, &ZeroVec, lod, /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);     /* R, G, B, A */
@@ -2762,13 +2833,13 @@ exec_sample(struct tgsi_exec_machine *mach,
       FETCH(&r[1], 0, TGSI_CHAN_Y);
       if (compare) {
          FETCH(&r[2], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &ZeroVec, lod,    /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);  /* outputs */
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &ZeroVec, &ZeroVec, lod,    /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);  /* outputs */
@@ -2782,13 +2853,13 @@ exec_sample(struct tgsi_exec_machine *mach,
       FETCH(&r[2], 0, TGSI_CHAN_Z);
       if(compare) {
          FETCH(&r[3], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &r[3], lod,
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &ZeroVec, lod,
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
@@ -2801,13 +2872,13 @@ exec_sample(struct tgsi_exec_machine *mach,
       FETCH(&r[3], 0, TGSI_CHAN_W);
       if(compare) {
          FETCH(&r[4], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &r[3], &r[4],
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &r[3], lod,
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
@@ -2839,7 +2910,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
    const uint resource_unit = inst->Src[1].Register.Index;
    const uint sampler_unit = inst->Src[2].Register.Index;
    union tgsi_exec_channel r[4];
-   float derivs[3][2][TGSI_QUAD_SIZE];
+   float derivs[3][2][TGSI_EXEC_WIDTH];
    uint chan;
    unsigned char swizzles[4];
    int8_t offsets[3];
@@ -2857,7 +2928,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
 
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_X, derivs[0]);
 
-      fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+      fetch_texel(mach, resource_unit, sampler_unit,
                   &r[0], &r[1], &ZeroVec, &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -2873,7 +2944,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_X, derivs[0]);
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_Y, derivs[1]);
 
-      fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+      fetch_texel(mach, resource_unit, sampler_unit,
                   &r[0], &r[1], &r[2], &ZeroVec, &ZeroVec,   /* inputs */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);     /* outputs */
@@ -2891,7 +2962,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_Y, derivs[1]);
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_Z, derivs[2]);
 
-      fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+      fetch_texel(mach, resource_unit, sampler_unit,
                   &r[0], &r[1], &r[2], &r[3], &ZeroVec,
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);
@@ -2927,7 +2998,7 @@ eval_constant_coef(
 {
    unsigned i;
 
-   for( i = 0; i < TGSI_QUAD_SIZE; i++ ) {
+   for( i = 0; i < TGSI_EXEC_WIDTH; i++ ) {
       mach->Inputs[attrib].xyzw[chan].f[i] = mach->InterpCoefs[attrib].a0[chan];
    }
 }
@@ -2945,7 +3016,7 @@ interp_constant_offset(
 
 /**
  * Evaluate a linear-valued coefficient at the position of the
- * current quad.
+ * current quads.
  */
 static void
 interp_linear_offset(
@@ -2959,10 +3030,9 @@ interp_linear_offset(
    const float dadx = mach->InterpCoefs[attrib].dadx[chan];
    const float dady = mach->InterpCoefs[attrib].dady[chan];
    const float delta = ofs_x * dadx + ofs_y * dady;
-   out_chan->f[0] += delta;
-   out_chan->f[1] += delta;
-   out_chan->f[2] += delta;
-   out_chan->f[3] += delta;
+   unsigned i;
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      out_chan->f[i] += delta;
 }
 
 static void
@@ -2970,16 +3040,21 @@ eval_linear_coef(struct tgsi_exec_machine *mach,
                  unsigned attrib,
                  unsigned chan)
 {
-   const float x = mach->QuadPos.xyzw[0].f[0];
-   const float y = mach->QuadPos.xyzw[1].f[0];
    const float dadx = mach->InterpCoefs[attrib].dadx[chan];
    const float dady = mach->InterpCoefs[attrib].dady[chan];
-   const float a0 = mach->InterpCoefs[attrib].a0[chan] + dadx * x + dady * y;
+   float *dst = mach->Inputs[attrib].xyzw[chan].f;
+   unsigned q;
+
+   for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+      const float x = mach->QuadPos.xyzw[0].f[q];
+      const float y = mach->QuadPos.xyzw[1].f[q];
+      const float a0 = mach->InterpCoefs[attrib].a0[chan] + dadx * x + dady * y;
 
-   mach->Inputs[attrib].xyzw[chan].f[0] = a0;
-   mach->Inputs[attrib].xyzw[chan].f[1] = a0 + dadx;
-   mach->Inputs[attrib].xyzw[chan].f[2] = a0 + dady;
-   mach->Inputs[attrib].xyzw[chan].f[3] = a0 + dadx + dady;
+      dst[q + 0] = a0;
+      dst[q + 1] = a0 + dadx;
+      dst[q + 2] = a0 + dady;
+      dst[q + 3] = a0 + dadx + dady;
+   }
 }
 
 /**
@@ -3000,10 +3075,9 @@ interp_perspective_offset(
    const float dady = mach->InterpCoefs[attrib].dady[chan];
    const float *w = mach->QuadPos.xyzw[3].f;
    const float delta = ofs_x * dadx + ofs_y * dady;
-   out_chan->f[0] += delta / w[0];
-   out_chan->f[1] += delta / w[1];
-   out_chan->f[2] += delta / w[2];
-   out_chan->f[3] += delta / w[3];
+   unsigned i;
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      out_chan->f[i] += delta / w[i];
 }
 
 static void
@@ -3012,17 +3086,23 @@ eval_perspective_coef(
    unsigned attrib,
    unsigned chan )
 {
-   const float x = mach->QuadPos.xyzw[0].f[0];
-   const float y = mach->QuadPos.xyzw[1].f[0];
    const float dadx = mach->InterpCoefs[attrib].dadx[chan];
    const float dady = mach->InterpCoefs[attrib].dady[chan];
-   const float a0 = mach->InterpCoefs[attrib].a0[chan] + dadx * x + dady * y;
    const float *w = mach->QuadPos.xyzw[3].f;
-   /* divide by W here */
-   mach->Inputs[attrib].xyzw[chan].f[0] = a0 / w[0];
-   mach->Inputs[attrib].xyzw[chan].f[1] = (a0 + dadx) / w[1];
-   mach->Inputs[attrib].xyzw[chan].f[2] = (a0 + dady) / w[2];
-   mach->Inputs[attrib].xyzw[chan].f[3] = (a0 + dadx + dady) / w[3];
+   float *dst = mach->Inputs[attrib].xyzw[chan].f;
+   unsigned q;
+
+   for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+      const float x = mach->QuadPos.xyzw[0].f[q];
+      const float y = mach->QuadPos.xyzw[1].f[q];
+      const float a0 = mach->InterpCoefs[attrib].a0[chan] + dadx * x + dady * y;
+
+      /* divide by W here */
+      dst[q + 0] = a0 / w[q + 0];
+      dst[q + 1] = (a0 + dadx) / w[q + 1];
+      dst[q + 2] = (a0 + dady) / w[q + 2];
+      dst[q + 3] = (a0 + dadx + dady) / w[q + 3];
+   }
 }
 
 
@@ -3061,7 +3141,7 @@ exec_declaration(struct tgsi_exec_machine *mach,
             assert(decl->Semantic.Index == 0);
             assert(first == last);
 
-            for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+            for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
                mach->Inputs[first].xyzw[0].f[i] = mach->Face;
             }
          } else {
@@ -3371,7 +3451,7 @@ exec_pk2h(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-   for (chan = 0; chan < TGSI_QUAD_SIZE; chan++) {
+   for (chan = 0; chan < TGSI_EXEC_WIDTH; chan++) {
       dst.u[chan] = util_float_to_half(arg[0].f[chan]) |
          (util_float_to_half(arg[1].f[chan]) << 16);
    }
@@ -3390,7 +3470,7 @@ exec_up2h(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel arg, dst[2];
 
    fetch_source(mach, &arg, &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_UINT);
-   for (chan = 0; chan < TGSI_QUAD_SIZE; chan++) {
+   for (chan = 0; chan < TGSI_EXEC_WIDTH; chan++) {
       dst[0].f[chan] = util_half_to_float(arg.u[chan] & 0xffff);
       dst[1].f[chan] = util_half_to_float(arg.u[chan] >> 16);
    }
@@ -3407,10 +3487,10 @@ micro_ucmp(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src1,
            const union tgsi_exec_channel *src2)
 {
-   dst->f[0] = src0->u[0] ? src1->f[0] : src2->f[0];
-   dst->f[1] = src0->u[1] ? src1->f[1] : src2->f[1];
-   dst->f[2] = src0->u[2] ? src1->f[2] : src2->f[2];
-   dst->f[3] = src0->u[3] ? src1->f[3] : src2->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = src0->u[i] ? src1->f[i] : src2->f[i];
 }
 
 static void
@@ -3461,7 +3541,7 @@ exec_dst(struct tgsi_exec_machine *mach,
    }
 
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
-      store_dest(mach, &OneVec, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
+      store_dest(mach, ONE_VEC(mach), &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
       store_dest(mach, &d[TGSI_CHAN_Y], &inst->Dst[0], inst, TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
@@ -3496,7 +3576,7 @@ exec_log(struct tgsi_exec_machine *mach,
       store_dest(mach, &r[1], &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_W) {
-      store_dest(mach, &OneVec, &inst->Dst[0], inst, TGSI_CHAN_W, TGSI_EXEC_DATA_FLOAT);
+      store_dest(mach, ONE_VEC(mach), &inst->Dst[0], inst, TGSI_CHAN_W, TGSI_EXEC_DATA_FLOAT);
    }
 }
 
@@ -3521,7 +3601,7 @@ exec_exp(struct tgsi_exec_machine *mach,
       store_dest(mach, &r[2], &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_W) {
-      store_dest(mach, &OneVec, &inst->Dst[0], inst, TGSI_CHAN_W, TGSI_EXEC_DATA_FLOAT);
+      store_dest(mach, ONE_VEC(mach), &inst->Dst[0], inst, TGSI_CHAN_W, TGSI_EXEC_DATA_FLOAT);
    }
 }
 
@@ -3539,8 +3619,8 @@ exec_lit(struct tgsi_exec_machine *mach,
          micro_max(&r[1], &r[1], &ZeroVec);
 
          fetch_source(mach, &r[2], &inst->Src[0], TGSI_CHAN_W, TGSI_EXEC_DATA_FLOAT);
-         micro_min(&r[2], &r[2], &P128Vec);
-         micro_max(&r[2], &r[2], &M128Vec);
+         micro_min(&r[2], &r[2], P128_VEC(mach));
+         micro_max(&r[2], &r[2], M128_VEC(mach));
          micro_pow(&r[1], &r[1], &r[2]);
          micro_lt(&d[TGSI_CHAN_Z], &ZeroVec, &r[0], &r[1], &ZeroVec);
          store_dest(mach, &d[TGSI_CHAN_Z], &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
@@ -3551,11 +3631,11 @@ exec_lit(struct tgsi_exec_machine *mach,
       }
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
-      store_dest(mach, &OneVec, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
+      store_dest(mach, ONE_VEC(mach), &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    }
 
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_W) {
-      store_dest(mach, &OneVec, &inst->Dst[0], inst, TGSI_CHAN_W, TGSI_EXEC_DATA_FLOAT);
+      store_dest(mach, ONE_VEC(mach), &inst->Dst[0], inst, TGSI_CHAN_W, TGSI_EXEC_DATA_FLOAT);
    }
 }
 
@@ -3601,20 +3681,13 @@ exec_case(struct tgsi_exec_machine *mach,
    uint prevMask = mach->SwitchStack[mach->SwitchStackTop - 1].mask;
    union tgsi_exec_channel src;
    uint mask = 0;
+   uint i;
 
    fetch_source(mach, &src, &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_UINT);
 
-   if (mach->Switch.selector.u[0] == src.u[0]) {
-      mask |= 0x1;
-   }
-   if (mach->Switch.selector.u[1] == src.u[1]) {
-      mask |= 0x2;
-   }
-   if (mach->Switch.selector.u[2] == src.u[2]) {
-      mask |= 0x4;
-   }
-   if (mach->Switch.selector.u[3] == src.u[3]) {
-      mask |= 0x8;
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
+      if (mach->Switch.selector.u[i] == src.u[i])
+         mask |= 1 << i;
    }
 
    mach->Switch.defaultMask |= mask;
@@ -3670,7 +3743,7 @@ fetch_double_channel(struct tgsi_exec_machine *mach,
    fetch_source_d(mach, &src[0], reg, chan_0);
    fetch_source_d(mach, &src[1], reg, chan_1);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
       chan->u[i][0] = src[0].u[i];
       chan->u[i][1] = src[1].u[i];
    }
@@ -3696,14 +3769,14 @@ store_double_channel(struct tgsi_exec_machine *mach,
    const uint execmask = mach->ExecMask;
 
    if (!inst->Instruction.Saturate) {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
          if (execmask & (1 << i)) {
             dst[0].u[i] = chan->u[i][0];
             dst[1].u[i] = chan->u[i][1];
          }
    }
    else {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
          if (execmask & (1 << i)) {
             if (chan->d[i] < 0.0)
                temp.d[i] = 0.0;
@@ -3936,17 +4009,18 @@ exec_load_img(struct tgsi_exec_machine *mach,
    int sample;
    int i, j;
    int dim;
-   uint chan;
+   uint chan, q;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_image_params params;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
+   uint execmask;
 
    unit = fetch_sampler_unit(mach, inst, 0);
    dim = get_image_coord_dim(inst->Memory.Texture);
    sample = get_image_coord_sample(inst->Memory.Texture);
    assert(dim <= 3);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.tgsi_tex_instr = inst->Memory.Texture;
    params.format = inst->Memory.Format;
@@ -3958,14 +4032,20 @@ exec_load_img(struct tgsi_exec_machine *mach,
    if (sample)
       IFETCH(&sample_r, 1, TGSI_CHAN_X + sample);
 
-   mach->Image->load(mach->Image, &params,
-                     r[0].i, r[1].i, r[2].i, sample_r.i,
-                     rgba);
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+   for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
+      if (!params.execmask)
+         continue;
+
+      mach->Image->load(mach->Image, &params,
+                        r[0].i + q, r[1].i + q, r[2].i + q, sample_r.i + q,
+                        rgba);
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -3981,24 +4061,31 @@ exec_load_buf(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel r[4];
    uint unit;
    int j;
-   uint chan;
+   uint chan, q;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_buffer_params params;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
+   uint execmask;
 
    unit = fetch_sampler_unit(mach, inst, 0);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    IFETCH(&r[0], 1, TGSI_CHAN_X);
 
-   mach->Buffer->load(mach->Buffer, &params,
-                      r[0].i, rgba);
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+   for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
+      if (!params.execmask)
+         continue;
+
+      mach->Buffer->load(mach->Buffer, &params,
+                         r[0].i + q, rgba);
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -4013,21 +4100,21 @@ exec_load_mem(struct tgsi_exec_machine *mach,
 {
    union tgsi_exec_channel r[4];
    uint chan;
-   char *ptr = mach->LocalMem;
+   const char *ptr = mach->LocalMem;
    uint32_t offset;
    int j;
 
    IFETCH(&r[0], 1, TGSI_CHAN_X);
-   if (r[0].u[0] >= mach->LocalMemSize)
-      return;
-
-   offset = r[0].u[0];
-   ptr += offset;
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+   /* each lane loads from its own address */
+   for (j = 0; j < TGSI_EXEC_WIDTH; j++) {
+      offset = r[0].u[j];
       for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
          if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
-            memcpy(&r[chan].u[j], ptr + (4 * chan), 4);
+            if (offset < mach->LocalMemSize)
+               memcpy(&r[chan].u[j], ptr + offset + (4 * chan), 4);
+            else
+               r[chan].u[j] = 0;
          }
       }
    }
@@ -4060,10 +4147,8 @@ fetch_store_img_unit(struct tgsi_exec_machine *mach,
    if (dst->Register.Indirect) {
       union tgsi_exec_channel indir_index, index2;
       const uint execmask = mach->ExecMask;
-      index2.i[0] =
-      index2.i[1] =
-      index2.i[2] =
-      index2.i[3] = dst->Indirect.Index;
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+         index2.i[i] = dst->Indirect.Index;
 
       fetch_src_file_channel(mach,
                              dst->Indirect.File,
@@ -4094,14 +4179,15 @@ exec_store_img(struct tgsi_exec_machine *mach,
    int dim;
    int sample;
    int i, j;
-   uint unit;
+   uint unit, q;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
+   uint execmask;
    unit = fetch_store_img_unit(mach, &inst->Dst[0]);
    dim = get_image_coord_dim(inst->Memory.Texture);
    sample = get_image_coord_sample(inst->Memory.Texture);
    assert(dim <= 3);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.tgsi_tex_instr = inst->Memory.Texture;
    params.format = inst->Memory.Format;
@@ -4116,16 +4202,22 @@ exec_store_img(struct tgsi_exec_machine *mach,
    if (sample)
       IFETCH(&sample_r, 0, TGSI_CHAN_X + sample);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
+   for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
+      if (!params.execmask)
+         continue;
+
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
 
-   mach->Image->store(mach->Image, &params,
-                      r[0].i, r[1].i, r[2].i, sample_r.i,
-                      rgba);
+      mach->Image->store(mach->Image, &params,
+                         r[0].i + q, r[1].i + q, r[2].i + q, sample_r.i + q,
+                         rgba);
+   }
 }
 
 static void
@@ -4137,12 +4229,13 @@ exec_store_buf(struct tgsi_exec_machine *mach,
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_buffer_params params;
    int i, j;
-   uint unit;
+   uint unit, q;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
+   uint execmask;
 
    unit = fetch_store_img_unit(mach, &inst->Dst[0]);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.writemask = inst->Dst[0].Register.WriteMask;
 
@@ -4151,16 +4244,22 @@ exec_store_buf(struct tgsi_exec_machine *mach,
       FETCH(&value[i], 1, TGSI_CHAN_X + i);
    }
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
+   for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
+      if (!params.execmask)
+         continue;
 
-   mach->Buffer->store(mach->Buffer, &params,
-                      r[0].i,
-                      rgba);
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
+
+      mach->Buffer->store(mach->Buffer, &params,
+                          r[0].i + q,
+                          rgba);
+   }
 }
 
 static void
@@ -4180,15 +4279,12 @@ exec_store_mem(struct tgsi_exec_machine *mach,
       FETCH(&value[i], 1, TGSI_CHAN_X + i);
    }
 
-   if (r[0].u[0] >= mach->LocalMemSize)
-      return;
-   ptr += r[0].u[0];
-
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
-      if (execmask & (1 << i)) {
+   /* each lane stores to its own address */
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
+      if ((execmask & (1 << i)) && r[0].u[i] < mach->LocalMemSize) {
          for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
             if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
-               memcpy(ptr + (chan * 4), &value[chan].u[0], 4);
+               memcpy(ptr + r[0].u[i] + (chan * 4), &value[chan].u[i], 4);
             }
          }
       }
@@ -4219,14 +4315,15 @@ exec_atomop_img(struct tgsi_exec_machine *mach,
    int dim;
    int sample;
    int i, j;
-   uint unit, chan;
+   uint unit, chan, q;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
+   uint execmask;
    unit = fetch_sampler_unit(mach, inst, 0);
    dim = get_image_coord_dim(inst->Memory.Texture);
    sample = get_image_coord_sample(inst->Memory.Texture);
    assert(dim <= 3);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.tgsi_tex_instr = inst->Memory.Texture;
    params.format = inst->Memory.Format;
@@ -4243,30 +4340,36 @@ exec_atomop_img(struct tgsi_exec_machine *mach,
    if (sample)
       IFETCH(&sample_r, 1, TGSI_CHAN_X + sample);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
-   if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+   for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
+      if (!params.execmask)
+         continue;
+
       for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-         rgba2[0][j] = value2[0].f[j];
-         rgba2[1][j] = value2[1].f[j];
-         rgba2[2][j] = value2[2].f[j];
-         rgba2[3][j] = value2[3].f[j];
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
+      if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+            rgba2[0][j] = value2[0].f[q + j];
+            rgba2[1][j] = value2[1].f[q + j];
+            rgba2[2][j] = value2[2].f[q + j];
+            rgba2[3][j] = value2[3].f[q + j];
+         }
       }
-   }
 
-   mach->Image->op(mach->Image, &params, inst->Instruction.Opcode,
-                   r[0].i, r[1].i, r[2].i, sample_r.i,
-                   rgba, rgba2);
+      mach->Image->op(mach->Image, &params, inst->Instruction.Opcode,
+                      r[0].i + q, r[1].i + q, r[2].i + q, sample_r.i + q,
+                      rgba, rgba2);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -4285,12 +4388,13 @@ exec_atomop_buf(struct tgsi_exec_machine *mach,
    float rgba2[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_buffer_params params;
    int i, j;
-   uint unit, chan;
+   uint unit, chan, q;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
+   uint execmask;
 
    unit = fetch_sampler_unit(mach, inst, 0);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.writemask = inst->Dst[0].Register.WriteMask;
 
@@ -4302,30 +4406,36 @@ exec_atomop_buf(struct tgsi_exec_machine *mach,
          FETCH(&value2[i], 3, TGSI_CHAN_X + i);
    }
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
-   if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+   for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
+      if (!params.execmask)
+         continue;
+
       for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-         rgba2[0][j] = value2[0].f[j];
-         rgba2[1][j] = value2[1].f[j];
-         rgba2[2][j] = value2[2].f[j];
-         rgba2[3][j] = value2[3].f[j];
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
+      if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+            rgba2[0][j] = value2[0].f[q + j];
+            rgba2[1][j] = value2[1].f[q + j];
+            rgba2[2][j] = value2[2].f[q + j];
+            rgba2[3][j] = value2[3].f[q + j];
+         }
       }
-   }
 
-   mach->Buffer->op(mach->Buffer, &params, inst->Instruction.Opcode,
-                   r[0].i,
-                   rgba, rgba2);
+      mach->Buffer->op(mach->Buffer, &params, inst->Instruction.Opcode,
+                       r[0].i + q,
+                       rgba, rgba2);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -4343,65 +4453,69 @@ exec_atomop_mem(struct tgsi_exec_machine *mach,
    char *ptr = mach->LocalMem;
    uint32_t val;
    uint chan, i;
-   uint32_t offset;
+   union tgsi_exec_channel addr;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
    int execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
-   IFETCH(&r[0], 1, TGSI_CHAN_X);
+   IFETCH(&addr, 1, TGSI_CHAN_X);
 
-   if (r[0].u[0] >= mach->LocalMemSize)
-      return;
-
-   offset = r[0].u[0];
-   ptr += offset;
    for (i = 0; i < 4; i++) {
       FETCH(&value[i], 2, TGSI_CHAN_X + i);
       if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS)
          FETCH(&value2[i], 3, TGSI_CHAN_X + i);
    }
 
-   memcpy(&r[0].u[0], ptr, 4);
-   val = r[0].u[0];
-   switch (inst->Instruction.Opcode) {
-   case TGSI_OPCODE_ATOMUADD:
-      val += value[0].u[0];
-      break;
-   case TGSI_OPCODE_ATOMXOR:
-      val ^= value[0].u[0];
-      break;
-   case TGSI_OPCODE_ATOMOR:
-      val |= value[0].u[0];
-      break;
-   case TGSI_OPCODE_ATOMAND:
-      val &= value[0].u[0];
-      break;
-   case TGSI_OPCODE_ATOMUMIN:
-      val = MIN2(val, value[0].u[0]);
-      break;
-   case TGSI_OPCODE_ATOMUMAX:
-      val = MAX2(val, value[0].u[0]);
-      break;
-   case TGSI_OPCODE_ATOMIMIN:
-      val = MIN2(r[0].i[0], value[0].i[0]);
-      break;
-   case TGSI_OPCODE_ATOMIMAX:
-      val = MAX2(r[0].i[0], value[0].i[0]);
-      break;
-   case TGSI_OPCODE_ATOMXCHG:
-      val = value[0].i[0];
-      break;
-   case TGSI_OPCODE_ATOMCAS:
-      if (val == value[0].u[0])
-         val = value2[0].u[0];
-      break;
-   case TGSI_OPCODE_ATOMFADD:
-      val = fui(r[0].f[0] + value[0].f[0]);
-      break;
-   default:
-      break;
+   /* the lanes are done in order, each one sees the result of the previous */
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
+      if (addr.u[i] >= mach->LocalMemSize) {
+         r[0].u[i] = 0;
+         continue;
+      }
+
+      memcpy(&r[0].u[i], ptr + addr.u[i], 4);
+      if (!(execmask & (1 << i)))
+         continue;
+
+      val = r[0].u[i];
+      switch (inst->Instruction.Opcode) {
+      case TGSI_OPCODE_ATOMUADD:
+         val += value[0].u[i];
+         break;
+      case TGSI_OPCODE_ATOMXOR:
+         val ^= value[0].u[i];
+         break;
+      case TGSI_OPCODE_ATOMOR:
+         val |= value[0].u[i];
+         break;
+      case TGSI_OPCODE_ATOMAND:
+         val &= value[0].u[i];
+         break;
+      case TGSI_OPCODE_ATOMUMIN:
+         val = MIN2(val, value[0].u[i]);
+         break;
+      case TGSI_OPCODE_ATOMUMAX:
+         val = MAX2(val, value[0].u[i]);
+         break;
+      case TGSI_OPCODE_ATOMIMIN:
+         val = MIN2(r[0].i[i], value[0].i[i]);
+         break;
+      case TGSI_OPCODE_ATOMIMAX:
+         val = MAX2(r[0].i[i], value[0].i[i]);
+         break;
+      case TGSI_OPCODE_ATOMXCHG:
+         val = value[0].i[i];
+         break;
+      case TGSI_OPCODE_ATOMCAS:
+         if (val == value[0].u[i])
+            val = value2[0].u[i];
+         break;
+      case TGSI_OPCODE_ATOMFADD:
+         val = fui(r[0].f[i] + value[0].f[i]);
+         break;
+      default:
+         break;
+      }
+      memcpy(ptr + addr.u[i], &val, 4);
    }
-   for (i = 0; i < TGSI_QUAD_SIZE; i++)
-      if (execmask & (1 << i))
-         memcpy(ptr, &val, 4);
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -4442,7 +4556,7 @@ exec_resq_img(struct tgsi_exec_machine *mach,
 
    mach->Image->get_dims(mach->Image, &params, result);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
       for (j = 0; j < 4; j++) {
          r[j].i[i] = result[j];
       }
@@ -4474,7 +4588,7 @@ exec_resq_buf(struct tgsi_exec_machine *mach,
 
    mach->Buffer->get_dims(mach->Buffer, &params, &result);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
       r[0].i[i] = result;
    }
 
@@ -4500,100 +4614,100 @@ static void
 micro_f2u64(union tgsi_double_channel *dst,
             const union tgsi_exec_channel *src)
 {
-   dst->u64[0] = (uint64_t)src->f[0];
-   dst->u64[1] = (uint64_t)src->f[1];
-   dst->u64[2] = (uint64_t)src->f[2];
-   dst->u64[3] = (uint64_t)src->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u64[i] = (uint64_t)src->f[i];
 }
 
 static void
 micro_f2i64(union tgsi_double_channel *dst,
             const union tgsi_exec_channel *src)
 {
-   dst->i64[0] = (int64_t)src->f[0];
-   dst->i64[1] = (int64_t)src->f[1];
-   dst->i64[2] = (int64_t)src->f[2];
-   dst->i64[3] = (int64_t)src->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i64[i] = (int64_t)src->f[i];
 }
 
 static void
 micro_u2i64(union tgsi_double_channel *dst,
             const union tgsi_exec_channel *src)
 {
-   dst->u64[0] = (uint64_t)src->u[0];
-   dst->u64[1] = (uint64_t)src->u[1];
-   dst->u64[2] = (uint64_t)src->u[2];
-   dst->u64[3] = (uint64_t)src->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u64[i] = (uint64_t)src->u[i];
 }
 
 static void
 micro_i2i64(union tgsi_double_channel *dst,
             const union tgsi_exec_channel *src)
 {
-   dst->i64[0] = (int64_t)src->i[0];
-   dst->i64[1] = (int64_t)src->i[1];
-   dst->i64[2] = (int64_t)src->i[2];
-   dst->i64[3] = (int64_t)src->i[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i64[i] = (int64_t)src->i[i];
 }
 
 static void
 micro_d2u64(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u64[0] = (uint64_t)src->d[0];
-   dst->u64[1] = (uint64_t)src->d[1];
-   dst->u64[2] = (uint64_t)src->d[2];
-   dst->u64[3] = (uint64_t)src->d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u64[i] = (uint64_t)src->d[i];
 }
 
 static void
 micro_d2i64(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->i64[0] = (int64_t)src->d[0];
-   dst->i64[1] = (int64_t)src->d[1];
-   dst->i64[2] = (int64_t)src->d[2];
-   dst->i64[3] = (int64_t)src->d[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i64[i] = (int64_t)src->d[i];
 }
 
 static void
 micro_u642d(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = (double)src->u64[0];
-   dst->d[1] = (double)src->u64[1];
-   dst->d[2] = (double)src->u64[2];
-   dst->d[3] = (double)src->u64[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = (double)src->u64[i];
 }
 
 static void
 micro_i642d(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = (double)src->i64[0];
-   dst->d[1] = (double)src->i64[1];
-   dst->d[2] = (double)src->i64[2];
-   dst->d[3] = (double)src->i64[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->d[i] = (double)src->i64[i];
 }
 
 static void
 micro_u642f(union tgsi_exec_channel *dst,
             const union tgsi_double_channel *src)
 {
-   dst->f[0] = (float)src->u64[0];
-   dst->f[1] = (float)src->u64[1];
-   dst->f[2] = (float)src->u64[2];
-   dst->f[3] = (float)src->u64[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = (float)src->u64[i];
 }
 
 static void
 micro_i642f(union tgsi_exec_channel *dst,
             const union tgsi_double_channel *src)
 {
-   dst->f[0] = (float)src->i64[0];
-   dst->f[1] = (float)src->i64[1];
-   dst->f[2] = (float)src->i64[2];
-   dst->f[3] = (float)src->i64[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = (float)src->i64[i];
 }
 
 static void
@@ -4646,20 +4760,20 @@ static void
 micro_i2f(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = (float)src->i[0];
-   dst->f[1] = (float)src->i[1];
-   dst->f[2] = (float)src->i[2];
-   dst->f[3] = (float)src->i[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = (float)src->i[i];
 }
 
 static void
 micro_not(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->u[0] = ~src->u[0];
-   dst->u[1] = ~src->u[1];
-   dst->u[2] = ~src->u[2];
-   dst->u[3] = ~src->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = ~src->u[i];
 }
 
 static void
@@ -4668,14 +4782,11 @@ micro_shl(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x1f;
-   dst->u[0] = src0->u[0] << masked_count;
-   masked_count = src1->u[1] & 0x1f;
-   dst->u[1] = src0->u[1] << masked_count;
-   masked_count = src1->u[2] & 0x1f;
-   dst->u[2] = src0->u[2] << masked_count;
-   masked_count = src1->u[3] & 0x1f;
-   dst->u[3] = src0->u[3] << masked_count;
+   unsigned i;
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
+      masked_count = src1->u[i] & 0x1f;
+      dst->u[i] = src0->u[i] << masked_count;
+   }
 }
 
 static void
@@ -4683,10 +4794,10 @@ micro_and(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] & src1->u[0];
-   dst->u[1] = src0->u[1] & src1->u[1];
-   dst->u[2] = src0->u[2] & src1->u[2];
-   dst->u[3] = src0->u[3] & src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->u[i] & src1->u[i];
 }
 
 static void
@@ -4694,10 +4805,10 @@ micro_or(union tgsi_exec_channel *dst,
          const union tgsi_exec_channel *src0,
          const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] | src1->u[0];
-   dst->u[1] = src0->u[1] | src1->u[1];
-   dst->u[2] = src0->u[2] | src1->u[2];
-   dst->u[3] = src0->u[3] | src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->u[i] | src1->u[i];
 }
 
 static void
@@ -4705,10 +4816,10 @@ micro_xor(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] ^ src1->u[0];
-   dst->u[1] = src0->u[1] ^ src1->u[1];
-   dst->u[2] = src0->u[2] ^ src1->u[2];
-   dst->u[3] = src0->u[3] ^ src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->u[i] ^ src1->u[i];
 }
 
 static void
@@ -4716,20 +4827,20 @@ micro_mod(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->i[0] = src1->i[0] ? src0->i[0] % src1->i[0] : ~0;
-   dst->i[1] = src1->i[1] ? src0->i[1] % src1->i[1] : ~0;
-   dst->i[2] = src1->i[2] ? src0->i[2] % src1->i[2] : ~0;
-   dst->i[3] = src1->i[3] ? src0->i[3] % src1->i[3] : ~0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = src1->i[i] ? src0->i[i] % src1->i[i] : ~0;
 }
 
 static void
 micro_f2i(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->i[0] = (int)src->f[0];
-   dst->i[1] = (int)src->f[1];
-   dst->i[2] = (int)src->f[2];
-   dst->i[3] = (int)src->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = (int)src->f[i];
 }
 
 static void
@@ -4737,10 +4848,10 @@ micro_fseq(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->f[0] == src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] == src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] == src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] == src1->f[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->f[i] == src1->f[i] ? ~0 : 0;
 }
 
 static void
@@ -4748,10 +4859,10 @@ micro_fsge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->f[0] >= src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] >= src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] >= src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] >= src1->f[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->f[i] >= src1->f[i] ? ~0 : 0;
 }
 
 static void
@@ -4759,10 +4870,10 @@ micro_fslt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->f[0] < src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] < src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] < src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] < src1->f[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->f[i] < src1->f[i] ? ~0 : 0;
 }
 
 static void
@@ -4770,10 +4881,10 @@ micro_fsne(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->f[0] != src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] != src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] != src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] != src1->f[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->f[i] != src1->f[i] ? ~0 : 0;
 }
 
 static void
@@ -4781,10 +4892,10 @@ micro_idiv(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->i[0] = src1->i[0] ? src0->i[0] / src1->i[0] : 0;
-   dst->i[1] = src1->i[1] ? src0->i[1] / src1->i[1] : 0;
-   dst->i[2] = src1->i[2] ? src0->i[2] / src1->i[2] : 0;
-   dst->i[3] = src1->i[3] ? src0->i[3] / src1->i[3] : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = src1->i[i] ? src0->i[i] / src1->i[i] : 0;
 }
 
 static void
@@ -4792,10 +4903,10 @@ micro_imax(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->i[0] = src0->i[0] > src1->i[0] ? src0->i[0] : src1->i[0];
-   dst->i[1] = src0->i[1] > src1->i[1] ? src0->i[1] : src1->i[1];
-   dst->i[2] = src0->i[2] > src1->i[2] ? src0->i[2] : src1->i[2];
-   dst->i[3] = src0->i[3] > src1->i[3] ? src0->i[3] : src1->i[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = src0->i[i] > src1->i[i] ? src0->i[i] : src1->i[i];
 }
 
 static void
@@ -4803,10 +4914,10 @@ micro_imin(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->i[0] = src0->i[0] < src1->i[0] ? src0->i[0] : src1->i[0];
-   dst->i[1] = src0->i[1] < src1->i[1] ? src0->i[1] : src1->i[1];
-   dst->i[2] = src0->i[2] < src1->i[2] ? src0->i[2] : src1->i[2];
-   dst->i[3] = src0->i[3] < src1->i[3] ? src0->i[3] : src1->i[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = src0->i[i] < src1->i[i] ? src0->i[i] : src1->i[i];
 }
 
 static void
@@ -4814,10 +4925,10 @@ micro_isge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->i[0] = src0->i[0] >= src1->i[0] ? -1 : 0;
-   dst->i[1] = src0->i[1] >= src1->i[1] ? -1 : 0;
-   dst->i[2] = src0->i[2] >= src1->i[2] ? -1 : 0;
-   dst->i[3] = src0->i[3] >= src1->i[3] ? -1 : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = src0->i[i] >= src1->i[i] ? -1 : 0;
 }
 
 static void
@@ -4826,14 +4937,11 @@ micro_ishr(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src1)
 {
    unsigned masked_count;
-   masked_count = src1->i[0] & 0x1f;
-   dst->i[0] = src0->i[0] >> masked_count;
-   masked_count = src1->i[1] & 0x1f;
-   dst->i[1] = src0->i[1] >> masked_count;
-   masked_count = src1->i[2] & 0x1f;
-   dst->i[2] = src0->i[2] >> masked_count;
-   masked_count = src1->i[3] & 0x1f;
-   dst->i[3] = src0->i[3] >> masked_count;
+   unsigned i;
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
+      masked_count = src1->i[i] & 0x1f;
+      dst->i[i] = src0->i[i] >> masked_count;
+   }
 }
 
 static void
@@ -4841,30 +4949,30 @@ micro_islt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->i[0] = src0->i[0] < src1->i[0] ? -1 : 0;
-   dst->i[1] = src0->i[1] < src1->i[1] ? -1 : 0;
-   dst->i[2] = src0->i[2] < src1->i[2] ? -1 : 0;
-   dst->i[3] = src0->i[3] < src1->i[3] ? -1 : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = src0->i[i] < src1->i[i] ? -1 : 0;
 }
 
 static void
 micro_f2u(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->u[0] = (uint)src->f[0];
-   dst->u[1] = (uint)src->f[1];
-   dst->u[2] = (uint)src->f[2];
-   dst->u[3] = (uint)src->f[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = (uint)src->f[i];
 }
 
 static void
 micro_u2f(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = (float)src->u[0];
-   dst->f[1] = (float)src->u[1];
-   dst->f[2] = (float)src->u[2];
-   dst->f[3] = (float)src->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->f[i] = (float)src->u[i];
 }
 
 static void
@@ -4872,10 +4980,10 @@ micro_uadd(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] + src1->u[0];
-   dst->u[1] = src0->u[1] + src1->u[1];
-   dst->u[2] = src0->u[2] + src1->u[2];
-   dst->u[3] = src0->u[3] + src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->u[i] + src1->u[i];
 }
 
 static void
@@ -4883,10 +4991,10 @@ micro_udiv(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src1->u[0] ? src0->u[0] / src1->u[0] : ~0u;
-   dst->u[1] = src1->u[1] ? src0->u[1] / src1->u[1] : ~0u;
-   dst->u[2] = src1->u[2] ? src0->u[2] / src1->u[2] : ~0u;
-   dst->u[3] = src1->u[3] ? src0->u[3] / src1->u[3] : ~0u;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src1->u[i] ? src0->u[i] / src1->u[i] : ~0u;
 }
 
 static void
@@ -4895,10 +5003,10 @@ micro_umad(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src1,
            const union tgsi_exec_channel *src2)
 {
-   dst->u[0] = src0->u[0] * src1->u[0] + src2->u[0];
-   dst->u[1] = src0->u[1] * src1->u[1] + src2->u[1];
-   dst->u[2] = src0->u[2] * src1->u[2] + src2->u[2];
-   dst->u[3] = src0->u[3] * src1->u[3] + src2->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->u[i] * src1->u[i] + src2->u[i];
 }
 
 static void
@@ -4906,10 +5014,10 @@ micro_umax(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] > src1->u[0] ? src0->u[0] : src1->u[0];
-   dst->u[1] = src0->u[1] > src1->u[1] ? src0->u[1] : src1->u[1];
-   dst->u[2] = src0->u[2] > src1->u[2] ? src0->u[2] : src1->u[2];
-   dst->u[3] = src0->u[3] > src1->u[3] ? src0->u[3] : src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->u[i] > src1->u[i] ? src0->u[i] : src1->u[i];
 }
 
 static void
@@ -4917,10 +5025,10 @@ micro_umin(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] < src1->u[0] ? src0->u[0] : src1->u[0];
-   dst->u[1] = src0->u[1] < src1->u[1] ? src0->u[1] : src1->u[1];
-   dst->u[2] = src0->u[2] < src1->u[2] ? src0->u[2] : src1->u[2];
-   dst->u[3] = src0->u[3] < src1->u[3] ? src0->u[3] : src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->u[i] < src1->u[i] ? src0->u[i] : src1->u[i];
 }
 
 static void
@@ -4928,10 +5036,10 @@ micro_umod(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src1->u[0] ? src0->u[0] % src1->u[0] : ~0u;
-   dst->u[1] = src1->u[1] ? src0->u[1] % src1->u[1] : ~0u;
-   dst->u[2] = src1->u[2] ? src0->u[2] % src1->u[2] : ~0u;
-   dst->u[3] = src1->u[3] ? src0->u[3] % src1->u[3] : ~0u;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src1->u[i] ? src0->u[i] % src1->u[i] : ~0u;
 }
 
 static void
@@ -4939,10 +5047,10 @@ micro_umul(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] * src1->u[0];
-   dst->u[1] = src0->u[1] * src1->u[1];
-   dst->u[2] = src0->u[2] * src1->u[2];
-   dst->u[3] = src0->u[3] * src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->u[i] * src1->u[i];
 }
 
 static void
@@ -4950,11 +5058,11 @@ micro_imul_hi(union tgsi_exec_channel *dst,
               const union tgsi_exec_channel *src0,
               const union tgsi_exec_channel *src1)
 {
+   unsigned i;
+
 #define I64M(x, y) ((((int64_t)x) * ((int64_t)y)) >> 32)
-   dst->i[0] = I64M(src0->i[0], src1->i[0]);
-   dst->i[1] = I64M(src0->i[1], src1->i[1]);
-   dst->i[2] = I64M(src0->i[2], src1->i[2]);
-   dst->i[3] = I64M(src0->i[3], src1->i[3]);
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = I64M(src0->i[i], src1->i[i]);
 #undef I64M
 }
 
@@ -4963,11 +5071,11 @@ micro_umul_hi(union tgsi_exec_channel *dst,
               const union tgsi_exec_channel *src0,
               const union tgsi_exec_channel *src1)
 {
+   unsigned i;
+
 #define U64M(x, y) ((((uint64_t)x) * ((uint64_t)y)) >> 32)
-   dst->u[0] = U64M(src0->u[0], src1->u[0]);
-   dst->u[1] = U64M(src0->u[1], src1->u[1]);
-   dst->u[2] = U64M(src0->u[2], src1->u[2]);
-   dst->u[3] = U64M(src0->u[3], src1->u[3]);
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = U64M(src0->u[i], src1->u[i]);
 #undef U64M
 }
 
@@ -4976,10 +5084,10 @@ micro_useq(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] == src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] == src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] == src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] == src1->u[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->u[i] == src1->u[i] ? ~0 : 0;
 }
 
 static void
@@ -4987,10 +5095,10 @@ micro_usge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] >= src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] >= src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] >= src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] >= src1->u[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->u[i] >= src1->u[i] ? ~0 : 0;
 }
 
 static void
@@ -4999,14 +5107,11 @@ micro_ushr(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src1)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x1f;
-   dst->u[0] = src0->u[0] >> masked_count;
-   masked_count = src1->u[1] & 0x1f;
-   dst->u[1] = src0->u[1] >> masked_count;
-   masked_count = src1->u[2] & 0x1f;
-   dst->u[2] = src0->u[2] >> masked_count;
-   masked_count = src1->u[3] & 0x1f;
-   dst->u[3] = src0->u[3] >> masked_count;
+   unsigned i;
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
+      masked_count = src1->u[i] & 0x1f;
+      dst->u[i] = src0->u[i] >> masked_count;
+   }
 }
 
 static void
@@ -5014,10 +5119,10 @@ micro_uslt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] < src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] < src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] < src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] < src1->u[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->u[i] < src1->u[i] ? ~0 : 0;
 }
 
 static void
@@ -5025,20 +5130,20 @@ micro_usne(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] != src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] != src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] != src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] != src1->u[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = src0->u[i] != src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_uarl(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->i[0] = src->u[0];
-   dst->i[1] = src->u[1];
-   dst->i[2] = src->u[2];
-   dst->i[3] = src->u[3];
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = src->u[i];
 }
 
 /**
@@ -5051,7 +5156,7 @@ micro_ibfe(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src2)
 {
    int i;
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
       int width = src2->i[i];
       int offset = src1->i[i] & 0x1f;
       if (width == 32 && offset == 0) {
@@ -5078,7 +5183,7 @@ micro_ubfe(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src2)
 {
    int i;
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
       int width = src2->u[i];
       int offset = src1->u[i] & 0x1f;
       if (width == 32 && offset == 0) {
@@ -5106,7 +5211,7 @@ micro_bfi(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src3)
 {
    int i;
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
       int width = src3->u[i];
       int offset = src2->u[i] & 0x1f;
       if (width == 32) {
@@ -5122,50 +5227,50 @@ static void
 micro_brev(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->u[0] = util_bitreverse(src->u[0]);
-   dst->u[1] = util_bitreverse(src->u[1]);
-   dst->u[2] = util_bitreverse(src->u[2]);
-   dst->u[3] = util_bitreverse(src->u[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = util_bitreverse(src->u[i]);
 }
 
 static void
 micro_popc(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->u[0] = util_bitcount(src->u[0]);
-   dst->u[1] = util_bitcount(src->u[1]);
-   dst->u[2] = util_bitcount(src->u[2]);
-   dst->u[3] = util_bitcount(src->u[3]);
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->u[i] = util_bitcount(src->u[i]);
 }
 
 static void
 micro_lsb(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->i[0] = ffs(src->u[0]) - 1;
-   dst->i[1] = ffs(src->u[1]) - 1;
-   dst->i[2] = ffs(src->u[2]) - 1;
-   dst->i[3] = ffs(src->u[3]) - 1;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = ffs(src->u[i]) - 1;
 }
 
 static void
 micro_imsb(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->i[0] = util_last_bit_signed(src->i[0]) - 1;
-   dst->i[1] = util_last_bit_signed(src->i[1]) - 1;
-   dst->i[2] = util_last_bit_signed(src->i[2]) - 1;
-   dst->i[3] = util_last_bit_signed(src->i[3]) - 1;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = util_last_bit_signed(src->i[i]) - 1;
 }
 
 static void
 micro_umsb(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->i[0] = util_last_bit(src->u[0]) - 1;
-   dst->i[1] = util_last_bit(src->u[1]) - 1;
-   dst->i[2] = util_last_bit(src->u[2]) - 1;
-   dst->i[3] = util_last_bit(src->u[3]) - 1;
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+      dst->i[i] = util_last_bit(src->u[i]) - 1;
 }
 
 
@@ -5285,6 +5390,7 @@ exec_instruction(
    int *pc )
 {
    union tgsi_exec_channel r[10];
+   unsigned i;
 
    (*pc)++;
 
@@ -5633,17 +5739,10 @@ exec_instruction(
       mach->CondStack[mach->CondStackTop++] = mach->CondMask;
       FETCH( &r[0], 0, TGSI_CHAN_X );
       /* update CondMask */
-      if( ! r[0].f[0] ) {
-         mach->CondMask &= ~0x1;
-      }
-      if( ! r[0].f[1] ) {
-         mach->CondMask &= ~0x2;
-      }
-      if( ! r[0].f[2] ) {
-         mach->CondMask &= ~0x4;
-      }
-      if( ! r[0].f[3] ) {
-         mach->CondMask &= ~0x8;
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
+         if( ! r[0].f[i] ) {
+            mach->CondMask &= ~(1 << i);
+         }
       }
       UPDATE_EXEC_MASK(mach);
       /* Todo: If CondMask==0, jump to ELSE */
@@ -5655,17 +5754,10 @@ exec_instruction(
       mach->CondStack[mach->CondStackTop++] = mach->CondMask;
       IFETCH( &r[0], 0, TGSI_CHAN_X );
       /* update CondMask */
-      if( ! r[0].u[0] ) {
-         mach->CondMask &= ~0x1;
-      }
-      if( ! r[0].u[1] ) {
-         mach->CondMask &= ~0x2;
-      }
-      if( ! r[0].u[2] ) {
-         mach->CondMask &= ~0x4;
-      }
-      if( ! r[0].u[3] ) {
-         mach->CondMask &= ~0x8;
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++) {
+         if( ! r[0].u[i] ) {
+            mach->CondMask &= ~(1 << i);
+         }
       }
       UPDATE_EXEC_MASK(mach);
       /* Todo: If CondMask==0, jump to ELSE */
@@ -6332,10 +6424,502 @@ exec_instruction(
    return FALSE;
 }
 
+/*
+ * Pre-decoded instructions.
+ *
+ * When a shader is bound, each instruction is decoded once into a
+ * tgsi_exec_op, which holds the handler to dispatch to.  For the common
+ * ALU instructions the operands are resolved to the channels of the
+ * registers of the machine and their swizzles, so running such an
+ * instruction needs neither the register file switch nor the index
+ * computations of fetch_source() and store_dest().  Anything else, like
+ * control flow, texturing or indirect addressing, dispatches to
+ * exec_instruction().
+ */
+
+typedef boolean (* tgsi_exec_op_func)(struct tgsi_exec_machine *mach,
+                                      const struct tgsi_exec_op *op);
+
+union tgsi_exec_micro_op
+{
+   micro_unary_op unary;
+   micro_binary_op binary;
+   micro_trinary_op trinary;
+};
+
+/**
+ * Source operand of a decoded instruction.  Registers are resolved to
+ * their channels and immediates to their values, only constants are
+ * looked up at run time as the buffers change between runs.
+ */
+struct tgsi_exec_op_src
+{
+   const union tgsi_exec_channel *reg;
+   const float *imm;
+   uint constbuf;
+   int index;
+   ubyte swizzle[TGSI_NUM_CHANNELS];
+   boolean absolute;
+   boolean negate;
+};
+
+struct tgsi_exec_op
+{
+   tgsi_exec_op_func func;
+   union tgsi_exec_micro_op micro;
+   const struct tgsi_full_instruction *inst;
+   union tgsi_exec_channel *dst;
+   struct tgsi_exec_op_src src[3];
+   enum tgsi_exec_datatype src_datatype;
+   ubyte writemask;
+   ubyte num_channels;   /**< of the dot products */
+   boolean saturate;
+};
+
+static boolean
+exec_op_generic(struct tgsi_exec_machine *mach,
+                const struct tgsi_exec_op *op)
+{
+   return exec_instruction(mach, op->inst, &mach->pc);
+}
+
+static inline const union tgsi_exec_channel *
+fetch_op_src(const struct tgsi_exec_machine *mach,
+             const struct tgsi_exec_op *op,
+             uint index,
+             uint chan,
+             union tgsi_exec_channel *tmp)
+{
+   const struct tgsi_exec_op_src *src = &op->src[index];
+   const uint swizzle = src->swizzle[chan];
+   const union tgsi_exec_channel *val;
+   uint i;
+
+   if (src->reg) {
+      val = &src->reg[swizzle];
+   }
+   else if (src->imm) {
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+         tmp->f[i] = src->imm[swizzle];
+      val = tmp;
+   }
+   else {
+      const int pos = src->index * 4 + swizzle;
+      uint value = 0;
+
+      if (pos < (int) mach->ConstsSize[src->constbuf])
+         value = ((const uint *) mach->Consts[src->constbuf])[pos];
+      for (i = 0; i < TGSI_EXEC_WIDTH; i++)
+         tmp->u[i] = value;
+      val = tmp;
+   }
+
+   if (src->absolute) {
+      if (op->src_datatype == TGSI_EXEC_DATA_FLOAT)
+         micro_abs(tmp, val);
+      else
+         micro_iabs(tmp, val);
+      val = tmp;
+   }
+
+   if (src->negate) {
+      if (op->src_datatype == TGSI_EXEC_DATA_FLOAT)
+         micro_neg(tmp, val);
+      else
+         micro_ineg(tmp, val);
+      val = tmp;
+   }
+
+   return val;
+}
+
+static inline void
+store_op_dst(const struct tgsi_exec_machine *mach,
+             const struct tgsi_exec_op *op,
+             const union tgsi_exec_channel *chan,
+             uint stride)
+{
+   uint i;
+
+   for (i = 0; i < TGSI_NUM_CHANNELS; i++) {
+      if (op->writemask & (1 << i))
+         store_channel(mach, &op->dst[i], &chan[i * stride], op->saturate);
+   }
+}
+
+static boolean
+exec_op_vector_unary(struct tgsi_exec_machine *mach,
+                     const struct tgsi_exec_op *op)
+{
+   union tgsi_exec_channel dst[TGSI_NUM_CHANNELS];
+   union tgsi_exec_channel tmp;
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->writemask & (1 << chan))
+         op->micro.unary(&dst[chan], fetch_op_src(mach, op, 0, chan, &tmp));
+   }
+   store_op_dst(mach, op, dst, 1);
+   mach->pc++;
+   return FALSE;
+}
+
+static boolean
+exec_op_vector_binary(struct tgsi_exec_machine *mach,
+                      const struct tgsi_exec_op *op)
+{
+   union tgsi_exec_channel dst[TGSI_NUM_CHANNELS];
+   union tgsi_exec_channel tmp[2];
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->writemask & (1 << chan))
+         op->micro.binary(&dst[chan],
+                          fetch_op_src(mach, op, 0, chan, &tmp[0]),
+                          fetch_op_src(mach, op, 1, chan, &tmp[1]));
+   }
+   store_op_dst(mach, op, dst, 1);
+   mach->pc++;
+   return FALSE;
+}
+
+static boolean
+exec_op_vector_trinary(struct tgsi_exec_machine *mach,
+                       const struct tgsi_exec_op *op)
+{
+   union tgsi_exec_channel dst[TGSI_NUM_CHANNELS];
+   union tgsi_exec_channel tmp[3];
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->writemask & (1 << chan))
+         op->micro.trinary(&dst[chan],
+                           fetch_op_src(mach, op, 0, chan, &tmp[0]),
+                           fetch_op_src(mach, op, 1, chan, &tmp[1]),
+                           fetch_op_src(mach, op, 2, chan, &tmp[2]));
+   }
+   store_op_dst(mach, op, dst, 1);
+   mach->pc++;
+   return FALSE;
+}
+
+static boolean
+exec_op_scalar_unary(struct tgsi_exec_machine *mach,
+                     const struct tgsi_exec_op *op)
+{
+   union tgsi_exec_channel dst;
+   union tgsi_exec_channel tmp;
+
+   op->micro.unary(&dst, fetch_op_src(mach, op, 0, TGSI_CHAN_X, &tmp));
+   store_op_dst(mach, op, &dst, 0);
+   mach->pc++;
+   return FALSE;
+}
+
+static boolean
+exec_op_scalar_binary(struct tgsi_exec_machine *mach,
+                      const struct tgsi_exec_op *op)
+{
+   union tgsi_exec_channel dst;
+   union tgsi_exec_channel tmp[2];
+
+   op->micro.binary(&dst,
+                    fetch_op_src(mach, op, 0, TGSI_CHAN_X, &tmp[0]),
+                    fetch_op_src(mach, op, 1, TGSI_CHAN_X, &tmp[1]));
+   store_op_dst(mach, op, &dst, 0);
+   mach->pc++;
+   return FALSE;
+}
+
+static boolean
+exec_op_dp(struct tgsi_exec_machine *mach,
+           const struct tgsi_exec_op *op)
+{
+   union tgsi_exec_channel dst;
+   union tgsi_exec_channel tmp[2];
+   uint chan;
+
+   micro_mul(&dst,
+             fetch_op_src(mach, op, 0, TGSI_CHAN_X, &tmp[0]),
+             fetch_op_src(mach, op, 1, TGSI_CHAN_X, &tmp[1]));
+   for (chan = TGSI_CHAN_Y; chan < op->num_channels; chan++) {
+      micro_mad(&dst,
+                fetch_op_src(mach, op, 0, chan, &tmp[0]),
+                fetch_op_src(mach, op, 1, chan, &tmp[1]),
+                &dst);
+   }
+   store_op_dst(mach, op, &dst, 0);
+   mach->pc++;
+   return FALSE;
+}
+
+/**
+ * How an instruction is run when its operands can be resolved, for the
+ * opcodes that exec_instruction() runs through the micro ops above.
+ */
+struct tgsi_exec_op_info
+{
+   tgsi_exec_op_func func;
+   union tgsi_exec_micro_op micro;
+   enum tgsi_exec_datatype src_datatype;
+   ubyte num_src;
+   ubyte num_channels;
+};
+
+#define OP_UNARY(opcode, kind, op, datatype) \
+   [TGSI_OPCODE_##opcode] = { exec_op_##kind, { .unary = op }, \
+                              TGSI_EXEC_DATA_##datatype, 1, 0 }
+#define OP_BINARY(opcode, kind, op, datatype) \
+   [TGSI_OPCODE_##opcode] = { exec_op_##kind, { .binary = op }, \
+                              TGSI_EXEC_DATA_##datatype, 2, 0 }
+#define OP_TRINARY(opcode, op, datatype) \
+   [TGSI_OPCODE_##opcode] = { exec_op_vector_trinary, { .trinary = op }, \
+                              TGSI_EXEC_DATA_##datatype, 3, 0 }
+#define OP_DP(opcode, num_channels) \
+   [TGSI_OPCODE_##opcode] = { exec_op_dp, { NULL }, \
+                              TGSI_EXEC_DATA_FLOAT, 2, num_channels }
+
+static const struct tgsi_exec_op_info op_infos[TGSI_OPCODE_LAST] = {
+   OP_UNARY(ARL, vector_unary, micro_arl, FLOAT),
+   OP_UNARY(MOV, vector_unary, micro_mov, FLOAT),
+   OP_UNARY(RCP, scalar_unary, micro_rcp, FLOAT),
+   OP_UNARY(RSQ, scalar_unary, micro_rsq, FLOAT),
+   OP_BINARY(MUL, vector_binary, micro_mul, FLOAT),
+   OP_BINARY(ADD, vector_binary, micro_add, FLOAT),
+   OP_DP(DP2, 2),
+   OP_DP(DP3, 3),
+   OP_DP(DP4, 4),
+   OP_BINARY(MIN, vector_binary, micro_min, FLOAT),
+   OP_BINARY(MAX, vector_binary, micro_max, FLOAT),
+   OP_BINARY(SLT, vector_binary, micro_slt, FLOAT),
+   OP_BINARY(SGE, vector_binary, micro_sge, FLOAT),
+   OP_TRINARY(MAD, micro_mad, FLOAT),
+   OP_TRINARY(LRP, micro_lrp, FLOAT),
+   OP_UNARY(SQRT, scalar_unary, micro_sqrt, FLOAT),
+   OP_UNARY(FRC, vector_unary, micro_frc, FLOAT),
+   OP_UNARY(FLR, vector_unary, micro_flr, FLOAT),
+   OP_UNARY(ROUND, vector_unary, micro_rnd, FLOAT),
+   OP_UNARY(EX2, scalar_unary, micro_exp2, FLOAT),
+   OP_UNARY(LG2, scalar_unary, micro_lg2, FLOAT),
+   OP_BINARY(POW, scalar_binary, micro_pow, FLOAT),
+   OP_BINARY(LDEXP, vector_binary, micro_ldexp, FLOAT),
+   OP_UNARY(COS, scalar_unary, micro_cos, FLOAT),
+   OP_UNARY(DDX, vector_unary, micro_ddx, FLOAT),
+   OP_UNARY(DDY, vector_unary, micro_ddy, FLOAT),
+   OP_BINARY(SEQ, vector_binary, micro_seq, FLOAT),
+   OP_BINARY(SGT, vector_binary, micro_sgt, FLOAT),
+   OP_UNARY(SIN, scalar_unary, micro_sin, FLOAT),
+   OP_BINARY(SLE, vector_binary, micro_sle, FLOAT),
+   OP_BINARY(SNE, vector_binary, micro_sne, FLOAT),
+   OP_UNARY(ARR, vector_unary, micro_arr, FLOAT),
+   OP_UNARY(SSG, vector_unary, micro_sgn, FLOAT),
+   OP_TRINARY(CMP, micro_cmp, FLOAT),
+   OP_BINARY(DIV, vector_binary, micro_div, FLOAT),
+   OP_UNARY(CEIL, vector_unary, micro_ceil, FLOAT),
+   OP_UNARY(I2F, vector_unary, micro_i2f, INT),
+   OP_UNARY(NOT, vector_unary, micro_not, UINT),
+   OP_UNARY(TRUNC, vector_unary, micro_trunc, FLOAT),
+   OP_BINARY(SHL, vector_binary, micro_shl, UINT),
+   OP_BINARY(AND, vector_binary, micro_and, UINT),
+   OP_BINARY(OR, vector_binary, micro_or, UINT),
+   OP_BINARY(MOD, vector_binary, micro_mod, INT),
+   OP_BINARY(XOR, vector_binary, micro_xor, UINT),
+   OP_UNARY(F2I, vector_unary, micro_f2i, FLOAT),
+   OP_BINARY(FSEQ, vector_binary, micro_fseq, FLOAT),
+   OP_BINARY(FSGE, vector_binary, micro_fsge, FLOAT),
+   OP_BINARY(FSLT, vector_binary, micro_fslt, FLOAT),
+   OP_BINARY(FSNE, vector_binary, micro_fsne, FLOAT),
+   OP_BINARY(IDIV, vector_binary, micro_idiv, INT),
+   OP_BINARY(IMAX, vector_binary, micro_imax, INT),
+   OP_BINARY(IMIN, vector_binary, micro_imin, INT),
+   OP_UNARY(INEG, vector_unary, micro_ineg, INT),
+   OP_BINARY(ISGE, vector_binary, micro_isge, INT),
+   OP_BINARY(ISHR, vector_binary, micro_ishr, INT),
+   OP_BINARY(ISLT, vector_binary, micro_islt, INT),
+   OP_UNARY(F2U, vector_unary, micro_f2u, FLOAT),
+   OP_UNARY(U2F, vector_unary, micro_u2f, UINT),
+   OP_BINARY(UADD, vector_binary, micro_uadd, INT),
+   OP_BINARY(UDIV, vector_binary, micro_udiv, UINT),
+   OP_TRINARY(UMAD, micro_umad, UINT),
+   OP_BINARY(UMAX, vector_binary, micro_umax, UINT),
+   OP_BINARY(UMIN, vector_binary, micro_umin, UINT),
+   OP_BINARY(UMOD, vector_binary, micro_umod, UINT),
+   OP_BINARY(UMUL, vector_binary, micro_umul, UINT),
+   OP_BINARY(IMUL_HI, vector_binary, micro_imul_hi, INT),
+   OP_BINARY(UMUL_HI, vector_binary, micro_umul_hi, UINT),
+   OP_BINARY(USEQ, vector_binary, micro_useq, UINT),
+   OP_BINARY(USGE, vector_binary, micro_usge, UINT),
+   OP_BINARY(USHR, vector_binary, micro_ushr, UINT),
+   OP_BINARY(USLT, vector_binary, micro_uslt, UINT),
+   OP_BINARY(USNE, vector_binary, micro_usne, UINT),
+   OP_UNARY(UARL, vector_unary, micro_uarl, UINT),
+   OP_UNARY(IABS, vector_unary, micro_iabs, INT),
+   OP_UNARY(ISSG, vector_unary, micro_isgn, INT),
+   OP_TRINARY(IBFE, micro_ibfe, INT),
+   OP_TRINARY(UBFE, micro_ubfe, UINT),
+   OP_UNARY(BREV, vector_unary, micro_brev, UINT),
+   OP_UNARY(POPC, vector_unary, micro_popc, UINT),
+   OP_UNARY(LSB, vector_unary, micro_lsb, UINT),
+   OP_UNARY(IMSB, vector_unary, micro_imsb, INT),
+   OP_UNARY(UMSB, vector_unary, micro_umsb, UINT),
+};
+
+#undef OP_DP
+#undef OP_TRINARY
+#undef OP_BINARY
+#undef OP_UNARY
+
+static boolean
+decode_op_src(const struct tgsi_exec_machine *mach,
+              const struct tgsi_full_src_register *reg,
+              struct tgsi_exec_op_src *src)
+{
+   const int index = reg->Register.Index;
+   uint chan;
+
+   if (reg->Register.Indirect)
+      return FALSE;
+
+   memset(src, 0, sizeof *src);
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_TEMPORARY:
+      if (index >= TGSI_EXEC_NUM_TEMPS)
+         return FALSE;
+      src->reg = mach->Temps[index].xyzw;
+      break;
+
+   case TGSI_FILE_INPUT:
+      if (reg->Register.Dimension || !mach->Inputs)
+         return FALSE;
+      src->reg = mach->Inputs[index].xyzw;
+      break;
+
+   case TGSI_FILE_OUTPUT:
+      if (mach->ShaderType == PIPE_SHADER_GEOMETRY || !mach->Outputs)
+         return FALSE;
+      src->reg = mach->Outputs[index].xyzw;
+      break;
+
+   case TGSI_FILE_SYSTEM_VALUE:
+      if (index >= TGSI_MAX_MISC_INPUTS)
+         return FALSE;
+      src->reg = mach->SystemValue[index].xyzw;
+      break;
+
+   case TGSI_FILE_IMMEDIATE:
+      assert(index >= 0 && index < (int) mach->ImmLimit);
+      src->imm = mach->Imms[index];
+      break;
+
+   case TGSI_FILE_CONSTANT:
+      if (index < 0 ||
+          (reg->Register.Dimension && reg->Dimension.Indirect))
+         return FALSE;
+      src->constbuf = reg->Register.Dimension ? reg->Dimension.Index : 0;
+      src->index = index;
+      assert(src->constbuf < PIPE_MAX_CONSTANT_BUFFERS);
+      break;
+
+   default:
+      return FALSE;
+   }
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      src->swizzle[chan] = tgsi_util_get_full_src_register_swizzle(reg, chan);
+   src->absolute = reg->Register.Absolute;
+   src->negate = reg->Register.Negate;
+   return TRUE;
+}
+
+static union tgsi_exec_channel *
+decode_op_dst(struct tgsi_exec_machine *mach,
+              const struct tgsi_full_dst_register *reg)
+{
+   const int index = reg->Register.Index;
+
+   if (reg->Register.Indirect || reg->Register.Dimension)
+      return NULL;
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_TEMPORARY:
+      if (index >= TGSI_EXEC_NUM_TEMPS)
+         return NULL;
+      return mach->Temps[index].xyzw;
+
+   case TGSI_FILE_OUTPUT:
+      /* geometry shaders offset the outputs by the emitted vertices */
+      if (mach->ShaderType == PIPE_SHADER_GEOMETRY || !mach->Outputs)
+         return NULL;
+      return mach->Outputs[index].xyzw;
+
+   case TGSI_FILE_ADDRESS:
+      return mach->Addrs[index].xyzw;
+
+   default:
+      return NULL;
+   }
+}
+
+static void
+decode_instruction(struct tgsi_exec_machine *mach,
+                   const struct tgsi_full_instruction *inst,
+                   struct tgsi_exec_op *op)
+{
+   const struct tgsi_exec_op_info *info;
+   uint i;
+
+   memset(op, 0, sizeof *op);
+   op->func = exec_op_generic;
+   op->inst = inst;
+
+   assert(inst->Instruction.Opcode < TGSI_OPCODE_LAST);
+   info = &op_infos[inst->Instruction.Opcode];
+   if (!info->func ||
+       inst->Instruction.NumDstRegs != 1 ||
+       inst->Instruction.NumSrcRegs != info->num_src)
+      return;
+
+   op->dst = decode_op_dst(mach, &inst->Dst[0]);
+   if (!op->dst)
+      return;
+
+   for (i = 0; i < info->num_src; i++) {
+      if (!decode_op_src(mach, &inst->Src[i], &op->src[i]))
+         return;
+   }
+
+   op->micro = info->micro;
+   op->src_datatype = info->src_datatype;
+   op->writemask = inst->Dst[0].Register.WriteMask;
+   op->num_channels = info->num_channels;
+   op->saturate = inst->Instruction.Saturate;
+   op->func = info->func;
+}
+
+/**
+ * Decode the instructions of the bound shader for tgsi_exec_machine_run().
+ */
+static struct tgsi_exec_op *
+decode_instructions(struct tgsi_exec_machine *mach)
+{
+   struct tgsi_exec_op *ops;
+   uint i;
+
+   ops = MALLOC(MAX2(mach->NumInstructions, 1) * sizeof *ops);
+   if (!ops)
+      return NULL;
+
+   for (i = 0; i < mach->NumInstructions; i++)
+      decode_instruction(mach, &mach->Instructions[i], &ops[i]);
+
+   return ops;
+}
+
 static void
 tgsi_exec_machine_setup_masks(struct tgsi_exec_machine *mach)
 {
-   uint default_mask = 0xf;
+   uint default_mask = TGSI_EXEC_MASK;
 
    mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0] = 0;
    mach->Temps[TEMP_OUTPUT_I].xyzw[TEMP_OUTPUT_C].u[0] = 0;
@@ -6351,6 +6935,21 @@ tgsi_exec_machine_setup_masks(struct tgsi_exec_machine *mach)
 
    if (mach->NonHelperMask == 0)
       mach->NonHelperMask = default_mask;
+   else if (mach->ShaderType == PIPE_SHADER_FRAGMENT) {
+      uint q;
+
+      /* Helper pixels run along with the live pixels of their quad for
+       * the derivatives, quads without any live pixel are left out.
+       */
+      default_mask = 0;
+      for (q = 0; q < TGSI_EXEC_WIDTH; q += TGSI_QUAD_SIZE) {
+         if ((mach->NonHelperMask >> q) & 0xf)
+            default_mask |= 0xf << q;
+      }
+   }
+   else
+      default_mask = mach->NonHelperMask;
+
    mach->CondMask = default_mask;
    mach->LoopMask = default_mask;
    mach->ContMask = default_mask;
@@ -6412,7 +7011,12 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
 #endif
 
          assert(mach->pc < (int) mach->NumInstructions);
-         barrier_hit = exec_instruction(mach, mach->Instructions + mach->pc, &mach->pc);
+         if (likely(mach->Ops)) {
+            const struct tgsi_exec_op *op = &mach->Ops[mach->pc];
+            barrier_hit = op->func(mach, op);
+         }
+         else
+            barrier_hit = exec_instruction(mach, mach->Instructions + mach->pc, &mach->pc);
 
          /* for compute shaders if we hit a barrier return now for later rescheduling */
          if (barrier_hit && mach->ShaderType == PIPE_SHADER_COMPUTE)
@@ -6425,7 +7029,7 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
 
                memcpy(&temps[i], &mach->Temps[i], sizeof(temps[i]));
                debug_printf("TEMP[%2u] = ", i);
-               for (j = 0; j < 4; j++) {
+               for (j = 0; j < TGSI_EXEC_WIDTH; j++) {
                   if (j > 0) {
                      debug_printf("           ");
                   }
@@ -6444,7 +7048,7 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
 
                   memcpy(&outputs[i], &mach->Outputs[i], sizeof(outputs[i]));
                   debug_printf("OUT[%2u] =  ", i);
-                  for (j = 0; j < 4; j++) {
+                  for (j = 0; j < TGSI_EXEC_WIDTH; j++) {
                      if (j > 0) {
                         debug_printf("           ");
                      }
@@ -45,6 +45,16 @@ extern "C" {
 #define TGSI_NUM_CHANNELS 4  /* R,G,B,A */
 #define TGSI_QUAD_SIZE    4  /* 4 pixel/quad */
 
+/**
+ * The interpreter runs each instruction on TGSI_EXEC_NUM_QUADS quads at
+ * once, stored as SoA channels of TGSI_EXEC_WIDTH lanes.  The execution
+ * masks are 32-bit, so this can go up to 8 quads.  Sampler, image and
+ * buffer callbacks still see one quad at a time.
+ */
+#define TGSI_EXEC_NUM_QUADS 4
+#define TGSI_EXEC_WIDTH   (TGSI_EXEC_NUM_QUADS * TGSI_QUAD_SIZE)
+#define TGSI_EXEC_MASK    (~0u >> (32 - TGSI_EXEC_WIDTH))
+
 #define TGSI_FOR_EACH_CHANNEL( CHAN )\
    for (CHAN = 0; CHAN < TGSI_NUM_CHANNELS; CHAN++)
 
@@ -73,13 +83,13 @@ extern "C" {
   */
 union tgsi_exec_channel
 {
-   float    f[TGSI_QUAD_SIZE];
-   int      i[TGSI_QUAD_SIZE];
-   unsigned u[TGSI_QUAD_SIZE];
+   float    f[TGSI_EXEC_WIDTH];
+   int      i[TGSI_EXEC_WIDTH];
+   unsigned u[TGSI_EXEC_WIDTH];
 };
 
 /**
-  * A vector[RGBA] of channels[4 pixels]
+  * A vector[RGBA] of channels[TGSI_EXEC_WIDTH pixels]
   */
 struct tgsi_exec_vector
 {
@@ -352,6 +362,7 @@ enum tgsi_break_type {
 typedef float float4[4];
 
 struct tgsi_exec_machine;
+struct tgsi_exec_op;
 
 typedef void (* apply_sample_offset_func)(
    const struct tgsi_exec_machine *mach,
@@ -462,6 +473,9 @@ struct tgsi_exec_machine
    struct tgsi_full_instruction *Instructions;
    uint NumInstructions;
 
+   /** Instructions decoded for dispatch, one per entry of Instructions */
+   struct tgsi_exec_op *Ops;
+
    struct tgsi_full_declaration *Declarations;
    uint NumDeclarations;
 
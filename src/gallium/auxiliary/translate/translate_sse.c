@@ -37,6 +37,9 @@
 
 #if (defined(PIPE_ARCH_X86) || defined(PIPE_ARCH_X86_64)) && !defined(PIPE_SUBSYSTEM_EMBEDDED)
 
+#include "util/simple_mtx.h"
+#include "cso_cache/cso_cache.h"
+#include "cso_cache/cso_hash.h"
 #include "rtasm/rtasm_cpu.h"
 #include "rtasm/rtasm_x86sse.h"
 
@@ -131,6 +134,42 @@ struct translate_sse
 };
 
 
+/**
+ * Code generated for a translate key.
+ *
+ * The generated functions only access the translate_sse object they are
+ * run with, at offsets which only depend on the key, so every object
+ * created for the same key, by any context, can run the same code.  The
+ * code is kept as long as any translate_sse object exists, so that
+ * contexts which come and go don't generate it over and over, and is
+ * released with the last object.
+ */
+struct translate_sse_code
+{
+   struct translate_key key;
+
+   struct x86_function linear_func;
+   struct x86_function elt_func;
+   struct x86_function elt16_func;
+   struct x86_function elt8_func;
+
+   run_func run;
+   run_elts_func run_elts;
+   run_elts16_func run_elts16;
+   run_elts8_func run_elts8;
+};
+
+/* Bound the executable memory held by the shared code.  Objects created
+ * for keys beyond that own their code, as before.
+ */
+#define MAX_SHARED_CODE 1024
+
+static simple_mtx_t shared_code_mutex = _SIMPLE_MTX_INITIALIZER_NP;
+static struct cso_hash *shared_code_hash;
+static unsigned num_shared_code;
+static unsigned num_translate_sse;
+
+
 static int
 get_offset(const void *a, const void *b)
 {
@@ -222,6 +261,47 @@ emit_load_sse2(struct translate_sse *p,
 }
 
 
+/* load 8 or 16 bit integers zero or sign extended to 32 bits in a SSE
+ * register, padding with zeros */
+static void
+emit_load_sse4_1(struct translate_sse *p,
+                 struct x86_reg data, struct x86_reg src,
+                 unsigned bits, unsigned chans, boolean is_signed)
+{
+   /* the memory forms read exactly four channels */
+   if (chans == 4) {
+      if (bits == 8) {
+         if (is_signed)
+            sse4_1_pmovsxbd(p->func, data, src);
+         else
+            sse4_1_pmovzxbd(p->func, data, src);
+      }
+      else {
+         if (is_signed)
+            sse4_1_pmovsxwd(p->func, data, src);
+         else
+            sse4_1_pmovzxwd(p->func, data, src);
+      }
+      return;
+   }
+
+   emit_load_sse2(p, data, src, bits * chans >> 3);
+
+   if (bits == 8) {
+      if (is_signed)
+         sse4_1_pmovsxbd(p->func, data, data);
+      else
+         sse4_1_pmovzxbd(p->func, data, data);
+   }
+   else {
+      if (is_signed)
+         sse4_1_pmovsxwd(p->func, data, data);
+      else
+         sse4_1_pmovzxwd(p->func, data, data);
+   }
+}
+
+
 /* this value can be passed for the out_chans argument */
 #define CHANNELS_0001 5
 
@@ -319,6 +399,10 @@ emit_load_float64to32(struct translate_sse *p, struct x86_reg data,
          sse_orps(p->func, data, get_const(p, CONST_IDENTITY));
       break;
    case 4:
+      if (x86_target_caps(p->func) & X86_AVX) {
+         avx_vcvtpd2ps256(p->func, data, arg0);
+         break;
+      }
       sse2_movupd(p->func, data, arg0);
       sse2_cvtpd2ps(p->func, data, data);
       sse2_movupd(p->func, tmpXMM, x86_make_disp(arg0, 16));
@@ -444,6 +528,15 @@ emit_memcpy(struct translate_sse *p, struct x86_reg dst, struct x86_reg src,
          emit_store64(p, x86_make_disp(dst, 16), dataGPR, dataXMM2);
          break;
       case 32:
+         if (x86_target_caps(p->func) & X86_AVX) {
+            avx_vmovdqu256(p->func, dataXMM, src);
+            avx_vmovdqu256(p->func, dst, dataXMM);
+            /* The rest of the loop is legacy SSE, which would pay the
+             * SSE/AVX transition penalty on every vertex.
+             */
+            avx_vzeroupper(p->func);
+            break;
+         }
          emit_mov128(p, dataXMM, src);
          emit_mov128(p, dataXMM2, x86_make_disp(src, 16));
          emit_mov128(p, dst, dataXMM);
@@ -455,6 +548,17 @@ emit_memcpy(struct translate_sse *p, struct x86_reg dst, struct x86_reg src,
    }
 }
 
+/* whether two channels only differ by their position in the format */
+static boolean
+same_channel_type(const struct util_format_channel_description *a,
+                  const struct util_format_channel_description *b)
+{
+   return a->type == b->type &&
+          a->normalized == b->normalized &&
+          a->pure_integer == b->pure_integer &&
+          a->size == b->size;
+}
+
 static boolean
 translate_attr_convert(struct translate_sse *p,
                        const struct translate_element *a,
@@ -483,16 +587,14 @@ translate_attr_convert(struct translate_sse *p,
       return FALSE;
 
    for (i = 1; i < input_desc->nr_channels; ++i) {
-      if (memcmp
-          (&input_desc->channel[i], &input_desc->channel[0],
-           sizeof(input_desc->channel[0])))
+      if (!same_channel_type(&input_desc->channel[i],
+                             &input_desc->channel[0]))
          return FALSE;
    }
 
    for (i = 1; i < output_desc->nr_channels; ++i) {
-      if (memcmp
-          (&output_desc->channel[i], &output_desc->channel[0],
-           sizeof(output_desc->channel[0]))) {
+      if (!same_channel_type(&output_desc->channel[i],
+                             &output_desc->channel[0])) {
          return FALSE;
       }
    }
@@ -527,13 +629,22 @@ translate_attr_convert(struct translate_sse *p,
          case UTIL_FORMAT_TYPE_UNSIGNED:
             if (!(x86_target_caps(p->func) & X86_SSE2))
                return FALSE;
-            emit_load_sse2(p, dataXMM, src,
-                           input_desc->channel[0].size *
-                           input_desc->nr_channels >> 3);
+            if ((x86_target_caps(p->func) & X86_SSE4_1) &&
+                input_desc->channel[0].size <= 16) {
+               emit_load_sse4_1(p, dataXMM, src,
+                                input_desc->channel[0].size,
+                                input_desc->nr_channels, FALSE);
+            }
+            else {
+               emit_load_sse2(p, dataXMM, src,
+                              input_desc->channel[0].size *
+                              input_desc->nr_channels >> 3);
+            }
 
-            /* TODO: add support for SSE4.1 pmovzx */
             switch (input_desc->channel[0].size) {
             case 8:
+               if (x86_target_caps(p->func) & X86_SSE4_1)
+                  break;
                /* TODO: this may be inefficient due to get_identity() being
                 *  used both as a float and integer register.
                 */
@@ -541,6 +652,8 @@ translate_attr_convert(struct translate_sse *p,
                sse2_punpcklbw(p->func, dataXMM, get_const(p, CONST_IDENTITY));
                break;
             case 16:
+               if (x86_target_caps(p->func) & X86_SSE4_1)
+                  break;
                sse2_punpcklwd(p->func, dataXMM, get_const(p, CONST_IDENTITY));
                break;
             case 32:           /* we lose precision here */
@@ -579,18 +692,29 @@ translate_attr_convert(struct translate_sse *p,
          case UTIL_FORMAT_TYPE_SIGNED:
             if (!(x86_target_caps(p->func) & X86_SSE2))
                return FALSE;
-            emit_load_sse2(p, dataXMM, src,
-                           input_desc->channel[0].size *
-                           input_desc->nr_channels >> 3);
+            if ((x86_target_caps(p->func) & X86_SSE4_1) &&
+                input_desc->channel[0].size <= 16) {
+               emit_load_sse4_1(p, dataXMM, src,
+                                input_desc->channel[0].size,
+                                input_desc->nr_channels, TRUE);
+            }
+            else {
+               emit_load_sse2(p, dataXMM, src,
+                              input_desc->channel[0].size *
+                              input_desc->nr_channels >> 3);
+            }
 
-            /* TODO: add support for SSE4.1 pmovsx */
             switch (input_desc->channel[0].size) {
             case 8:
+               if (x86_target_caps(p->func) & X86_SSE4_1)
+                  break;
                sse2_punpcklbw(p->func, dataXMM, dataXMM);
                sse2_punpcklbw(p->func, dataXMM, dataXMM);
                sse2_psrad_imm(p->func, dataXMM, 24);
                break;
             case 16:
+               if (x86_target_caps(p->func) & X86_SSE4_1)
+                  break;
                sse2_punpcklwd(p->func, dataXMM, dataXMM);
                sse2_psrad_imm(p->func, dataXMM, 16);
                break;
@@ -626,6 +750,20 @@ translate_attr_convert(struct translate_sse *p,
 
             break;
          case UTIL_FORMAT_TYPE_FLOAT:
+            if (input_desc->channel[0].size == 16) {
+               if (!(x86_target_caps(p->func) & X86_F16C))
+                  return FALSE;
+               emit_load_sse2(p, dataXMM, src,
+                              2 * input_desc->nr_channels);
+               f16c_vcvtph2ps(p->func, dataXMM, dataXMM);
+               if (swizzle[3] == PIPE_SWIZZLE_1
+                   && input_desc->nr_channels <= 3) {
+                  /* the missing channels were loaded as zero */
+                  sse_orps(p->func, dataXMM, get_const(p, CONST_IDENTITY));
+                  swizzle[3] = PIPE_SWIZZLE_W;
+               }
+               break;
+            }
             if (input_desc->channel[0].size != 32
                 && input_desc->channel[0].size != 64) {
                return FALSE;
@@ -1416,6 +1554,11 @@ build_vertex_emit(struct translate_sse *p,
    if (p->func->need_emms)
       mmx_emms(p->func);
 
+   /* Avoid the SSE/AVX transition penalty in the caller
+    */
+   if (p->func->need_vzeroupper)
+      avx_vzeroupper(p->func);
+
    /* Land forward jump here:
     */
    x86_fixup_fwd_jump(p->func, fixup);
@@ -1461,6 +1604,38 @@ translate_sse_set_buffer(struct translate *translate,
 }
 
 
+/**
+ * Release all the shared code.  Must be called with the shared code mutex
+ * held, once no translate_sse object is left to run it.
+ */
+static void
+release_shared_code(void)
+{
+   struct cso_hash_iter iter;
+
+   if (!shared_code_hash)
+      return;
+
+   iter = cso_hash_first_node(shared_code_hash);
+   while (!cso_hash_iter_is_null(iter)) {
+      struct translate_sse_code *code =
+         (struct translate_sse_code *) cso_hash_iter_data(iter);
+
+      x86_release_func(&code->elt8_func);
+      x86_release_func(&code->elt16_func);
+      x86_release_func(&code->elt_func);
+      x86_release_func(&code->linear_func);
+      FREE(code);
+
+      iter = cso_hash_iter_next(iter);
+   }
+
+   cso_hash_delete(shared_code_hash);
+   shared_code_hash = NULL;
+   num_shared_code = 0;
+}
+
+
 static void
 translate_sse_release(struct translate *translate)
 {
@@ -1472,12 +1647,99 @@ translate_sse_release(struct translate *translate)
    x86_release_func(&p->linear_func);
 
    os_free_aligned(p);
+
+   simple_mtx_lock(&shared_code_mutex);
+   assert(num_translate_sse > 0);
+   if (--num_translate_sse == 0)
+      release_shared_code();
+   simple_mtx_unlock(&shared_code_mutex);
+}
+
+
+static unsigned
+shared_code_hash_key(const struct translate_key *key)
+{
+   return cso_construct_key((void *) key, translate_keysize(key));
+}
+
+
+/**
+ * Look up the shared code for a key.  Must be called with the shared code
+ * mutex held.
+ */
+static const struct translate_sse_code *
+find_shared_code(const struct translate_key *key)
+{
+   if (!shared_code_hash)
+      return NULL;
+
+   return (const struct translate_sse_code *)
+      cso_hash_find_data_from_template(shared_code_hash,
+                                       shared_code_hash_key(key),
+                                       (void *) key,
+                                       translate_keysize(key));
+}
+
+
+/**
+ * Hand the code just generated for p over to the shared code, unless
+ * another thread got there first or there is no room left, in which case
+ * p keeps owning it.
+ */
+static void
+share_code(struct translate_sse *p)
+{
+   const struct translate_key *key = &p->translate.key;
+   struct translate_sse_code *code;
+
+   simple_mtx_lock(&shared_code_mutex);
+
+   if (!shared_code_hash)
+      shared_code_hash = cso_hash_create();
+
+   if (!shared_code_hash ||
+       num_shared_code >= MAX_SHARED_CODE ||
+       find_shared_code(key))
+      goto out;
+
+   code = CALLOC_STRUCT(translate_sse_code);
+   if (!code)
+      goto out;
+
+   code->key = *key;
+   code->linear_func = p->linear_func;
+   code->elt_func = p->elt_func;
+   code->elt16_func = p->elt16_func;
+   code->elt8_func = p->elt8_func;
+   code->run = p->translate.run;
+   code->run_elts = p->translate.run_elts;
+   code->run_elts16 = p->translate.run_elts16;
+   code->run_elts8 = p->translate.run_elts8;
+
+   if (cso_hash_iter_is_null(cso_hash_insert(shared_code_hash,
+                                             shared_code_hash_key(key),
+                                             code))) {
+      FREE(code);
+      goto out;
+   }
+
+   num_shared_code++;
+
+   /* The functions are now released with the shared code */
+   memset(&p->linear_func, 0, sizeof p->linear_func);
+   memset(&p->elt_func, 0, sizeof p->elt_func);
+   memset(&p->elt16_func, 0, sizeof p->elt16_func);
+   memset(&p->elt8_func, 0, sizeof p->elt8_func);
+
+ out:
+   simple_mtx_unlock(&shared_code_mutex);
 }
 
 
 struct translate *
 translate_sse2_create(const struct translate_key *key)
 {
+   const struct translate_sse_code *code;
    struct translate_sse *p = NULL;
    unsigned i;
 
@@ -1492,6 +1754,11 @@ translate_sse2_create(const struct translate_key *key)
    memset(p, 0, sizeof(*p));
    memcpy(p->consts, consts, sizeof(consts));
 
+   /* Counted from here on, as translate_sse_release() is used on failure */
+   simple_mtx_lock(&shared_code_mutex);
+   num_translate_sse++;
+   simple_mtx_unlock(&shared_code_mutex);
+
    p->translate.key = *key;
    p->translate.release = translate_sse_release;
    p->translate.set_buffer = translate_sse_set_buffer;
@@ -1538,6 +1805,18 @@ translate_sse2_create(const struct translate_key *key)
    if (0)
       debug_printf("nr_buffers: %d\n", p->nr_buffers);
 
+   simple_mtx_lock(&shared_code_mutex);
+   code = find_shared_code(key);
+   simple_mtx_unlock(&shared_code_mutex);
+
+   if (code) {
+      p->translate.run = code->run;
+      p->translate.run_elts = code->run_elts;
+      p->translate.run_elts16 = code->run_elts16;
+      p->translate.run_elts8 = code->run_elts8;
+      return &p->translate;
+   }
+
    if (!build_vertex_emit(p, &p->linear_func, 0))
       goto fail;
 
@@ -1566,6 +1845,8 @@ translate_sse2_create(const struct translate_key *key)
    if (p->translate.run_elts8 == NULL)
       goto fail;
 
+   share_code(p);
+
    return &p->translate;
 
  fail:
@@ -457,6 +457,17 @@ lp_build_occlusion_count(struct gallivm_state *gallivm,
                                        LLVMInt32TypeInContext(context), bits);
       count = LLVMBuildZExt(builder, count, LLVMIntTypeInContext(context, 64), "");
    }
+   else if(util_cpu_caps.has_avx512f && type.length == 16) {
+      /* The sign bits compare into an AVX-512 mask register */
+      const char *popcntintr = "llvm.ctpop.i32";
+      LLVMValueRef bits = LLVMBuildICmp(builder, LLVMIntSLT, maskvalue,
+                                        lp_build_const_int_vec(gallivm, type, 0), "");
+      bits = LLVMBuildBitCast(builder, bits, LLVMInt16TypeInContext(context), "");
+      bits = LLVMBuildZExt(builder, bits, LLVMInt32TypeInContext(context), "");
+      count = lp_build_intrinsic_unary(builder, popcntintr,
+                                       LLVMInt32TypeInContext(context), bits);
+      count = LLVMBuildZExt(builder, count, LLVMIntTypeInContext(context, 64), "");
+   }
    else {
       unsigned i;
       LLVMValueRef countv = LLVMBuildAnd(builder, maskvalue, countmask, "countv");
@@ -544,8 +555,9 @@ lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
    unsigned depth_bytes = format_desc->block.bits / 8;
    struct lp_type zs_type = lp_depth_type(format_desc, z_src_type.length);
    struct lp_type zs_load_type = zs_type;
+   unsigned num_rows = z_src_type.length == 16 ? 4 : 2;
 
-   zs_load_type.length = zs_load_type.length / 2;
+   zs_load_type.length = zs_load_type.length / num_rows;
    load_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, zs_load_type), 0);
 
    if (z_src_type.length == 4) {
@@ -569,30 +581,53 @@ lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
       unsigned i;
       LLVMValueRef loopx2 = LLVMBuildShl(builder, loop_counter,
                                          lp_build_const_int32(gallivm, 1), "");
-      assert(z_src_type.length == 8);
+      assert(z_src_type.length == 8 || z_src_type.length == 16);
       depth_offset1 = LLVMBuildMul(builder, loopx2, depth_stride, "");
       /*
-       * We load 2x4 values, and need to swizzle them (order
-       * 0,1,4,5,2,3,6,7) - not so hot with avx unfortunately.
+       * We load 2x4 (or 4x4) values, and need to swizzle them (order
+       * 0,1,4,5,2,3,6,7 (,8,9,12,13,10,11,14,15)) - not so hot with avx
+       * unfortunately.
        */
-      for (i = 0; i < 8; i++) {
-         shuffles[i] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2);
+      for (i = 0; i < z_src_type.length; i++) {
+         shuffles[i] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2 + (i&8));
       }
    }
 
-   depth_offset2 = LLVMBuildAdd(builder, depth_offset1, depth_stride, "");
+   if (z_src_type.length == 16) {
+      /* Load the four rows, and make two 2x4 halves of them */
+      LLVMValueRef rows[4];
+      unsigned i;
 
-   /* Load current z/stencil values from z/stencil buffer */
-   zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset1, 1, "");
-   zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
-   zs_dst1 = LLVMBuildLoad(builder, zs_dst_ptr, "");
-   if (is_1d) {
-      zs_dst2 = lp_build_undef(gallivm, zs_load_type);
+      for (i = 0; i < 4; i++) {
+         if (is_1d && i > 0) {
+            rows[i] = lp_build_undef(gallivm, zs_load_type);
+         }
+         else {
+            LLVMValueRef offset = LLVMBuildMul(builder, depth_stride,
+                                               lp_build_const_int32(gallivm, i), "");
+            zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &offset, 1, "");
+            zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
+            rows[i] = LLVMBuildLoad(builder, zs_dst_ptr, "");
+         }
+      }
+      zs_dst1 = lp_build_concat(gallivm, &rows[0], zs_load_type, 2);
+      zs_dst2 = lp_build_concat(gallivm, &rows[2], zs_load_type, 2);
    }
    else {
-      zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset2, 1, "");
+      depth_offset2 = LLVMBuildAdd(builder, depth_offset1, depth_stride, "");
+
+      /* Load current z/stencil values from z/stencil buffer */
+      zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset1, 1, "");
       zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
-      zs_dst2 = LLVMBuildLoad(builder, zs_dst_ptr, "");
+      zs_dst1 = LLVMBuildLoad(builder, zs_dst_ptr, "");
+      if (is_1d) {
+         zs_dst2 = lp_build_undef(gallivm, zs_load_type);
+      }
+      else {
+         zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset2, 1, "");
+         zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
+         zs_dst2 = LLVMBuildLoad(builder, zs_dst_ptr, "");
+      }
    }
 
    *z_fb = LLVMBuildShuffleVector(builder, zs_dst1, zs_dst2,
@@ -683,8 +718,9 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
    struct lp_type zs_type = lp_depth_type(format_desc, z_src_type.length);
    struct lp_type z_type = zs_type;
    struct lp_type zs_load_type = zs_type;
+   unsigned num_rows = z_src_type.length == 16 ? 4 : 2;
 
-   zs_load_type.length = zs_load_type.length / 2;
+   zs_load_type.length = zs_load_type.length / num_rows;
    load_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, zs_load_type), 0);
 
    z_type.width = z_src_type.width;
@@ -710,14 +746,15 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
       unsigned i;
       LLVMValueRef loopx2 = LLVMBuildShl(builder, loop_counter,
                                          lp_build_const_int32(gallivm, 1), "");
-      assert(z_src_type.length == 8);
+      assert(z_src_type.length == 8 || z_src_type.length == 16);
       depth_offset1 = LLVMBuildMul(builder, loopx2, depth_stride, "");
       /*
-       * We load 2x4 values, and need to swizzle them (order
-       * 0,1,4,5,2,3,6,7) - not so hot with avx unfortunately.
+       * We load 2x4 (or 4x4) values, and need to swizzle them (order
+       * 0,1,4,5,2,3,6,7 (,8,9,12,13,10,11,14,15)) - not so hot with avx
+       * unfortunately.
        */
-      for (i = 0; i < 8; i++) {
-         shuffles[i] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2);
+      for (i = 0; i < z_src_type.length; i++) {
+         shuffles[i] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2 + (i&8));
       }
    }
 
@@ -747,6 +784,49 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
                                lp_build_int_vec_type(gallivm, zs_type), "");
    }
 
+   if (z_src_type.length == 16) {
+      /*
+       * Unswizzle the whole 4x4 block into rows (the swizzle is its own
+       * inverse), interleaving z and s if they share a 64 bit value.
+       */
+      LLVMValueRef zs_rows;
+      unsigned row_length = zs_load_type.length;
+      unsigned i;
+
+      if (format_desc->block.bits <= 32) {
+         zs_rows = LLVMBuildShuffleVector(builder, z_value, z_value,
+                                          LLVMConstVector(shuffles, 16), "");
+      }
+      else {
+         LLVMValueRef shuffles2[LP_MAX_VECTOR_LENGTH / 2];
+         for (i = 0; i < 16; i++) {
+            shuffles2[i*2] = shuffles[i];
+            shuffles2[i*2+1] = lp_build_const_int32(gallivm,
+                                                    (i&1) + (i&2) * 2 + (i&4) / 2 + (i&8) +
+                                                    z_src_type.length);
+         }
+         zs_rows = LLVMBuildShuffleVector(builder, z_value, s_value,
+                                          LLVMConstVector(shuffles2, 32), "");
+         row_length *= 2;
+      }
+
+      for (i = 0; i < num_rows; i++) {
+         LLVMValueRef offset = LLVMBuildMul(builder, depth_stride,
+                                            lp_build_const_int32(gallivm, i), "");
+         LLVMValueRef row = lp_build_extract_range(gallivm, zs_rows,
+                                                   i * row_length, row_length);
+         row = LLVMBuildBitCast(builder, row,
+                                lp_build_vec_type(gallivm, zs_load_type), "");
+         zs_dst_ptr1 = LLVMBuildGEP(builder, depth_ptr, &offset, 1, "");
+         zs_dst_ptr1 = LLVMBuildBitCast(builder, zs_dst_ptr1, load_ptr_type, "");
+         LLVMBuildStore(builder, row, zs_dst_ptr1);
+         if (is_1d) {
+            break;
+         }
+      }
+      return;
+   }
+
    if (format_desc->block.bits <= 32) {
       if (z_src_type.length == 4) {
          zs_dst1 = lp_build_extract_range(gallivm, z_value, 0, 2);
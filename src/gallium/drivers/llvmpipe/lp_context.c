@@ -38,6 +38,7 @@
 #include "util/u_memory.h"
 #include "util/simple_list.h"
 #include "util/u_upload_mgr.h"
+#include "util/u_debug.h"
 #include "lp_clear.h"
 #include "lp_context.h"
 #include "lp_flush.h"
@@ -46,6 +47,7 @@
 #include "lp_surface.h"
 #include "lp_query.h"
 #include "lp_setup.h"
+#include "lp_screen.h"
 
 /* This is only safe if there's just one concurrent context */
 #ifdef PIPE_SUBSYSTEM_EMBEDDED
@@ -59,6 +61,15 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
 
    lp_print_counters();
 
+#ifndef USE_GLOBAL_LLVM_CONTEXT
+   /* Shaders may still have variants being compiled */
+   if (llvmpipe->fs_compile_async) {
+      util_queue_finish(&llvmpipe->fs_compile_queue);
+      util_queue_destroy(&llvmpipe->fs_compile_queue);
+      llvmpipe->fs_compile_async = FALSE;
+   }
+#endif
+
    if (llvmpipe->blitter) {
       util_blitter_destroy(llvmpipe->blitter);
    }
@@ -95,6 +106,16 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
       }
    }
 
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->ssbos); i++) {
+      for (j = 0; j < ARRAY_SIZE(llvmpipe->ssbos[i]); j++) {
+         pipe_resource_reference(&llvmpipe->ssbos[i][j].buffer, NULL);
+      }
+   }
+
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->cs_images); i++) {
+      pipe_resource_reference(&llvmpipe->cs_images[i].resource, NULL);
+   }
+
    for (i = 0; i < llvmpipe->num_vertex_buffers; i++) {
       pipe_vertex_buffer_unreference(&llvmpipe->vertex_buffer[i]);
    }
@@ -131,6 +152,40 @@ llvmpipe_render_condition(struct pipe_context *pipe,
    llvmpipe->render_cond_cond = condition;
 }
 
+
+static void
+llvmpipe_set_debug_callback(struct pipe_context *pipe,
+                            const struct pipe_debug_callback *cb)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
+
+   if (cb)
+      llvmpipe->debug = *cb;
+   else
+      memset(&llvmpipe->debug, 0, sizeof(llvmpipe->debug));
+}
+
+
+static void
+llvmpipe_disk_cache_find_shader(void *cookie,
+                                struct lp_cached_code *cache,
+                                unsigned char ir_sha1_cache_key[20])
+{
+   lp_disk_cache_find_shader((struct llvmpipe_screen *)cookie,
+                             cache, ir_sha1_cache_key);
+}
+
+
+static void
+llvmpipe_disk_cache_insert_shader(void *cookie,
+                                  struct lp_cached_code *cache,
+                                  unsigned char ir_sha1_cache_key[20])
+{
+   lp_disk_cache_insert_shader((struct llvmpipe_screen *)cookie,
+                               cache, ir_sha1_cache_key);
+}
+
+
 struct pipe_context *
 llvmpipe_create_context(struct pipe_screen *screen, void *priv,
                         unsigned flags)
@@ -160,6 +215,7 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    llvmpipe->pipe.flush = do_flush;
 
    llvmpipe->pipe.render_condition = llvmpipe_render_condition;
+   llvmpipe->pipe.set_debug_callback = llvmpipe_set_debug_callback;
 
    llvmpipe_init_blend_funcs(llvmpipe);
    llvmpipe_init_clip_funcs(llvmpipe);
@@ -169,6 +225,7 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    llvmpipe_init_vertex_funcs(llvmpipe);
    llvmpipe_init_so_funcs(llvmpipe);
    llvmpipe_init_fs_funcs(llvmpipe);
+   llvmpipe_init_compute_funcs(llvmpipe);
    llvmpipe_init_vs_funcs(llvmpipe);
    llvmpipe_init_gs_funcs(llvmpipe);
    llvmpipe_init_rasterizer_funcs(llvmpipe);
@@ -184,6 +241,25 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    if (!llvmpipe->context)
       goto fail;
 
+#ifndef USE_GLOBAL_LLVM_CONTEXT
+   /*
+    * Fragment shader variants missing at draw time are compiled on this
+    * queue, each in its own LLVM context, while a generic variant is used.
+    */
+   {
+      unsigned num_threads = debug_get_num_option("LP_COMPILE_THREADS", 1);
+      if (num_threads > 0 &&
+          util_queue_init(&llvmpipe->fs_compile_queue, "lpfs", 32,
+                          num_threads,
+                          UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                          UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY)) {
+         llvmpipe->fs_compile_async = TRUE;
+         llvmpipe->fs_tier_up_threshold =
+            debug_get_num_option("LP_TIER_UP_THRESHOLD", 65536);
+      }
+   }
+#endif
+
    /*
     * Create drawing context and plug our rendering stage into it.
     */
@@ -192,6 +268,11 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    if (!llvmpipe->draw)
       goto fail;
 
+   draw_set_disk_cache_callbacks(llvmpipe->draw,
+                                 llvmpipe_screen(screen),
+                                 llvmpipe_disk_cache_find_shader,
+                                 llvmpipe_disk_cache_insert_shader);
+
    /* FIXME: devise alternative to draw_texture_samplers */
 
    llvmpipe->setup = lp_setup_create( &llvmpipe->pipe,
@@ -40,6 +40,7 @@
 #include "lp_jit.h"
 #include "lp_setup.h"
 #include "lp_state_fs.h"
+#include "lp_state_cs.h"
 #include "lp_state_setup.h"
 
 
@@ -48,6 +49,7 @@ struct draw_context;
 struct draw_stage;
 struct draw_vertex_shader;
 struct lp_fragment_shader;
+struct lp_compute_shader;
 struct lp_blend_state;
 struct lp_setup_context;
 struct lp_setup_variant;
@@ -67,6 +69,7 @@ struct llvmpipe_context {
    const struct lp_geometry_shader *gs;
    const struct lp_velems_state *velems;
    const struct lp_so_state *so;
+   struct lp_compute_shader *cs;
 
    /** Other rendering state */
    unsigned sample_mask;
@@ -78,6 +81,8 @@ struct llvmpipe_context {
    struct pipe_poly_stipple poly_stipple;
    struct pipe_scissor_state scissors[PIPE_MAX_VIEWPORTS];
    struct pipe_sampler_view *sampler_views[PIPE_SHADER_TYPES][PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   struct pipe_shader_buffer ssbos[PIPE_SHADER_TYPES][LP_MAX_TGSI_SHADER_BUFFERS];
+   struct pipe_image_view cs_images[PIPE_MAX_SHADER_IMAGES];
 
    struct pipe_viewport_state viewports[PIPE_MAX_VIEWPORTS];
    struct pipe_vertex_buffer vertex_buffer[PIPE_MAX_ATTRIBS];
@@ -142,6 +147,19 @@ struct llvmpipe_context {
    unsigned nr_fs_variants;
    unsigned nr_fs_instrs;
 
+   /** Background compilation of fragment shader variants */
+   struct util_queue fs_compile_queue;
+   boolean fs_compile_async;
+   /** A generic variant is bound until the specialized one is compiled */
+   boolean fs_variant_pending;
+   /** Blocks a fast tier variant shades before it is reoptimized, or 0 */
+   unsigned fs_tier_up_threshold;
+   /** The bound fast tier variant, while it isn't being reoptimized */
+   struct lp_fragment_shader_variant *fs_tier_up_variant;
+   /** Variants compiled by the draw thread, and its waits for the others */
+   unsigned nr_fs_draw_compiles;
+   unsigned nr_fs_compile_waits;
+
    struct lp_setup_variant_list_item setup_variants_list;
    unsigned nr_setup_variants;
 
@@ -150,6 +168,8 @@ struct llvmpipe_context {
    enum pipe_render_cond_flag render_cond_mode;
    boolean render_cond_cond;
 
+   struct pipe_debug_callback debug;
+
    /** The LLVMContext to use for LLVM related work */
    LLVMContextRef context;
 };
@@ -66,9 +66,18 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
       return;
    }
 
+   /* Keep checking whether the specialized fragment shader variant got
+    * compiled, to swap it in for the generic one.
+    */
+   if (lp->fs_variant_pending)
+      lp->dirty |= LP_NEW_FS_VARIANT;
+
    if (lp->dirty)
       llvmpipe_update_derived( lp );
 
+   if (lp->fs_tier_up_variant)
+      llvmpipe_fs_tier_up(lp);
+
    /*
     * Map vertex buffers
     */
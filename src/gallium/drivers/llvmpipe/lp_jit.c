@@ -33,20 +33,29 @@
  */
 
 
+#include "util/u_format.h"
 #include "util/u_memory.h"
 #include "gallivm/lp_bld_init.h"
 #include "gallivm/lp_bld_debug.h"
 #include "gallivm/lp_bld_format.h"
+#include "state_tracker/sw_winsys.h"
 #include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_memory.h"
+#include "lp_screen.h"
 #include "lp_jit.h"
 
 
-static void
-lp_jit_create_types(struct lp_fragment_shader_variant *lp)
+/**
+ * Create the LLVM type of struct lp_jit_context, shared by fragment and
+ * compute shaders.
+ */
+static LLVMTypeRef
+lp_jit_create_context_type(struct gallivm_state *gallivm)
 {
-   struct gallivm_state *gallivm = lp->gallivm;
    LLVMContextRef lc = gallivm->context;
-   LLVMTypeRef viewport_type, texture_type, sampler_type;
+   LLVMTypeRef viewport_type, texture_type, sampler_type, image_type;
+   LLVMTypeRef context_type;
 
    /* struct lp_jit_viewport */
    {
@@ -145,10 +154,45 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
                            gallivm->target, sampler_type);
    }
 
+   /* struct lp_jit_image */
+   {
+      LLVMTypeRef elem_types[LP_JIT_IMAGE_NUM_FIELDS];
+
+      elem_types[LP_JIT_IMAGE_WIDTH] =
+      elem_types[LP_JIT_IMAGE_HEIGHT] =
+      elem_types[LP_JIT_IMAGE_DEPTH] = LLVMInt32TypeInContext(lc);
+      elem_types[LP_JIT_IMAGE_BASE] = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+      elem_types[LP_JIT_IMAGE_ROW_STRIDE] =
+      elem_types[LP_JIT_IMAGE_IMG_STRIDE] = LLVMInt32TypeInContext(lc);
+
+      image_type = LLVMStructTypeInContext(lc, elem_types,
+                                           ARRAY_SIZE(elem_types), 0);
+
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, width,
+                             gallivm->target, image_type,
+                             LP_JIT_IMAGE_WIDTH);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, height,
+                             gallivm->target, image_type,
+                             LP_JIT_IMAGE_HEIGHT);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, depth,
+                             gallivm->target, image_type,
+                             LP_JIT_IMAGE_DEPTH);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, base,
+                             gallivm->target, image_type,
+                             LP_JIT_IMAGE_BASE);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, row_stride,
+                             gallivm->target, image_type,
+                             LP_JIT_IMAGE_ROW_STRIDE);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, img_stride,
+                             gallivm->target, image_type,
+                             LP_JIT_IMAGE_IMG_STRIDE);
+      LP_CHECK_STRUCT_SIZE(struct lp_jit_image,
+                           gallivm->target, image_type);
+   }
+
    /* struct lp_jit_context */
    {
       LLVMTypeRef elem_types[LP_JIT_CTX_COUNT];
-      LLVMTypeRef context_type;
 
       elem_types[LP_JIT_CTX_CONSTANTS] =
          LLVMArrayType(LLVMPointerType(LLVMFloatTypeInContext(lc), 0), LP_MAX_TGSI_CONST_BUFFERS);
@@ -164,6 +208,13 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
                                                       PIPE_MAX_SHADER_SAMPLER_VIEWS);
       elem_types[LP_JIT_CTX_SAMPLERS] = LLVMArrayType(sampler_type,
                                                       PIPE_MAX_SAMPLERS);
+      elem_types[LP_JIT_CTX_SSBOS] =
+         LLVMArrayType(LLVMPointerType(LLVMInt32TypeInContext(lc), 0),
+                       LP_MAX_TGSI_SHADER_BUFFERS);
+      elem_types[LP_JIT_CTX_NUM_SSBOS] =
+         LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TGSI_SHADER_BUFFERS);
+      elem_types[LP_JIT_CTX_IMAGES] = LLVMArrayType(image_type,
+                                                    PIPE_MAX_SHADER_IMAGES);
 
       context_type = LLVMStructTypeInContext(lc, elem_types,
                                              ARRAY_SIZE(elem_types), 0);
@@ -198,12 +249,32 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
       LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, samplers,
                              gallivm->target, context_type,
                              LP_JIT_CTX_SAMPLERS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, ssbos,
+                             gallivm->target, context_type,
+                             LP_JIT_CTX_SSBOS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, num_ssbos,
+                             gallivm->target, context_type,
+                             LP_JIT_CTX_NUM_SSBOS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, images,
+                             gallivm->target, context_type,
+                             LP_JIT_CTX_IMAGES);
       LP_CHECK_STRUCT_SIZE(struct lp_jit_context,
                            gallivm->target, context_type);
-
-      lp->jit_context_ptr_type = LLVMPointerType(context_type, 0);
    }
 
+   return context_type;
+}
+
+
+static void
+lp_jit_create_types(struct lp_fragment_shader_variant *lp)
+{
+   struct gallivm_state *gallivm = lp->gallivm;
+   LLVMContextRef lc = gallivm->context;
+
+   lp->jit_context_ptr_type =
+      LLVMPointerType(lp_jit_create_context_type(gallivm), 0);
+
    /* struct lp_jit_thread_data */
    {
       LLVMTypeRef elem_types[LP_JIT_THREAD_DATA_COUNT];
@@ -254,3 +325,211 @@ lp_jit_init_types(struct lp_fragment_shader_variant *lp)
    if (!lp->jit_context_ptr_type)
       lp_jit_create_types(lp);
 }
+
+
+static void
+lp_jit_create_cs_types(struct lp_compute_shader_variant *lp)
+{
+   struct gallivm_state *gallivm = lp->gallivm;
+   LLVMContextRef lc = gallivm->context;
+
+   lp->jit_context_ptr_type =
+      LLVMPointerType(lp_jit_create_context_type(gallivm), 0);
+
+   /* struct lp_jit_cs_thread_data */
+   {
+      LLVMTypeRef elem_types[LP_JIT_CS_THREAD_DATA_COUNT];
+      LLVMTypeRef thread_data_type;
+
+      elem_types[LP_JIT_CS_THREAD_DATA_CACHE] =
+            LLVMPointerType(lp_build_format_cache_type(gallivm), 0);
+      elem_types[LP_JIT_CS_THREAD_DATA_SHARED] =
+            LLVMPointerType(LLVMInt32TypeInContext(lc), 0);
+
+      thread_data_type = LLVMStructTypeInContext(lc, elem_types,
+                                                 ARRAY_SIZE(elem_types), 0);
+
+      lp->jit_cs_thread_data_ptr_type = LLVMPointerType(thread_data_type, 0);
+   }
+}
+
+
+void
+lp_jit_init_cs_types(struct lp_compute_shader_variant *lp)
+{
+   if (!lp->jit_context_ptr_type)
+      lp_jit_create_cs_types(lp);
+}
+
+
+/**
+ * Fill in the jit texture of a sampler view.  The caller must hold a
+ * reference to the texture for as long as the jit texture is in use.
+ */
+void
+lp_jit_texture_from_view(struct lp_jit_texture *jit_tex,
+                         const struct pipe_sampler_view *view)
+{
+   struct pipe_resource *res = view->texture;
+   struct llvmpipe_resource *lp_tex = llvmpipe_resource(res);
+
+   if (!lp_tex->dt) {
+      /* regular texture - setup array of mipmap level offsets */
+      int j;
+      unsigned first_level = 0;
+      unsigned last_level = 0;
+
+      if (llvmpipe_resource_is_texture(res)) {
+         first_level = view->u.tex.first_level;
+         last_level = view->u.tex.last_level;
+         assert(first_level <= last_level);
+         assert(last_level <= res->last_level);
+         jit_tex->base = lp_tex->tex_data;
+      }
+      else {
+        jit_tex->base = lp_tex->data;
+      }
+
+      if (LP_PERF & PERF_TEX_MEM) {
+         /* use dummy tile memory */
+         jit_tex->base = lp_dummy_tile;
+         jit_tex->width = TILE_SIZE/8;
+         jit_tex->height = TILE_SIZE/8;
+         jit_tex->depth = 1;
+         jit_tex->first_level = 0;
+         jit_tex->last_level = 0;
+         jit_tex->mip_offsets[0] = 0;
+         jit_tex->row_stride[0] = 0;
+         jit_tex->img_stride[0] = 0;
+      }
+      else {
+         jit_tex->width = res->width0;
+         jit_tex->height = res->height0;
+         jit_tex->depth = res->depth0;
+         jit_tex->first_level = first_level;
+         jit_tex->last_level = last_level;
+
+         if (llvmpipe_resource_is_texture(res)) {
+            for (j = first_level; j <= last_level; j++) {
+               jit_tex->mip_offsets[j] = lp_tex->mip_offsets[j];
+               jit_tex->row_stride[j] = lp_tex->row_stride[j];
+               jit_tex->img_stride[j] = lp_tex->img_stride[j];
+            }
+
+            if (res->target == PIPE_TEXTURE_1D_ARRAY ||
+                res->target == PIPE_TEXTURE_2D_ARRAY ||
+                res->target == PIPE_TEXTURE_CUBE ||
+                res->target == PIPE_TEXTURE_CUBE_ARRAY) {
+               /*
+                * For array textures, we don't have first_layer, instead
+                * adjust last_layer (stored as depth) plus the mip level offsets
+                * (as we have mip-first layout can't just adjust base ptr).
+                * XXX For mip levels, could do something similar.
+                */
+               jit_tex->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
+               for (j = first_level; j <= last_level; j++) {
+                  jit_tex->mip_offsets[j] += view->u.tex.first_layer *
+                                             lp_tex->img_stride[j];
+               }
+               if (view->target == PIPE_TEXTURE_CUBE ||
+                   view->target == PIPE_TEXTURE_CUBE_ARRAY) {
+                  assert(jit_tex->depth % 6 == 0);
+               }
+               assert(view->u.tex.first_layer <= view->u.tex.last_layer);
+               assert(view->u.tex.last_layer < res->array_size);
+            }
+         }
+         else {
+            /*
+             * For buffers, we don't have "offset", instead adjust
+             * the size (stored as width) plus the base pointer.
+             */
+            unsigned view_blocksize = util_format_get_blocksize(view->format);
+            /* probably don't really need to fill that out */
+            jit_tex->mip_offsets[0] = 0;
+            jit_tex->row_stride[0] = 0;
+            jit_tex->img_stride[0] = 0;
+
+            /* everything specified in number of elements here. */
+            jit_tex->width = view->u.buf.size / view_blocksize;
+            jit_tex->base = (uint8_t *)jit_tex->base + view->u.buf.offset;
+            /* XXX Unsure if we need to sanitize parameters? */
+            assert(view->u.buf.offset + view->u.buf.size <= res->width0);
+         }
+      }
+   }
+   else {
+      /* display target texture/surface */
+      /*
+       * XXX: Where should this be unmapped?
+       */
+      struct llvmpipe_screen *screen = llvmpipe_screen(res->screen);
+      struct sw_winsys *winsys = screen->winsys;
+      jit_tex->base = winsys->displaytarget_map(winsys, lp_tex->dt,
+                                                PIPE_TRANSFER_READ);
+      jit_tex->row_stride[0] = lp_tex->row_stride[0];
+      jit_tex->img_stride[0] = lp_tex->img_stride[0];
+      jit_tex->mip_offsets[0] = 0;
+      jit_tex->width = res->width0;
+      jit_tex->height = res->height0;
+      jit_tex->depth = res->depth0;
+      jit_tex->first_level = jit_tex->last_level = 0;
+      assert(jit_tex->base);
+   }
+}
+
+
+/**
+ * Fill in the jit image of a shader image view.  The caller must hold a
+ * reference to the resource for as long as the jit image is in use.
+ */
+void
+lp_jit_image_from_view(struct lp_jit_image *jit_image,
+                       const struct pipe_image_view *view)
+{
+   struct pipe_resource *res = view->resource;
+   struct llvmpipe_resource *lp_res = llvmpipe_resource(res);
+
+   if (!llvmpipe_resource_is_texture(res)) {
+      /* everything specified in number of elements here. */
+      unsigned view_blocksize = util_format_get_blocksize(view->format);
+
+      jit_image->base = (uint8_t *)lp_res->data + view->u.buf.offset;
+      jit_image->width = view->u.buf.size / view_blocksize;
+      jit_image->height = 1;
+      jit_image->depth = 1;
+      jit_image->row_stride = 0;
+      jit_image->img_stride = 0;
+      assert(view->u.buf.offset + view->u.buf.size <= res->width0);
+   }
+   else if (lp_res->dt) {
+      /* display target texture/surface, see lp_jit_texture_from_view() */
+      struct llvmpipe_screen *screen = llvmpipe_screen(res->screen);
+      struct sw_winsys *winsys = screen->winsys;
+
+      jit_image->base = winsys->displaytarget_map(winsys, lp_res->dt,
+                                                  PIPE_TRANSFER_READ_WRITE);
+      jit_image->width = res->width0;
+      jit_image->height = res->height0;
+      jit_image->depth = 1;
+      jit_image->row_stride = lp_res->row_stride[0];
+      jit_image->img_stride = lp_res->img_stride[0];
+      assert(jit_image->base);
+   }
+   else {
+      /* the view accesses one level, from its first layer */
+      unsigned level = view->u.tex.level;
+
+      assert(level <= res->last_level);
+      assert(view->u.tex.first_layer <= view->u.tex.last_layer);
+
+      jit_image->base = (uint8_t *)lp_res->tex_data +
+                        lp_res->mip_offsets[level] +
+                        view->u.tex.first_layer * lp_res->img_stride[level];
+      jit_image->width = u_minify(res->width0, level);
+      jit_image->height = u_minify(res->height0, level);
+      jit_image->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
+      jit_image->row_stride = lp_res->row_stride[level];
+      jit_image->img_stride = lp_res->img_stride[level];
+   }
+}
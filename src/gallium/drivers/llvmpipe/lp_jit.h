@@ -45,6 +45,7 @@
 
 struct lp_build_format_cache;
 struct lp_fragment_shader_variant;
+struct lp_compute_shader_variant;
 struct llvmpipe_screen;
 
 
@@ -62,6 +63,17 @@ struct lp_jit_texture
 };
 
 
+struct lp_jit_image
+{
+   uint32_t width;        /* same as number of elements */
+   uint32_t height;
+   uint32_t depth;        /* doubles as array size */
+   const void *base;      /* first layer of the level */
+   uint32_t row_stride;
+   uint32_t img_stride;
+};
+
+
 struct lp_jit_sampler
 {
    float min_lod;
@@ -92,6 +104,17 @@ enum {
 };
 
 
+enum {
+   LP_JIT_IMAGE_WIDTH = 0,
+   LP_JIT_IMAGE_HEIGHT,
+   LP_JIT_IMAGE_DEPTH,
+   LP_JIT_IMAGE_BASE,
+   LP_JIT_IMAGE_ROW_STRIDE,
+   LP_JIT_IMAGE_IMG_STRIDE,
+   LP_JIT_IMAGE_NUM_FIELDS  /* number of fields above */
+};
+
+
 enum {
    LP_JIT_SAMPLER_MIN_LOD,
    LP_JIT_SAMPLER_MAX_LOD,
@@ -135,6 +158,11 @@ struct lp_jit_context
 
    struct lp_jit_texture textures[PIPE_MAX_SHADER_SAMPLER_VIEWS];
    struct lp_jit_sampler samplers[PIPE_MAX_SAMPLERS];
+
+   const uint32_t *ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+   int num_ssbos[LP_MAX_TGSI_SHADER_BUFFERS];  /* in bytes */
+
+   struct lp_jit_image images[PIPE_MAX_SHADER_IMAGES];
 };
 
 
@@ -153,6 +181,9 @@ enum {
    LP_JIT_CTX_VIEWPORTS,
    LP_JIT_CTX_TEXTURES,
    LP_JIT_CTX_SAMPLERS,
+   LP_JIT_CTX_SSBOS,
+   LP_JIT_CTX_NUM_SSBOS,
+   LP_JIT_CTX_IMAGES,
    LP_JIT_CTX_COUNT
 };
 
@@ -187,6 +218,15 @@ enum {
 #define lp_jit_context_samplers(_gallivm, _ptr) \
    lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_SAMPLERS, "samplers")
 
+#define lp_jit_context_ssbos(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_SSBOS, "ssbos")
+
+#define lp_jit_context_num_ssbos(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_NUM_SSBOS, "num_ssbos")
+
+#define lp_jit_context_images(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_IMAGES, "images")
+
 
 struct lp_jit_thread_data
 {
@@ -259,6 +299,62 @@ typedef void
                     unsigned depth_stride);
 
 
+
+/**
+ * Per-thread data of the compute shaders.  The cache must stay the first
+ * member, like in lp_jit_thread_data, for the texture sampling code.
+ */
+struct lp_jit_cs_thread_data
+{
+   struct lp_build_format_cache *cache;
+   void *shared;
+};
+
+
+enum {
+   LP_JIT_CS_THREAD_DATA_CACHE = 0,
+   LP_JIT_CS_THREAD_DATA_SHARED,
+   LP_JIT_CS_THREAD_DATA_COUNT
+};
+
+
+#define lp_jit_cs_thread_data_cache(_gallivm, _ptr) \
+   lp_build_struct_get(_gallivm, _ptr, LP_JIT_CS_THREAD_DATA_CACHE, "cache")
+
+#define lp_jit_cs_thread_data_shared(_gallivm, _ptr) \
+   lp_build_struct_get(_gallivm, _ptr, LP_JIT_CS_THREAD_DATA_SHARED, "shared")
+
+
+/**
+ * typedef for compute shader function, which runs all the invocations of
+ * one workgroup.
+ *
+ * @param context       jit context
+ * @param x             workgroup id x
+ * @param y             workgroup id y
+ * @param z             workgroup id z
+ * @param grid_x        number of workgroups in x
+ * @param grid_y        number of workgroups in y
+ * @param grid_z        number of workgroups in z
+ * @param block_x       workgroup size x
+ * @param block_y       workgroup size y
+ * @param block_z       workgroup size z
+ * @param thread_data   task thread data
+ */
+typedef void
+(*lp_jit_cs_func)(const struct lp_jit_context *context,
+                  uint32_t x,
+                  uint32_t y,
+                  uint32_t z,
+                  uint32_t grid_x,
+                  uint32_t grid_y,
+                  uint32_t grid_z,
+                  uint32_t block_x,
+                  uint32_t block_y,
+                  uint32_t block_z,
+                  struct lp_jit_cs_thread_data *thread_data);
+
+
 void
 lp_jit_screen_cleanup(struct llvmpipe_screen *screen);
 
@@ -271,4 +367,17 @@ void
 lp_jit_init_types(struct lp_fragment_shader_variant *lp);
 
 
+void
+lp_jit_init_cs_types(struct lp_compute_shader_variant *lp);
+
+
+void
+lp_jit_texture_from_view(struct lp_jit_texture *jit_tex,
+                         const struct pipe_sampler_view *view);
+
+void
+lp_jit_image_from_view(struct lp_jit_image *jit_image,
+                       const struct pipe_image_view *view);
+
+
 #endif /* LP_JIT_H */
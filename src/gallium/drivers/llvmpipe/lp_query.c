@@ -48,6 +48,52 @@ static struct llvmpipe_query *llvmpipe_query( struct pipe_query *p )
    return (struct llvmpipe_query *)p;
 }
 
+
+/**
+ * Current value of the counter behind a driver specific query.
+ */
+static uint64_t
+get_driver_count(struct llvmpipe_context *llvmpipe, unsigned type)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(llvmpipe->pipe.screen);
+   const struct lp_setup_stats *stats = lp_setup_get_stats(llvmpipe->setup);
+   uint64_t count = 0, num_indices, num_shaded;
+   unsigned i;
+
+   switch (type) {
+   case LP_QUERY_BIN_TIME:
+      return stats->bin_time;
+   case LP_QUERY_RAST_TIME:
+      for (i = 0; i < MAX2(1, screen->num_threads); i++)
+         count += lp_rast_get_thread_time(screen->rast, i);
+      return count;
+   case LP_QUERY_COMPILE_TIME:
+      return p_atomic_read(&screen->compile_time);
+   case LP_QUERY_NUM_COMPILES:
+      return p_atomic_read(&screen->num_compiles);
+   case LP_QUERY_NUM_FLUSHES:
+      return stats->num_flushes;
+   case LP_QUERY_NUM_EXPLICIT_FLUSHES:
+      return stats->num_explicit_flushes;
+   case LP_QUERY_NUM_SCENE_SIZE_FLUSHES:
+      return stats->num_scene_size_flushes;
+   case LP_QUERY_NUM_RESOURCE_SIZE_FLUSHES:
+      return stats->num_resource_size_flushes;
+   case LP_QUERY_NUM_OOM_FLUSHES:
+      return stats->num_oom_flushes;
+   case LP_QUERY_NUM_INDEXED_VERTICES:
+      draw_get_vertex_cache_stats(llvmpipe->draw, &num_indices, &num_shaded);
+      return num_indices;
+   case LP_QUERY_NUM_SHADED_VERTICES:
+      draw_get_vertex_cache_stats(llvmpipe->draw, &num_indices, &num_shaded);
+      return num_shaded;
+   default:
+      assert(type >= LP_QUERY_RAST_TIME_THREAD0 && type < LP_QUERY_LAST);
+      return lp_rast_get_thread_time(screen->rast,
+                                     type - LP_QUERY_RAST_TIME_THREAD0);
+   }
+}
+
 static struct pipe_query *
 llvmpipe_create_query(struct pipe_context *pipe, 
                       unsigned type,
@@ -55,7 +101,8 @@ llvmpipe_create_query(struct pipe_context *pipe,
 {
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          (type >= PIPE_QUERY_DRIVER_SPECIFIC && type < LP_QUERY_LAST));
 
    pq = CALLOC_STRUCT( llvmpipe_query );
 
@@ -101,6 +148,17 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
    uint64_t *result = (uint64_t *)vresult;
    int i;
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      /* Counters are read on the CPU, the result is always available */
+      *result = pq->driver_count;
+      if (pq->type == LP_QUERY_BIN_TIME ||
+          pq->type == LP_QUERY_RAST_TIME ||
+          pq->type == LP_QUERY_COMPILE_TIME ||
+          pq->type >= LP_QUERY_RAST_TIME_THREAD0)
+         *result /= 1000;  /* nanoseconds to microseconds */
+      return TRUE;
+   }
+
    if (pq->fence) {
       /* only have a fence if there was a scene */
       if (!lp_fence_signalled(pq->fence)) {
@@ -192,6 +250,11 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      pq->driver_count = get_driver_count(llvmpipe, pq->type);
+      return true;
+   }
+
    /* Check if the query is already in the scene.  If so, we need to
     * flush the scene now.  Real apps shouldn't re-use a query in a
     * frame of rendering.
@@ -249,6 +312,12 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      pq->driver_count = get_driver_count(llvmpipe, pq->type) -
+                         pq->driver_count;
+      return true;
+   }
+
    lp_setup_end_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -291,6 +360,8 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
          llvmpipe->pipeline_statistics.c_primitives - pq->stats.c_primitives;
       pq->stats.ps_invocations =
          llvmpipe->pipeline_statistics.ps_invocations - pq->stats.ps_invocations;
+      pq->stats.cs_invocations =
+         llvmpipe->pipeline_statistics.cs_invocations - pq->stats.cs_invocations;
 
       llvmpipe->active_statistics_queries--;
       break;
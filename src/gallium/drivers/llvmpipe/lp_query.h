@@ -35,12 +35,35 @@
 
 #include <limits.h>
 #include "os/os_thread.h"
+#include "pipe/p_defines.h"
 #include "lp_limits.h"
 
 
 struct llvmpipe_context;
 
 
+/**
+ * Driver specific queries, for the HUD and GL_AMD_performance_monitor.
+ * All the times are in nanoseconds.
+ */
+enum lp_query_type {
+   LP_QUERY_BIN_TIME = PIPE_QUERY_DRIVER_SPECIFIC,
+   LP_QUERY_RAST_TIME,
+   LP_QUERY_COMPILE_TIME,
+   LP_QUERY_NUM_COMPILES,
+   LP_QUERY_NUM_FLUSHES,
+   LP_QUERY_NUM_EXPLICIT_FLUSHES,
+   LP_QUERY_NUM_SCENE_SIZE_FLUSHES,
+   LP_QUERY_NUM_RESOURCE_SIZE_FLUSHES,
+   LP_QUERY_NUM_OOM_FLUSHES,
+   LP_QUERY_NUM_INDEXED_VERTICES,
+   LP_QUERY_NUM_SHADED_VERTICES,
+   /** One query per rasterizer thread */
+   LP_QUERY_RAST_TIME_THREAD0,
+   LP_QUERY_LAST = LP_QUERY_RAST_TIME_THREAD0 + LP_MAX_THREADS
+};
+
+
 struct llvmpipe_query {
    uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
    uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
@@ -48,6 +71,7 @@ struct llvmpipe_query {
    unsigned type;                   /* PIPE_QUERY_* */
    unsigned num_primitives_generated;
    unsigned num_primitives_written;
+   uint64_t driver_count;           /* LP_QUERY_x counter value */
 
    struct pipe_query_data_pipeline_statistics stats;
 };
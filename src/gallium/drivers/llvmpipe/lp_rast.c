@@ -26,6 +26,8 @@
  **************************************************************************/
 
 #include <limits.h>
+#include <float.h>
+#include "util/u_format.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/u_rect.h"
@@ -33,6 +35,8 @@
 #include "util/u_pack_color.h"
 #include "util/u_string.h"
 #include "util/u_thread.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_atomic.h"
 
 #include "util/os_time.h"
 
@@ -70,16 +74,360 @@ lp_rast_begin( struct lp_rasterizer *rast,
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   lp_scene_bin_iter_begin( scene, MAX2(1, rast->num_threads) );
 }
 
 
 static void
 lp_rast_end( struct lp_rasterizer *rast )
 {
-   lp_scene_end_rasterization( rast->curr_scene );
+   struct lp_scene *scene = rast->curr_scene;
+   struct lp_fence *fence = NULL;
+
+   lp_scene_end_rasterization( scene );
 
    rast->curr_scene = NULL;
+
+   /* Setup may reset the scene and drop its fence reference as soon as the
+    * fence is signalled, so hold our own reference while signalling.
+    */
+   lp_fence_reference(&fence, scene->fence);
+   if (fence) {
+      lp_fence_signal(fence);
+      lp_fence_reference(&fence, NULL);
+   }
+}
+
+
+/*
+ * Hierarchical Z.
+ *
+ * Each task keeps bounds of the depth values stored in the 16x16 blocks of
+ * its current tile, so that blocks where the depth test fails for the whole
+ * primitive are dropped before running the fragment shader.  The bounds are
+ * set by clears, widened by the depth writes of the primitives shaded, and
+ * otherwise computed from the depth buffer when a block is first tested.
+ */
+
+
+/**
+ * Set up hierarchical Z for a new tile.  Nothing is known about the depth
+ * buffer contents, as they may have changed since the last scene.
+ */
+static void
+hiz_tile_begin(struct lp_rasterizer_task *task)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const struct lp_scene *scene = task->scene;
+   const struct util_format_description *format_desc;
+   unsigned z_swizzle, size;
+
+   hiz->enabled = FALSE;
+   hiz->valid = 0;
+
+   if (!scene->fb.zsbuf || !scene->zsbuf.map || (LP_PERF & PERF_NO_HIZ))
+      return;
+
+   format_desc = util_format_description(scene->fb.zsbuf->format);
+   z_swizzle = format_desc->swizzle[0];
+   if (z_swizzle >= 4)
+      return;
+
+   size = format_desc->channel[z_swizzle].size;
+   hiz->shift = format_desc->channel[z_swizzle].shift;
+   hiz->mask = (1ULL << size) - 1;
+
+   if (format_desc->channel[z_swizzle].type == UTIL_FORMAT_TYPE_FLOAT) {
+      if (size != 32)
+         return;
+      hiz->is_float = TRUE;
+      hiz->scale = 1.0f;
+      hiz->eps = 0.0f;
+   }
+   else {
+      /* Depth is converted to unorm with rounding */
+      hiz->is_float = FALSE;
+      hiz->scale = (float) (1.0 / (double) hiz->mask);
+      hiz->eps = 2.0f * hiz->scale + 2.0f * FLT_EPSILON;
+   }
+
+   hiz->enabled = TRUE;
+}
+
+
+static inline float
+hiz_decode(const struct lp_rast_hiz *hiz, uint64_t zs)
+{
+   uint64_t z = (zs >> hiz->shift) & hiz->mask;
+
+   if (hiz->is_float) {
+      union fi fi;
+      fi.ui = (uint32_t) z;
+      return fi.f;
+   }
+
+   return (float) z * hiz->scale;
+}
+
+
+/**
+ * Compute the depth bounds of a block from the depth buffer.
+ */
+static void
+hiz_scan_block(struct lp_rasterizer_task *task, unsigned block)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const struct lp_scene *scene = task->scene;
+   const unsigned format_bytes = scene->zsbuf.format_bytes;
+   const unsigned stride = scene->zsbuf.stride;
+   const unsigned bx = (block & 3) * 16;
+   const unsigned by = (block >> 2) * 16;
+   const unsigned width = bx < task->width ? MIN2(16, task->width - bx) : 0;
+   const unsigned height = by < task->height ? MIN2(16, task->height - by) : 0;
+   const uint8_t *row = task->depth_tile + by * stride + bx * format_bytes;
+   float zmin = FLT_MAX, zmax = -FLT_MAX;
+   unsigned i, j;
+
+   for (i = 0; i < height; i++) {
+      for (j = 0; j < width; j++) {
+         uint64_t zs;
+         float z;
+
+         switch (format_bytes) {
+         case 2:
+            zs = ((const uint16_t *) row)[j];
+            break;
+         case 4:
+            zs = ((const uint32_t *) row)[j];
+            break;
+         case 8:
+            zs = ((const uint64_t *) row)[j];
+            break;
+         default:
+            assert(0);
+            zs = 0;
+            break;
+         }
+
+         z = hiz_decode(hiz, zs);
+         zmin = MIN2(zmin, z);
+         zmax = MAX2(zmax, z);
+      }
+      row += stride;
+   }
+
+   hiz->zmin[block] = zmin;
+   hiz->zmax[block] = zmax;
+   hiz->valid |= 1 << block;
+}
+
+
+/**
+ * Mask of the 16x16 blocks of the current tile covered by a rectangle
+ * within it.
+ */
+static inline unsigned
+hiz_blocks(const struct lp_rasterizer_task *task,
+           int x, int y, unsigned width, unsigned height)
+{
+   const unsigned bx0 = (x - task->x) / 16;
+   const unsigned by0 = (y - task->y) / 16;
+   const unsigned bx1 = MIN2((x - task->x + width - 1) / 16, 3);
+   const unsigned by1 = MIN2((y - task->y + height - 1) / 16, 3);
+   const unsigned row = ((2 << bx1) - 1) & ~((1 << bx0) - 1);
+   unsigned blocks = 0;
+   unsigned by;
+
+   for (by = by0; by <= by1; by++)
+      blocks |= row << (by * 4);
+
+   return blocks;
+}
+
+
+/**
+ * Conservative bounds of the depth of a primitive's fragments within a
+ * rectangle, evaluated from the position z plane at the rectangle's
+ * corners.
+ */
+static void
+hiz_primitive_bounds(const struct lp_rasterizer_task *task,
+                     const struct lp_rast_shader_inputs *inputs,
+                     int x, int y, unsigned width, unsigned height,
+                     float *zmin, float *zmax)
+{
+   const struct lp_rast_hiz *hiz = &task->hiz;
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+   const float a0 = GET_A0(inputs)[0][2];
+   const float dzdx = GET_DADX(inputs)[0][2];
+   const float dzdy = GET_DADY(inputs)[0][2];
+   const float zx0 = dzdx * (float) x;
+   const float zx1 = dzdx * (float) (x + width);
+   const float zy0 = dzdy * (float) y;
+   const float zy1 = dzdy * (float) (y + height);
+   float lo, hi, slack;
+
+   lo = a0 + MIN2(zx0, zx1) + MIN2(zy0, zy1);
+   hi = a0 + MAX2(zx0, zx1) + MAX2(zy0, zy1);
+
+   /* The shader evaluates the plane in a different order */
+   slack = (fabsf(a0) + MAX2(fabsf(zx0), fabsf(zx1)) +
+            MAX2(fabsf(zy0), fabsf(zy1))) * 8.0f * FLT_EPSILON + hiz->eps;
+   lo -= slack;
+   hi += slack;
+
+   if (variant->key.depth_clamp) {
+      const struct lp_jit_viewport *viewport =
+         &task->state->jit_context.viewports[inputs->viewport_index];
+      lo = CLAMP(lo, viewport->min_depth, viewport->max_depth);
+      hi = CLAMP(hi, viewport->min_depth, viewport->max_depth);
+   }
+
+   if (!hiz->is_float) {
+      lo = CLAMP(lo, 0.0f, 1.0f);
+      hi = CLAMP(hi, 0.0f, 1.0f);
+   }
+
+   *zmin = lo;
+   *zmax = hi;
+}
+
+
+/**
+ * Whether the depth test fails for all fragments of a primitive within a
+ * rectangle of the current tile, so that it needn't be shaded.
+ */
+boolean
+lp_rast_hiz_reject(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs,
+                   int x, int y, unsigned width, unsigned height)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+   float fb_zmin = FLT_MAX, fb_zmax = -FLT_MAX;
+   float zmin, zmax;
+   unsigned blocks, missing;
+   boolean reject;
+
+   if (!hiz->enabled || !variant->hiz_test || inputs->layer != 0)
+      return FALSE;
+
+   blocks = hiz_blocks(task, x, y, width, height);
+
+   missing = blocks & ~hiz->valid;
+   while (missing) {
+      hiz_scan_block(task, u_bit_scan(&missing));
+   }
+
+   while (blocks) {
+      unsigned i = u_bit_scan(&blocks);
+      fb_zmin = MIN2(fb_zmin, hiz->zmin[i]);
+      fb_zmax = MAX2(fb_zmax, hiz->zmax[i]);
+   }
+
+   hiz_primitive_bounds(task, inputs, x, y, width, height, &zmin, &zmax);
+
+   switch (variant->key.depth.func) {
+   case PIPE_FUNC_LESS:
+   case PIPE_FUNC_LEQUAL:
+      reject = zmin > fb_zmax;
+      break;
+   case PIPE_FUNC_GREATER:
+   case PIPE_FUNC_GEQUAL:
+      reject = zmax < fb_zmin;
+      break;
+   default:
+      reject = FALSE;
+      break;
+   }
+
+   if (reject)
+      LP_COUNT(nr_hiz_rejected);
+
+   return reject;
+}
+
+
+/**
+ * Account for the depth writes of a primitive shaded within a rectangle
+ * of the current tile.
+ */
+void
+lp_rast_hiz_update(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs,
+                   int x, int y, unsigned width, unsigned height)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+   const struct pipe_depth_state *depth = &variant->key.depth;
+   float zmin, zmax;
+   unsigned blocks;
+
+   if (!hiz->enabled || inputs->layer != 0 ||
+       !depth->enabled || !depth->writemask)
+      return;
+
+   blocks = hiz_blocks(task, x, y, width, height) & hiz->valid;
+   if (!blocks)
+      return;
+
+   if (variant->writes_z) {
+      hiz->valid &= ~blocks;
+      return;
+   }
+
+   hiz_primitive_bounds(task, inputs, x, y, width, height, &zmin, &zmax);
+
+   while (blocks) {
+      unsigned i = u_bit_scan(&blocks);
+
+      /* Values which pass a less/greater test only move in one direction */
+      switch (depth->func) {
+      case PIPE_FUNC_NEVER:
+      case PIPE_FUNC_EQUAL:
+         break;
+      case PIPE_FUNC_LESS:
+      case PIPE_FUNC_LEQUAL:
+         hiz->zmin[i] = MIN2(hiz->zmin[i], zmin);
+         break;
+      case PIPE_FUNC_GREATER:
+      case PIPE_FUNC_GEQUAL:
+         hiz->zmax[i] = MAX2(hiz->zmax[i], zmax);
+         break;
+      default:
+         hiz->zmin[i] = MIN2(hiz->zmin[i], zmin);
+         hiz->zmax[i] = MAX2(hiz->zmax[i], zmax);
+         break;
+      }
+   }
+}
+
+
+/**
+ * Update hierarchical Z for a clear of the current tile.
+ */
+static void
+hiz_clear(struct lp_rasterizer_task *task,
+          uint64_t clear_value, uint64_t clear_mask)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const uint64_t z_mask = hiz->mask << hiz->shift;
+   unsigned i;
+
+   if (!hiz->enabled)
+      return;
+
+   if ((clear_mask & z_mask) == z_mask) {
+      const float z = hiz_decode(hiz, clear_value);
+      for (i = 0; i < 16; i++) {
+         hiz->zmin[i] = z;
+         hiz->zmax[i] = z;
+      }
+      hiz->valid = 0xffff;
+   }
+   else if (clear_mask & z_mask) {
+      hiz->valid = 0;
+   }
 }
 
 
@@ -121,6 +469,8 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
                          scene->zsbuf.stride * task->y +
                          scene->zsbuf.format_bytes * task->x;
    }
+
+   hiz_tile_begin(task);
 }
 
 
@@ -281,6 +631,8 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
          }
          dst_layer += scene->zsbuf.layer_stride;
       }
+
+      hiz_clear(task, arg.clear_zstencil.value, clear_mask64);
    }
 }
 
@@ -300,7 +652,7 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    const struct lp_rast_state *state;
    struct lp_fragment_shader_variant *variant;
    const unsigned tile_x = task->x, tile_y = task->y;
-   unsigned x, y;
+   unsigned x, y, bx, by;
 
    if (inputs->disable) {
       /* This command was partially binned and has been disabled */
@@ -316,53 +668,74 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    }
    variant = state->variant;
 
-   /* render the whole 64x64 tile in 4x4 chunks */
-   for (y = 0; y < task->height; y += 4){
-      for (x = 0; x < task->width; x += 4) {
-         uint8_t *color[PIPE_MAX_COLOR_BUFS];
-         unsigned stride[PIPE_MAX_COLOR_BUFS];
-         uint8_t *depth = NULL;
-         unsigned depth_stride = 0;
-         unsigned i;
-
-         /* color buffer */
-         for (i = 0; i < scene->fb.nr_cbufs; i++){
-            if (scene->fb.cbufs[i]) {
-               stride[i] = scene->cbufs[i].stride;
-               color[i] = lp_rast_get_color_block_pointer(task, i, tile_x + x,
-                                                          tile_y + y, inputs->layer);
-            }
-            else {
-               stride[i] = 0;
-               color[i] = NULL;
-            }
-         }
+   /* render the whole 64x64 tile in 4x4 chunks, 16x16 blocks at a time */
+   for (by = 0; by < task->height; by += 16) {
+      for (bx = 0; bx < task->width; bx += 16) {
+         const unsigned x_end = MIN2(bx + 16, task->width);
+         const unsigned y_end = MIN2(by + 16, task->height);
+
+         if (lp_rast_hiz_reject(task, inputs, tile_x + bx, tile_y + by,
+                                16, 16))
+            continue;
+
+         lp_rast_count_invocations(task, variant,
+                                   ((x_end - bx + 3) / 4) *
+                                   ((y_end - by + 3) / 4));
+
+         for (y = by; y < y_end; y += 4) {
+            for (x = bx; x < x_end; x += 4) {
+               uint8_t *color[PIPE_MAX_COLOR_BUFS];
+               unsigned stride[PIPE_MAX_COLOR_BUFS];
+               uint8_t *depth = NULL;
+               unsigned depth_stride = 0;
+               unsigned i;
+
+               /* color buffer */
+               for (i = 0; i < scene->fb.nr_cbufs; i++){
+                  if (scene->fb.cbufs[i]) {
+                     stride[i] = scene->cbufs[i].stride;
+                     color[i] = lp_rast_get_color_block_pointer(task, i,
+                                                                tile_x + x,
+                                                                tile_y + y,
+                                                                inputs->layer);
+                  }
+                  else {
+                     stride[i] = 0;
+                     color[i] = NULL;
+                  }
+               }
 
-         /* depth buffer */
-         if (scene->zsbuf.map) {
-            depth = lp_rast_get_depth_block_pointer(task, tile_x + x,
-                                                    tile_y + y, inputs->layer);
-            depth_stride = scene->zsbuf.stride;
-         }
+               /* depth buffer */
+               if (scene->zsbuf.map) {
+                  depth = lp_rast_get_depth_block_pointer(task, tile_x + x,
+                                                          tile_y + y,
+                                                          inputs->layer);
+                  depth_stride = scene->zsbuf.stride;
+               }
 
-         /* Propagate non-interpolated raster state. */
-         task->thread_data.raster_state.viewport_index = inputs->viewport_index;
+               /* Propagate non-interpolated raster state. */
+               task->thread_data.raster_state.viewport_index =
+                  inputs->viewport_index;
+
+               /* run shader on 4x4 block */
+               BEGIN_JIT_CALL(state, task);
+               variant->jit_function[RAST_WHOLE]( &state->jit_context,
+                                                  tile_x + x, tile_y + y,
+                                                  inputs->frontfacing,
+                                                  GET_A0(inputs),
+                                                  GET_DADX(inputs),
+                                                  GET_DADY(inputs),
+                                                  color,
+                                                  depth,
+                                                  0xffff,
+                                                  &task->thread_data,
+                                                  stride,
+                                                  depth_stride);
+               END_JIT_CALL();
+            }
+         }
 
-         /* run shader on 4x4 block */
-         BEGIN_JIT_CALL(state, task);
-         variant->jit_function[RAST_WHOLE]( &state->jit_context,
-                                            tile_x + x, tile_y + y,
-                                            inputs->frontfacing,
-                                            GET_A0(inputs),
-                                            GET_DADX(inputs),
-                                            GET_DADY(inputs),
-                                            color,
-                                            depth,
-                                            0xffff,
-                                            &task->thread_data,
-                                            stride,
-                                            depth_stride);
-         END_JIT_CALL();
+         lp_rast_hiz_update(task, inputs, tile_x + bx, tile_y + by, 16, 16);
       }
    }
 }
@@ -449,6 +822,8 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
       /* Propagate non-interpolated raster state. */
       task->thread_data.raster_state.viewport_index = inputs->viewport_index;
 
+      lp_rast_count_invocations(task, variant, 1);
+
       /* run shader on 4x4 block */
       BEGIN_JIT_CALL(state, task);
       variant->jit_function[RAST_EDGE_TEST](&state->jit_context,
@@ -662,6 +1037,8 @@ static void
 rasterize_scene(struct lp_rasterizer_task *task,
                 struct lp_scene *scene)
 {
+   const int64_t t0 = os_time_get_nano();
+
    task->scene = scene;
 
    /* Clear the cache tags. This should not always be necessary but
@@ -682,7 +1059,8 @@ rasterize_scene(struct lp_rasterizer_task *task,
          int i, j;
 
          assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
+         while ((bin = lp_scene_bin_iter_next(scene, task->thread_index,
+                                             &i, &j))) {
             if (!is_empty_bin( bin ))
                rasterize_bin(task, bin, i, j);
          }
@@ -704,11 +1082,64 @@ rasterize_scene(struct lp_rasterizer_task *task,
    }
 #endif
 
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
-   }
+   /* The variants may be freed once the scene is done */
+   lp_rast_flush_invocations(task);
 
    task->scene = NULL;
+
+   p_atomic_add(&task->rast_time, os_time_get_nano() - t0);
+}
+
+
+/**
+ * Run the workgroups of a compute job.  All the threads take workgroups
+ * from the job until there are none left.
+ */
+static void
+run_cs_job(struct lp_rasterizer_task *task,
+           struct lp_rast_cs_job *job)
+{
+   uint64_t block;
+
+   if (job->shared_size > task->cs_shared_size) {
+      align_free(task->cs_thread_data.shared);
+      task->cs_thread_data.shared = align_malloc(job->shared_size, 16);
+      if (!task->cs_thread_data.shared) {
+         /* Leave the workgroups to the threads that have the memory.  The
+          * submitter reports the ones nobody could run.
+          */
+         task->cs_shared_size = 0;
+         return;
+      }
+      task->cs_shared_size = job->shared_size;
+   }
+   task->cs_thread_data.cache = task->thread_data.cache;
+
+   while ((block = p_atomic_inc_return(&job->next_block) - 1) <
+          job->num_blocks) {
+      unsigned x = block % job->grid_size[0];
+      unsigned y = (block / job->grid_size[0]) % job->grid_size[1];
+      unsigned z = block / ((uint64_t) job->grid_size[0] * job->grid_size[1]);
+
+      BEGIN_JIT_CALL(NULL, task);
+      job->jit_func(job->jit_context, x, y, z,
+                    job->grid_size[0], job->grid_size[1], job->grid_size[2],
+                    job->block_size[0], job->block_size[1], job->block_size[2],
+                    &task->cs_thread_data);
+      END_JIT_CALL();
+   }
+}
+
+
+/**
+ * Return the time the given thread has spent rasterizing scenes, in
+ * nanoseconds.
+ */
+uint64_t
+lp_rast_get_thread_time( struct lp_rasterizer *rast,
+                         unsigned thread_index )
+{
+   return p_atomic_read(&rast->tasks[thread_index].rast_time);
 }
 
 
@@ -756,18 +1187,34 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 }
 
 
+/**
+ * Queue a compute job.  Its fence gets signalled once all its workgroups
+ * have run, and the job must stay alive until then.
+ */
 void
-lp_rast_finish( struct lp_rasterizer *rast )
+lp_rast_queue_cs_job( struct lp_rasterizer *rast,
+                      struct lp_rast_cs_job *job )
 {
+   job->next_block = 0;
+
    if (rast->num_threads == 0) {
-      /* nothing to do */
+      unsigned fpstate = util_fpstate_get();
+
+      util_fpstate_set_denorms_to_zero(fpstate);
+
+      run_cs_job( &rast->tasks[0], job );
+
+      util_fpstate_set(fpstate);
+
+      lp_fence_signal(job->fence);
    }
    else {
-      int i;
+      unsigned i;
+
+      lp_scene_enqueue_cs_job( rast->full_scenes, job );
 
-      /* wait for work to complete */
       for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_wait(&rast->tasks[i].work_done);
+         pipe_semaphore_signal(&rast->tasks[i].work_ready);
       }
    }
 }
@@ -809,11 +1256,16 @@ thread_function(void *init_data)
 
       if (task->thread_index == 0) {
          /* thread[0]:
-          *  - get next scene to rasterize
+          *  - get next scene to rasterize, or compute job to run
           *  - map the framebuffer surfaces
           */
-         lp_rast_begin( rast, 
-                        lp_scene_dequeue( rast->full_scenes, TRUE ) );
+         struct lp_rast_cs_job *cs_job;
+         struct lp_scene *scene = lp_scene_dequeue( rast->full_scenes, TRUE,
+                                                    &cs_job );
+         if (scene)
+            lp_rast_begin( rast, scene );
+         else
+            rast->curr_cs_job = cs_job;
       }
 
       /* Wait for all threads to get here so that threads[1+] don't
@@ -825,23 +1277,40 @@ thread_function(void *init_data)
       if (debug)
          debug_printf("thread %d doing work\n", task->thread_index);
 
-      rasterize_scene(task,
-                      rast->curr_scene);
+      if (rast->curr_cs_job)
+         run_cs_job(task, rast->curr_cs_job);
+      else
+         rasterize_scene(task,
+                         rast->curr_scene);
       
       /* wait for all threads to finish with this scene */
       util_barrier_wait( &rast->barrier );
 
-      /* XXX: shouldn't be necessary:
+      /* thread[0]:
+       *  - unmap the framebuffer surfaces
+       *  - signal the scene's or job's fence
        */
       if (task->thread_index == 0) {
-         lp_rast_end( rast );
+         if (rast->curr_cs_job) {
+            /* The job is freed by its submitter as soon as the fence is
+             * signalled, so hold our own fence reference.
+             */
+            struct lp_fence *fence = NULL;
+            lp_fence_reference(&fence, rast->curr_cs_job->fence);
+            rast->curr_cs_job = NULL;
+            lp_fence_signal(fence);
+            lp_fence_reference(&fence, NULL);
+         }
+         else {
+            lp_rast_end( rast );
+         }
       }
 
-      /* signal done with work */
+      /* Completion is reported through the scene's fence only, so that
+       * setup can queue further scenes without waiting for this one.
+       */
       if (debug)
          debug_printf("thread %d done working\n", task->thread_index);
-
-      pipe_semaphore_signal(&task->work_done);
    }
 
 #ifdef _WIN32
@@ -852,6 +1321,38 @@ thread_function(void *init_data)
 }
 
 
+/**
+ * Spread the threads over the L3 caches of the machine, filling one L3
+ * before moving on to the next.  Consecutive threads get neighbouring
+ * bin ranges (see lp_scene_bin_iter_begin()), so tiles that get stolen
+ * are most often taken by a thread sharing the victim's cache.
+ * Only done when the threads don't all fit behind one L3, which we can
+ * only tell where util_cpu_detect() knows the L3 topology (AMD Zen); other
+ * CPUs report a single L3 and are left alone.
+ * Set LP_PIN_THREADS=0 to leave placement to the OS scheduler.
+ */
+static void
+pin_rast_threads(struct lp_rasterizer *rast)
+{
+   unsigned cores_per_L3 = util_cpu_caps.cores_per_L3;
+   unsigned num_L3, i;
+
+   if (!debug_get_bool_option("LP_PIN_THREADS", TRUE))
+      return;
+
+   if (cores_per_L3 == 0 || cores_per_L3 >= util_cpu_caps.nr_cpus ||
+       rast->num_threads <= cores_per_L3)
+      return;
+
+   num_L3 = util_cpu_caps.nr_cpus / cores_per_L3;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      util_pin_thread_to_L3(rast->threads[i],
+                            (i / cores_per_L3) % num_L3, cores_per_L3);
+   }
+}
+
+
 /**
  * Initialize semaphores and spawn the threads.
  */
@@ -867,6 +1368,8 @@ create_rast_threads(struct lp_rasterizer *rast)
       rast->threads[i] = u_thread_create(thread_function,
                                             (void *) &rast->tasks[i]);
    }
+
+   pin_rast_threads(rast);
 }
 
 
@@ -882,6 +1385,8 @@ lp_rast_create( unsigned num_threads )
    struct lp_rasterizer *rast;
    unsigned i;
 
+   lp_rast_init_tri_kernels();
+
    rast = CALLOC_STRUCT(lp_rasterizer);
    if (!rast) {
       goto no_rast;
@@ -966,6 +1471,7 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
    }
    for (i = 0; i < MAX2(1, rast->num_threads); i++) {
       align_free(rast->tasks[i].thread_data.cache);
+      align_free(rast->tasks[i].cs_thread_data.shared);
    }
 
    /* for synchronizing rasterization threads */
@@ -155,6 +155,25 @@ struct lp_rast_clear_rb {
 #define GET_PLANES(tri) ((struct lp_rast_plane *)((char *)(&(tri)->inputs + 1) + 3 * (tri)->inputs.stride))
 
 
+/**
+ * A compute grid dispatch.  The workgroups are distributed over the
+ * rasterizer threads, which take them one at a time from next_block.
+ */
+struct lp_rast_cs_job {
+   lp_jit_cs_func jit_func;
+   const struct lp_jit_context *jit_context;
+
+   unsigned grid_size[3];
+   unsigned block_size[3];
+   unsigned shared_size;     /**< workgroup shared memory, in bytes */
+
+   uint64_t num_blocks;
+   uint64_t next_block;      /**< atomic */
+
+   struct lp_fence *fence;   /**< signalled when all workgroups are done */
+};
+
+
 
 struct lp_rasterizer *
 lp_rast_create( unsigned num_threads );
@@ -167,7 +186,12 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
                      struct lp_scene *scene );
 
 void
-lp_rast_finish( struct lp_rasterizer *rast );
+lp_rast_queue_cs_job( struct lp_rasterizer *rast,
+                      struct lp_rast_cs_job *job );
+
+uint64_t
+lp_rast_get_thread_time( struct lp_rasterizer *rast,
+                         unsigned thread_index );
 
 
 union lp_rast_cmd_arg {
@@ -28,6 +28,7 @@
 #ifndef LP_RAST_PRIV_H
 #define LP_RAST_PRIV_H
 
+#include "util/u_atomic.h"
 #include "util/u_format.h"
 #include "util/u_thread.h"
 #include "gallivm/lp_bld_debug.h"
@@ -76,6 +77,26 @@ extern const struct lp_rasterizer_task *jit_task;
 struct lp_rasterizer;
 struct cmd_bin;
 
+
+/**
+ * Hierarchical Z: bounds of the depth values stored in each 16x16 block
+ * of the current tile.  Only the first layer is tracked.
+ */
+struct lp_rast_hiz
+{
+   boolean enabled;       /**< depth buffer format can be tracked */
+   boolean is_float;
+   unsigned shift;        /**< of the depth bits in a z/s pixel */
+   uint64_t mask;         /**< depth bits, once shifted down */
+   float scale;           /**< from unorm depth to float */
+   float eps;             /**< depth conversion error allowance */
+
+   unsigned valid;        /**< mask of the blocks with known bounds */
+   float zmin[16];
+   float zmax[16];
+};
+
+
 /**
  * Per-thread rasterization state
  */
@@ -91,6 +112,8 @@ struct lp_rasterizer_task
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
 
+   struct lp_rast_hiz hiz;
+
    /** "back" pointer */
    struct lp_rasterizer *rast;
 
@@ -100,6 +123,17 @@ struct lp_rasterizer_task
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
 
+   /** Compute shader thread data, and the size of its shared memory */
+   struct lp_jit_cs_thread_data cs_thread_data;
+   unsigned cs_shared_size;
+
+   /** Time spent rasterizing scenes, in nanoseconds, for the queries */
+   uint64_t rast_time;
+
+   /** Blocks shaded with a variant, not yet added to its counter */
+   struct lp_fragment_shader_variant *counted_variant;
+   unsigned counted_invocations;
+
    pipe_semaphore work_ready;
    pipe_semaphore work_done;
 };
@@ -121,6 +155,9 @@ struct lp_rasterizer
    /** The scene currently being rasterized by the threads */
    struct lp_scene *curr_scene;
 
+   /** The compute job currently being run by the threads, if no scene */
+   struct lp_rast_cs_job *curr_cs_job;
+
    /** A task object for each rasterization thread */
    struct lp_rasterizer_task tasks[LP_MAX_THREADS];
 
@@ -139,6 +176,17 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          unsigned mask);
 
 
+boolean
+lp_rast_hiz_reject(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs,
+                   int x, int y, unsigned width, unsigned height);
+
+void
+lp_rast_hiz_update(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs,
+                   int x, int y, unsigned width, unsigned height);
+
+
 /**
  * Get the pointer to a 4x4 color block (within a 64x64 tile).
  * \param x, y location of 4x4 block in window coords
@@ -214,6 +262,38 @@ lp_rast_get_depth_block_pointer(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Add the task's count of shaded blocks to the variant's counter.
+ */
+static inline void
+lp_rast_flush_invocations(struct lp_rasterizer_task *task)
+{
+   if (task->counted_invocations) {
+      p_atomic_add(&task->counted_variant->invocations,
+                   task->counted_invocations);
+      task->counted_invocations = 0;
+   }
+   task->counted_variant = NULL;
+}
+
+
+/**
+ * Count 4x4 blocks shaded with a variant, which decides when a fast tier
+ * variant gets reoptimized.  The counts are kept per task and only added
+ * to the shared counter when the variant changes, to avoid contention.
+ */
+static inline void
+lp_rast_count_invocations(struct lp_rasterizer_task *task,
+                          struct lp_fragment_shader_variant *variant,
+                          unsigned count)
+{
+   if (task->counted_variant != variant) {
+      lp_rast_flush_invocations(task);
+      task->counted_variant = variant;
+   }
+   task->counted_invocations += count;
+}
+
 
 /**
  * Shade all pixels in a 4x4 block.  The fragment code omits the
@@ -260,6 +340,8 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
       /* Propagate non-interpolated raster state. */
       task->thread_data.raster_state.viewport_index = inputs->viewport_index;
 
+      lp_rast_count_invocations(task, variant, 1);
+
       /* run shader on 4x4 block */
       BEGIN_JIT_CALL(state, task);
       variant->jit_function[RAST_WHOLE]( &state->jit_context,
@@ -325,6 +407,62 @@ void lp_rast_triangle_32_8( struct lp_rasterizer_task *,
 void lp_rast_triangle_32_3_4(struct lp_rasterizer_task *,
 			  const union lp_rast_cmd_arg );
 
+
+/**
+ * A 4x4 block of a triangle contained in a 16x16 block, with the mask of
+ * its pixels which are outside the triangle.
+ */
+struct lp_rast_block_mask {
+   unsigned mask:16;
+   unsigned i:8;     /**< block row */
+   unsigned j:8;     /**< block column */
+};
+
+/**
+ * Evaluate the three edge functions of a triangle contained in the 16x16
+ * block at x, y, and list the 4x4 blocks which are not entirely outside.
+ * Returns the number of blocks.
+ */
+typedef unsigned
+(*lp_rast_tri_3_16_func)(const struct lp_rast_plane *plane,
+                         int x, int y,
+                         struct lp_rast_block_mask *out);
+
+/**
+ * Evaluate the three edge functions of a triangle contained in the 4x4
+ * block at x, y.  Returns the mask of the pixels outside the triangle.
+ */
+typedef unsigned
+(*lp_rast_tri_3_4_func)(const struct lp_rast_plane *plane,
+                        int x, int y);
+
+#if defined(PIPE_ARCH_SSE)
+unsigned
+lp_rast_tri_3_16_sse2(const struct lp_rast_plane *plane, int x, int y,
+                      struct lp_rast_block_mask *out);
+unsigned
+lp_rast_tri_3_4_sse2(const struct lp_rast_plane *plane, int x, int y);
+#endif
+
+#ifdef LP_HAVE_AVX2
+unsigned
+lp_rast_tri_3_16_avx2(const struct lp_rast_plane *plane, int x, int y,
+                      struct lp_rast_block_mask *out);
+unsigned
+lp_rast_tri_3_4_avx2(const struct lp_rast_plane *plane, int x, int y);
+#endif
+
+#ifdef LP_HAVE_AVX512
+unsigned
+lp_rast_tri_3_16_avx512(const struct lp_rast_plane *plane, int x, int y,
+                        struct lp_rast_block_mask *out);
+unsigned
+lp_rast_tri_3_4_avx512(const struct lp_rast_plane *plane, int x, int y);
+#endif
+
+void
+lp_rast_init_tri_kernels(void);
+
 void lp_rast_triangle_32_3_16( struct lp_rasterizer_task *, 
                             const union lp_rast_cmd_arg );
 
@@ -30,7 +30,9 @@
  */
 
 #include <limits.h>
+#include "c11/threads.h"
 #include "util/u_math.h"
+#include "util/u_cpu_detect.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
 #include "lp_rast_priv.h"
@@ -237,17 +239,12 @@ sign_bits4(const __m128i *cstep, int cdiff)
 
 #define NR_PLANES 3
 
-void
-lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
-                         const union lp_rast_cmd_arg arg)
+unsigned
+lp_rast_tri_3_16_sse2(const struct lp_rast_plane *plane,
+                      int x, int y,
+                      struct lp_rast_block_mask *out)
 {
-   const struct lp_rast_triangle *tri = arg.triangle.tri;
-   const struct lp_rast_plane *plane = GET_PLANES(tri);
-   int x = (arg.triangle.plane_mask & 0xff) + task->x;
-   int y = (arg.triangle.plane_mask >> 8) + task->y;
    unsigned i, j;
-
-   struct { unsigned mask:16; unsigned i:8; unsigned j:8; } out[16];
    unsigned nr = 0;
 
    /* p0 and p2 are aligned, p1 is not (plane size 24 bytes). */
@@ -342,23 +339,13 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
       c = _mm_add_epi32(c, _mm_slli_epi32(dcdy, 2));
    }
 
-   for (i = 0; i < nr; i++)
-      lp_rast_shade_quads_mask(task,
-                               &tri->inputs,
-                               x + 4 * out[i].j,
-                               y + 4 * out[i].i,
-                               0xffff & ~out[i].mask);
+   return nr;
 }
 
-void
-lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
-                        const union lp_rast_cmd_arg arg)
+unsigned
+lp_rast_tri_3_4_sse2(const struct lp_rast_plane *plane,
+                     int x, int y)
 {
-   const struct lp_rast_triangle *tri = arg.triangle.tri;
-   const struct lp_rast_plane *plane = GET_PLANES(tri);
-   unsigned x = (arg.triangle.plane_mask & 0xff) + task->x;
-   unsigned y = (arg.triangle.plane_mask >> 8) + task->y;
-
    /* p0 and p2 are aligned, p1 is not (plane size 24 bytes). */
    __m128i p0 = _mm_load_si128((__m128i *)&plane[0]); /* clo, chi, dcdx, dcdy */
    __m128i p1 = _mm_loadu_si128((__m128i *)&plane[1]);
@@ -421,14 +408,90 @@ lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
       __m128i c_23 = _mm_packs_epi32(c_2, c_3);
       __m128i c_0123 = _mm_packs_epi16(c_01, c_23);
 
-      unsigned mask = _mm_movemask_epi8(c_0123);
+      return _mm_movemask_epi8(c_0123);
+   }
+}
+
+
+/* The widest kernels the CPU supports, picked by lp_rast_init_tri_kernels */
+static lp_rast_tri_3_16_func tri_3_16 = lp_rast_tri_3_16_sse2;
+static lp_rast_tri_3_4_func tri_3_4 = lp_rast_tri_3_4_sse2;
 
-      if (mask != 0xffff)
-         lp_rast_shade_quads_mask(task,
-                                  &tri->inputs,
-                                  x,
-                                  y,
-                                  0xffff & ~mask);
+
+static void
+init_tri_kernels(void)
+{
+#ifdef LP_HAVE_AVX2
+   if (util_cpu_caps.has_avx2) {
+      tri_3_16 = lp_rast_tri_3_16_avx2;
+      tri_3_4 = lp_rast_tri_3_4_avx2;
+   }
+#endif
+#ifdef LP_HAVE_AVX512
+   if (util_cpu_caps.has_avx512f) {
+      tri_3_16 = lp_rast_tri_3_16_avx512;
+      tri_3_4 = lp_rast_tri_3_4_avx512;
+   }
+#endif
+}
+
+
+void
+lp_rast_init_tri_kernels(void)
+{
+   static once_flag once = ONCE_FLAG_INIT;
+   call_once(&once, init_tri_kernels);
+}
+
+
+void
+lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
+                         const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   int x = (arg.triangle.plane_mask & 0xff) + task->x;
+   int y = (arg.triangle.plane_mask >> 8) + task->y;
+   struct lp_rast_block_mask out[16];
+   unsigned i, nr;
+
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 16, 16))
+      return;
+
+   nr = tri_3_16(plane, x, y, out);
+
+   for (i = 0; i < nr; i++)
+      lp_rast_shade_quads_mask(task,
+                               &tri->inputs,
+                               x + 4 * out[i].j,
+                               y + 4 * out[i].i,
+                               0xffff & ~out[i].mask);
+
+   lp_rast_hiz_update(task, &tri->inputs, x, y, 16, 16);
+}
+
+void
+lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
+                        const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   int x = (arg.triangle.plane_mask & 0xff) + task->x;
+   int y = (arg.triangle.plane_mask >> 8) + task->y;
+   unsigned mask;
+
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 4, 4))
+      return;
+
+   mask = tri_3_4(plane, x, y);
+
+   if (mask != 0xffff) {
+      lp_rast_shade_quads_mask(task,
+                               &tri->inputs,
+                               x,
+                               y,
+                               0xffff & ~mask);
+      lp_rast_hiz_update(task, &tri->inputs, x, y, 4, 4);
    }
 }
 
@@ -436,6 +499,11 @@ lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
 
 #else
 
+void
+lp_rast_init_tri_kernels(void)
+{
+}
+
 #if defined(_ARCH_PWR8) && defined(PIPE_ARCH_LITTLE_ENDIAN)
 
 #include <altivec.h>
@@ -556,6 +624,9 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
    __m128i vshuf_mask1;
    __m128i vshuf_mask2;
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 16, 16))
+      return;
+
 #ifdef PIPE_ARCH_LITTLE_ENDIAN
    vshuf_mask0 = (__m128i) vec_splats((unsigned int) 0x03020100);
    vshuf_mask1 = (__m128i) vec_splats((unsigned int) 0x07060504);
@@ -646,6 +717,8 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
                                x + 4 * out[i].j,
                                y + 4 * out[i].i,
                                0xffff & ~out[i].mask);
+
+   lp_rast_hiz_update(task, &tri->inputs, x, y, 16, 16);
 }
 
 #undef NR_PLANES
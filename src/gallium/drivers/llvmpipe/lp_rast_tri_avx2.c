@@ -0,0 +1,164 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * AVX2 versions of the kernels for triangles contained in a 16x16 or 4x4
+ * block.  Eight edge function values are evaluated per instruction: two
+ * rows of a 4x4 block, or the trivial reject corners of eight 4x4 blocks.
+ *
+ * This file is built with AVX2 code generation enabled, and its functions
+ * are only called when util_cpu_caps.has_avx2 is set.
+ */
+
+#include <immintrin.h>
+
+#include "lp_rast_priv.h"
+
+
+/**
+ * Edge function of one plane over the top two rows of the 4x4 block at
+ * x, y, minus one so that the sign bit is set for pixels outside.  The
+ * multiples of the steps are selected with masks rather than multiplied.
+ */
+static inline __m256i
+plane_rows(const struct lp_rast_plane *plane, int x, int y)
+{
+   const __m256i col1 = _mm256_setr_epi32(0, ~0, 0, ~0, 0, ~0, 0, ~0);
+   const __m256i col2 = _mm256_setr_epi32(0, 0, ~0, ~0, 0, 0, ~0, ~0);
+   const __m256i row1 = _mm256_setr_epi32(0, 0, 0, 0, ~0, ~0, ~0, ~0);
+   const uint32_t dcdx = (uint32_t) plane->dcdx;
+   const uint32_t dcdy = (uint32_t) plane->dcdy;
+   const __m256i ndcdx = _mm256_set1_epi32(0 - dcdx);
+   __m256i span;
+
+   span = _mm256_add_epi32(
+      _mm256_add_epi32(_mm256_and_si256(ndcdx, col1),
+                       _mm256_and_si256(_mm256_slli_epi32(ndcdx, 1), col2)),
+      _mm256_and_si256(_mm256_set1_epi32(dcdy), row1));
+
+   return _mm256_add_epi32(span,
+                           _mm256_set1_epi32((uint32_t) plane->c -
+                                             dcdx * (uint32_t) x +
+                                             dcdy * (uint32_t) y - 1));
+}
+
+
+/**
+ * Mask of the pixels of a 4x4 block which are outside the triangle, given
+ * the top two rows of each plane.
+ */
+static inline unsigned
+block_mask(__m256i c0, __m256i c1, __m256i c2,
+           int32_t dcdy0, int32_t dcdy1, int32_t dcdy2)
+{
+   const __m256i r01 = _mm256_or_si256(_mm256_or_si256(c0, c1), c2);
+   const __m256i r23 = _mm256_or_si256(
+      _mm256_or_si256(_mm256_add_epi32(c0, _mm256_set1_epi32(dcdy0 * 2)),
+                      _mm256_add_epi32(c1, _mm256_set1_epi32(dcdy1 * 2))),
+      _mm256_add_epi32(c2, _mm256_set1_epi32(dcdy2 * 2)));
+
+   return _mm256_movemask_ps(_mm256_castsi256_ps(r01)) |
+          (_mm256_movemask_ps(_mm256_castsi256_ps(r23)) << 8);
+}
+
+
+/**
+ * Trivial reject values of the eight 4x4 blocks in the top half of the
+ * 16x16 block, given the top two rows of the plane.  The block corners
+ * step by four pixels, so scale the steps of the rows.
+ */
+static inline __m256i
+plane_reject(const struct lp_rast_plane *plane, __m256i rows)
+{
+   const uint32_t rej = ((uint32_t) MAX2(plane->dcdy, 0) -
+                         (uint32_t) MIN2(plane->dcdx, 0)) * 4 + 1;
+   const __m256i c = _mm256_broadcastd_epi32(_mm256_castsi256_si128(rows));
+
+   return _mm256_add_epi32(_mm256_add_epi32(c, _mm256_set1_epi32(rej)),
+                           _mm256_slli_epi32(_mm256_sub_epi32(rows, c), 2));
+}
+
+
+unsigned
+lp_rast_tri_3_16_avx2(const struct lp_rast_plane *plane,
+                      int x, int y,
+                      struct lp_rast_block_mask *out)
+{
+   const __m256i c0 = plane_rows(&plane[0], x, y);
+   const __m256i c1 = plane_rows(&plane[1], x, y);
+   const __m256i c2 = plane_rows(&plane[2], x, y);
+   const uint32_t dcdx0 = plane[0].dcdx * 4, dcdy0 = plane[0].dcdy * 4;
+   const uint32_t dcdx1 = plane[1].dcdx * 4, dcdy1 = plane[1].dcdy * 4;
+   const uint32_t dcdx2 = plane[2].dcdx * 4, dcdy2 = plane[2].dcdy * 4;
+   const __m256i rej0 = plane_reject(&plane[0], c0);
+   const __m256i rej1 = plane_reject(&plane[1], c1);
+   const __m256i rej2 = plane_reject(&plane[2], c2);
+   __m256i rej_lo, rej_hi;
+   unsigned inmask;
+   unsigned nr = 0;
+
+   /* Trivially reject the 4x4 blocks, eight at a time */
+   rej_lo = _mm256_or_si256(_mm256_or_si256(rej0, rej1), rej2);
+   rej_hi = _mm256_or_si256(
+      _mm256_or_si256(_mm256_add_epi32(rej0, _mm256_set1_epi32(dcdy0 * 2)),
+                      _mm256_add_epi32(rej1, _mm256_set1_epi32(dcdy1 * 2))),
+      _mm256_add_epi32(rej2, _mm256_set1_epi32(dcdy2 * 2)));
+
+   inmask = ~(_mm256_movemask_ps(_mm256_castsi256_ps(rej_lo)) |
+              (_mm256_movemask_ps(_mm256_castsi256_ps(rej_hi)) << 8)) & 0xffff;
+
+   while (inmask) {
+      const unsigned b = u_bit_scan(&inmask);
+      const unsigned i = b >> 2;
+      const unsigned j = b & 3;
+      const unsigned mask = block_mask(
+         _mm256_add_epi32(c0, _mm256_set1_epi32(dcdy0 * i - dcdx0 * j)),
+         _mm256_add_epi32(c1, _mm256_set1_epi32(dcdy1 * i - dcdx1 * j)),
+         _mm256_add_epi32(c2, _mm256_set1_epi32(dcdy2 * i - dcdx2 * j)),
+         plane[0].dcdy, plane[1].dcdy, plane[2].dcdy);
+
+      if (mask != 0xffff) {
+         out[nr].i = i;
+         out[nr].j = j;
+         out[nr].mask = mask;
+         nr++;
+      }
+   }
+
+   return nr;
+}
+
+
+unsigned
+lp_rast_tri_3_4_avx2(const struct lp_rast_plane *plane,
+                     int x, int y)
+{
+   return block_mask(plane_rows(&plane[0], x, y),
+                     plane_rows(&plane[1], x, y),
+                     plane_rows(&plane[2], x, y),
+                     plane[0].dcdy, plane[1].dcdy, plane[2].dcdy);
+}
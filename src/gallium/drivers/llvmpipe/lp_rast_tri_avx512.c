@@ -0,0 +1,141 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * AVX-512 versions of the kernels for triangles contained in a 16x16 or
+ * 4x4 block.  Sixteen edge function values are evaluated per instruction:
+ * a whole 4x4 block, or the trivial reject corners of all the 4x4 blocks
+ * of a 16x16 block.  The compares produce the pixel masks directly.
+ *
+ * This file is built with AVX-512F code generation enabled, and its
+ * functions are only called when util_cpu_caps.has_avx512f is set.
+ */
+
+#include <immintrin.h>
+
+#include "lp_rast_priv.h"
+
+
+/**
+ * Edge function of one plane over the 4x4 block at x, y, minus one so that
+ * the sign bit is set for pixels outside.  The multiples of the steps are
+ * selected with lane masks rather than multiplied.
+ */
+static inline __m512i
+plane_block(const struct lp_rast_plane *plane, int x, int y)
+{
+   const uint32_t dcdx = (uint32_t) plane->dcdx;
+   const uint32_t dcdy = (uint32_t) plane->dcdy;
+   const __m512i ndcdx = _mm512_set1_epi32(0 - dcdx);
+   const __m512i vdcdy = _mm512_set1_epi32(dcdy);
+   __m512i c;
+
+   c = _mm512_set1_epi32((uint32_t) plane->c -
+                         dcdx * (uint32_t) x +
+                         dcdy * (uint32_t) y - 1);
+   c = _mm512_mask_add_epi32(c, 0xaaaa, c, ndcdx);
+   c = _mm512_mask_add_epi32(c, 0xcccc, c, _mm512_slli_epi32(ndcdx, 1));
+   c = _mm512_mask_add_epi32(c, 0xf0f0, c, vdcdy);
+   c = _mm512_mask_add_epi32(c, 0xff00, c, _mm512_slli_epi32(vdcdy, 1));
+
+   return c;
+}
+
+
+/**
+ * Trivial reject values of the sixteen 4x4 blocks of the 16x16 block,
+ * given the plane over the first 4x4 block.  The block corners step by
+ * four pixels, so scale the steps of the block.
+ */
+static inline __m512i
+plane_reject(const struct lp_rast_plane *plane, __m512i block)
+{
+   const uint32_t rej = ((uint32_t) MAX2(plane->dcdy, 0) -
+                         (uint32_t) MIN2(plane->dcdx, 0)) * 4 + 1;
+   const __m512i c = _mm512_broadcastd_epi32(_mm512_castsi512_si128(block));
+
+   return _mm512_add_epi32(_mm512_add_epi32(c, _mm512_set1_epi32(rej)),
+                           _mm512_slli_epi32(_mm512_sub_epi32(block, c), 2));
+}
+
+
+static inline unsigned
+block_mask(__m512i c0, __m512i c1, __m512i c2)
+{
+   return _mm512_cmplt_epi32_mask(_mm512_or_si512(_mm512_or_si512(c0, c1), c2),
+                                  _mm512_setzero_si512());
+}
+
+
+unsigned
+lp_rast_tri_3_16_avx512(const struct lp_rast_plane *plane,
+                        int x, int y,
+                        struct lp_rast_block_mask *out)
+{
+   const __m512i c0 = plane_block(&plane[0], x, y);
+   const __m512i c1 = plane_block(&plane[1], x, y);
+   const __m512i c2 = plane_block(&plane[2], x, y);
+   const uint32_t dcdx0 = plane[0].dcdx * 4, dcdy0 = plane[0].dcdy * 4;
+   const uint32_t dcdx1 = plane[1].dcdx * 4, dcdy1 = plane[1].dcdy * 4;
+   const uint32_t dcdx2 = plane[2].dcdx * 4, dcdy2 = plane[2].dcdy * 4;
+   unsigned inmask;
+   unsigned nr = 0;
+
+   /* Trivially reject all the 4x4 blocks at once */
+   inmask = ~block_mask(plane_reject(&plane[0], c0),
+                        plane_reject(&plane[1], c1),
+                        plane_reject(&plane[2], c2)) & 0xffff;
+
+   while (inmask) {
+      const unsigned b = u_bit_scan(&inmask);
+      const unsigned i = b >> 2;
+      const unsigned j = b & 3;
+      const unsigned mask = block_mask(
+         _mm512_add_epi32(c0, _mm512_set1_epi32(dcdy0 * i - dcdx0 * j)),
+         _mm512_add_epi32(c1, _mm512_set1_epi32(dcdy1 * i - dcdx1 * j)),
+         _mm512_add_epi32(c2, _mm512_set1_epi32(dcdy2 * i - dcdx2 * j)));
+
+      if (mask != 0xffff) {
+         out[nr].i = i;
+         out[nr].j = j;
+         out[nr].mask = mask;
+         nr++;
+      }
+   }
+
+   return nr;
+}
+
+
+unsigned
+lp_rast_tri_3_4_avx512(const struct lp_rast_plane *plane,
+                       int x, int y)
+{
+   return block_mask(plane_block(&plane[0], x, y),
+                     plane_block(&plane[1], x, y),
+                     plane_block(&plane[2], x, y));
+}
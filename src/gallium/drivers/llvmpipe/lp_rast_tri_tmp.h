@@ -191,6 +191,9 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       return;
    }
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, TILE_SIZE, TILE_SIZE))
+      return;
+
    outmask = 0;                 /* outside one or more trivial reject planes */
    partmask = 0;                /* outside one or more trivial accept planes */
 
@@ -301,8 +304,12 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
       partial_mask &= ~(1 << i);
 
+      if (lp_rast_hiz_reject(task, &tri->inputs, px, py, 16, 16))
+         continue;
+
       LP_COUNT(nr_partially_covered_16);
       TAG(do_block_16)(task, tri, plane, px, py, cx);
+      lp_rast_hiz_update(task, &tri->inputs, px, py, 16, 16);
    }
 
    /* Iterate over fulls: 
@@ -316,8 +323,12 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
       inmask &= ~(1 << i);
 
+      if (lp_rast_hiz_reject(task, &tri->inputs, px, py, 16, 16))
+         continue;
+
       LP_COUNT(nr_fully_covered_16);
       block_full_16(task, tri, px, py);
+      lp_rast_hiz_update(task, &tri->inputs, px, py, 16, 16);
    }
 }
 
@@ -345,6 +356,9 @@ TRI_16(struct lp_rasterizer_task *task,
    x += task->x;
    y += task->y;
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 16, 16))
+      return;
+
    for (j = 0; j < NR_PLANES; j++) {
       const int dcdx = -plane[j].dcdx * 4;
       const int dcdy = plane[j].dcdy * 4;
@@ -395,6 +409,8 @@ TRI_16(struct lp_rasterizer_task *task,
       if (mask)
 	 lp_rast_shade_quads_mask(task, &tri->inputs, px, py, mask);
    }
+
+   lp_rast_hiz_update(task, &tri->inputs, x, y, 16, 16);
 }
 #endif
 
@@ -410,6 +426,9 @@ TRI_4(struct lp_rasterizer_task *task,
    const int y = task->y + (mask >> 8);
    unsigned j;
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 4, 4))
+      return;
+
    /* Iterate over partials:
     */
    {
@@ -438,8 +457,10 @@ TRI_4(struct lp_rasterizer_task *task,
 	 mask &= ~_mm_movemask_epi8(result);
       }
 
-      if (mask)
+      if (mask) {
 	 lp_rast_shade_quads_mask(task, &tri->inputs, x, y, mask);
+         lp_rast_hiz_update(task, &tri->inputs, x, y, 4, 4);
+      }
    }
 }
 #endif
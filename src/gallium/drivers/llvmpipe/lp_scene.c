@@ -27,6 +27,7 @@
 
 #include "util/u_framebuffer.h"
 #include "util/u_math.h"
+#include "util/u_atomic.h"
 #include "util/u_memory.h"
 #include "util/u_inlines.h"
 #include "util/simple_list.h"
@@ -62,8 +63,6 @@ lp_scene_create( struct pipe_context *pipe )
    scene->data.head =
       CALLOC_STRUCT(data_block);
 
-   (void) mtx_init(&scene->mutex, mtx_plain);
-
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
    {
@@ -90,7 +89,6 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_fence_reference(&scene->fence, NULL);
-   mtx_destroy(&scene->mutex);
    assert(scene->data.head->next == NULL);
    FREE(scene->data.head);
    FREE(scene);
@@ -204,12 +202,13 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
 
 
 /**
- * Free all the temporary data in a scene.
+ * Release the framebuffer mappings set up by lp_scene_begin_rasterization().
+ * Called by the rasterizer once all bins have been executed.
  */
 void
 lp_scene_end_rasterization(struct lp_scene *scene )
 {
-   int i, j;
+   int i;
 
    /* Unmap color buffers */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
@@ -232,6 +231,23 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                               zsbuf->u.tex.first_layer);
       scene->zsbuf.map = NULL;
    }
+}
+
+
+/**
+ * Release everything the scene holds so it can be binned again.
+ * Called by setup, either once the scene's fence has been signalled or for
+ * a scene which never got rasterized.  Rasterizer threads don't touch the
+ * command lists or resource references, so that setup can examine them
+ * while the scene is still in flight.
+ */
+void
+lp_scene_reset(struct lp_scene *scene)
+{
+   int i, j;
+
+   /* Unmap the framebuffer in case the scene never got rasterized. */
+   lp_scene_end_rasterization(scene);
 
    /* Reset all command lists:
     */
@@ -449,61 +465,75 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 
 
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
+/**
+ * Split the bins of the scene into one contiguous range per thread.
+ * Called once per scene by one thread, before any thread calls
+ * lp_scene_bin_iter_next().
+ *
+ * Contiguous ranges keep each thread on neighbouring tiles (and so on
+ * neighbouring framebuffer memory); threads pinned to the same cache get
+ * adjacent ranges since they have adjacent indices.
+ */
+void
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads )
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
+   int num_bins = scene->tiles_x * scene->tiles_y;
+   unsigned i;
+
+   assert(num_threads >= 1 && num_threads <= LP_MAX_THREADS);
+
+   for (i = 0; i < num_threads; i++) {
+      scene->bin_range[i].next = (int)((int64_t)num_bins * i / num_threads);
+      scene->bin_range[i].end = (int)((int64_t)num_bins * (i + 1) / num_threads);
    }
-   return TRUE;
+   scene->num_bin_ranges = num_threads;
 }
 
 
-void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
+/** Atomically take the next bin from a range, or return -1 if empty */
+static inline int
+take_bin(struct lp_scene_bin_range *range)
 {
-   scene->curr_x = scene->curr_y = -1;
+   int idx;
+
+   if (range->next >= range->end)
+      return -1;
+
+   idx = p_atomic_inc_return(&range->next) - 1;
+   return idx < range->end ? idx : -1;
 }
 
 
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
+ * Return pointer to next bin to be rendered by the given thread.
  * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * of work (a bin) to work on.  Bins come from the thread's own range
+ * first; once that is exhausted they are stolen from the other threads'
+ * ranges, visiting the nearest ranges first.
  */
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y)
 {
-   struct cmd_bin *bin = NULL;
+   unsigned n = scene->num_bin_ranges;
+   unsigned i;
+   int idx;
 
-   mtx_lock(&scene->mutex);
+   assert(thread_index < n);
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   }
-   else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
+   idx = take_bin(&scene->bin_range[thread_index]);
+
+   for (i = 1; idx < 0 && i < n; i++) {
+      idx = take_bin(&scene->bin_range[(thread_index + i) % n]);
    }
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+   if (idx < 0)
+      return NULL;
+
+   *x = idx % scene->tiles_x;
+   *y = idx / scene->tiles_x;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+   return lp_scene_get_bin(scene, *x, *y);
 }
 
 
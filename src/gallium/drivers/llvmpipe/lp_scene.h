@@ -38,6 +38,7 @@
 #include "os/os_thread.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
+#include "lp_limits.h"
 
 struct lp_scene_queue;
 struct lp_rast_state;
@@ -117,6 +118,17 @@ struct data_block_list {
 
 struct resource_ref;
 
+/**
+ * A range of bins [next, end) in raster order.  Padded to a cache line
+ * so that threads advancing different ranges don't contend.
+ */
+struct lp_scene_bin_range {
+   int next;
+   int end;
+   char pad[64 - 2 * sizeof(int)];
+};
+
+
 /**
  * All bins and bin data are contained here.
  * Per-bin data goes into the 'tile' bins.
@@ -134,6 +146,8 @@ struct lp_scene {
    unsigned num_active_queries;
    /* If queries were either active or there were begin/end query commands */
    boolean had_queries;
+   /* If a fragment shader of the scene writes to shader storage buffers */
+   boolean writes_memory;
 
    /* Framebuffer mappings - valid only between begin_rasterization()
     * and end_rasterization().
@@ -172,8 +186,13 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   mtx_t mutex;
+   /**
+    * Bins handed out to the rasterizer threads, see lp_scene_bin_iter_next().
+    * Each thread owns a contiguous range of bins; a thread that runs out of
+    * work takes bins from the other threads' ranges.
+    */
+   struct lp_scene_bin_range bin_range[LP_MAX_THREADS];
+   unsigned num_bin_ranges;
 
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
@@ -378,10 +397,11 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 
 
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads );
 
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y );
 
 
 
@@ -403,6 +423,9 @@ lp_scene_begin_rasterization(struct lp_scene *scene);
 void
 lp_scene_end_rasterization(struct lp_scene *scene);
 
+void
+lp_scene_reset(struct lp_scene *scene);
+
 
 
 
@@ -30,6 +30,9 @@
  * Scene queue.  We'll use two queues.  One contains "full" scenes which
  * are produced by the "setup" code.  The other contains "empty" scenes
  * which are produced by the "rast" code when it finishes rendering a scene.
+ *
+ * Compute jobs go through the same queue as the scenes, so that the
+ * rasterizer threads process both in submission order.
  */
 
 #include "util/u_ringbuffer.h"
@@ -38,11 +41,20 @@
 
 
 
-#define MAX_SCENE_QUEUE 4
+/* Must be a power of two, and large enough to hold the scenes a context
+ * can have in flight (MAX_SCENES) without blocking setup.
+ */
+#define MAX_SCENE_QUEUE 8
+
+/** Packet types, stored in the packet header's data24 field */
+enum scene_packet_type {
+   SCENE_PACKET_SCENE = 0,
+   SCENE_PACKET_CS_JOB
+};
 
 struct scene_packet {
    struct util_packet header;
-   struct lp_scene *scene;
+   void *data;   /**< lp_scene or lp_rast_cs_job */
 };
 
 /**
@@ -85,14 +97,19 @@ lp_scene_queue_destroy(struct lp_scene_queue *queue)
 }
 
 
-/** Remove first lp_scene from head of queue */
+/**
+ * Remove first item from head of queue.  Returns the lp_scene, or NULL
+ * if the item is a compute job, which is then returned in *cs_job.
+ */
 struct lp_scene *
-lp_scene_dequeue(struct lp_scene_queue *queue, boolean wait)
+lp_scene_dequeue(struct lp_scene_queue *queue, boolean wait,
+                 struct lp_rast_cs_job **cs_job)
 {
    struct scene_packet packet;
    enum pipe_error ret;
 
-   packet.scene = NULL;
+   packet.data = NULL;
+   *cs_job = NULL;
 
    ret = util_ringbuffer_dequeue(queue->ring,
                                  &packet.header,
@@ -101,24 +118,45 @@ lp_scene_dequeue(struct lp_scene_queue *queue, boolean wait)
    if (ret != PIPE_OK)
       return NULL;
 
-   return packet.scene;
+   if (packet.header.data24 == SCENE_PACKET_CS_JOB) {
+      *cs_job = packet.data;
+      return NULL;
+   }
+
+   return packet.data;
 }
 
 
-/** Add an lp_scene to tail of queue */
-void
-lp_scene_enqueue(struct lp_scene_queue *queue, struct lp_scene *scene)
+static void
+enqueue_packet(struct lp_scene_queue *queue, unsigned type, void *data)
 {
    struct scene_packet packet;
 
    packet.header.dwords = sizeof packet / 4;
-   packet.header.data24 = 0;
-   packet.scene = scene;
+   packet.header.data24 = type;
+   packet.data = data;
 
    util_ringbuffer_enqueue(queue->ring, &packet.header);
 }
 
 
+/** Add an lp_scene to tail of queue */
+void
+lp_scene_enqueue(struct lp_scene_queue *queue, struct lp_scene *scene)
+{
+   enqueue_packet(queue, SCENE_PACKET_SCENE, scene);
+}
+
+
+/** Add a compute job to tail of queue */
+void
+lp_scene_enqueue_cs_job(struct lp_scene_queue *queue,
+                        struct lp_rast_cs_job *cs_job)
+{
+   enqueue_packet(queue, SCENE_PACKET_CS_JOB, cs_job);
+}
+
+
 
 
 
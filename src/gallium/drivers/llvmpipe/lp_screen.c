@@ -33,10 +33,16 @@
 #include "util/u_screen.h"
 #include "util/u_string.h"
 #include "util/u_format_s3tc.h"
+#include "util/disk_cache.h"
+#include "util/mesa-sha1.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
 #include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_coro.h"
+#include "compiler/nir/nir.h"
 
 #include "util/os_misc.h"
 #include "util/os_time.h"
@@ -48,6 +54,7 @@
 #include "lp_debug.h"
 #include "lp_public.h"
 #include "lp_limits.h"
+#include "lp_query.h"
 #include "lp_rast.h"
 
 #include "state_tracker/sw_winsys.h"
@@ -72,6 +79,8 @@ static const struct debug_named_value lp_debug_flags[] = {
 };
 #endif
 
+DEBUG_GET_ONCE_BOOL_OPTION(lp_nir, "LP_NIR", FALSE)
+
 int LP_PERF = 0;
 static const struct debug_named_value lp_perf_flags[] = {
    { "texmem",         PERF_TEX_MEM, NULL },
@@ -82,6 +91,7 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_blend",       PERF_NO_BLEND, NULL },
    { "no_depth",       PERF_NO_DEPTH, NULL },
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
+   { "no_hiz",         PERF_NO_HIZ, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -214,7 +224,8 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_QUADS_FOLLOW_PROVOKING_VERTEX_CONVENTION:
       return 0;
    case PIPE_CAP_COMPUTE:
-      return 0;
+      /* barriers need coroutines */
+      return GALLIVM_HAVE_CORO;
    case PIPE_CAP_USER_VERTEX_BUFFERS:
       return 1;
    case PIPE_CAP_VERTEX_BUFFER_OFFSET_4BYTE_ALIGNED_ONLY:
@@ -310,6 +321,9 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
       return 1;
    case PIPE_CAP_CLEAR_TEXTURE:
       return 1;
+   case PIPE_CAP_SHADER_BUFFER_OFFSET_ALIGNMENT:
+      /* shader buffers are accessed one 32-bit word at a time */
+      return 4;
    case PIPE_CAP_MAX_VARYINGS:
       return 32;
    case PIPE_CAP_MULTISAMPLE_Z_RESOLVE:
@@ -326,7 +340,6 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_MULTI_DRAW_INDIRECT_PARAMS:
    case PIPE_CAP_TGSI_FS_POSITION_IS_SYSVAL:
    case PIPE_CAP_TGSI_FS_FACE_IS_INTEGER_SYSVAL:
-   case PIPE_CAP_SHADER_BUFFER_OFFSET_ALIGNMENT:
    case PIPE_CAP_INVALIDATE_BUFFER:
    case PIPE_CAP_GENERATE_MIPMAP:
    case PIPE_CAP_STRING_MARKER:
@@ -389,15 +402,47 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    }
 }
 
+/**
+ * The NIR backend is opt-in (LP_NIR=true) until it has seen more testing.
+ * Vertex and geometry shaders can only consume NIR when the draw module
+ * runs them through LLVM.
+ */
+static unsigned
+llvmpipe_supported_irs(enum pipe_shader_type shader)
+{
+   unsigned irs = 1 << PIPE_SHADER_IR_TGSI;
+
+   if (shader == PIPE_SHADER_FRAGMENT ||
+       shader == PIPE_SHADER_COMPUTE ||
+       debug_get_bool_option("DRAW_USE_LLVM", TRUE))
+      irs |= 1 << PIPE_SHADER_IR_NIR;
+
+   return irs;
+}
+
 static int
 llvmpipe_get_shader_param(struct pipe_screen *screen,
                           enum pipe_shader_type shader,
                           enum pipe_shader_cap param)
 {
+   switch (param) {
+   case PIPE_SHADER_CAP_SUPPORTED_IRS:
+      return llvmpipe_supported_irs(shader);
+   case PIPE_SHADER_CAP_PREFERRED_IR:
+      if (debug_get_option_lp_nir() &&
+          (llvmpipe_supported_irs(shader) & (1 << PIPE_SHADER_IR_NIR)))
+         return PIPE_SHADER_IR_NIR;
+      return PIPE_SHADER_IR_TGSI;
+   default:
+      break;
+   }
+
    switch(shader)
    {
    case PIPE_SHADER_FRAGMENT:
       switch (param) {
+      case PIPE_SHADER_CAP_MAX_SHADER_BUFFERS:
+         return LP_MAX_TGSI_SHADER_BUFFERS;
       default:
          return gallivm_get_shader_param(param);
       }
@@ -421,6 +466,18 @@ llvmpipe_get_shader_param(struct pipe_screen *screen,
       default:
          return draw_get_shader_param(shader, param);
       }
+   case PIPE_SHADER_COMPUTE:
+      switch (param) {
+      case PIPE_SHADER_CAP_MAX_INPUTS:
+      case PIPE_SHADER_CAP_MAX_OUTPUTS:
+         return 0;
+      case PIPE_SHADER_CAP_MAX_SHADER_BUFFERS:
+         return LP_MAX_TGSI_SHADER_BUFFERS;
+      case PIPE_SHADER_CAP_MAX_SHADER_IMAGES:
+         return PIPE_MAX_SHADER_IMAGES;
+      default:
+         return gallivm_get_shader_param(param);
+      }
    default:
       return 0;
    }
@@ -455,6 +512,48 @@ llvmpipe_get_paramf(struct pipe_screen *screen, enum pipe_capf param)
 }
 
 
+static const struct nir_shader_compiler_options gallivm_nir_options = {
+   .lower_scmp = true,
+   .lower_flrp32 = true,
+   .lower_flrp64 = true,
+   .lower_fsat = true,
+   .lower_fmod = true,
+   .lower_bitfield_extract_to_shifts = true,
+   .lower_bitfield_insert_to_shifts = true,
+   .lower_bfm = true,
+   .lower_ifind_msb = true,
+   .lower_uadd_carry = true,
+   .lower_usub_borrow = true,
+   .lower_mul_high = true,
+   .lower_ldexp = true,
+   .lower_pack_half_2x16 = true,
+   .lower_pack_snorm_2x16 = true,
+   .lower_pack_snorm_4x8 = true,
+   .lower_pack_unorm_2x16 = true,
+   .lower_pack_unorm_4x8 = true,
+   .lower_unpack_half_2x16 = true,
+   .lower_unpack_snorm_2x16 = true,
+   .lower_unpack_snorm_4x8 = true,
+   .lower_unpack_unorm_2x16 = true,
+   .lower_unpack_unorm_4x8 = true,
+   .lower_extract_byte = true,
+   .lower_extract_word = true,
+   .lower_hadd = true,
+   .lower_add_sat = true,
+   .lower_all_io_to_temps = true,
+   .max_unroll_iterations = 32,
+};
+
+static const void *
+llvmpipe_get_compiler_options(struct pipe_screen *screen,
+                              enum pipe_shader_ir ir,
+                              enum pipe_shader_type shader)
+{
+   assert(ir == PIPE_SHADER_IR_NIR);
+   return &gallivm_nir_options;
+}
+
+
 /**
  * Query format support for creating a texture, drawing surface, etc.
  * \param format  the format to test
@@ -516,6 +615,16 @@ llvmpipe_is_format_supported( struct pipe_screen *_screen,
          return FALSE;
    }
 
+   if (bind & PIPE_BIND_SHADER_IMAGE) {
+      /* the formats lp_build_store_rgba_soa() can pack */
+      if (format_desc->colorspace != UTIL_FORMAT_COLORSPACE_RGB)
+         return FALSE;
+
+      if (format_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN &&
+          format != PIPE_FORMAT_R11G11B10_FLOAT)
+         return FALSE;
+   }
+
    if ((bind & (PIPE_BIND_RENDER_TARGET | PIPE_BIND_SAMPLER_VIEW)) &&
        ((bind & PIPE_BIND_DISPLAY_TARGET) == 0)) {
       /* Disable all 3-channel formats, where channel size != 32 bits.
@@ -597,6 +706,8 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
 
    lp_jit_screen_cleanup(screen);
 
+   disk_cache_destroy(screen->disk_shader_cache);
+
    if(winsys->destroy)
       winsys->destroy(winsys);
 
@@ -608,6 +719,101 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
 
 
 
+/**
+ * Create the on-disk cache of JIT-compiled shader variants.
+ *
+ * The cache is keyed on the driver build and on everything that affects the
+ * generated machine code beyond the variant itself, namely the LLVM build,
+ * the gallivm optimization flags and the CPU features used for codegen.
+ */
+static void
+lp_disk_cache_create(struct llvmpipe_screen *screen)
+{
+   /* Without dladdr() there is no driver build to key the cache on, so
+    * llvmpipe runs without one.
+    */
+#if defined(ENABLE_SHADER_CACHE) && defined(HAVE_DLFCN_H)
+   struct mesa_sha1 ctx;
+   unsigned char sha1[20];
+   char cache_id[20 * 2 + 1];
+
+   _mesa_sha1_init(&ctx);
+
+   if (!disk_cache_get_function_identifier(lp_disk_cache_create, &ctx) ||
+       !disk_cache_get_function_identifier(LLVMLinkInMCJIT, &ctx))
+      return;
+
+   _mesa_sha1_update(&ctx, &gallivm_perf, sizeof(gallivm_perf));
+   _mesa_sha1_update(&ctx, &lp_native_vector_width,
+                     sizeof(lp_native_vector_width));
+   _mesa_sha1_update(&ctx, &util_cpu_caps, sizeof(util_cpu_caps));
+   _mesa_sha1_final(&ctx, sha1);
+   disk_cache_format_hex_id(cache_id, sha1, 20 * 2);
+
+   screen->disk_shader_cache = disk_cache_create("llvmpipe", cache_id, 0);
+#endif
+}
+
+
+static struct disk_cache *
+llvmpipe_get_disk_shader_cache(struct pipe_screen *_screen)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+
+   return screen->disk_shader_cache;
+}
+
+
+/**
+ * Look up the machine code of a variant in the on-disk cache.
+ * On a hit, cache->data is filled in and owned by the gallivm state.
+ */
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          unsigned char ir_sha1_cache_key[20])
+{
+   unsigned char sha1[CACHE_KEY_SIZE];
+   size_t binary_size;
+   uint8_t *buffer;
+
+   if (!screen->disk_shader_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key, 20,
+                          sha1);
+
+   buffer = disk_cache_get(screen->disk_shader_cache, sha1, &binary_size);
+   if (!buffer) {
+      cache->data_size = 0;
+      return;
+   }
+   cache->data_size = binary_size;
+   cache->data = buffer;
+}
+
+
+/**
+ * Store the machine code recorded while jitting a variant.
+ * Must be called before gallivm_free_ir().
+ */
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            unsigned char ir_sha1_cache_key[20])
+{
+   unsigned char sha1[CACHE_KEY_SIZE];
+
+   if (!screen->disk_shader_cache || !cache->data_size || cache->dont_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key, 20,
+                          sha1);
+   disk_cache_put(screen->disk_shader_cache, sha1, cache->data,
+                  cache->data_size, NULL);
+}
+
+
 /**
  * Fence reference counting.
  */
@@ -646,12 +852,151 @@ llvmpipe_fence_finish(struct pipe_screen *screen,
    return TRUE;
 }
 
+static int
+llvmpipe_get_compute_param(struct pipe_screen *_screen,
+                           enum pipe_shader_ir ir_type,
+                           enum pipe_compute_cap param,
+                           void *ret)
+{
+   switch (param) {
+   case PIPE_COMPUTE_CAP_IR_TARGET:
+      return 0;
+   case PIPE_COMPUTE_CAP_MAX_GRID_SIZE:
+      if (ret) {
+         uint64_t *grid_size = ret;
+         grid_size[0] = 65535;
+         grid_size[1] = 65535;
+         grid_size[2] = 65535;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_BLOCK_SIZE:
+      if (ret) {
+         uint64_t *block_size = ret;
+         block_size[0] = 1024;
+         block_size[1] = 1024;
+         block_size[2] = 64;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_THREADS_PER_BLOCK:
+      if (ret) {
+         uint64_t *max_threads_per_block = ret;
+         *max_threads_per_block = 1024;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_LOCAL_SIZE:
+      if (ret) {
+         uint64_t *max_local_size = ret;
+         *max_local_size = 32768;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_GRID_DIMENSION:
+      if (ret) {
+         uint64_t *grid_dim = ret;
+         *grid_dim = 3;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_GLOBAL_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_PRIVATE_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_INPUT_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_MEM_ALLOC_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_CLOCK_FREQUENCY:
+   case PIPE_COMPUTE_CAP_MAX_COMPUTE_UNITS:
+   case PIPE_COMPUTE_CAP_IMAGES_SUPPORTED:
+   case PIPE_COMPUTE_CAP_SUBGROUP_SIZE:
+   case PIPE_COMPUTE_CAP_ADDRESS_BITS:
+   case PIPE_COMPUTE_CAP_MAX_VARIABLE_THREADS_PER_BLOCK:
+      break;
+   }
+   return 0;
+}
+
 static uint64_t
 llvmpipe_get_timestamp(struct pipe_screen *_screen)
 {
    return os_time_get_nano();
 }
 
+
+static int
+llvmpipe_get_driver_query_info(struct pipe_screen *_screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+   const unsigned num_threads = MAX2(1, screen->num_threads);
+
+#define QUERY(NAME, ENUM, UNITS) \
+   {NAME, ENUM, {0}, UNITS, PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE, 0, 0x0}
+
+   static const struct pipe_driver_query_info queries[] = {
+      QUERY("bin-time", LP_QUERY_BIN_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS),
+      QUERY("rast-time", LP_QUERY_RAST_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS),
+      QUERY("compile-time", LP_QUERY_COMPILE_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS),
+      QUERY("num-compiles", LP_QUERY_NUM_COMPILES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("num-flushes", LP_QUERY_NUM_FLUSHES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("num-explicit-flushes", LP_QUERY_NUM_EXPLICIT_FLUSHES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("num-scene-size-flushes", LP_QUERY_NUM_SCENE_SIZE_FLUSHES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("num-resource-size-flushes", LP_QUERY_NUM_RESOURCE_SIZE_FLUSHES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("num-oom-flushes", LP_QUERY_NUM_OOM_FLUSHES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("num-indexed-vertices", LP_QUERY_NUM_INDEXED_VERTICES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("num-shaded-vertices", LP_QUERY_NUM_SHADED_VERTICES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+   };
+#undef QUERY
+
+   if (!info)
+      return ARRAY_SIZE(queries) + num_threads;
+
+   if (index < ARRAY_SIZE(queries)) {
+      *info = queries[index];
+      return 1;
+   }
+
+   /* rasterization time of each thread */
+   index -= ARRAY_SIZE(queries);
+   if (index >= num_threads)
+      return 0;
+
+   memset(info, 0, sizeof *info);
+   info->name = screen->rast_time_query_names[index];
+   info->query_type = LP_QUERY_RAST_TIME_THREAD0 + index;
+   info->type = PIPE_DRIVER_QUERY_TYPE_MICROSECONDS;
+   info->result_type = PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE;
+   return 1;
+}
+
+
+static int
+llvmpipe_get_driver_query_group_info(struct pipe_screen *_screen,
+                                     unsigned index,
+                                     struct pipe_driver_query_group_info *info)
+{
+   const unsigned num_queries =
+      llvmpipe_get_driver_query_info(_screen, 0, NULL);
+
+   if (!info)
+      return 1;
+
+   if (index != 0)
+      return 0;
+
+   info->name = "llvmpipe";
+   info->max_active_queries = num_queries;
+   info->num_queries = num_queries;
+   return 1;
+}
+
+
 /**
  * Create a new pipe_screen object
  * Note: we're not presently subclassing pipe_screen (no llvmpipe_screen).
@@ -660,6 +1005,7 @@ struct pipe_screen *
 llvmpipe_create_screen(struct sw_winsys *winsys)
 {
    struct llvmpipe_screen *screen;
+   unsigned i;
 
    util_cpu_detect();
 
@@ -688,6 +1034,8 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.get_param = llvmpipe_get_param;
    screen->base.get_shader_param = llvmpipe_get_shader_param;
    screen->base.get_paramf = llvmpipe_get_paramf;
+   screen->base.get_compute_param = llvmpipe_get_compute_param;
+   screen->base.get_compiler_options = llvmpipe_get_compiler_options;
    screen->base.is_format_supported = llvmpipe_is_format_supported;
 
    screen->base.context_create = llvmpipe_create_context;
@@ -696,6 +1044,10 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.fence_finish = llvmpipe_fence_finish;
 
    screen->base.get_timestamp = llvmpipe_get_timestamp;
+   screen->base.get_disk_shader_cache = llvmpipe_get_disk_shader_cache;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
+   screen->base.get_driver_query_group_info =
+      llvmpipe_get_driver_query_group_info;
 
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
@@ -706,6 +1058,11 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS", screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
 
+   for (i = 0; i < LP_MAX_THREADS; i++)
+      util_snprintf(screen->rast_time_query_names[i],
+                    sizeof screen->rast_time_query_names[i],
+                    "rast-time-thread%u", i);
+
    screen->rast = lp_rast_create(screen->num_threads);
    if (!screen->rast) {
       lp_jit_screen_cleanup(screen);
@@ -714,5 +1071,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    }
    (void) mtx_init(&screen->rast_mutex, mtx_plain);
 
+   lp_disk_cache_create(screen);
+
    return &screen->base;
 }
@@ -37,10 +37,14 @@
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
 #include "os/os_thread.h"
+#include "util/u_atomic.h"
 #include "gallivm/lp_bld.h"
+#include "lp_limits.h"
 
 
 struct sw_winsys;
+struct lp_cached_code;
+struct disk_cache;
 
 
 struct llvmpipe_screen
@@ -57,6 +61,15 @@ struct llvmpipe_screen
 
    struct lp_rasterizer *rast;
    mtx_t rast_mutex;
+
+   struct disk_cache *disk_shader_cache;
+
+   /** JIT compilation counters, updated by the compiler threads too */
+   uint64_t compile_time;  /**< in nanoseconds */
+   uint64_t num_compiles;
+
+   /** Names of the per-thread rasterization time queries */
+   char rast_time_query_names[LP_MAX_THREADS][32];
 };
 
 
@@ -69,5 +82,27 @@ llvmpipe_screen( struct pipe_screen *pipe )
 }
 
 
+/**
+ * Account for the generation and compilation of a shader variant, which
+ * took the given number of nanoseconds.
+ */
+static inline void
+llvmpipe_screen_count_compile(struct llvmpipe_screen *screen, int64_t time)
+{
+   p_atomic_add(&screen->compile_time, time);
+   p_atomic_inc(&screen->num_compiles);
+}
+
+
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          unsigned char ir_sha1_cache_key[20]);
+
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            unsigned char ir_sha1_cache_key[20]);
+
 
 #endif /* LP_SCREEN_H */
@@ -64,26 +64,57 @@ static boolean set_scene_state( struct lp_setup_context *, enum setup_state,
 static boolean try_update_scene_state( struct lp_setup_context *setup );
 
 
+/**
+ * Find a scene which isn't queued for rasterization anymore.  Prefer
+ * creating a new scene over waiting for the rasterizer, up to max_scenes.
+ * When all scenes are in flight, wait for the oldest one.
+ */
 static void
 lp_setup_get_empty_scene(struct lp_setup_context *setup)
 {
+   struct lp_scene *scene = NULL;
+   unsigned i;
+
    assert(setup->scene == NULL);
 
-   setup->scene_idx++;
-   setup->scene_idx %= ARRAY_SIZE(setup->scenes);
+   for (i = 0; i < setup->num_scenes; i++) {
+      struct lp_scene *s = setup->scenes[i];
+      if (!s->fence || lp_fence_signalled(s->fence)) {
+         scene = s;
+         break;
+      }
+   }
 
-   setup->scene = setup->scenes[setup->scene_idx];
+   if (!scene && setup->num_scenes < setup->max_scenes) {
+      scene = lp_scene_create(setup->pipe);
+      if (scene)
+         setup->scenes[setup->num_scenes++] = scene;
+   }
+
+   if (!scene) {
+      /* Scenes are rasterized in order, so the oldest fence is the first
+       * one to be signalled.
+       */
+      scene = setup->scenes[0];
+      for (i = 1; i < setup->num_scenes; i++) {
+         if (setup->scenes[i]->fence->id < scene->fence->id)
+            scene = setup->scenes[i];
+      }
 
-   if (setup->scene->fence) {
       if (LP_DEBUG & DEBUG_SETUP)
          debug_printf("%s: wait for scene %d\n",
-                      __FUNCTION__, setup->scene->fence->id);
+                      __FUNCTION__, scene->fence->id);
 
-      lp_fence_wait(setup->scene->fence);
+      lp_fence_wait(scene->fence);
    }
 
-   lp_scene_begin_binning(setup->scene, &setup->fb);
+   /* Release what the scene still holds from its previous use. */
+   if (scene->fence)
+      lp_scene_reset(scene);
 
+   setup->scene = scene;
+
+   lp_scene_begin_binning(setup->scene, &setup->fb);
 }
 
 
@@ -165,23 +196,15 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
-   mtx_lock(&screen->rast_mutex);
-
-   /* FIXME: We enqueue the scene then wait on the rasterizer to finish.
-    * This means we never actually run any vertex stuff in parallel to
-    * rasterization (not in the same context at least) which is what the
-    * multiple scenes per setup is about - when we get a new empty scene
-    * any old one is already empty again because we waited here for
-    * raster tasks to be finished. Ideally, we shouldn't need to wait here
-    * and rely on fences elsewhere when waiting is necessary.
-    * Certainly, lp_scene_end_rasterization() would need to be deferred too
-    * and there's probably other bits why this doesn't actually work.
+   /* We don't wait for the rasterizer here, so that binning of the next
+    * scene overlaps with rasterization of this one.  The scene keeps its
+    * resource references until it is reused after its fence has been
+    * signalled, see lp_setup_get_empty_scene().
     */
+   mtx_lock(&screen->rast_mutex);
    lp_rast_queue_scene(screen->rast, scene);
-   lp_rast_finish(screen->rast);
    mtx_unlock(&screen->rast_mutex);
 
-   lp_scene_end_rasterization(setup->scene);
    lp_setup_reset( setup );
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
@@ -199,9 +222,10 @@ begin_binning( struct lp_setup_context *setup )
    assert(scene);
    assert(scene->fence == NULL);
 
-   /* Always create a fence:
+   /* Always create a fence.  It is signalled once, by the rasterizer,
+    * after all threads are done with the scene.
     */
-   scene->fence = lp_fence_create(MAX2(1, setup->num_threads));
+   scene->fence = lp_fence_create(1);
    if (!scene->fence)
       return FALSE;
 
@@ -261,6 +285,7 @@ begin_binning( struct lp_setup_context *setup )
    setup->clear.zsvalue = 0;
 
    scene->had_queries = !!setup->active_binned_queries;
+   scene->writes_memory = FALSE;
 
    LP_DBG(DEBUG_SETUP, "%s done\n", __FUNCTION__);
    return TRUE;
@@ -330,6 +355,7 @@ set_scene_state( struct lp_setup_context *setup,
 
       lp_setup_rasterize_scene( setup );
       assert(setup->scene == NULL);
+      setup->stats.num_flushes++;
       break;
 
    default:
@@ -342,7 +368,7 @@ set_scene_state( struct lp_setup_context *setup,
 
 fail:
    if (setup->scene) {
-      lp_scene_end_rasterization(setup->scene);
+      lp_scene_reset(setup->scene);
       setup->scene = NULL;
    }
 
@@ -352,11 +378,34 @@ fail:
 }
 
 
+/**
+ * Count the flush of a scene which ran out of space, by cause.
+ */
+static void
+count_scene_full(struct lp_setup_context *setup)
+{
+   struct lp_scene *scene = setup->scene;
+
+   if (!scene)
+      return;
+
+   if (lp_scene_is_oom(scene))
+      setup->stats.num_scene_size_flushes++;
+   else if (scene->resource_reference_size >= LP_SCENE_MAX_RESOURCE_SIZE)
+      setup->stats.num_resource_size_flushes++;
+   else
+      setup->stats.num_oom_flushes++;
+}
+
+
 void
 lp_setup_flush( struct lp_setup_context *setup,
                 struct pipe_fence_handle **fence,
                 const char *reason)
 {
+   if (setup->state != SETUP_FLUSHED)
+      setup->stats.num_explicit_flushes++;
+
    set_scene_state( setup, SETUP_FLUSHED, reason );
 
    if (fence) {
@@ -553,7 +602,8 @@ lp_setup_clear( struct lp_setup_context *setup,
    if (flags & PIPE_CLEAR_DEPTHSTENCIL) {
       unsigned flagszs = flags & PIPE_CLEAR_DEPTHSTENCIL;
       if (!lp_setup_try_clear_zs(setup, depth, stencil, flagszs)) {
-         lp_setup_flush(setup, NULL, __FUNCTION__);
+         count_scene_full(setup);
+         set_scene_state(setup, SETUP_FLUSHED, __FUNCTION__);
 
          if (!lp_setup_try_clear_zs(setup, depth, stencil, flagszs))
             assert(0);
@@ -565,7 +615,8 @@ lp_setup_clear( struct lp_setup_context *setup,
       for (i = 0; i < setup->fb.nr_cbufs; i++) {
          if ((flags & (1 << (2 + i))) && setup->fb.cbufs[i]) {
             if (!lp_setup_try_clear_color_buffer(setup, color, i)) {
-               lp_setup_flush(setup, NULL, __FUNCTION__);
+               count_scene_full(setup);
+               set_scene_state(setup, SETUP_FLUSHED, __FUNCTION__);
 
                if (!lp_setup_try_clear_color_buffer(setup, color, i))
                   assert(0);
@@ -665,6 +716,31 @@ lp_setup_set_fs_constants(struct lp_setup_context *setup,
 }
 
 
+void
+lp_setup_set_fs_ssbos(struct lp_setup_context *setup,
+                      unsigned num,
+                      const struct pipe_shader_buffer *buffers)
+{
+   unsigned i;
+
+   LP_DBG(DEBUG_SETUP, "%s %p\n", __FUNCTION__, (void *) buffers);
+
+   assert(num <= ARRAY_SIZE(setup->ssbos));
+
+   for (i = 0; i < num; ++i) {
+      pipe_resource_reference(&setup->ssbos[i].buffer, buffers[i].buffer);
+      setup->ssbos[i].buffer_offset = buffers[i].buffer_offset;
+      setup->ssbos[i].buffer_size = buffers[i].buffer_size;
+   }
+   for (; i < ARRAY_SIZE(setup->ssbos); i++) {
+      pipe_resource_reference(&setup->ssbos[i].buffer, NULL);
+      setup->ssbos[i].buffer_offset = 0;
+      setup->ssbos[i].buffer_size = 0;
+   }
+   setup->dirty |= LP_SETUP_NEW_SSBOS;
+}
+
+
 void
 lp_setup_set_alpha_ref_value( struct lp_setup_context *setup,
                               float alpha_ref_value )
@@ -809,119 +885,13 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
       struct pipe_sampler_view *view = i < num ? views[i] : NULL;
 
       if (view) {
-         struct pipe_resource *res = view->texture;
-         struct llvmpipe_resource *lp_tex = llvmpipe_resource(res);
-         struct lp_jit_texture *jit_tex;
-         jit_tex = &setup->fs.current.jit_context.textures[i];
-
          /* We're referencing the texture's internal data, so save a
           * reference to it.
           */
-         pipe_resource_reference(&setup->fs.current_tex[i], res);
-
-         if (!lp_tex->dt) {
-            /* regular texture - setup array of mipmap level offsets */
-            int j;
-            unsigned first_level = 0;
-            unsigned last_level = 0;
-
-            if (llvmpipe_resource_is_texture(res)) {
-               first_level = view->u.tex.first_level;
-               last_level = view->u.tex.last_level;
-               assert(first_level <= last_level);
-               assert(last_level <= res->last_level);
-               jit_tex->base = lp_tex->tex_data;
-            }
-            else {
-              jit_tex->base = lp_tex->data;
-            }
+         pipe_resource_reference(&setup->fs.current_tex[i], view->texture);
 
-            if (LP_PERF & PERF_TEX_MEM) {
-               /* use dummy tile memory */
-               jit_tex->base = lp_dummy_tile;
-               jit_tex->width = TILE_SIZE/8;
-               jit_tex->height = TILE_SIZE/8;
-               jit_tex->depth = 1;
-               jit_tex->first_level = 0;
-               jit_tex->last_level = 0;
-               jit_tex->mip_offsets[0] = 0;
-               jit_tex->row_stride[0] = 0;
-               jit_tex->img_stride[0] = 0;
-            }
-            else {
-               jit_tex->width = res->width0;
-               jit_tex->height = res->height0;
-               jit_tex->depth = res->depth0;
-               jit_tex->first_level = first_level;
-               jit_tex->last_level = last_level;
-
-               if (llvmpipe_resource_is_texture(res)) {
-                  for (j = first_level; j <= last_level; j++) {
-                     jit_tex->mip_offsets[j] = lp_tex->mip_offsets[j];
-                     jit_tex->row_stride[j] = lp_tex->row_stride[j];
-                     jit_tex->img_stride[j] = lp_tex->img_stride[j];
-                  }
-
-                  if (res->target == PIPE_TEXTURE_1D_ARRAY ||
-                      res->target == PIPE_TEXTURE_2D_ARRAY ||
-                      res->target == PIPE_TEXTURE_CUBE ||
-                      res->target == PIPE_TEXTURE_CUBE_ARRAY) {
-                     /*
-                      * For array textures, we don't have first_layer, instead
-                      * adjust last_layer (stored as depth) plus the mip level offsets
-                      * (as we have mip-first layout can't just adjust base ptr).
-                      * XXX For mip levels, could do something similar.
-                      */
-                     jit_tex->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
-                     for (j = first_level; j <= last_level; j++) {
-                        jit_tex->mip_offsets[j] += view->u.tex.first_layer *
-                                                   lp_tex->img_stride[j];
-                     }
-                     if (view->target == PIPE_TEXTURE_CUBE ||
-                         view->target == PIPE_TEXTURE_CUBE_ARRAY) {
-                        assert(jit_tex->depth % 6 == 0);
-                     }
-                     assert(view->u.tex.first_layer <= view->u.tex.last_layer);
-                     assert(view->u.tex.last_layer < res->array_size);
-                  }
-               }
-               else {
-                  /*
-                   * For buffers, we don't have "offset", instead adjust
-                   * the size (stored as width) plus the base pointer.
-                   */
-                  unsigned view_blocksize = util_format_get_blocksize(view->format);
-                  /* probably don't really need to fill that out */
-                  jit_tex->mip_offsets[0] = 0;
-                  jit_tex->row_stride[0] = 0;
-                  jit_tex->img_stride[0] = 0;
-
-                  /* everything specified in number of elements here. */
-                  jit_tex->width = view->u.buf.size / view_blocksize;
-                  jit_tex->base = (uint8_t *)jit_tex->base + view->u.buf.offset;
-                  /* XXX Unsure if we need to sanitize parameters? */
-                  assert(view->u.buf.offset + view->u.buf.size <= res->width0);
-               }
-            }
-         }
-         else {
-            /* display target texture/surface */
-            /*
-             * XXX: Where should this be unmapped?
-             */
-            struct llvmpipe_screen *screen = llvmpipe_screen(res->screen);
-            struct sw_winsys *winsys = screen->winsys;
-            jit_tex->base = winsys->displaytarget_map(winsys, lp_tex->dt,
-                                                         PIPE_TRANSFER_READ);
-            jit_tex->row_stride[0] = lp_tex->row_stride[0];
-            jit_tex->img_stride[0] = lp_tex->img_stride[0];
-            jit_tex->mip_offsets[0] = 0;
-            jit_tex->width = res->width0;
-            jit_tex->height = res->height0;
-            jit_tex->depth = res->depth0;
-            jit_tex->first_level = jit_tex->last_level = 0;
-            assert(jit_tex->base);
-         }
+         lp_jit_texture_from_view(&setup->fs.current.jit_context.textures[i],
+                                  view);
       }
       else {
          pipe_resource_reference(&setup->fs.current_tex[i], NULL);
@@ -974,7 +944,7 @@ unsigned
 lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
                                 const struct pipe_resource *texture )
 {
-   unsigned i;
+   unsigned i, j;
 
    /* check the render targets */
    for (i = 0; i < setup->fb.nr_cbufs; i++) {
@@ -985,10 +955,30 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
       return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
 
-   /* check textures referenced by the scene */
-   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
-         return LP_REFERENCED_FOR_READ;
+   /* check textures referenced by the scenes still being binned or
+    * rasterized; those already rasterized don't access them anymore.
+    */
+   for (i = 0; i < setup->num_scenes; i++) {
+      struct lp_scene *scene = setup->scenes[i];
+
+      if (scene->fence && lp_fence_signalled(scene->fence))
+         continue;
+
+      /* a queued scene may still be drawing to a previously bound fb */
+      for (j = 0; j < scene->fb.nr_cbufs; j++) {
+         if (scene->fb.cbufs[j] && scene->fb.cbufs[j]->texture == texture)
+            return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+      }
+      if (scene->fb.zsbuf && scene->fb.zsbuf->texture == texture)
+         return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+
+      /* the fragment shaders of the scene may write to any buffer it
+       * references
+       */
+      if (lp_scene_is_resource_referenced(scene, texture)) {
+         return scene->writes_memory ?
+                LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE :
+                LP_REFERENCED_FOR_READ;
       }
    }
 
@@ -1136,6 +1126,37 @@ try_update_scene_state( struct lp_setup_context *setup )
    }
 
 
+   if (setup->dirty & LP_SETUP_NEW_SSBOS) {
+      for (i = 0; i < ARRAY_SIZE(setup->ssbos); ++i) {
+         struct pipe_resource *buffer = setup->ssbos[i].buffer;
+
+         /* The shader writes to the buffers in place, so they are only
+          * referenced by the scene rather than copied like the constants.
+          */
+         if (buffer) {
+            const ubyte *data = (ubyte *) llvmpipe_resource_data(buffer);
+
+            if (!lp_scene_add_resource_reference(scene, buffer, new_scene)) {
+               assert(!new_scene);
+               return FALSE;
+            }
+            setup->fs.current.jit_context.ssbos[i] =
+               (const uint32_t *) (data + setup->ssbos[i].buffer_offset);
+            setup->fs.current.jit_context.num_ssbos[i] =
+               setup->ssbos[i].buffer_size;
+         }
+         else {
+            setup->fs.current.jit_context.ssbos[i] = NULL;
+            setup->fs.current.jit_context.num_ssbos[i] = 0;
+         }
+      }
+      setup->dirty |= LP_SETUP_NEW_FS;
+   }
+
+   if (setup->fs.current.variant &&
+       setup->fs.current.variant->shader->info.base.writes_memory)
+      scene->writes_memory = TRUE;
+
    if (setup->dirty & LP_SETUP_NEW_FS) {
       if (!setup->fs.stored ||
           memcmp(setup->fs.stored,
@@ -1251,6 +1272,7 @@ lp_setup_update_state( struct lp_setup_context *setup,
        * Cannot call lp_setup_flush_and_restart() directly here
        * because of potential recursion.
        */
+      count_scene_full(setup);
       if (!set_scene_state(setup, SETUP_FLUSHED, __FUNCTION__))
          return FALSE;
 
@@ -1287,12 +1309,18 @@ lp_setup_destroy( struct lp_setup_context *setup )
       pipe_resource_reference(&setup->constants[i].current.buffer, NULL);
    }
 
-   /* free the scenes in the 'empty' queue */
-   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
+   for (i = 0; i < ARRAY_SIZE(setup->ssbos); i++) {
+      pipe_resource_reference(&setup->ssbos[i].buffer, NULL);
+   }
+
+   /* wait for the scenes still in flight, then free all of them */
+   for (i = 0; i < setup->num_scenes; i++) {
       struct lp_scene *scene = setup->scenes[i];
 
-      if (scene->fence)
+      if (scene->fence) {
          lp_fence_wait(scene->fence);
+         lp_scene_reset(scene);
+      }
 
       lp_scene_destroy(scene);
    }
@@ -1314,7 +1342,6 @@ lp_setup_create( struct pipe_context *pipe,
 {
    struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
    struct lp_setup_context *setup;
-   unsigned i;
 
    setup = CALLOC_STRUCT(lp_setup_context);
    if (!setup) {
@@ -1337,13 +1364,15 @@ lp_setup_create( struct pipe_context *pipe,
    draw_set_rasterize_stage(draw, setup->vbuf);
    draw_set_render(draw, &setup->base);
 
-   /* create some empty scenes */
-   for (i = 0; i < MAX_SCENES; i++) {
-      setup->scenes[i] = lp_scene_create( pipe );
-      if (!setup->scenes[i]) {
-         goto no_scenes;
-      }
+   setup->max_scenes = debug_get_num_option("LP_MAX_SCENES", MAX_SCENES);
+   setup->max_scenes = CLAMP(setup->max_scenes, 1, MAX_SCENES);
+
+   /* create the first empty scene, more are created on demand */
+   setup->scenes[0] = lp_scene_create( pipe );
+   if (!setup->scenes[0]) {
+      goto no_scenes;
    }
+   setup->num_scenes = 1;
 
    setup->triangle = first_triangle;
    setup->line     = first_line;
@@ -1358,12 +1387,6 @@ lp_setup_create( struct pipe_context *pipe,
    return setup;
 
 no_scenes:
-   for (i = 0; i < MAX_SCENES; i++) {
-      if (setup->scenes[i]) {
-         lp_scene_destroy(setup->scenes[i]);
-      }
-   }
-
    setup->vbuf->destroy(setup->vbuf);
 no_vbuf:
    FREE(setup);
@@ -1498,6 +1521,8 @@ lp_setup_flush_and_restart(struct lp_setup_context *setup)
 
    assert(setup->state == SETUP_ACTIVE);
 
+   count_scene_full(setup);
+
    if (!set_scene_state(setup, SETUP_FLUSHED, __FUNCTION__))
       return FALSE;
    
@@ -1508,3 +1533,8 @@ lp_setup_flush_and_restart(struct lp_setup_context *setup)
 }
 
 
+const struct lp_setup_stats *
+lp_setup_get_stats(const struct lp_setup_context *setup)
+{
+   return &setup->stats;
+}
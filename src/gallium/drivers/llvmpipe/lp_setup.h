@@ -47,6 +47,21 @@ struct pipe_fence_handle;
 struct lp_setup_variant;
 struct lp_setup_context;
 
+
+/**
+ * Counters kept by setup for the driver queries.
+ */
+struct lp_setup_stats
+{
+   uint64_t bin_time;                /**< nanoseconds spent binning */
+   uint64_t num_flushes;             /**< scenes sent to the rasterizer */
+   uint64_t num_explicit_flushes;    /**< lp_setup_flush() calls */
+   uint64_t num_scene_size_flushes;  /**< scene reached LP_SCENE_MAX_SIZE */
+   uint64_t num_resource_size_flushes; /**< LP_SCENE_MAX_RESOURCE_SIZE */
+   uint64_t num_oom_flushes;         /**< failed scene allocations */
+};
+
+
 void lp_setup_reset( struct lp_setup_context *setup );
 
 struct lp_setup_context *
@@ -104,6 +119,11 @@ lp_setup_set_fs_constants(struct lp_setup_context *setup,
                           unsigned num,
                           struct pipe_constant_buffer *buffers);
 
+void
+lp_setup_set_fs_ssbos(struct lp_setup_context *setup,
+                      unsigned num,
+                      const struct pipe_shader_buffer *buffers);
+
 void
 lp_setup_set_alpha_ref_value( struct lp_setup_context *setup,
                               float alpha_ref_value );
@@ -159,6 +179,9 @@ void
 lp_setup_end_query(struct lp_setup_context *setup,
                    struct llvmpipe_query *pq);
 
+const struct lp_setup_stats *
+lp_setup_get_stats(const struct lp_setup_context *setup);
+
 static inline unsigned
 lp_clamp_viewport_idx(int idx)
 {
@@ -233,8 +233,11 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
        * were just active we also can't do the optimization since to get
        * accurate query results we unfortunately need to execute the rendering
        * commands.
+       * - Rendering which wrote to shader storage buffers can't be dropped
+       * either.
        */
-      if (!scene->fb.zsbuf && scene->fb_max_layer == 0 && !scene->had_queries) {
+      if (!scene->fb.zsbuf && scene->fb_max_layer == 0 && !scene->had_queries &&
+          !scene->writes_memory) {
          /*
           * All previous rendering will be overwritten so reset the bin.
           */
@@ -41,6 +41,7 @@
 #include "draw/draw_vbuf.h"
 #include "draw/draw_vertex.h"
 #include "util/u_memory.h"
+#include "util/os_time.h"
 
 
 #define LP_MAX_VBUF_INDEXES 1024
@@ -139,6 +140,7 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    const unsigned stride = setup->vertex_info->size * sizeof(float);
    const void *vertex_buffer = setup->vertex_buffer;
    const boolean flatshade_first = setup->flatshade_first;
+   const int64_t t0 = os_time_get_nano();
    unsigned i;
 
    assert(setup->setup.variant);
@@ -324,6 +326,8 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    default:
       assert(0);
    }
+
+   setup->stats.bin_time += os_time_get_nano() - t0;
 }
 
 
@@ -339,6 +343,7 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    const void *vertex_buffer =
       (void *) get_vert(setup->vertex_buffer, start, stride);
    const boolean flatshade_first = setup->flatshade_first;
+   const int64_t t0 = os_time_get_nano();
    unsigned i;
 
    if (!lp_setup_update_state(setup, TRUE))
@@ -519,6 +524,8 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    default:
       assert(0);
    }
+
+   setup->stats.bin_time += os_time_get_nano() - t0;
 }
 
 
@@ -56,6 +56,8 @@
 #define LP_NEW_GS            0x10000
 #define LP_NEW_SO            0x20000
 #define LP_NEW_SO_BUFFERS    0x40000
+#define LP_NEW_FS_VARIANT    0x80000
+#define LP_NEW_FS_SSBOS      0x100000
 
 
 
@@ -90,6 +92,9 @@ llvmpipe_set_framebuffer_state(struct pipe_context *,
 void
 llvmpipe_update_fs(struct llvmpipe_context *lp);
 
+void
+llvmpipe_fs_tier_up(struct llvmpipe_context *lp);
+
 void 
 llvmpipe_update_setup(struct llvmpipe_context *lp);
 
@@ -114,6 +119,9 @@ llvmpipe_init_clip_funcs(struct llvmpipe_context *llvmpipe);
 void
 llvmpipe_init_fs_funcs(struct llvmpipe_context *llvmpipe);
 
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe);
+
 void
 llvmpipe_init_vs_funcs(struct llvmpipe_context *llvmpipe);
 
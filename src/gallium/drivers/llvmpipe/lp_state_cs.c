@@ -0,0 +1,982 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Compute shaders.
+ *
+ * A compute shader variant is a function which runs all the invocations
+ * of one workgroup, a SIMD vector of invocations at a time.  The
+ * workgroups of a dispatch are distributed over the rasterizer threads.
+ *
+ * Barriers are implemented with LLVM coroutines: each SIMD vector of
+ * invocations runs in its own coroutine, which suspends at every barrier.
+ * The workgroup function resumes the coroutines in turn until they are
+ * all done, so all the invocations reach a barrier before any of them
+ * goes past it.
+ */
+
+#include "pipe/p_defines.h"
+#include "pipe/p_shader_tokens.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+#include "util/simple_list.h"
+#include "util/mesa-sha1.h"
+#include "util/os_time.h"
+#include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
+#include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_intr.h"
+#include "gallivm/lp_bld_logic.h"
+#include "gallivm/lp_bld_tgsi.h"
+#include "gallivm/lp_bld_nir.h"
+#include "gallivm/lp_bld_swizzle.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_coro.h"
+#include "gallivm/lp_bld_debug.h"
+#include "nir/nir_to_tgsi_info.h"
+
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_fence.h"
+#include "lp_flush.h"
+#include "lp_limits.h"
+#include "lp_query.h"
+#include "lp_rast.h"
+#include "lp_screen.h"
+#include "lp_state.h"
+#include "lp_state_cs.h"
+#include "lp_tex_sample.h"
+#include "lp_texture.h"
+
+
+/** shader number (for debugging) */
+static unsigned cs_no = 0;
+
+/** Bound for unbound constant buffers, like lp_setup's */
+static const float fake_const_buf[4];
+
+
+/**
+ * Compute shader interface, extended with what the barriers need.
+ */
+struct lp_cs_iface
+{
+   struct lp_build_tgsi_cs_iface base;
+
+   struct lp_build_coro_suspend_info sus_info;
+};
+
+
+#if GALLIVM_HAVE_CORO
+
+/**
+ * Barrier: suspend the coroutine, to be resumed once all the other SIMD
+ * vectors of the workgroup got to the same barrier.
+ */
+static void
+cs_iface_emit_barrier(const struct lp_build_tgsi_cs_iface *cs_iface,
+                      struct lp_build_context *bld)
+{
+   const struct lp_cs_iface *iface = (const struct lp_cs_iface *)cs_iface;
+   struct gallivm_state *gallivm = bld->gallivm;
+   LLVMBasicBlockRef resume = lp_build_insert_new_block(gallivm, "resume");
+
+   lp_build_coro_suspend_switch(gallivm, &iface->sus_info, resume, FALSE);
+   LLVMPositionBuilderAtEnd(gallivm->builder, resume);
+}
+
+#endif /* GALLIVM_HAVE_CORO */
+
+
+/**
+ * Run the shader for one SIMD vector of invocations of a workgroup.
+ * The invocations are numbered linearly, x first, and the ones past the
+ * end of the workgroup are masked out.
+ */
+static void
+generate_cs_chunk(struct gallivm_state *gallivm,
+                  struct lp_compute_shader *shader,
+                  struct lp_type cs_type,
+                  LLVMValueRef context_ptr,
+                  LLVMValueRef thread_data_ptr,
+                  LLVMValueRef block_id[3],
+                  LLVMValueRef grid_size[3],
+                  LLVMValueRef block_size[3],
+                  LLVMValueRef chunk,
+                  const struct lp_build_sampler_soa *sampler,
+                  struct lp_cs_iface *cs_iface)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type uint_type = lp_uint_type(cs_type);
+   struct lp_build_context uint_bld;
+   struct lp_bld_tgsi_system_values system_values;
+   struct lp_build_mask_context mask;
+   LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
+   LLVMValueRef offsets[LP_MAX_VECTOR_LENGTH];
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   LLVMValueRef invocation, total, size_x, size_y, tmp;
+   unsigned i;
+
+   lp_build_context_init(&uint_bld, gallivm, uint_type);
+
+   memset(&system_values, 0, sizeof(system_values));
+   memset(outputs, 0, sizeof outputs);
+
+   /* invocation = chunk * length + { 0, 1, ..., length - 1 } */
+   for (i = 0; i < cs_type.length; i++)
+      offsets[i] = lp_build_const_int32(gallivm, i);
+   tmp = LLVMBuildMul(builder, chunk,
+                      lp_build_const_int32(gallivm, cs_type.length), "");
+   invocation = LLVMBuildAdd(builder,
+                             lp_build_broadcast_scalar(&uint_bld, tmp),
+                             LLVMConstVector(offsets, cs_type.length),
+                             "invocation");
+
+   size_x = lp_build_broadcast_scalar(&uint_bld, block_size[0]);
+   size_y = lp_build_broadcast_scalar(&uint_bld, block_size[1]);
+   system_values.thread_id[0] = LLVMBuildURem(builder, invocation, size_x, "");
+   tmp = LLVMBuildUDiv(builder, invocation, size_x, "");
+   system_values.thread_id[1] = LLVMBuildURem(builder, tmp, size_y, "");
+   system_values.thread_id[2] = LLVMBuildUDiv(builder, tmp, size_y, "");
+
+   for (i = 0; i < 3; i++) {
+      system_values.block_id[i] = block_id[i];
+      system_values.grid_size[i] = grid_size[i];
+      system_values.block_size[i] = block_size[i];
+   }
+
+   total = LLVMBuildMul(builder, block_size[0], block_size[1], "");
+   total = LLVMBuildMul(builder, total, block_size[2], "total");
+   lp_build_mask_begin(&mask, gallivm, cs_type,
+                       lp_build_cmp(&uint_bld, PIPE_FUNC_LESS, invocation,
+                                    lp_build_broadcast_scalar(&uint_bld,
+                                                              total)));
+
+   consts_ptr = lp_jit_context_constants(gallivm, context_ptr);
+   num_consts_ptr = lp_jit_context_num_constants(gallivm, context_ptr);
+
+   cs_iface->base.ssbo_ptr = lp_jit_context_ssbos(gallivm, context_ptr);
+   cs_iface->base.ssbo_sizes_ptr = lp_jit_context_num_ssbos(gallivm,
+                                                            context_ptr);
+   cs_iface->base.shared_ptr = lp_jit_cs_thread_data_shared(gallivm,
+                                                            thread_data_ptr);
+
+   if (shader->base.type == PIPE_SHADER_IR_NIR)
+      lp_build_nir_soa(gallivm, shader->base.ir.nir, cs_type, &mask,
+                       consts_ptr, num_consts_ptr, &system_values,
+                       NULL, outputs, context_ptr, thread_data_ptr,
+                       sampler, &shader->info.base, NULL, &cs_iface->base);
+   else
+      lp_build_tgsi_soa(gallivm, shader->base.tokens, cs_type, &mask,
+                        consts_ptr, num_consts_ptr, &system_values,
+                        NULL, outputs, context_ptr, thread_data_ptr,
+                        sampler, &shader->info.base, NULL, &cs_iface->base);
+
+   lp_build_mask_end(&mask);
+}
+
+
+/**
+ * Generate the workgroup function, and for shaders with barriers, the
+ * coroutine it runs for each SIMD vector of invocations.
+ */
+static void
+generate_compute(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 struct lp_compute_shader_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   LLVMContextRef lc = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(lc);
+   LLVMTypeRef hdl_type = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+   LLVMTypeRef arg_types[12];
+   LLVMTypeRef func_type, coro_func_type;
+   LLVMValueRef function, coro = NULL;
+   LLVMValueRef args[12];
+   LLVMValueRef total, num_chunks;
+   LLVMBasicBlockRef block;
+   struct lp_build_for_loop_state loop_state;
+   struct lp_build_sampler_soa *sampler;
+   struct lp_build_image_soa *image;
+   struct lp_type cs_type;
+   const boolean use_coro =
+      shader->info.base.opcode_count[TGSI_OPCODE_BARRIER] > 0;
+   unsigned i;
+
+   assert(!use_coro || GALLIVM_HAVE_CORO);
+
+   memset(&cs_type, 0, sizeof cs_type);
+   cs_type.floating = TRUE;      /* floating point values */
+   cs_type.sign = TRUE;          /* values are signed */
+   cs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
+   cs_type.width = 32;           /* 32-bit float */
+   cs_type.length = MIN2(lp_native_vector_width / 32, 16);
+
+   /* code generated texture sampling */
+   sampler = lp_llvm_sampler_soa_create(variant->key.state);
+   image = lp_llvm_image_soa_create(variant->key.image_state);
+
+   /*
+    * Generate the function prototype. Any change here must be reflected in
+    * lp_jit.h's lp_jit_cs_func function pointer type, and vice-versa.
+    */
+   arg_types[0] = variant->jit_context_ptr_type;       /* context */
+   for (i = 1; i < 10; i++)
+      arg_types[i] = int32_type;                       /* x, y, z, grid, block */
+   arg_types[10] = variant->jit_cs_thread_data_ptr_type; /* per thread data */
+   arg_types[11] = int32_type;                         /* chunk, coro only */
+
+   /* The names must not depend on the shader numbering, as they are used
+    * to look the functions up in objects loaded from the disk cache.
+    */
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(lc), arg_types, 11, 0);
+   function = LLVMAddFunction(gallivm->module, "cs_variant", func_type);
+   LLVMSetFunctionCallConv(function, LLVMCCallConv);
+   variant->function = function;
+
+   for (i = 0; i < 11; ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(function, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   if (use_coro) {
+      coro_func_type = LLVMFunctionType(hdl_type, arg_types, 12, 0);
+      coro = LLVMAddFunction(gallivm->module, "cs_co", coro_func_type);
+      LLVMSetFunctionCallConv(coro, LLVMCCallConv);
+      /* Tell the coroutine passes to split this function. */
+      LLVMAddTargetDependentFunctionAttr(coro, "coroutine.presplit", "0");
+   }
+
+   for (i = 0; i < 11; i++)
+      args[i] = LLVMGetParam(function, i);
+
+   lp_build_name(args[0], "context");
+   lp_build_name(args[1], "x");
+   lp_build_name(args[2], "y");
+   lp_build_name(args[3], "z");
+   lp_build_name(args[4], "grid_x");
+   lp_build_name(args[5], "grid_y");
+   lp_build_name(args[6], "grid_z");
+   lp_build_name(args[7], "block_x");
+   lp_build_name(args[8], "block_y");
+   lp_build_name(args[9], "block_z");
+   lp_build_name(args[10], "thread_data");
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(lc, function, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   total = LLVMBuildMul(builder, args[7], args[8], "");
+   total = LLVMBuildMul(builder, total, args[9], "total");
+   num_chunks = LLVMBuildAdd(builder, total,
+                             lp_build_const_int32(gallivm,
+                                                  cs_type.length - 1), "");
+   num_chunks = LLVMBuildUDiv(builder, num_chunks,
+                              lp_build_const_int32(gallivm, cs_type.length),
+                              "num_chunks");
+
+   if (!use_coro) {
+      struct lp_cs_iface cs_iface;
+
+      memset(&cs_iface, 0, sizeof cs_iface);
+      cs_iface.base.image = image;
+
+      lp_build_for_loop_begin(&loop_state, gallivm,
+                              lp_build_const_int32(gallivm, 0),
+                              LLVMIntULT, num_chunks,
+                              lp_build_const_int32(gallivm, 1));
+      generate_cs_chunk(gallivm, shader, cs_type, args[0], args[10],
+                        &args[1], &args[4], &args[7],
+                        loop_state.counter, sampler, &cs_iface);
+      lp_build_for_loop_end(&loop_state);
+
+      LLVMBuildRetVoid(builder);
+   }
+#if GALLIVM_HAVE_CORO
+   else {
+      struct lp_cs_iface cs_iface;
+      LLVMValueRef coro_hdls, hdl_ptr, hdl, done;
+      LLVMValueRef coro_args[12], coro_id, coro_hdl;
+      LLVMBasicBlockRef resume_block, end_block;
+      struct lp_build_if_state ifstate;
+
+      /* Start a coroutine for each SIMD vector of invocations; each runs
+       * up to its first barrier.
+       */
+      coro_hdls = LLVMBuildArrayAlloca(builder, hdl_type, num_chunks,
+                                       "coro_hdls");
+      memcpy(coro_args, args, 11 * sizeof args[0]);
+      lp_build_for_loop_begin(&loop_state, gallivm,
+                              lp_build_const_int32(gallivm, 0),
+                              LLVMIntULT, num_chunks,
+                              lp_build_const_int32(gallivm, 1));
+      coro_args[11] = loop_state.counter;
+      hdl = LLVMBuildCall(builder, coro, coro_args, 12, "");
+      hdl_ptr = LLVMBuildGEP(builder, coro_hdls, &loop_state.counter, 1, "");
+      LLVMBuildStore(builder, hdl, hdl_ptr);
+      lp_build_for_loop_end(&loop_state);
+
+      /* Resume them in turn until they are done.  They all go through the
+       * same barriers, so they all finish in the same round.
+       */
+      resume_block = lp_build_insert_new_block(gallivm, "resume_all");
+      end_block = lp_build_insert_new_block(gallivm, "end");
+      LLVMBuildBr(builder, resume_block);
+      LLVMPositionBuilderAtEnd(builder, resume_block);
+
+      lp_build_for_loop_begin(&loop_state, gallivm,
+                              lp_build_const_int32(gallivm, 0),
+                              LLVMIntULT, num_chunks,
+                              lp_build_const_int32(gallivm, 1));
+      hdl_ptr = LLVMBuildGEP(builder, coro_hdls, &loop_state.counter, 1, "");
+      hdl = LLVMBuildLoad(builder, hdl_ptr, "");
+      lp_build_if(&ifstate, gallivm,
+                  LLVMBuildNot(builder, lp_build_coro_done(gallivm, hdl), ""));
+      lp_build_coro_resume(gallivm, hdl);
+      lp_build_endif(&ifstate);
+      lp_build_for_loop_end(&loop_state);
+
+      hdl = LLVMBuildLoad(builder, coro_hdls, "");
+      done = lp_build_coro_done(gallivm, hdl);
+      LLVMBuildCondBr(builder, done, end_block, resume_block);
+
+      LLVMPositionBuilderAtEnd(builder, end_block);
+      lp_build_for_loop_begin(&loop_state, gallivm,
+                              lp_build_const_int32(gallivm, 0),
+                              LLVMIntULT, num_chunks,
+                              lp_build_const_int32(gallivm, 1));
+      hdl_ptr = LLVMBuildGEP(builder, coro_hdls, &loop_state.counter, 1, "");
+      hdl = LLVMBuildLoad(builder, hdl_ptr, "");
+      lp_build_coro_destroy(gallivm, hdl);
+      lp_build_for_loop_end(&loop_state);
+
+      LLVMBuildRetVoid(builder);
+
+      gallivm_verify_function(gallivm, function);
+
+      /*
+       * Coroutine body
+       */
+
+      for (i = 0; i < 12; i++)
+         coro_args[i] = LLVMGetParam(coro, i);
+
+      block = LLVMAppendBasicBlockInContext(lc, coro, "entry");
+      LLVMPositionBuilderAtEnd(builder, block);
+
+      coro_id = lp_build_coro_id(gallivm);
+      coro_hdl = lp_build_coro_begin_alloc_mem(gallivm, coro_id);
+
+      memset(&cs_iface, 0, sizeof cs_iface);
+      cs_iface.base.image = image;
+      cs_iface.base.emit_barrier = cs_iface_emit_barrier;
+      cs_iface.sus_info.suspend = lp_build_insert_new_block(gallivm,
+                                                            "coro_end");
+      cs_iface.sus_info.cleanup = lp_build_insert_new_block(gallivm,
+                                                            "coro_cleanup");
+
+      generate_cs_chunk(gallivm, shader, cs_type, coro_args[0], coro_args[10],
+                        &coro_args[1], &coro_args[4], &coro_args[7],
+                        coro_args[11], sampler, &cs_iface);
+
+      lp_build_coro_suspend_switch(gallivm, &cs_iface.sus_info, NULL, TRUE);
+
+      LLVMPositionBuilderAtEnd(builder, cs_iface.sus_info.cleanup);
+      lp_build_coro_free_mem(gallivm, coro_id, coro_hdl);
+      LLVMBuildBr(builder, cs_iface.sus_info.suspend);
+
+      LLVMPositionBuilderAtEnd(builder, cs_iface.sus_info.suspend);
+      lp_build_coro_end(gallivm, coro_hdl);
+      LLVMBuildRet(builder, coro_hdl);
+
+      gallivm_verify_function(gallivm, coro);
+   }
+#endif
+
+   sampler->destroy(sampler);
+   image->destroy(image);
+
+   if (!use_coro)
+      gallivm_verify_function(gallivm, function);
+}
+
+
+/**
+ * Compute the disk cache key of a compute shader variant.
+ */
+static void
+llvmpipe_cs_get_ir_cache_key(struct lp_compute_shader *shader,
+                             const struct lp_compute_shader_variant_key *key,
+                             unsigned char ir_sha1_cache_key[20])
+{
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, key, shader->variant_key_size);
+   if (shader->base.type == PIPE_SHADER_IR_NIR) {
+      unsigned char nir_sha1[20];
+      lp_build_nir_sha1(shader->base.ir.nir, nir_sha1);
+      _mesa_sha1_update(&ctx, nir_sha1, sizeof(nir_sha1));
+   }
+   else {
+      _mesa_sha1_update(&ctx, shader->base.tokens,
+                        tgsi_num_tokens(shader->base.tokens) *
+                        sizeof(struct tgsi_token));
+   }
+   _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+}
+
+
+static struct lp_compute_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 const struct lp_compute_shader_variant_key *key)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   struct lp_compute_shader_variant *variant;
+   char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   boolean needs_caching = FALSE;
+   const int64_t t0 = os_time_get_nano();
+
+   variant = CALLOC_STRUCT(lp_compute_shader_variant);
+   if (!variant)
+      return NULL;
+
+   util_snprintf(module_name, sizeof(module_name), "cs%u_variant%u",
+                 shader->no, shader->variants_cached);
+
+   memcpy(&variant->key, key, shader->variant_key_size);
+   variant->list_item.base = variant;
+
+   llvmpipe_cs_get_ir_cache_key(shader, key, ir_sha1_cache_key);
+
+   lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+   if (!cached.data_size)
+      needs_caching = TRUE;
+
+   variant->gallivm = gallivm_create(module_name, lp->context, &cached);
+   if (!variant->gallivm) {
+      free(cached.data);
+      FREE(variant);
+      return NULL;
+   }
+
+   lp_jit_init_cs_types(variant);
+
+   generate_compute(lp, shader, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+
+   variant->jit_function = (lp_jit_cs_func)
+         gallivm_jit_function(variant->gallivm, variant->function);
+
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+
+   gallivm_free_ir(variant->gallivm);
+
+   llvmpipe_screen_count_compile(screen, os_time_get_nano() - t0);
+
+   if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
+      debug_printf("llvmpipe: cs #%u variant #%u, %u instrs\n",
+                   shader->no, shader->variants_cached, variant->nr_instrs);
+   }
+
+   return variant;
+}
+
+
+static void *
+llvmpipe_create_compute_state(struct pipe_context *pipe,
+                              const struct pipe_compute_state *templ)
+{
+   struct lp_compute_shader *shader;
+   int nr_samplers, nr_sampler_views;
+
+   assert(templ->ir_type == PIPE_SHADER_IR_TGSI ||
+          templ->ir_type == PIPE_SHADER_IR_NIR);
+
+   shader = CALLOC_STRUCT(lp_compute_shader);
+   if (!shader)
+      return NULL;
+
+   shader->no = cs_no++;
+   shader->req_local_mem = templ->req_local_mem;
+   make_empty_list(&shader->variants);
+
+   if (templ->ir_type == PIPE_SHADER_IR_NIR) {
+      struct nir_shader *nir = (struct nir_shader *) templ->prog;
+
+      /* the NIR is owned by the shader from now on */
+      shader->base.type = PIPE_SHADER_IR_NIR;
+      shader->base.ir.nir = nir;
+      lp_build_opt_nir(nir);
+      nir_tgsi_scan_shader(nir, &shader->info.base, false);
+      shader->req_local_mem = MAX2(shader->req_local_mem, nir->num_shared);
+   }
+   else {
+      shader->base.type = PIPE_SHADER_IR_TGSI;
+
+      /* get/save the summary info for this shader */
+      lp_build_tgsi_info(templ->prog, &shader->info);
+
+      /* we need to keep a local copy of the tokens */
+      shader->base.tokens = tgsi_dup_tokens(templ->prog);
+      if (!shader->base.tokens) {
+         FREE(shader);
+         return NULL;
+      }
+   }
+
+   nr_samplers = shader->info.base.file_max[TGSI_FILE_SAMPLER] + 1;
+   nr_sampler_views = shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+
+   shader->variant_key_size = Offset(struct lp_compute_shader_variant_key,
+                                     state[MAX2(nr_samplers, nr_sampler_views)]);
+
+   if (LP_DEBUG & DEBUG_TGSI) {
+      debug_printf("llvmpipe: Create compute shader #%u %p:\n",
+                   shader->no, (void *) shader);
+      if (shader->base.type == PIPE_SHADER_IR_NIR)
+         nir_print_shader(shader->base.ir.nir, stderr);
+      else
+         tgsi_dump(shader->base.tokens, 0);
+   }
+
+   return shader;
+}
+
+
+static void
+llvmpipe_bind_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+
+   llvmpipe->cs = (struct lp_compute_shader *) cs;
+}
+
+
+static void
+remove_variant(struct lp_compute_shader *shader,
+               struct lp_compute_shader_variant *variant)
+{
+   remove_from_list(&variant->list_item);
+   shader->variants_cached--;
+
+   gallivm_destroy(variant->gallivm);
+   FREE(variant);
+}
+
+
+static void
+llvmpipe_delete_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct lp_compute_shader *shader = cs;
+
+   assert(cs != llvmpipe->cs);
+
+   /* Dispatches are synchronous, so the variants can't be in use. */
+   while (!is_empty_list(&shader->variants))
+      remove_variant(shader, first_elem(&shader->variants)->base);
+
+   if (shader->base.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(shader->base.ir.nir);
+   else
+      FREE((void *) shader->base.tokens);
+   FREE(shader);
+}
+
+
+static void
+llvmpipe_set_shader_buffers(struct pipe_context *pipe,
+                            enum pipe_shader_type shader,
+                            unsigned start_slot, unsigned count,
+                            const struct pipe_shader_buffer *buffers,
+                            unsigned writable_bitmask)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   /* Only fragment and compute shaders can access shader buffers. */
+   if (shader != PIPE_SHADER_FRAGMENT && shader != PIPE_SHADER_COMPUTE)
+      return;
+
+   assert(start_slot + count <= ARRAY_SIZE(llvmpipe->ssbos[shader]));
+
+   for (i = 0; i < count; i++) {
+      struct pipe_shader_buffer *dst = &llvmpipe->ssbos[shader][start_slot + i];
+
+      if (buffers && buffers[i].buffer) {
+         /* buffers which weren't created for it are bound too, and their
+          * references by the scenes need to be tracked
+          */
+         buffers[i].buffer->bind |= PIPE_BIND_SHADER_BUFFER;
+         pipe_resource_reference(&dst->buffer, buffers[i].buffer);
+         dst->buffer_offset = buffers[i].buffer_offset;
+         dst->buffer_size = buffers[i].buffer_size;
+      }
+      else {
+         pipe_resource_reference(&dst->buffer, NULL);
+         dst->buffer_offset = 0;
+         dst->buffer_size = 0;
+      }
+   }
+
+   if (shader == PIPE_SHADER_FRAGMENT)
+      llvmpipe->dirty |= LP_NEW_FS_SSBOS;
+}
+
+
+static void
+llvmpipe_set_shader_images(struct pipe_context *pipe,
+                           enum pipe_shader_type shader,
+                           unsigned start_slot, unsigned count,
+                           const struct pipe_image_view *images)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   /* Only compute shaders can access images so far. */
+   if (shader != PIPE_SHADER_COMPUTE)
+      return;
+
+   assert(start_slot + count <= ARRAY_SIZE(llvmpipe->cs_images));
+
+   for (i = 0; i < count; i++) {
+      struct pipe_image_view *dst = &llvmpipe->cs_images[start_slot + i];
+
+      if (images && images[i].resource) {
+         pipe_resource_reference(&dst->resource, images[i].resource);
+         dst->format = images[i].format;
+         dst->access = images[i].access;
+         dst->shader_access = images[i].shader_access;
+         dst->u = images[i].u;
+      }
+      else {
+         pipe_resource_reference(&dst->resource, NULL);
+         memset(dst, 0, sizeof *dst);
+      }
+   }
+}
+
+
+/**
+ * Point the jit context at the bound constant buffers, shader buffers,
+ * textures and images.  Dispatches are synchronous, so they need no
+ * copying.
+ */
+static void
+update_cs_jit_context(struct llvmpipe_context *llvmpipe,
+                      struct lp_jit_context *jit_context)
+{
+   unsigned i;
+
+   memset(jit_context, 0, sizeof *jit_context);
+
+   for (i = 0; i < LP_MAX_TGSI_CONST_BUFFERS; i++) {
+      const struct pipe_constant_buffer *cb =
+         &llvmpipe->constants[PIPE_SHADER_COMPUTE][i];
+      const ubyte *data = NULL;
+
+      if (cb->buffer)
+         data = (const ubyte *) llvmpipe_resource_data(cb->buffer);
+      else if (cb->user_buffer)
+         data = (const ubyte *) cb->user_buffer;
+
+      if (data) {
+         jit_context->constants[i] = (const float *) (data + cb->buffer_offset);
+         jit_context->num_constants[i] =
+            cb->buffer_size / (sizeof(float) * 4);
+      }
+      else {
+         jit_context->constants[i] = fake_const_buf;
+         jit_context->num_constants[i] = 0;
+      }
+   }
+
+   for (i = 0; i < LP_MAX_TGSI_SHADER_BUFFERS; i++) {
+      const struct pipe_shader_buffer *sb = &llvmpipe->ssbos[PIPE_SHADER_COMPUTE][i];
+
+      if (sb->buffer) {
+         const ubyte *data = llvmpipe_resource_data(sb->buffer);
+         jit_context->ssbos[i] = (const uint32_t *) (data + sb->buffer_offset);
+         jit_context->num_ssbos[i] = sb->buffer_size;
+      }
+   }
+
+   for (i = 0; i < llvmpipe->num_sampler_views[PIPE_SHADER_COMPUTE]; i++) {
+      const struct pipe_sampler_view *view =
+         llvmpipe->sampler_views[PIPE_SHADER_COMPUTE][i];
+
+      if (view)
+         lp_jit_texture_from_view(&jit_context->textures[i], view);
+   }
+
+   for (i = 0; i < PIPE_MAX_SHADER_IMAGES; i++) {
+      const struct pipe_image_view *view = &llvmpipe->cs_images[i];
+
+      if (view->resource)
+         lp_jit_image_from_view(&jit_context->images[i], view);
+   }
+
+   for (i = 0; i < llvmpipe->num_samplers[PIPE_SHADER_COMPUTE]; i++) {
+      const struct pipe_sampler_state *sampler =
+         llvmpipe->samplers[PIPE_SHADER_COMPUTE][i];
+
+      if (sampler) {
+         struct lp_jit_sampler *jit_sam = &jit_context->samplers[i];
+
+         jit_sam->min_lod = sampler->min_lod;
+         jit_sam->max_lod = sampler->max_lod;
+         jit_sam->lod_bias = sampler->lod_bias;
+         COPY_4V(jit_sam->border_color, sampler->border_color.f);
+      }
+   }
+}
+
+
+/**
+ * The variant key of the bound samplers, sampler views and images, built
+ * like the fragment shader one.
+ */
+static void
+make_variant_key(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 struct lp_compute_shader_variant_key *key)
+{
+   const struct tgsi_shader_info *info = &shader->info.base;
+   unsigned i;
+
+   memset(key, 0, shader->variant_key_size);
+
+   key->nr_samplers = info->file_max[TGSI_FILE_SAMPLER] + 1;
+   for (i = 0; i < key->nr_samplers; ++i) {
+      if (info->file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
+         lp_sampler_static_sampler_state(&key->state[i].sampler_state,
+                                         lp->samplers[PIPE_SHADER_COMPUTE][i]);
+      }
+   }
+
+   if (info->file_max[TGSI_FILE_SAMPLER_VIEW] != -1) {
+      key->nr_sampler_views = info->file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+      for (i = 0; i < key->nr_sampler_views; ++i) {
+         if (info->file_mask[TGSI_FILE_SAMPLER_VIEW] & (1u << (i & 31))) {
+            lp_sampler_static_texture_state(&key->state[i].texture_state,
+                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+         }
+      }
+   }
+   else {
+      key->nr_sampler_views = key->nr_samplers;
+      for (i = 0; i < key->nr_sampler_views; ++i) {
+         if (info->file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
+            lp_sampler_static_texture_state(&key->state[i].texture_state,
+                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+         }
+      }
+   }
+
+   key->nr_images = info->file_max[TGSI_FILE_IMAGE] + 1;
+   for (i = 0; i < key->nr_images; ++i) {
+      lp_sampler_static_texture_state_image(&key->image_state[i],
+                                            &lp->cs_images[i]);
+   }
+}
+
+
+/**
+ * Find the variant of the bound compute shader for the current state,
+ * generating it if there is none yet.
+ */
+static struct lp_compute_shader_variant *
+llvmpipe_update_cs(struct llvmpipe_context *lp)
+{
+   struct lp_compute_shader *shader = lp->cs;
+   struct lp_compute_shader_variant_key key;
+   struct lp_compute_shader_variant *variant;
+   struct lp_cs_variant_list_item *li;
+
+   make_variant_key(lp, shader, &key);
+
+   foreach(li, &shader->variants) {
+      if (memcmp(&li->base->key, &key, shader->variant_key_size) == 0) {
+         move_to_head(&shader->variants, li);
+         return li->base;
+      }
+   }
+
+   /* Dispatches are synchronous, so the least recently used variant can
+    * go right away.
+    */
+   if (shader->variants_cached >= LP_MAX_SHADER_VARIANTS)
+      remove_variant(shader, last_elem(&shader->variants)->base);
+
+   variant = generate_variant(lp, shader, &key);
+   if (variant) {
+      insert_at_head(&shader->variants, &variant->list_item);
+      shader->variants_cached++;
+   }
+
+   return variant;
+}
+
+
+static boolean
+fill_grid_size(struct pipe_context *pipe,
+               const struct pipe_grid_info *info,
+               uint32_t grid_size[3])
+{
+   struct pipe_transfer *transfer;
+   uint32_t *params;
+
+   if (!info->indirect) {
+      grid_size[0] = info->grid[0];
+      grid_size[1] = info->grid[1];
+      grid_size[2] = info->grid[2];
+      return TRUE;
+   }
+
+   params = pipe_buffer_map_range(pipe, info->indirect,
+                                  info->indirect_offset,
+                                  3 * sizeof(uint32_t),
+                                  PIPE_TRANSFER_READ,
+                                  &transfer);
+   if (!transfer)
+      return FALSE;
+
+   grid_size[0] = params[0];
+   grid_size[1] = params[1];
+   grid_size[2] = params[2];
+   pipe_buffer_unmap(pipe, transfer);
+   return TRUE;
+}
+
+
+static void
+llvmpipe_launch_grid(struct pipe_context *pipe,
+                     const struct pipe_grid_info *info)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct lp_compute_shader *shader = llvmpipe->cs;
+   struct lp_compute_shader_variant *variant;
+   struct lp_jit_context jit_context;
+   struct lp_rast_cs_job job;
+   uint32_t grid_size[3] = { 0 };
+   unsigned i;
+
+   if (!shader)
+      return;
+
+   if (!llvmpipe_check_render_cond(llvmpipe))
+      return;
+
+   if (!fill_grid_size(pipe, info, grid_size)) {
+      pipe_debug_message(&llvmpipe->debug, ERROR,
+                         "llvmpipe: failed to map the indirect dispatch "
+                         "buffer, dispatch skipped");
+      return;
+   }
+
+   if (!grid_size[0] || !grid_size[1] || !grid_size[2] ||
+       !info->block[0] || !info->block[1] || !info->block[2])
+      return;
+
+   variant = llvmpipe_update_cs(llvmpipe);
+   if (!variant)
+      return;
+
+   /* Queue the pending rendering first: the job goes through the same
+    * queue, so it runs after the scenes that may write its inputs.
+    */
+   llvmpipe_flush(pipe, NULL, __FUNCTION__);
+
+   update_cs_jit_context(llvmpipe, &jit_context);
+
+   memset(&job, 0, sizeof job);
+   job.jit_func = variant->jit_function;
+   job.jit_context = &jit_context;
+   for (i = 0; i < 3; i++) {
+      job.grid_size[i] = grid_size[i];
+      job.block_size[i] = info->block[i];
+   }
+   job.shared_size = shader->req_local_mem;
+   job.num_blocks = (uint64_t) grid_size[0] * grid_size[1] * grid_size[2];
+   job.fence = lp_fence_create(1);
+   if (!job.fence)
+      return;
+   job.fence->issued = TRUE;
+
+   mtx_lock(&screen->rast_mutex);
+   lp_rast_queue_cs_job(screen->rast, &job);
+   mtx_unlock(&screen->rast_mutex);
+
+   lp_fence_wait(job.fence);
+   lp_fence_reference(&job.fence, NULL);
+
+   /* Workgroups are only left over when no thread could allocate the
+    * shared memory.
+    */
+   if (job.next_block < job.num_blocks) {
+      pipe_debug_message(&llvmpipe->debug, OUT_OF_MEMORY,
+                         "llvmpipe: out of memory for %u bytes of compute "
+                         "shared memory, %"PRIu64" of %"PRIu64" workgroups "
+                         "not run", job.shared_size,
+                         job.num_blocks - job.next_block, job.num_blocks);
+   }
+
+   if (llvmpipe->active_statistics_queries) {
+      llvmpipe->pipeline_statistics.cs_invocations +=
+         (uint64_t) job.num_blocks *
+         info->block[0] * info->block[1] * info->block[2];
+   }
+}
+
+
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe)
+{
+   llvmpipe->pipe.create_compute_state = llvmpipe_create_compute_state;
+   llvmpipe->pipe.bind_compute_state = llvmpipe_bind_compute_state;
+   llvmpipe->pipe.delete_compute_state = llvmpipe_delete_compute_state;
+   llvmpipe->pipe.set_shader_buffers = llvmpipe_set_shader_buffers;
+   llvmpipe->pipe.set_shader_images = llvmpipe_set_shader_images;
+   llvmpipe->pipe.launch_grid = llvmpipe_launch_grid;
+}
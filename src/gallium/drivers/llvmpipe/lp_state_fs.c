@@ -68,6 +68,8 @@
 #include "util/simple_list.h"
 #include "util/u_dual_blend.h"
 #include "util/os_time.h"
+#include "util/u_atomic.h"
+#include "util/mesa-sha1.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "tgsi/tgsi_dump.h"
@@ -80,6 +82,7 @@
 #include "gallivm/lp_bld_intr.h"
 #include "gallivm/lp_bld_logic.h"
 #include "gallivm/lp_bld_tgsi.h"
+#include "gallivm/lp_bld_nir.h"
 #include "gallivm/lp_bld_swizzle.h"
 #include "gallivm/lp_bld_flow.h"
 #include "gallivm/lp_bld_debug.h"
@@ -88,6 +91,7 @@
 #include "gallivm/lp_bld_pack.h"
 #include "gallivm/lp_bld_format.h"
 #include "gallivm/lp_bld_quad.h"
+#include "nir/nir_to_tgsi_info.h"
 
 #include "lp_bld_alpha.h"
 #include "lp_bld_blend.h"
@@ -96,6 +100,7 @@
 #include "lp_context.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
+#include "lp_screen.h"
 #include "lp_setup.h"
 #include "lp_state.h"
 #include "lp_tex_sample.h"
@@ -308,7 +313,6 @@ generate_fs_loop(struct gallivm_state *gallivm,
                  LLVMValueRef thread_data_ptr)
 {
    const struct util_format_description *zs_format_desc = NULL;
-   const struct tgsi_token *tokens = shader->base.tokens;
    struct lp_type int_type = lp_int_type(type);
    LLVMTypeRef vec_type, int_vec_type;
    LLVMValueRef mask_ptr, mask_val;
@@ -320,6 +324,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
    LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
    struct lp_build_for_loop_state loop_state;
    struct lp_build_mask_context mask;
+   struct lp_build_tgsi_cs_iface cs_iface;
    /*
     * TODO: figure out if simple_shader optimization is really worthwile to
     * keep. Disabled because it may hide some real bugs in the (depth/stencil)
@@ -345,7 +350,11 @@ generate_fs_loop(struct gallivm_state *gallivm,
       zs_format_desc = util_format_description(key->zsbuf_format);
       assert(zs_format_desc);
 
-      if (!shader->info.base.writes_z && !shader->info.base.writes_stencil) {
+      /* The memory writes of the fragments failing the depth/stencil test
+       * still happen, so only test after the shader for those shaders.
+       */
+      if (!shader->info.base.writes_z && !shader->info.base.writes_stencil &&
+          !shader->info.base.writes_memory) {
          if (key->alpha.enabled ||
              key->blend.alpha_to_coverage ||
              shader->info.base.uses_kill ||
@@ -392,6 +401,11 @@ generate_fs_loop(struct gallivm_state *gallivm,
    consts_ptr = lp_jit_context_constants(gallivm, context_ptr);
    num_consts_ptr = lp_jit_context_num_constants(gallivm, context_ptr);
 
+   /* Only the shader storage buffers of the interface are available */
+   memset(&cs_iface, 0, sizeof cs_iface);
+   cs_iface.ssbo_ptr = lp_jit_context_ssbos(gallivm, context_ptr);
+   cs_iface.ssbo_sizes_ptr = lp_jit_context_num_ssbos(gallivm, context_ptr);
+
    lp_build_for_loop_begin(&loop_state, gallivm,
                            lp_build_const_int32(gallivm, 0),
                            LLVMIntULT,
@@ -475,11 +489,18 @@ generate_fs_loop(struct gallivm_state *gallivm,
    lp_build_interp_soa_update_inputs_dyn(interp, gallivm, loop_state.counter);
 
    /* Build the actual shader */
-   lp_build_tgsi_soa(gallivm, tokens, type, &mask,
-                     consts_ptr, num_consts_ptr, &system_values,
-                     interp->inputs,
-                     outputs, context_ptr, thread_data_ptr,
-                     sampler, &shader->info.base, NULL);
+   if (shader->base.type == PIPE_SHADER_IR_NIR)
+      lp_build_nir_soa(gallivm, shader->base.ir.nir, type, &mask,
+                       consts_ptr, num_consts_ptr, &system_values,
+                       interp->inputs,
+                       outputs, context_ptr, thread_data_ptr,
+                       sampler, &shader->info.base, NULL, &cs_iface);
+   else
+      lp_build_tgsi_soa(gallivm, shader->base.tokens, type, &mask,
+                        consts_ptr, num_consts_ptr, &system_values,
+                        interp->inputs,
+                        outputs, context_ptr, thread_data_ptr,
+                        sampler, &shader->info.base, NULL, &cs_iface);
 
    /* Alpha test */
    if (key->alpha.enabled) {
@@ -1819,7 +1840,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
    undef_src_val = lp_build_undef(gallivm, fs_type);
 
    row_type.length = fs_type.length;
-   vector_width    = dst_type.floating ? lp_native_vector_width : lp_integer_vector_width;
+   vector_width    = dst_type.floating ? fs_type.width * fs_type.length : lp_integer_vector_width;
 
    /* Compute correct swizzle and count channels */
    memset(swizzle, LP_BLD_SWIZZLE_DONTCARE, TGSI_NUM_CHANNELS);
@@ -2390,6 +2411,36 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Pointer to the i-th output vector of the shader loop, as the blend code
+ * sees it: vectors wider than out_type are handed out in parts.
+ *
+ * \param store  array of shader loop output vectors
+ */
+static LLVMValueRef
+fs_out_ptr(struct gallivm_state *gallivm,
+           LLVMValueRef store,
+           struct lp_type out_type,
+           unsigned i)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef vec_type = LLVMGetElementType(LLVMTypeOf(store));
+   unsigned parts = LLVMGetVectorSize(vec_type) / out_type.length;
+   LLVMValueRef index = lp_build_const_int32(gallivm, i / parts);
+   LLVMValueRef ptr = LLVMBuildGEP(builder, store, &index, 1, "");
+
+   if (parts > 1) {
+      LLVMTypeRef part_type = LLVMVectorType(LLVMGetElementType(vec_type),
+                                             out_type.length);
+      index = lp_build_const_int32(gallivm, i % parts);
+      ptr = LLVMBuildBitCast(builder, ptr, LLVMPointerType(part_type, 0), "");
+      ptr = LLVMBuildGEP(builder, ptr, &index, 1, "");
+   }
+
+   return ptr;
+}
+
+
 /**
  * Generate the runtime callable function for the whole fragment pipeline.
  * Note that the function which we generate operates on a block of 16
@@ -2407,6 +2458,7 @@ generate_fragment(struct llvmpipe_context *lp,
    struct lp_shader_input inputs[PIPE_MAX_SHADER_INPUTS];
    char func_name[64];
    struct lp_type fs_type;
+   struct lp_type fs_out_type;
    struct lp_type blend_type;
    LLVMTypeRef fs_elem_type;
    LLVMTypeRef blend_vec_type;
@@ -2435,6 +2487,7 @@ generate_fragment(struct llvmpipe_context *lp,
    LLVMValueRef function;
    LLVMValueRef facing;
    unsigned num_fs;
+   unsigned num_fs_out;
    unsigned i;
    unsigned chan;
    unsigned cbuf;
@@ -2470,6 +2523,13 @@ generate_fragment(struct llvmpipe_context *lp,
    fs_type.width = 32;           /* 32-bit float */
    fs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
 
+   /* The blend code handles at most 8 pixels per vector, so the outputs of
+    * a 16-wide shader are blended in two halves of two quads each, which is
+    * the same order an 8-wide shader produces them in.
+    */
+   fs_out_type = fs_type;
+   fs_out_type.length = MIN2(fs_type.length, 8);
+
    memset(&blend_type, 0, sizeof blend_type);
    blend_type.floating = FALSE; /* values are integers */
    blend_type.sign = FALSE;     /* values are unsigned */
@@ -2486,8 +2546,11 @@ generate_fragment(struct llvmpipe_context *lp,
 
    blend_vec_type = lp_build_vec_type(gallivm, blend_type);
 
-   util_snprintf(func_name, sizeof(func_name), "fs%u_variant%u_%s",
-                 shader->no, variant->no, partial_mask ? "partial" : "whole");
+   /* The name must not depend on the shader/variant numbering, as it is
+    * used to look the function up in objects loaded from the disk cache.
+    */
+   util_snprintf(func_name, sizeof(func_name), "fs_variant_%s",
+                 partial_mask ? "partial" : "whole");
 
    arg_types[0] = variant->jit_context_ptr_type;       /* context */
    arg_types[1] = int32_type;                          /* x */
@@ -2577,9 +2640,12 @@ generate_fragment(struct llvmpipe_context *lp,
    sampler = lp_llvm_sampler_soa_create(key->state);
 
    num_fs = 16 / fs_type.length; /* number of loops per 4x4 stamp */
+   num_fs_out = 16 / fs_out_type.length;
    /* for 1d resources only run "upper half" of stamp */
-   if (key->resource_1d)
-      num_fs /= 2;
+   if (key->resource_1d) {
+      num_fs = MAX2(num_fs / 2, 1);
+      num_fs_out /= 2;
+   }
 
    {
       LLVMValueRef num_loop = lp_build_const_int32(gallivm, num_fs);
@@ -2636,26 +2702,22 @@ generate_fragment(struct llvmpipe_context *lp,
                        facing,
                        thread_data_ptr);
 
-      for (i = 0; i < num_fs; i++) {
-         LLVMValueRef indexi = lp_build_const_int32(gallivm, i);
-         LLVMValueRef ptr = LLVMBuildGEP(builder, mask_store,
-                                         &indexi, 1, "");
+      for (i = 0; i < num_fs_out; i++) {
+         LLVMValueRef ptr = fs_out_ptr(gallivm, mask_store, fs_out_type, i);
          fs_mask[i] = LLVMBuildLoad(builder, ptr, "mask");
          /* This is fucked up need to reorganize things */
          for (cbuf = 0; cbuf < key->nr_cbufs; cbuf++) {
             for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
-               ptr = LLVMBuildGEP(builder,
-                                  color_store[cbuf * !cbuf0_write_all][chan],
-                                  &indexi, 1, "");
+               ptr = fs_out_ptr(gallivm,
+                                color_store[cbuf * !cbuf0_write_all][chan],
+                                fs_out_type, i);
                fs_out_color[cbuf][chan][i] = ptr;
             }
          }
          if (dual_source_blend) {
             /* only support one dual source blend target hence always use output 1 */
             for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
-               ptr = LLVMBuildGEP(builder,
-                                  color_store[1][chan],
-                                  &indexi, 1, "");
+               ptr = fs_out_ptr(gallivm, color_store[1][chan], fs_out_type, i);
                fs_out_color[1][chan][i] = ptr;
             }
          }
@@ -2690,7 +2752,7 @@ generate_fragment(struct llvmpipe_context *lp,
 
          generate_unswizzled_blend(gallivm, cbuf, variant,
                                    key->cbuf_format[cbuf],
-                                   num_fs, fs_type, fs_mask, fs_out_color,
+                                   num_fs_out, fs_out_type, fs_mask, fs_out_color,
                                    context_ptr, color_ptr, stride,
                                    partial_mask, do_branch);
       }
@@ -2800,44 +2862,114 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 {
    debug_printf("llvmpipe: Fragment shader #%u variant #%u:\n", 
                 variant->shader->no, variant->no);
-   tgsi_dump(variant->shader->base.tokens, 0);
+   if (variant->shader->base.type == PIPE_SHADER_IR_NIR)
+      nir_print_shader(variant->shader->base.ir.nir, stderr);
+   else
+      tgsi_dump(variant->shader->base.tokens, 0);
    dump_fs_variant_key(&variant->key);
    debug_printf("variant->opaque = %u\n", variant->opaque);
    debug_printf("\n");
 }
 
 
+/**
+ * Compute the disk cache key of a fragment shader variant, from the
+ * shader IR and the variant key.
+ */
+static void
+llvmpipe_fs_get_ir_cache_key(struct lp_fragment_shader *shader,
+                             const struct lp_fragment_shader_variant_key *key,
+                             unsigned char ir_sha1_cache_key[20])
+{
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, key, shader->variant_key_size);
+   if (shader->base.type == PIPE_SHADER_IR_NIR) {
+      unsigned char nir_sha1[20];
+      lp_build_nir_sha1(shader->base.ir.nir, nir_sha1);
+      _mesa_sha1_update(&ctx, nir_sha1, sizeof(nir_sha1));
+   }
+   else {
+      _mesa_sha1_update(&ctx, shader->base.tokens,
+                        tgsi_num_tokens(shader->base.tokens) *
+                        sizeof(struct tgsi_token));
+   }
+   _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+}
+
+
+/**
+ * Whether a stencil face leaves the stencil buffer untouched for the
+ * fragments which fail the stencil or depth test.
+ */
+static boolean
+stencil_keeps_on_depth_fail(const struct pipe_stencil_state *stencil)
+{
+   return !stencil->enabled ||
+          !stencil->writemask ||
+          (stencil->fail_op == PIPE_STENCIL_OP_KEEP &&
+           stencil->zfail_op == PIPE_STENCIL_OP_KEEP);
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
+ *
+ * This may run on a compiler thread, with its own LLVM context, so it
+ * must not touch any mutable context or shader state.
+ *
+ * Code from the fast tier is never put in the disk cache, so that a
+ * later run finds the fully optimized code instead.
  */
 static struct lp_fragment_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
                  struct lp_fragment_shader *shader,
-                 const struct lp_fragment_shader_variant_key *key)
+                 const struct lp_fragment_shader_variant_key *key,
+                 unsigned no,
+                 LLVMContextRef context,
+                 enum gallivm_tier tier)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc = NULL;
    boolean fullcolormask;
    char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   boolean needs_caching = FALSE;
+   const int64_t t0 = os_time_get_nano();
 
    variant = CALLOC_STRUCT(lp_fragment_shader_variant);
    if (!variant)
       return NULL;
 
    util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
-                 shader->no, shader->variants_created);
+                 shader->no, no);
+
+   llvmpipe_fs_get_ir_cache_key(shader, key, ir_sha1_cache_key);
 
-   variant->gallivm = gallivm_create(module_name, lp->context);
+   lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+   if (!cached.data_size)
+      needs_caching = tier == GALLIVM_TIER_FULL;
+   else
+      tier = GALLIVM_TIER_FULL;
+
+   variant->gallivm = gallivm_create(module_name, context, &cached);
    if (!variant->gallivm) {
+      free(cached.data);
       FREE(variant);
       return NULL;
    }
 
+   variant->gallivm->tier = tier;
+
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
-   variant->no = shader->variants_created++;
+   variant->no = no;
+   variant->tier = tier;
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
@@ -2862,6 +2994,19 @@ generate_variant(struct llvmpipe_context *lp,
          !shader->info.base.writes_samplemask
       ? TRUE : FALSE;
 
+   variant->writes_z = shader->info.base.writes_z;
+
+   variant->hiz_test =
+         key->depth.enabled &&
+         (key->depth.func == PIPE_FUNC_LESS ||
+          key->depth.func == PIPE_FUNC_LEQUAL ||
+          key->depth.func == PIPE_FUNC_GREATER ||
+          key->depth.func == PIPE_FUNC_GEQUAL) &&
+         !variant->writes_z &&
+         stencil_keeps_on_depth_fail(&key->stencil[0]) &&
+         stencil_keeps_on_depth_fail(&key->stencil[1])
+      ? TRUE : FALSE;
+
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       lp_debug_fs_variant(variant);
    }
@@ -2900,12 +3045,56 @@ generate_variant(struct llvmpipe_context *lp,
       variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
    }
 
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+
    gallivm_free_ir(variant->gallivm);
 
+   llvmpipe_screen_count_compile(screen, os_time_get_nano() - t0);
+
    return variant;
 }
 
 
+static void
+variant_job_execute(void *data, int thread_index)
+{
+   struct lp_fs_variant_job *job = (struct lp_fs_variant_job *) data;
+
+   job->variant = generate_variant(job->lp, job->shader, &job->key,
+                                   job->no, job->context, job->tier);
+
+   /* Switch a fast tier variant over to the optimized code.  The old code
+    * stays alive until the variant is removed, as scenes being rasterized
+    * may still call it.
+    */
+   if (job->target && job->variant) {
+      struct lp_fragment_shader_variant *target = job->target;
+      unsigned i;
+
+      for (i = 0; i < ARRAY_SIZE(target->jit_function); i++)
+         p_atomic_set(&target->jit_function[i],
+                      job->variant->jit_function[i]);
+   }
+}
+
+
+/**
+ * Free a finished background compilation job, and its result.
+ */
+static void
+free_variant_job(struct lp_fs_variant_job *job)
+{
+   if (job->variant) {
+      gallivm_destroy(job->variant->gallivm);
+      FREE(job->variant);
+   }
+   LLVMContextDispose(job->context);
+   util_queue_fence_destroy(&job->fence);
+   FREE(job);
+}
+
+
 static void *
 llvmpipe_create_fs_state(struct pipe_context *pipe,
                          const struct pipe_shader_state *templ)
@@ -2923,15 +3112,28 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    shader->no = fs_no++;
    make_empty_list(&shader->variants);
 
-   /* get/save the summary info for this shader */
-   lp_build_tgsi_info(templ->tokens, &shader->info);
+   shader->base.type = templ->type;
+   if (templ->type == PIPE_SHADER_IR_NIR) {
+      /* the NIR is owned by the shader from now on */
+      shader->base.ir.nir = templ->ir.nir;
+      lp_build_opt_nir(shader->base.ir.nir);
+      nir_tgsi_scan_shader(shader->base.ir.nir, &shader->info.base, false);
+   }
+   else {
+      /* get/save the summary info for this shader */
+      lp_build_tgsi_info(templ->tokens, &shader->info);
 
-   /* we need to keep a local copy of the tokens */
-   shader->base.tokens = tgsi_dup_tokens(templ->tokens);
+      /* we need to keep a local copy of the tokens */
+      shader->base.tokens = tgsi_dup_tokens(templ->tokens);
+   }
 
-   shader->draw_data = draw_create_fragment_shader(llvmpipe->draw, templ);
+   shader->draw_data = draw_create_fragment_shader(llvmpipe->draw,
+                                                   &shader->base);
    if (shader->draw_data == NULL) {
-      FREE((void *) shader->base.tokens);
+      if (shader->base.type == PIPE_SHADER_IR_NIR)
+         ralloc_free(shader->base.ir.nir);
+      else
+         FREE((void *) shader->base.tokens);
       FREE(shader);
       return NULL;
    }
@@ -2984,7 +3186,10 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
       unsigned attrib;
       debug_printf("llvmpipe: Create fragment shader #%u %p:\n",
                    shader->no, (void *) shader);
-      tgsi_dump(templ->tokens, 0);
+      if (shader->base.type == PIPE_SHADER_IR_NIR)
+         nir_print_shader(shader->base.ir.nir, stderr);
+      else
+         tgsi_dump(shader->base.tokens, 0);
       debug_printf("usage masks:\n");
       for (attrib = 0; attrib < shader->info.base.num_inputs; ++attrib) {
          unsigned usage_mask = shader->info.base.input_usage_mask[attrib];
@@ -3036,7 +3241,21 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants, variant->nr_instrs, lp->nr_fs_instrs);
    }
 
+   if (variant->tier_up_job) {
+      struct lp_fs_variant_job *job = variant->tier_up_job;
+
+      if (lp->fs_compile_async)
+         util_queue_drop_job(&lp->fs_compile_queue, &job->fence);
+      util_queue_fence_wait(&job->fence);
+      free_variant_job(job);
+   }
+
+   if (lp->fs_tier_up_variant == variant)
+      lp->fs_tier_up_variant = NULL;
+
    gallivm_destroy(variant->gallivm);
+   if (variant->context)
+      LLVMContextDispose(variant->context);
 
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
@@ -3067,6 +3286,16 @@ llvmpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
     */
    llvmpipe_finish(pipe, __FUNCTION__);
 
+   /* Drop or wait for the variants being compiled */
+   while (shader->pending_jobs) {
+      struct lp_fs_variant_job *job = shader->pending_jobs;
+      shader->pending_jobs = job->next;
+
+      util_queue_drop_job(&llvmpipe->fs_compile_queue, &job->fence);
+      util_queue_fence_wait(&job->fence);
+      free_variant_job(job);
+   }
+
    /* Delete all the variants */
    li = first_elem(&shader->variants);
    while(!at_end(&shader->variants, li)) {
@@ -3079,7 +3308,10 @@ llvmpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
    draw_delete_fragment_shader(llvmpipe->draw, shader->draw_data);
 
    assert(shader->variants_cached == 0);
-   FREE((void *) shader->base.tokens);
+   if (shader->base.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(shader->base.ir.nir);
+   else
+      FREE((void *) shader->base.tokens);
    FREE(shader);
 }
 
@@ -3128,7 +3360,7 @@ llvmpipe_set_constant_buffer(struct pipe_context *pipe,
       draw_set_mapped_constant_buffer(llvmpipe->draw, shader,
                                       index, data, size);
    }
-   else {
+   else if (shader == PIPE_SHADER_FRAGMENT) {
       llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
    }
 
@@ -3360,110 +3592,406 @@ make_variant_key(struct llvmpipe_context *lp,
 
 
 /**
- * Update fragment shader state.  This is called just prior to drawing
- * something when some fragment-related state has changed.
+ * Make the key of a variant which can stand in for the one of the given
+ * key.  It has the texture and sampler specializations which merely
+ * allow faster code turned off, so it is valid for more state.
  */
-void 
-llvmpipe_update_fs(struct llvmpipe_context *lp)
+static void
+make_generic_variant_key(const struct lp_fragment_shader *shader,
+                         const struct lp_fragment_shader_variant_key *key,
+                         struct lp_fragment_shader_variant_key *generic_key)
 {
-   struct lp_fragment_shader *shader = lp->fs;
-   struct lp_fragment_shader_variant_key key;
-   struct lp_fragment_shader_variant *variant = NULL;
-   struct lp_fs_variant_list_item *li;
+   unsigned i;
 
-   make_variant_key(lp, shader, &key);
+   memcpy(generic_key, key, shader->variant_key_size);
+
+   for (i = 0; i < MAX2(key->nr_samplers, key->nr_sampler_views); ++i) {
+      struct lp_static_texture_state *texture =
+         &generic_key->state[i].texture_state;
+      struct lp_static_sampler_state *sampler =
+         &generic_key->state[i].sampler_state;
+
+      texture->pot_width = 0;
+      texture->pot_height = 0;
+      texture->pot_depth = 0;
+      texture->level_zero_only = 0;
+
+      /* Applying the lod bias and clamps is always correct. */
+      if (!sampler->min_max_lod_equal) {
+         sampler->lod_bias_non_zero = 1;
+         sampler->apply_min_lod = 1;
+         sampler->apply_max_lod = 1;
+      }
+   }
+}
+
+
+static struct lp_fragment_shader_variant *
+find_variant(struct lp_fragment_shader *shader,
+             const struct lp_fragment_shader_variant_key *key)
+{
+   struct lp_fs_variant_list_item *li;
 
-   /* Search the variants for one which matches the key */
    li = first_elem(&shader->variants);
    while(!at_end(&shader->variants, li)) {
-      if(memcmp(&li->base->key, &key, shader->variant_key_size) == 0) {
-         variant = li->base;
-         break;
+      if(memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
+         return li->base;
       }
       li = next_elem(li);
    }
 
-   if (variant) {
-      /* Move this variant to the head of the list to implement LRU
-       * deletion of shader's when we have too many.
-       */
-      move_to_head(&lp->fs_variants_list, &variant->list_item_global);
+   return NULL;
+}
+
+
+static struct lp_fs_variant_job *
+find_variant_job(struct lp_fragment_shader *shader,
+                 const struct lp_fragment_shader_variant_key *key)
+{
+   struct lp_fs_variant_job *job;
+
+   for (job = shader->pending_jobs; job; job = job->next) {
+      if (memcmp(&job->key, key, shader->variant_key_size) == 0)
+         return job;
    }
-   else {
-      /* variant not found, create it now */
-      int64_t t0, t1, dt;
-      unsigned i;
-      unsigned variants_to_cull;
 
-      if (LP_DEBUG & DEBUG_FS) {
-         debug_printf("%u variants,\t%u instrs,\t%u instrs/variant\n",
-                      lp->nr_fs_variants,
-                      lp->nr_fs_instrs,
-                      lp->nr_fs_variants ? lp->nr_fs_instrs / lp->nr_fs_variants : 0);
+   return NULL;
+}
+
+
+/**
+ * Free the least recently used variants if we have too many, to make
+ * room for a new one.
+ */
+static void
+cull_variants(struct llvmpipe_context *lp,
+              struct lp_fragment_shader *shader)
+{
+   unsigned i;
+   unsigned variants_to_cull;
+
+   if (LP_DEBUG & DEBUG_FS) {
+      debug_printf("%u variants,\t%u instrs,\t%u instrs/variant\n",
+                   lp->nr_fs_variants,
+                   lp->nr_fs_instrs,
+                   lp->nr_fs_variants ? lp->nr_fs_instrs / lp->nr_fs_variants : 0);
+   }
+
+   /* First, check if we've exceeded the max number of shader variants.
+    * If so, free 6.25% of them (the least recently used ones).
+    */
+   variants_to_cull = lp->nr_fs_variants >= LP_MAX_SHADER_VARIANTS ? LP_MAX_SHADER_VARIANTS / 16 : 0;
+
+   if (variants_to_cull ||
+       lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS) {
+      struct pipe_context *pipe = &lp->pipe;
+
+      if (gallivm_debug & GALLIVM_DEBUG_PERF) {
+         debug_printf("Evicting FS: %u fs variants,\t%u total variants,"
+                      "\t%u instrs,\t%u instrs/variant\n",
+                      shader->variants_cached,
+                      lp->nr_fs_variants, lp->nr_fs_instrs,
+                      lp->nr_fs_instrs / lp->nr_fs_variants);
       }
 
-      /* First, check if we've exceeded the max number of shader variants.
-       * If so, free 6.25% of them (the least recently used ones).
+      /*
+       * XXX: we need to flush the context until we have some sort of
+       * reference counting in fragment shaders as they may still be binned
+       * Flushing alone might not be sufficient we need to wait on it too.
+       */
+      llvmpipe_finish(pipe, __FUNCTION__);
+
+      /*
+       * We need to re-check lp->nr_fs_variants because an arbitrarliy large
+       * number of shader variants (potentially all of them) could be
+       * pending for destruction on flush.
        */
-      variants_to_cull = lp->nr_fs_variants >= LP_MAX_SHADER_VARIANTS ? LP_MAX_SHADER_VARIANTS / 16 : 0;
-
-      if (variants_to_cull ||
-          lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS) {
-         struct pipe_context *pipe = &lp->pipe;
-
-         if (gallivm_debug & GALLIVM_DEBUG_PERF) {
-            debug_printf("Evicting FS: %u fs variants,\t%u total variants,"
-                         "\t%u instrs,\t%u instrs/variant\n",
-                         shader->variants_cached,
-                         lp->nr_fs_variants, lp->nr_fs_instrs,
-                         lp->nr_fs_instrs / lp->nr_fs_variants);
+
+      for (i = 0; i < variants_to_cull || lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS; i++) {
+         struct lp_fs_variant_list_item *item;
+         if (is_empty_list(&lp->fs_variants_list)) {
+            break;
          }
+         item = last_elem(&lp->fs_variants_list);
+         assert(item);
+         assert(item->base);
+         llvmpipe_remove_shader_variant(lp, item->base);
+      }
+   }
+}
 
-         /*
-          * XXX: we need to flush the context until we have some sort of
-          * reference counting in fragment shaders as they may still be binned
-          * Flushing alone might not be sufficient we need to wait on it too.
-          */
-         llvmpipe_finish(pipe, __FUNCTION__);
 
-         /*
-          * We need to re-check lp->nr_fs_variants because an arbitrarliy large
-          * number of shader variants (potentially all of them) could be
-          * pending for destruction on flush.
-          */
+/** Put a new variant into the lists */
+static void
+add_variant(struct llvmpipe_context *lp,
+            struct lp_fragment_shader *shader,
+            struct lp_fragment_shader_variant *variant)
+{
+   insert_at_head(&shader->variants, &variant->list_item_local);
+   insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
+   lp->nr_fs_variants++;
+   lp->nr_fs_instrs += variant->nr_instrs;
+   shader->variants_cached++;
+}
+
+
+/**
+ * Compile a variant on the draw thread, for a draw which can't proceed
+ * without it, when there is no compiler thread.  When hot variants are
+ * reoptimized in the background, this only does the fast tier.
+ */
+static struct lp_fragment_shader_variant *
+create_variant(struct llvmpipe_context *lp,
+               struct lp_fragment_shader *shader,
+               const struct lp_fragment_shader_variant_key *key)
+{
+   struct lp_fragment_shader_variant *variant;
+   int64_t t0, t1, dt;
+
+   cull_variants(lp, shader);
+   lp->nr_fs_draw_compiles++;
+
+   /*
+    * Generate the new variant.
+    */
+   t0 = os_time_get();
+   variant = generate_variant(lp, shader, key, shader->variants_created++,
+                              lp->context,
+                              lp->fs_tier_up_threshold ? GALLIVM_TIER_FAST :
+                                                         GALLIVM_TIER_FULL);
+   t1 = os_time_get();
+   dt = t1 - t0;
+   LP_COUNT_ADD(llvm_compile_time, dt);
+   LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+
+   if (variant)
+      add_variant(lp, shader, variant);
+
+   return variant;
+}
+
+
+/**
+ * Queue the compilation of a variant on the compiler thread.
+ */
+static struct lp_fs_variant_job *
+queue_variant_job(struct llvmpipe_context *lp,
+                  struct lp_fragment_shader *shader,
+                  const struct lp_fragment_shader_variant_key *key,
+                  enum gallivm_tier tier)
+{
+   struct lp_fs_variant_job *job = CALLOC_STRUCT(lp_fs_variant_job);
+   if (!job)
+      return NULL;
+
+   job->lp = lp;
+   job->shader = shader;
+   memcpy(&job->key, key, shader->variant_key_size);
+   job->no = shader->variants_created++;
+   job->tier = tier;
+   job->context = LLVMContextCreate();
+   util_queue_fence_init(&job->fence);
+
+   job->next = shader->pending_jobs;
+   shader->pending_jobs = job;
+
+   util_queue_add_job(&lp->fs_compile_queue, job, &job->fence,
+                      variant_job_execute, NULL);
+
+   return job;
+}
+
+
+/**
+ * Queue the reoptimization of a fast tier variant which became hot.
+ */
+static void
+queue_tier_up_job(struct llvmpipe_context *lp,
+                  struct lp_fragment_shader_variant *variant)
+{
+   struct lp_fs_variant_job *job = CALLOC_STRUCT(lp_fs_variant_job);
+   if (!job)
+      return;
+
+   job->lp = lp;
+   job->shader = variant->shader;
+   memcpy(&job->key, &variant->key, variant->shader->variant_key_size);
+   job->no = variant->no;
+   job->tier = GALLIVM_TIER_FULL;
+   job->context = LLVMContextCreate();
+   job->target = variant;
+   util_queue_fence_init(&job->fence);
+
+   variant->tier_up_job = job;
+
+   util_queue_add_job(&lp->fs_compile_queue, job, &job->fence,
+                      variant_job_execute, NULL);
+}
+
+
+/**
+ * Called before each draw: once the bound fast tier variant has shaded
+ * enough blocks, reoptimize it on the compiler thread.
+ */
+void
+llvmpipe_fs_tier_up(struct llvmpipe_context *lp)
+{
+   struct lp_fragment_shader_variant *variant = lp->fs_tier_up_variant;
 
-         for (i = 0; i < variants_to_cull || lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS; i++) {
-            struct lp_fs_variant_list_item *item;
-            if (is_empty_list(&lp->fs_variants_list)) {
-               break;
+   if (p_atomic_read(&variant->invocations) < lp->fs_tier_up_threshold)
+      return;
+
+   lp->fs_tier_up_variant = NULL;
+   queue_tier_up_job(lp, variant);
+}
+
+
+/**
+ * Take the result of a background compilation job whose fence is
+ * signalled, and put it into the lists.
+ */
+static struct lp_fragment_shader_variant *
+finish_variant_job(struct llvmpipe_context *lp,
+                   struct lp_fragment_shader *shader,
+                   struct lp_fs_variant_job *job)
+{
+   struct lp_fragment_shader_variant *variant = job->variant;
+   struct lp_fs_variant_job **prev = &shader->pending_jobs;
+
+   while (*prev != job)
+      prev = &(*prev)->next;
+   *prev = job->next;
+
+   if (variant) {
+      variant->context = job->context;
+      job->context = NULL;
+      job->variant = NULL;
+
+      cull_variants(lp, shader);
+      add_variant(lp, shader, variant);
+   }
+   else {
+      LLVMContextDispose(job->context);
+   }
+
+   util_queue_fence_destroy(&job->fence);
+   FREE(job);
+
+   return variant;
+}
+
+
+/**
+ * Wait for a background compilation job which the draw can't proceed
+ * without.
+ */
+static struct lp_fragment_shader_variant *
+wait_variant_job(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader *shader,
+                 struct lp_fs_variant_job *job)
+{
+   lp->nr_fs_compile_waits++;
+   util_queue_fence_wait(&job->fence);
+   return finish_variant_job(lp, shader, job);
+}
+
+
+/**
+ * Update fragment shader state.  This is called just prior to drawing
+ * something when some fragment-related state has changed.
+ *
+ * With a compiler thread, the draw thread doesn't compile variants.  A
+ * missing variant is compiled on the compiler thread while a generic
+ * variant stands in for it, and the draw only waits when no variant which
+ * can be used exists yet.
+ */
+void 
+llvmpipe_update_fs(struct llvmpipe_context *lp)
+{
+   struct lp_fragment_shader *shader = lp->fs;
+   struct lp_fragment_shader_variant_key key;
+   struct lp_fragment_shader_variant *variant;
+   struct lp_fs_variant_job *job = NULL;
+
+   make_variant_key(lp, shader, &key);
+
+   lp->fs_variant_pending = FALSE;
+
+   /* Search the variants for one which matches the key */
+   variant = find_variant(shader, &key);
+
+   if (!variant) {
+      job = find_variant_job(shader, &key);
+      if (job && util_queue_fence_is_signalled(&job->fence)) {
+         variant = finish_variant_job(lp, shader, job);
+         job = NULL;
+      }
+   }
+
+   if (!variant && lp->fs_compile_async) {
+      /* the variants the draw waits for are compiled quickly */
+      const enum gallivm_tier wait_tier =
+         lp->fs_tier_up_threshold ? GALLIVM_TIER_FAST : GALLIVM_TIER_FULL;
+      struct lp_fragment_shader_variant_key generic_key;
+      struct lp_fragment_shader_variant *generic = NULL;
+      struct lp_fs_variant_job *generic_job = NULL;
+
+      make_generic_variant_key(shader, &key, &generic_key);
+
+      if (memcmp(&generic_key, &key, shader->variant_key_size) != 0) {
+         generic = find_variant(shader, &generic_key);
+         if (!generic) {
+            generic_job = find_variant_job(shader, &generic_key);
+            if (generic_job &&
+                util_queue_fence_is_signalled(&generic_job->fence)) {
+               generic = finish_variant_job(lp, shader, generic_job);
+               generic_job = NULL;
+            }
+            else if (!generic_job && !job) {
+               /* Nothing can be used yet.  Compile the generic variant
+                * first, as it will stand in for other specializations
+                * later too.
+                */
+               generic_job = queue_variant_job(lp, shader, &generic_key,
+                                               wait_tier);
             }
-            item = last_elem(&lp->fs_variants_list);
-            assert(item);
-            assert(item->base);
-            llvmpipe_remove_shader_variant(lp, item->base);
          }
       }
 
-      /*
-       * Generate the new variant.
-       */
-      t0 = os_time_get();
-      variant = generate_variant(lp, shader, &key);
-      t1 = os_time_get();
-      dt = t1 - t0;
-      LP_COUNT_ADD(llvm_compile_time, dt);
-      LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
-
-      /* Put the new variant into the list */
-      if (variant) {
-         insert_at_head(&shader->variants, &variant->list_item_local);
-         insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
-         lp->nr_fs_variants++;
-         lp->nr_fs_instrs += variant->nr_instrs;
-         shader->variants_cached++;
+      if (!job) {
+         job = queue_variant_job(lp, shader, &key,
+                                 generic || generic_job ? GALLIVM_TIER_FULL :
+                                                          wait_tier);
+      }
+
+      if (!generic && generic_job)
+         generic = wait_variant_job(lp, shader, generic_job);
+
+      if (generic) {
+         variant = generic;
+         lp->fs_variant_pending = TRUE;
       }
    }
 
+   if (!variant && job)
+      variant = wait_variant_job(lp, shader, job);
+
+   if (!variant) {
+      /* variant not found, create it now */
+      variant = create_variant(lp, shader, &key);
+   }
+   else {
+      /* Move this variant to the head of the list to implement LRU
+       * deletion of shader's when we have too many.
+       */
+      move_to_head(&lp->fs_variants_list, &variant->list_item_global);
+   }
+
+   /* Watch the fast tier variant for reoptimization */
+   lp->fs_tier_up_variant = NULL;
+   if (variant && variant->tier == GALLIVM_TIER_FAST && !variant->tier_up_job)
+      lp->fs_tier_up_variant = variant;
+
    /* Bind this variant */
    lp_setup_set_fs_variant(lp->setup, variant);
 }
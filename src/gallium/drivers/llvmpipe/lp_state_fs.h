@@ -32,7 +32,9 @@
 
 #include "pipe/p_compiler.h"
 #include "pipe/p_state.h"
+#include "util/u_queue.h"
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
+#include "gallivm/lp_bld_init.h" /* for enum gallivm_tier */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
@@ -99,8 +101,18 @@ struct lp_fragment_shader_variant
 
    boolean opaque;
 
+   /** Fragments failing the depth test have no side effects, so blocks
+    * may be rejected against the hierarchical Z bounds */
+   boolean hiz_test;
+
+   /** Depth comes from the shader rather than the interpolated position */
+   boolean writes_z;
+
    struct gallivm_state *gallivm;
 
+   /** Own LLVM context, for variants compiled in the background */
+   LLVMContextRef context;
+
    LLVMTypeRef jit_context_ptr_type;
    LLVMTypeRef jit_thread_data_ptr_type;
    LLVMTypeRef jit_linear_context_ptr_type;
@@ -112,6 +124,15 @@ struct lp_fragment_shader_variant
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
+   /** Optimization tier the functions were compiled with */
+   enum gallivm_tier tier;
+
+   /** Number of 4x4 blocks shaded, updated atomically by the rasterizer */
+   unsigned invocations;
+
+   /** Reoptimization of a fast tier variant, which owns the new code */
+   struct lp_fs_variant_job *tier_up_job;
+
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
 
@@ -120,6 +141,31 @@ struct lp_fragment_shader_variant
 };
 
 
+/**
+ * A fragment shader variant being compiled in the background.
+ * LLVM contexts are not thread-safe, so each job compiles in its own.
+ */
+struct lp_fs_variant_job
+{
+   struct lp_fs_variant_job *next;
+
+   struct llvmpipe_context *lp;
+   struct lp_fragment_shader *shader;
+   struct lp_fragment_shader_variant_key key;
+   unsigned no;
+   enum gallivm_tier tier;
+
+   LLVMContextRef context;
+   struct util_queue_fence fence;
+
+   /** Fast tier variant whose functions are replaced by the result */
+   struct lp_fragment_shader_variant *target;
+
+   /** The result, valid once the fence is signalled */
+   struct lp_fragment_shader_variant *variant;
+};
+
+
 /** Subclass of pipe_shader_state */
 struct lp_fragment_shader
 {
@@ -129,6 +175,9 @@ struct lp_fragment_shader
 
    struct lp_fs_variant_list_item variants;
 
+   /** Variants being compiled in the background */
+   struct lp_fs_variant_job *pending_jobs;
+
    struct draw_fragment_shader *draw_data;
 
    /* For debugging/profiling purposes */
@@ -37,6 +37,7 @@
 #include "tgsi/tgsi_dump.h"
 #include "tgsi/tgsi_scan.h"
 #include "tgsi/tgsi_parse.h"
+#include "compiler/nir/nir.h"
 
 
 static void *
@@ -53,14 +54,17 @@ llvmpipe_create_gs_state(struct pipe_context *pipe,
    /* debug */
    if (LP_DEBUG & DEBUG_TGSI) {
       debug_printf("llvmpipe: Create geometry shader %p:\n", (void *)state);
-      tgsi_dump(templ->tokens, 0);
+      if (templ->type == PIPE_SHADER_IR_NIR)
+         nir_print_shader(templ->ir.nir, stderr);
+      else
+         tgsi_dump(templ->tokens, 0);
    }
 
    /* copy stream output info */
-   state->no_tokens = !templ->tokens;
+   state->no_tokens = templ->type == PIPE_SHADER_IR_TGSI && !templ->tokens;
    memcpy(&state->stream_output, &templ->stream_output, sizeof state->stream_output);
 
-   if (templ->tokens) {
+   if (!state->no_tokens) {
       state->dgs = draw_create_geometry_shader(llvmpipe->draw, templ);
       if (state->dgs == NULL) {
          goto no_dgs;
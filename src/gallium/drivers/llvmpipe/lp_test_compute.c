@@ -0,0 +1,275 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Unit tests for compute shader grids.
+ *
+ * Each invocation writes its index to the workgroup shared memory, waits on
+ * a barrier, and copies the value its neighbour wrote to a shader storage
+ * buffer, which is then checked.  The workgroup sizes include ones which
+ * don't fill the last SIMD vector of the workgroup.
+ */
+
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+#include "tgsi/tgsi_text.h"
+#include "state_tracker/sw_winsys.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_public.h"
+#include "lp_test.h"
+
+
+struct grid_case {
+   unsigned block[3];
+   unsigned grid[3];
+};
+
+
+static const struct grid_case grid_cases[] = {
+   { { 64, 1, 1 }, { 4, 1, 1 } },
+   { { 8, 8, 1 }, { 3, 2, 1 } },
+   { { 4, 4, 4 }, { 2, 2, 2 } },
+   { { 7, 3, 1 }, { 5, 1, 1 } },
+   { { 1, 1, 1 }, { 3, 3, 1 } },
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "block\t"
+           "grid\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              const struct grid_case *test,
+              boolean success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+
+   fprintf(fp, "%ux%ux%u\t%ux%ux%u\n",
+           test->block[0], test->block[1], test->block[2],
+           test->grid[0], test->grid[1], test->grid[2]);
+
+   fflush(fp);
+}
+
+
+/**
+ * The shader of the test, in TGSI text.  The flat index of an invocation in
+ * its workgroup is L = x + bx * (y + by * z), and the one of the workgroup
+ * in the grid is W = X + gx * (Y + gy * Z); invocation W * N + L of the
+ * N-invocation workgroups writes W * N + (L + 1) % N.
+ */
+static void
+make_shader_text(const struct grid_case *test, char *text, size_t size)
+{
+   const unsigned num_threads =
+      test->block[0] * test->block[1] * test->block[2];
+
+   util_snprintf(text, size,
+      "COMP\n"
+      "PROPERTY CS_FIXED_BLOCK_WIDTH %u\n"
+      "PROPERTY CS_FIXED_BLOCK_HEIGHT %u\n"
+      "PROPERTY CS_FIXED_BLOCK_DEPTH %u\n"
+      "DCL SV[0], THREAD_ID\n"
+      "DCL SV[1], BLOCK_ID\n"
+      "DCL BUFFER[0]\n"
+      "DCL MEMORY[0], SHARED\n"
+      "DCL TEMP[0..3]\n"
+      "IMM[0] UINT32 {%u, %u, %u, 4}\n"
+      "IMM[1] UINT32 {%u, %u, 1, 0}\n"
+      "  0: UMAD TEMP[0].x, SV[0].zzzz, IMM[0].yyyy, SV[0].yyyy\n"
+      "  1: UMAD TEMP[0].x, TEMP[0].xxxx, IMM[0].xxxx, SV[0].xxxx\n"
+      "  2: UMAD TEMP[1].x, SV[1].zzzz, IMM[1].yyyy, SV[1].yyyy\n"
+      "  3: UMAD TEMP[1].x, TEMP[1].xxxx, IMM[1].xxxx, SV[1].xxxx\n"
+      "  4: UMUL TEMP[1].x, TEMP[1].xxxx, IMM[0].zzzz\n"
+      "  5: UADD TEMP[2].x, TEMP[1].xxxx, TEMP[0].xxxx\n"
+      "  6: UMUL TEMP[3].x, TEMP[0].xxxx, IMM[0].wwww\n"
+      "  7: STORE MEMORY[0].x, TEMP[3].xxxx, TEMP[2].xxxx\n"
+      "  8: BARRIER\n"
+      "  9: UADD TEMP[3].x, TEMP[0].xxxx, IMM[1].zzzz\n"
+      " 10: UMOD TEMP[3].x, TEMP[3].xxxx, IMM[0].zzzz\n"
+      " 11: UMUL TEMP[3].x, TEMP[3].xxxx, IMM[0].wwww\n"
+      " 12: LOAD TEMP[3].x, MEMORY[0], TEMP[3].xxxx\n"
+      " 13: UMUL TEMP[2].x, TEMP[2].xxxx, IMM[0].wwww\n"
+      " 14: STORE BUFFER[0].x, TEMP[2].xxxx, TEMP[3].xxxx\n"
+      " 15: END\n",
+      test->block[0], test->block[1], test->block[2],
+      test->block[0], test->block[1], num_threads,
+      test->grid[0], test->grid[1]);
+}
+
+
+static boolean
+test_grid(struct pipe_context *pipe, unsigned verbose, FILE *fp,
+          const struct grid_case *test)
+{
+   const unsigned num_threads =
+      test->block[0] * test->block[1] * test->block[2];
+   const unsigned num_invocations =
+      num_threads * test->grid[0] * test->grid[1] * test->grid[2];
+   struct tgsi_token tokens[1024];
+   struct pipe_compute_state cs;
+   struct pipe_shader_buffer sb;
+   struct pipe_grid_info info;
+   struct pipe_resource *buf;
+   char text[2048];
+   uint32_t *results;
+   void *shader;
+   unsigned i, errors = 0;
+   boolean success;
+
+   make_shader_text(test, text, sizeof text);
+   if (!tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens))) {
+      fprintf(stderr, "failed to translate the shader\n");
+      return FALSE;
+   }
+
+   memset(&cs, 0, sizeof cs);
+   cs.ir_type = PIPE_SHADER_IR_TGSI;
+   cs.prog = tokens;
+   cs.req_local_mem = num_threads * 4;
+   shader = pipe->create_compute_state(pipe, &cs);
+   pipe->bind_compute_state(pipe, shader);
+
+   buf = pipe_buffer_create(pipe->screen, PIPE_BIND_SHADER_BUFFER,
+                            PIPE_USAGE_DEFAULT, num_invocations * 4);
+   memset(&sb, 0, sizeof sb);
+   sb.buffer = buf;
+   sb.buffer_size = num_invocations * 4;
+   pipe->set_shader_buffers(pipe, PIPE_SHADER_COMPUTE, 0, 1, &sb, 1);
+
+   memset(&info, 0, sizeof info);
+   for (i = 0; i < 3; i++) {
+      info.block[i] = test->block[i];
+      info.grid[i] = test->grid[i];
+   }
+   pipe->launch_grid(pipe, &info);
+
+   results = MALLOC(num_invocations * 4);
+   pipe_buffer_read(pipe, buf, 0, num_invocations * 4, results);
+
+   for (i = 0; i < num_invocations; i++) {
+      const unsigned group = i / num_threads;
+      const uint32_t expected =
+         group * num_threads + (i % num_threads + 1) % num_threads;
+
+      if (results[i] != expected) {
+         if (verbose || errors == 0)
+            fprintf(stderr, "invocation %u: expected %u, got %u\n",
+                    i, expected, results[i]);
+         errors++;
+      }
+   }
+   success = errors == 0;
+
+   if (verbose || !success)
+      fprintf(stderr, "%s block %ux%ux%u grid %ux%ux%u\n",
+              success ? "PASS" : "FAIL",
+              test->block[0], test->block[1], test->block[2],
+              test->grid[0], test->grid[1], test->grid[2]);
+
+   if (fp)
+      write_tsv_row(fp, test, success);
+
+   FREE(results);
+   pipe->set_shader_buffers(pipe, PIPE_SHADER_COMPUTE, 0, 1, NULL, 0);
+   pipe_resource_reference(&buf, NULL);
+   pipe->bind_compute_state(pipe, NULL);
+   pipe->delete_compute_state(pipe, shader);
+
+   return success;
+}
+
+
+static boolean
+test_grids(unsigned verbose, FILE *fp, unsigned num_cases)
+{
+   struct sw_winsys *winsys;
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   boolean success = TRUE;
+   unsigned i;
+
+   winsys = null_sw_create();
+   if (!winsys)
+      return FALSE;
+
+   screen = llvmpipe_create_screen(winsys);
+   if (!screen) {
+      winsys->destroy(winsys);
+      return FALSE;
+   }
+
+   pipe = screen->context_create(screen, NULL, 0);
+   if (!pipe) {
+      screen->destroy(screen);
+      return FALSE;
+   }
+
+   for (i = 0; i < num_cases; i++) {
+      if (!test_grid(pipe, verbose, fp, &grid_cases[i]))
+         success = FALSE;
+   }
+
+   pipe->destroy(pipe);
+   screen->destroy(screen);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_grids(verbose, fp, ARRAY_SIZE(grid_cases));
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_grids(verbose, fp, ARRAY_SIZE(grid_cases));
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_grids(verbose, fp, 1);
+}
@@ -0,0 +1,440 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Unit tests for the compilation of fragment shader variants.
+ *
+ * A textured quad is drawn with textures which need differently
+ * specialized variants of the same shader.  With a compiler thread, the
+ * draw thread must not compile any of them: the first draw waits for the
+ * generic variant, and the next one uses it while its own variant is
+ * compiled.  Without a compiler thread each variant is compiled by the
+ * draw.  The rendering is checked in every case.
+ */
+
+#include <stdlib.h>
+
+#include "util/u_box.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_queue.h"
+#include "util/u_string.h"
+#include "tgsi/tgsi_text.h"
+#include "state_tracker/sw_winsys.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_context.h"
+#include "lp_public.h"
+#include "lp_test.h"
+
+
+#define FB_SIZE 32
+#define TEXEL   0xff20c040
+
+
+static const char vs_text[] =
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL IN[1]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL OUT[1], GENERIC[0]\n"
+   "  0: MOV OUT[0], IN[0]\n"
+   "  1: MOV OUT[1], IN[1]\n"
+   "  2: END\n";
+
+static const char fs_text[] =
+   "FRAG\n"
+   "DCL IN[0], GENERIC[0], LINEAR\n"
+   "DCL OUT[0], COLOR\n"
+   "DCL SAMP[0]\n"
+   "DCL SVIEW[0], 2D, FLOAT\n"
+   "  0: TEX OUT[0], IN[0], SAMP[0], 2D\n"
+   "  1: END\n";
+
+
+struct test_state {
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   struct pipe_resource *cbuf;
+   struct pipe_surface *surf;
+   void *rs, *blend, *dsa, *velems, *sampler, *vs, *fs;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "compile_threads\t"
+           "draw_compiles\t"
+           "compile_waits\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              unsigned num_threads,
+              const struct llvmpipe_context *lp,
+              boolean success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+
+   fprintf(fp, "%u\t%u\t%u\n",
+           num_threads, lp->nr_fs_draw_compiles, lp->nr_fs_compile_waits);
+
+   fflush(fp);
+}
+
+
+static void *
+create_shader(struct pipe_context *pipe, const char *text, boolean fs)
+{
+   struct tgsi_token tokens[256];
+   struct pipe_shader_state state;
+
+   if (!tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens)))
+      return NULL;
+
+   memset(&state, 0, sizeof state);
+   state.type = PIPE_SHADER_IR_TGSI;
+   state.tokens = tokens;
+
+   return fs ? pipe->create_fs_state(pipe, &state) :
+               pipe->create_vs_state(pipe, &state);
+}
+
+
+static boolean
+init_state(struct test_state *state)
+{
+   struct pipe_context *pipe;
+   struct pipe_resource templ;
+   struct pipe_surface surf_templ;
+   struct pipe_framebuffer_state fb;
+   struct pipe_rasterizer_state rs;
+   struct pipe_blend_state blend;
+   struct pipe_depth_stencil_alpha_state dsa;
+   struct pipe_vertex_element velems[2];
+   struct pipe_sampler_state sampler;
+   struct pipe_viewport_state vp;
+   struct sw_winsys *winsys;
+
+   memset(state, 0, sizeof *state);
+
+   winsys = null_sw_create();
+   if (!winsys)
+      return FALSE;
+
+   state->screen = llvmpipe_create_screen(winsys);
+   if (!state->screen) {
+      winsys->destroy(winsys);
+      return FALSE;
+   }
+
+   pipe = state->pipe = state->screen->context_create(state->screen, NULL, 0);
+   if (!pipe)
+      return FALSE;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templ.width0 = FB_SIZE;
+   templ.height0 = FB_SIZE;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_RENDER_TARGET;
+   state->cbuf = state->screen->resource_create(state->screen, &templ);
+   if (!state->cbuf)
+      return FALSE;
+
+   memset(&surf_templ, 0, sizeof surf_templ);
+   surf_templ.format = templ.format;
+   state->surf = pipe->create_surface(pipe, state->cbuf, &surf_templ);
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = FB_SIZE;
+   fb.height = FB_SIZE;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = state->surf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   memset(&rs, 0, sizeof rs);
+   rs.half_pixel_center = 1;
+   rs.depth_clip_near = 1;
+   rs.depth_clip_far = 1;
+   state->rs = pipe->create_rasterizer_state(pipe, &rs);
+   pipe->bind_rasterizer_state(pipe, state->rs);
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   state->blend = pipe->create_blend_state(pipe, &blend);
+   pipe->bind_blend_state(pipe, state->blend);
+
+   memset(&dsa, 0, sizeof dsa);
+   state->dsa = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+   pipe->bind_depth_stencil_alpha_state(pipe, state->dsa);
+
+   memset(&vp, 0, sizeof vp);
+   vp.scale[0] = vp.scale[1] = FB_SIZE / 2;
+   vp.translate[0] = vp.translate[1] = FB_SIZE / 2;
+   vp.scale[2] = 1.0f;
+   pipe->set_viewport_states(pipe, 0, 1, &vp);
+
+   memset(velems, 0, sizeof velems);
+   velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   velems[1].src_offset = 16;
+   velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   state->velems = pipe->create_vertex_elements_state(pipe, 2, velems);
+   pipe->bind_vertex_elements_state(pipe, state->velems);
+
+   memset(&sampler, 0, sizeof sampler);
+   sampler.wrap_s = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+   sampler.wrap_t = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+   sampler.wrap_r = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+   sampler.min_img_filter = PIPE_TEX_FILTER_NEAREST;
+   sampler.mag_img_filter = PIPE_TEX_FILTER_NEAREST;
+   sampler.min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+   sampler.normalized_coords = 1;
+   state->sampler = pipe->create_sampler_state(pipe, &sampler);
+   pipe->bind_sampler_states(pipe, PIPE_SHADER_FRAGMENT, 0, 1,
+                             &state->sampler);
+
+   state->vs = create_shader(pipe, vs_text, FALSE);
+   state->fs = create_shader(pipe, fs_text, TRUE);
+   if (!state->vs || !state->fs)
+      return FALSE;
+
+   pipe->bind_vs_state(pipe, state->vs);
+   pipe->bind_fs_state(pipe, state->fs);
+
+   return TRUE;
+}
+
+
+static void
+cleanup_state(struct test_state *state)
+{
+   struct pipe_context *pipe = state->pipe;
+
+   if (pipe) {
+      pipe->bind_fs_state(pipe, NULL);
+      pipe->bind_vs_state(pipe, NULL);
+      if (state->fs)
+         pipe->delete_fs_state(pipe, state->fs);
+      if (state->vs)
+         pipe->delete_vs_state(pipe, state->vs);
+      if (state->sampler)
+         pipe->delete_sampler_state(pipe, state->sampler);
+      if (state->velems)
+         pipe->delete_vertex_elements_state(pipe, state->velems);
+      if (state->dsa)
+         pipe->delete_depth_stencil_alpha_state(pipe, state->dsa);
+      if (state->blend)
+         pipe->delete_blend_state(pipe, state->blend);
+      if (state->rs)
+         pipe->delete_rasterizer_state(pipe, state->rs);
+      pipe_surface_reference(&state->surf, NULL);
+      pipe_resource_reference(&state->cbuf, NULL);
+      pipe->destroy(pipe);
+   }
+   if (state->screen)
+      state->screen->destroy(state->screen);
+}
+
+
+/**
+ * Draw the framebuffer-sized quad with a texture of the given size, filled
+ * with TEXEL, and check the rendering.
+ */
+static boolean
+draw_textured_quad(struct test_state *state, unsigned tex_size)
+{
+   static const float verts[4][2][4] = {
+      { { -1.0f, -1.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } },
+      { {  1.0f, -1.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+      { { -1.0f,  1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
+      { {  1.0f,  1.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 0.0f, 1.0f } },
+   };
+   struct pipe_context *pipe = state->pipe;
+   struct pipe_resource templ, *tex;
+   struct pipe_sampler_view view_templ, *view;
+   struct pipe_vertex_buffer vbuf;
+   struct pipe_draw_info info;
+   struct pipe_transfer *transfer;
+   struct pipe_box box;
+   uint32_t *texels;
+   const uint8_t *map;
+   unsigned i, x, y, errors = 0;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templ.width0 = tex_size;
+   templ.height0 = tex_size;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_SAMPLER_VIEW;
+   tex = state->screen->resource_create(state->screen, &templ);
+   if (!tex)
+      return FALSE;
+
+   texels = MALLOC(tex_size * tex_size * 4);
+   for (i = 0; i < tex_size * tex_size; i++)
+      texels[i] = TEXEL;
+   u_box_2d(0, 0, tex_size, tex_size, &box);
+   pipe->texture_subdata(pipe, tex, 0, 0, &box, texels, tex_size * 4, 0);
+   FREE(texels);
+
+   u_sampler_view_default_template(&view_templ, tex, tex->format);
+   view = pipe->create_sampler_view(pipe, tex, &view_templ);
+   pipe->set_sampler_views(pipe, PIPE_SHADER_FRAGMENT, 0, 1, &view);
+
+   memset(&vbuf, 0, sizeof vbuf);
+   vbuf.stride = sizeof verts[0];
+   vbuf.is_user_buffer = true;
+   vbuf.buffer.user = verts;
+   pipe->set_vertex_buffers(pipe, 0, 1, &vbuf);
+
+   memset(&info, 0, sizeof info);
+   info.mode = PIPE_PRIM_TRIANGLE_STRIP;
+   info.count = 4;
+   info.instance_count = 1;
+   info.max_index = 3;
+   pipe->draw_vbo(pipe, &info);
+
+   u_box_2d(0, 0, FB_SIZE, FB_SIZE, &box);
+   map = pipe->transfer_map(pipe, state->cbuf, 0, PIPE_TRANSFER_READ,
+                            &box, &transfer);
+   for (y = 0; y < FB_SIZE; y++) {
+      for (x = 0; x < FB_SIZE; x++) {
+         const uint32_t *pixel =
+            (const uint32_t *) (map + y * transfer->stride) + x;
+
+         if (*pixel != TEXEL)
+            errors++;
+      }
+   }
+   pipe->transfer_unmap(pipe, transfer);
+
+   pipe->set_sampler_views(pipe, PIPE_SHADER_FRAGMENT, 0, 0, NULL);
+   pipe_sampler_view_reference(&view, NULL);
+   pipe_resource_reference(&tex, NULL);
+
+   return errors == 0;
+}
+
+
+/**
+ * Draw with a power-of-two texture, then with a non power-of-two one, and
+ * check how many variants the draw thread compiled and waited for.
+ */
+static boolean
+test_compile(unsigned verbose, FILE *fp, unsigned num_threads)
+{
+   struct test_state state;
+   struct llvmpipe_context *lp;
+   char value[16];
+   boolean success = TRUE;
+
+   /* read when the context is created */
+   util_snprintf(value, sizeof value, "%u", num_threads);
+   setenv("LP_COMPILE_THREADS", value, 1);
+
+   if (!init_state(&state)) {
+      fprintf(stderr, "failed to create the state\n");
+      cleanup_state(&state);
+      return FALSE;
+   }
+   lp = llvmpipe_context(state.pipe);
+
+   if (!draw_textured_quad(&state, 32) ||
+       !draw_textured_quad(&state, 30)) {
+      fprintf(stderr, "wrong rendering\n");
+      success = FALSE;
+   }
+
+   if (num_threads) {
+      /* the second draw used the generic variant the first waited for */
+      if (lp->nr_fs_draw_compiles != 0 || lp->nr_fs_compile_waits != 1)
+         success = FALSE;
+
+      /* and the specialized variants replace it once compiled */
+      util_queue_finish(&lp->fs_compile_queue);
+      if (!draw_textured_quad(&state, 32) || lp->fs_variant_pending)
+         success = FALSE;
+   }
+   else {
+      if (lp->nr_fs_draw_compiles != 2 || lp->nr_fs_compile_waits != 0)
+         success = FALSE;
+   }
+
+   if (verbose || !success)
+      fprintf(stderr, "%s %u compile threads: %u draw compiles, "
+              "%u compile waits\n",
+              success ? "PASS" : "FAIL", num_threads,
+              lp->nr_fs_draw_compiles, lp->nr_fs_compile_waits);
+
+   if (fp)
+      write_tsv_row(fp, num_threads, lp, success);
+
+   cleanup_state(&state);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   boolean success = TRUE;
+
+   if (!test_compile(verbose, fp, 1))
+      success = FALSE;
+   if (!test_compile(verbose, fp, 0))
+      success = FALSE;
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_compile(verbose, fp, 1);
+}
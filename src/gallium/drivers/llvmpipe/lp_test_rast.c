@@ -0,0 +1,367 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Unit tests and benchmark for the contained triangle kernels.
+ *
+ * Random triangles contained in a 4x4 or 16x16 block are rasterized by each
+ * kernel the CPU supports, the results are checked against a scalar
+ * reference, and the throughput is reported in triangles per second.
+ */
+
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_cpu_detect.h"
+#include "util/os_time.h"
+
+#include "lp_rast_priv.h"
+#include "lp_test.h"
+
+
+#define NUM_TRIANGLES 4096
+#define NUM_REPEATS   64
+
+
+struct tri_kernel {
+   const char *name;
+   boolean supported;
+   lp_rast_tri_3_16_func tri_3_16;
+   lp_rast_tri_3_4_func tri_3_4;
+};
+
+
+struct tri_case {
+   struct lp_rast_plane plane[3];
+   int x, y;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "tris_per_sec\t"
+           "kernel\t"
+           "size\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              const char *kernel,
+              unsigned size,
+              double tris_per_sec,
+              boolean success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+   fprintf(fp, "%.1f\t", tris_per_sec);
+   fprintf(fp, "%s\t%ux%u\n", kernel, size, size);
+
+   fflush(fp);
+}
+
+
+/**
+ * Mask of the pixels of the 4x4 block at x, y which are outside the
+ * triangle, evaluating the edge functions one pixel at a time.
+ */
+static unsigned
+ref_block_mask(const struct lp_rast_plane *plane, int x, int y)
+{
+   unsigned mask = 0;
+   unsigned i, j, k;
+
+   for (i = 0; i < 4; i++) {
+      for (j = 0; j < 4; j++) {
+         for (k = 0; k < 3; k++) {
+            int32_t c = (int32_t) ((uint32_t) plane[k].c -
+                                   (uint32_t) plane[k].dcdx * (x + j) +
+                                   (uint32_t) plane[k].dcdy * (y + i));
+            if (c <= 0) {
+               mask |= 1 << (i * 4 + j);
+               break;
+            }
+         }
+      }
+   }
+
+   return mask;
+}
+
+
+static unsigned
+ref_tri_3_16(const struct lp_rast_plane *plane, int x, int y,
+             struct lp_rast_block_mask *out)
+{
+   unsigned nr = 0;
+   unsigned i, j;
+
+   for (i = 0; i < 4; i++) {
+      for (j = 0; j < 4; j++) {
+         unsigned mask = ref_block_mask(plane, x + j * 4, y + i * 4);
+         if (mask != 0xffff) {
+            out[nr].i = i;
+            out[nr].j = j;
+            out[nr].mask = mask;
+            nr++;
+         }
+      }
+   }
+
+   return nr;
+}
+
+
+/**
+ * Make a random triangle contained in a size x size block, with the edge
+ * functions set up the way lp_setup_tri.c does: vertices in FIXED_ONE
+ * subpixel units, and steps of one pixel.
+ */
+static void
+random_triangle(unsigned size, struct tri_case *tri)
+{
+   int vx[3], vy[3];
+   int64_t cx = 0, cy = 0, e = 0;
+   unsigned k;
+
+   tri->x = (rand() % 64) * size;
+   tri->y = (rand() % 64) * size;
+
+   for (k = 0; k < 3; k++) {
+      vx[k] = tri->x * FIXED_ONE + rand() % (size * FIXED_ONE);
+      vy[k] = tri->y * FIXED_ONE + rand() % (size * FIXED_ONE);
+      cx += vx[k];
+      cy += vy[k];
+   }
+
+   for (k = 0; k < 3; k++) {
+      unsigned k1 = (k + 1) % 3;
+      struct lp_rast_plane *plane = &tri->plane[k];
+
+      plane->dcdx = vy[k] - vy[k1];
+      plane->dcdy = vx[k] - vx[k1];
+      plane->c = (int64_t) plane->dcdx * vx[k] - (int64_t) plane->dcdy * vy[k];
+      plane->eo = 0;
+      plane->pad = 0;
+   }
+
+   /* Orient the edges so that the centroid is inside. */
+   e = tri->plane[0].c * 3 - tri->plane[0].dcdx * cx + tri->plane[0].dcdy * cy;
+   for (k = 0; k < 3; k++) {
+      struct lp_rast_plane *plane = &tri->plane[k];
+
+      if (e < 0) {
+         plane->dcdx = -plane->dcdx;
+         plane->dcdy = -plane->dcdy;
+         plane->c = -plane->c;
+      }
+
+      /* Pixel steps, with the sample at the pixel center. */
+      plane->c = (plane->c - (int64_t) plane->dcdx * FIXED_ONE / 2 +
+                  (int64_t) plane->dcdy * FIXED_ONE / 2) >> FIXED_ORDER;
+   }
+}
+
+
+static boolean
+check_kernel(unsigned verbose, const struct tri_kernel *kernel,
+             unsigned size, const struct tri_case *tris, unsigned num_tris)
+{
+   unsigned t, b;
+
+   for (t = 0; t < num_tris; t++) {
+      const struct tri_case *tri = &tris[t];
+      struct lp_rast_block_mask ref[16], res[16];
+      unsigned ref_nr, res_nr;
+      boolean match = TRUE;
+
+      if (size == 4) {
+         ref[0].mask = ref_block_mask(tri->plane, tri->x, tri->y);
+         res[0].mask = kernel->tri_3_4(tri->plane, tri->x, tri->y);
+         match = ref[0].mask == res[0].mask;
+      }
+      else {
+         ref_nr = ref_tri_3_16(tri->plane, tri->x, tri->y, ref);
+         res_nr = kernel->tri_3_16(tri->plane, tri->x, tri->y, res);
+         match = ref_nr == res_nr;
+         for (b = 0; match && b < ref_nr; b++) {
+            match = ref[b].i == res[b].i &&
+                    ref[b].j == res[b].j &&
+                    ref[b].mask == res[b].mask;
+         }
+      }
+
+      if (!match) {
+         if (verbose) {
+            printf("%s: %ux%u triangle at %i, %i mismatch\n",
+                   kernel->name, size, size, tri->x, tri->y);
+            for (b = 0; b < 3; b++) {
+               printf("  plane %u: c = %lli, dcdx = %i, dcdy = %i\n", b,
+                      (long long) tri->plane[b].c,
+                      tri->plane[b].dcdx, tri->plane[b].dcdy);
+            }
+         }
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+static double
+time_kernel(const struct tri_kernel *kernel, unsigned size,
+            const struct tri_case *tris, unsigned num_tris)
+{
+   struct lp_rast_block_mask out[16];
+   volatile unsigned sink = 0;
+   int64_t start, end;
+   unsigned r, t;
+
+   start = os_time_get_nano();
+   for (r = 0; r < NUM_REPEATS; r++) {
+      for (t = 0; t < num_tris; t++) {
+         const struct tri_case *tri = &tris[t];
+         if (size == 4)
+            sink += kernel->tri_3_4(tri->plane, tri->x, tri->y);
+         else
+            sink += kernel->tri_3_16(tri->plane, tri->x, tri->y, out);
+      }
+   }
+   end = os_time_get_nano();
+
+   (void) sink;
+
+   if (end <= start)
+      return 0.0;
+
+   return (double) num_tris * NUM_REPEATS * 1e9 / (double) (end - start);
+}
+
+
+static boolean
+test_kernels(unsigned verbose, FILE *fp, unsigned num_tris)
+{
+   static const unsigned sizes[] = { 4, 16 };
+   struct tri_kernel kernels[3];
+   unsigned num_kernels = 0;
+   struct tri_case *tris;
+   boolean success = TRUE;
+   unsigned s, k, t;
+
+#if defined(PIPE_ARCH_SSE)
+   kernels[num_kernels].name = "sse2";
+   kernels[num_kernels].supported = util_cpu_caps.has_sse2;
+   kernels[num_kernels].tri_3_16 = lp_rast_tri_3_16_sse2;
+   kernels[num_kernels].tri_3_4 = lp_rast_tri_3_4_sse2;
+   num_kernels++;
+#endif
+#ifdef LP_HAVE_AVX2
+   kernels[num_kernels].name = "avx2";
+   kernels[num_kernels].supported = util_cpu_caps.has_avx2;
+   kernels[num_kernels].tri_3_16 = lp_rast_tri_3_16_avx2;
+   kernels[num_kernels].tri_3_4 = lp_rast_tri_3_4_avx2;
+   num_kernels++;
+#endif
+#ifdef LP_HAVE_AVX512
+   kernels[num_kernels].name = "avx512";
+   kernels[num_kernels].supported = util_cpu_caps.has_avx512f;
+   kernels[num_kernels].tri_3_16 = lp_rast_tri_3_16_avx512;
+   kernels[num_kernels].tri_3_4 = lp_rast_tri_3_4_avx512;
+   num_kernels++;
+#endif
+
+   if (!num_kernels) {
+      if (verbose)
+         printf("no contained triangle kernels on this architecture\n");
+      return TRUE;
+   }
+
+   tris = align_malloc(num_tris * sizeof *tris, 16);
+   if (!tris)
+      return FALSE;
+
+   for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+      srand(s + 1);
+      for (t = 0; t < num_tris; t++)
+         random_triangle(sizes[s], &tris[t]);
+
+      for (k = 0; k < num_kernels; k++) {
+         const struct tri_kernel *kernel = &kernels[k];
+         boolean pass;
+         double rate;
+
+         if (!kernel->supported)
+            continue;
+
+         pass = check_kernel(verbose, kernel, sizes[s], tris, num_tris);
+         rate = time_kernel(kernel, sizes[s], tris, num_tris);
+
+         if (verbose >= 1) {
+            printf("%s: %2ux%-2u %12.0f tris/sec  %s\n",
+                   kernel->name, sizes[s], sizes[s], rate,
+                   pass ? "pass" : "FAIL");
+         }
+
+         if (fp)
+            write_tsv_row(fp, kernel->name, sizes[s], rate, pass);
+
+         if (!pass)
+            success = FALSE;
+      }
+   }
+
+   align_free(tris);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_kernels(verbose, fp, NUM_TRIANGLES);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_kernels(verbose, fp, MAX2(n, 1));
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_kernels(verbose, fp, 1);
+}
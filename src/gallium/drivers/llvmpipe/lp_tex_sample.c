@@ -324,3 +324,138 @@ lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state)
    return &sampler->base;
 }
 
+
+
+/**
+ * The bridge between the shader images in lp_jit_context and the image
+ * code generator, like llvmpipe_sampler_dynamic_state for textures.
+ */
+struct lp_llvm_image_soa
+{
+   struct lp_build_image_soa base;
+
+   struct lp_sampler_dynamic_state dynamic_state;
+
+   const struct lp_static_texture_state *static_state;
+};
+
+
+/**
+ * Fetch the specified member of the lp_jit_image structure.
+ */
+static LLVMValueRef
+lp_llvm_image_member(const struct lp_sampler_dynamic_state *base,
+                     struct gallivm_state *gallivm,
+                     LLVMValueRef context_ptr,
+                     unsigned image_unit,
+                     unsigned member_index,
+                     const char *member_name)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef indices[4];
+   LLVMValueRef ptr;
+   LLVMValueRef res;
+
+   assert(image_unit < PIPE_MAX_SHADER_IMAGES);
+
+   /* context[0] */
+   indices[0] = lp_build_const_int32(gallivm, 0);
+   /* context[0].images */
+   indices[1] = lp_build_const_int32(gallivm, LP_JIT_CTX_IMAGES);
+   /* context[0].images[unit] */
+   indices[2] = lp_build_const_int32(gallivm, image_unit);
+   /* context[0].images[unit].member */
+   indices[3] = lp_build_const_int32(gallivm, member_index);
+
+   ptr = LLVMBuildGEP(builder, context_ptr, indices, ARRAY_SIZE(indices), "");
+   res = LLVMBuildLoad(builder, ptr, "");
+
+   lp_build_name(res, "context.image%u.%s", image_unit, member_name);
+
+   return res;
+}
+
+
+#define LP_LLVM_IMAGE_MEMBER(_name, _index)  \
+   static LLVMValueRef \
+   lp_llvm_image_##_name( const struct lp_sampler_dynamic_state *base, \
+                          struct gallivm_state *gallivm, \
+                          LLVMValueRef context_ptr, \
+                          unsigned image_unit) \
+   { \
+      return lp_llvm_image_member(base, gallivm, context_ptr, \
+                                  image_unit, _index, #_name ); \
+   }
+
+
+LP_LLVM_IMAGE_MEMBER(width,      LP_JIT_IMAGE_WIDTH)
+LP_LLVM_IMAGE_MEMBER(height,     LP_JIT_IMAGE_HEIGHT)
+LP_LLVM_IMAGE_MEMBER(depth,      LP_JIT_IMAGE_DEPTH)
+LP_LLVM_IMAGE_MEMBER(base_ptr,   LP_JIT_IMAGE_BASE)
+LP_LLVM_IMAGE_MEMBER(row_stride, LP_JIT_IMAGE_ROW_STRIDE)
+LP_LLVM_IMAGE_MEMBER(img_stride, LP_JIT_IMAGE_IMG_STRIDE)
+
+
+static void
+lp_llvm_image_soa_destroy(struct lp_build_image_soa *image)
+{
+   FREE(image);
+}
+
+
+static void
+lp_llvm_image_soa_emit_op(const struct lp_build_image_soa *base,
+                          struct gallivm_state *gallivm,
+                          const struct lp_img_params *params)
+{
+   struct lp_llvm_image_soa *image = (struct lp_llvm_image_soa *)base;
+
+   assert(params->image_index < PIPE_MAX_SHADER_IMAGES);
+
+   lp_build_img_op_soa(&image->static_state[params->image_index],
+                       &image->dynamic_state, gallivm, params);
+}
+
+
+/**
+ * Fetch the image size.
+ */
+static void
+lp_llvm_image_soa_emit_size_query(const struct lp_build_image_soa *base,
+                                  struct gallivm_state *gallivm,
+                                  const struct lp_sampler_size_query_params *params)
+{
+   struct lp_llvm_image_soa *image = (struct lp_llvm_image_soa *)base;
+
+   assert(params->texture_unit < PIPE_MAX_SHADER_IMAGES);
+
+   lp_build_size_query_soa(gallivm,
+                           &image->static_state[params->texture_unit],
+                           &image->dynamic_state,
+                           params);
+}
+
+
+struct lp_build_image_soa *
+lp_llvm_image_soa_create(const struct lp_static_texture_state *static_state)
+{
+   struct lp_llvm_image_soa *image;
+
+   image = CALLOC_STRUCT(lp_llvm_image_soa);
+   if (!image)
+      return NULL;
+
+   image->base.destroy = lp_llvm_image_soa_destroy;
+   image->base.emit_op = lp_llvm_image_soa_emit_op;
+   image->base.emit_size_query = lp_llvm_image_soa_emit_size_query;
+   image->dynamic_state.width = lp_llvm_image_width;
+   image->dynamic_state.height = lp_llvm_image_height;
+   image->dynamic_state.depth = lp_llvm_image_depth;
+   image->dynamic_state.base_ptr = lp_llvm_image_base_ptr;
+   image->dynamic_state.row_stride = lp_llvm_image_row_stride;
+   image->dynamic_state.img_stride = lp_llvm_image_img_stride;
+
+   image->static_state = static_state;
+
+   return &image->base;
+}
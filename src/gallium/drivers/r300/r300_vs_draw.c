@@ -320,6 +320,7 @@ void r300_draw_init_vertex_shader(struct r300_context *r300,
 
     tgsi_scan_shader(vs->state.tokens, &info);
 
+    new_vs.type = PIPE_SHADER_IR_TGSI;
     new_vs.tokens = tgsi_alloc_tokens(newLen);
     if (new_vs.tokens == NULL)
         return;
@@ -0,0 +1,624 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * Binned rasterization.
+ *
+ * The framebuffer tiles are shared among the threads by the position
+ * they take in a tile cache, see tile_cache_split().  Each thread has tile
+ * caches holding only its own tiles, and since those are at the same
+ * positions they would be in the caches of the context, the tiles are
+ * evicted and written back in the same order as without threads.  The
+ * rendering is identical to the single threaded one.
+ */
+
+#include "util/u_dynarray.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_queue.h"
+#include "tgsi/tgsi_exec.h"
+
+#include "sp_bin.h"
+#include "sp_context.h"
+#include "sp_limits.h"
+#include "sp_quad.h"
+#include "sp_quad_pipe.h"
+#include "sp_setup.h"
+#include "sp_state.h"
+#include "sp_tex_sample.h"
+#include "sp_tex_tile_cache.h"
+#include "sp_texture.h"
+#include "sp_tile_cache.h"
+
+
+/**
+ * A primitive of the draw being binned.  The vertices belong to the vbuf
+ * backend and stay valid until sp_bin_flush() returns.
+ */
+struct sp_bin_prim
+{
+   const float (*v[3])[4];
+   unsigned type;          /**< QUAD_PRIM_POINT, LINE, TRI */
+   unsigned first_thread;  /**< the one thread counting the primitive */
+};
+
+
+/**
+ * A rasterizer thread, which owns the tiles for which tile_cache_split()
+ * returns its index.
+ */
+struct sp_bin_thread
+{
+   struct sp_bin_context *bin;
+   unsigned index;
+
+   /**
+    * Copy of the context state read by the setup and the quad stages,
+    * updated before each flush and pointing to the members below.
+    */
+   struct softpipe_context softpipe;
+
+   struct setup_context *setup;
+   struct quad_stage *shade;
+   struct quad_stage *depth_test;
+   struct quad_stage *blend;
+   struct quad_stage *pstipple;
+
+   struct tgsi_exec_machine *fs_machine;
+   /** The fragment shader variant bound to fs_machine */
+   const struct sp_fragment_shader_variant *fs_variant;
+
+   struct sp_tgsi_sampler *sampler;
+   struct softpipe_tex_tile_cache *tex_cache[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   struct softpipe_tile_cache *cbuf_cache[PIPE_MAX_COLOR_BUFS];
+   struct softpipe_tile_cache *zsbuf_cache;
+
+   /** Indices of the binned primitives in sp_bin_context::prims */
+   struct util_dynarray prims;
+
+   struct util_queue_fence fence;
+};
+
+
+struct sp_bin_context
+{
+   struct softpipe_context *softpipe;
+
+   /** Runs the bins of all the threads but one, which the caller runs */
+   struct util_queue queue;
+
+   /** The primitives of the draw */
+   struct util_dynarray prims;
+
+   unsigned num_threads;
+   struct sp_bin_thread *threads[SP_MAX_THREADS];
+};
+
+
+static void
+destroy_thread(struct sp_bin_thread *thread)
+{
+   unsigned i;
+
+   if (thread->setup)
+      sp_setup_destroy_context(thread->setup);
+
+   if (thread->shade)
+      thread->shade->destroy(thread->shade);
+   if (thread->depth_test)
+      thread->depth_test->destroy(thread->depth_test);
+   if (thread->blend)
+      thread->blend->destroy(thread->blend);
+   if (thread->pstipple)
+      thread->pstipple->destroy(thread->pstipple);
+
+   tgsi_exec_machine_destroy(thread->fs_machine);
+   FREE(thread->sampler);
+
+   for (i = 0; i < PIPE_MAX_SHADER_SAMPLER_VIEWS; i++) {
+      if (thread->tex_cache[i]) {
+         sp_tex_tile_cache_set_sampler_view(thread->tex_cache[i], NULL);
+         sp_destroy_tex_tile_cache(thread->tex_cache[i]);
+      }
+   }
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      sp_destroy_tile_cache(thread->cbuf_cache[i]);
+   sp_destroy_tile_cache(thread->zsbuf_cache);
+
+   util_dynarray_fini(&thread->prims);
+   util_queue_fence_destroy(&thread->fence);
+   FREE(thread);
+}
+
+
+static struct sp_bin_thread *
+create_thread(struct sp_bin_context *bin, unsigned index)
+{
+   struct pipe_context *pipe = &bin->softpipe->pipe;
+   struct sp_bin_thread *thread = CALLOC_STRUCT(sp_bin_thread);
+   struct softpipe_context *sp;
+   unsigned i;
+
+   if (!thread)
+      return NULL;
+
+   sp = &thread->softpipe;
+   thread->bin = bin;
+   thread->index = index;
+   util_dynarray_init(&thread->prims, NULL);
+   util_queue_fence_init(&thread->fence);
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      thread->cbuf_cache[i] = sp_create_tile_cache(pipe);
+      if (!thread->cbuf_cache[i])
+         goto fail;
+      thread->cbuf_cache[i]->split_index = index;
+      thread->cbuf_cache[i]->split_count = bin->num_threads;
+   }
+   thread->zsbuf_cache = sp_create_tile_cache(pipe);
+   if (!thread->zsbuf_cache)
+      goto fail;
+   thread->zsbuf_cache->split_index = index;
+   thread->zsbuf_cache->split_count = bin->num_threads;
+
+   for (i = 0; i < PIPE_MAX_SHADER_SAMPLER_VIEWS; i++) {
+      thread->tex_cache[i] = sp_create_tex_tile_cache(pipe);
+      if (!thread->tex_cache[i])
+         goto fail;
+   }
+
+   thread->sampler = sp_create_tgsi_sampler();
+   thread->fs_machine = tgsi_exec_machine_create(PIPE_SHADER_FRAGMENT);
+   if (!thread->sampler || !thread->fs_machine)
+      goto fail;
+
+   /* The stages and the setup keep a pointer to the copy of the context */
+   thread->shade = sp_quad_shade_stage(sp);
+   thread->depth_test = sp_quad_depth_test_stage(sp);
+   thread->blend = sp_quad_blend_stage(sp);
+   thread->pstipple = sp_quad_polygon_stipple_stage(sp);
+   thread->setup = sp_setup_create_context(sp);
+   if (!thread->shade || !thread->depth_test || !thread->blend ||
+       !thread->pstipple || !thread->setup)
+      goto fail;
+
+   sp_setup_set_split(thread->setup, index, bin->num_threads);
+
+   return thread;
+
+fail:
+   destroy_thread(thread);
+   return NULL;
+}
+
+
+struct sp_bin_context *
+sp_bin_create(struct softpipe_context *softpipe, unsigned num_threads)
+{
+   struct sp_bin_context *bin;
+   unsigned i;
+
+   assert(num_threads > 0 && num_threads <= SP_MAX_THREADS);
+
+   bin = CALLOC_STRUCT(sp_bin_context);
+   if (!bin)
+      return NULL;
+
+   bin->softpipe = softpipe;
+   bin->num_threads = num_threads;
+   util_dynarray_init(&bin->prims, NULL);
+
+   for (i = 0; i < num_threads; i++) {
+      bin->threads[i] = create_thread(bin, i);
+      if (!bin->threads[i])
+         goto fail;
+   }
+
+   /* The calling thread rasterizes one of the bins */
+   if (num_threads > 1 &&
+       !util_queue_init(&bin->queue, "spbin", num_threads - 1,
+                        num_threads - 1, 0))
+      goto fail;
+
+   return bin;
+
+fail:
+   sp_bin_destroy(bin);
+   return NULL;
+}
+
+
+void
+sp_bin_destroy(struct sp_bin_context *bin)
+{
+   unsigned i;
+
+   if (util_queue_is_initialized(&bin->queue))
+      util_queue_destroy(&bin->queue);
+
+   for (i = 0; i < bin->num_threads; i++) {
+      if (bin->threads[i])
+         destroy_thread(bin->threads[i]);
+   }
+
+   util_dynarray_fini(&bin->prims);
+   FREE(bin);
+}
+
+
+/**
+ * Add a primitive to the bins of the threads owning the tiles its
+ * bounding box touches.
+ */
+static void
+bin_prim(struct sp_bin_context *bin, unsigned type,
+         const float (*v0)[4], const float (*v1)[4], const float (*v2)[4],
+         float xmin, float ymin, float xmax, float ymax)
+{
+   const struct softpipe_context *softpipe = bin->softpipe;
+   const unsigned all = (1u << bin->num_threads) - 1;
+   const unsigned index =
+      util_dynarray_num_elements(&bin->prims, struct sp_bin_prim);
+   struct sp_bin_prim *prim;
+   unsigned mask = 0;
+
+   if (softpipe->layer_slot > 0) {
+      /* The tiles of other layers are owned by other threads */
+      mask = all;
+   }
+   else {
+      /* Written so that NaNs end up covering the whole framebuffer */
+      const float width = (float) softpipe->framebuffer.width;
+      const float height = (float) softpipe->framebuffer.height;
+      const int x0 = (int) MIN2(MAX2(xmin, 0.0f), width);
+      const int y0 = (int) MIN2(MAX2(ymin, 0.0f), height);
+      const int x1 = (int) MAX2(MIN2(xmax, width - 1.0f), -1.0f);
+      const int y1 = (int) MAX2(MIN2(ymax, height - 1.0f), -1.0f);
+      int x, y;
+
+      for (y = y0 & ~(TILE_SIZE - 1); y <= y1 && mask != all; y += TILE_SIZE) {
+         for (x = x0 & ~(TILE_SIZE - 1); x <= x1 && mask != all; x += TILE_SIZE)
+            mask |= 1 << tile_cache_split(x, y, 0, bin->num_threads);
+      }
+   }
+
+   /* Not drawn at all, but still counted */
+   if (!mask)
+      mask = 1;
+
+   prim = util_dynarray_grow(&bin->prims, sizeof(*prim));
+   prim->v[0] = v0;
+   prim->v[1] = v1;
+   prim->v[2] = v2;
+   prim->type = type;
+   prim->first_thread = ffs(mask) - 1;
+
+   while (mask) {
+      struct sp_bin_thread *thread = bin->threads[u_bit_scan(&mask)];
+      util_dynarray_append(&thread->prims, unsigned, index);
+   }
+}
+
+
+void
+sp_bin_tri(struct sp_bin_context *bin,
+           const float (*v0)[4],
+           const float (*v1)[4],
+           const float (*v2)[4])
+{
+   /* Pixel centers are sampled, so a pixel of margin is plenty */
+   bin_prim(bin, QUAD_PRIM_TRI, v0, v1, v2,
+            MIN3(v0[0][0], v1[0][0], v2[0][0]) - 1.0f,
+            MIN3(v0[0][1], v1[0][1], v2[0][1]) - 1.0f,
+            MAX3(v0[0][0], v1[0][0], v2[0][0]) + 1.0f,
+            MAX3(v0[0][1], v1[0][1], v2[0][1]) + 1.0f);
+}
+
+
+void
+sp_bin_line(struct sp_bin_context *bin,
+            const float (*v0)[4],
+            const float (*v1)[4])
+{
+   bin_prim(bin, QUAD_PRIM_LINE, v0, v1, NULL,
+            MIN2(v0[0][0], v1[0][0]) - 1.0f,
+            MIN2(v0[0][1], v1[0][1]) - 1.0f,
+            MAX2(v0[0][0], v1[0][0]) + 1.0f,
+            MAX2(v0[0][1], v1[0][1]) + 1.0f);
+}
+
+
+void
+sp_bin_point(struct sp_bin_context *bin,
+             const float (*v0)[4])
+{
+   const struct softpipe_context *softpipe = bin->softpipe;
+   const int sizeAttr = softpipe->psize_slot;
+   const float size = sizeAttr > 0 ? v0[sizeAttr][0]
+                                   : softpipe->rasterizer->point_size;
+   /* Points are drawn in whole quads, which may add a pixel each side */
+   const float radius = 0.5f * size + 2.0f;
+
+   bin_prim(bin, QUAD_PRIM_POINT, v0, NULL, NULL,
+            v0[0][0] - radius, v0[0][1] - radius,
+            v0[0][0] + radius, v0[0][1] + radius);
+}
+
+
+static void
+bin_thread_execute(void *data, int thread_index)
+{
+   struct sp_bin_thread *thread = (struct sp_bin_thread *) data;
+   const struct sp_bin_prim *prims = thread->bin->prims.data;
+
+   util_dynarray_foreach(&thread->prims, unsigned, index) {
+      const struct sp_bin_prim *prim = &prims[*index];
+
+      sp_setup_count_prims(thread->setup,
+                           prim->first_thread == thread->index);
+
+      switch (prim->type) {
+      case QUAD_PRIM_TRI:
+         sp_setup_tri(thread->setup, prim->v[0], prim->v[1], prim->v[2]);
+         break;
+      case QUAD_PRIM_LINE:
+         sp_setup_line(thread->setup, prim->v[0], prim->v[1]);
+         break;
+      default:
+         sp_setup_point(thread->setup, prim->v[0]);
+         break;
+      }
+   }
+}
+
+
+/**
+ * Copy the derived state of the context to a thread, before it runs its
+ * bin.
+ */
+static void
+update_thread(struct sp_bin_context *bin, struct sp_bin_thread *thread)
+{
+   struct softpipe_context *softpipe = bin->softpipe;
+   struct softpipe_context *sp = &thread->softpipe;
+   const struct sp_tgsi_sampler *sampler =
+      softpipe->tgsi.sampler[PIPE_SHADER_FRAGMENT];
+   unsigned i;
+
+   memcpy(sp, softpipe, sizeof(*sp));
+   sp->bin = NULL;
+   sp->dirty = 0;
+   sp->occlusion_count = 0;
+   memset(&sp->pipeline_statistics, 0, sizeof(sp->pipeline_statistics));
+   memcpy(sp->cbuf_cache, thread->cbuf_cache, sizeof(sp->cbuf_cache));
+   sp->zsbuf_cache = thread->zsbuf_cache;
+   sp->quad.shade = thread->shade;
+   sp->quad.depth_test = thread->depth_test;
+   sp->quad.blend = thread->blend;
+   sp->quad.pstipple = thread->pstipple;
+   sp->fs_machine = thread->fs_machine;
+   sp->tgsi.sampler[PIPE_SHADER_FRAGMENT] = thread->sampler;
+
+   /* The same samplers and views, with the texture tiles of the thread */
+   memcpy(thread->sampler->sp_sampler, sampler->sp_sampler,
+          sizeof(sampler->sp_sampler));
+   for (i = 0; i < softpipe->num_sampler_views[PIPE_SHADER_FRAGMENT]; i++) {
+      struct pipe_sampler_view *view =
+         softpipe->sampler_views[PIPE_SHADER_FRAGMENT][i];
+      const struct softpipe_tex_tile_cache *main_tc =
+         softpipe->tex_cache[PIPE_SHADER_FRAGMENT][i];
+      struct softpipe_tex_tile_cache *tc = thread->tex_cache[i];
+
+      thread->sampler->sp_sview[i] = sampler->sp_sview[i];
+      sp_tex_tile_cache_set_sampler_view(tc, view);
+      if (!view)
+         continue;
+
+      /* Invalidate when the context did, see update_tgsi_samplers() */
+      if (tc->timestamp != main_tc->timestamp) {
+         sp_tex_tile_cache_validate_texture(tc);
+         tc->timestamp = main_tc->timestamp;
+      }
+      thread->sampler->sp_sview[i].cache = tc;
+   }
+
+   if (thread->fs_variant != softpipe->fs_variant) {
+      softpipe->fs_variant->prepare(softpipe->fs_variant,
+                                    thread->fs_machine,
+                                    (struct tgsi_sampler *) thread->sampler,
+                                    (struct tgsi_image *)
+                                    softpipe->tgsi.image[PIPE_SHADER_FRAGMENT],
+                                    (struct tgsi_buffer *)
+                                    softpipe->tgsi.buffer[PIPE_SHADER_FRAGMENT]);
+      thread->fs_variant = softpipe->fs_variant;
+   }
+
+   sp_build_quad_pipeline(sp);
+   sp_setup_prepare(thread->setup);
+}
+
+
+/**
+ * Rasterize the binned primitives, and wait for the threads to be done.
+ * Called at the end of each draw of the vbuf backend.
+ */
+void
+sp_bin_flush(struct sp_bin_context *bin)
+{
+   struct softpipe_context *softpipe = bin->softpipe;
+   struct sp_bin_thread *local = NULL;
+   boolean serial;
+   unsigned i;
+
+   if (!bin->prims.size)
+      return;
+
+   /* Shaders with stores and atomics run the bins one after the other,
+    * in the order of the threads.
+    */
+   serial = softpipe->fs_variant->info.writes_memory;
+
+   for (i = 0; i < bin->num_threads; i++) {
+      struct sp_bin_thread *thread = bin->threads[i];
+
+      if (!thread->prims.size)
+         continue;
+
+      update_thread(bin, thread);
+
+      if (serial)
+         bin_thread_execute(thread, 0);
+      else if (!local)
+         local = thread;
+      else
+         util_queue_add_job(&bin->queue, thread, &thread->fence,
+                            bin_thread_execute, NULL);
+   }
+
+   if (local)
+      bin_thread_execute(local, 0);
+
+   for (i = 0; i < bin->num_threads; i++) {
+      struct sp_bin_thread *thread = bin->threads[i];
+
+      if (!thread->prims.size)
+         continue;
+
+      util_queue_fence_wait(&thread->fence);
+
+      softpipe->occlusion_count += thread->softpipe.occlusion_count;
+      softpipe->pipeline_statistics.ps_invocations +=
+         thread->softpipe.pipeline_statistics.ps_invocations;
+      softpipe->pipeline_statistics.c_primitives +=
+         thread->softpipe.pipeline_statistics.c_primitives;
+
+      util_dynarray_clear(&thread->prims);
+   }
+
+   util_dynarray_clear(&bin->prims);
+}
+
+
+void
+sp_bin_set_framebuffer(struct sp_bin_context *bin,
+                       const struct pipe_framebuffer_state *fb)
+{
+   unsigned t, i;
+
+   for (t = 0; t < bin->num_threads; t++) {
+      struct sp_bin_thread *thread = bin->threads[t];
+
+      for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+         struct pipe_surface *cbuf = i < fb->nr_cbufs ? fb->cbufs[i] : NULL;
+
+         if (sp_tile_cache_get_surface(thread->cbuf_cache[i]) != cbuf) {
+            sp_flush_tile_cache(thread->cbuf_cache[i]);
+            sp_tile_cache_set_surface(thread->cbuf_cache[i], cbuf);
+         }
+      }
+
+      if (sp_tile_cache_get_surface(thread->zsbuf_cache) != fb->zsbuf) {
+         sp_flush_tile_cache(thread->zsbuf_cache);
+         sp_tile_cache_set_surface(thread->zsbuf_cache, fb->zsbuf);
+      }
+   }
+}
+
+
+void
+sp_bin_clear_cbuf(struct sp_bin_context *bin, unsigned cbuf,
+                  const union pipe_color_union *color)
+{
+   unsigned t;
+
+   for (t = 0; t < bin->num_threads; t++)
+      sp_tile_cache_clear(bin->threads[t]->cbuf_cache[cbuf], color, 0);
+}
+
+
+void
+sp_bin_clear_zsbuf(struct sp_bin_context *bin, uint64_t clear_value)
+{
+   static const union pipe_color_union zero;
+   unsigned t;
+
+   for (t = 0; t < bin->num_threads; t++)
+      sp_tile_cache_clear(bin->threads[t]->zsbuf_cache, &zero, clear_value);
+}
+
+
+void
+sp_bin_flush_tile_caches(struct sp_bin_context *bin)
+{
+   const unsigned nr_cbufs = bin->softpipe->framebuffer.nr_cbufs;
+   unsigned t, i;
+
+   for (t = 0; t < bin->num_threads; t++) {
+      struct sp_bin_thread *thread = bin->threads[t];
+
+      for (i = 0; i < nr_cbufs; i++)
+         sp_flush_tile_cache(thread->cbuf_cache[i]);
+      sp_flush_tile_cache(thread->zsbuf_cache);
+   }
+}
+
+
+void
+sp_bin_flush_tex_caches(struct sp_bin_context *bin)
+{
+   const unsigned num_views =
+      bin->softpipe->num_sampler_views[PIPE_SHADER_FRAGMENT];
+   unsigned t, i;
+
+   for (t = 0; t < bin->num_threads; t++) {
+      for (i = 0; i < num_views; i++)
+         sp_flush_tex_tile_cache(bin->threads[t]->tex_cache[i]);
+   }
+}
+
+
+/**
+ * Called before a fragment shader variant is deleted, which may still be
+ * bound to the machines of the threads.
+ */
+void
+sp_bin_release_fs_variant(struct sp_bin_context *bin,
+                          const struct sp_fragment_shader_variant *var)
+{
+   unsigned t;
+
+   for (t = 0; t < bin->num_threads; t++) {
+      struct sp_bin_thread *thread = bin->threads[t];
+
+      if (thread->fs_variant == var) {
+         tgsi_exec_machine_bind_shader(thread->fs_machine, NULL, NULL, NULL, NULL);
+         thread->fs_variant = NULL;
+      }
+   }
+}
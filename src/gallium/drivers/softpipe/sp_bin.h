@@ -0,0 +1,94 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * Binned rasterization: the primitives of a draw are sorted into bins by
+ * the framebuffer tiles they touch, and each bin is rasterized by a thread
+ * which owns those tiles, with its own setup, quad pipeline and caches.
+ */
+
+#ifndef SP_BIN_H
+#define SP_BIN_H
+
+#include "pipe/p_compiler.h"
+
+
+struct pipe_framebuffer_state;
+struct softpipe_context;
+struct sp_bin_context;
+struct sp_fragment_shader_variant;
+union pipe_color_union;
+
+
+struct sp_bin_context *
+sp_bin_create(struct softpipe_context *softpipe, unsigned num_threads);
+
+void
+sp_bin_destroy(struct sp_bin_context *bin);
+
+void
+sp_bin_tri(struct sp_bin_context *bin,
+           const float (*v0)[4],
+           const float (*v1)[4],
+           const float (*v2)[4]);
+
+void
+sp_bin_line(struct sp_bin_context *bin,
+            const float (*v0)[4],
+            const float (*v1)[4]);
+
+void
+sp_bin_point(struct sp_bin_context *bin,
+             const float (*v0)[4]);
+
+void
+sp_bin_flush(struct sp_bin_context *bin);
+
+void
+sp_bin_set_framebuffer(struct sp_bin_context *bin,
+                       const struct pipe_framebuffer_state *fb);
+
+void
+sp_bin_clear_cbuf(struct sp_bin_context *bin, unsigned cbuf,
+                  const union pipe_color_union *color);
+
+void
+sp_bin_clear_zsbuf(struct sp_bin_context *bin, uint64_t clear_value);
+
+void
+sp_bin_flush_tile_caches(struct sp_bin_context *bin);
+
+void
+sp_bin_flush_tex_caches(struct sp_bin_context *bin);
+
+void
+sp_bin_release_fs_variant(struct sp_bin_context *bin,
+                          const struct sp_fragment_shader_variant *var);
+
+
+#endif /* SP_BIN_H */
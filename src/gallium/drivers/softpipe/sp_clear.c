@@ -35,6 +35,7 @@
 #include "pipe/p_defines.h"
 #include "util/u_pack_color.h"
 #include "util/u_surface.h"
+#include "sp_bin.h"
 #include "sp_clear.h"
 #include "sp_context.h"
 #include "sp_query.h"
@@ -68,7 +69,11 @@ softpipe_clear(struct pipe_context *pipe, unsigned buffers,
 
    if (buffers & PIPE_CLEAR_COLOR) {
       for (i = 0; i < softpipe->framebuffer.nr_cbufs; i++) {
-         if (buffers & (PIPE_CLEAR_COLOR0 << i))
+         if (!(buffers & (PIPE_CLEAR_COLOR0 << i)))
+            continue;
+         if (softpipe->bin)
+            sp_bin_clear_cbuf(softpipe->bin, i, color);
+         else
             sp_tile_cache_clear(softpipe->cbuf_cache[i], color, 0);
       }
    }
@@ -84,7 +89,10 @@ softpipe_clear(struct pipe_context *pipe, unsigned buffers,
       static const union pipe_color_union zero;
 
       cv = util_pack64_z_stencil(zsbuf->format, depth, stencil);
-      sp_tile_cache_clear(softpipe->zsbuf_cache, &zero, cv);
+      if (softpipe->bin)
+         sp_bin_clear_zsbuf(softpipe->bin, cv);
+      else
+         sp_tile_cache_clear(softpipe->zsbuf_cache, &zero, cv);
    }
 
    softpipe->dirty_render_cache = TRUE;
@@ -22,6 +22,7 @@
  */
 #include "util/u_inlines.h"
 #include "util/u_math.h"
+#include "util/u_atomic.h"
 #include "util/u_memory.h"
 #include "util/u_pstipple.h"
 #include "pipe/p_shader_tokens.h"
@@ -35,10 +36,14 @@
 #include "sp_tex_tile_cache.h"
 #include "tgsi/tgsi_parse.h"
 
+/**
+ * Set up a machine to run 'count' invocations of a workgroup, starting at
+ * invocation 'first', one per lane.
+ */
 static void
 cs_prepare(const struct sp_compute_shader *cs,
            struct tgsi_exec_machine *machine,
-           int w, int h, int d,
+           int first, int count,
            int g_w, int g_h, int g_d,
            int b_w, int b_h, int b_d,
            struct tgsi_sampler *sampler,
@@ -55,16 +60,18 @@ cs_prepare(const struct sp_compute_shader *cs,
 
    if (machine->SysSemanticToIndex[TGSI_SEMANTIC_THREAD_ID] != -1) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_THREAD_ID];
-      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-         machine->SystemValue[i].xyzw[0].i[j] = w;
-         machine->SystemValue[i].xyzw[1].i[j] = h;
-         machine->SystemValue[i].xyzw[2].i[j] = d;
+      for (j = 0; j < TGSI_EXEC_WIDTH; j++) {
+         /* unused lanes get the ids of the last invocation */
+         const int idx = first + MIN2(j, count - 1);
+         machine->SystemValue[i].xyzw[0].i[j] = idx % b_w;
+         machine->SystemValue[i].xyzw[1].i[j] = (idx / b_w) % b_h;
+         machine->SystemValue[i].xyzw[2].i[j] = idx / (b_w * b_h);
       }
    }
 
    if (machine->SysSemanticToIndex[TGSI_SEMANTIC_GRID_SIZE] != -1) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_GRID_SIZE];
-      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+      for (j = 0; j < TGSI_EXEC_WIDTH; j++) {
          machine->SystemValue[i].xyzw[0].i[j] = g_w;
          machine->SystemValue[i].xyzw[1].i[j] = g_h;
          machine->SystemValue[i].xyzw[2].i[j] = g_d;
@@ -73,12 +80,14 @@ cs_prepare(const struct sp_compute_shader *cs,
 
    if (machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_SIZE] != -1) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_SIZE];
-      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+      for (j = 0; j < TGSI_EXEC_WIDTH; j++) {
          machine->SystemValue[i].xyzw[0].i[j] = b_w;
          machine->SystemValue[i].xyzw[1].i[j] = b_h;
          machine->SystemValue[i].xyzw[2].i[j] = b_d;
       }
    }
+
+   machine->NonHelperMask = TGSI_EXEC_MASK >> (TGSI_EXEC_WIDTH - count);
 }
 
 static bool
@@ -90,13 +99,12 @@ cs_run(const struct sp_compute_shader *cs,
       if (machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_ID] != -1) {
          unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_ID];
          int j;
-         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         for (j = 0; j < TGSI_EXEC_WIDTH; j++) {
             machine->SystemValue[i].xyzw[0].i[j] = g_w;
             machine->SystemValue[i].xyzw[1].i[j] = g_h;
             machine->SystemValue[i].xyzw[2].i[j] = g_d;
          }
       }
-      machine->NonHelperMask = (1 << 1) - 1;
    }
 
    tgsi_exec_machine_run(machine, restart ? machine->pc : 0);
@@ -108,7 +116,7 @@ cs_run(const struct sp_compute_shader *cs,
 
 static void
 run_workgroup(const struct sp_compute_shader *cs,
-              int g_w, int g_h, int g_d, int num_threads,
+              int g_w, int g_h, int g_d, int num_machines,
               struct tgsi_exec_machine **machines)
 {
    int i;
@@ -116,7 +124,7 @@ run_workgroup(const struct sp_compute_shader *cs,
 
    do {
       grp_hit_barrier = false;
-      for (i = 0; i < num_threads; i++) {
+      for (i = 0; i < num_machines; i++) {
          grp_hit_barrier |= cs_run(cs, g_w, g_h, g_d, machines[i], restart_threads);
       }
       restart_threads = false;
@@ -164,70 +172,316 @@ fill_grid_size(struct pipe_context *context,
    pipe_buffer_unmap(context, transfer);
 }
 
+/*
+ * When workgroups run on several threads, the read-modify-write of the
+ * atomic operations on images and buffers is shared between them, so they
+ * go through these wrappers which serialize them.  The other image and
+ * buffer accesses don't touch any shared state, and each thread samples
+ * the textures through tile caches of its own, see sp_cs_thread.
+ */
+struct sp_cs_image {
+   struct tgsi_image base;
+   const struct tgsi_image *image;
+   mtx_t *mutex;
+};
+
+struct sp_cs_buffer {
+   struct tgsi_buffer base;
+   const struct tgsi_buffer *buffer;
+   mtx_t *mutex;
+};
+
+static void
+cs_image_load(const struct tgsi_image *tgsi_image,
+              const struct tgsi_image_params *params,
+              const int s[TGSI_QUAD_SIZE],
+              const int t[TGSI_QUAD_SIZE],
+              const int r[TGSI_QUAD_SIZE],
+              const int sample[TGSI_QUAD_SIZE],
+              float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE])
+{
+   const struct sp_cs_image *cs_image = (const struct sp_cs_image *)tgsi_image;
+
+   cs_image->image->load(cs_image->image, params, s, t, r, sample, rgba);
+}
+
+static void
+cs_image_store(const struct tgsi_image *tgsi_image,
+               const struct tgsi_image_params *params,
+               const int s[TGSI_QUAD_SIZE],
+               const int t[TGSI_QUAD_SIZE],
+               const int r[TGSI_QUAD_SIZE],
+               const int sample[TGSI_QUAD_SIZE],
+               float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE])
+{
+   const struct sp_cs_image *cs_image = (const struct sp_cs_image *)tgsi_image;
+
+   cs_image->image->store(cs_image->image, params, s, t, r, sample, rgba);
+}
+
+static void
+cs_image_op(const struct tgsi_image *tgsi_image,
+            const struct tgsi_image_params *params,
+            enum tgsi_opcode opcode,
+            const int s[TGSI_QUAD_SIZE],
+            const int t[TGSI_QUAD_SIZE],
+            const int r[TGSI_QUAD_SIZE],
+            const int sample[TGSI_QUAD_SIZE],
+            float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE],
+            float rgba2[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE])
+{
+   const struct sp_cs_image *cs_image = (const struct sp_cs_image *)tgsi_image;
+
+   mtx_lock(cs_image->mutex);
+   cs_image->image->op(cs_image->image, params, opcode,
+                       s, t, r, sample, rgba, rgba2);
+   mtx_unlock(cs_image->mutex);
+}
+
+static void
+cs_image_get_dims(const struct tgsi_image *tgsi_image,
+                  const struct tgsi_image_params *params,
+                  int dims[4])
+{
+   const struct sp_cs_image *cs_image = (const struct sp_cs_image *)tgsi_image;
+
+   cs_image->image->get_dims(cs_image->image, params, dims);
+}
+
+static void
+cs_buffer_load(const struct tgsi_buffer *tgsi_buffer,
+               const struct tgsi_buffer_params *params,
+               const int s[TGSI_QUAD_SIZE],
+               float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE])
+{
+   const struct sp_cs_buffer *cs_buffer =
+      (const struct sp_cs_buffer *)tgsi_buffer;
+
+   cs_buffer->buffer->load(cs_buffer->buffer, params, s, rgba);
+}
+
+static void
+cs_buffer_store(const struct tgsi_buffer *tgsi_buffer,
+                const struct tgsi_buffer_params *params,
+                const int s[TGSI_QUAD_SIZE],
+                float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE])
+{
+   const struct sp_cs_buffer *cs_buffer =
+      (const struct sp_cs_buffer *)tgsi_buffer;
+
+   cs_buffer->buffer->store(cs_buffer->buffer, params, s, rgba);
+}
+
+static void
+cs_buffer_op(const struct tgsi_buffer *tgsi_buffer,
+             const struct tgsi_buffer_params *params,
+             enum tgsi_opcode opcode,
+             const int s[TGSI_QUAD_SIZE],
+             float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE],
+             float rgba2[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE])
+{
+   const struct sp_cs_buffer *cs_buffer =
+      (const struct sp_cs_buffer *)tgsi_buffer;
+
+   mtx_lock(cs_buffer->mutex);
+   cs_buffer->buffer->op(cs_buffer->buffer, params, opcode, s, rgba, rgba2);
+   mtx_unlock(cs_buffer->mutex);
+}
+
+static void
+cs_buffer_get_dims(const struct tgsi_buffer *tgsi_buffer,
+                   const struct tgsi_buffer_params *params,
+                   int *dim)
+{
+   const struct sp_cs_buffer *cs_buffer =
+      (const struct sp_cs_buffer *)tgsi_buffer;
+
+   cs_buffer->buffer->get_dims(cs_buffer->buffer, params, dim);
+}
+
+/**
+ * The samplers of a compute worker.  They are those of the context, with
+ * texture tile caches of their own, as the tile caches aren't thread safe.
+ * Created on first use and kept until the context is destroyed.
+ */
+struct sp_cs_thread {
+   struct sp_tgsi_sampler *sampler;
+   struct softpipe_tex_tile_cache *tex_cache[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+};
+
+static void
+destroy_cs_thread(struct sp_cs_thread *thread)
+{
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(thread->tex_cache); i++) {
+      if (thread->tex_cache[i]) {
+         sp_tex_tile_cache_set_sampler_view(thread->tex_cache[i], NULL);
+         sp_destroy_tex_tile_cache(thread->tex_cache[i]);
+      }
+   }
+
+   FREE(thread->sampler);
+   FREE(thread);
+}
+
+/**
+ * Get the samplers of worker 'index' ready for a grid launch, with the
+ * state of the context's compute samplers.
+ */
+static struct tgsi_sampler *
+prepare_cs_thread(struct softpipe_context *softpipe, unsigned index)
+{
+   const struct sp_tgsi_sampler *sampler =
+      softpipe->tgsi.sampler[PIPE_SHADER_COMPUTE];
+   struct sp_cs_thread *thread = softpipe->cs_threads[index];
+   unsigned i;
+
+   if (!thread) {
+      thread = CALLOC_STRUCT(sp_cs_thread);
+      if (!thread)
+         return NULL;
+
+      thread->sampler = sp_create_tgsi_sampler();
+      if (!thread->sampler) {
+         FREE(thread);
+         return NULL;
+      }
+
+      softpipe->cs_threads[index] = thread;
+   }
+
+   memcpy(thread->sampler->sp_sampler, sampler->sp_sampler,
+          sizeof(sampler->sp_sampler));
+   for (i = 0; i < softpipe->num_sampler_views[PIPE_SHADER_COMPUTE]; i++) {
+      struct pipe_sampler_view *view =
+         softpipe->sampler_views[PIPE_SHADER_COMPUTE][i];
+      struct softpipe_tex_tile_cache *tc = thread->tex_cache[i];
+
+      thread->sampler->sp_sview[i] = sampler->sp_sview[i];
+      if (!view)
+         continue;
+
+      if (!tc) {
+         tc = sp_create_tex_tile_cache(&softpipe->pipe);
+         if (!tc)
+            return NULL;
+         thread->tex_cache[i] = tc;
+      }
+
+      /* The texture may have been written since the previous grid */
+      sp_tex_tile_cache_set_sampler_view(tc, view);
+      sp_flush_tex_tile_cache(tc);
+      thread->sampler->sp_sview[i].cache = tc;
+   }
+
+   return (struct tgsi_sampler *) thread->sampler;
+}
+
+/**
+ * Called when the context is destroyed.
+ */
 void
-softpipe_launch_grid(struct pipe_context *context,
-                     const struct pipe_grid_info *info)
+softpipe_destroy_compute_threads(struct softpipe_context *softpipe)
 {
-   struct softpipe_context *softpipe = softpipe_context(context);
-   struct sp_compute_shader *cs = softpipe->cs;
-   int num_threads_in_group;
-   struct tgsi_exec_machine **machines;
+   unsigned i;
+
+   if (util_queue_is_initialized(&softpipe->cs_queue))
+      util_queue_destroy(&softpipe->cs_queue);
+
+   for (i = 0; i < ARRAY_SIZE(softpipe->cs_threads); i++) {
+      if (softpipe->cs_threads[i])
+         destroy_cs_thread(softpipe->cs_threads[i]);
+   }
+}
+
+/* Bound the memory used by the machines of all the threads, as there is
+ * one machine of about a MB per TGSI_EXEC_WIDTH invocations of a workgroup.
+ */
+#define SP_MAX_CS_MACHINES 512
+
+/**
+ * State of a grid launch shared by all the threads running its workgroups.
+ */
+struct sp_cs_dispatch {
+   struct softpipe_context *softpipe;
+   const struct sp_compute_shader *cs;
+   uint32_t grid_size[3];
    int bwidth, bheight, bdepth;
-   int w, h, d, i;
-   int g_w, g_h, g_d;
-   uint32_t grid_size[3] = {0};
-   void *local_mem = NULL;
 
-   softpipe_update_compute_samplers(softpipe);
-   bwidth = cs->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_WIDTH];
-   bheight = cs->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_HEIGHT];
-   bdepth = cs->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_DEPTH];
-   num_threads_in_group = bwidth * bheight * bdepth;
+   /** Index of the next workgroup to run, in the order of the grid */
+   uint64_t next_group;
+   uint64_t num_groups;
+
+   struct tgsi_image *image;
+   struct tgsi_buffer *buffer;
+};
 
-   fill_grid_size(context, info, grid_size);
+struct sp_cs_job {
+   struct sp_cs_dispatch *dispatch;
+   struct tgsi_sampler *sampler;
+   struct util_queue_fence fence;
+};
+
+/**
+ * Run workgroups of the grid until there is none left, each with the
+ * machines, shared memory and samplers of the calling thread.
+ */
+static void
+run_workgroups(struct sp_cs_dispatch *dispatch, struct tgsi_sampler *sampler)
+{
+   struct softpipe_context *softpipe = dispatch->softpipe;
+   const struct sp_compute_shader *cs = dispatch->cs;
+   const int bwidth = dispatch->bwidth;
+   const int bheight = dispatch->bheight;
+   const int bdepth = dispatch->bdepth;
+   const int num_threads_in_group = bwidth * bheight * bdepth;
+   const int num_machines = DIV_ROUND_UP(num_threads_in_group, TGSI_EXEC_WIDTH);
+   struct tgsi_exec_machine **machines;
+   uint64_t group;
+   int i;
+   void *local_mem = NULL;
 
    if (cs->shader.req_local_mem) {
       local_mem = CALLOC(1, cs->shader.req_local_mem);
    }
 
-   machines = CALLOC(sizeof(struct tgsi_exec_machine *), num_threads_in_group);
+   machines = CALLOC(sizeof(struct tgsi_exec_machine *), num_machines);
    if (!machines) {
       FREE(local_mem);
       return;
    }
 
    /* initialise machines + GRID_SIZE + THREAD_ID  + BLOCK_SIZE */
-   for (d = 0; d < bdepth; d++) {
-      for (h = 0; h < bheight; h++) {
-         for (w = 0; w < bwidth; w++) {
-            int idx = w + (h * bwidth) + (d * bheight * bwidth);
-            machines[idx] = tgsi_exec_machine_create(PIPE_SHADER_COMPUTE);
-
-            machines[idx]->LocalMem = local_mem;
-            machines[idx]->LocalMemSize = cs->shader.req_local_mem;
-            cs_prepare(cs, machines[idx],
-                       w, h, d,
-                       grid_size[0], grid_size[1], grid_size[2],
-                       bwidth, bheight, bdepth,
-                       (struct tgsi_sampler *)softpipe->tgsi.sampler[PIPE_SHADER_COMPUTE],
-                       (struct tgsi_image *)softpipe->tgsi.image[PIPE_SHADER_COMPUTE],
-                       (struct tgsi_buffer *)softpipe->tgsi.buffer[PIPE_SHADER_COMPUTE]);
-            tgsi_exec_set_constant_buffers(machines[idx], PIPE_MAX_CONSTANT_BUFFERS,
-                                           softpipe->mapped_constants[PIPE_SHADER_COMPUTE],
-                                           softpipe->const_buffer_size[PIPE_SHADER_COMPUTE]);
-         }
-      }
+   for (i = 0; i < num_machines; i++) {
+      const int first = i * TGSI_EXEC_WIDTH;
+
+      machines[i] = tgsi_exec_machine_create(PIPE_SHADER_COMPUTE);
+
+      machines[i]->LocalMem = local_mem;
+      machines[i]->LocalMemSize = cs->shader.req_local_mem;
+      cs_prepare(cs, machines[i],
+                 first, MIN2(num_threads_in_group - first, TGSI_EXEC_WIDTH),
+                 dispatch->grid_size[0], dispatch->grid_size[1],
+                 dispatch->grid_size[2],
+                 bwidth, bheight, bdepth,
+                 sampler, dispatch->image, dispatch->buffer);
+      tgsi_exec_set_constant_buffers(machines[i], PIPE_MAX_CONSTANT_BUFFERS,
+                                     softpipe->mapped_constants[PIPE_SHADER_COMPUTE],
+                                     softpipe->const_buffer_size[PIPE_SHADER_COMPUTE]);
    }
 
-   for (g_d = 0; g_d < grid_size[2]; g_d++) {
-      for (g_h = 0; g_h < grid_size[1]; g_h++) {
-         for (g_w = 0; g_w < grid_size[0]; g_w++) {
-            run_workgroup(cs, g_w, g_h, g_d, num_threads_in_group, machines);
-         }
-      }
+   while ((group = p_atomic_inc_return(&dispatch->next_group) - 1) <
+          dispatch->num_groups) {
+      const uint64_t row = group / dispatch->grid_size[0];
+      const int g_w = group % dispatch->grid_size[0];
+      const int g_h = row % dispatch->grid_size[1];
+      const int g_d = row / dispatch->grid_size[1];
+
+      run_workgroup(cs, g_w, g_h, g_d, num_machines, machines);
    }
 
-   for (i = 0; i < num_threads_in_group; i++) {
+   for (i = 0; i < num_machines; i++) {
       cs_delete(cs, machines[i]);
       tgsi_exec_machine_destroy(machines[i]);
    }
@@ -235,3 +489,119 @@ softpipe_launch_grid(struct pipe_context *context,
    FREE(local_mem);
    FREE(machines);
 }
+
+static void
+cs_job_execute(void *data, int thread_index)
+{
+   struct sp_cs_job *job = (struct sp_cs_job *)data;
+
+   run_workgroups(job->dispatch, job->sampler);
+}
+
+/**
+ * How many threads to run the workgroups of the grid on.
+ */
+static unsigned
+num_cs_jobs(struct softpipe_context *softpipe,
+            const struct sp_cs_dispatch *dispatch)
+{
+   const unsigned num_threads_in_group =
+      dispatch->bwidth * dispatch->bheight * dispatch->bdepth;
+   const unsigned num_machines = DIV_ROUND_UP(num_threads_in_group, TGSI_EXEC_WIDTH);
+   unsigned num_jobs;
+
+   if (!softpipe->num_cs_threads || dispatch->num_groups < 2)
+      return 0;
+
+   if (!util_queue_is_initialized(&softpipe->cs_queue) &&
+       !util_queue_init(&softpipe->cs_queue, "spcs", SP_MAX_THREADS,
+                        softpipe->num_cs_threads, 0)) {
+      softpipe->num_cs_threads = 0;
+      return 0;
+   }
+
+   num_jobs = MIN2(softpipe->num_cs_threads,
+                   MAX2(SP_MAX_CS_MACHINES / MAX2(num_machines, 1), 1));
+   if (num_jobs > dispatch->num_groups)
+      num_jobs = dispatch->num_groups;
+
+   return num_jobs > 1 ? num_jobs : 0;
+}
+
+void
+softpipe_launch_grid(struct pipe_context *context,
+                     const struct pipe_grid_info *info)
+{
+   struct softpipe_context *softpipe = softpipe_context(context);
+   struct sp_cs_dispatch dispatch;
+   struct sp_cs_job jobs[SP_MAX_THREADS];
+   unsigned num_jobs, i;
+
+   softpipe_update_compute_samplers(softpipe);
+
+   memset(&dispatch, 0, sizeof dispatch);
+   dispatch.softpipe = softpipe;
+   dispatch.cs = softpipe->cs;
+   dispatch.bwidth = dispatch.cs->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_WIDTH];
+   dispatch.bheight = dispatch.cs->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_HEIGHT];
+   dispatch.bdepth = dispatch.cs->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_DEPTH];
+
+   fill_grid_size(context, info, dispatch.grid_size);
+   dispatch.num_groups = (uint64_t)dispatch.grid_size[0] *
+                         dispatch.grid_size[1] * dispatch.grid_size[2];
+
+   dispatch.image = (struct tgsi_image *)softpipe->tgsi.image[PIPE_SHADER_COMPUTE];
+   dispatch.buffer = (struct tgsi_buffer *)softpipe->tgsi.buffer[PIPE_SHADER_COMPUTE];
+
+   num_jobs = num_cs_jobs(softpipe, &dispatch);
+
+   for (i = 0; i < num_jobs; i++) {
+      jobs[i].sampler = prepare_cs_thread(softpipe, i);
+      if (!jobs[i].sampler) {
+         num_jobs = i > 1 ? i : 0;
+         break;
+      }
+   }
+
+   if (!num_jobs) {
+      run_workgroups(&dispatch, (struct tgsi_sampler *)
+                     softpipe->tgsi.sampler[PIPE_SHADER_COMPUTE]);
+   }
+   else {
+      struct sp_cs_image image = {
+         .base = {
+            .load = cs_image_load,
+            .store = cs_image_store,
+            .op = cs_image_op,
+            .get_dims = cs_image_get_dims,
+         },
+         .image = dispatch.image,
+         .mutex = &softpipe->cs_mutex,
+      };
+      struct sp_cs_buffer buffer = {
+         .base = {
+            .load = cs_buffer_load,
+            .store = cs_buffer_store,
+            .op = cs_buffer_op,
+            .get_dims = cs_buffer_get_dims,
+         },
+         .buffer = dispatch.buffer,
+         .mutex = &softpipe->cs_mutex,
+      };
+
+      dispatch.image = &image.base;
+      dispatch.buffer = &buffer.base;
+
+      for (i = 0; i < num_jobs; i++) {
+         jobs[i].dispatch = &dispatch;
+         util_queue_fence_init(&jobs[i].fence);
+         util_queue_add_job(&softpipe->cs_queue, &jobs[i], &jobs[i].fence,
+                            cs_job_execute, NULL);
+      }
+
+      for (i = 0; i < num_jobs; i++) {
+         util_queue_fence_wait(&jobs[i].fence);
+         util_queue_fence_destroy(&jobs[i].fence);
+      }
+   }
+}
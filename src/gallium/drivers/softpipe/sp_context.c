@@ -33,12 +33,14 @@
 #include "draw/draw_context.h"
 #include "draw/draw_vbuf.h"
 #include "pipe/p_defines.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_pstipple.h"
 #include "util/u_inlines.h"
 #include "util/u_upload_mgr.h"
 #include "tgsi/tgsi_exec.h"
+#include "sp_bin.h"
 #include "sp_buffer.h"
 #include "sp_clear.h"
 #include "sp_context.h"
@@ -87,6 +89,12 @@ softpipe_destroy( struct pipe_context *pipe )
    if (softpipe->quad.pstipple)
       softpipe->quad.pstipple->destroy( softpipe->quad.pstipple );
 
+   if (softpipe->bin)
+      sp_bin_destroy(softpipe->bin);
+
+   softpipe_destroy_compute_threads(softpipe);
+   mtx_destroy(&softpipe->cs_mutex);
+
    if (softpipe->pipe.stream_uploader)
       u_upload_destroy(softpipe->pipe.stream_uploader);
 
@@ -198,6 +206,7 @@ softpipe_create_context(struct pipe_screen *screen,
 {
    struct softpipe_screen *sp_screen = softpipe_screen(screen);
    struct softpipe_context *softpipe = CALLOC_STRUCT(softpipe_context);
+   unsigned num_rast_threads;
    uint i, sh;
 
    util_init_math();
@@ -218,6 +227,16 @@ softpipe_create_context(struct pipe_screen *screen,
    softpipe->dump_gs = debug_get_bool_option( "SOFTPIPE_DUMP_GS", FALSE );
    softpipe->dump_cs = debug_get_bool_option( "SOFTPIPE_DUMP_CS", FALSE );
 
+   util_cpu_detect();
+   softpipe->num_cs_threads =
+      debug_get_num_option("SOFTPIPE_NUM_THREADS",
+                           util_cpu_caps.nr_cpus > 1 ?
+                           MIN2(util_cpu_caps.nr_cpus, SP_MAX_THREADS) : 0);
+   softpipe->num_cs_threads = MIN2(softpipe->num_cs_threads, SP_MAX_THREADS);
+   (void) mtx_init(&softpipe->cs_mutex, mtx_plain);
+   num_rast_threads = debug_get_num_option("SOFTPIPE_RAST_THREADS", 0);
+   num_rast_threads = MIN2(num_rast_threads, SP_MAX_THREADS);
+
    softpipe->pipe.screen = screen;
    softpipe->pipe.destroy = softpipe_destroy;
    softpipe->pipe.priv = priv;
@@ -271,6 +290,12 @@ softpipe_create_context(struct pipe_screen *screen,
    softpipe->quad.blend = sp_quad_blend_stage(softpipe);
    softpipe->quad.pstipple = sp_quad_polygon_stipple_stage(softpipe);
 
+   if (num_rast_threads) {
+      softpipe->bin = sp_bin_create(softpipe, num_rast_threads);
+      if (!softpipe->bin)
+         goto fail;
+   }
+
    softpipe->pipe.stream_uploader = u_upload_create_default(&softpipe->pipe);
    if (!softpipe->pipe.stream_uploader)
       goto fail;
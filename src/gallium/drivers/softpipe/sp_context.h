@@ -33,9 +33,11 @@
 
 #include "pipe/p_context.h"
 #include "util/u_blitter.h"
+#include "util/u_queue.h"
 
 #include "draw/draw_vertex.h"
 
+#include "sp_limits.h"
 #include "sp_quad_pipe.h"
 #include "sp_setup.h"
 
@@ -48,6 +50,8 @@
 
 
 struct softpipe_vbuf_render;
+struct sp_bin_context;
+struct sp_cs_thread;
 struct draw_context;
 struct draw_stage;
 struct softpipe_tile_cache;
@@ -205,6 +209,17 @@ struct softpipe_context {
     */
    struct softpipe_tex_tile_cache *tex_cache[PIPE_SHADER_TYPES][PIPE_MAX_SHADER_SAMPLER_VIEWS];
 
+   /** Rasterizer threads, when binned rasterization is enabled */
+   struct sp_bin_context *bin;
+
+   /** Worker threads running compute workgroups, created on first use */
+   struct util_queue cs_queue;
+   unsigned num_cs_threads;
+   /** The samplers of the workers, with their own texture tile caches */
+   struct sp_cs_thread *cs_threads[SP_MAX_THREADS];
+   /** Serializes the image and buffer atomics of the workers */
+   mtx_t cs_mutex;
+
    unsigned dump_fs : 1;
    unsigned dump_gs : 1;
    unsigned dump_cs : 1;
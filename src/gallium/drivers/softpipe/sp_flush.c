@@ -33,6 +33,7 @@
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
+#include "sp_bin.h"
 #include "sp_flush.h"
 #include "sp_context.h"
 #include "sp_state.h"
@@ -61,6 +62,8 @@ softpipe_flush( struct pipe_context *pipe,
             sp_flush_tex_tile_cache(softpipe->tex_cache[sh][i]);
          }
       }
+      if (softpipe->bin)
+         sp_bin_flush_tex_caches(softpipe->bin);
    }
 
    /* If this is a swapbuffers, just flush color buffers.
@@ -75,6 +78,9 @@ softpipe_flush( struct pipe_context *pipe,
    if (softpipe->zsbuf_cache)
       sp_flush_tile_cache(softpipe->zsbuf_cache);
 
+   if (softpipe->bin)
+      sp_bin_flush_tile_caches(softpipe->bin);
+
    softpipe->dirty_render_cache = FALSE;
 
    /* Enable to dump BMPs of the color/depth buffers each frame */
@@ -179,6 +185,8 @@ void softpipe_texture_barrier(struct pipe_context *pipe, unsigned flags)
          sp_flush_tex_tile_cache(softpipe->tex_cache[sh][i]);
       }
    }
+   if (softpipe->bin)
+      sp_bin_flush_tex_caches(softpipe->bin);
 
    for (i = 0; i < softpipe->framebuffer.nr_cbufs; i++)
       if (softpipe->cbuf_cache[i])
@@ -187,6 +195,9 @@ void softpipe_texture_barrier(struct pipe_context *pipe, unsigned flags)
    if (softpipe->zsbuf_cache)
       sp_flush_tile_cache(softpipe->zsbuf_cache);
 
+   if (softpipe->bin)
+      sp_bin_flush_tile_caches(softpipe->bin);
+
    softpipe->dirty_render_cache = FALSE;
 }
 
@@ -69,37 +69,39 @@ exec_prepare( const struct sp_fragment_shader_variant *var,
 
 
 /**
- * Compute quad X,Y,Z,W for the four fragments in a quad.
+ * Compute quad X,Y,Z,W for the four fragments in a quad, into the lanes
+ * starting at 'lane'.
  *
  * This should really be part of the compiled shader.
  */
 static void
 setup_pos_vector(const struct tgsi_interp_coef *coef,
                  float x, float y,
-                 struct tgsi_exec_vector *quadpos)
+                 struct tgsi_exec_vector *quadpos,
+                 uint lane)
 {
    uint chan;
    /* do X */
-   quadpos->xyzw[0].f[0] = x;
-   quadpos->xyzw[0].f[1] = x + 1;
-   quadpos->xyzw[0].f[2] = x;
-   quadpos->xyzw[0].f[3] = x + 1;
+   quadpos->xyzw[0].f[lane + 0] = x;
+   quadpos->xyzw[0].f[lane + 1] = x + 1;
+   quadpos->xyzw[0].f[lane + 2] = x;
+   quadpos->xyzw[0].f[lane + 3] = x + 1;
 
    /* do Y */
-   quadpos->xyzw[1].f[0] = y;
-   quadpos->xyzw[1].f[1] = y;
-   quadpos->xyzw[1].f[2] = y + 1;
-   quadpos->xyzw[1].f[3] = y + 1;
+   quadpos->xyzw[1].f[lane + 0] = y;
+   quadpos->xyzw[1].f[lane + 1] = y;
+   quadpos->xyzw[1].f[lane + 2] = y + 1;
+   quadpos->xyzw[1].f[lane + 3] = y + 1;
 
    /* do Z and W for all fragments in the quad */
    for (chan = 2; chan < 4; chan++) {
       const float dadx = coef->dadx[chan];
       const float dady = coef->dady[chan];
       const float a0 = coef->a0[chan] + dadx * x + dady * y;
-      quadpos->xyzw[chan].f[0] = a0;
-      quadpos->xyzw[chan].f[1] = a0 + dadx;
-      quadpos->xyzw[chan].f[2] = a0 + dady;
-      quadpos->xyzw[chan].f[3] = a0 + dadx + dady;
+      quadpos->xyzw[chan].f[lane + 0] = a0;
+      quadpos->xyzw[chan].f[lane + 1] = a0 + dadx;
+      quadpos->xyzw[chan].f[lane + 2] = a0 + dady;
+      quadpos->xyzw[chan].f[lane + 3] = a0 + dadx + dady;
    }
 }
 
@@ -110,41 +112,56 @@ setup_pos_vector(const struct tgsi_interp_coef *coef,
 static unsigned 
 exec_run( const struct sp_fragment_shader_variant *var,
 	  struct tgsi_exec_machine *machine,
-	  struct quad_header *quad,
+	  struct quad_header *quads[],
+	  unsigned nr,
 	  bool early_depth_test )
 {
-   /* Compute X, Y, Z, W vals for this quad */
-   setup_pos_vector(quad->posCoef, 
-                    (float)quad->input.x0, (float)quad->input.y0, 
-                    &machine->QuadPos);
+   uint nonhelper = 0, alive = 0, mask;
+   uint q;
 
-   /* convert 0 to 1.0 and 1 to -1.0 */
-   machine->Face = (float) (quad->input.facing * -2 + 1);
+   assert(nr <= TGSI_EXEC_NUM_QUADS);
 
-   machine->NonHelperMask = quad->inout.mask;
-   quad->inout.mask &= tgsi_exec_machine_run( machine, 0 );
-   if (quad->inout.mask == 0)
-      return FALSE;
+   /* Compute X, Y, Z, W vals for these quads, one quad per 4 lanes */
+   for (q = 0; q < nr; q++) {
+      setup_pos_vector(quads[q]->posCoef,
+                       (float)quads[q]->input.x0, (float)quads[q]->input.y0,
+                       &machine->QuadPos, q * TGSI_QUAD_SIZE);
+      nonhelper |= quads[q]->inout.mask << (q * TGSI_QUAD_SIZE);
+   }
+
+   /* convert 0 to 1.0 and 1 to -1.0, the quads come from one primitive */
+   machine->Face = (float) (quads[0]->input.facing * -2 + 1);
 
-   /* store outputs */
-   {
+   machine->NonHelperMask = nonhelper;
+   mask = tgsi_exec_machine_run( machine, 0 );
+
+   for (q = 0; q < nr; q++) {
+      struct quad_header *quad = quads[q];
+      const uint lane = q * TGSI_QUAD_SIZE;
       const ubyte *sem_name = var->info.output_semantic_name;
       const ubyte *sem_index = var->info.output_semantic_index;
       const uint n = var->info.num_outputs;
       uint i;
+
+      quad->inout.mask &= mask >> lane;
+      if (quad->inout.mask == 0)
+         continue;
+
+      alive |= 1 << q;
+
+      /* store outputs */
       for (i = 0; i < n; i++) {
          switch (sem_name[i]) {
          case TGSI_SEMANTIC_COLOR:
             {
                uint cbuf = sem_index[i];
-
-               assert(sizeof(quad->output.color[cbuf]) ==
-                      sizeof(machine->Outputs[i]));
+               uint chan;
 
                /* copy float[4][4] result */
-               memcpy(quad->output.color[cbuf],
-                      &machine->Outputs[i],
-                      sizeof(quad->output.color[0]) );
+               for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+                  memcpy(quad->output.color[cbuf][chan],
+                         &machine->Outputs[i].xyzw[chan].f[lane],
+                         sizeof(quad->output.color[0][0]));
             }
             break;
          case TGSI_SEMANTIC_POSITION:
@@ -153,7 +170,7 @@ exec_run( const struct sp_fragment_shader_variant *var,
 
                if (!early_depth_test) {
                   for (j = 0; j < 4; j++)
-                     quad->output.depth[j] = machine->Outputs[i].xyzw[2].f[j];
+                     quad->output.depth[j] = machine->Outputs[i].xyzw[2].f[lane + j];
                }
             }
             break;
@@ -162,7 +179,7 @@ exec_run( const struct sp_fragment_shader_variant *var,
                uint j;
                if (!early_depth_test) {
                   for (j = 0; j < 4; j++)
-                     quad->output.stencil[j] = (unsigned)machine->Outputs[i].xyzw[1].u[j];
+                     quad->output.stencil[j] = (unsigned)machine->Outputs[i].xyzw[1].u[lane + j];
                }
             }
             break;
@@ -170,7 +187,7 @@ exec_run( const struct sp_fragment_shader_variant *var,
       }
    }
 
-   return TRUE;
+   return alive;
 }
 
 
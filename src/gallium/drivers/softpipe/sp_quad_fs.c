@@ -56,23 +56,27 @@ struct quad_shade_stage
 
 
 /**
- * Execute fragment shader for the four fragments in the quad.
- * \return TRUE if quad is alive, FALSE if all four pixels are killed
+ * Execute fragment shader for the fragments of up to TGSI_EXEC_NUM_QUADS
+ * quads at once.
+ * \return bitmask of the quads which are alive, a quad is dead if all
+ * four pixels are killed
  */
-static inline boolean
-shade_quad(struct quad_stage *qs, struct quad_header *quad)
+static inline unsigned
+shade_quad(struct quad_stage *qs, struct quad_header *quads[], unsigned nr)
 {
    struct softpipe_context *softpipe = qs->softpipe;
    struct tgsi_exec_machine *machine = softpipe->fs_machine;
 
    if (softpipe->active_statistics_queries) {
-      softpipe->pipeline_statistics.ps_invocations +=
-         util_bitcount(quad->inout.mask);         
+      unsigned i;
+      for (i = 0; i < nr; i++)
+         softpipe->pipeline_statistics.ps_invocations +=
+            util_bitcount(quads[i]->inout.mask);
    }
 
    /* run shader */
    machine->flatshade_color = softpipe->rasterizer->flatshade ? TRUE : FALSE;
-   return softpipe->fs_variant->run( softpipe->fs_variant, machine, quad, softpipe->early_depth );
+   return softpipe->fs_variant->run( softpipe->fs_variant, machine, quads, nr, softpipe->early_depth );
 }
 
 
@@ -107,7 +111,7 @@ shade_quads(struct quad_stage *qs,
 {
    struct softpipe_context *softpipe = qs->softpipe;
    struct tgsi_exec_machine *machine = softpipe->fs_machine;
-   unsigned i, nr_quads = 0;
+   unsigned i, j, nr_quads = 0;
 
    tgsi_exec_set_constant_buffers(machine, PIPE_MAX_CONSTANT_BUFFERS,
                          softpipe->mapped_constants[PIPE_SHADER_FRAGMENT],
@@ -115,23 +119,28 @@ shade_quads(struct quad_stage *qs,
 
    machine->InterpCoefs = quads[0]->coef;
 
-   for (i = 0; i < nr; i++) {
-      /* Only omit this quad from the output list if all the fragments
-       * are killed _AND_ it's not the first quad in the list.
-       * The first quad is special in the (optimized) depth-testing code:
-       * the quads' Z coordinates are step-wise interpolated with respect
-       * to the first quad in the list.
-       * For multi-pass algorithms we need to produce exactly the same
-       * Z values in each pass.  If interpolation starts with different quads
-       * we can get different Z values for the same (x,y).
-       */
-      if (!shade_quad(qs, quads[i]) && i > 0)
-         continue; /* quad totally culled/killed */
-
-      if (/*do_coverage*/ 0)
-         coverage_quad( qs, quads[i] );
-
-      quads[nr_quads++] = quads[i];
+   for (i = 0; i < nr; i += TGSI_EXEC_NUM_QUADS) {
+      const unsigned n = MIN2(nr - i, TGSI_EXEC_NUM_QUADS);
+      const unsigned alive = shade_quad(qs, &quads[i], n);
+
+      for (j = i; j < i + n; j++) {
+         /* Only omit this quad from the output list if all the fragments
+          * are killed _AND_ it's not the first quad in the list.
+          * The first quad is special in the (optimized) depth-testing code:
+          * the quads' Z coordinates are step-wise interpolated with respect
+          * to the first quad in the list.
+          * For multi-pass algorithms we need to produce exactly the same
+          * Z values in each pass.  If interpolation starts with different quads
+          * we can get different Z values for the same (x,y).
+          */
+         if (!(alive & (1 << (j - i))) && j > 0)
+            continue; /* quad totally culled/killed */
+
+         if (/*do_coverage*/ 0)
+            coverage_quad( qs, quads[j] );
+
+         quads[nr_quads++] = quads[j];
+      }
    }
    
    if (nr_quads)
@@ -32,11 +32,13 @@
  * \author  Brian Paul
  */
 
+#include "sp_bin.h"
 #include "sp_context.h"
 #include "sp_quad.h"
 #include "sp_quad_pipe.h"
 #include "sp_setup.h"
 #include "sp_state.h"
+#include "sp_tile_cache.h"
 #include "draw/draw_context.h"
 #include "pipe/p_shader_tokens.h"
 #include "util/u_math.h"
@@ -113,6 +115,14 @@ struct setup_context {
 
    unsigned cull_face;		/* which faces cull */
    unsigned nr_vertex_attrs;
+
+   /**
+    * When the framebuffer tiles are split between the rasterizer threads,
+    * the index of this thread and the number of threads.  Only the quads
+    * of the tiles of this thread are emitted.
+    */
+   unsigned split_index, split_count;
+   boolean count_prims;   /**< count triangles for statistics queries? */
 };
 
 
@@ -153,6 +163,19 @@ quad_clip(struct setup_context *setup, struct quad_header *quad)
 }
 
 
+/**
+ * Does the tile containing the quad or span at (x,y) belong to another
+ * rasterizer thread?
+ */
+static inline boolean
+other_thread_tile(const struct setup_context *setup, int x, int y)
+{
+   return setup->split_count > 1 &&
+          tile_cache_split(x, y, setup->quad[0].input.layer,
+                           setup->split_count) != setup->split_index;
+}
+
+
 /**
  * Emit a quad (pass to next stage) with clipping.
  */
@@ -161,7 +184,8 @@ clip_emit_quad(struct setup_context *setup, struct quad_header *quad)
 {
    quad_clip(setup, quad);
 
-   if (quad->inout.mask) {
+   if (quad->inout.mask &&
+       !other_thread_tile(setup, quad->input.x0, quad->input.y0)) {
       struct softpipe_context *sp = setup->softpipe;
 
 #if DEBUG_FRAGS
@@ -229,6 +253,10 @@ flush_spans(struct setup_context *setup)
       unsigned mask0 = ~skipmask_left0 & ~skipmask_right0;
       unsigned mask1 = ~skipmask_left1 & ~skipmask_right1;
 
+      /* A chunk never straddles two tiles */
+      if (other_thread_tile(setup, x, setup->span.y))
+         continue;
+
       if (mask0 | mask1) {
          do {
             unsigned quadmask = (mask0 & 3) | ((mask1 & 3) << 2);
@@ -810,6 +838,11 @@ sp_setup_tri(struct setup_context *setup,
 
    if (setup->softpipe->no_rast || setup->softpipe->rasterizer->rasterizer_discard)
       return;
+
+   if (setup->softpipe->bin) {
+      sp_bin_tri(setup->softpipe->bin, v0, v1, v2);
+      return;
+   }
    
    det = calc_det(v0, v1, v2);
    /*
@@ -862,7 +895,7 @@ sp_setup_tri(struct setup_context *setup,
 
    flush_spans( setup );
 
-   if (setup->softpipe->active_statistics_queries) {
+   if (setup->softpipe->active_statistics_queries && setup->count_prims) {
       setup->softpipe->pipeline_statistics.c_primitives++;
    }
 
@@ -1099,6 +1132,11 @@ sp_setup_line(struct setup_context *setup,
    if (dx == 0 && dy == 0)
       return;
 
+   if (setup->softpipe->bin) {
+      sp_bin_line(setup->softpipe->bin, v0, v1);
+      return;
+   }
+
    if (!setup_line_coefficients(setup, v0, v1))
       return;
 
@@ -1243,6 +1281,11 @@ sp_setup_point(struct setup_context *setup,
    if (setup->softpipe->no_rast || setup->softpipe->rasterizer->rasterizer_discard)
       return;
 
+   if (setup->softpipe->bin) {
+      sp_bin_point(setup->softpipe->bin, v0);
+      return;
+   }
+
    assert(setup->softpipe->reduced_prim == PIPE_PRIM_POINTS);
 
    if (setup->softpipe->layer_slot > 0) {
@@ -1492,6 +1535,29 @@ sp_setup_prepare(struct setup_context *setup)
 }
 
 
+/**
+ * Make the setup emit only the quads of the framebuffer tiles of one of
+ * count rasterizer threads (see tile_cache_split).
+ */
+void
+sp_setup_set_split(struct setup_context *setup, unsigned index, unsigned count)
+{
+   setup->split_index = index;
+   setup->split_count = count;
+}
+
+
+/**
+ * Whether the following triangles are counted for the statistics queries,
+ * so that each triangle binned to several threads is counted once.
+ */
+void
+sp_setup_count_prims(struct setup_context *setup, boolean count)
+{
+   setup->count_prims = count;
+}
+
+
 void
 sp_setup_destroy_context(struct setup_context *setup)
 {
@@ -1509,6 +1575,7 @@ sp_setup_create_context(struct softpipe_context *softpipe)
    unsigned i;
 
    setup->softpipe = softpipe;
+   setup->count_prims = TRUE;
 
    for (i = 0; i < MAX_QUADS; i++) {
       setup->quad[i].coef = setup->coef;
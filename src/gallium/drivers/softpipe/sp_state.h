@@ -87,9 +87,14 @@ struct sp_fragment_shader_variant
 		   struct tgsi_image *image,
 		   struct tgsi_buffer *buffer);
 
+   /**
+    * Shade up to TGSI_EXEC_NUM_QUADS quads of a primitive at once.
+    * \return bitmask of the quads which still have live fragments
+    */
    unsigned (*run)(const struct sp_fragment_shader_variant *shader,
 		   struct tgsi_exec_machine *machine,
-		   struct quad_header *quad,
+		   struct quad_header *quads[],
+		   unsigned nr,
 		   bool early_depth_test);
 
    /* Deletes this instance of the object */
@@ -226,4 +231,7 @@ softpipe_launch_grid(struct pipe_context *context,
 
 void
 softpipe_update_compute_samplers(struct softpipe_context *softpipe);
+
+void
+softpipe_destroy_compute_threads(struct softpipe_context *softpipe);
 #endif
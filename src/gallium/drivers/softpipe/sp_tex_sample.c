@@ -41,6 +41,7 @@
 #include "util/u_format.h"
 #include "util/u_memory.h"
 #include "util/u_inlines.h"
+#include "util/u_sse.h"
 #include "sp_quad.h"   /* only for #define QUAD_* tokens */
 #include "sp_tex_sample.h"
 #include "sp_texture.h"
@@ -1268,6 +1269,387 @@ img_filter_2d_nearest_clamp_POT(const struct sp_sampler_view *sp_sview,
 }
 
 
+/*
+ * Direct fetch fastpaths.
+ *
+ * Small 2D textures in the 8-bit RGBA formats are sampled straight from
+ * the texture memory, which avoids filling the tile cache with float
+ * texels, and the four texels of the bilinear filter are converted and
+ * interpolated as vectors.  The results are the same as with the tile
+ * cache, which converts with the same ubyte_to_float() expression.
+ */
+
+/**
+ * Textures of up to this size, about what fits in the L2 cache, are
+ * sampled directly.  Bigger ones are better served by the tiles.
+ */
+#define SP_DIRECT_FETCH_MAX_SIZE (256 * 1024)
+
+enum sp_direct_format
+{
+   SP_DIRECT_RGBA8,
+   SP_DIRECT_BGRA8,
+   SP_DIRECT_RGBX8,
+   SP_DIRECT_BGRX8,
+};
+
+#if defined(PIPE_ARCH_SSE)
+typedef __m128 direct_texel;
+#else
+typedef struct { float c[TGSI_NUM_CHANNELS]; } direct_texel;
+#endif
+
+
+static inline direct_texel
+direct_fetch(const uint8_t *texel, enum sp_direct_format format)
+{
+   const bool bgr = format == SP_DIRECT_BGRA8 || format == SP_DIRECT_BGRX8;
+   const bool opaque = format == SP_DIRECT_RGBX8 || format == SP_DIRECT_BGRX8;
+#if defined(PIPE_ARCH_SSE)
+   const __m128i zero = _mm_setzero_si128();
+   __m128i t = _mm_cvtsi32_si128(*(const int32_t *) texel);
+   __m128 v;
+
+   t = _mm_unpacklo_epi16(_mm_unpacklo_epi8(t, zero), zero);
+   v = _mm_mul_ps(_mm_cvtepi32_ps(t), _mm_set1_ps(1.0f / 255.0f));
+   if (bgr)
+      v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+   if (opaque)
+      v = _mm_or_ps(_mm_and_ps(v, _mm_castsi128_ps(_mm_set_epi32(0, ~0, ~0, ~0))),
+                    _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f));
+   return v;
+#else
+   direct_texel v;
+
+   v.c[0] = ubyte_to_float(texel[bgr ? 2 : 0]);
+   v.c[1] = ubyte_to_float(texel[1]);
+   v.c[2] = ubyte_to_float(texel[bgr ? 0 : 2]);
+   v.c[3] = opaque ? 1.0f : ubyte_to_float(texel[3]);
+   return v;
+#endif
+}
+
+
+static inline direct_texel
+direct_border(const struct sp_sampler *sp_samp)
+{
+#if defined(PIPE_ARCH_SSE)
+   return _mm_loadu_ps(sp_samp->base.border_color.f);
+#else
+   direct_texel v;
+
+   memcpy(v.c, sp_samp->base.border_color.f, sizeof v.c);
+   return v;
+#endif
+}
+
+
+static inline direct_texel
+direct_lerp_2d(float a, float b,
+               direct_texel v00, direct_texel v10,
+               direct_texel v01, direct_texel v11)
+{
+#if defined(PIPE_ARCH_SSE)
+   const __m128 va = _mm_set1_ps(a);
+   const __m128 temp0 = _mm_add_ps(v00, _mm_mul_ps(va, _mm_sub_ps(v10, v00)));
+   const __m128 temp1 = _mm_add_ps(v01, _mm_mul_ps(va, _mm_sub_ps(v11, v01)));
+
+   return _mm_add_ps(temp0, _mm_mul_ps(_mm_set1_ps(b),
+                                       _mm_sub_ps(temp1, temp0)));
+#else
+   direct_texel v;
+   int c;
+
+   for (c = 0; c < TGSI_NUM_CHANNELS; c++)
+      v.c[c] = lerp_2d(a, b, v00.c[c], v10.c[c], v01.c[c], v11.c[c]);
+   return v;
+#endif
+}
+
+
+static inline void
+direct_store(direct_texel v, float *rgba)
+{
+#if defined(PIPE_ARCH_SSE)
+   float c[TGSI_NUM_CHANNELS];
+
+   _mm_storeu_ps(c, v);
+#else
+   const float *c = v.c;
+#endif
+   rgba[0] = c[0];
+   rgba[TGSI_NUM_CHANNELS] = c[1];
+   rgba[2*TGSI_NUM_CHANNELS] = c[2];
+   rgba[3*TGSI_NUM_CHANNELS] = c[3];
+}
+
+
+/**
+ * Return the first texel of a level of the view, and the row stride.
+ */
+static inline const uint8_t *
+direct_level(const struct sp_sampler_view *sp_sview, unsigned level,
+             unsigned *stride)
+{
+   const struct softpipe_resource *spr =
+      softpipe_resource(sp_sview->base.texture);
+
+   *stride = spr->stride[level];
+   return (const uint8_t *) spr->data + spr->level_offset[level] +
+          sp_sview->base.u.tex.first_layer * spr->img_stride[level];
+}
+
+
+static inline direct_texel
+direct_fetch_2d(const struct sp_sampler *sp_samp,
+                const uint8_t *data, unsigned stride,
+                int width, int height, int x, int y,
+                enum sp_direct_format format)
+{
+   if (x < 0 || x >= width || y < 0 || y >= height)
+      return direct_border(sp_samp);
+   else
+      return direct_fetch(data + y * stride + x * 4, format);
+}
+
+
+static inline void
+img_filter_2d_linear_repeat_POT_direct(const struct sp_sampler_view *sp_sview,
+                                       const struct img_filter_args *args,
+                                       enum sp_direct_format format,
+                                       float *rgba)
+{
+   const unsigned xpot = pot_level_size(sp_sview->xpot, args->level);
+   const unsigned ypot = pot_level_size(sp_sview->ypot, args->level);
+   unsigned stride;
+   const uint8_t *data = direct_level(sp_sview, args->level, &stride);
+
+   const float u = (args->s * xpot - 0.5F) + args->offset[0];
+   const float v = (args->t * ypot - 0.5F) + args->offset[1];
+
+   const int uflr = util_ifloor(u);
+   const int vflr = util_ifloor(v);
+
+   const float xw = u - (float)uflr;
+   const float yw = v - (float)vflr;
+
+   const int x0 = uflr & (xpot - 1);
+   const int y0 = vflr & (ypot - 1);
+   const int x1 = (x0 + 1) & (xpot - 1);
+   const int y1 = (y0 + 1) & (ypot - 1);
+
+   const uint8_t *row0 = data + y0 * stride;
+   const uint8_t *row1 = data + y1 * stride;
+
+   direct_store(direct_lerp_2d(xw, yw,
+                               direct_fetch(row0 + x0 * 4, format),
+                               direct_fetch(row0 + x1 * 4, format),
+                               direct_fetch(row1 + x0 * 4, format),
+                               direct_fetch(row1 + x1 * 4, format)),
+                rgba);
+}
+
+
+static inline void
+img_filter_2d_nearest_repeat_POT_direct(const struct sp_sampler_view *sp_sview,
+                                        const struct img_filter_args *args,
+                                        enum sp_direct_format format,
+                                        float *rgba)
+{
+   const unsigned xpot = pot_level_size(sp_sview->xpot, args->level);
+   const unsigned ypot = pot_level_size(sp_sview->ypot, args->level);
+   unsigned stride;
+   const uint8_t *data = direct_level(sp_sview, args->level, &stride);
+
+   const float u = args->s * xpot + args->offset[0];
+   const float v = args->t * ypot + args->offset[1];
+
+   const int x0 = util_ifloor(u) & (xpot - 1);
+   const int y0 = util_ifloor(v) & (ypot - 1);
+
+   direct_store(direct_fetch(data + y0 * stride + x0 * 4, format), rgba);
+}
+
+
+static inline void
+img_filter_2d_nearest_clamp_POT_direct(const struct sp_sampler_view *sp_sview,
+                                       const struct img_filter_args *args,
+                                       enum sp_direct_format format,
+                                       float *rgba)
+{
+   const unsigned xpot = pot_level_size(sp_sview->xpot, args->level);
+   const unsigned ypot = pot_level_size(sp_sview->ypot, args->level);
+   unsigned stride;
+   const uint8_t *data = direct_level(sp_sview, args->level, &stride);
+
+   const float u = args->s * xpot + args->offset[0];
+   const float v = args->t * ypot + args->offset[1];
+
+   const int x0 = CLAMP(util_ifloor(u), 0, (int) xpot - 1);
+   const int y0 = CLAMP(util_ifloor(v), 0, (int) ypot - 1);
+
+   direct_store(direct_fetch(data + y0 * stride + x0 * 4, format), rgba);
+}
+
+
+static inline void
+img_filter_2d_linear_direct(const struct sp_sampler_view *sp_sview,
+                            const struct sp_sampler *sp_samp,
+                            const struct img_filter_args *args,
+                            enum sp_direct_format format,
+                            float *rgba)
+{
+   const struct pipe_resource *texture = sp_sview->base.texture;
+   const int width = u_minify(texture->width0, args->level);
+   const int height = u_minify(texture->height0, args->level);
+   unsigned stride;
+   const uint8_t *data = direct_level(sp_sview, args->level, &stride);
+   int x0, y0, x1, y1;
+   float xw, yw; /* weights */
+
+   sp_samp->linear_texcoord_s(args->s, width,  args->offset[0], &x0, &x1, &xw);
+   sp_samp->linear_texcoord_t(args->t, height, args->offset[1], &y0, &y1, &yw);
+
+   direct_store(direct_lerp_2d(xw, yw,
+                               direct_fetch_2d(sp_samp, data, stride,
+                                               width, height, x0, y0, format),
+                               direct_fetch_2d(sp_samp, data, stride,
+                                               width, height, x1, y0, format),
+                               direct_fetch_2d(sp_samp, data, stride,
+                                               width, height, x0, y1, format),
+                               direct_fetch_2d(sp_samp, data, stride,
+                                               width, height, x1, y1, format)),
+                rgba);
+}
+
+
+static inline void
+img_filter_2d_nearest_direct(const struct sp_sampler_view *sp_sview,
+                             const struct sp_sampler *sp_samp,
+                             const struct img_filter_args *args,
+                             enum sp_direct_format format,
+                             float *rgba)
+{
+   const struct pipe_resource *texture = sp_sview->base.texture;
+   const int width = u_minify(texture->width0, args->level);
+   const int height = u_minify(texture->height0, args->level);
+   unsigned stride;
+   const uint8_t *data = direct_level(sp_sview, args->level, &stride);
+   int x, y;
+
+   sp_samp->nearest_texcoord_s(args->s, width, args->offset[0], &x);
+   sp_samp->nearest_texcoord_t(args->t, height, args->offset[1], &y);
+
+   direct_store(direct_fetch_2d(sp_samp, data, stride,
+                                width, height, x, y, format),
+                rgba);
+}
+
+
+/* Instantiate the direct filters for a format, with the format as a
+ * constant so that its handling folds away.
+ */
+#define DIRECT_FILTERS(fmt, FORMAT)                                       \
+static void                                                               \
+img_filter_2d_linear_repeat_POT_##fmt(const struct sp_sampler_view *sp_sview, \
+                                      const struct sp_sampler *sp_samp,   \
+                                      const struct img_filter_args *args, \
+                                      float *rgba)                        \
+{                                                                         \
+   img_filter_2d_linear_repeat_POT_direct(sp_sview, args, FORMAT, rgba);  \
+}                                                                         \
+                                                                          \
+static void                                                               \
+img_filter_2d_nearest_repeat_POT_##fmt(const struct sp_sampler_view *sp_sview, \
+                                       const struct sp_sampler *sp_samp,  \
+                                       const struct img_filter_args *args, \
+                                       float *rgba)                       \
+{                                                                         \
+   img_filter_2d_nearest_repeat_POT_direct(sp_sview, args, FORMAT, rgba); \
+}                                                                         \
+                                                                          \
+static void                                                               \
+img_filter_2d_nearest_clamp_POT_##fmt(const struct sp_sampler_view *sp_sview, \
+                                      const struct sp_sampler *sp_samp,   \
+                                      const struct img_filter_args *args, \
+                                      float *rgba)                        \
+{                                                                         \
+   img_filter_2d_nearest_clamp_POT_direct(sp_sview, args, FORMAT, rgba);  \
+}                                                                         \
+                                                                          \
+static void                                                               \
+img_filter_2d_linear_##fmt(const struct sp_sampler_view *sp_sview,        \
+                           const struct sp_sampler *sp_samp,              \
+                           const struct img_filter_args *args,            \
+                           float *rgba)                                   \
+{                                                                         \
+   img_filter_2d_linear_direct(sp_sview, sp_samp, args, FORMAT, rgba);    \
+}                                                                         \
+                                                                          \
+static void                                                               \
+img_filter_2d_nearest_##fmt(const struct sp_sampler_view *sp_sview,       \
+                            const struct sp_sampler *sp_samp,             \
+                            const struct img_filter_args *args,           \
+                            float *rgba)                                  \
+{                                                                         \
+   img_filter_2d_nearest_direct(sp_sview, sp_samp, args, FORMAT, rgba);   \
+}                                                                         \
+                                                                          \
+static const struct sp_direct_filters direct_filters_##fmt = {           \
+   img_filter_2d_linear_repeat_POT_##fmt,                                 \
+   img_filter_2d_nearest_repeat_POT_##fmt,                                \
+   img_filter_2d_nearest_clamp_POT_##fmt,                                 \
+   img_filter_2d_linear_##fmt,                                            \
+   img_filter_2d_nearest_##fmt                                            \
+};
+
+DIRECT_FILTERS(rgba8, SP_DIRECT_RGBA8)
+DIRECT_FILTERS(bgra8, SP_DIRECT_BGRA8)
+DIRECT_FILTERS(rgbx8, SP_DIRECT_RGBX8)
+DIRECT_FILTERS(bgrx8, SP_DIRECT_BGRX8)
+
+#undef DIRECT_FILTERS
+
+
+/**
+ * Return the direct filters for a sampler view, or NULL if it has to be
+ * sampled through the tile cache.
+ */
+static const struct sp_direct_filters *
+get_direct_filters(const struct pipe_sampler_view *view)
+{
+   const struct softpipe_resource *spr = softpipe_resource(view->texture);
+   unsigned size = 0;
+   unsigned level;
+
+   if (view->target != PIPE_TEXTURE_2D && view->target != PIPE_TEXTURE_RECT)
+      return NULL;
+
+   /* display targets are only mapped for the transfers */
+   if (spr->dt || !spr->data)
+      return NULL;
+
+   for (level = view->u.tex.first_level; level <= view->u.tex.last_level;
+        level++)
+      size += spr->img_stride[level];
+   if (size > SP_DIRECT_FETCH_MAX_SIZE)
+      return NULL;
+
+   switch (view->format) {
+   case PIPE_FORMAT_R8G8B8A8_UNORM:
+      return &direct_filters_rgba8;
+   case PIPE_FORMAT_B8G8R8A8_UNORM:
+      return &direct_filters_bgra8;
+   case PIPE_FORMAT_R8G8B8X8_UNORM:
+      return &direct_filters_rgbx8;
+   case PIPE_FORMAT_B8G8R8X8_UNORM:
+      return &direct_filters_bgrx8;
+   default:
+      return NULL;
+   }
+}
+
+
 static void
 img_filter_1d_nearest(const struct sp_sampler_view *sp_sview,
                       const struct sp_sampler *sp_samp,
@@ -2667,14 +3049,13 @@ mip_rel_level_linear_2d_linear_repeat_POT(
 
 /**
  * Specialized version of mip_filter_linear with hard-wired calls to
- * 2d lambda calculation and 2d_linear_repeat_POT img filters.
+ * 2d lambda calculation and the given 2d_linear_repeat_POT img filter.
  */
-static void
-mip_filter_linear_2d_linear_repeat_POT(
+static inline void
+mip_filter_linear_2d_linear_repeat_POT_filter(
    const struct sp_sampler_view *sp_sview,
    const struct sp_sampler *sp_samp,
-   img_filter_func min_filter,
-   img_filter_func mag_filter,
+   img_filter_func img_filter,
    const float s[TGSI_QUAD_SIZE],
    const float t[TGSI_QUAD_SIZE],
    const float p[TGSI_QUAD_SIZE],
@@ -2703,8 +3084,7 @@ mip_filter_linear_2d_linear_repeat_POT(
             args.level = psview->u.tex.first_level;
          else
             args.level = psview->u.tex.last_level;
-         img_filter_2d_linear_repeat_POT(sp_sview, sp_samp, &args,
-                                         &rgba[0][j]);
+         img_filter(sp_sview, sp_samp, &args, &rgba[0][j]);
 
       }
       else {
@@ -2713,9 +3093,9 @@ mip_filter_linear_2d_linear_repeat_POT(
          int c;
 
          args.level = level0;
-         img_filter_2d_linear_repeat_POT(sp_sview, sp_samp, &args, &rgbax[0][0]);
+         img_filter(sp_sview, sp_samp, &args, &rgbax[0][0]);
          args.level = level0+1;
-         img_filter_2d_linear_repeat_POT(sp_sview, sp_samp, &args, &rgbax[0][1]);
+         img_filter(sp_sview, sp_samp, &args, &rgbax[0][1]);
 
          for (c = 0; c < TGSI_NUM_CHANNELS; c++)
             rgba[c][j] = lerp(levelBlend, rgbax[c][0], rgbax[c][1]);
@@ -2727,6 +3107,46 @@ mip_filter_linear_2d_linear_repeat_POT(
    }
 }
 
+static void
+mip_filter_linear_2d_linear_repeat_POT(
+   const struct sp_sampler_view *sp_sview,
+   const struct sp_sampler *sp_samp,
+   img_filter_func min_filter,
+   img_filter_func mag_filter,
+   const float s[TGSI_QUAD_SIZE],
+   const float t[TGSI_QUAD_SIZE],
+   const float p[TGSI_QUAD_SIZE],
+   int gather_comp,
+   const float lod[TGSI_QUAD_SIZE],
+   const struct filter_args *filt_args,
+   float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE])
+{
+   mip_filter_linear_2d_linear_repeat_POT_filter(sp_sview, sp_samp,
+                                                 img_filter_2d_linear_repeat_POT,
+                                                 s, t, p, gather_comp, lod,
+                                                 filt_args, rgba);
+}
+
+static void
+mip_filter_linear_2d_linear_repeat_POT_direct(
+   const struct sp_sampler_view *sp_sview,
+   const struct sp_sampler *sp_samp,
+   img_filter_func min_filter,
+   img_filter_func mag_filter,
+   const float s[TGSI_QUAD_SIZE],
+   const float t[TGSI_QUAD_SIZE],
+   const float p[TGSI_QUAD_SIZE],
+   int gather_comp,
+   const float lod[TGSI_QUAD_SIZE],
+   const struct filter_args *filt_args,
+   float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE])
+{
+   mip_filter_linear_2d_linear_repeat_POT_filter(sp_sview, sp_samp,
+                                                 sp_sview->direct->linear_repeat_POT,
+                                                 s, t, p, gather_comp, lod,
+                                                 filt_args, rgba);
+}
+
 static const struct sp_filter_funcs funcs_linear = {
    mip_rel_level_linear,
    mip_filter_linear
@@ -2757,6 +3177,11 @@ static const struct sp_filter_funcs funcs_linear_2d_linear_repeat_POT = {
    mip_filter_linear_2d_linear_repeat_POT
 };
 
+static const struct sp_filter_funcs funcs_linear_2d_linear_repeat_POT_direct = {
+   mip_rel_level_linear_2d_linear_repeat_POT,
+   mip_filter_linear_2d_linear_repeat_POT_direct
+};
+
 /**
  * Do shadow/depth comparisons.
  */
@@ -3070,6 +3495,10 @@ get_img_filter(const struct sp_sampler_view *sp_sview,
       break;
    case PIPE_TEXTURE_2D:
    case PIPE_TEXTURE_RECT:
+   {
+      /* Textures read directly from memory have their own versions */
+      const struct sp_direct_filters *direct = gather ? NULL : sp_sview->direct;
+
       /* Try for fast path:
        */
       if (!gather && sp_sview->pot2d &&
@@ -3080,9 +3509,11 @@ get_img_filter(const struct sp_sampler_view *sp_sview,
          case PIPE_TEX_WRAP_REPEAT:
             switch (filter) {
             case PIPE_TEX_FILTER_NEAREST:
-               return img_filter_2d_nearest_repeat_POT;
+               return direct ? direct->nearest_repeat_POT :
+                               img_filter_2d_nearest_repeat_POT;
             case PIPE_TEX_FILTER_LINEAR:
-               return img_filter_2d_linear_repeat_POT;
+               return direct ? direct->linear_repeat_POT :
+                               img_filter_2d_linear_repeat_POT;
             default:
                break;
             }
@@ -3090,7 +3521,8 @@ get_img_filter(const struct sp_sampler_view *sp_sview,
          case PIPE_TEX_WRAP_CLAMP:
             switch (filter) {
             case PIPE_TEX_FILTER_NEAREST:
-               return img_filter_2d_nearest_clamp_POT;
+               return direct ? direct->nearest_clamp_POT :
+                               img_filter_2d_nearest_clamp_POT;
             default:
                break;
             }
@@ -3099,10 +3531,11 @@ get_img_filter(const struct sp_sampler_view *sp_sview,
       /* Otherwise use default versions:
        */
       if (filter == PIPE_TEX_FILTER_NEAREST) 
-         return img_filter_2d_nearest;
+         return direct ? direct->nearest : img_filter_2d_nearest;
       else
-         return img_filter_2d_linear;
+         return direct ? direct->linear : img_filter_2d_linear;
       break;
+   }
    case PIPE_TEXTURE_2D_ARRAY:
       if (filter == PIPE_TEX_FILTER_NEAREST) 
          return img_filter_2d_array_nearest;
@@ -3154,7 +3587,8 @@ get_filters(const struct sp_sampler_view *sp_sview,
                                PIPE_TEX_FILTER_LINEAR, true);
       }
    } else if (sp_sview->pot2d & sp_samp->min_mag_equal_repeat_linear) {
-      *funcs = &funcs_linear_2d_linear_repeat_POT;
+      *funcs = sp_sview->direct ? &funcs_linear_2d_linear_repeat_POT_direct :
+                                  &funcs_linear_2d_linear_repeat_POT;
    } else {
       *funcs = sp_samp->filter_funcs;
       if (min) {
@@ -3633,6 +4067,8 @@ softpipe_create_sampler_view(struct pipe_context *pipe,
 
       sview->xpot = util_logbase2( resource->width0 );
       sview->ypot = util_logbase2( resource->height0 );
+
+      sview->direct = get_direct_filters(view);
    }
 
    return (struct pipe_sampler_view *) sview;
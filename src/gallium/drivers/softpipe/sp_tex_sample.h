@@ -104,6 +104,20 @@ typedef void (*fetch_func)(struct sp_sampler_view *sp_sview,
                            float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE]);
 
 
+/**
+ * Image filters of the textures that are sampled straight from memory
+ * rather than through the tile cache, for one texel format.
+ */
+struct sp_direct_filters
+{
+   img_filter_func linear_repeat_POT;
+   img_filter_func nearest_repeat_POT;
+   img_filter_func nearest_clamp_POT;
+   img_filter_func linear;
+   img_filter_func nearest;
+};
+
+
 struct sp_sampler_view
 {
    struct pipe_sampler_view base;
@@ -117,6 +131,9 @@ struct sp_sampler_view
    boolean pot2d;
    boolean need_cube_convert;
 
+   /* Small 2D unorm8 textures are sampled with these, or NULL */
+   const struct sp_direct_filters *direct;
+
    /* these are different per shader type */
    struct softpipe_tex_tile_cache *cache;
    compute_lambda_func compute_lambda;
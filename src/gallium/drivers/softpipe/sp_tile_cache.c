@@ -42,16 +42,6 @@ static struct softpipe_cached_tile *
 sp_alloc_tile(struct softpipe_tile_cache *tc);
 
 
-/**
- * Return the position in the cache for the tile that contains win pos (x,y).
- * We currently use a direct mapped cache so this is like a hack key.
- * At some point we should investige something more sophisticated, like
- * a LRU replacement policy.
- */
-#define CACHE_POS(x, y, l)                        \
-   (((x) + (y) * 5 + (l) * 10) % NUM_ENTRIES)
-
-
 static inline int addr_to_clear_pos(union tile_address addr)
 {
    int pos;
@@ -359,6 +349,11 @@ sp_tile_cache_flush_clear(struct softpipe_tile_cache *tc, int layer)
       for (x = 0; x < w; x += TILE_SIZE) {
          union tile_address addr = tile_address(x, y, layer);
 
+         /* the tiles of the other caches are cleared by those */
+         if (tc->split_count > 1 &&
+             tile_cache_split(x, y, layer, tc->split_count) != tc->split_index)
+            continue;
+
          if (is_clear_flag_set(tc->clear_flags, addr, tc->clear_flags_size)) {
             /* write the scratch tile to the surface */
             if (tc->depth_stencil) {
@@ -516,10 +511,14 @@ sp_find_cached_tile(struct softpipe_tile_cache *tc,
 {
    struct pipe_transfer *pt;
    /* cache pos/entry: */
-   const int pos = CACHE_POS(addr.bits.x,
-                             addr.bits.y, addr.bits.layer);
+   const int pos = tile_cache_pos(addr.bits.x,
+                                  addr.bits.y, addr.bits.layer);
    struct softpipe_cached_tile *tile = tc->entries[pos];
    int layer;
+
+   assert(tc->split_count <= 1 ||
+          pos % tc->split_count == tc->split_index);
+
    if (!tile) {
       tile = sp_alloc_tile(tc);
       tc->entries[pos] = tile;
@@ -97,6 +97,13 @@ struct softpipe_tile_cache
 
    struct softpipe_cached_tile *tile;  /**< scratch tile for clears */
 
+   /**
+    * When the tiles of the surface are split between several caches, the
+    * index of this cache and the number of caches (see tile_cache_split).
+    * The cache only ever holds and clears its own tiles.
+    */
+   unsigned split_index, split_count;
+
    union tile_address last_tile_addr;
    struct softpipe_cached_tile *last_tile;  /**< most recently retrieved tile */
 };
@@ -141,6 +148,31 @@ tile_address( unsigned x,
    return addr;
 }
 
+/**
+ * Return the position in the cache for the tile at (x,y), in tiles.
+ * We currently use a direct mapped cache so this is like a hack key.
+ * At some point we should investige something more sophisticated, like
+ * a LRU replacement policy.
+ */
+static inline unsigned
+tile_cache_pos(unsigned x, unsigned y, unsigned layer)
+{
+   return (x + y * 5 + layer * 10) % NUM_ENTRIES;
+}
+
+/**
+ * Return which of count caches holds the tile containing pixel (x,y), when
+ * the tiles of a surface are split between several caches.
+ * The tiles are split by position in the cache, so the tiles which evict
+ * each other in a single cache evict each other in the same order in one
+ * of the split caches.
+ */
+static inline unsigned
+tile_cache_split(unsigned x, unsigned y, unsigned layer, unsigned count)
+{
+   return tile_cache_pos(x / TILE_SIZE, y / TILE_SIZE, layer) % count;
+}
+
 /* Quickly retrieve tile if it matches last lookup.
  */
 static inline struct softpipe_cached_tile *
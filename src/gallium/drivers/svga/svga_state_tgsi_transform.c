@@ -131,6 +131,7 @@ emulate_point_sprite(struct svga_context *svga,
          tgsi_dump(new_tokens, 0);
       }
 
+      templ.type = PIPE_SHADER_IR_TGSI;
       templ.tokens = new_tokens;
       templ.stream_output.num_outputs = 0;
 
@@ -0,0 +1,365 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Microbenchmark of the draw module clipper.
+ *
+ * Draws lists of triangles whose clip space positions are passed through
+ * a trivial vertex shader to a null backend, with a varying number of
+ * vertices behind the near plane and of attributes to interpolate, and
+ * prints the triangle throughput of each workload.
+ *
+ * Usage: draw_clip_bench [seconds per workload] [vertex buffer bytes]
+ *
+ * The vertex buffer defaults to 64 KiB; llvmpipe and softpipe use 4 KiB.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "tgsi/tgsi_text.h"
+#include "util/os_time.h"
+#include "util/u_memory.h"
+#include "util/u_inlines.h"
+#include "draw/draw_context.h"
+#include "draw/draw_vbuf.h"
+#include "draw/draw_vertex.h"
+
+
+#define NUM_TRIS        4096
+#define MAX_GENERICS    8
+
+
+/*
+ * The draw module only queries a few caps of the screen of its context.
+ */
+static int
+null_get_param(struct pipe_screen *screen, enum pipe_cap param)
+{
+   return 0;
+}
+
+
+struct null_render {
+   struct vbuf_render base;
+   struct vertex_info vinfo;
+   void *vertices;
+   unsigned vertices_size;
+   uint64_t num_indices;
+};
+
+
+static struct null_render *
+null_render(struct vbuf_render *vbr)
+{
+   return (struct null_render *) vbr;
+}
+
+static const struct vertex_info *
+null_get_vertex_info(struct vbuf_render *vbr)
+{
+   return &null_render(vbr)->vinfo;
+}
+
+static boolean
+null_allocate_vertices(struct vbuf_render *vbr,
+                       ushort vertex_size, ushort nr_vertices)
+{
+   struct null_render *nr = null_render(vbr);
+   unsigned size = vertex_size * nr_vertices;
+
+   if (nr->vertices_size < size) {
+      FREE(nr->vertices);
+      nr->vertices = MALLOC(size);
+      nr->vertices_size = nr->vertices ? size : 0;
+   }
+   return nr->vertices != NULL;
+}
+
+static void *
+null_map_vertices(struct vbuf_render *vbr)
+{
+   return null_render(vbr)->vertices;
+}
+
+static void
+null_unmap_vertices(struct vbuf_render *vbr, ushort min_index,
+                    ushort max_index)
+{
+}
+
+static void
+null_set_primitive(struct vbuf_render *vbr, enum pipe_prim_type prim)
+{
+}
+
+static void
+null_draw_elements(struct vbuf_render *vbr, const ushort *indices,
+                   uint nr_indices)
+{
+   null_render(vbr)->num_indices += nr_indices;
+}
+
+static void
+null_draw_arrays(struct vbuf_render *vbr, unsigned start, uint nr)
+{
+   null_render(vbr)->num_indices += nr;
+}
+
+static void
+null_release_vertices(struct vbuf_render *vbr)
+{
+}
+
+static void
+null_destroy(struct vbuf_render *vbr)
+{
+}
+
+static void
+null_set_stream_output_info(struct vbuf_render *vbr, unsigned stream,
+                            unsigned primitive_count,
+                            unsigned primitive_generated)
+{
+}
+
+static void
+null_pipeline_statistics(struct vbuf_render *vbr,
+                         const struct pipe_query_data_pipeline_statistics *stats)
+{
+}
+
+
+/**
+ * Vertex shader passing the position and the generic attributes through.
+ */
+static void *
+create_vs(struct draw_context *draw, unsigned num_generics)
+{
+   struct tgsi_token tokens[1024];
+   struct pipe_shader_state state;
+   char text[2048];
+   unsigned len, i;
+
+   len = sprintf(text, "VERT\nDCL IN[0]\nDCL OUT[0], POSITION\n");
+   for (i = 0; i < num_generics; i++)
+      len += sprintf(text + len, "DCL IN[%u]\nDCL OUT[%u], GENERIC[%u]\n",
+                     i + 1, i + 1, i);
+   for (i = 0; i <= num_generics; i++)
+      len += sprintf(text + len, "MOV OUT[%u], IN[%u]\n", i, i);
+   sprintf(text + len, "END\n");
+
+   if (!tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens)))
+      return NULL;
+
+   memset(&state, 0, sizeof state);
+   state.type = PIPE_SHADER_IR_TGSI;
+   state.tokens = tokens;
+   return draw_create_vertex_shader(draw, &state);
+}
+
+
+/**
+ * Fill in triangles in clip space, of which num_behind vertices are
+ * behind the near plane.
+ */
+static void
+fill_vertices(float (*verts)[4], unsigned num_attribs, unsigned num_behind)
+{
+   unsigned i, j, k;
+
+   srand(0);
+   for (i = 0; i < NUM_TRIS * 3; i++) {
+      float *pos = verts[i * num_attribs];
+      const float w = 1.0f + (float) rand() / RAND_MAX;
+
+      pos[0] = ((float) rand() / RAND_MAX * 2.0f - 1.0f) * w;
+      pos[1] = ((float) rand() / RAND_MAX * 2.0f - 1.0f) * w;
+      pos[2] = (i % 3 < num_behind ? -2.0f : 0.5f) * w;
+      pos[3] = w;
+
+      for (j = 1; j < num_attribs; j++)
+         for (k = 0; k < 4; k++)
+            verts[i * num_attribs + j][k] = (float) rand() / RAND_MAX;
+   }
+}
+
+
+static void
+run(struct draw_context *draw, struct null_render *render,
+    unsigned num_generics, unsigned num_behind, double seconds)
+{
+   const unsigned num_attribs = 1 + num_generics;
+   const unsigned stride = num_attribs * 4 * sizeof(float);
+   struct pipe_vertex_element elements[1 + MAX_GENERICS];
+   struct pipe_vertex_buffer vb;
+   struct pipe_draw_info info;
+   float (*verts)[4];
+   void *vs;
+   int64_t start, end;
+   unsigned num_draws = 0;
+   unsigned i;
+
+   verts = MALLOC(NUM_TRIS * 3 * stride);
+   vs = create_vs(draw, num_generics);
+   if (!verts || !vs) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+   }
+
+   fill_vertices(verts, num_attribs, num_behind);
+
+   memset(elements, 0, sizeof elements);
+   for (i = 0; i < num_attribs; i++) {
+      elements[i].src_offset = i * 4 * sizeof(float);
+      elements[i].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   }
+
+   memset(&vb, 0, sizeof vb);
+   vb.stride = stride;
+   vb.is_user_buffer = true;
+   vb.buffer.user = verts;
+
+   draw_bind_vertex_shader(draw, vs);
+   draw_set_vertex_elements(draw, num_attribs, elements);
+   draw_set_vertex_buffers(draw, 0, 1, &vb);
+   draw_set_mapped_vertex_buffer(draw, 0, verts, NUM_TRIS * 3 * stride);
+
+   /* emit every vertex shader output as is */
+   memset(&render->vinfo, 0, sizeof render->vinfo);
+   draw_emit_vertex_attr(&render->vinfo, EMIT_4F,
+                         draw_find_shader_output(draw, TGSI_SEMANTIC_POSITION,
+                                                 0));
+   for (i = 0; i < num_generics; i++)
+      draw_emit_vertex_attr(&render->vinfo, EMIT_4F,
+                            draw_find_shader_output(draw,
+                                                    TGSI_SEMANTIC_GENERIC, i));
+   draw_compute_vertex_size(&render->vinfo);
+
+   memset(&info, 0, sizeof info);
+   info.mode = PIPE_PRIM_TRIANGLES;
+   info.count = NUM_TRIS * 3;
+   info.instance_count = 1;
+   info.max_index = ~0;
+
+   render->num_indices = 0;
+   start = os_time_get_nano();
+   do {
+      draw_vbo(draw, &info);
+      draw_flush(draw);
+      num_draws++;
+      end = os_time_get_nano();
+   } while (end - start < (int64_t) (seconds * 1e9));
+
+   printf("%u generics, %u of 3 vertices clipped: %8.3f Mtri/s, "
+          "%.2f vertices out per triangle\n",
+          num_generics, num_behind,
+          (double) num_draws * NUM_TRIS * 1e3 / (end - start),
+          (double) render->num_indices / ((double) num_draws * NUM_TRIS));
+
+   draw_bind_vertex_shader(draw, NULL);
+   draw_delete_vertex_shader(draw, vs);
+   FREE(verts);
+}
+
+
+int
+main(int argc, char **argv)
+{
+   static const unsigned generics[] = { 1, 4, MAX_GENERICS };
+   const double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+   const unsigned vbuf_size = argc > 2 ? atoi(argv[2]) : 64 * 1024;
+   struct pipe_rasterizer_state rast;
+   struct pipe_viewport_state viewport;
+   struct null_render render;
+   struct pipe_screen screen;
+   struct pipe_context pipe;
+   struct draw_context *draw;
+   struct draw_stage *stage;
+   unsigned i, num_behind;
+
+   memset(&render, 0, sizeof render);
+   render.base.max_indices = 1024;
+   render.base.max_vertex_buffer_bytes = vbuf_size;
+   render.base.get_vertex_info = null_get_vertex_info;
+   render.base.allocate_vertices = null_allocate_vertices;
+   render.base.map_vertices = null_map_vertices;
+   render.base.unmap_vertices = null_unmap_vertices;
+   render.base.set_primitive = null_set_primitive;
+   render.base.draw_elements = null_draw_elements;
+   render.base.draw_arrays = null_draw_arrays;
+   render.base.release_vertices = null_release_vertices;
+   render.base.destroy = null_destroy;
+   render.base.set_stream_output_info = null_set_stream_output_info;
+   render.base.pipeline_statistics = null_pipeline_statistics;
+
+   memset(&screen, 0, sizeof screen);
+   screen.get_param = null_get_param;
+   memset(&pipe, 0, sizeof pipe);
+   pipe.screen = &screen;
+
+   draw = draw_create(&pipe);
+   if (!draw) {
+      fprintf(stderr, "failed to create the draw context\n");
+      return 1;
+   }
+
+   stage = draw_vbuf_stage(draw, &render.base);
+   if (!stage) {
+      fprintf(stderr, "failed to create the vbuf stage\n");
+      return 1;
+   }
+   draw_set_rasterize_stage(draw, stage);
+   draw_set_render(draw, &render.base);
+
+   memset(&rast, 0, sizeof rast);
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   draw_set_rasterizer_state(draw, &rast, &rast);
+
+   viewport.scale[0] = 512.0f;
+   viewport.scale[1] = -512.0f;
+   viewport.scale[2] = 0.5f;
+   viewport.translate[0] = 512.0f;
+   viewport.translate[1] = 512.0f;
+   viewport.translate[2] = 0.5f;
+   draw_set_viewport_states(draw, 0, 1, &viewport);
+
+   for (i = 0; i < ARRAY_SIZE(generics); i++)
+      for (num_behind = 0; num_behind < 3; num_behind++)
+         run(draw, &render, generics[i], num_behind, seconds);
+
+   draw_destroy(draw);
+   FREE(render.vertices);
+
+   return 0;
+}
@@ -0,0 +1,231 @@
+/**************************************************************************
+ *
+ * Copyright 2019 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Microbenchmark of the TGSI interpreter.
+ *
+ * Runs a few straight-line shaders, which step through every one of their
+ * instructions on each run, on a tgsi_exec machine and prints how many
+ * instructions it executes per second.
+ *
+ * Usage: tgsi_exec_bench [seconds per shader]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pipe/p_shader_tokens.h"
+#include "tgsi/tgsi_exec.h"
+#include "tgsi/tgsi_text.h"
+#include "util/os_time.h"
+#include "util/u_memory.h"
+
+
+#define NUM_CONSTS   16
+
+
+struct shader {
+   const char *name;
+   const char *text;
+};
+
+
+static const struct shader shaders[] = {
+   {
+      "vertex transform and lighting",
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL IN[1]\n"
+      "DCL OUT[0], POSITION\n"
+      "DCL OUT[1], COLOR\n"
+      "DCL CONST[0..15]\n"
+      "DCL TEMP[0..3]\n"
+      "IMM[0] FLT32 {0.0, 1.0, 0.5, 16.0}\n"
+      "DP4 TEMP[0].x, IN[0], CONST[0]\n"
+      "DP4 TEMP[0].y, IN[0], CONST[1]\n"
+      "DP4 TEMP[0].z, IN[0], CONST[2]\n"
+      "DP4 TEMP[0].w, IN[0], CONST[3]\n"
+      "MOV OUT[0], TEMP[0]\n"
+      "DP3 TEMP[1].x, IN[1], CONST[4]\n"
+      "DP3 TEMP[1].y, IN[1], CONST[5]\n"
+      "DP3 TEMP[1].z, IN[1], CONST[6]\n"
+      "DP3 TEMP[2].x, TEMP[1], TEMP[1]\n"
+      "RSQ TEMP[2].x, TEMP[2].xxxx\n"
+      "MUL TEMP[1].xyz, TEMP[1], TEMP[2].xxxx\n"
+      "DP3 TEMP[2].x, TEMP[1], CONST[8]\n"
+      "MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+      "DP3 TEMP[2].y, TEMP[1], CONST[9]\n"
+      "MAX TEMP[2].y, TEMP[2].yyyy, IMM[0].xxxx\n"
+      "POW TEMP[2].y, TEMP[2].yyyy, IMM[0].wwww\n"
+      "MAD TEMP[3], CONST[10], TEMP[2].xxxx, CONST[11]\n"
+      "MAD_SAT OUT[1], CONST[12], TEMP[2].yyyy, TEMP[3]\n"
+      "END\n"
+   },
+   {
+      "fragment arithmetic",
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL IN[1]\n"
+      "DCL OUT[0], COLOR\n"
+      "DCL CONST[0..15]\n"
+      "DCL TEMP[0..3]\n"
+      "IMM[0] FLT32 {0.0, 1.0, 0.5, 2.0}\n"
+      "MAD TEMP[0], IN[0], IMM[0].wwww, -IMM[0].yyyy\n"
+      "DP3 TEMP[1].x, TEMP[0], TEMP[0]\n"
+      "RCP TEMP[1].y, TEMP[1].xxxx\n"
+      "MUL TEMP[0].xyz, TEMP[0], TEMP[1].yyyy\n"
+      "ADD TEMP[2], IN[1], -CONST[0]\n"
+      "MUL TEMP[2], TEMP[2], |TEMP[0].zxyw|\n"
+      "LRP TEMP[3], IN[1].wwww, TEMP[2], CONST[1]\n"
+      "FRC TEMP[1], TEMP[3]\n"
+      "FLR TEMP[2], TEMP[3]\n"
+      "CMP TEMP[3], -TEMP[1], TEMP[2], TEMP[1]\n"
+      "MIN TEMP[3], TEMP[3], CONST[2]\n"
+      "MAX TEMP[3], TEMP[3], -CONST[2]\n"
+      "SGE TEMP[1], TEMP[3], IMM[0].zzzz\n"
+      "MAD TEMP[3], TEMP[1], CONST[3], TEMP[3]\n"
+      "MUL_SAT OUT[0], TEMP[3], IN[0]\n"
+      "END\n"
+   },
+   {
+      "integer arithmetic",
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL OUT[0], GENERIC[0]\n"
+      "DCL TEMP[0..3]\n"
+      "IMM[0] UINT32 {1, 3, 255, 16}\n"
+      "F2U TEMP[0], IN[0]\n"
+      "UMAD TEMP[1], TEMP[0], IMM[0].yyyy, IMM[0].xxxx\n"
+      "USHR TEMP[2], TEMP[1], IMM[0].wwww\n"
+      "XOR TEMP[1], TEMP[1], TEMP[2]\n"
+      "AND TEMP[2], TEMP[1], IMM[0].zzzz\n"
+      "SHL TEMP[3], TEMP[2], IMM[0].xxxx\n"
+      "UADD TEMP[3], TEMP[3], TEMP[0].yzwx\n"
+      "UMIN TEMP[3], TEMP[3], IMM[0].zzzz\n"
+      "USLT TEMP[2], TEMP[3], TEMP[1]\n"
+      "OR TEMP[3], TEMP[3], TEMP[2]\n"
+      "U2F OUT[0], TEMP[3]\n"
+      "END\n"
+   },
+   {
+      "control flow",
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL OUT[0], GENERIC[0]\n"
+      "DCL TEMP[0..1]\n"
+      "IMM[0] FLT32 {0.0, 1.0, 0.5, 2.0}\n"
+      "SLT TEMP[0], IN[0], IMM[0].zzzz\n"
+      "MOV TEMP[1], IN[0]\n"
+      "IF TEMP[0].xxxx\n"
+      "  ADD TEMP[1].x, TEMP[1].xxxx, IMM[0].yyyy\n"
+      "  IF TEMP[0].yyyy\n"
+      "    MUL TEMP[1].y, TEMP[1].yyyy, IMM[0].wwww\n"
+      "  ELSE\n"
+      "    MUL TEMP[1].y, TEMP[1].yyyy, IMM[0].zzzz\n"
+      "  ENDIF\n"
+      "ELSE\n"
+      "  ADD TEMP[1].x, TEMP[1].xxxx, -IMM[0].yyyy\n"
+      "ENDIF\n"
+      "IF TEMP[0].zzzz\n"
+      "  MOV TEMP[1].z, IMM[0].xxxx\n"
+      "ENDIF\n"
+      "MOV OUT[0], TEMP[1]\n"
+      "END\n"
+   },
+};
+
+
+static void
+run(struct tgsi_exec_machine *mach, const struct shader *shader,
+    double seconds)
+{
+   struct tgsi_token tokens[1024];
+   int64_t start, end;
+   unsigned num_runs = 0;
+   unsigned i;
+
+   if (!tgsi_text_translate(shader->text, tokens, ARRAY_SIZE(tokens))) {
+      fprintf(stderr, "failed to translate the %s shader\n", shader->name);
+      exit(1);
+   }
+
+   tgsi_exec_machine_bind_shader(mach, tokens, NULL, NULL, NULL);
+
+   start = os_time_get_nano();
+   do {
+      for (i = 0; i < 256; i++) {
+         mach->NonHelperMask = TGSI_EXEC_MASK;
+         tgsi_exec_machine_run(mach, 0);
+      }
+      num_runs += i;
+      end = os_time_get_nano();
+   } while (end - start < (int64_t) (seconds * 1e9));
+
+   printf("%-32s %3u instructions: %8.2f Minstr/s, %9.2f Mlane-instr/s\n",
+          shader->name, mach->NumInstructions,
+          (double) num_runs * mach->NumInstructions * 1e3 / (end - start),
+          (double) num_runs * mach->NumInstructions * TGSI_EXEC_WIDTH * 1e3 /
+          (end - start));
+
+   tgsi_exec_machine_bind_shader(mach, NULL, NULL, NULL, NULL);
+}
+
+
+int
+main(int argc, char **argv)
+{
+   const double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+   static float consts[NUM_CONSTS][4];
+   const void *bufs[1] = { consts };
+   const unsigned sizes[1] = { sizeof consts };
+   struct tgsi_exec_machine *mach;
+   unsigned i, j, k;
+
+   mach = tgsi_exec_machine_create(PIPE_SHADER_VERTEX);
+   if (!mach) {
+      fprintf(stderr, "failed to create the machine\n");
+      return 1;
+   }
+
+   srand(0);
+   for (i = 0; i < NUM_CONSTS; i++)
+      for (j = 0; j < 4; j++)
+         consts[i][j] = (float) rand() / RAND_MAX;
+   tgsi_exec_set_constant_buffers(mach, 1, bufs, sizes);
+
+   for (i = 0; i < 2; i++)
+      for (j = 0; j < TGSI_NUM_CHANNELS; j++)
+         for (k = 0; k < TGSI_EXEC_WIDTH; k++)
+            mach->Inputs[i].xyzw[j].f[k] = (float) rand() / RAND_MAX * 4.0f;
+
+   for (i = 0; i < ARRAY_SIZE(shaders); i++)
+      run(mach, &shaders[i], seconds);
+
+   tgsi_exec_machine_destroy(mach);
+
+   return 0;
+}
@@ -83,6 +83,8 @@ int main(int argc, char** argv)
       util_cpu_caps.has_sse2 = 0;
       util_cpu_caps.has_sse3 = 0;
       util_cpu_caps.has_sse4_1 = 0;
+      util_cpu_caps.has_avx = 0;
+      util_cpu_caps.has_f16c = 0;
       create_fn = translate_sse2_create;
    }
    else if (!strcmp(argv[1], "sse"))
@@ -95,6 +97,8 @@ int main(int argc, char** argv)
       util_cpu_caps.has_sse2 = 0;
       util_cpu_caps.has_sse3 = 0;
       util_cpu_caps.has_sse4_1 = 0;
+      util_cpu_caps.has_avx = 0;
+      util_cpu_caps.has_f16c = 0;
       create_fn = translate_sse2_create;
    }
    else if (!strcmp(argv[1], "sse2"))
@@ -106,6 +110,8 @@ int main(int argc, char** argv)
       }
       util_cpu_caps.has_sse3 = 0;
       util_cpu_caps.has_sse4_1 = 0;
+      util_cpu_caps.has_avx = 0;
+      util_cpu_caps.has_f16c = 0;
       create_fn = translate_sse2_create;
    }
    else if (!strcmp(argv[1], "sse3"))
@@ -116,6 +122,8 @@ int main(int argc, char** argv)
          return 2;
       }
       util_cpu_caps.has_sse4_1 = 0;
+      util_cpu_caps.has_avx = 0;
+      util_cpu_caps.has_f16c = 0;
       create_fn = translate_sse2_create;
    }
    else if (!strcmp(argv[1], "sse4.1"))
@@ -125,12 +133,23 @@ int main(int argc, char** argv)
          printf("Error: CPU doesn't support SSE4.1 (test with qemu)\n");
          return 2;
       }
+      util_cpu_caps.has_avx = 0;
+      util_cpu_caps.has_f16c = 0;
+      create_fn = translate_sse2_create;
+   }
+   else if (!strcmp(argv[1], "avx"))
+   {
+      if(!util_cpu_caps.has_avx || !util_cpu_caps.has_f16c || !rtasm_cpu_has_sse())
+      {
+         printf("Error: CPU doesn't support AVX and F16C (test with qemu)\n");
+         return 2;
+      }
       create_fn = translate_sse2_create;
    }
 
    if (!create_fn)
    {
-      printf("Usage: ./translate_test [default|generic|x86|nosse|sse|sse2|sse3|sse4.1]\n");
+      printf("Usage: ./translate_test [default|generic|x86|nosse|sse|sse2|sse3|sse4.1|avx]\n");
       return 2;
    }
 
@@ -1317,6 +1317,9 @@ _mesa_free_context_data(struct gl_context *ctx, bool destroy_compiler_types)
       _mesa_make_current(ctx, NULL, NULL);
    }
 
+   /* Compiler threads may still be using the context. */
+   _mesa_destroy_shader_compiler_threads(ctx);
+
    /* unreference WinSysDraw/Read buffers */
    _mesa_reference_framebuffer(&ctx->WinSysDrawBuffer, NULL);
    _mesa_reference_framebuffer(&ctx->WinSysReadBuffer, NULL);
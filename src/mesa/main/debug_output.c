@@ -31,6 +31,7 @@
 #include "imports.h"
 #include "hash.h"
 #include "mtypes.h"
+#include "shaderobj.h"
 #include "version.h"
 #include "util/hash_table.h"
 #include "util/simple_list.h"
@@ -730,6 +731,23 @@ _mesa_unlock_debug_state(struct gl_context *ctx)
    simple_mtx_unlock(&ctx->DebugMutex);
 }
 
+/**
+ * Whether the messages of the context have to be generated by the thread
+ * making the GL call: the output is synchronous or the application
+ * installed a callback.
+ */
+bool
+_mesa_debug_output_is_synchronous(struct gl_context *ctx)
+{
+   bool sync;
+
+   simple_mtx_lock(&ctx->DebugMutex);
+   sync = ctx->Debug && (ctx->Debug->SyncOutput || ctx->Debug->Callback);
+   simple_mtx_unlock(&ctx->DebugMutex);
+
+   return sync;
+}
+
 /**
  * Set the integer debug state specified by \p pname.  This can be called from
  * _mesa_set_enable for example.
@@ -737,7 +755,15 @@ _mesa_unlock_debug_state(struct gl_context *ctx)
 bool
 _mesa_set_debug_state_int(struct gl_context *ctx, GLenum pname, GLint val)
 {
-   struct gl_debug_state *debug = _mesa_lock_debug_state(ctx);
+   struct gl_debug_state *debug;
+
+   /* Messages of compiles and links running on compiler threads could
+    * otherwise still be output asynchronously.
+    */
+   if (pname == GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB && val)
+      _mesa_finish_shader_compiler_threads(ctx);
+
+   debug = _mesa_lock_debug_state(ctx);
 
    if (!debug)
       return false;
@@ -1160,7 +1186,12 @@ void GLAPIENTRY
 _mesa_DebugMessageCallback(GLDEBUGPROC callback, const void *userParam)
 {
    GET_CURRENT_CONTEXT(ctx);
-   struct gl_debug_state *debug = _mesa_lock_debug_state(ctx);
+   struct gl_debug_state *debug;
+
+   /* Don't call the new callback from a compiler thread */
+   _mesa_finish_shader_compiler_threads(ctx);
+
+   debug = _mesa_lock_debug_state(ctx);
    if (debug) {
       debug->Callback = callback;
       debug->CallbackData = userParam;
@@ -48,6 +48,9 @@ _mesa_free_errors_data(struct gl_context *ctx);
 void
 _mesa_debug_get_id(GLuint *id);
 
+bool
+_mesa_debug_output_is_synchronous(struct gl_context *ctx);
+
 bool
 _mesa_set_debug_state_int(struct gl_context *ctx, GLenum pname, GLint val);
 
@@ -86,6 +86,8 @@ _mesa_spirv_shader_binary(struct gl_context *ctx,
    for (int i = 0; i < n; ++i) {
       struct gl_shader *sh = shaders[i];
 
+      _mesa_wait_shader_links(ctx, sh);
+
       spirv_data = rzalloc(NULL, struct gl_shader_spirv_data);
       _mesa_shader_spirv_data_reference(&sh->spirv_data, spirv_data);
       _mesa_spirv_module_reference(&spirv_data->SpirVModule, module);
@@ -148,9 +150,7 @@ _mesa_spirv_link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
 
       /* Create program and attach it to the linked shader */
       struct gl_program *gl_prog =
-         ctx->Driver.NewProgram(ctx,
-                                _mesa_shader_stage_to_program(shader_type),
-                                prog->Name, false);
+         _mesa_new_linked_program(ctx, prog, shader_type);
       if (!gl_prog) {
          prog->data->LinkStatus = LINKING_FAILURE;
          _mesa_delete_linked_shader(ctx, linked);
@@ -298,6 +298,8 @@ _mesa_SpecializeShaderARB(GLuint shader,
       return;
    }
 
+   _mesa_wait_shader_links(ctx, sh);
+
    struct gl_shader_spirv_data *spirv_data = sh->spirv_data;
 
    /* From the GL_ARB_gl_spirv spec:
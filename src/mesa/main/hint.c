@@ -138,6 +138,10 @@ _mesa_MaxShaderCompilerThreadsKHR(GLuint count)
 
    ctx->Hint.MaxShaderCompilerThreads = count;
 
+   /* Zero makes glCompileShader and glLinkProgram synchronous instead. */
+   if (count && util_queue_is_initialized(&ctx->ShaderCompilerQueue))
+      util_queue_adjust_num_threads(&ctx->ShaderCompilerQueue, count);
+
    if (ctx->Driver.SetMaxShaderCompilerThreads)
       ctx->Driver.SetMaxShaderCompilerThreads(ctx, count);
 }
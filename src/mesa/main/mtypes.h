@@ -49,6 +49,7 @@
 #include "compiler/glsl/list.h"
 #include "util/simple_mtx.h"
 #include "util/u_dynarray.h"
+#include "util/u_queue.h"
 
 
 #ifdef __cplusplus
@@ -2609,6 +2610,12 @@ struct gl_shader
 
    enum gl_compile_status CompileStatus;
 
+   /** Signalled once a glCompileShader on a compiler thread has finished */
+   struct util_queue_fence CompileFence;
+
+   /** Number of links on compiler threads that are reading this shader */
+   int PendingLinks;
+
 #ifdef DEBUG
    unsigned SourceChecksum;       /**< for debug/logging purposes */
 #endif
@@ -2954,6 +2961,28 @@ struct gl_shader_program
    GLint RefCount;  /**< Reference count */
    GLboolean DeletePending;
 
+   /**
+    * Signalled once the GLSL linker started by a glLinkProgram on a compiler
+    * thread has finished.  LinkPending stays set until the driver has been
+    * handed the result, which happens on the application's thread.
+    * LinkMutex guards clearing it, as several contexts may try at once.
+    */
+   struct util_queue_fence LinkFence;
+   simple_mtx_t LinkMutex;
+   bool LinkPending;
+
+   /**
+    * The gl_programs of a link running on a compiler thread, one for each
+    * stage of the attached shaders.  The driver may only be called on the
+    * application's thread, so they are created there before the link
+    * starts, and the program object keeps a reference to them until the
+    * driver has been handed the result, so that the linker dropping one
+    * doesn't delete it either.  LinkProgramsUsed has the stages handed
+    * out to the linker.
+    */
+   struct gl_program *LinkPrograms[MESA_SHADER_STAGES];
+   GLbitfield LinkProgramsUsed;
+
    /**
     * Is the application intending to glGetProgramBinary this program?
     *
@@ -4843,6 +4872,9 @@ struct gl_context
 
    struct glthread_state *GLThread;
 
+   /** Compiler threads for GL_ARB_parallel_shader_compile */
+   struct util_queue ShaderCompilerQueue;
+
    struct gl_config Visual;
    struct gl_framebuffer *DrawBuffer;	/**< buffer for writing */
    struct gl_framebuffer *ReadBuffer;	/**< buffer for reading */
@@ -41,6 +41,7 @@
 #include <c99_alloca.h>
 #include "main/glheader.h"
 #include "main/context.h"
+#include "main/debug_output.h"
 #include "main/enums.h"
 #include "main/glspirv.h"
 #include "main/hash.h"
@@ -56,6 +57,7 @@
 #include "compiler/glsl/ir.h"
 #include "compiler/glsl/ir_uniform.h"
 #include "compiler/glsl/program.h"
+#include "program/ir_to_mesa.h"
 #include "program/program.h"
 #include "program/prog_print.h"
 #include "program/prog_parameter.h"
@@ -63,6 +65,8 @@
 #include "util/hash_table.h"
 #include "util/mesa-sha1.h"
 #include "util/crc32.h"
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
 
 /**
  * Return mask of GLSL_x flags by examining the MESA_GLSL env var.
@@ -157,6 +161,8 @@ _mesa_init_shader_state(struct gl_context *ctx)
 void
 _mesa_free_shader_state(struct gl_context *ctx)
 {
+   _mesa_destroy_shader_compiler_threads(ctx);
+
    for (int i = 0; i < MESA_SHADER_STAGES; i++) {
       _mesa_reference_program(ctx, &ctx->Shader.CurrentProgram[i], NULL);
       _mesa_reference_shader_program(ctx,
@@ -172,6 +178,115 @@ _mesa_free_shader_state(struct gl_context *ctx)
 }
 
 
+/**
+ * Return the queue that glCompileShader and glLinkProgram hand their work
+ * to, and that the linker spreads the stages of a program over, or NULL if
+ * they have to run synchronously.
+ */
+struct util_queue *
+_mesa_get_shader_compiler_queue(struct gl_context *ctx)
+{
+   /* The MESA_GLSL debug output and shader capture expect each compile and
+    * link to be done when the GL call returns, and the application's debug
+    * callback and synchronous debug output expect compiler and linker
+    * messages from the thread that made the call.
+    */
+   if (ctx->Hint.MaxShaderCompilerThreads == 0 ||
+       ctx->_Shader->Flags != 0 ||
+       _mesa_get_shader_capture_path() != NULL ||
+       _mesa_debug_output_is_synchronous(ctx))
+      return NULL;
+
+   if (!util_queue_is_initialized(&ctx->ShaderCompilerQueue)) {
+      util_cpu_detect();
+      if (util_cpu_caps.nr_cpus < 2)
+         return NULL;
+
+      if (!util_queue_init(&ctx->ShaderCompilerQueue, "glsl", 32,
+                           util_cpu_caps.nr_cpus,
+                           UTIL_QUEUE_INIT_RESIZE_IF_FULL))
+         return NULL;
+
+      util_queue_adjust_num_threads(&ctx->ShaderCompilerQueue,
+                                    ctx->Hint.MaxShaderCompilerThreads);
+   }
+
+   return &ctx->ShaderCompilerQueue;
+}
+
+
+/**
+ * Wait for all compiles and links started by the context.
+ */
+void
+_mesa_finish_shader_compiler_threads(struct gl_context *ctx)
+{
+   if (util_queue_is_initialized(&ctx->ShaderCompilerQueue))
+      util_queue_finish(&ctx->ShaderCompilerQueue);
+}
+
+
+/**
+ * Finish all compiles and links started by the context and stop its
+ * compiler threads.
+ */
+void
+_mesa_destroy_shader_compiler_threads(struct gl_context *ctx)
+{
+   if (!util_queue_is_initialized(&ctx->ShaderCompilerQueue))
+      return;
+
+   /* util_queue_destroy() drops jobs that haven't started yet. */
+   util_queue_finish(&ctx->ShaderCompilerQueue);
+   util_queue_destroy(&ctx->ShaderCompilerQueue);
+   memset(&ctx->ShaderCompilerQueue, 0, sizeof(ctx->ShaderCompilerQueue));
+}
+
+
+/** A glCompileShader or glLinkProgram running on a compiler thread. */
+struct shader_compiler_job
+{
+   struct gl_context *ctx;
+   struct gl_shader *shader;
+   struct gl_shader_program *program;
+};
+
+
+static void
+compile_shader_job(void *data, int thread_index)
+{
+   struct shader_compiler_job *job = data;
+
+   _mesa_glsl_compile_shader(job->ctx, job->shader, false, false, false);
+}
+
+
+static void
+link_program_job(void *data, int thread_index)
+{
+   struct shader_compiler_job *job = data;
+   struct gl_shader_program *shProg = job->program;
+
+   /* The shaders may still be compiling on other threads.  Their jobs were
+    * queued before this one, so waiting for them can't deadlock.
+    */
+   for (unsigned i = 0; i < shProg->NumShaders; i++)
+      util_queue_fence_wait(&shProg->Shaders[i]->CompileFence);
+
+   _mesa_glsl_link_shader_ir(job->ctx, shProg);
+
+   for (unsigned i = 0; i < shProg->NumShaders; i++)
+      p_atomic_dec(&shProg->Shaders[i]->PendingLinks);
+}
+
+
+static void
+free_shader_compiler_job(void *data, int thread_index)
+{
+   free(data);
+}
+
+
 /**
  * Copy string from <src> to <dst>, up to maxLength characters, returning
  * length of <dst> in <length>.
@@ -282,7 +397,8 @@ attach_shader_err(struct gl_context *ctx, GLuint program, GLuint shader,
    if (!shProg)
       return;
 
-   sh = _mesa_lookup_shader_err(ctx, shader, caller);
+   /* Attaching only needs the stage, so don't wait for the compile */
+   sh = _mesa_lookup_shader_err_nowait(ctx, shader, caller);
    if (!sh) {
       return;
    }
@@ -323,7 +439,7 @@ attach_shader_no_error(struct gl_context *ctx, GLuint program, GLuint shader)
    struct gl_shader *sh;
 
    shProg = _mesa_lookup_shader_program(ctx, program);
-   sh = _mesa_lookup_shader(ctx, shader);
+   sh = _mesa_lookup_shader_nowait(ctx, shader);
 
    attach_shader(ctx, shProg, sh);
 }
@@ -493,7 +609,8 @@ detach_shader(struct gl_context *ctx, GLuint program, GLuint shader,
    /* not found */
    if (!no_error) {
       GLenum err;
-      if (is_shader(ctx, shader) || is_program(ctx, shader))
+      if (_mesa_lookup_shader_nowait(ctx, shader) ||
+          is_program(ctx, shader))
          err = GL_INVALID_OPERATION;
       else
          err = GL_INVALID_VALUE;
@@ -658,7 +775,8 @@ get_programiv(struct gl_context *ctx, GLuint program, GLenum pname,
               GLint *params)
 {
    struct gl_shader_program *shProg
-      = _mesa_lookup_shader_program_err(ctx, program, "glGetProgramiv(program)");
+      = _mesa_lookup_shader_program_err_nowait(ctx, program,
+                                               "glGetProgramiv(program)");
 
    /* Is transform feedback available in this context?
     */
@@ -685,6 +803,14 @@ get_programiv(struct gl_context *ctx, GLuint program, GLenum pname,
       return;
    }
 
+   if (pname == GL_COMPLETION_STATUS_ARB &&
+       !util_queue_fence_is_signalled(&shProg->LinkFence)) {
+      *params = GL_FALSE;
+      return;
+   }
+
+   _mesa_finish_shader_program_link(ctx, shProg);
+
    switch (pname) {
    case GL_DELETE_STATUS:
       *params = shProg->DeletePending;
@@ -953,12 +1079,19 @@ static void
 get_shaderiv(struct gl_context *ctx, GLuint name, GLenum pname, GLint *params)
 {
    struct gl_shader *shader =
-      _mesa_lookup_shader_err(ctx, name, "glGetShaderiv");
+      _mesa_lookup_shader_err_nowait(ctx, name, "glGetShaderiv");
 
    if (!shader) {
       return;
    }
 
+   if (pname == GL_COMPLETION_STATUS_ARB) {
+      *params = util_queue_fence_is_signalled(&shader->CompileFence);
+      return;
+   }
+
+   util_queue_fence_wait(&shader->CompileFence);
+
    switch (pname) {
    case GL_SHADER_TYPE:
       *params = shader->Type;
@@ -966,10 +1099,6 @@ get_shaderiv(struct gl_context *ctx, GLuint name, GLenum pname, GLint *params)
    case GL_DELETE_STATUS:
       *params = shader->DeletePending;
       break;
-   case GL_COMPLETION_STATUS_ARB:
-      /* _mesa_glsl_compile_shader is not offloaded to other threads. */
-      *params = GL_TRUE;
-      return;
    case GL_COMPILE_STATUS:
       *params = shader->CompileStatus ? GL_TRUE : GL_FALSE;
       break;
@@ -1105,8 +1234,8 @@ set_shader_source(struct gl_shader *sh, const GLchar *source)
 /**
  * Compile a shader.
  */
-void
-_mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
+static void
+compile_shader(struct gl_context *ctx, struct gl_shader *sh, bool async)
 {
    if (!sh)
       return;
@@ -1123,12 +1252,31 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
       return;
    }
 
+   /* Links on compiler threads may still be reading the old IR. */
+   _mesa_wait_shader_links(ctx, sh);
+
    if (!sh->Source) {
       /* If the user called glCompileShader without first calling
        * glShaderSource, we should fail to compile, but not raise a GL_ERROR.
        */
       sh->CompileStatus = COMPILE_FAILURE;
    } else {
+      struct util_queue *queue =
+         async ? _mesa_get_shader_compiler_queue(ctx) : NULL;
+      struct shader_compiler_job *job = NULL;
+
+      if (queue)
+         job = calloc(1, sizeof(*job));
+
+      if (job) {
+         /* Nothing else below applies without MESA_GLSL flags. */
+         job->ctx = ctx;
+         job->shader = sh;
+         util_queue_add_job(queue, job, &sh->CompileFence, compile_shader_job,
+                            free_shader_compiler_job);
+         return;
+      }
+
       if (ctx->_Shader->Flags & GLSL_DUMP) {
          _mesa_log("GLSL source for %s shader %d:\n",
                  _mesa_shader_stage_to_string(sh->Stage), sh->Name);
@@ -1180,12 +1328,65 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
 }
 
 
+void
+_mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
+{
+   compile_shader(ctx, sh, false);
+}
+
+
+/**
+ * Start linking a program on a compiler thread.  Only the GLSL linker runs
+ * there; the driver gets the result on the next lookup of the program, see
+ * _mesa_finish_shader_program_link().
+ *
+ * \return false if the program has to be linked synchronously.
+ */
+static bool
+link_program_async(struct gl_context *ctx, struct gl_shader_program *shProg)
+{
+   struct util_queue *queue = _mesa_get_shader_compiler_queue(ctx);
+   if (!queue)
+      return false;
+
+   /* A program that is bound anywhere can't change under the draw calls and
+    * glUniform calls that use it without looking it up.
+    */
+   if (p_atomic_read(&shProg->RefCount) != 1 || shProg->DeletePending)
+      return false;
+
+   struct shader_compiler_job *job = calloc(1, sizeof(*job));
+   if (!job)
+      return false;
+
+   /* The linker doesn't call into the driver for its gl_programs. */
+   if (!_mesa_create_link_programs(ctx, shProg)) {
+      free(job);
+      return false;
+   }
+
+   /* Freeing the old gl_programs may call into the driver. */
+   _mesa_clear_shader_program_data(ctx, shProg);
+   shProg->data = _mesa_create_shader_program_data();
+   shProg->LinkPending = true;
+
+   for (unsigned i = 0; i < shProg->NumShaders; i++)
+      p_atomic_inc(&shProg->Shaders[i]->PendingLinks);
+
+   job->ctx = ctx;
+   job->program = shProg;
+   util_queue_add_job(queue, job, &shProg->LinkFence, link_program_job,
+                      free_shader_compiler_job);
+   return true;
+}
+
+
 /**
  * Link a program's shaders.
  */
 static ALWAYS_INLINE void
 link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
-             bool no_error)
+             bool no_error, bool async)
 {
    if (!shProg)
       return;
@@ -1213,6 +1414,12 @@ link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
    }
 
    FLUSH_VERTICES(ctx, 0);
+
+   if (async && link_program_async(ctx, shProg)) {
+      shProg->BinaryRetrievableHint = shProg->BinaryRetrievableHintPending;
+      return;
+   }
+
    _mesa_glsl_link_shader(ctx, shProg);
 
    /* From section 7.3 (Program Objects) of the OpenGL 4.5 spec:
@@ -1307,23 +1514,24 @@ link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
 
 
 static void
-link_program_error(struct gl_context *ctx, struct gl_shader_program *shProg)
+link_program_error(struct gl_context *ctx, struct gl_shader_program *shProg,
+                   bool async)
 {
-   link_program(ctx, shProg, false);
+   link_program(ctx, shProg, false, async);
 }
 
 
 static void
 link_program_no_error(struct gl_context *ctx, struct gl_shader_program *shProg)
 {
-   link_program(ctx, shProg, true);
+   link_program(ctx, shProg, true, true);
 }
 
 
 void
 _mesa_link_program(struct gl_context *ctx, struct gl_shader_program *shProg)
 {
-   link_program_error(ctx, shProg);
+   link_program_error(ctx, shProg, false);
 }
 
 
@@ -1504,8 +1712,8 @@ _mesa_CompileShader(GLuint shaderObj)
    GET_CURRENT_CONTEXT(ctx);
    if (MESA_VERBOSE & VERBOSE_API)
       _mesa_debug(ctx, "glCompileShader %u\n", shaderObj);
-   _mesa_compile_shader(ctx, _mesa_lookup_shader_err(ctx, shaderObj,
-                                                     "glCompileShader"));
+   compile_shader(ctx, _mesa_lookup_shader_err(ctx, shaderObj,
+                                               "glCompileShader"), true);
 }
 
 
@@ -1801,7 +2009,7 @@ _mesa_LinkProgram(GLuint programObj)
 
    struct gl_shader_program *shProg =
       _mesa_lookup_shader_program_err(ctx, programObj, "glLinkProgram");
-   link_program_error(ctx, shProg);
+   link_program_error(ctx, shProg, true);
 }
 
 #ifdef ENABLE_SHADER_CACHE
@@ -1948,6 +2156,9 @@ shader_source(struct gl_context *ctx, GLuint shaderObj, GLsizei count,
       sh = _mesa_lookup_shader(ctx, shaderObj);
    }
 
+   /* Links on compiler threads may still be reading the old source. */
+   _mesa_wait_shader_links(ctx, sh);
+
    /*
     * This array holds offsets of where the appropriate string ends, thus the
     * last element will be set to the total length of the source code.
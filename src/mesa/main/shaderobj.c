@@ -41,6 +41,7 @@
 #include "main/uniforms.h"
 #include "program/program.h"
 #include "program/prog_parameter.h"
+#include "program/ir_to_mesa.h"
 #include "util/ralloc.h"
 #include "util/u_atomic.h"
 
@@ -91,6 +92,7 @@ static void
 _mesa_init_shader(struct gl_shader *shader)
 {
    shader->RefCount = 1;
+   util_queue_fence_init(&shader->CompileFence);
    shader->info.Geom.VerticesOut = -1;
    shader->info.Geom.InputType = GL_TRIANGLES;
    shader->info.Geom.OutputType = GL_TRIANGLE_STRIP;
@@ -122,6 +124,9 @@ _mesa_new_shader(GLuint name, gl_shader_stage stage)
 void
 _mesa_delete_shader(struct gl_context *ctx, struct gl_shader *sh)
 {
+   util_queue_fence_wait(&sh->CompileFence);
+   util_queue_fence_destroy(&sh->CompileFence);
+
    _mesa_shader_spirv_data_reference(&sh->spirv_data, NULL);
    free((void *)sh->Source);
    free((void *)sh->FallbackSource);
@@ -144,10 +149,24 @@ _mesa_delete_linked_shader(struct gl_context *ctx,
 
 
 /**
- * Lookup a GLSL shader object.
+ * Lookup a GLSL shader object, waiting for any compile of it still running
+ * on a compiler thread.
  */
 struct gl_shader *
 _mesa_lookup_shader(struct gl_context *ctx, GLuint name)
+{
+   struct gl_shader *sh = _mesa_lookup_shader_nowait(ctx, name);
+   if (sh)
+      util_queue_fence_wait(&sh->CompileFence);
+   return sh;
+}
+
+
+/**
+ * As above, but don't wait for a compile running on a compiler thread.
+ */
+struct gl_shader *
+_mesa_lookup_shader_nowait(struct gl_context *ctx, GLuint name)
 {
    if (name) {
       struct gl_shader *sh = (struct gl_shader *)
@@ -170,6 +189,20 @@ _mesa_lookup_shader(struct gl_context *ctx, GLuint name)
  */
 struct gl_shader *
 _mesa_lookup_shader_err(struct gl_context *ctx, GLuint name, const char *caller)
+{
+   struct gl_shader *sh = _mesa_lookup_shader_err_nowait(ctx, name, caller);
+   if (sh)
+      util_queue_fence_wait(&sh->CompileFence);
+   return sh;
+}
+
+
+/**
+ * As above, but don't wait for a compile running on a compiler thread.
+ */
+struct gl_shader *
+_mesa_lookup_shader_err_nowait(struct gl_context *ctx, GLuint name,
+                               const char *caller)
 {
    if (!name) {
       _mesa_error(ctx, GL_INVALID_VALUE, "%s", caller);
@@ -191,6 +224,50 @@ _mesa_lookup_shader_err(struct gl_context *ctx, GLuint name, const char *caller)
 }
 
 
+/**
+ * Callback for _mesa_HashWalk() waiting for the link of a program that has
+ * the shader attached.
+ */
+static void
+wait_shader_link_cb(GLuint key, void *data, void *userData)
+{
+   struct gl_shader_program *shProg = (struct gl_shader_program *) data;
+   struct gl_shader *sh = (struct gl_shader *) userData;
+   unsigned i;
+
+   if (shProg->Type != GL_SHADER_PROGRAM_MESA)
+      return;
+
+   for (i = 0; i < shProg->NumShaders; i++) {
+      if (shProg->Shaders[i] == sh) {
+         util_queue_fence_wait(&shProg->LinkFence);
+         return;
+      }
+   }
+}
+
+
+/**
+ * Wait until no link running on a compiler thread reads the shader anymore,
+ * so that its source or IR can be replaced.
+ *
+ * The links may have been started by any context sharing the shader.  A
+ * program can't be detached from the shader nor deleted before its link is
+ * finished, so waiting for the programs that have it attached is enough.
+ * Link jobs never take the lock of the table, so they can't deadlock with
+ * the walk.
+ */
+void
+_mesa_wait_shader_links(struct gl_context *ctx, struct gl_shader *sh)
+{
+   if (!p_atomic_read(&sh->PendingLinks))
+      return;
+
+   _mesa_HashWalk(ctx->Shared->ShaderObjects, wait_shader_link_cb, sh);
+   assert(!p_atomic_read(&sh->PendingLinks));
+}
+
+
 
 /**********************************************************************/
 /*** Shader Program object functions                                ***/
@@ -285,6 +362,8 @@ init_shader_program(struct gl_shader_program *prog)
 {
    prog->Type = GL_SHADER_PROGRAM_MESA;
    prog->RefCount = 1;
+   util_queue_fence_init(&prog->LinkFence);
+   simple_mtx_init(&prog->LinkMutex, mtx_plain);
 
    prog->AttributeBindings = string_to_uint_map_ctor();
    prog->FragDataBindings = string_to_uint_map_ctor();
@@ -406,13 +485,112 @@ void
 _mesa_delete_shader_program(struct gl_context *ctx,
                             struct gl_shader_program *shProg)
 {
+   /* A link in progress is simply dropped once the GLSL linker is done. */
+   util_queue_fence_wait(&shProg->LinkFence);
+   util_queue_fence_destroy(&shProg->LinkFence);
+   simple_mtx_destroy(&shProg->LinkMutex);
+   _mesa_release_link_programs(ctx, shProg);
+
    _mesa_free_shader_program_data(ctx, shProg);
    ralloc_free(shProg);
 }
 
 
 /**
- * Lookup a GLSL program object.
+ * Finish a glLinkProgram that was started on a compiler thread: wait for the
+ * GLSL linker, then hand its result to the driver on this thread.
+ *
+ * Contexts sharing the program may get here at the same time.  Only the
+ * first one calls the driver, and the others wait for it under LinkMutex so
+ * that none of them sees a half-finished link.
+ */
+void
+_mesa_finish_shader_program_link(struct gl_context *ctx,
+                                 struct gl_shader_program *shProg)
+{
+   util_queue_fence_wait(&shProg->LinkFence);
+
+   simple_mtx_lock(&shProg->LinkMutex);
+   if (shProg->LinkPending) {
+      shProg->LinkPending = false;
+      _mesa_glsl_link_shader_driver(ctx, shProg);
+      _mesa_release_link_programs(ctx, shProg);
+   }
+   simple_mtx_unlock(&shProg->LinkMutex);
+}
+
+
+/**
+ * Create the gl_programs for a link of shProg on a compiler thread, see
+ * gl_shader_program::LinkPrograms.
+ */
+bool
+_mesa_create_link_programs(struct gl_context *ctx,
+                           struct gl_shader_program *shProg)
+{
+   for (unsigned i = 0; i < shProg->NumShaders; i++) {
+      gl_shader_stage stage = shProg->Shaders[i]->Stage;
+
+      if (shProg->LinkPrograms[stage])
+         continue;
+
+      shProg->LinkPrograms[stage] =
+         ctx->Driver.NewProgram(ctx, _mesa_shader_stage_to_program(stage),
+                                shProg->Name, false);
+      if (!shProg->LinkPrograms[stage]) {
+         _mesa_release_link_programs(ctx, shProg);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+
+/**
+ * Drop the references of shProg to the gl_programs of its last link on a
+ * compiler thread, deleting those the linker didn't keep.
+ */
+void
+_mesa_release_link_programs(struct gl_context *ctx,
+                            struct gl_shader_program *shProg)
+{
+   for (unsigned stage = 0; stage < MESA_SHADER_STAGES; stage++)
+      _mesa_reference_program(ctx, &shProg->LinkPrograms[stage], NULL);
+
+   shProg->LinkProgramsUsed = 0;
+}
+
+
+/**
+ * Create the gl_program of a linked shader.  A link running on a compiler
+ * thread gets the one created in advance for the stage, only once, as the
+ * linker expects a new program.
+ */
+struct gl_program *
+_mesa_new_linked_program(struct gl_context *ctx,
+                         struct gl_shader_program *shProg,
+                         gl_shader_stage stage)
+{
+   struct gl_program *prog = NULL;
+
+   if (!shProg->LinkPending) {
+      return ctx->Driver.NewProgram(ctx, _mesa_shader_stage_to_program(stage),
+                                    shProg->Name, false);
+   }
+
+   if (!(shProg->LinkProgramsUsed & (1 << stage))) {
+      shProg->LinkProgramsUsed |= 1 << stage;
+      _mesa_reference_program(ctx, &prog, shProg->LinkPrograms[stage]);
+   }
+
+   return prog;
+}
+
+
+/**
+ * Lookup a GLSL program object, finishing any link of it that was started
+ * on a compiler thread.
  */
 struct gl_shader_program *
 _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
@@ -428,6 +606,8 @@ _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
       if (shProg && shProg->Type != GL_SHADER_PROGRAM_MESA) {
          return NULL;
       }
+      if (shProg)
+         _mesa_finish_shader_program_link(ctx, shProg);
       return shProg;
    }
    return NULL;
@@ -440,6 +620,21 @@ _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
 struct gl_shader_program *
 _mesa_lookup_shader_program_err(struct gl_context *ctx, GLuint name,
                                 const char *caller)
+{
+   struct gl_shader_program *shProg =
+      _mesa_lookup_shader_program_err_nowait(ctx, name, caller);
+   if (shProg)
+      _mesa_finish_shader_program_link(ctx, shProg);
+   return shProg;
+}
+
+
+/**
+ * As above, but don't wait for a link running on a compiler thread.
+ */
+struct gl_shader_program *
+_mesa_lookup_shader_program_err_nowait(struct gl_context *ctx, GLuint name,
+                                       const char *caller)
 {
    if (!name) {
       _mesa_error(ctx, GL_INVALID_VALUE, "%s", caller);
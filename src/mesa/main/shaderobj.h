@@ -41,6 +41,7 @@ struct gl_shader_program_data;
 struct gl_linked_shader;
 struct dd_function_table;
 struct gl_pipeline_object;
+struct util_queue;
 
 /**
  * Internal functions
@@ -52,6 +53,15 @@ _mesa_init_shader_state(struct gl_context * ctx);
 extern void
 _mesa_free_shader_state(struct gl_context *ctx);
 
+extern struct util_queue *
+_mesa_get_shader_compiler_queue(struct gl_context *ctx);
+
+extern void
+_mesa_finish_shader_compiler_threads(struct gl_context *ctx);
+
+extern void
+_mesa_destroy_shader_compiler_threads(struct gl_context *ctx);
+
 
 extern void
 _mesa_reference_shader(struct gl_context *ctx, struct gl_shader **ptr,
@@ -60,9 +70,19 @@ _mesa_reference_shader(struct gl_context *ctx, struct gl_shader **ptr,
 extern struct gl_shader *
 _mesa_lookup_shader(struct gl_context *ctx, GLuint name);
 
+extern struct gl_shader *
+_mesa_lookup_shader_nowait(struct gl_context *ctx, GLuint name);
+
 extern struct gl_shader *
 _mesa_lookup_shader_err(struct gl_context *ctx, GLuint name, const char *caller);
 
+extern struct gl_shader *
+_mesa_lookup_shader_err_nowait(struct gl_context *ctx, GLuint name,
+                               const char *caller);
+
+extern void
+_mesa_wait_shader_links(struct gl_context *ctx, struct gl_shader *sh);
+
 
 
 extern void
@@ -101,6 +121,27 @@ extern struct gl_shader_program *
 _mesa_lookup_shader_program_err(struct gl_context *ctx, GLuint name,
                                 const char *caller);
 
+extern struct gl_shader_program *
+_mesa_lookup_shader_program_err_nowait(struct gl_context *ctx, GLuint name,
+                                       const char *caller);
+
+extern void
+_mesa_finish_shader_program_link(struct gl_context *ctx,
+                                 struct gl_shader_program *shProg);
+
+extern bool
+_mesa_create_link_programs(struct gl_context *ctx,
+                           struct gl_shader_program *shProg);
+
+extern void
+_mesa_release_link_programs(struct gl_context *ctx,
+                            struct gl_shader_program *shProg);
+
+extern struct gl_program *
+_mesa_new_linked_program(struct gl_context *ctx,
+                         struct gl_shader_program *shProg,
+                         gl_shader_stage stage);
+
 extern struct gl_shader_program *
 _mesa_new_shader_program(GLuint name);
 
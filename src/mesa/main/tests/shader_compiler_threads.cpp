@@ -0,0 +1,262 @@
+/*
+ * Copyright © 2019 VMware, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name shader_compiler_threads.cpp
+ *
+ * Check that compiles and links started on the compiler threads of
+ * GL_KHR_parallel_shader_compile are finished by the queries that read
+ * their results, and that those results are the same as when compiling and
+ * linking synchronously.
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+
+#include "GL/gl.h"
+#include "GL/glext.h"
+#include "main/context.h"
+#include "main/extensions.h"
+#include "main/hint.h"
+#include "main/mtypes.h"
+#include "main/shaderapi.h"
+#include "main/shaderobj.h"
+#include "program/ir_to_mesa.h"
+#include "drivers/common/driverfuncs.h"
+
+struct link_result {
+   GLint compile_status[2];
+   std::string shader_log[2];
+   GLint link_status;
+   std::string program_log;
+};
+
+class ShaderCompilerThreads_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   link_result link(const char *vs, const char *fs, bool async);
+
+   struct gl_config visual;
+   struct dd_function_table driver_functions;
+   struct gl_context ctx;
+};
+
+void
+ShaderCompilerThreads_test::SetUp()
+{
+   memset(&visual, 0, sizeof(visual));
+   memset(&driver_functions, 0, sizeof(driver_functions));
+   memset(&ctx, 0, sizeof(ctx));
+
+   _mesa_init_driver_functions(&driver_functions);
+   driver_functions.LinkShader = _mesa_ir_link_shader;
+
+   _mesa_initialize_context(&ctx, API_OPENGL_COMPAT, &visual, NULL,
+                            &driver_functions);
+   _mesa_override_extensions(&ctx);
+   ctx.Version = 21;
+   ctx.Const.GLSLVersion = 120;
+
+   _mesa_make_current(&ctx, NULL, NULL);
+}
+
+void
+ShaderCompilerThreads_test::TearDown()
+{
+   _mesa_make_current(NULL, NULL, NULL);
+   _mesa_free_context_data(&ctx, true);
+}
+
+static std::string
+shader_info_log(GLuint shader)
+{
+   GLchar log[4096];
+
+   _mesa_GetShaderInfoLog(shader, sizeof(log), NULL, log);
+   return log;
+}
+
+static std::string
+program_info_log(GLuint program)
+{
+   GLchar log[4096];
+
+   _mesa_GetProgramInfoLog(program, sizeof(log), NULL, log);
+   return log;
+}
+
+/**
+ * Compile and link a program, on the compiler threads if async, and query
+ * its results.  Each query is checked to have finished the work it reads.
+ */
+link_result
+ShaderCompilerThreads_test::link(const char *vs, const char *fs, bool async)
+{
+   const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+   const char *sources[2] = { vs, fs };
+   GLuint shaders[2];
+   link_result result;
+
+   _mesa_MaxShaderCompilerThreadsKHR(async ? 0xffffffff : 0);
+
+   GLuint program = _mesa_CreateProgram();
+   for (unsigned i = 0; i < 2; i++) {
+      shaders[i] = _mesa_CreateShader(types[i]);
+      _mesa_ShaderSource(shaders[i], 1, &sources[i], NULL);
+      _mesa_CompileShader(shaders[i]);
+      _mesa_AttachShader(program, shaders[i]);
+   }
+   _mesa_LinkProgram(program);
+
+   struct gl_shader_program *shProg =
+      _mesa_lookup_shader_program_err_nowait(&ctx, program, "test");
+   if (async && _mesa_get_shader_compiler_queue(&ctx)) {
+      EXPECT_TRUE(shProg->LinkPending);
+   }
+
+   _mesa_GetProgramiv(program, GL_LINK_STATUS, &result.link_status);
+   EXPECT_TRUE(util_queue_fence_is_signalled(&shProg->LinkFence));
+   EXPECT_FALSE(shProg->LinkPending);
+   result.program_log = program_info_log(program);
+
+   for (unsigned i = 0; i < 2; i++) {
+      struct gl_shader *sh = _mesa_lookup_shader_nowait(&ctx, shaders[i]);
+
+      result.shader_log[i] = shader_info_log(shaders[i]);
+      EXPECT_TRUE(util_queue_fence_is_signalled(&sh->CompileFence));
+      _mesa_GetShaderiv(shaders[i], GL_COMPILE_STATUS,
+                        &result.compile_status[i]);
+
+      _mesa_DeleteShader(shaders[i]);
+   }
+   _mesa_DeleteProgram(program);
+
+   return result;
+}
+
+static void
+expect_same_results(const link_result &sync, const link_result &async)
+{
+   for (unsigned i = 0; i < 2; i++) {
+      EXPECT_EQ(sync.compile_status[i], async.compile_status[i]);
+      EXPECT_EQ(sync.shader_log[i], async.shader_log[i]);
+   }
+   EXPECT_EQ(sync.link_status, async.link_status);
+   EXPECT_EQ(sync.program_log, async.program_log);
+}
+
+static const char vs_passthrough[] =
+   "#version 120\n"
+   "uniform vec4 u;\n"
+   "varying vec4 color;\n"
+   "void main() {\n"
+   "   color = u;\n"
+   "   gl_Position = gl_Vertex;\n"
+   "}\n";
+
+static const char fs_passthrough[] =
+   "#version 120\n"
+   "varying vec4 color;\n"
+   "void main() {\n"
+   "   gl_FragColor = color;\n"
+   "}\n";
+
+static const char fs_mismatched_uniform[] =
+   "#version 120\n"
+   "uniform float u;\n"
+   "void main() {\n"
+   "   gl_FragColor = vec4(u);\n"
+   "}\n";
+
+static const char fs_syntax_error[] =
+   "#version 120\n"
+   "void main() {\n"
+   "   gl_FragColor = vec4(1.0)\n"
+   "}\n";
+
+TEST_F(ShaderCompilerThreads_test, LinkSuccess)
+{
+   link_result sync = link(vs_passthrough, fs_passthrough, false);
+   link_result async = link(vs_passthrough, fs_passthrough, true);
+
+   EXPECT_EQ(GL_TRUE, sync.link_status);
+   expect_same_results(sync, async);
+}
+
+TEST_F(ShaderCompilerThreads_test, LinkFailure)
+{
+   link_result sync = link(vs_passthrough, fs_mismatched_uniform, false);
+   link_result async = link(vs_passthrough, fs_mismatched_uniform, true);
+
+   EXPECT_EQ(GL_FALSE, sync.link_status);
+   EXPECT_NE(std::string::npos, sync.program_log.find("`u'"));
+   expect_same_results(sync, async);
+}
+
+TEST_F(ShaderCompilerThreads_test, CompileFailure)
+{
+   link_result sync = link(vs_passthrough, fs_syntax_error, false);
+   link_result async = link(vs_passthrough, fs_syntax_error, true);
+
+   EXPECT_EQ(GL_FALSE, sync.compile_status[1]);
+   EXPECT_NE("", sync.shader_log[1]);
+   EXPECT_EQ(GL_FALSE, sync.link_status);
+   expect_same_results(sync, async);
+}
+
+/**
+ * Replacing the source of a shader while a link reading it runs on a
+ * compiler thread must not change the result of that link.
+ */
+TEST_F(ShaderCompilerThreads_test, RecompileDuringLink)
+{
+   const char *vs = vs_passthrough;
+   const char *fs = fs_passthrough;
+   const char *broken = fs_syntax_error;
+
+   GLuint program = _mesa_CreateProgram();
+   GLuint vsh = _mesa_CreateShader(GL_VERTEX_SHADER);
+   GLuint fsh = _mesa_CreateShader(GL_FRAGMENT_SHADER);
+   _mesa_ShaderSource(vsh, 1, &vs, NULL);
+   _mesa_ShaderSource(fsh, 1, &fs, NULL);
+   _mesa_CompileShader(vsh);
+   _mesa_CompileShader(fsh);
+   _mesa_AttachShader(program, vsh);
+   _mesa_AttachShader(program, fsh);
+   _mesa_LinkProgram(program);
+
+   _mesa_ShaderSource(fsh, 1, &broken, NULL);
+   _mesa_CompileShader(fsh);
+
+   GLint status;
+   _mesa_GetProgramiv(program, GL_LINK_STATUS, &status);
+   EXPECT_EQ(GL_TRUE, status);
+   _mesa_GetShaderiv(fsh, GL_COMPILE_STATUS, &status);
+   EXPECT_EQ(GL_FALSE, status);
+
+   _mesa_DeleteShader(vsh);
+   _mesa_DeleteShader(fsh);
+   _mesa_DeleteProgram(program);
+}
@@ -3118,13 +3118,29 @@ _mesa_ir_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 void
 _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 {
-   unsigned int i;
-   bool spirv = false;
-
    _mesa_clear_shader_program_data(ctx, prog);
 
    prog->data = _mesa_create_shader_program_data();
 
+   _mesa_glsl_link_shader_ir(ctx, prog);
+   _mesa_glsl_link_shader_driver(ctx, prog);
+}
+
+/**
+ * Run the GLSL linker on a program whose previous link results have been
+ * cleared.  The only driver functions this calls are NewProgram and
+ * DeleteProgram, through _mesa_new_linked_program() and the linked shaders.
+ * When running on a compiler thread, the gl_programs are created in advance
+ * by the application's thread, which also holds a reference to them, so
+ * the driver isn't called at all.
+ */
+void
+_mesa_glsl_link_shader_ir(struct gl_context *ctx,
+                          struct gl_shader_program *prog)
+{
+   unsigned int i;
+   bool spirv = false;
+
    prog->data->LinkStatus = LINKING_SUCCESS;
 
    for (i = 0; i < prog->NumShaders; i++) {
@@ -3163,7 +3179,16 @@ _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
    if (prog->data->LinkStatus == LINKING_SUCCESS) {
       prog->SamplersValidated = GL_TRUE;
    }
+}
 
+/**
+ * Hand the result of _mesa_glsl_link_shader_ir() to the driver.  This must
+ * run on the thread the context is current on.
+ */
+void
+_mesa_glsl_link_shader_driver(struct gl_context *ctx,
+                              struct gl_shader_program *prog)
+{
    if (prog->data->LinkStatus && !ctx->Driver.LinkShader(ctx, prog)) {
       prog->data->LinkStatus = LINKING_FAILURE;
    }
@@ -142,7 +142,13 @@ st_feedback_draw_vbo(struct gl_context *ctx,
    vs = &vp_variant->tgsi;
 
    if (!vp_variant->draw_shader) {
-      vp_variant->draw_shader = draw_create_vertex_shader(draw, vs);
+      /* The NIR of the variant belongs to the driver, so the draw module
+       * gets the TGSI copy kept for feedback/select.
+       */
+      struct pipe_shader_state state = *vs;
+
+      state.type = PIPE_SHADER_IR_TGSI;
+      vp_variant->draw_shader = draw_create_vertex_shader(draw, &state);
    }
 
    /*
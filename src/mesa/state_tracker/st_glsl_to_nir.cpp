@@ -47,6 +47,7 @@
 #include "compiler/glsl/gl_nir.h"
 #include "compiler/glsl/ir.h"
 #include "compiler/glsl/ir_optimization.h"
+#include "compiler/glsl/linker_util.h"
 #include "compiler/glsl/string_to_uint_map.h"
 
 static int
@@ -367,6 +368,11 @@ st_nir_opts(nir_shader *nir, bool scalar)
 /* First third of converting glsl_to_nir.. this leaves things in a pre-
  * nir_lower_io state, so that shader variants can more easily insert/
  * replace variables, etc.
+ *
+ * It is done in two steps, st_glsl_to_nir() and st_glsl_to_nir_lower(), so
+ * that the linker can build the software fp64 library in between on its own
+ * thread: that compiles GLSL with the context, while the two steps only
+ * touch the stage they are given.
  */
 static nir_shader *
 st_glsl_to_nir(struct st_context *st, struct gl_program *prog,
@@ -375,12 +381,7 @@ st_glsl_to_nir(struct st_context *st, struct gl_program *prog,
 {
    const nir_shader_compiler_options *options =
       st->ctx->Const.ShaderCompilerOptions[prog->info.stage].NirOptions;
-   enum pipe_shader_type type = pipe_shader_type_from_mesa(stage);
-   struct pipe_screen *screen = st->pipe->screen;
-   bool is_scalar = screen->get_shader_param(screen, type, PIPE_SHADER_CAP_SCALAR_ISA);
    assert(options);
-   bool lower_64bit =
-      options->lower_int64_options || options->lower_doubles_options;
 
    if (prog->nir)
       return prog->nir;
@@ -403,12 +404,30 @@ st_glsl_to_nir(struct st_context *st, struct gl_program *prog,
    }
 
    nir_shader_gather_info(nir, nir_shader_get_entrypoint(nir));
-   nir_shader *softfp64 = NULL;
-   if (nir->info.uses_64bit &&
-       (options->lower_doubles_options & nir_lower_fp64_full_software) != 0) {
-      softfp64 = glsl_float64_funcs_to_nir(st->ctx, options);
-      ralloc_steal(ralloc_parent(nir), softfp64);
-   }
+
+   return nir;
+}
+
+/* Whether st_glsl_to_nir_lower() needs the software fp64 library. */
+static bool
+st_nir_needs_softfp64(const nir_shader *nir)
+{
+   return nir->info.uses_64bit &&
+          (nir->options->lower_doubles_options &
+           nir_lower_fp64_full_software) != 0;
+}
+
+static void
+st_glsl_to_nir_lower(struct st_context *st,
+                     struct gl_shader_program *shader_program,
+                     nir_shader *nir, nir_shader *softfp64)
+{
+   const nir_shader_compiler_options *options = nir->options;
+   enum pipe_shader_type type = pipe_shader_type_from_mesa(nir->info.stage);
+   struct pipe_screen *screen = st->pipe->screen;
+   bool is_scalar = screen->get_shader_param(screen, type, PIPE_SHADER_CAP_SCALAR_ISA);
+   bool lower_64bit =
+      options->lower_int64_options || options->lower_doubles_options;
 
    nir_variable_mode mask =
       (nir_variable_mode) (nir_var_shader_in | nir_var_shader_out);
@@ -465,8 +484,6 @@ st_glsl_to_nir(struct st_context *st, struct gl_program *prog,
       if (lowered_64bit_ops)
          st_nir_opts(nir, is_scalar);
    }
-
-   return nir;
 }
 
 /* Second third of converting glsl_to_nir. This creates uniforms, gathers
@@ -618,7 +635,6 @@ st_nir_get_mesa_program(struct gl_context *ctx,
                         struct gl_shader_program *shader_program,
                         struct gl_linked_shader *shader)
 {
-   struct st_context *st = st_context(ctx);
    struct pipe_screen *pscreen = ctx->st->pipe->screen;
    struct gl_program *prog;
 
@@ -647,11 +663,52 @@ st_nir_get_mesa_program(struct gl_context *ctx,
 
    prog->ExternalSamplersUsed = gl_external_samplers(prog);
    _mesa_update_shader_textures_used(shader_program, prog);
+}
+
+/* The stages of a program on their way from GLSL IR to NIR in st_link_nir().
+ */
+struct st_nir_link_stages {
+   bool is_scalar[MESA_SHADER_STAGES];
+   nir_shader *nir[MESA_SHADER_STAGES];
+   nir_shader *softfp64[MESA_SHADER_STAGES];
+};
+
+/* Convert a linked shader to NIR.  This only touches the stage's own IR and
+ * program, so it runs for all stages in parallel.
+ */
+static void
+st_nir_translate_linked_shader(struct gl_context *ctx,
+                               struct gl_shader_program *shader_program,
+                               struct gl_linked_shader *shader, void *data)
+{
+   struct st_nir_link_stages *stages = (struct st_nir_link_stages *) data;
 
-   nir_shader *nir = st_glsl_to_nir(st, prog, shader_program, shader->Stage);
+   stages->nir[shader->Stage] =
+      st_glsl_to_nir(st_context(ctx), shader->Program, shader_program,
+                     shader->Stage);
+}
+
+/* Lower the NIR of a linked shader, in parallel like the translation. */
+static void
+st_nir_lower_linked_shader(struct gl_context *ctx,
+                           struct gl_shader_program *shader_program,
+                           struct gl_linked_shader *shader, void *data)
+{
+   struct st_nir_link_stages *stages = (struct st_nir_link_stages *) data;
+   struct gl_program *prog = shader->Program;
+   nir_shader *nir = stages->nir[shader->Stage];
+
+   if (nir != prog->nir) {
+      st_glsl_to_nir_lower(st_context(ctx), shader_program, nir,
+                           stages->softfp64[shader->Stage]);
+   }
 
    set_st_program(prog, shader_program, nir);
    prog->nir = nir;
+
+   if (stages->is_scalar[shader->Stage]) {
+      NIR_PASS_V(nir, nir_lower_load_const_to_scalar);
+   }
 }
 
 static void
@@ -790,7 +847,7 @@ st_link_nir(struct gl_context *ctx,
 {
    struct st_context *st = st_context(ctx);
    struct pipe_screen *screen = st->pipe->screen;
-   bool is_scalar[MESA_SHADER_STAGES];
+   struct st_nir_link_stages stages = {};
 
    unsigned last_stage = 0;
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
@@ -800,17 +857,33 @@ st_link_nir(struct gl_context *ctx,
 
       /* Determine scalar property of each shader stage */
       enum pipe_shader_type type = pipe_shader_type_from_mesa(shader->Stage);
-      is_scalar[i] = screen->get_shader_param(screen, type,
-                                              PIPE_SHADER_CAP_SCALAR_ISA);
+      stages.is_scalar[i] = screen->get_shader_param(screen, type,
+                                                     PIPE_SHADER_CAP_SCALAR_ISA);
 
       st_nir_get_mesa_program(ctx, shader_program, shader);
       last_stage = i;
+   }
 
-      if (is_scalar[i]) {
-         NIR_PASS_V(shader->Program->nir, nir_lower_load_const_to_scalar);
-      }
+   link_util_run_stages(ctx, shader_program, st_nir_translate_linked_shader,
+                        &stages);
+
+   /* The software fp64 library is compiled from GLSL with the context, so
+    * build it here rather than on the threads the stages run on.
+    */
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      struct gl_linked_shader *shader = shader_program->_LinkedShaders[i];
+      nir_shader *nir = stages.nir[i];
+      if (nir == NULL || nir == shader->Program->nir ||
+          !st_nir_needs_softfp64(nir))
+         continue;
+
+      stages.softfp64[i] = glsl_float64_funcs_to_nir(ctx, nir->options);
+      ralloc_steal(ralloc_parent(nir), stages.softfp64[i]);
    }
 
+   link_util_run_stages(ctx, shader_program, st_nir_lower_linked_shader,
+                        &stages);
+
    /* Linking the stages in the opposite order (from fragment to vertex)
     * ensures that inter-shader outputs written to in an earlier stage
     * are eliminated if they are (transitively) not used in a later
@@ -824,7 +897,7 @@ st_link_nir(struct gl_context *ctx,
 
       st_nir_link_shaders(&shader->Program->nir,
                           &shader_program->_LinkedShaders[next]->Program->nir,
-                          is_scalar[i]);
+                          stages.is_scalar[i]);
       next = i;
    }
 
@@ -96,7 +96,7 @@ simple_mtx_unlock(simple_mtx_t *mtx)
 
    c = __sync_fetch_and_sub(&mtx->val, 1);
    if (__builtin_expect(c != 1, 0)) {
-      mtx->val = 0;
+      __sync_lock_release(&mtx->val);
       futex_wake(&mtx->val, 1);
    }
 }
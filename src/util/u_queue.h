@@ -113,7 +113,11 @@ util_queue_fence_reset(struct util_queue_fence *fence)
 static inline bool
 util_queue_fence_is_signalled(struct util_queue_fence *fence)
 {
-   return fence->val == 0;
+   /* Acquire, so that whatever the job wrote before signalling is visible to
+    * the caller.  p_atomic_read() is only an acquire load with the __atomic
+    * builtins, so ask for it explicitly; this path requires GCC anyway.
+    */
+   return __atomic_load_n(&fence->val, __ATOMIC_ACQUIRE) == 0;
 }
 #endif
 